@@ -0,0 +1,79 @@
+#include <jukebox/host/host.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+
+// The benchmark runs outside the game: songs live in a scratch directory,
+// GD knows no songs, there is no network, saves and events go nowhere and
+// logs go to stderr
+
+namespace jukebox {
+
+namespace host {
+
+std::filesystem::path saveDir() {
+    return std::filesystem::temp_directory_path() / "jukebox-bench";
+}
+
+std::filesystem::path gdResourcesDir() { return saveDir() / "Resources"; }
+
+std::filesystem::path gdSongsDir() { return saveDir() / "songs"; }
+
+std::filesystem::path gdSongPath(int songID) {
+    return gdSongsDir() / fmt::format("{}.mp3", songID);
+}
+
+std::filesystem::path robtopSongPath(int songID) {
+    return gdResourcesDir() / fmt::format("{}.mp3", songID);
+}
+
+std::optional<SongInfo> songInfo(int songID) { return std::nullopt; }
+
+void fetchSongInfo(int songID, bool refetch) {}
+
+void httpGet(HttpRequest request, HttpCallback callback) {
+    callback(geode::Err(
+        fmt::format("No network in the benchmark: {}", request.url)));
+}
+
+void queueSave(int songID) {}
+
+void activeChanged(Nongs* nongs) {}
+
+void songDeleted(UniqueID uniqueID, int songID) {}
+
+void songsCleared(std::vector<UniqueID> uniqueIDs, int songID) {}
+
+bool fileExists(const std::filesystem::path& path) {
+    std::error_code ec;
+    return std::filesystem::exists(path, ec);
+}
+
+// Nothing watches the files, the bench never changes them mid-run either
+bool fileWatched(const std::filesystem::path& path) { return false; }
+
+void removeSongFiles(std::vector<std::filesystem::path> paths) {
+    for (const std::filesystem::path& path : paths) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+}
+
+void logWarning(std::string_view message) {
+    fmt::print(stderr, "[warn] {}\n", message);
+}
+
+void logError(std::string_view message) {
+    fmt::print(stderr, "[error] {}\n", message);
+}
+
+}  // namespace host
+
+}  // namespace jukebox
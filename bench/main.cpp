@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/compat/v2.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/nong/index.hpp>
+#include <jukebox/nong/index_delta.hpp>
+#include <jukebox/nong/index_parser.hpp>
+#include <jukebox/nong/nong.hpp>
+#include <jukebox/nong/nong_parser.hpp>
+#include <jukebox/nong/nong_serialize.hpp>
+#include <jukebox/utils/flat_int_map.hpp>
+
+using namespace jukebox;
+
+namespace {
+
+// Every allocation of the process goes through these, so each step can
+// report how much memory it kept and how much it needed at its peak
+struct Allocations {
+    std::atomic<std::size_t> live = 0;
+    std::atomic<std::size_t> peak = 0;
+    std::atomic<std::size_t> count = 0;
+};
+
+Allocations s_allocations;
+
+// Room in front of every block for its size, keeping malloc's alignment
+constexpr std::size_t s_header = alignof(std::max_align_t);
+
+void* allocate(std::size_t size) {
+    void* block = std::malloc(size + s_header);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<std::size_t*>(block) = size;
+
+    const std::size_t live =
+        s_allocations.live.fetch_add(size, std::memory_order_relaxed) + size;
+    std::size_t peak = s_allocations.peak.load(std::memory_order_relaxed);
+    while (live > peak && !s_allocations.peak.compare_exchange_weak(
+                              peak, live, std::memory_order_relaxed)) {
+    }
+    s_allocations.count.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<std::byte*>(block) + s_header;
+}
+
+void deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    std::byte* block = static_cast<std::byte*>(ptr) - s_header;
+    s_allocations.live.fetch_sub(*reinterpret_cast<std::size_t*>(block),
+                                 std::memory_order_relaxed);
+    std::free(block);
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void* ptr) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { deallocate(ptr); }
+
+namespace {
+
+constexpr std::size_t s_lookups = 1000000;
+constexpr std::size_t s_searches = 1000;
+
+struct Sample {
+    std::chrono::duration<double, std::milli> time;
+    std::size_t allocations;
+    // Above what was live when the step started
+    std::size_t peak;
+    // Still live after the step, negative if it freed memory
+    std::int64_t kept;
+};
+
+template <class F>
+Sample measure(F&& step) {
+    const std::size_t live = s_allocations.live.load();
+    const std::size_t count = s_allocations.count.load();
+    s_allocations.peak.store(live);
+
+    const auto start = std::chrono::steady_clock::now();
+    step();
+    const auto end = std::chrono::steady_clock::now();
+
+    return Sample{
+        .time = end - start,
+        .allocations = s_allocations.count.load() - count,
+        .peak = s_allocations.peak.load() - live,
+        .kept = static_cast<std::int64_t>(s_allocations.live.load()) -
+                static_cast<std::int64_t>(live)};
+}
+
+double megabytes(double bytes) { return bytes / (1024.0 * 1024.0); }
+
+void printHeader() {
+    fmt::print("{:>7}  {:<18} {:>10} {:>10} {:>10} {:>9} {:>9}\n", "songs",
+               "step", "total ms", "per op", "allocs", "peak MB", "kept MB");
+}
+
+/**
+ * @param ops how many songs, lookups or queries the step went through
+ */
+void printSample(std::size_t songs, std::string_view step, std::size_t ops,
+                 const Sample& sample) {
+    const double perOp = sample.time.count() * 1e6 / ops;
+    fmt::print("{:>7}  {:<18} {:>10.2f} {:>7.0f} ns {:>10} {:>9.2f} {:>9.2f}\n",
+               songs, step, sample.time.count(), perOp, sample.allocations,
+               megabytes(sample.peak), megabytes(sample.kept));
+}
+
+// Names and artists repeat across songs like they do in real indexes
+class Generator {
+private:
+    constexpr static inline std::string_view s_words[] = {
+        "Dash",      "Theory",    "Cycles",     "Electro",    "Clubstep",
+        "Blast",     "Stereo",    "Madness",    "Jumper",     "Time",
+        "Machine",   "Press",     "Start",      "Nock",       "Em",
+        "Dry",       "Out",       "Fingerdash", "Xstep",      "Polargeist",
+        "Base",      "After",     "Cataclysm",  "Deadlocked", "Toe",
+        "Heartbeat", "Sound",     "Bounce",     "Neon",       "Velocity"};
+
+    std::mt19937 m_random{42};
+
+public:
+    std::string word() {
+        return std::string(
+            s_words[m_random() % (sizeof(s_words) / sizeof(s_words[0]))]);
+    }
+
+    std::string name() {
+        return fmt::format("{} {}", this->word(), this->word());
+    }
+
+    std::string artist() {
+        return fmt::format("{}{}", this->word(), m_random() % 500);
+    }
+
+    std::string uniqueID() {
+        constexpr std::string_view charset =
+            "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+        std::string ret(16, '\0');
+        for (char& c : ret) {
+            c = charset[m_random() % charset.size()];
+        }
+        return ret;
+    }
+
+    std::uint32_t next() { return m_random(); }
+};
+
+std::string songPath(std::string_view uniqueID) {
+    return (host::saveDir() / "nongs" / fmt::format("{}.mp3", uniqueID))
+        .string();
+}
+
+matjson::Value songJson(Generator& random, std::string uniqueID) {
+    return matjson::makeObject({
+        {"name", random.name()},
+        {"unique_id", uniqueID},
+        {"artist", random.artist()},
+        {"path", songPath(uniqueID)},
+        {"offset", static_cast<int>(random.next() % 4) * 250},
+    });
+}
+
+/**
+ * One manifest file per song ID, as the manifest directory stores them. A
+ * song has its default, a local NONG, and a YouTube or hosted NONG for half
+ * of them each.
+ */
+std::vector<std::pair<int, std::string>> generateManifest(std::size_t songs) {
+    Generator random;
+    std::vector<std::pair<int, std::string>> ret;
+    ret.reserve(songs);
+    for (std::size_t i = 0; i < songs; i++) {
+        const int id = static_cast<int>(i) + 1;
+        const std::string local = random.uniqueID();
+        matjson::Value youtube = matjson::Value::array();
+        matjson::Value hosted = matjson::Value::array();
+        if (random.next() % 2) {
+            matjson::Value song = songJson(random, random.uniqueID());
+            song["youtube_id"] = random.uniqueID().substr(0, 11);
+            youtube.push(std::move(song));
+        }
+        if (random.next() % 2) {
+            matjson::Value song = songJson(random, random.uniqueID());
+            song["url"] = fmt::format("https://example.com/{}.mp3", id);
+            hosted.push(std::move(song));
+        }
+
+        matjson::Value locals = matjson::Value::array();
+        locals.push(songJson(random, local));
+        matjson::Value nongs = matjson::makeObject({
+            {"default", songJson(random, random.uniqueID())},
+            {"active", local},
+            {"locals", std::move(locals)},
+            {"youtube", std::move(youtube)},
+            {"hosted", std::move(hosted)},
+        });
+        ret.emplace_back(id, nongs.dump(matjson::NO_INDENTATION));
+    }
+    return ret;
+}
+
+/**
+ * An index with a song for every song ID on average. Songs are for one to
+ * three song IDs, a fifth of them from YouTube.
+ */
+std::string generateIndex(std::size_t songs) {
+    Generator random;
+    matjson::Value youtube = matjson::makeObject({});
+    matjson::Value hosted = matjson::makeObject({});
+    for (std::size_t i = 0; i < songs; i++) {
+        matjson::Value ids = matjson::Value::array();
+        const std::uint32_t count = 1 + random.next() % 3;
+        for (std::uint32_t j = 0; j < count; j++) {
+            ids.push(static_cast<int>(1 + random.next() % songs));
+        }
+        matjson::Value song = matjson::makeObject({
+            {"name", random.name()},
+            {"artist", random.artist()},
+            {"songs", std::move(ids)},
+            {"startOffset", static_cast<int>(random.next() % 4) * 250},
+        });
+        if (random.next() % 5 == 0) {
+            song["ytID"] = random.uniqueID().substr(0, 11);
+            youtube.set(random.uniqueID(), std::move(song));
+        } else {
+            song["url"] = fmt::format("https://example.com/{}.mp3", i);
+            hosted.set(random.uniqueID(), std::move(song));
+        }
+    }
+
+    matjson::Value nongs = matjson::makeObject({
+        {"youtube", std::move(youtube)},
+        {"hosted", std::move(hosted)},
+    });
+    matjson::Value index = matjson::makeObject({
+        {"manifest", 1},
+        {"url", "https://example.com/index.json"},
+        {"id", "bench"},
+        {"name", "Benchmark"},
+        {"lastUpdate", 1},
+        {"nongs", std::move(nongs)},
+    });
+    return index.dump(matjson::NO_INDENTATION);
+}
+
+/**
+ * A delta to the generated index adding a song per hundred and removing
+ * as many of the existing ones
+ */
+std::string generateIndexDelta(const index::IndexMetadata& index) {
+    Generator random;
+    const std::size_t changed = std::max<std::size_t>(
+        1, (index.m_songs.m_youtube.size() + index.m_songs.m_hosted.size()) /
+               100);
+    matjson::Value hosted = matjson::makeObject({});
+    matjson::Value removed = matjson::Value::array();
+    for (std::size_t i = 0; i < changed; i++) {
+        matjson::Value ids = matjson::Value::array();
+        ids.push(static_cast<int>(1 + random.next() % changed));
+        hosted.set(random.uniqueID(),
+                   matjson::makeObject({
+                       {"name", random.name()},
+                       {"artist", random.artist()},
+                       {"songs", std::move(ids)},
+                       {"url", fmt::format("https://example.com/d{}.mp3", i)},
+                   }));
+        if (i < index.m_songs.m_hosted.size()) {
+            removed.push(std::string(index.m_songs.m_hosted[i]->uniqueID));
+        }
+    }
+
+    matjson::Value delta = matjson::makeObject({
+        {"manifest", 2},
+        {"id", index.m_id},
+        {"since", index.m_lastUpdate.value_or(0)},
+        {"lastUpdate", index.m_lastUpdate.value_or(0) + 1},
+        {"nongs", matjson::makeObject({{"hosted", std::move(hosted)}})},
+        {"removed", std::move(removed)},
+    });
+    return delta.dump(matjson::NO_INDENTATION);
+}
+
+/**
+ * The v2 nong_data.json, three songs per song ID
+ */
+std::string generateV2Manifest(std::size_t songs) {
+    Generator random;
+    matjson::Value nongs = matjson::makeObject({});
+    for (std::size_t i = 0; i < songs; i++) {
+        matjson::Value list = matjson::Value::array();
+        std::string defaultPath;
+        for (int j = 0; j < 3; j++) {
+            std::string path = songPath(random.uniqueID());
+            if (j == 0) {
+                defaultPath = path;
+            }
+            list.push(matjson::makeObject({
+                {"songName", random.name()},
+                {"authorName", random.artist()},
+                {"path", std::move(path)},
+                {"startOffset", 0},
+            }));
+        }
+        nongs.set(fmt::format("{}", i + 1),
+                  matjson::makeObject({
+                      {"defaultPath", defaultPath},
+                      {"active", defaultPath},
+                      {"songs", std::move(list)},
+                  }));
+    }
+    return matjson::makeObject({{"version", 3}, {"nongs", std::move(nongs)}})
+        .dump(matjson::NO_INDENTATION);
+}
+
+void benchManifest(std::size_t songs) {
+    const std::vector<std::pair<int, std::string>> files =
+        generateManifest(songs);
+
+    std::vector<std::pair<int, matjson::Value>> documents;
+    documents.reserve(files.size());
+    printSample(songs, "manifest json", songs, measure([&]() {
+                    for (const auto& [id, text] : files) {
+                        matjson::Value json =
+                            matjson::parse(text).unwrapOr(matjson::Value());
+                        documents.emplace_back(id, std::move(json));
+                    }
+                }));
+
+    FlatIntMap<std::unique_ptr<Nongs>> manifest;
+    std::vector<std::string> warnings;
+    printSample(songs, "manifest build", songs, measure([&]() {
+                    manifest.reserve(documents.size());
+                    for (const auto& [id, json] : documents) {
+                        geode::Result<Nongs> nongs =
+                            matjson::Serialize<Nongs>::fromJson(json, id,
+                                                                &warnings);
+                        if (nongs.isOk()) {
+                            manifest.insert(
+                                {id, std::make_unique<Nongs>(
+                                         std::move(nongs.unwrap()))});
+                        }
+                    }
+                }));
+    documents.clear();
+    documents.shrink_to_fit();
+
+    // The same files again, without the DOM step
+    std::size_t streamed = 0;
+    printSample(songs, "manifest stream", songs, measure([&]() {
+                    for (const auto& [id, text] : files) {
+                        streamed += parseNongs(text, id, &warnings).isOk();
+                    }
+                }));
+
+    std::size_t bytes = 0;
+    printSample(songs, "manifest serialize", songs, measure([&]() {
+                    for (auto& [id, nongs] : manifest) {
+                        bytes += matjson::Serialize<Nongs>::toJson(*nongs)
+                                     .dump(matjson::NO_INDENTATION)
+                                     .size();
+                    }
+                }));
+
+    Generator random;
+    std::size_t found = 0;
+    printSample(songs, "manifest lookup", s_lookups, measure([&]() {
+                    for (std::size_t i = 0; i < s_lookups; i++) {
+                        const int id = 1 + random.next() % songs;
+                        auto it = manifest.find(id);
+                        if (it == manifest.end()) {
+                            continue;
+                        }
+                        Nongs& nongs = *it->second;
+                        found += nongs
+                                     .findSong(nongs.defaultSong()
+                                                   ->metadata()
+                                                   ->uniqueID)
+                                     .has_value();
+                    }
+                }));
+
+    if (!warnings.empty() || found == 0 || bytes == 0 ||
+        streamed != manifest.size()) {
+        fmt::print(stderr, "{} manifest warnings, {} lookups found\n",
+                   warnings.size(), found);
+    }
+}
+
+void benchIndex(std::size_t songs) {
+    const std::string text = generateIndex(songs);
+
+    matjson::Value json;
+    printSample(songs, "index json", songs, measure([&]() {
+                    json = matjson::parse(text).unwrapOr(matjson::Value());
+                }));
+
+    std::optional<index::ParsedIndex> parsed;
+    printSample(songs, "index build", songs, measure([&]() {
+                    geode::Result<index::ParsedIndex> res =
+                        index::parseIndex(std::move(json));
+                    if (res.isOk()) {
+                        parsed = std::move(res.unwrap());
+                    }
+                }));
+    if (!parsed) {
+        fmt::print(stderr, "Index didn't parse\n");
+        return;
+    }
+
+    // The same text again, without the DOM step
+    std::size_t streamed = 0;
+    printSample(songs, "index stream", songs, measure([&]() {
+                    geode::Result<index::ParsedIndex> res =
+                        index::parseIndex(std::string_view(text));
+                    if (res.isOk()) {
+                        streamed = res.unwrap().songsForID.size();
+                    }
+                }));
+    if (streamed != parsed->songsForID.size()) {
+        fmt::print(stderr, "Streamed index differs\n");
+    }
+
+    Generator random;
+    std::size_t found = 0;
+    printSample(songs, "index lookup", s_lookups, measure([&]() {
+                    for (std::size_t i = 0; i < s_lookups; i++) {
+                        const int id = 1 + random.next() % songs;
+                        if (auto it = parsed->songsForID.find(id);
+                            it != parsed->songsForID.end()) {
+                            found += it->second.size();
+                        }
+                    }
+                }));
+
+    printSample(songs, "index search", s_searches, measure([&]() {
+                    for (std::size_t i = 0; i < s_searches; i++) {
+                        found +=
+                            parsed->index->searchSongs(random.word()).size();
+                    }
+                }));
+
+    if (found == 0) {
+        fmt::print(stderr, "No index songs found\n");
+    }
+
+    // Applied in place instead of parsing the whole index again
+    const std::string deltaText = generateIndexDelta(*parsed->index);
+    bool applied = false;
+    printSample(songs, "index delta", songs, measure([&]() {
+                    geode::Result<index::IndexDelta> delta =
+                        index::parseIndexDelta(deltaText);
+                    if (delta.isOk()) {
+                        applied = index::applyIndexDelta(
+                                      *parsed, std::move(delta.unwrap()))
+                                      .isOk();
+                    }
+                }));
+    if (!applied) {
+        fmt::print(stderr, "Index delta didn't apply\n");
+    }
+}
+
+void benchV2(std::size_t songs) {
+    std::error_code ec;
+    std::filesystem::create_directories(host::saveDir(), ec);
+    {
+        std::ofstream output(compat::v2::manifestPath(), std::ios::binary);
+        output << generateV2Manifest(songs);
+    }
+
+    std::size_t parsed = 0;
+    printSample(songs, "v2 parse", songs, measure([&]() {
+                    auto res = compat::v2::parseManifest();
+                    if (res.isOk()) {
+                        parsed = res.unwrap().size();
+                    }
+                }));
+    std::filesystem::remove(compat::v2::manifestPath(), ec);
+
+    if (parsed != songs) {
+        fmt::print(stderr, "Parsed {} of {} v2 songs\n", parsed, songs);
+    }
+}
+
+}  // namespace
+
+/**
+ * Usage: jukebox-bench [song counts...], 1000 10000 100000 by default
+ */
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes.empty()) {
+        sizes = {1000, 10000, 100000};
+    }
+
+    printHeader();
+    for (std::size_t songs : sizes) {
+        if (songs == 0) {
+            continue;
+        }
+        benchManifest(songs);
+        benchIndex(songs);
+        benchV2(songs);
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(host::saveDir(), ec);
+    return 0;
+}
@@ -1,21 +1,28 @@
 #include <jukebox/compat/v2.hpp>
 
+#include <charconv>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iterator>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <fmt/core.h>
 #include <Geode/Result.hpp>
-#include <Geode/loader/Log.hpp>
-#include <Geode/loader/Mod.hpp>
-#include <matjson.hpp>
 
 #include <jukebox/compat/compat.hpp>
+#include <jukebox/host/host.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/json_reader.hpp>
 #include <jukebox/utils/random_string.hpp>
 
-using namespace geode::prelude;
+using namespace geode;
 
 namespace jukebox {
 
@@ -23,16 +30,163 @@ namespace compat {
 
 namespace v2 {
 
-bool isSongValid(const matjson::Value& s) {
-    return s.contains("songName") && s["songName"].isString() &&
-           s.contains("authorName") && s["authorName"].isString() &&
-           s.contains("path") && s["path"].isString();
+namespace {
+
+struct V2Song {
+    std::optional<std::string> name;
+    std::optional<std::string> artist;
+    std::optional<std::string> path;
+    int startOffset = 0;
+
+    bool valid() const { return name && artist && path; }
+};
+
+struct V2Entry {
+    std::optional<std::string> defaultPath;
+    std::optional<std::string> active;
+    std::optional<std::vector<V2Song>> songs;
+};
+
+Result<std::optional<std::string>> readOptionalString(JsonReader& reader) {
+    GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+    if (type != JsonReader::Type::String) {
+        GEODE_UNWRAP(reader.skip());
+        return Ok(std::nullopt);
+    }
+    GEODE_UNWRAP_INTO(std::string_view str, reader.readString());
+    return Ok(std::string(str));
+}
+
+Result<V2Song> readSong(JsonReader& reader) {
+    V2Song song;
+    GEODE_UNWRAP(reader.readObject([&](std::string_view key) -> Result<> {
+        if (key == "songName") {
+            GEODE_UNWRAP_INTO(song.name, readOptionalString(reader));
+            return Ok();
+        }
+        if (key == "authorName") {
+            GEODE_UNWRAP_INTO(song.artist, readOptionalString(reader));
+            return Ok();
+        }
+        if (key == "path") {
+            GEODE_UNWRAP_INTO(song.path, readOptionalString(reader));
+            return Ok();
+        }
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (key == "startOffset" && type == JsonReader::Type::Number) {
+            GEODE_UNWRAP_INTO(std::int64_t offset, reader.readInt());
+            song.startOffset = static_cast<int>(offset);
+            return Ok();
+        }
+        return reader.skip();
+    }));
+    return Ok(std::move(song));
+}
+
+Result<V2Entry> readEntry(JsonReader& reader) {
+    V2Entry entry;
+    GEODE_UNWRAP(reader.readObject([&](std::string_view key) -> Result<> {
+        if (key == "defaultPath") {
+            GEODE_UNWRAP_INTO(entry.defaultPath, readOptionalString(reader));
+            return Ok();
+        }
+        if (key == "active") {
+            GEODE_UNWRAP_INTO(entry.active, readOptionalString(reader));
+            return Ok();
+        }
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (key == "songs" && type == JsonReader::Type::Array) {
+            entry.songs.emplace();
+            return reader.readArray([&]() -> Result<> {
+                GEODE_UNWRAP_INTO(JsonReader::Type element, reader.peek());
+                if (element != JsonReader::Type::Object) {
+                    // Kept as an invalid song, for the warning
+                    entry.songs->emplace_back();
+                    return reader.skip();
+                }
+                GEODE_UNWRAP_INTO(V2Song song, readSong(reader));
+                entry.songs->push_back(std::move(song));
+                return Ok();
+            });
+        }
+        return reader.skip();
+    }));
+    return Ok(std::move(entry));
+}
+
+LocalSong makeSong(int id, std::string unique, const V2Song& song) {
+    return LocalSong(SongMetadata(id, UniqueID(unique), song.name.value(),
+                                  song.artist.value(), std::nullopt,
+                                  song.startOffset),
+                     std::filesystem::path(song.path.value()));
+}
+
+/**
+ * The first valid song with the given path, as a new song
+ */
+std::optional<LocalSong> findSong(int id, const std::filesystem::path& path,
+                                  const std::vector<V2Song>& songs) {
+    for (const V2Song& song : songs) {
+        if (song.valid() && std::filesystem::path(song.path.value()) == path) {
+            return makeSong(id, jukebox::random_string(16), song);
+        }
+    }
+    return std::nullopt;
 }
 
+std::optional<CompatManifest> buildEntry(int id, V2Entry&& entry) {
+    if (!entry.defaultPath || !entry.active || !entry.songs) {
+        host::logWarning(fmt::format("Skipping id {}, invalid data", id));
+        return std::nullopt;
+    }
+
+    const std::filesystem::path defaultPath(entry.defaultPath.value());
+    const std::filesystem::path activePath(entry.active.value());
+    const std::vector<V2Song>& songs = entry.songs.value();
+
+    std::optional<LocalSong> defaultSong = findSong(id, defaultPath, songs);
+    if (!defaultSong) {
+        host::logWarning("Default song not found");
+        return std::nullopt;
+    }
+    std::optional<LocalSong> activeSong = findSong(id, activePath, songs);
+    if (!activeSong) {
+        host::logWarning("Active song not found");
+        return std::nullopt;
+    }
+
+    std::vector<LocalSong> manifestSongs;
+    manifestSongs.reserve(songs.size());
+    for (const V2Song& song : songs) {
+        if (!song.valid()) {
+            host::logWarning("Found invalid song. Skipping...");
+            continue;
+        }
+
+        const std::filesystem::path path(song.path.value());
+        std::string unique;
+        if (path == defaultPath) {
+            unique = defaultSong->metadata()->uniqueID;
+        } else if (path == activePath) {
+            unique = activeSong->metadata()->uniqueID;
+        } else {
+            unique = jukebox::random_string(16);
+        }
+        manifestSongs.push_back(makeSong(id, std::move(unique), song));
+    }
+
+    return CompatManifest{.id = id,
+                          .defaultSong = std::move(defaultSong.value()),
+                          .active = std::move(activeSong.value()),
+                          .songs = std::move(manifestSongs)};
+}
+
+}  // namespace
+
 bool manifestExists() { return std::filesystem::exists(manifestPath()); }
 
 std::filesystem::path manifestPath() {
-    return Mod::get()->getSaveDir() / "nong_data.json";
+    return host::saveDir() / "nong_data.json";
 }
 
 void backupManifest(bool deleteOrig) {
@@ -41,7 +195,7 @@ void backupManifest(bool deleteOrig) {
     }
 
     const std::filesystem::path backupDir =
-        Mod::get()->getSaveDir() / ".v2-compat-backup";
+        host::saveDir() / ".v2-compat-backup";
     bool exists = std::filesystem::exists(backupDir);
 
     if (exists && !std::filesystem::is_directory(backupDir)) {
@@ -66,67 +220,6 @@ void backupManifest(bool deleteOrig) {
     }
 }
 
-Result<LocalSong> parseSong(const matjson::Value& i, int id) {
-    if (!isSongValid(i)) {
-        return Err("Invalid JSON");
-    }
-
-    std::filesystem::path path =
-        i["path"]
-            .asString()
-            .map([](std::string v) { return std::filesystem::path(v); })
-            .unwrap();
-
-    return Ok(LocalSong(
-        SongMetadata(id, jukebox::random_string(16),
-                     i["songName"].asString().unwrap(),
-                     i["authorName"].asString().unwrap(), std::nullopt,
-                     i["startOffset"].asInt().unwrapOr(0)),
-        path));
-}
-
-Result<LocalSong> getDefault(int id, const std::filesystem::path& defaultPath,
-                             const matjson::Value& songs) {
-    for (const matjson::Value& i : songs) {
-        if (!isSongValid(i)) {
-            continue;
-        }
-
-        std::filesystem::path path = i["path"].asString().unwrap();
-        if (path == defaultPath) {
-            return Ok(LocalSong(
-                SongMetadata(id, jukebox::random_string(16),
-                             i["songName"].asString().unwrap(),
-                             i["authorName"].asString().unwrap(), std::nullopt,
-                             i["startOffset"].asInt().unwrapOr(0)),
-                path));
-        }
-    }
-
-    return Err("Default song not found");
-}
-
-Result<LocalSong> getActive(int id, const std::filesystem::path& activePath,
-                            const matjson::Value& songs) {
-    for (const matjson::Value& i : songs) {
-        if (!isSongValid(i)) {
-            continue;
-        }
-
-        std::filesystem::path path = i["path"].asString().unwrap();
-        if (path == activePath) {
-            return Ok(LocalSong(
-                SongMetadata(id, jukebox::random_string(16),
-                             i["songName"].asString().unwrap(),
-                             i["authorName"].asString().unwrap(), std::nullopt,
-                             i["startOffset"].asInt().unwrapOr(0)),
-                path));
-        }
-    }
-
-    return Err("Active song not found");
-}
-
 Result<std::unordered_map<int, CompatManifest>> parseManifest() {
     if (!manifestExists()) {
         return Err("No manifest exists for V2");
@@ -134,95 +227,70 @@ Result<std::unordered_map<int, CompatManifest>> parseManifest() {
 
     std::filesystem::path path = manifestPath();
 
-    std::ifstream input(path);
+    std::ifstream input(path, std::ios::binary);
     if (!input.is_open()) {
         return Err(
             fmt::format("Couldn't open file: {}", path.filename().string()));
     }
+    const std::string text((std::istreambuf_iterator<char>(input)),
+                           std::istreambuf_iterator<char>());
 
-    GEODE_UNWRAP_INTO(matjson::Value json,
-                      matjson::parse(input).mapErr([](matjson::ParseError err) {
-                          return fmt::format(
-                              "Couldn't parse JSON from file: {}", err);
-                      }));
-
-    if (!json.contains("version") || !json["version"].isNumber()) {
-        return Err("Invalid JSON");
-    }
-
-    int version = json["version"].asInt().unwrap();
-    if (version < 1 || version > 3) {
-        return Err("Invalid JSON");
-    }
-
-    if (!json.contains("nongs") || !json["nongs"].isObject()) {
-        return Err("Invalid JSON");
-    }
-
+    // Entries are built as they are read, one ID's songs at a time
+    std::optional<std::int64_t> version;
+    bool hasNongs = false;
     std::unordered_map<int, CompatManifest> ret;
 
-    for (const auto& [key, data] : json["nongs"]) {
-        int id = std::stoi(key);
-
-        if (!data.contains("defaultPath") || !data["defaultPath"].isString() ||
-            !data.contains("active") || !data["active"].isString() ||
-            !data.contains("songs") || !data["songs"].isArray()) {
-            log::warn("Skipping id {}, invalid data", id);
-            continue;
+    JsonReader reader(text);
+    Result<> read = reader.readObject([&](std::string_view key) -> Result<> {
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (key == "version" && type == JsonReader::Type::Number) {
+            GEODE_UNWRAP_INTO(version, reader.readInt());
+            return Ok();
         }
-
-        std::filesystem::path defaultPath =
-            data["defaultPath"].asString().unwrap();
-        std::filesystem::path activePath = data["active"].asString().unwrap();
-        matjson::Value songs = data["songs"].asArray().unwrap();
-
-        Result<LocalSong> defaultRes = getDefault(id, defaultPath, songs);
-        if (defaultRes.isErr()) {
-            log::warn("{}", defaultRes.unwrapErr());
-            continue;
+        if (key != "nongs" || type != JsonReader::Type::Object) {
+            return reader.skip();
         }
 
-        Result<LocalSong> activeRes = getActive(id, activePath, songs);
-        if (activeRes.isErr()) {
-            log::warn("{}", activeRes.unwrapErr());
-            continue;
-        }
-
-        LocalSong defaultSong = std::move(defaultRes.unwrap());
-        LocalSong activeSong = std::move(activeRes.unwrap());
-        std::vector<LocalSong> manifestSongs;
-
-        for (const matjson::Value& i : songs) {
-            if (!isSongValid(i)) {
-                log::warn("Found invalid song. Skipping...");
-                continue;
+        hasNongs = true;
+        return reader.readObject([&](std::string_view idKey) -> Result<> {
+            int id = 0;
+            auto [end, ec] = std::from_chars(
+                idKey.data(), idKey.data() + idKey.size(), id);
+            if (ec != std::errc() || end != idKey.data() + idKey.size()) {
+                host::logWarning(
+                    fmt::format("Skipping id {}, invalid data", idKey));
+                return reader.skip();
             }
 
-            std::filesystem::path path = i["path"].asString().unwrap();
-            std::string unique;
-
-            if (path == defaultPath) {
-                unique = defaultSong.metadata()->uniqueID;
-            } else if (path == activePath) {
-                unique = activeSong.metadata()->uniqueID;
-            } else {
-                unique = jukebox::random_string(16);
+            GEODE_UNWRAP_INTO(JsonReader::Type entryType, reader.peek());
+            if (entryType != JsonReader::Type::Object) {
+                host::logWarning(
+                    fmt::format("Skipping id {}, invalid data", id));
+                return reader.skip();
             }
 
-            manifestSongs.push_back(LocalSong(
-                SongMetadata(id, unique, i["songName"].asString().unwrap(),
-                             i["authorName"].asString().unwrap(), std::nullopt,
-                             i["startOffset"].asInt().unwrapOr(0)),
-                path));
-        }
+            GEODE_UNWRAP_INTO(V2Entry entry, readEntry(reader));
+            if (std::optional<CompatManifest> manifest =
+                    buildEntry(id, std::move(entry))) {
+                ret.insert({id, std::move(manifest.value())});
+            }
+            return Ok();
+        });
+    });
+    if (read.isOk()) {
+        read = reader.finish();
+    }
+    if (read.isErr()) {
+        return Err(fmt::format("Couldn't parse JSON from file: {}",
+                               read.unwrapErr()));
+    }
 
-        ret.insert({id, CompatManifest{.id = id,
-                                       .defaultSong = defaultSong,
-                                       .active = activeSong,
-                                       .songs = std::move(manifestSongs)}});
+    if (!version || version.value() < 1 || version.value() > 3 ||
+        !hasNongs) {
+        return Err("Invalid JSON");
     }
 
-    return Ok(ret);
+    return Ok(std::move(ret));
 }
 
 }  // namespace v2
@@ -1,14 +1,25 @@
 #pragma once
 
+#include <filesystem>
+
 #include <Geode/Result.hpp>
 #include <Geode/utils/Task.hpp>
-#include <Geode/utils/general.hpp>
 
 namespace jukebox {
 
 namespace download {
 
-using DownloadTask = geode::Task<geode::Result<geode::ByteVector>, float>;
+struct DownloadProgress {
+    // 0 to 100
+    float percent = 0.f;
+    // Attempt number of a retry that is waiting or running, 0 if the download
+    // hasn't failed
+    int retry = 0;
+};
+
+// Resolves to the path the song was written to
+using DownloadTask =
+    geode::Task<geode::Result<std::filesystem::path>, DownloadProgress>;
 
 }
 
@@ -0,0 +1,129 @@
+#include <jukebox/download/host_stats.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// 5s, 10s, 20s... capped at 160s
+std::chrono::seconds failureCooldown(int failures) {
+    return std::chrono::seconds(5) * (1 << std::min(failures - 1, 5));
+}
+
+}  // namespace
+
+namespace jukebox {
+
+namespace download {
+
+std::string hostFromUrl(std::string_view url) {
+    if (std::size_t scheme = url.find("://"); scheme != std::string_view::npos) {
+        url.remove_prefix(scheme + 3);
+    }
+    return std::string(url.substr(0, url.find_first_of("/?#")));
+}
+
+void HostStats::recordSuccess(std::string_view url, std::uint64_t bytes,
+                              Seconds elapsed) {
+    const double seconds = std::max(elapsed.count(), 0.001);
+    auto blend = [](std::optional<double>& average, double sample) {
+        average = average.has_value()
+                      ? average.value() * (1 - s_smoothing) +
+                            sample * s_smoothing
+                      : sample;
+    };
+
+    std::lock_guard lock(m_mutex);
+    Host& host = m_hosts[hostFromUrl(url)];
+    host.failures = 0;
+    host.retryAt = {};
+    if (bytes < s_latencySampleBytes) {
+        blend(host.latency, seconds);
+    } else {
+        // The time to the first byte isn't part of the transfer
+        const double transfer =
+            std::max(seconds - host.latency.value_or(0), seconds / 2);
+        blend(host.bytesPerSecond, bytes / transfer);
+    }
+}
+
+void HostStats::recordFailure(std::string_view url) {
+    std::lock_guard lock(m_mutex);
+    Host& host = m_hosts[hostFromUrl(url)];
+    host.failures++;
+    host.retryAt = Clock::now() + failureCooldown(host.failures);
+}
+
+HostStats::Seconds HostStats::estimateLocked(const std::string& host,
+                                             std::uint64_t bytes) {
+    double latency = s_defaultLatency;
+    double bytesPerSecond = s_defaultBytesPerSecond;
+    if (auto it = m_hosts.find(host); it != m_hosts.end()) {
+        latency = it->second.latency.value_or(latency);
+        bytesPerSecond = it->second.bytesPerSecond.value_or(bytesPerSecond);
+    }
+    return Seconds(latency + bytes / bytesPerSecond);
+}
+
+bool HostStats::healthyLocked(const std::string& host, Clock::time_point now) {
+    auto it = m_hosts.find(host);
+    return it == m_hosts.end() || it->second.retryAt <= now;
+}
+
+HostStats::Seconds HostStats::estimate(std::string_view url,
+                                       std::uint64_t bytes) {
+    std::lock_guard lock(m_mutex);
+    return this->estimateLocked(hostFromUrl(url), bytes);
+}
+
+bool HostStats::healthy(std::string_view url) {
+    std::lock_guard lock(m_mutex);
+    return this->healthyLocked(hostFromUrl(url), Clock::now());
+}
+
+std::vector<std::string> HostStats::rank(std::vector<std::string> urls,
+                                         std::uint64_t bytes) {
+    struct Ranked {
+        bool healthy;
+        Seconds estimate;
+    };
+
+    const Clock::time_point now = Clock::now();
+    std::vector<std::pair<Ranked, std::string>> ranked;
+    ranked.reserve(urls.size());
+    {
+        std::lock_guard lock(m_mutex);
+        for (std::string& url : urls) {
+            const std::string host = hostFromUrl(url);
+            ranked.emplace_back(Ranked{this->healthyLocked(host, now),
+                                       this->estimateLocked(host, bytes)},
+                                std::move(url));
+        }
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto& a, const auto& b) {
+                         if (a.first.healthy != b.first.healthy) {
+                             return a.first.healthy;
+                         }
+                         return a.first.estimate < b.first.estimate;
+                     });
+
+    urls.clear();
+    for (auto& [_, url] : ranked) {
+        urls.push_back(std::move(url));
+    }
+    return urls;
+}
+
+}  // namespace download
+
+}  // namespace jukebox
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jukebox {
+
+namespace download {
+
+/**
+ * The host part of a URL, without the scheme or path
+ */
+std::string hostFromUrl(std::string_view url);
+
+/**
+ * Latency, throughput and failures seen per host, kept for the session.
+ * Downloads with several sources start with the host expected to be the
+ * fastest, and leave hosts that keep failing alone for a while. Safe to use
+ * from any thread.
+ */
+class HostStats {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+protected:
+    struct Host {
+        // Exponential moving averages, std::nullopt until measured
+        std::optional<double> latency;
+        std::optional<double> bytesPerSecond;
+        int failures = 0;
+        // A failing host isn't picked before this
+        Clock::time_point retryAt;
+    };
+
+    // Responses smaller than this mostly measure latency
+    constexpr static inline std::uint64_t s_latencySampleBytes = 64 * 1024;
+    // Weight of a new sample in the moving averages
+    constexpr static inline double s_smoothing = 0.3;
+    // What a host that hasn't been measured is assumed to manage
+    constexpr static inline double s_defaultLatency = 0.3;
+    constexpr static inline double s_defaultBytesPerSecond = 512 * 1024;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Host> m_hosts;
+
+    HostStats() = default;
+
+    HostStats(const HostStats&) = delete;
+    HostStats(HostStats&&) = delete;
+
+    HostStats& operator=(const HostStats&) = delete;
+    HostStats& operator=(HostStats&&) = delete;
+
+    // Needs m_mutex held
+    Seconds estimateLocked(const std::string& host, std::uint64_t bytes);
+    bool healthyLocked(const std::string& host, Clock::time_point now);
+
+public:
+    /**
+     * Records a successful request of a URL
+     *
+     * @param bytes size of the response body
+     * @param elapsed time the whole request took
+     */
+    void recordSuccess(std::string_view url, std::uint64_t bytes,
+                       Seconds elapsed);
+    /**
+     * Records a failed request of a URL. Each failure in a row keeps the
+     * host out of the way for longer
+     */
+    void recordFailure(std::string_view url);
+
+    /**
+     * Expected time to fetch bytes from the host of a URL
+     */
+    Seconds estimate(std::string_view url, std::uint64_t bytes);
+
+    /**
+     * Whether the host of a URL isn't waiting out its failures
+     */
+    bool healthy(std::string_view url);
+
+    /**
+     * Orders URLs serving the same file, healthy hosts first, then by how
+     * long fetching bytes is expected to take. Hosts that are alike keep
+     * their order.
+     */
+    std::vector<std::string> rank(std::vector<std::string> urls,
+                                  std::uint64_t bytes);
+
+    static HostStats& get() {
+        static HostStats instance;
+        return instance;
+    }
+};
+
+}  // namespace download
+
+}  // namespace jukebox
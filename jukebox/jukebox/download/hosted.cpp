@@ -1,39 +1,365 @@
 #include <jukebox/download/hosted.hpp>
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include <fmt/core.h>
 #include <Geode/Result.hpp>
 #include <Geode/utils/web.hpp>
 
 #include <jukebox/download/download.hpp>
+#include <jukebox/download/host_stats.hpp>
+#include <jukebox/utils/sha256.hpp>
 
 using namespace geode::prelude;
 
+using jukebox::download::s_chunkSize;
+
+namespace {
+
+// Retries of a single chunk before the download fails
+constexpr int s_maxRetries = 5;
+// A chunk may take as long as it would at this speed, plus a base timeout
+constexpr std::uint64_t s_minBytesPerSecond = 64 * 1024;
+constexpr std::chrono::seconds s_baseTimeout{15};
+// Another source is switched to mid-download if it's expected to fetch a
+// chunk this many times faster
+constexpr double s_switchFactor = 2;
+// Whole-file refetches after a hash mismatch before the download fails
+constexpr int s_maxVerifyRetries = 2;
+
+std::string requestError(int code) {
+    if (code == 502) {
+        return "Web request failed. Service is currently unavailable or under "
+               "maintenance. Please try again later.";
+    }
+    return fmt::format("Web request failed. Status {}", code);
+}
+
+// Connection errors, timeouts and server errors are worth retrying, other
+// client errors won't go away on their own
+bool isRetryable(int code) {
+    return code <= 0 || code == 408 || code == 429 || code >= 500;
+}
+
+std::chrono::seconds chunkTimeout(std::uint64_t bytes) {
+    return s_baseTimeout + std::chrono::seconds(bytes / s_minBytesPerSecond);
+}
+
+// 1s, 2s, 4s... capped at 30s
+std::chrono::milliseconds retryDelay(int attempt) {
+    return std::chrono::milliseconds(1000) *
+           std::min(1 << std::min(attempt - 1, 5), 30);
+}
+
+// Returns false if the task got cancelled while waiting
+template <class C>
+bool waitUnlessCanceled(std::chrono::milliseconds delay, C&& hasBeenCanceled) {
+    constexpr std::chrono::milliseconds step{100};
+    for (std::chrono::milliseconds waited{0}; waited < delay; waited += step) {
+        if (hasBeenCanceled()) {
+            return false;
+        }
+        std::this_thread::sleep_for(step);
+    }
+    return !hasBeenCanceled();
+}
+
+// Feeds the first bytes of a file to the hasher
+bool hashPrefix(jukebox::Sha256& hasher, const std::filesystem::path& path,
+                std::uint64_t bytes) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<std::uint8_t> buffer(64 * 1024);
+    while (bytes > 0 && in) {
+        const std::uint64_t want =
+            std::min<std::uint64_t>(bytes, buffer.size());
+        in.read(reinterpret_cast<char*>(buffer.data()),
+                static_cast<std::streamsize>(want));
+        const std::uint64_t got = static_cast<std::uint64_t>(in.gcount());
+        hasher.update(std::span(buffer.data(), got));
+        bytes -= got;
+    }
+    return bytes == 0;
+}
+
+// Total size from a "bytes <start>-<end>/<total>" or "bytes */<total>"
+// Content-Range header
+std::optional<std::uint64_t> rangeTotal(
+    const std::optional<std::string>& header) {
+    if (!header.has_value()) {
+        return std::nullopt;
+    }
+    std::string_view value = header.value();
+    std::size_t slash = value.rfind('/');
+    if (slash == std::string_view::npos) {
+        return std::nullopt;
+    }
+    std::uint64_t total = 0;
+    auto res =
+        std::from_chars(value.data() + slash + 1, value.data() + value.size(),
+                        total);
+    if (res.ec != std::errc()) {
+        return std::nullopt;
+    }
+    return total;
+}
+
+}  // namespace
+
 namespace jukebox {
 
 namespace download {
 
-DownloadTask startHostedDownload(const std::string& url) {
-    return web::WebRequest()
-        .timeout(std::chrono::seconds(30))
-        .get(url)
-        .map(
-            [](web::WebResponse* response) -> DownloadTask::Value {
-                if (!response->ok()) {
-                    if (response->code() == 502) {
-                        return Err(
-                            "Web request failed. Service is currently "
-                            "unavailable or under maintenance. Please try "
-                            "again later.");
-                    } else {
-                        return Err(fmt::format("Web request failed. Status {}",
-                                               response->code()));
+DownloadTask startHostedDownload(const std::string& url,
+                                 const std::filesystem::path& destination) {
+    return startHostedDownload(std::vector<std::string>{url}, destination);
+}
+
+DownloadTask startHostedDownload(std::vector<std::string> urls,
+                                 const std::filesystem::path& destination,
+                                 std::optional<std::string> sha256) {
+    std::string name = urls.empty() ? std::string() : urls.front();
+    return DownloadTask::run(
+        [urls = std::move(urls), destination, sha256 = std::move(sha256)](
+            auto progress, auto hasBeenCanceled) -> DownloadTask::Result {
+            if (urls.empty()) {
+                return Err("No URL to download from");
+            }
+
+            HostStats& stats = HostStats::get();
+            std::vector<std::string> sources = stats.rank(urls, s_chunkSize);
+            std::size_t current = 0;
+
+            std::filesystem::path part = destination;
+            part += ".part";
+
+            // Pick up where an earlier attempt left off
+            std::uint64_t received = 0;
+            std::error_code ec;
+            if (std::filesystem::exists(part, ec)) {
+                received = std::filesystem::file_size(part, ec);
+                if (ec) {
+                    received = 0;
+                }
+            }
+
+            // The bytes resumed from the .part file are hashed first
+            Sha256 hasher;
+            if (sha256.has_value() && received > 0 &&
+                !hashPrefix(hasher, part, received)) {
+                received = 0;
+                hasher = Sha256();
+            }
+
+            std::ofstream out(part, std::ios::binary | (received > 0
+                                                            ? std::ios::app
+                                                            : std::ios::trunc));
+            if (!out.is_open()) {
+                return Err("Couldn't open {} for writing",
+                           part.filename().string());
+            }
+
+            auto discard = [&out, &part]() {
+                out.close();
+                std::error_code ec;
+                std::filesystem::remove(part, ec);
+            };
+            auto restart = [&out, &part, &received, &hasher]() {
+                out.close();
+                out.open(part, std::ios::binary | std::ios::trunc);
+                received = 0;
+                hasher = Sha256();
+            };
+
+            std::optional<std::uint64_t> total;
+            int attempt = 0;
+            int verifyAttempt = 0;
+            // Failed requests in a row, across every source
+            std::size_t failures = 0;
+
+            auto percent = [&]() {
+                return total.has_value() && total.value() > 0
+                           ? 100.f * received / total.value()
+                           : 0.f;
+            };
+
+            while (true) {
+                while (!total.has_value() || received < total.value()) {
+                    if (hasBeenCanceled()) {
+                        discard();
+                        return DownloadTask::Cancel();
+                    }
+
+                    const std::string url = sources[current];
+                    const HostStats::Clock::time_point started =
+                        HostStats::Clock::now();
+                    web::WebResponse response =
+                        web::WebRequest()
+                            .timeout(chunkTimeout(s_chunkSize))
+                            .header("Range",
+                                    fmt::format("bytes={}-{}", received,
+                                                received + s_chunkSize - 1))
+                            .getSync(url);
+                    const HostStats::Seconds elapsed =
+                        HostStats::Clock::now() - started;
+
+                    // Resumed a .part file that already holds the whole song
+                    if (response.code() == 416 && received > 0) {
+                        if (rangeTotal(response.header("Content-Range")) ==
+                            received) {
+                            break;
+                        }
+                        restart();
+                        continue;
+                    }
+
+                    if (!response.ok()) {
+                        stats.recordFailure(url);
+                        if (!isRetryable(response.code())) {
+                            // Other sources may still have the file
+                            sources.erase(sources.begin() + current);
+                            if (sources.empty()) {
+                                discard();
+                                return Err(requestError(response.code()));
+                            }
+                            current %= sources.size();
+                            continue;
+                        }
+
+                        // The next source picks up from the same byte, the
+                        // backoff only starts once every source failed in a row
+                        failures++;
+                        current = (current + 1) % sources.size();
+                        if (failures % sources.size() != 0) {
+                            continue;
+                        }
+                        if (attempt >= s_maxRetries) {
+                            // The .part file stays, the next attempt resumes it
+                            out.close();
+                            return Err("{} after {} retries",
+                                       requestError(response.code()), attempt);
+                        }
+
+                        attempt++;
+                        progress(DownloadProgress{percent(), attempt});
+                        if (!waitUnlessCanceled(retryDelay(attempt),
+                                                hasBeenCanceled)) {
+                            discard();
+                            return DownloadTask::Cancel();
+                        }
+                        continue;
+                    }
+
+                    const ByteVector& data = response.data();
+                    stats.recordSuccess(url, data.size(), elapsed);
+                    failures = 0;
+                    if (attempt > 0) {
+                        attempt = 0;
+                        progress(DownloadProgress{percent(), 0});
+                    }
+
+                    // The server ignored the range, the body is the whole file
+                    if (response.code() != 206 && received > 0) {
+                        restart();
+                    }
+
+                    // A source with another size serves another file, so what
+                    // came from the previous one can't be resumed
+                    const std::optional<std::uint64_t> sourceTotal =
+                        rangeTotal(response.header("Content-Range"));
+                    if (response.code() == 206 && received > 0 &&
+                        total.has_value() && sourceTotal.has_value() &&
+                        sourceTotal != total) {
+                        restart();
+                        total.reset();
+                        continue;
+                    }
+
+                    out.write(reinterpret_cast<const char*>(data.data()),
+                              data.size());
+                    if (!out) {
+                        discard();
+                        return Err("Couldn't write to {}",
+                                   part.filename().string());
+                    }
+                    received += data.size();
+                    hasher.update(data);
+
+                    if (response.code() != 206) {
+                        break;
+                    }
+
+                    total = sourceTotal;
+                    if (!total.has_value() && data.size() < s_chunkSize) {
+                        break;
+                    }
+                    progress(DownloadProgress{percent(), 0});
+
+                    // Moves to a source that is expected to be much faster,
+                    // resuming from the same byte
+                    if (sources.size() > 1) {
+                        std::vector<std::string> ranked =
+                            stats.rank(sources, s_chunkSize);
+                        if (ranked.front() != url &&
+                            stats.estimate(ranked.front(), s_chunkSize) *
+                                    s_switchFactor <
+                                stats.estimate(url, s_chunkSize)) {
+                            sources = std::move(ranked);
+                            current = 0;
+                        }
                     }
                 }
-                return Ok(std::move(response->data()));
-            },
-            [](web::WebProgress* progress) {
-                return progress->downloadProgress().value_or(0);
-            });
+
+                if (!sha256.has_value() || received == 0) {
+                    break;
+                }
+                // Checked as the bytes came in, there is no second pass
+                const std::string digest = Sha256::toHex(hasher.finish());
+                if (digest == sha256.value()) {
+                    break;
+                }
+
+                // The whole file is fetched again, from the next source
+                stats.recordFailure(sources[current]);
+                if (verifyAttempt >= s_maxVerifyRetries) {
+                    discard();
+                    return Err("Downloaded file doesn't match its hash");
+                }
+                verifyAttempt++;
+                current = (current + 1) % sources.size();
+                restart();
+                total.reset();
+                progress(DownloadProgress{0.f, verifyAttempt});
+            }
+
+            out.close();
+            if (received == 0) {
+                discard();
+                return Err("Downloaded file is empty");
+            }
+
+            std::filesystem::rename(part, destination, ec);
+            if (ec) {
+                discard();
+                return Err("Couldn't move download to {}: {}",
+                           destination.filename().string(), ec.message());
+            }
+
+            return Ok(destination);
+        },
+        fmt::format("Downloading {}", name));
 }
 
 }  // namespace download
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <filesystem>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <jukebox/download/download.hpp>
 
@@ -8,7 +12,38 @@ namespace jukebox {
 
 namespace download {
 
-DownloadTask startHostedDownload(const std::string& url);
+// Bytes requested per range request, and so the most held in memory at once
+constexpr inline std::uint64_t s_chunkSize = 4 * 1024 * 1024;
+
+/**
+ * Downloads a file in chunks, streaming them to a .part file next to the
+ * destination. The .part file is renamed to the destination once the whole
+ * file is on disk, so a failed download never leaves a truncated song behind.
+ * Failed chunks are retried with exponential backoff, and a .part file left
+ * by an earlier attempt is resumed instead of downloaded again.
+ *
+ * @param url the URL to download
+ * @param destination where to store the file
+ */
+DownloadTask startHostedDownload(const std::string& url,
+                                 const std::filesystem::path& destination);
+
+/**
+ * Same as the above, from several URLs serving the same file. Starts with
+ * the one expected to be the fastest according to HostStats, moves on to the
+ * next one when a request fails, and switches to a much faster one between
+ * chunks. Each picks up from the byte the previous one stopped at.
+ *
+ * With a hash given, the file is hashed as it's written, and a file that
+ * doesn't match is fetched again from the next source instead of being kept.
+ *
+ * @param urls the URLs to download, in order of preference
+ * @param destination where to store the file
+ * @param sha256 lowercase hex SHA-256 of the file, if known
+ */
+DownloadTask startHostedDownload(
+    std::vector<std::string> urls, const std::filesystem::path& destination,
+    std::optional<std::string> sha256 = std::nullopt);
 
 }
 
@@ -0,0 +1,410 @@
+#include <jukebox/download/optimize.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmod.hpp>
+#include <fmod_common.h>
+#include <fmt/core.h>
+#include <fmt/std.h>
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/utils/Task.hpp>
+
+#include <jukebox/managers/file_status_cache.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/executor.hpp>
+#include <jukebox/utils/flac_encoder.hpp>
+#include <jukebox/utils/mapped_file.hpp>
+#include <jukebox/utils/mp3_frames.hpp>
+#include <jukebox/utils/profiler.hpp>
+
+using namespace geode::prelude;
+
+namespace {
+
+using Bytes = std::span<const std::uint8_t>;
+
+constexpr unsigned int s_readChunk = 64 * 1024;
+
+struct PcmWav {
+    std::uint32_t sampleRate;
+    std::size_t channels;
+    std::uint32_t bitsPerSample;
+    Bytes samples;
+};
+
+// What to do with a downloaded file
+struct Plan {
+    std::string extension;
+    // New contents, std::nullopt to only rename the file
+    std::optional<std::vector<std::uint8_t>> contents;
+};
+
+std::uint16_t le16(const std::uint8_t* p) {
+    return static_cast<std::uint16_t>(p[1] << 8 | p[0]);
+}
+
+std::uint32_t le32(const std::uint8_t* p) {
+    return std::uint32_t(p[3]) << 24 | std::uint32_t(p[2]) << 16 |
+           std::uint32_t(p[1]) << 8 | p[0];
+}
+
+bool startsWith(Bytes data, std::size_t at, std::string_view magic) {
+    return data.size() >= at + magic.size() &&
+           std::memcmp(data.data() + at, magic.data(), magic.size()) == 0;
+}
+
+/**
+ * Finds the samples of an integer PCM WAV, the only kind FLAC can hold
+ */
+std::optional<PcmWav> parsePcmWav(Bytes data) {
+    std::optional<std::uint16_t> format;
+    std::uint16_t channels = 0;
+    std::uint32_t sampleRate = 0;
+    std::uint16_t blockAlign = 0;
+    std::uint16_t bitsPerSample = 0;
+
+    std::uint64_t at = 12;
+    while (at + 8 <= data.size()) {
+        const std::uint8_t* chunk = data.data() + at;
+        const std::uint64_t size = le32(chunk + 4);
+        const std::uint64_t body = at + 8;
+        // Files that were streamed out leave the data size unset
+        const std::size_t available = static_cast<std::size_t>(
+            std::min<std::uint64_t>(size, data.size() - body));
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = le16(chunk + 8);
+            channels = le16(chunk + 10);
+            sampleRate = le32(chunk + 12);
+            blockAlign = le16(chunk + 20);
+            bitsPerSample = le16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE, the format is the start of the
+            // SubFormat GUID
+            if (*format == 0xfffe && available >= 40) {
+                format = le16(chunk + 8 + 24);
+            }
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!format || *format != 1 || channels == 0 || channels > 8 ||
+                (bitsPerSample != 8 && bitsPerSample != 16 &&
+                 bitsPerSample != 24) ||
+                blockAlign != channels * bitsPerSample / 8 ||
+                sampleRate == 0 || sampleRate >= 1 << 20 ||
+                available < blockAlign) {
+                return std::nullopt;
+            }
+            return PcmWav{
+                .sampleRate = sampleRate,
+                .channels = channels,
+                .bitsPerSample = bitsPerSample,
+                .samples = data.subspan(static_cast<std::size_t>(body),
+                                        available - available % blockAlign)};
+        }
+
+        // Chunks are padded to an even size
+        at = body + size + (size & 1);
+    }
+
+    return std::nullopt;
+}
+
+struct SoundRelease {
+    void operator()(FMOD::Sound* sound) const { sound->release(); }
+};
+
+using SoundPtr = std::unique_ptr<FMOD::Sound, SoundRelease>;
+
+// Non-realtime and separate from GD's, FMOD's API can be used from any
+// thread
+FMOD::System* checkSystem() {
+    static FMOD::System* system = []() -> FMOD::System* {
+        FMOD::System* system = nullptr;
+        if (FMOD::System_Create(&system) != FMOD_OK ||
+            system->setOutput(FMOD_OUTPUTTYPE_NOSOUND_NRT) != FMOD_OK ||
+            system->init(1, FMOD_INIT_NORMAL, nullptr) != FMOD_OK) {
+            log::error("Couldn't create the FMOD system to check optimized "
+                       "downloads");
+            if (system) {
+                system->release();
+            }
+            return nullptr;
+        }
+        return system;
+    }();
+    return system;
+}
+
+// data has to outlive the sound, FMOD reads it in place
+SoundPtr openSound(FMOD::System* system, Bytes data) {
+    FMOD_CREATESOUNDEXINFO info{};
+    info.cbsize = sizeof(info);
+    info.length = static_cast<unsigned int>(data.size());
+    FMOD::Sound* raw = nullptr;
+    if (system->createSound(reinterpret_cast<const char*>(data.data()),
+                            FMOD_OPENMEMORY_POINT | FMOD_OPENONLY |
+                                FMOD_ACCURATETIME,
+                            &info, &raw) != FMOD_OK) {
+        return nullptr;
+    }
+    return SoundPtr(raw);
+}
+
+/**
+ * Decodes the downloaded file and what would replace it side by side
+ *
+ * @param exact whether the samples have to match, not only how many there
+ * are
+ * @return whether both decode to the same format and length
+ */
+bool decodesTheSame(Bytes original, Bytes optimized, bool exact,
+                    const std::function<bool()>& hasBeenCanceled) {
+    FMOD::System* system = checkSystem();
+    if (!system) {
+        return false;
+    }
+    SoundPtr sounds[] = {openSound(system, original),
+                         openSound(system, optimized)};
+    if (!sounds[0] || !sounds[1]) {
+        return false;
+    }
+
+    struct Format {
+        FMOD_SOUND_FORMAT format;
+        int channels = 0;
+        int bits = 0;
+        float frequency = 0;
+    };
+    Format formats[2];
+    for (std::size_t i = 0; i < 2; i++) {
+        Format& f = formats[i];
+        if (sounds[i]->getFormat(nullptr, &f.format, &f.channels, &f.bits) !=
+                FMOD_OK ||
+            sounds[i]->getDefaults(&f.frequency, nullptr) != FMOD_OK) {
+            return false;
+        }
+    }
+    if (formats[0].format != formats[1].format ||
+        formats[0].channels != formats[1].channels ||
+        formats[0].bits != formats[1].bits ||
+        formats[0].frequency != formats[1].frequency) {
+        return false;
+    }
+
+    std::vector<std::uint8_t> chunks[2] = {
+        std::vector<std::uint8_t>(s_readChunk),
+        std::vector<std::uint8_t>(s_readChunk)};
+    while (true) {
+        if (hasBeenCanceled()) {
+            return false;
+        }
+        unsigned int read[2] = {0, 0};
+        for (std::size_t i = 0; i < 2; i++) {
+            const FMOD_RESULT result =
+                sounds[i]->readData(chunks[i].data(), s_readChunk, &read[i]);
+            if (result != FMOD_OK && result != FMOD_ERR_FILE_EOF) {
+                return false;
+            }
+        }
+        // Short reads only happen at the end
+        if (read[0] != read[1] ||
+            (exact && std::memcmp(chunks[0].data(), chunks[1].data(),
+                                  read[0]) != 0)) {
+            return false;
+        }
+        if (read[0] < s_readChunk) {
+            return true;
+        }
+    }
+}
+
+std::optional<std::vector<std::uint8_t>> encodeFlac(
+    const PcmWav& wav, const std::function<bool()>& hasBeenCanceled) {
+    jukebox::FlacEncoder encoder(wav.sampleRate, wav.channels,
+                                 wav.bitsPerSample);
+    const std::size_t bytesPerSample = wav.bitsPerSample / 8;
+    const std::size_t frameBytes = bytesPerSample * wav.channels;
+    const std::size_t frames = wav.samples.size() / frameBytes;
+
+    std::vector<std::int32_t> block(jukebox::FlacEncoder::s_blockSize *
+                                    wav.channels);
+    for (std::size_t frame = 0; frame < frames;) {
+        if (hasBeenCanceled()) {
+            return std::nullopt;
+        }
+        const std::size_t count =
+            std::min(jukebox::FlacEncoder::s_blockSize, frames - frame);
+        const std::uint8_t* p = wav.samples.data() + frame * frameBytes;
+        for (std::size_t i = 0; i < count * wav.channels; i++) {
+            switch (bytesPerSample) {
+                case 1:
+                    // 8 bit WAVs are unsigned
+                    block[i] = std::int32_t(p[i]) - 128;
+                    break;
+                case 2:
+                    block[i] = static_cast<std::int16_t>(le16(p + i * 2));
+                    break;
+                default: {
+                    const std::uint8_t* s = p + i * 3;
+                    block[i] = static_cast<std::int32_t>(
+                                   std::uint32_t(s[0]) << 8 |
+                                   std::uint32_t(s[1]) << 16 |
+                                   std::uint32_t(s[2]) << 24) >>
+                               8;
+                    break;
+                }
+            }
+        }
+        encoder.addFrames(block.data(), count);
+        frame += count;
+    }
+
+    return encoder.finish();
+}
+
+Result<Plan> planOptimization(const std::filesystem::path& path,
+                              bool transcode,
+                              const std::function<bool()>& hasBeenCanceled) {
+    GEODE_UNWRAP_INTO(jukebox::MappedFile file,
+                      jukebox::MappedFile::open(path));
+    const Bytes data = file.bytes();
+
+    if (startsWith(data, 0, "fLaC")) {
+        return Ok(Plan{.extension = ".flac"});
+    }
+    if (startsWith(data, 0, "OggS")) {
+        return Ok(Plan{.extension = ".ogg"});
+    }
+    if (startsWith(data, 0, "RIFF") && startsWith(data, 8, "WAVE")) {
+        if (!transcode) {
+            return Ok(Plan{.extension = ".wav"});
+        }
+        std::optional<PcmWav> wav = parsePcmWav(data);
+        if (!wav) {
+            return Ok(Plan{.extension = ".wav"});
+        }
+        std::optional<std::vector<std::uint8_t>> flac =
+            encodeFlac(*wav, hasBeenCanceled);
+        if (!flac) {
+            return Ok(Plan{.extension = ".wav"});
+        }
+        // Lossless, so every sample has to come back as it was
+        if (!decodesTheSame(data, *flac, true, hasBeenCanceled)) {
+            log::warn("FLAC copy of {} doesn't decode like the WAV, keeping "
+                      "the WAV",
+                      path.filename());
+            return Ok(Plan{.extension = ".wav"});
+        }
+        return Ok(Plan{.extension = ".flac", .contents = std::move(flac)});
+    }
+
+    std::optional<jukebox::Mp3Stream> mp3 = jukebox::scanMp3(data);
+    if (!mp3) {
+        // Leave it be, FMOD knows more formats than this does
+        return Ok(Plan{.extension = path.extension().string()});
+    }
+    if (!transcode || mp3->constantBitrate || mp3->hasSeekHeader) {
+        return Ok(Plan{.extension = ".mp3"});
+    }
+    std::optional<std::vector<std::uint8_t>> xing =
+        jukebox::buildXingFrame(*mp3);
+    if (!xing) {
+        return Ok(Plan{.extension = ".mp3"});
+    }
+
+    // Tags first, the Xing frame has to be the first frame
+    const std::size_t audioStart =
+        static_cast<std::size_t>(mp3->frames.front());
+    std::vector<std::uint8_t> contents;
+    contents.reserve(data.size() + xing->size());
+    contents.insert(contents.end(), data.begin(), data.begin() + audioStart);
+    contents.insert(contents.end(), xing->begin(), xing->end());
+    contents.insert(contents.end(), data.begin() + audioStart, data.end());
+
+    // The same frames behind the new header, decoding to as many samples.
+    // Decoders may round differently, so the samples aren't compared.
+    std::optional<jukebox::Mp3Stream> rewritten =
+        jukebox::scanMp3(contents);
+    if (!rewritten || !rewritten->hasSeekHeader ||
+        rewritten->frames.size() != mp3->frames.size() ||
+        !decodesTheSame(data, contents, false, hasBeenCanceled)) {
+        log::warn("Seek table for {} doesn't check out, keeping the MP3 as "
+                  "it was",
+                  path.filename());
+        return Ok(Plan{.extension = ".mp3"});
+    }
+    return Ok(Plan{.extension = ".mp3", .contents = std::move(contents)});
+}
+
+// The file has to be unmapped by now, Windows can't replace a mapped file
+Result<std::filesystem::path> applyOptimization(
+    const std::filesystem::path& path, Plan&& plan) {
+    std::filesystem::path destination = path;
+    destination.replace_extension(plan.extension);
+
+    if (plan.contents) {
+        GEODE_UNWRAP(jukebox::write_file_atomic(destination, *plan.contents));
+        if (destination != path) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            FileStatusCache::get().invalidate(path);
+        }
+        return Ok(destination);
+    }
+
+    if (destination != path) {
+        std::error_code ec;
+        std::filesystem::rename(path, destination, ec);
+        if (ec) {
+            return Err("Couldn't rename {} to {}: {}", path.filename(),
+                       destination.filename(), ec.message());
+        }
+        FileStatusCache::get().invalidate(path);
+    }
+    return Ok(destination);
+}
+
+}  // namespace
+
+namespace jukebox {
+
+namespace download {
+
+OptimizeTask optimizeDownload(std::filesystem::path path, bool transcode) {
+    std::string name = fmt::format("Optimizing {}", path.filename());
+    return Executor::get().run<OptimizeTask>(
+        Executor::Priority::Bulk,
+        [path = std::move(path), transcode](
+            auto progress, auto hasBeenCanceled) -> OptimizeTask::Result {
+            ProfileScope profile("download::optimizeDownload");
+            Result<Plan> plan =
+                planOptimization(path, transcode, [&hasBeenCanceled]() {
+                    return hasBeenCanceled();
+                });
+            // Nothing was touched yet, so a cancelled download can be
+            // thrown away as it is
+            if (hasBeenCanceled()) {
+                return OptimizeTask::Cancel();
+            }
+            if (plan.isErr()) {
+                return Err(plan.unwrapErr());
+            }
+            return applyOptimization(path, std::move(plan.unwrap()));
+        },
+        std::move(name));
+}
+
+}
+
+}  // namespace jukebox
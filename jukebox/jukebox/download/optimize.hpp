@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <string_view>
+
+#include <Geode/Result.hpp>
+#include <Geode/utils/Task.hpp>
+
+namespace jukebox {
+
+namespace download {
+
+// Every extension optimizeDownload may rename a song to
+constexpr inline std::array<std::string_view, 4> s_optimizedExtensions = {
+    ".mp3", ".flac", ".ogg", ".wav"};
+
+// Resolves to where the song ended up, its extension may have changed
+using OptimizeTask = geode::Task<geode::Result<std::filesystem::path>>;
+
+/**
+ * Post-download stage, run on a worker thread. Servers return whatever they
+ * host under a .mp3 name, so the file is renamed to the extension of its
+ * actual format first. With transcode set, PCM WAVs are also converted to
+ * FLAC, which is lossless, about half the size and has a seek table, and VBR
+ * MP3s without a seek table get a Xing frame, so seeking them is fast and
+ * accurate. The new file replaces the download only if FMOD decodes both
+ * to the same format and length, and for FLAC to the same samples. Files
+ * are only ever replaced by renaming a new file over them.
+ *
+ * @param path the downloaded file
+ * @param transcode whether to rewrite WAVs and VBR MP3s
+ */
+OptimizeTask optimizeDownload(std::filesystem::path path, bool transcode);
+
+}
+
+}  // namespace jukebox
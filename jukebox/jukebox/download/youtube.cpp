@@ -1,9 +1,16 @@
 #include <jukebox/download/youtube.hpp>
 
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
 #include <matjson.hpp>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 
 #include <Geode/Result.hpp>
+#include <Geode/utils/Task.hpp>
 #include <Geode/utils/web.hpp>
 
 #include <jukebox/download/download.hpp>
@@ -11,21 +18,129 @@
 
 using namespace geode::prelude;
 
-web::WebTask getMetadata(const std::string& id);
+web::WebRequest getMetadata(const std::string& id);
 Result<std::string> getUrlFromMetadataPayload(web::WebResponse* resp);
-jukebox::download::DownloadTask onMetadata(web::WebResponse*);
+
+namespace {
+
+using StreamTask = Task<Result<std::string>>;
+
+/**
+ * Stream URLs cobalt resolved videos to. A video is only asked for once at a
+ * time, a second caller waits for the first one's answer.
+ */
+class StreamCache {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // cobalt's tunnels live for 90 seconds by default, a URL is kept for
+    // less than that so a download doesn't start on one that is about to
+    // expire
+    constexpr static inline std::chrono::seconds s_ttl{60};
+
+    struct Entry {
+        std::optional<std::string> url;
+        Clock::time_point expiresAt;
+        bool resolving = false;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_resolved;
+    std::unordered_map<std::string, Entry> m_entries;
+
+public:
+    /**
+     * Blocks until the stream URL of a video is known, asking cobalt unless
+     * it's cached or already being asked for
+     */
+    template <class C>
+    Result<std::string> resolve(const std::string& id, C&& hasBeenCanceled) {
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            auto it = m_entries.find(id);
+            if (it == m_entries.end()) {
+                break;
+            }
+            if (it->second.url.has_value() &&
+                Clock::now() < it->second.expiresAt) {
+                return Ok(it->second.url.value());
+            }
+            if (!it->second.resolving) {
+                break;
+            }
+            m_resolved.wait_for(lock, std::chrono::milliseconds(100));
+            if (hasBeenCanceled()) {
+                return Err("Cancelled");
+            }
+        }
+        m_entries[id] = Entry{.resolving = true};
+        lock.unlock();
+
+        web::WebResponse response = getMetadata(id).postSync(
+            "https://dl.hep.gg/api/json");
+        Result<std::string> res = getUrlFromMetadataPayload(&response);
+
+        lock.lock();
+        if (res.isOk()) {
+            m_entries[id] = Entry{.url = res.unwrap(),
+                                  .expiresAt = Clock::now() + s_ttl};
+        } else {
+            m_entries.erase(id);
+        }
+        m_resolved.notify_all();
+        return res;
+    }
+
+    /**
+     * Forgets the stream URL of a video, e.g. after its download failed
+     */
+    void invalidate(const std::string& id) {
+        std::lock_guard lock(m_mutex);
+        if (auto it = m_entries.find(id);
+            it != m_entries.end() && !it->second.resolving) {
+            m_entries.erase(it);
+        }
+    }
+
+    static StreamCache& get() {
+        static StreamCache instance;
+        return instance;
+    }
+};
+
+}  // namespace
 
 namespace jukebox {
 
 namespace download {
 
-DownloadTask startYoutubeDownload(const std::string& id) {
+DownloadTask startYoutubeDownload(const std::string& id,
+                                  const std::filesystem::path& destination) {
     if (id.length() != 11) {
         return DownloadTask::immediate(Err("Invalid YouTube ID"));
     }
 
-    return getMetadata(id).chain(
-        [](web::WebResponse* r) { return onMetadata(r); });
+    return StreamTask::run(
+               [id](auto, auto hasBeenCanceled) -> StreamTask::Result {
+                   return StreamCache::get().resolve(id, hasBeenCanceled);
+               },
+               fmt::format("Resolving YouTube video {}", id))
+        .chain([id, destination](Result<std::string>* r) -> DownloadTask {
+            if (r->isErr()) {
+                return DownloadTask::immediate(Err(r->unwrapErr()));
+            }
+            return startHostedDownload(r->unwrap(), destination)
+                .map(
+                    [id](Result<std::filesystem::path>* res) {
+                        // The URL may have expired, the next attempt asks
+                        // for a new one
+                        if (res->isErr()) {
+                            StreamCache::get().invalidate(id);
+                        }
+                        return std::move(*res);
+                    },
+                    [](DownloadProgress* p) { return *p; });
+        });
 }
 
 }  // namespace download
@@ -56,24 +171,15 @@ Result<std::string> getUrlFromMetadataPayload(web::WebResponse* r) {
     return Ok(payload["url"].asString().unwrap());
 }
 
-web::WebTask getMetadata(const std::string& id) {
-    return web::WebRequest()
-        .timeout(std::chrono::seconds(30))
+web::WebRequest getMetadata(const std::string& id) {
+    web::WebRequest request;
+    request.timeout(std::chrono::seconds(30))
         .bodyJSON(matjson::makeObject(
             {{"url", fmt::format("https://www.youtube.com/watch?v={}", id)},
              {"audioBitrate", "320"},
              {"downloadMode", "audio"},
              {"alwaysProxy", "true"}}))
         .header("Accept", "application/json")
-        .header("Content-Type", "application/json")
-        .post("https://dl.hep.gg/api/json");
-}
-
-jukebox::download::DownloadTask onMetadata(web::WebResponse* result) {
-    Result<std::string> res = getUrlFromMetadataPayload(result);
-    if (res.isErr()) {
-        return jukebox::download::DownloadTask::immediate(Err(res.unwrapErr()));
-    }
-
-    return jukebox::download::startHostedDownload(res.unwrap());
+        .header("Content-Type", "application/json");
+    return request;
 }
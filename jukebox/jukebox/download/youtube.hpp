@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <string>
 
 #include <jukebox/download/download.hpp>
@@ -8,7 +9,13 @@ namespace jukebox {
 
 namespace download {
 
-DownloadTask startYoutubeDownload(const std::string& id);
+/**
+ * Downloads the audio of a YouTube video through cobalt. The stream URL the
+ * video resolves to is cached for a minute, so retries and redownloads
+ * don't ask cobalt again.
+ */
+DownloadTask startYoutubeDownload(const std::string& id,
+                                  const std::filesystem::path& destination);
 
 }
 
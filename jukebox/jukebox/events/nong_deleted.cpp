@@ -4,10 +4,10 @@ namespace jukebox {
 
 namespace event {
 
-NongDeleted::NongDeleted(const std::string& uniqueId, int gdId)
+NongDeleted::NongDeleted(UniqueID uniqueId, int gdId)
     : m_uniqueId(uniqueId), m_gdId(gdId) {}
 
-std::string NongDeleted::uniqueId() const { return m_uniqueId; }
+UniqueID NongDeleted::uniqueId() const { return m_uniqueId; }
 int NongDeleted::gdId() const { return m_gdId; }
 
 }  // namespace event
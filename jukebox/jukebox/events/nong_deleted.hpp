@@ -3,6 +3,7 @@
 #include <Geode/loader/Event.hpp>
 
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
@@ -10,15 +11,15 @@ namespace event {
 
 class NongDeleted : public geode::Event {
 protected:
-    std::string m_uniqueId;
+    UniqueID m_uniqueId;
     int m_gdId;
 
     friend class ::jukebox::Nongs;
 
-    NongDeleted(const std::string& uniqueId, int gdId);
+    NongDeleted(UniqueID uniqueId, int gdId);
 
 public:
-    std::string uniqueId() const;
+    UniqueID uniqueId() const;
     int gdId() const;
 };
 
@@ -0,0 +1,20 @@
+#include <jukebox/events/nongs_cleared.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace jukebox {
+
+namespace event {
+
+NongsCleared::NongsCleared(std::vector<UniqueID> uniqueIds, int gdId)
+    : m_uniqueIds(std::move(uniqueIds)), m_gdId(gdId) {}
+
+const std::vector<UniqueID>& NongsCleared::uniqueIds() const {
+    return m_uniqueIds;
+}
+int NongsCleared::gdId() const { return m_gdId; }
+
+}  // namespace event
+
+}  // namespace jukebox
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <Geode/loader/Event.hpp>
+
+#include <jukebox/utils/unique_id.hpp>
+
+namespace jukebox {
+
+namespace event {
+
+/**
+ * Every song but the default one was deleted from the NONGs of a GD song.
+ * Posted once for the whole song ID instead of a NongDeleted per song.
+ */
+class NongsCleared final : public geode::Event {
+protected:
+    std::vector<UniqueID> m_uniqueIds;
+    int m_gdId;
+
+public:
+    NongsCleared(std::vector<UniqueID> uniqueIds, int gdId);
+
+    const std::vector<UniqueID>& uniqueIds() const;
+    int gdId() const;
+};
+
+}  // namespace event
+
+}  // namespace jukebox
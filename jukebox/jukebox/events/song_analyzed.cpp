@@ -0,0 +1,17 @@
+#include <jukebox/events/song_analyzed.hpp>
+
+#include <filesystem>
+#include <utility>
+
+namespace jukebox {
+
+namespace event {
+
+SongAnalyzed::SongAnalyzed(std::filesystem::path path)
+    : m_path(std::move(path)) {}
+
+const std::filesystem::path& SongAnalyzed::path() const { return m_path; }
+
+}  // namespace event
+
+}  // namespace jukebox
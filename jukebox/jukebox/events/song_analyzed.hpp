@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+
+#include <Geode/loader/Event.hpp>
+
+namespace jukebox {
+
+class AnalysisManager;
+
+namespace event {
+
+/**
+ * Posted on the main thread once a song file has been analyzed, whether it
+ * was decoded or its contents matched a cached analysis
+ */
+class SongAnalyzed final : public geode::Event {
+protected:
+    friend class ::jukebox::AnalysisManager;
+
+    std::filesystem::path m_path;
+
+    SongAnalyzed(std::filesystem::path path);
+
+public:
+    const std::filesystem::path& path() const;
+};
+
+}  // namespace event
+
+}  // namespace jukebox
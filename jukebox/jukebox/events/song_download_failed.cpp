@@ -4,11 +4,11 @@ namespace jukebox {
 
 namespace event {
 
-SongDownloadFailed::SongDownloadFailed(int gdSongId, std::string uniqueId,
+SongDownloadFailed::SongDownloadFailed(int gdSongId, UniqueID uniqueId,
                                        std::string error)
     : m_gdSongId(gdSongId), m_uniqueId(uniqueId), m_error(error) {}
 int SongDownloadFailed::gdSongId() const { return m_gdSongId; }
-std::string SongDownloadFailed::uniqueId() const { return m_uniqueId; }
+UniqueID SongDownloadFailed::uniqueId() const { return m_uniqueId; }
 std::string SongDownloadFailed::error() const { return m_error; }
 
 }  // namespace event
@@ -4,6 +4,8 @@
 
 #include <Geode/loader/Event.hpp>
 
+#include <jukebox/utils/unique_id.hpp>
+
 namespace jukebox {
 
 namespace event {
@@ -11,13 +13,13 @@ namespace event {
 class SongDownloadFailed final : public geode::Event {
 private:
     int m_gdSongId;
-    std::string m_uniqueId;
+    UniqueID m_uniqueId;
     std::string m_error;
 
 public:
-    SongDownloadFailed(int gdSongId, std::string uniqueId, std::string error);
+    SongDownloadFailed(int gdSongId, UniqueID uniqueId, std::string error);
     int gdSongId() const;
-    std::string uniqueId() const;
+    UniqueID uniqueId() const;
     std::string error() const;
 };
 
@@ -4,13 +4,17 @@ namespace jukebox {
 
 namespace event {
 
-SongDownloadProgress::SongDownloadProgress(int gdSongID, std::string m_uniqueID,
-                                           float progress)
-    : m_gdSongID(gdSongID), m_uniqueID(m_uniqueID), m_progress(progress) {};
+SongDownloadProgress::SongDownloadProgress(int gdSongID, UniqueID uniqueID,
+                                           float progress, int retry)
+    : m_gdSongID(gdSongID),
+      m_uniqueID(uniqueID),
+      m_progress(progress),
+      m_retry(retry) {};
 
 int SongDownloadProgress::gdSongID() { return m_gdSongID; }
-std::string SongDownloadProgress::uniqueID() { return m_uniqueID; }
+UniqueID SongDownloadProgress::uniqueID() { return m_uniqueID; }
 float SongDownloadProgress::progress() { return m_progress; }
+int SongDownloadProgress::retry() { return m_retry; }
 
 }  // namespace event
 
@@ -1,11 +1,11 @@
 #pragma once
 
-#include <string>
 
 #include <Geode/loader/Event.hpp>
 
 #include <jukebox/managers/index_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
@@ -14,19 +14,23 @@ namespace event {
 class SongDownloadProgress final : public geode::Event {
 private:
     int m_gdSongID;
-    std::string m_uniqueID;
+    UniqueID m_uniqueID;
     float m_progress;
+    int m_retry;
 
 protected:
     friend class ::jukebox::NongManager;
     friend class ::jukebox::IndexManager;
 
-    SongDownloadProgress(int gdSongID, std::string m_uniqueID, float progress);
+    SongDownloadProgress(int gdSongID, UniqueID uniqueID, float progress,
+                         int retry = 0);
 
 public:
     int gdSongID();
-    std::string uniqueID();
+    UniqueID uniqueID();
     float progress();
+    // Retry attempt the download is on, 0 if it hasn't failed
+    int retry();
 };
 
 }  // namespace event
@@ -0,0 +1,67 @@
+#include <jukebox/events/song_subscriptions.hpp>
+
+#include <functional>
+#include <utility>
+
+#include <Geode/loader/Event.hpp>
+
+#include <jukebox/events/song_download_failed.hpp>
+#include <jukebox/events/song_download_finished.hpp>
+#include <jukebox/events/song_download_progress.hpp>
+#include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/nong/nong.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace event {
+
+SongSubscriptions::SongSubscriptions()
+    : m_progressListener([this](SongDownloadProgress* e) {
+          m_progress.dispatch(SongKey{e->gdSongID(), e->uniqueID()}, e);
+          return ListenerResult::Propagate;
+      }),
+      m_failedListener([this](SongDownloadFailed* e) {
+          m_failed.dispatch(SongKey{e->gdSongId(), e->uniqueId()}, e);
+          return ListenerResult::Propagate;
+      }),
+      m_finishedListener([this](SongDownloadFinished* e) {
+          SongMetadata* metadata = e->destination()->metadata();
+          m_finished.dispatch(SongKey{metadata->gdID, metadata->uniqueID}, e);
+          return ListenerResult::Propagate;
+      }),
+      m_stateChangedListener([this](SongStateChanged* e) {
+          m_stateChanged.dispatch(e->nongs()->songID(), e);
+          return ListenerResult::Propagate;
+      }) {}
+
+SongSubscriptions::ProgressSubscription SongSubscriptions::onProgress(
+    int gdSongID, UniqueID uniqueID,
+    std::function<void(SongDownloadProgress*)> callback) {
+    return m_progress.subscribe(SongKey{gdSongID, uniqueID},
+                                std::move(callback));
+}
+
+SongSubscriptions::FailedSubscription SongSubscriptions::onFailed(
+    int gdSongID, UniqueID uniqueID,
+    std::function<void(SongDownloadFailed*)> callback) {
+    return m_failed.subscribe(SongKey{gdSongID, uniqueID},
+                              std::move(callback));
+}
+
+SongSubscriptions::FinishedSubscription SongSubscriptions::onFinished(
+    int gdSongID, UniqueID uniqueID,
+    std::function<void(SongDownloadFinished*)> callback) {
+    return m_finished.subscribe(SongKey{gdSongID, uniqueID},
+                                std::move(callback));
+}
+
+SongSubscriptions::StateSubscription SongSubscriptions::onStateChanged(
+    int gdSongID, std::function<void(SongStateChanged*)> callback) {
+    return m_stateChanged.subscribe(gdSongID, std::move(callback));
+}
+
+}  // namespace event
+
+}  // namespace jukebox
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include <Geode/loader/Event.hpp>
+
+#include <jukebox/events/song_download_failed.hpp>
+#include <jukebox/events/song_download_finished.hpp>
+#include <jukebox/events/song_download_progress.hpp>
+#include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/utils/keyed_dispatcher.hpp>
+#include <jukebox/utils/unique_id.hpp>
+
+namespace jukebox {
+
+namespace event {
+
+/**
+ * A song of a GD song ID
+ */
+struct SongKey {
+    int gdSongID = 0;
+    UniqueID uniqueID;
+
+    bool operator==(const SongKey&) const = default;
+};
+
+struct SongKeyHash {
+    std::size_t operator()(const SongKey& key) const {
+        return std::hash<UniqueID>{}(key.uniqueID) ^
+               (std::hash<int>{}(key.gdSongID) << 1);
+    }
+};
+
+/**
+ * Routes song events to the cells showing that song. One listener per event
+ * type forwards to the subscribers of the event's song, so a download tick
+ * doesn't wake every cell of a long list.
+ */
+class SongSubscriptions final {
+public:
+    template <class T>
+    using SongDispatcher = KeyedDispatcher<SongKey, T, SongKeyHash>;
+
+    using ProgressSubscription =
+        SongDispatcher<SongDownloadProgress>::Subscription;
+    using FailedSubscription = SongDispatcher<SongDownloadFailed>::Subscription;
+    using FinishedSubscription =
+        SongDispatcher<SongDownloadFinished>::Subscription;
+    using StateSubscription =
+        KeyedDispatcher<int, SongStateChanged>::Subscription;
+
+private:
+    SongDispatcher<SongDownloadProgress> m_progress;
+    SongDispatcher<SongDownloadFailed> m_failed;
+    SongDispatcher<SongDownloadFinished> m_finished;
+    // Keyed by GD song ID
+    KeyedDispatcher<int, SongStateChanged> m_stateChanged;
+
+    geode::EventListener<geode::EventFilter<SongDownloadProgress>>
+        m_progressListener;
+    geode::EventListener<geode::EventFilter<SongDownloadFailed>>
+        m_failedListener;
+    geode::EventListener<geode::EventFilter<SongDownloadFinished>>
+        m_finishedListener;
+    geode::EventListener<geode::EventFilter<SongStateChanged>>
+        m_stateChangedListener;
+
+    SongSubscriptions();
+
+public:
+    SongSubscriptions(const SongSubscriptions&) = delete;
+    SongSubscriptions& operator=(const SongSubscriptions&) = delete;
+
+    [[nodiscard]] ProgressSubscription onProgress(
+        int gdSongID, UniqueID uniqueID,
+        std::function<void(SongDownloadProgress*)> callback);
+    [[nodiscard]] FailedSubscription onFailed(
+        int gdSongID, UniqueID uniqueID,
+        std::function<void(SongDownloadFailed*)> callback);
+    [[nodiscard]] FinishedSubscription onFinished(
+        int gdSongID, UniqueID uniqueID,
+        std::function<void(SongDownloadFinished*)> callback);
+    [[nodiscard]] StateSubscription onStateChanged(
+        int gdSongID, std::function<void(SongStateChanged*)> callback);
+
+    static SongSubscriptions& get() {
+        static SongSubscriptions instance;
+        return instance;
+    }
+};
+
+}  // namespace event
+
+}  // namespace jukebox
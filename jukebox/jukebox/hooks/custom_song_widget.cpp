@@ -1,7 +1,13 @@
 #include <Geode/Result.hpp>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
 #include <optional>
+#include <ranges>
 #include <sstream>
+#include <string_view>
+#include <unordered_set>
 
 #include <Geode/cocos/cocoa/CCGeometry.h>
 #include <Geode/cocos/cocoa/CCObject.h>
@@ -23,9 +29,14 @@
 #include <Geode/utils/cocos.hpp>
 
 #include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/hooks/song_info_object.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/managers/index_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/prefetch_manager.hpp>
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/nong_dropdown_layer.hpp>
+#include <jukebox/utils/profiler.hpp>
 
 using namespace geode::prelude;
 using namespace jukebox;
@@ -34,6 +45,7 @@ class $modify(JBSongWidget, CustomSongWidget) {
     struct Fields {
         Nongs* nongs = nullptr;
         CCMenu* labelMenu = nullptr;
+        CCLabelBMFont* nameLabel = nullptr;
         CCMenu* pinMenu = nullptr;
         CCLabelBMFont* sizeIdLabel = nullptr;
         std::string songIds = "";
@@ -50,6 +62,7 @@ class $modify(JBSongWidget, CustomSongWidget) {
     bool init(SongInfoObject* songInfo, CustomSongDelegate* songDelegate,
               bool showSongSelect, bool showPlayMusic, bool showDownload,
               bool isRobtopSong, bool unk, bool isMusicLibrary, int unkInt) {
+        ProfileScope profile("JBSongWidget::init");
         this->adjustSongInfoObject(songInfo);
         if (!CustomSongWidget::init(songInfo, songDelegate, showSongSelect,
                                     showPlayMusic, showDownload, isRobtopSong,
@@ -81,10 +94,8 @@ class $modify(JBSongWidget, CustomSongWidget) {
                     return ListenerResult::Propagate;
                 }
 
-                Song* active = event->nongs()->active();
-
-                m_songInfoObject->m_songName = active->metadata()->name;
-                m_songInfoObject->m_artistName = active->metadata()->artist;
+                JBSongInfoObject::from(m_songInfoObject)
+                    ->applyActive(event->nongs()->activeSummary());
                 this->updateSongInfo();
 
                 return ListenerResult::Propagate;
@@ -108,11 +119,11 @@ class $modify(JBSongWidget, CustomSongWidget) {
         Nongs* nongs = opt.value();
 
         object->m_isUnknownSong = false;
-        object->m_songName = nongs->active()->metadata()->name;
-        object->m_artistName = nongs->active()->metadata()->artist;
+        JBSongInfoObject::from(object)->applyActive(nongs->activeSummary());
     }
 
     void updateWithMultiAssets(gd::string p1, gd::string p2, int p3) {
+        ProfileScope profile("JBSongWidget::updateWithMultiAssets");
         CustomSongWidget::updateWithMultiAssets(p1, p2, p3);
         m_fields->songIds = std::string(p1);
         m_fields->sfxIds = std::string(p2);
@@ -162,18 +173,15 @@ class $modify(JBSongWidget, CustomSongWidget) {
 
     void restoreUI() {
         if (m_fields->pinMenu != nullptr) {
-            m_fields->pinMenu->removeFromParent();
-            m_fields->pinMenu = nullptr;
+            m_fields->pinMenu->setVisible(false);
         }
         if (m_fields->labelMenu != nullptr) {
             m_songLabel->setVisible(true);
-            m_fields->labelMenu->removeFromParent();
-            m_fields->labelMenu = nullptr;
+            m_fields->labelMenu->setVisible(false);
         }
         if (m_fields->sizeIdLabel != nullptr) {
             m_songIDLabel->setVisible(true);
-            m_fields->sizeIdLabel->removeFromParent();
-            m_fields->sizeIdLabel = nullptr;
+            m_fields->sizeIdLabel->setVisible(false);
         }
     }
 
@@ -195,6 +203,7 @@ class $modify(JBSongWidget, CustomSongWidget) {
     }
 
     void setupJBSW() {
+        ProfileScope profile("JBSongWidget::setupJBSW");
         SongInfoObject* obj = m_songInfoObject;
         if (obj == nullptr) {
             return;
@@ -223,7 +232,9 @@ class $modify(JBSongWidget, CustomSongWidget) {
 
         if (!NongManager::get().hasSongID(adjustedId)) {
             Result<Nongs*> res =
-                NongManager::get().initSongID(obj, id, m_isRobtopSong);
+                NongManager::get().initSongID(
+                    host::SongInfo{obj->m_songName, obj->m_artistName}, id,
+                    m_isRobtopSong);
             if (res.isErr()) {
                 std::string err = res.unwrapErr();
                 log::error("{}", err);
@@ -247,6 +258,11 @@ class $modify(JBSongWidget, CustomSongWidget) {
 
         m_fields->nongs = nongs;
         this->createSongLabels(nongs);
+
+        if (std::optional<std::filesystem::path> path =
+                nongs->active()->path()) {
+            PrefetchManager::get().prefetch(adjustedId, path.value());
+        }
     }
 
     void updateSongInfo() {
@@ -260,11 +276,8 @@ class $modify(JBSongWidget, CustomSongWidget) {
                 NongManager::get().getNongs(NongManager::get().adjustSongID(
                     m_songInfoObject->m_songID, true));
             if (opt) {
-                Nongs* n = opt.value();
-
-                m_songInfoObject->m_songName = n->active()->metadata()->name;
-                m_songInfoObject->m_artistName =
-                    n->active()->metadata()->artist;
+                JBSongInfoObject::from(m_songInfoObject)
+                    ->applyActive(opt.value()->activeSummary());
             }
         }
 
@@ -275,11 +288,13 @@ class $modify(JBSongWidget, CustomSongWidget) {
     }
 
     void getMultiAssetSongInfo() {
+        ProfileScope profile("JBSongWidget::getMultiAssetSongInfo");
         for (auto const& kv : m_songs) {
             Nongs* nongs = nullptr;
             if (!NongManager::get().hasSongID(kv.first)) {
                 Result<Nongs*> result =
-                    NongManager::get().initSongID(nullptr, kv.first, false);
+                    NongManager::get().initSongID(std::nullopt, kv.first,
+                                                  false);
 
                 if (result.isErr()) {
                     log::error("Failed to init multi asset song: {}",
@@ -295,47 +310,66 @@ class $modify(JBSongWidget, CustomSongWidget) {
         }
     }
 
+    // Nodes are created the first time they're shown and updated in place
+    // after, switching NONGs or getting song info doesn't rebuild them
     void createSongLabels(Nongs* nongs) {
+        ProfileScope profile("JBSongWidget::createSongLabels");
         int songID = m_songInfoObject->m_songID;
         if (m_isRobtopSong) {
             songID++;
             songID = -songID;
         }
         Song* active = nongs->active();
-        if (m_fields->pinMenu != nullptr) {
-            m_fields->pinMenu->removeFromParent();
-            m_fields->pinMenu = nullptr;
-        }
-
-        if (m_fields->labelMenu != nullptr) {
-            m_fields->labelMenu->removeFromParent();
-            m_fields->labelMenu = nullptr;
-        }
+        bool created = false;
 
         if (Mod::get()->getSettingValue<bool>("old-label-display")) {
-            m_fields->labelMenu = CCMenu::create();
-            m_fields->labelMenu->setID("nong-menu"_spr);
-            m_fields->labelMenu->ignoreAnchorPointForPosition(false);
-            CCLabelBMFont* label = CCLabelBMFont::create(
-                active->metadata()->name.c_str(), "bigFont.fnt");
-            label->setID("song-name-label"_spr);
-            CCMenuItemSpriteExtra* btn = CCMenuItemSpriteExtra::create(
-                label, this, menu_selector(JBSongWidget::addNongLayer));
-            btn->setID("nong-button"_spr);
-            float labelScale = label->getScale();
-            m_fields->labelMenu->addChild(btn);
+            if (m_fields->pinMenu != nullptr) {
+                m_fields->pinMenu->setVisible(false);
+            }
+
+            if (m_fields->labelMenu == nullptr) {
+                m_fields->labelMenu = CCMenu::create();
+                m_fields->labelMenu->setID("nong-menu"_spr);
+                m_fields->labelMenu->ignoreAnchorPointForPosition(false);
+                m_fields->nameLabel = CCLabelBMFont::create(
+                    active->metadata()->name.c_str(), "bigFont.fnt");
+                m_fields->nameLabel->setID("song-name-label"_spr);
+                CCMenuItemSpriteExtra* btn = CCMenuItemSpriteExtra::create(
+                    m_fields->nameLabel, this,
+                    menu_selector(JBSongWidget::addNongLayer));
+                btn->setID("nong-button"_spr);
+                m_fields->labelMenu->addChild(btn);
+                m_fields->labelMenu->setLayout(
+                    RowLayout::create()
+                        ->setDefaultScaleLimits(0.1f, 1.0f)
+                        ->setAxisAlignment(AxisAlignment::Start));
+                this->addChild(m_fields->labelMenu);
+                created = true;
+            } else {
+                m_fields->nameLabel->setString(
+                    active->metadata()->name.c_str());
+                // The button keeps the size of the text it was made with
+                auto btn = static_cast<CCMenuItemSpriteExtra*>(
+                    m_fields->nameLabel->getParent());
+                const CCSize size = m_fields->nameLabel->getScaledContentSize();
+                btn->setContentSize(size);
+                m_fields->nameLabel->setPosition(
+                    ccp(size.width / 2.f, size.height / 2.f));
+            }
+
             m_fields->labelMenu->setAnchorPoint(m_songLabel->getAnchorPoint());
             m_fields->labelMenu->setContentSize(
                 m_songLabel->getScaledContentSize());
             m_fields->labelMenu->setPosition(m_songLabel->getPosition());
-            m_fields->labelMenu->setLayout(
-                RowLayout::create()
-                    ->setDefaultScaleLimits(0.1f, 1.0f)
-                    ->setAxisAlignment(AxisAlignment::Start));
             m_fields->labelMenu->updateLayout();
+            m_fields->labelMenu->setVisible(true);
             m_songLabel->setVisible(false);
-            this->addChild(m_fields->labelMenu);
         } else {
+            if (m_fields->labelMenu != nullptr) {
+                m_fields->labelMenu->setVisible(false);
+                m_songLabel->setVisible(true);
+            }
+
             CCSize pos;
 
             if (!m_isMusicLibrary) {
@@ -350,74 +384,85 @@ class $modify(JBSongWidget, CustomSongWidget) {
                 pos = m_songIDLabel->getPosition() + CCSize{-7.0f, -11.0f};
             }
 
-            m_fields->pinMenu = CCMenu::create();
-            m_fields->pinMenu->setID("nong-menu"_spr);
+            if (m_fields->pinMenu == nullptr) {
+                m_fields->pinMenu = CCMenu::create();
+                m_fields->pinMenu->setID("nong-menu"_spr);
 
-            CCSprite* spr =
-                CCSprite::createWithSpriteFrameName("JB_PinDisc.png"_spr);
-            if (m_isMusicLibrary) {
-                spr->setScale(0.5f);
-            } else {
-                spr->setScale(0.7f);
+                CCSprite* spr =
+                    CCSprite::createWithSpriteFrameName("JB_PinDisc.png"_spr);
+                if (m_isMusicLibrary) {
+                    spr->setScale(0.5f);
+                } else {
+                    spr->setScale(0.7f);
+                }
+                spr->setID("nong-pin"_spr);
+
+                CCMenuItemSpriteExtra* btn = CCMenuItemSpriteExtra::create(
+                    spr, this, menu_selector(JBSongWidget::addNongLayer));
+                btn->setID("nong-button"_spr);
+
+                m_fields->pinMenu->setAnchorPoint({0.5f, 0.5f});
+                m_fields->pinMenu->ignoreAnchorPointForPosition(false);
+                m_fields->pinMenu->addChild(btn);
+                m_fields->pinMenu->setContentSize(btn->getScaledContentSize());
+                m_fields->pinMenu->setLayout(RowLayout::create());
+                this->addChild(m_fields->pinMenu);
+                created = true;
             }
-            spr->setID("nong-pin"_spr);
-
-            CCMenuItemSpriteExtra* btn = CCMenuItemSpriteExtra::create(
-                spr, this, menu_selector(JBSongWidget::addNongLayer));
-            btn->setID("nong-button"_spr);
-
-            m_fields->pinMenu->setAnchorPoint({0.5f, 0.5f});
-            m_fields->pinMenu->ignoreAnchorPointForPosition(false);
-            m_fields->pinMenu->addChild(btn);
-            m_fields->pinMenu->setContentSize(btn->getScaledContentSize());
-            m_fields->pinMenu->setLayout(RowLayout::create());
 
             m_fields->pinMenu->setPosition(pos);
-            this->addChild(m_fields->pinMenu);
+            m_fields->pinMenu->setVisible(true);
         }
 
-        if (m_songs.size() == 0 && m_sfx.size() == 0 && !m_isMusicLibrary) {
-            if (m_fields->sizeIdLabel != nullptr) {
-                m_fields->sizeIdLabel->removeFromParent();
-                m_fields->sizeIdLabel = nullptr;
+        if (created) {
+            geode::cocos::handleTouchPriority(this);
+        }
+
+        if (m_songs.size() != 0 || m_sfx.size() != 0 || m_isMusicLibrary) {
+            if (m_fields->sizeIdLabel) {
+                m_fields->sizeIdLabel->setVisible(false);
             }
-            auto data = NongManager::get().getNongs(songID).value();
+            m_songIDLabel->setVisible(true);
+            return;
+        }
 
-            // TODO this might be fuckery
-            if (!std::filesystem::exists(active->path().value()) &&
-                nongs->isDefaultActive()) {
-                m_songIDLabel->setVisible(true);
-                geode::cocos::handleTouchPriority(this);
-                return;
-            } else if (m_songIDLabel) {
-                m_songIDLabel->setVisible(false);
+        // One stat through the size cache tells both whether the file is
+        // there and how large it is
+        std::optional<std::filesystem::path> path = active->path();
+        std::optional<std::uintmax_t> size =
+            path ? NongManager::get().assetSize(path.value()) : std::nullopt;
+
+        if (!size && nongs->isDefaultActive()) {
+            if (m_fields->sizeIdLabel) {
+                m_fields->sizeIdLabel->setVisible(false);
             }
+            m_songIDLabel->setVisible(true);
+            return;
+        } else if (m_songIDLabel) {
+            m_songIDLabel->setVisible(false);
+        }
 
-            std::string sizeText;
-            if (std::filesystem::exists(active->path().value())) {
-                sizeText =
-                    NongManager::get().getFormattedSize(active->path().value());
-            } else {
-                sizeText = "NA";
+        std::string sizeText =
+            size ? NongManager::formatSize(size.value()) : "NA";
+        std::string labelText;
+        if (nongs->isDefaultActive()) {
+            std::stringstream ss;
+            int displayId = songID;
+            if (displayId < 0) {
+                displayId = (-displayId) - 1;
+                ss << "(R) ";
             }
-            std::string labelText;
-            if (nongs->isDefaultActive()) {
-                std::stringstream ss;
-                int displayId = songID;
-                if (displayId < 0) {
-                    displayId = (-displayId) - 1;
-                    ss << "(R) ";
-                }
-                ss << displayId;
-                labelText = "SongID: " + ss.str() + "  Size: " + sizeText;
-            } else {
-                std::string display = "NONG";
-                if (songID < 0) {
-                    display = "(R) NONG";
-                }
-                labelText = "SongID: " + display + "  Size: " + sizeText;
+            ss << displayId;
+            labelText = "SongID: " + ss.str() + "  Size: " + sizeText;
+        } else {
+            std::string display = "NONG";
+            if (songID < 0) {
+                display = "(R) NONG";
             }
+            labelText = "SongID: " + display + "  Size: " + sizeText;
+        }
 
+        if (m_fields->sizeIdLabel == nullptr) {
             auto label =
                 CCLabelBMFont::create(labelText.c_str(), "bigFont.fnt");
             label->setID("id-and-size-label"_spr);
@@ -426,14 +471,10 @@ class $modify(JBSongWidget, CustomSongWidget) {
             label->setScale(0.4f);
             this->addChild(label);
             m_fields->sizeIdLabel = label;
-            geode::cocos::handleTouchPriority(this);
         } else {
-            if (m_fields->sizeIdLabel) {
-                m_fields->sizeIdLabel->setVisible(false);
-            }
-            m_songIDLabel->setVisible(true);
-            geode::cocos::handleTouchPriority(this);
+            m_fields->sizeIdLabel->setString(labelText.c_str());
         }
+        m_fields->sizeIdLabel->setVisible(true);
     }
 
     void addNongLayer(CCObject* target) {
@@ -465,10 +506,32 @@ class $modify(JBSongWidget, CustomSongWidget) {
 };
 
 class $modify(JBLevelInfoLayer, LevelInfoLayer) {
+    struct Fields {
+        std::uint64_t priorityToken = 0;
+
+        // Destroyed with the layer, a layer that replaced it keeps its own
+        ~Fields() { IndexManager::get().clearPrioritySongIDs(priorityToken); }
+    };
+
     bool init(GJGameLevel* level, bool p1) {
         if (!LevelInfoLayer::init(level, p1)) {
             return false;
         }
+
+        std::unordered_set<int> songIDs;
+        songIDs.insert(level->m_songID != 0 ? level->m_songID
+                                            : -level->m_audioTrack - 1);
+        const std::string multiAsset = level->m_songIDs;
+        for (auto part : std::views::split(multiAsset, ',')) {
+            std::string_view str(part.begin(), part.end());
+            int id = 0;
+            auto res = std::from_chars(str.data(), str.data() + str.size(), id);
+            if (res.ec == std::errc()) {
+                songIDs.insert(id);
+            }
+        }
+        m_fields->priorityToken =
+            IndexManager::get().setPrioritySongIDs(std::move(songIDs));
         if (Mod::get()->getSavedValue("show-tutorial", true) &&
             GameManager::get()->m_levelEditorLayer == nullptr) {
             auto popup =
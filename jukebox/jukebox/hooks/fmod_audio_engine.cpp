@@ -1,40 +1,86 @@
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
 #include <Geode/binding/FMODAudioEngine.hpp>
 #include <Geode/modify/FMODAudioEngine.hpp>  // IWYU pragma: keep
+#include <fmod.hpp>
 
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/prefetch_manager.hpp>
+#include <jukebox/managers/seek_index_manager.hpp>
+#include <jukebox/utils/profiler.hpp>
 
 using namespace jukebox;
 
+namespace {
+
+struct PendingGain {
+    int channel;
+    float gain;
+};
+
+// GD only creates the channel when it processes the queued start, so the
+// gain waits for the next update
+std::optional<PendingGain> s_pendingGain;
+
+}  // namespace
+
 class $modify(FMODAudioEngine) {
     void queueStartMusic(gd::string audioFilename, float p1, float p2, float p3,
                          bool p4, int ms, int p6, int p7, int p8, int p9,
                          bool p10, int p11, bool p12, bool p13) {
-        if (NongManager::get().m_currentlyPreparingNong) {
-            int additionalOffset = NongManager::get()
-                                       .m_currentlyPreparingNong.value()
-                                       ->active()
-                                       ->metadata()
-                                       ->startOffset;
-            FMODAudioEngine::queueStartMusic(audioFilename, p1, p2, p3, p4,
-                                             ms + additionalOffset, p6, p7, p8,
-                                             p9, p10, p11, p12, p13);
+        Profiler::get().count(Profiler::Counter::QueueStartMusic);
+        int additionalOffset =
+            NongManager::get().startMusicOffset(audioFilename);
+        s_pendingGain = std::nullopt;
+        if (const PreparedTrack* track = NongManager::get().playingTrack()) {
+            // FMOD streams the file from here on
+            PrefetchManager::get().handOff(track->songID);
+            const std::string_view name = track->filename.c_str();
+            SeekIndexManager::get().load(std::filesystem::path(
+                std::u8string(name.begin(), name.end())));
+            if (track->gain != 1.f) {
+                // p11 is the music channel the track is queued on
+                s_pendingGain = PendingGain{p11, track->gain};
+            }
         } else {
-            FMODAudioEngine::queueStartMusic(audioFilename, p1, p2, p3, p4, ms,
-                                             p6, p7, p8, p9, p10, p11, p12,
-                                             p13);
+            SeekIndexManager::get().unload();
+        }
+        FMODAudioEngine::queueStartMusic(audioFilename, p1, p2, p3, p4,
+                                         ms + additionalOffset, p6, p7, p8, p9,
+                                         p10, p11, p12, p13);
+    }
+
+    void update(float dt) {
+        FMODAudioEngine::update(dt);
+        if (!s_pendingGain) {
+            return;
+        }
+        // The channel volume scales on top of the music volume GD sets on
+        // its channel group, so the user's volume setting still applies
+        if (FMOD::Channel* channel =
+                this->getActiveMusicChannel(s_pendingGain->channel)) {
+            channel->setVolume(s_pendingGain->gain);
+            s_pendingGain = std::nullopt;
         }
     }
 
     void setMusicTimeMS(unsigned int ms, bool p1, int channel) {
-        if (NongManager::get().m_currentlyPreparingNong) {
-            int additionalOffset = NongManager::get()
-                                       .m_currentlyPreparingNong.value()
-                                       ->active()
-                                       ->metadata()
-                                       ->startOffset;
-            FMODAudioEngine::setMusicTimeMS(ms + additionalOffset, p1, channel);
-        } else {
-            FMODAudioEngine::setMusicTimeMS(ms, p1, channel);
+        Profiler::get().count(Profiler::Counter::SetMusicTimeMS);
+        unsigned int target = ms + NongManager::get().seekOffset();
+        // Seeks of VBR MP3s without a TOC go through their seek table
+        FMOD::Channel* music = this->getActiveMusicChannel(channel);
+        FMOD::Sound* sound = nullptr;
+        unsigned int length = 0;
+        if (music && music->getCurrentSound(&sound) == FMOD_OK && sound &&
+            sound->getLength(&length, FMOD_TIMEUNIT_MS) == FMOD_OK) {
+            if (std::optional<unsigned int> mapped =
+                    SeekIndexManager::get().fmodSeekTime(target, length)) {
+                target = mapped.value();
+            }
         }
+        FMODAudioEngine::setMusicTimeMS(target, p1, channel);
     }
 };
@@ -1,37 +1,35 @@
-#include <filesystem>
 #include <optional>
 
 #include <Geode/binding/GJGameLevel.hpp>
+#include <Geode/c++stl/string.hpp>
 #include <Geode/modify/GJGameLevel.hpp>  // IWYU pragma: keep
 #include <Geode/modify/Modify.hpp>
-#include <Geode/utils/string.hpp>
 
+#include <jukebox/host/host.hpp>
+#include <jukebox/managers/audio_cache_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/nong/nong.hpp>
 
 using namespace geode::prelude;
 using namespace jukebox;
 
 class $modify(GJGameLevel) {
     gd::string getAudioFileName() {
-        NongManager::get().m_currentlyPreparingNong = std::nullopt;
         // If we have a custom song, return
         if (m_songID != 0) {
             return GJGameLevel::getAudioFileName();
         }
         int id = (-m_audioTrack) - 1;
         std::optional<Nongs*> res = NongManager::get().getNongs(id);
-        if (!res.has_value()) {
+        const host::GameString* path =
+            res ? res.value()->playablePath() : nullptr;
+        if (!path) {
+            NongManager::get().forgetPreparedTrack(id);
             return GJGameLevel::getAudioFileName();
         }
-        Song* active = res.value()->active();
-        if (!std::filesystem::exists(active->path().value())) {
-            return GJGameLevel::getAudioFileName();
-        }
-        jukebox::NongManager::get().m_currentlyPreparingNong = res.value();
-#ifdef GEODE_IS_WINDOWS
-        return geode::utils::string::wideToUtf8(active->path().value().c_str());
-#else
-        return active->path().value().string();
-#endif
+        NongManager::get().prepareTrack(
+            id, *path, res.value()->activeSummary().startOffset);
+        AudioCacheManager::get().touch(path->c_str());
+        return *path;
     }
 };
@@ -2,11 +2,13 @@
 
 #include <Geode/cocos/base_nodes/CCNode.h>
 #include <Geode/cocos/label_nodes/CCLabelBMFont.h>
+#include <Geode/cocos/sprite_nodes/CCSprite.h>
 #include <Geode/binding/GJGameLevel.hpp>
 #include <Geode/binding/LevelCell.hpp>
 #include <Geode/loader/Loader.hpp>
 #include <Geode/modify/LevelCell.hpp>
 
+#include <jukebox/managers/index_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
 #include <jukebox/nong/nong.hpp>
 
@@ -17,6 +19,10 @@ class $modify(JBLevelCell, LevelCell) {
     void loadCustomLevelCell() {
         LevelCell::loadCustomLevelCell();
 
+        const int id = this->songID();
+        // Levels in the browser are likely to be opened next
+        IndexManager::get().prefetchSong(id);
+
         if (!Loader::get()->isModLoaded("geode.node-ids")) {
             return;
         }
@@ -36,20 +42,45 @@ class $modify(JBLevelCell, LevelCell) {
         if (nongName.has_value()) {
             songName->setString(nongName.value().c_str());
         }
+
+        if (IndexManager::get().hasIndexSongs(id)) {
+            this->addIndexBadge(main, songName);
+        }
     }
 
-    std::optional<std::string> getNongSongName() {
-        int id = m_level->m_songID;
+    // Shows that an index has NONGs for the song, after its name
+    void addIndexBadge(CCNode* main, CCLabelBMFont* songName) {
+        if (main->getChildByID("index-badge"_spr)) {
+            return;
+        }
+
+        CCSprite* badge =
+            CCSprite::createWithSpriteFrameName("GJ_downloadsIcon_001.png");
+        badge->setID("index-badge"_spr);
+        badge->setScale(0.35f);
+        badge->setAnchorPoint({0.f, 0.5f});
+
+        const float nameWidth = songName->getScaledContentSize().width;
+        const float left =
+            songName->getPositionX() - songName->getAnchorPoint().x * nameWidth;
+        badge->setPosition(
+            {left + nameWidth + 3.f, songName->getPositionY()});
+        main->addChild(badge);
+    }
+
+    int songID() {
         if (m_level->m_songID == 0) {
-            id = (-m_level->m_audioTrack) - 1;
+            return (-m_level->m_audioTrack) - 1;
         }
+        return m_level->m_songID;
+    }
 
-        std::optional<Nongs*> opt = NongManager::get().getNongs(id);
+    std::optional<std::string> getNongSongName() {
+        std::optional<Nongs*> opt = NongManager::get().getNongs(this->songID());
         if (!opt.has_value()) {
             return std::nullopt;
         }
 
-        Nongs* nongs = opt.value();
-        return nongs->active()->metadata()->name;
+        return opt.value()->activeSummary().name;
     }
 };
@@ -35,7 +35,7 @@ class $modify(LevelTools) {
         int searchID = -id - 1;
         std::optional<Nongs*> res = NongManager::get().getNongs(searchID);
         if (res.has_value()) {
-            return res.value()->active()->metadata()->name;
+            return res.value()->activeSummary().name;
         }
         return LevelTools::getAudioTitle(id);
     }
@@ -1,36 +1,37 @@
 #include <jukebox/hooks/music_download_manager.hpp>
 
 #include <optional>
+#include <string>
 
 #include <Geode/binding/MusicDownloadManager.hpp>
 #include <Geode/binding/SongInfoObject.hpp>
 #include <Geode/c++stl/string.hpp>
 #include <Geode/loader/Log.hpp>
-#include <Geode/utils/string.hpp>
 
 #include <jukebox/events/get_song_info.hpp>
+#include <jukebox/hooks/song_info_object.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/managers/audio_cache_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/song_info_manager.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/profiler.hpp>
 
 using namespace jukebox;
 
 gd::string JBMusicDownloadManager::pathForSong(int id) {
-    NongManager::get().m_currentlyPreparingNong = std::nullopt;
+    Profiler::get().count(Profiler::Counter::PathForSong);
     std::optional<Nongs*> nongs = NongManager::get().getNongs(id);
-    if (!nongs.has_value()) {
+    const host::GameString* path =
+        nongs ? nongs.value()->playablePath() : nullptr;
+    if (!path) {
+        NongManager::get().forgetPreparedTrack(id);
         return MusicDownloadManager::pathForSong(id);
     }
-    Nongs* value = nongs.value();
-    Song* active = value->active();
-    if (!std::filesystem::exists(active->path().value())) {
-        return MusicDownloadManager::pathForSong(id);
-    }
-    NongManager::get().m_currentlyPreparingNong = value;
-#ifdef GEODE_IS_WINDOWS
-    return geode::utils::string::wideToUtf8(active->path().value().c_str());
-#else
-    return active->path().value().string();
-#endif
+    NongManager::get().prepareTrack(
+        id, *path, nongs.value()->activeSummary().startOffset);
+    AudioCacheManager::get().touch(path->c_str());
+    return *path;
 }
 
 void JBMusicDownloadManager::onGetSongInfoCompleted(gd::string p1,
@@ -42,15 +43,18 @@ void JBMusicDownloadManager::onGetSongInfoCompleted(gd::string p1,
     SongInfoObject* obj = this->getSongInfoObject(songID);
     m_fields->overrideSongInfo = false;
 
-    if (obj == nullptr) {
-        return;
+    if (obj != nullptr) {
+        // GD just wrote the details it fetched
+        JBSongInfoObject::from(obj)->forgetApplied();
+        jukebox::event::GetSongInfo(obj->m_songName, obj->m_artistName, songID)
+            .post();
     }
-
-    jukebox::event::GetSongInfo(obj->m_songName, obj->m_artistName, songID)
-        .post();
+    // After the event, so its save is part of the batch
+    SongInfoManager::get().completed(songID);
 }
 
 SongInfoObject* JBMusicDownloadManager::getSongInfoObject(int id) {
+    Profiler::get().count(Profiler::Counter::GetSongInfoObject);
     auto og = MusicDownloadManager::getSongInfoObject(id);
     if (og == nullptr) {
         return og;
@@ -66,10 +70,6 @@ SongInfoObject* JBMusicDownloadManager::getSongInfoObject(int id) {
         return og;
     }
 
-    Nongs* res = opt.value();
-    Song* active = res->active();
-
-    og->m_songName = active->metadata()->name;
-    og->m_artistName = active->metadata()->artist;
+    JBSongInfoObject::from(og)->applyActive(opt.value()->activeSummary());
     return og;
 }
@@ -0,0 +1,18 @@
+#include <jukebox/hooks/song_info_object.hpp>
+
+#include <Geode/binding/SongInfoObject.hpp>
+
+#include <jukebox/nong/nong.hpp>
+
+using namespace jukebox;
+
+void JBSongInfoObject::applyActive(const Nongs::ActiveSummary& active) {
+    if (m_fields->appliedGeneration == active.generation) {
+        return;
+    }
+    m_songName = active.name;
+    m_artistName = active.artist;
+    m_fields->appliedGeneration = active.generation;
+}
+
+void JBSongInfoObject::forgetApplied() { m_fields->appliedGeneration = 0; }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Geode/binding/SongInfoObject.hpp>
+#include <Geode/modify/SongInfoObject.hpp>  // IWYU pragma: keep
+
+#include <jukebox/nong/nong.hpp>
+
+struct JBSongInfoObject : geode::Modify<JBSongInfoObject, SongInfoObject> {
+    struct Fields {
+        // Generation of the active summary last copied in, 0 if none
+        std::uint64_t appliedGeneration = 0;
+    };
+
+    /**
+     * Shows the active song of a song ID. The names are only copied when
+     * another summary generation was applied last, so calling this on every
+     * getSongInfoObject costs an integer compare.
+     */
+    void applyActive(const jukebox::Nongs::ActiveSummary& active);
+    /**
+     * Call after GD wrote its own details into the object
+     */
+    void forgetApplied();
+
+    static JBSongInfoObject* from(SongInfoObject* object) {
+        return static_cast<JBSongInfoObject*>(object);
+    }
+};
@@ -0,0 +1,143 @@
+#include <jukebox/host/host.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <Geode/binding/LevelTools.hpp>
+#include <Geode/binding/MusicDownloadManager.hpp>
+#include <Geode/binding/SongInfoObject.hpp>
+#include <Geode/cocos/platform/CCFileUtils.h>
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+#include <Geode/utils/web.hpp>
+
+#include <jukebox/events/nong_deleted.hpp>
+#include <jukebox/events/nongs_cleared.hpp>
+#include <jukebox/managers/blob_store.hpp>
+#include <jukebox/managers/file_status_cache.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/song_info_manager.hpp>
+#include <jukebox/nong/nong.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace host {
+
+std::filesystem::path saveDir() { return Mod::get()->getSaveDir(); }
+
+std::filesystem::path gdResourcesDir() {
+    return std::filesystem::path(
+               std::string(CCFileUtils::get()->getWritablePath2())) /
+           "Resources";
+}
+
+std::filesystem::path gdSongsDir() {
+    return std::filesystem::path(
+        std::string(CCFileUtils::get()->getWritablePath()));
+}
+
+std::filesystem::path gdSongPath(int songID) {
+    return std::filesystem::path(
+        MusicDownloadManager::sharedState()->pathForSong(songID));
+}
+
+std::filesystem::path robtopSongPath(int songID) {
+    return gdResourcesDir() / std::string(LevelTools::getAudioFileName(songID));
+}
+
+std::optional<SongInfo> songInfo(int songID) {
+    SongInfoObject* obj =
+        MusicDownloadManager::sharedState()->getSongInfoObject(songID);
+    if (!obj) {
+        return std::nullopt;
+    }
+    return SongInfo{obj->m_songName, obj->m_artistName};
+}
+
+void fetchSongInfo(int songID, bool refetch) {
+    SongInfoManager::get().request(songID, refetch);
+}
+
+void httpGet(HttpRequest request, HttpCallback callback) {
+    web::WebRequest web;
+    web.timeout(request.timeout);
+    for (auto& [name, value] : request.headers) {
+        web.header(name, value);
+    }
+    if (request.compressed) {
+        web.acceptEncoding("gzip, deflate");
+    }
+
+    web.get(request.url)
+        .listen(
+            [callback](web::WebResponse* response) {
+                HttpResponse ret{.code = response->code()};
+                for (const std::string& name : response->headers()) {
+                    if (auto value = response->header(name)) {
+                        ret.headers.emplace_back(name, std::move(*value));
+                    }
+                }
+                if (response->ok()) {
+                    Result<std::string> body = response->string();
+                    if (body.isErr()) {
+                        callback(Err(body.unwrapErr()));
+                        return;
+                    }
+                    ret.body = std::move(body.unwrap());
+                }
+                callback(Ok(std::move(ret)));
+            },
+            [](auto) {},  // irrelevant
+            [callback]() { callback(Err("Request cancelled")); });
+}
+
+void queueSave(int songID) { NongManager::get().queueSave(songID); }
+
+void activeChanged(Nongs* nongs) {
+    NongManager::get().markSnapshotDirty(nongs->songID());
+    // Loading the manifest sets the active songs too, nobody listens yet
+    if (NongManager::get().initialized()) {
+        NongManager::get().queueStateChanged(nongs->songID());
+    }
+}
+
+void songDeleted(UniqueID uniqueID, int songID) {
+    if (NongManager::get().initialized()) {
+        event::NongDeleted(uniqueID, songID).post();
+    }
+}
+
+void songsCleared(std::vector<UniqueID> uniqueIDs, int songID) {
+    if (NongManager::get().initialized()) {
+        event::NongsCleared(std::move(uniqueIDs), songID).post();
+    }
+}
+
+bool fileExists(const std::filesystem::path& path) {
+    return FileStatusCache::get().exists(path);
+}
+
+bool fileWatched(const std::filesystem::path& path) {
+    return FileStatusCache::get().isWatched(path);
+}
+
+void removeSongFiles(std::vector<std::filesystem::path> paths) {
+    // Other songs may share the files through their blobs
+    BlobStore::get().removeLater(std::move(paths));
+}
+
+void logWarning(std::string_view message) { log::warn("{}", message); }
+
+void logError(std::string_view message) { log::error("{}", message); }
+
+}  // namespace host
+
+}  // namespace jukebox
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#ifndef JUKEBOX_HEADLESS
+#include <Geode/c++stl/string.hpp>
+#endif
+
+#include <jukebox/utils/unique_id.hpp>
+
+namespace jukebox {
+
+class Nongs;
+
+/**
+ * What jukebox needs from the program it runs in: storage paths, HTTP, GD's
+ * song info and a few notifications. The mod defines these with Geode and GD
+ * in host/geode.cpp, the benchmark defines them without either, so the
+ * model, its serializers and the index parser build as a core library on
+ * their own and the managers don't call into GD directly.
+ */
+namespace host {
+
+// The string GD takes song paths as, so a path can be cached in the form
+// the hooks hand it over. The benchmark has no GD.
+#ifdef JUKEBOX_HEADLESS
+using GameString = std::string;
+#else
+using GameString = gd::string;
+#endif
+
+struct SongInfo {
+    std::string name;
+    std::string artist;
+};
+
+struct HttpRequest {
+    std::string url;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::chrono::seconds timeout{30};
+    // Advertises gzip and deflate, the body is handed back decoded
+    bool compressed = false;
+};
+
+struct HttpResponse {
+    int code = 0;
+    // Only read for 2xx responses
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    bool ok() const { return code >= 200 && code < 300; }
+    /**
+     * Looks up a response header, ignoring case
+     */
+    std::optional<std::string> header(std::string_view name) const;
+};
+
+using HttpCallback = std::function<void(geode::Result<HttpResponse>)>;
+
+/**
+ * Where the mod keeps its data
+ */
+std::filesystem::path saveDir();
+
+/**
+ * GD's Resources folder, holding the built-in songs and sfx
+ */
+std::filesystem::path gdResourcesDir();
+
+/**
+ * Where GD downloads songs and sfx to
+ */
+std::filesystem::path gdSongsDir();
+
+/**
+ * Path GD stores a song at
+ */
+std::filesystem::path gdSongPath(int songID);
+
+/**
+ * Path of a built-in RobTop song
+ */
+std::filesystem::path robtopSongPath(int songID);
+
+/**
+ * Song info GD has stored for a song, if any
+ */
+std::optional<SongInfo> songInfo(int songID);
+
+/**
+ * Asks GD's servers for the song info of a song. The mod queues these and
+ * sends them a few at a time
+ *
+ * @param refetch drop what GD has stored for it first
+ */
+void fetchSongInfo(int songID, bool refetch);
+
+/**
+ * Sends a GET request. The callback runs on the main thread
+ */
+void httpGet(HttpRequest request, HttpCallback callback);
+
+/**
+ * Queues the NONGs of a song to be written to disk
+ */
+void queueSave(int songID);
+
+/**
+ * Called after the active song of some NONGs changed. The mod tells its UI
+ * on the next frame, once per song ID.
+ */
+void activeChanged(Nongs* nongs);
+
+/**
+ * Called after a song was deleted from the NONGs of a GD song
+ */
+void songDeleted(UniqueID uniqueID, int songID);
+
+/**
+ * Called once after every song but the default one was deleted from the
+ * NONGs of a GD song
+ */
+void songsCleared(std::vector<UniqueID> uniqueIDs, int songID);
+
+/**
+ * Whether a file exists. The mod answers from its file status cache, so
+ * this is cheap to call on every UI update
+ */
+bool fileExists(const std::filesystem::path& path);
+
+/**
+ * Whether changes to a file are reported through
+ * Nongs::invalidatePlayablePaths. Files it isn't for have to be checked
+ * again every so often.
+ */
+bool fileWatched(const std::filesystem::path& path);
+
+/**
+ * Removes song files. The mod queues them to a background thread in
+ * batches, they're reported missing by fileExists right away. Errors are
+ * logged.
+ */
+void removeSongFiles(std::vector<std::filesystem::path> paths);
+
+void logWarning(std::string_view message);
+void logError(std::string_view message);
+
+}  // namespace host
+
+}  // namespace jukebox
@@ -0,0 +1,29 @@
+#include <jukebox/host/host.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace jukebox {
+
+namespace host {
+
+std::optional<std::string> HttpResponse::header(std::string_view name) const {
+    auto sameName = [name](const auto& header) {
+        return std::ranges::equal(header.first, name, [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) ==
+                   std::tolower(static_cast<unsigned char>(b));
+        });
+    };
+    if (auto it = std::ranges::find_if(headers, sameName);
+        it != headers.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+}  // namespace host
+
+}  // namespace jukebox
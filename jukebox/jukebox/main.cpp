@@ -1,20 +1,43 @@
 #include <Geode/DefaultInclude.hpp>
 #include <Geode/Result.hpp>
+#include <Geode/loader/GameEvent.hpp>
 #include <Geode/loader/Mod.hpp>
 #include <Geode/loader/ModEvent.hpp>
 
+#include <jukebox/managers/analysis_manager.hpp>
+#include <jukebox/managers/audio_cache_manager.hpp>
 #include <jukebox/managers/index_manager.hpp>
+#include <jukebox/managers/lifecycle_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/seek_index_manager.hpp>
+#include <jukebox/managers/shared_library.hpp>
 #include <jukebox/ui/indexes_setting.hpp>
+#include <jukebox/ui/profiler_setting.hpp>
+#include <jukebox/utils/profiler.hpp>
 
 using namespace geode::prelude;
 
 $execute {
     (void)Mod::get()->registerCustomSettingType("indexes",
                                                 &jukebox::IndexSetting::parse);
+    (void)Mod::get()->registerCustomSettingType(
+        "profiler", &jukebox::ProfilerSetting::parse);
 }
 
 $on_mod(Loaded) {
+    jukebox::Profiler::get().init();
+    jukebox::ProfileScope profile("startup");
+    jukebox::SharedLibrary::get().init();
+    // Indexes are fetched and parsed in the background while the manifest
+    // loads, IndexManager::init only registers them with it
+    jukebox::IndexManager::get().start();
     jukebox::NongManager::get().init();
+    jukebox::AudioCacheManager::get().init();
+    jukebox::AnalysisManager::get().init();
+    jukebox::SeekIndexManager::get().prune();
     jukebox::IndexManager::get().init();
 };
+
+$on_mod(DataSaved) { jukebox::LifecycleManager::get().onDataSaved(); };
+
+$on_game(Exiting) { jukebox::LifecycleManager::get().onExit(); };
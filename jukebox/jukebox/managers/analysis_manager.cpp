@@ -0,0 +1,559 @@
+#include <jukebox/managers/analysis_manager.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fmod.hpp>
+#include <fmod_common.h>
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+#include <Geode/utils/file.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/events/song_analyzed.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/loudness.hpp>
+#include <jukebox/utils/profiler.hpp>
+#include <jukebox/utils/sha256.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+constexpr unsigned int s_readChunk = 64 * 1024;
+// Envelope frames per second the offset search works with
+constexpr std::size_t s_envelopeRate = 100;
+// How much of the start of each song is compared
+constexpr std::size_t s_envelopeSeconds = 120;
+constexpr std::size_t s_maxOffsetSeconds = 30;
+// Songs need to overlap this long for a match to count
+constexpr std::size_t s_minOverlapSeconds = 15;
+// Below this the songs are considered unrelated
+constexpr double s_minCorrelation = 0.3;
+
+std::string toUtf8(const std::filesystem::path& path) {
+    const std::u8string str = path.u8string();
+    return std::string(str.begin(), str.end());
+}
+
+struct SoundRelease {
+    void operator()(FMOD::Sound* sound) const { sound->release(); }
+};
+
+struct Decoded {
+    std::uint32_t durationMs = 0;
+    std::optional<double> loudness;
+    // Log energy of every 1 / s_envelopeRate seconds, mixed down to mono
+    std::vector<float> envelope;
+};
+
+// Converts one chunk of FMOD_OPENONLY output to floats
+bool toFloats(FMOD_SOUND_FORMAT format, const std::uint8_t* data,
+              std::size_t bytes, std::vector<float>& out) {
+    out.clear();
+    switch (format) {
+        case FMOD_SOUND_FORMAT_PCM8:
+            for (std::size_t i = 0; i < bytes; i++) {
+                out.push_back(static_cast<std::int8_t>(data[i]) / 128.f);
+            }
+            return true;
+        case FMOD_SOUND_FORMAT_PCM16:
+            for (std::size_t i = 0; i + 1 < bytes; i += 2) {
+                const auto sample =
+                    static_cast<std::int16_t>(data[i] | data[i + 1] << 8);
+                out.push_back(sample / 32768.f);
+            }
+            return true;
+        case FMOD_SOUND_FORMAT_PCM24:
+            for (std::size_t i = 0; i + 2 < bytes; i += 3) {
+                // Sign extended through the top byte
+                const std::int32_t sample =
+                    static_cast<std::int32_t>(
+                        std::uint32_t(data[i]) << 8 |
+                        std::uint32_t(data[i + 1]) << 16 |
+                        std::uint32_t(data[i + 2]) << 24) >>
+                    8;
+                out.push_back(sample / 8388608.f);
+            }
+            return true;
+        case FMOD_SOUND_FORMAT_PCM32:
+            for (std::size_t i = 0; i + 3 < bytes; i += 4) {
+                std::int32_t sample;
+                std::memcpy(&sample, data + i, sizeof(sample));
+                out.push_back(static_cast<float>(sample / 2147483648.0));
+            }
+            return true;
+        case FMOD_SOUND_FORMAT_PCMFLOAT:
+            out.resize(bytes / sizeof(float));
+            std::memcpy(out.data(), data, out.size() * sizeof(float));
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Decodes a song file through FMOD
+ *
+ * @param full decode all of it and measure its loudness, otherwise stop
+ * once the envelope is long enough
+ */
+std::optional<Decoded> decode(FMOD::System* system,
+                              const std::filesystem::path& path, bool full) {
+    FMOD::Sound* raw = nullptr;
+    // FMOD takes UTF-8 paths on every platform
+    if (system->createSound(toUtf8(path).c_str(),
+                            FMOD_OPENONLY | FMOD_ACCURATETIME, nullptr,
+                            &raw) != FMOD_OK ||
+        !raw) {
+        return std::nullopt;
+    }
+    std::unique_ptr<FMOD::Sound, SoundRelease> sound(raw);
+
+    FMOD_SOUND_FORMAT format;
+    int channels = 0;
+    int bits = 0;
+    float frequency = 0;
+    if (sound->getFormat(nullptr, &format, &channels, &bits) != FMOD_OK ||
+        sound->getDefaults(&frequency, nullptr) != FMOD_OK || channels <= 0 ||
+        bits < 8 || frequency < static_cast<float>(s_envelopeRate)) {
+        return std::nullopt;
+    }
+
+    const std::size_t channelCount = static_cast<std::size_t>(channels);
+    const std::size_t frameBytes =
+        channelCount * static_cast<std::size_t>(bits / 8);
+    const std::size_t sampleRate = static_cast<std::size_t>(frequency);
+    const std::size_t envelopeFrames = sampleRate / s_envelopeRate;
+    const std::size_t maxEnvelope = s_envelopeRate * s_envelopeSeconds;
+
+    Decoded ret;
+    ret.envelope.reserve(maxEnvelope);
+    LoudnessMeter meter(static_cast<int>(sampleRate), channelCount);
+
+    std::vector<std::uint8_t> chunk(s_readChunk - s_readChunk % frameBytes);
+    std::vector<float> samples;
+    std::uint64_t frames = 0;
+    double energy = 0;
+    std::size_t energyFrames = 0;
+
+    while (true) {
+        unsigned int read = 0;
+        const FMOD_RESULT result = sound->readData(
+            chunk.data(), static_cast<unsigned int>(chunk.size()), &read);
+        if (result != FMOD_OK && result != FMOD_ERR_FILE_EOF) {
+            return std::nullopt;
+        }
+        if (read == 0 || !toFloats(format, chunk.data(), read, samples)) {
+            break;
+        }
+
+        const std::size_t count = samples.size() / channelCount;
+        frames += count;
+        if (full) {
+            meter.addFrames(samples.data(), count);
+        }
+
+        for (std::size_t i = 0;
+             i < count && ret.envelope.size() < maxEnvelope; i++) {
+            double mono = 0;
+            for (std::size_t c = 0; c < channelCount; c++) {
+                mono += samples[i * channelCount + c];
+            }
+            mono /= static_cast<double>(channelCount);
+            energy += mono * mono;
+            if (++energyFrames == envelopeFrames) {
+                ret.envelope.push_back(static_cast<float>(
+                    std::log10(energy / envelopeFrames + 1e-10)));
+                energy = 0;
+                energyFrames = 0;
+            }
+        }
+
+        if (result == FMOD_ERR_FILE_EOF ||
+            (!full && ret.envelope.size() >= maxEnvelope)) {
+            break;
+        }
+    }
+
+    if (full) {
+        ret.durationMs =
+            static_cast<std::uint32_t>(frames * 1000 / sampleRate);
+        ret.loudness = meter.integrated();
+    }
+    return ret;
+}
+
+// Rises in energy, normalized to zero mean and unit variance
+std::vector<float> onsets(const std::vector<float>& envelope) {
+    std::vector<float> ret(envelope.size(), 0.f);
+    for (std::size_t i = 1; i < envelope.size(); i++) {
+        ret[i] = std::max(0.f, envelope[i] - envelope[i - 1]);
+    }
+
+    double mean = 0;
+    for (float v : ret) {
+        mean += v;
+    }
+    mean /= std::max<std::size_t>(1, ret.size());
+    double variance = 0;
+    for (float v : ret) {
+        variance += (v - mean) * (v - mean);
+    }
+    variance /= std::max<std::size_t>(1, ret.size());
+    const double deviation = std::sqrt(variance);
+
+    for (float& v : ret) {
+        v = deviation > 0 ? static_cast<float>((v - mean) / deviation) : 0.f;
+    }
+    return ret;
+}
+
+/**
+ * Finds how far into the song the default song starts, by correlating
+ * their onsets. Only positive offsets can be applied when GD starts the
+ * music, so the song is only ever shifted one way.
+ *
+ * @return the offset in ms, std::nullopt if nothing matches well enough
+ */
+std::optional<int> bestOffset(const std::vector<float>& song,
+                              const std::vector<float>& reference) {
+    const std::vector<float> a = onsets(song);
+    const std::vector<float> b = onsets(reference);
+    const std::size_t minOverlap = s_envelopeRate * s_minOverlapSeconds;
+    const std::size_t maxLag = s_envelopeRate * s_maxOffsetSeconds;
+
+    double best = s_minCorrelation;
+    std::optional<std::size_t> bestLag;
+    for (std::size_t lag = 0; lag <= maxLag && lag < a.size(); lag++) {
+        const std::size_t overlap = std::min(b.size(), a.size() - lag);
+        if (overlap < minOverlap) {
+            break;
+        }
+        double sum = 0;
+        for (std::size_t t = 0; t < overlap; t++) {
+            sum += a[t + lag] * b[t];
+        }
+        const double correlation = sum / overlap;
+        if (correlation > best) {
+            best = correlation;
+            bestLag = lag;
+        }
+    }
+
+    if (!bestLag.has_value()) {
+        return std::nullopt;
+    }
+    return static_cast<int>(bestLag.value() * 1000 / s_envelopeRate);
+}
+
+}  // namespace
+
+std::filesystem::path AnalysisManager::statePath() {
+    return NongManager::get().baseNongsPath() / "analysis.json";
+}
+
+std::optional<AnalysisManager::FileKey> AnalysisManager::statFile(
+    const std::filesystem::path& path) {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return FileKey{
+        .hash = "",
+        .size = size,
+        .modified = static_cast<std::int64_t>(
+            modified.time_since_epoch().count())};
+}
+
+void AnalysisManager::init() {
+    const std::filesystem::path path = this->statePath();
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        return;
+    }
+
+    Result<std::string> contents = file::readString(path);
+    if (contents.isErr()) {
+        log::warn("Couldn't read {}: {}", path.string(), contents.unwrapErr());
+        return;
+    }
+    Result<matjson::Value> parsed = matjson::parse(contents.unwrap());
+    if (parsed.isErr() || !parsed.unwrap()["analyses"].isObject() ||
+        !parsed.unwrap()["files"].isObject()) {
+        log::warn("Ignoring invalid {}", path.string());
+        return;
+    }
+    const matjson::Value& json = parsed.unwrap();
+
+    std::lock_guard lock(m_mutex);
+    for (const auto& [hash, value] : json["analyses"]) {
+        if (!value["duration"].isNumber()) {
+            continue;
+        }
+        Analysis analysis;
+        analysis.durationMs =
+            static_cast<std::uint32_t>(value["duration"].asInt().unwrapOr(0));
+        if (value["loudness"].isNumber()) {
+            analysis.loudness = value["loudness"].asDouble().unwrap();
+        }
+        if (value["offsets"].isObject()) {
+            for (const auto& [id, offset] : value["offsets"]) {
+                // A hand-edited key is skipped rather than thrown on
+                int songID = 0;
+                auto [end, ec] = std::from_chars(
+                    id.data(), id.data() + id.size(), songID);
+                if (ec != std::errc() || end != id.data() + id.size()) {
+                    continue;
+                }
+                std::optional<int> ms;
+                if (offset.isNumber()) {
+                    ms = static_cast<int>(offset.asInt().unwrap());
+                }
+                analysis.offsets.emplace(songID, ms);
+            }
+        }
+        m_analyses.emplace(hash, std::move(analysis));
+    }
+
+    for (const auto& [file, value] : json["files"]) {
+        if (!value["hash"].isString() || !value["size"].isNumber() ||
+            !value["modified"].isNumber()) {
+            continue;
+        }
+        m_files.insert_or_assign(
+            file, FileKey{.hash = value["hash"].asString().unwrap(),
+                          .size = static_cast<std::uintmax_t>(
+                              value["size"].asInt().unwrap()),
+                          .modified = value["modified"].asInt().unwrap()});
+    }
+}
+
+std::optional<AnalysisManager::Analysis> AnalysisManager::find(
+    const std::filesystem::path& path) {
+    auto it = m_files.find(toUtf8(path));
+    if (it == m_files.end()) {
+        return std::nullopt;
+    }
+
+    std::optional<FileKey> now = statFile(path);
+    if (!now || now->size != it->second.size ||
+        now->modified != it->second.modified) {
+        // Replaced since, analyzed again on the next request
+        m_files.erase(it);
+        m_dirty = true;
+        return std::nullopt;
+    }
+
+    std::lock_guard lock(m_mutex);
+    auto analysis = m_analyses.find(it->second.hash);
+    if (analysis == m_analyses.end()) {
+        return std::nullopt;
+    }
+    return analysis->second;
+}
+
+void AnalysisManager::request(int gdSongID,
+                              const std::filesystem::path& path) {
+    if (!Mod::get()->getSettingValue<bool>("song-analysis")) {
+        return;
+    }
+
+    std::string key = toUtf8(path);
+    if (m_pending.contains(key)) {
+        return;
+    }
+
+    std::optional<std::filesystem::path> reference;
+    if (std::optional<Nongs*> nongs = NongManager::get().getNongs(gdSongID)) {
+        std::optional<std::filesystem::path> defaultPath =
+            nongs.value()->defaultSong()->path();
+        std::error_code ec;
+        if (defaultPath.has_value() && defaultPath.value() != path &&
+            std::filesystem::exists(defaultPath.value(), ec)) {
+            reference = std::move(defaultPath);
+        }
+    }
+
+    if (std::optional<Analysis> cached = this->find(path)) {
+        if (!reference.has_value() || cached->offsets.contains(gdSongID)) {
+            return;
+        }
+    }
+
+    m_pending.insert(std::move(key));
+    m_worker.post([this, job = Job{gdSongID, path, std::move(reference)}]() {
+        this->run(job);
+    });
+}
+
+const std::vector<float>* AnalysisManager::referenceEnvelope(
+    const std::filesystem::path& path) {
+    if (!m_reference.has_value() || m_reference->path != path) {
+        m_reference.reset();
+        std::optional<Decoded> decoded = decode(m_system, path, false);
+        if (!decoded.has_value()) {
+            return nullptr;
+        }
+        m_reference = Reference{path, std::move(decoded->envelope)};
+    }
+    return &m_reference->envelope;
+}
+
+void AnalysisManager::run(Job job) {
+    ProfileScope profile("AnalysisManager::run");
+    auto done = [this, &job](std::optional<FileKey> key) {
+        Executor::get().postMain(
+            [this, path = job.path, key = std::move(key)]() {
+                std::string file = toUtf8(path);
+                m_pending.erase(file);
+                if (!key.has_value()) {
+                    return;
+                }
+                m_files.insert_or_assign(std::move(file), key.value());
+                m_dirty = true;
+                this->flush();
+                event::SongAnalyzed(path).post();
+            });
+    };
+
+    std::optional<FileKey> key = statFile(job.path);
+    std::optional<std::string> hash = Sha256::hashFile(job.path);
+    if (!key.has_value() || !hash.has_value()) {
+        return done(std::nullopt);
+    }
+    key->hash = hash.value();
+
+    std::optional<Analysis> cached;
+    {
+        std::lock_guard lock(m_mutex);
+        if (auto it = m_analyses.find(key->hash); it != m_analyses.end()) {
+            cached = it->second;
+        }
+    }
+
+    const bool needsOffset =
+        job.reference.has_value() &&
+        (!cached || !cached->offsets.contains(job.gdSongID));
+    if (cached.has_value() && !needsOffset) {
+        return done(std::move(key));
+    }
+
+    if (!m_system) {
+        FMOD::System* system = nullptr;
+        if (FMOD::System_Create(&system) != FMOD_OK ||
+            system->setOutput(FMOD_OUTPUTTYPE_NOSOUND_NRT) != FMOD_OK ||
+            system->init(1, FMOD_INIT_NORMAL, nullptr) != FMOD_OK) {
+            log::error("Couldn't create the FMOD system for song analysis");
+            if (system) {
+                system->release();
+            }
+            return done(std::nullopt);
+        }
+        m_system = system;
+    }
+
+    std::optional<Decoded> decoded =
+        decode(m_system, job.path, !cached.has_value());
+    if (!decoded.has_value()) {
+        log::warn("Couldn't decode {} for analysis", toUtf8(job.path));
+        return done(std::nullopt);
+    }
+
+    Analysis analysis = cached.value_or(Analysis{});
+    if (!cached.has_value()) {
+        analysis.durationMs = decoded->durationMs;
+        analysis.loudness = decoded->loudness;
+    }
+    std::optional<std::optional<int>> offset;
+    if (needsOffset) {
+        if (const std::vector<float>* reference =
+                this->referenceEnvelope(job.reference.value())) {
+            offset = bestOffset(decoded->envelope, *reference);
+        }
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        Analysis& stored =
+            m_analyses.try_emplace(key->hash, std::move(analysis))
+                .first->second;
+        if (offset.has_value()) {
+            stored.offsets.insert_or_assign(job.gdSongID, offset.value());
+        }
+    }
+    done(std::move(key));
+}
+
+void AnalysisManager::flush(bool wait) {
+    if (m_dirty) {
+        m_dirty = false;
+
+        matjson::Value analyses = matjson::Value::object();
+        {
+            std::lock_guard lock(m_mutex);
+            for (const auto& [hash, analysis] : m_analyses) {
+                matjson::Value offsets = matjson::Value::object();
+                for (const auto& [id, offset] : analysis.offsets) {
+                    offsets.set(std::to_string(id),
+                                offset.has_value() ? matjson::Value(*offset)
+                                                   : matjson::Value());
+                }
+                analyses.set(
+                    hash,
+                    matjson::makeObject(
+                        {{"duration", analysis.durationMs},
+                         {"loudness", analysis.loudness.has_value()
+                                          ? matjson::Value(*analysis.loudness)
+                                          : matjson::Value()},
+                         {"offsets", std::move(offsets)}}));
+            }
+        }
+
+        matjson::Value files = matjson::Value::object();
+        for (const auto& [path, key] : m_files) {
+            files.set(path, matjson::makeObject({{"hash", key.hash},
+                                                 {"size", key.size},
+                                                 {"modified", key.modified}}));
+        }
+
+        std::string json =
+            matjson::makeObject({{"analyses", std::move(analyses)},
+                                 {"files", std::move(files)}})
+                .dump(matjson::NO_INDENTATION);
+
+        m_writer.post([path = this->statePath(), json = std::move(json)]() {
+            if (Result<> r = write_file_atomic(path, json); r.isErr()) {
+                log::error("Couldn't save the song analyses: {}",
+                           r.unwrapErr());
+            }
+        });
+    }
+
+    if (wait) {
+        m_writer.drain();
+    }
+}
+
+}  // namespace jukebox
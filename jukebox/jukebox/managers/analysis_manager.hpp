@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <jukebox/utils/executor.hpp>
+#include <jukebox/utils/serial_queue.hpp>
+#include <jukebox/utils/string_hash.hpp>
+
+namespace FMOD {
+class System;
+}
+
+namespace jukebox {
+
+/**
+ * Decodes each NONG once in the background to find its duration, its
+ * integrated loudness, and the start offset lining it up with the default
+ * song. Results are stored by the SHA-256 of the file, so songs sharing a
+ * file are only decoded once, and they stay cached across sessions.
+ */
+class AnalysisManager {
+public:
+    struct Analysis {
+        std::uint32_t durationMs = 0;
+        // LUFS, std::nullopt for silence
+        std::optional<double> loudness;
+        // GD song ID -> suggested start offset in ms, std::nullopt if the
+        // song doesn't resemble the default song enough to tell
+        std::unordered_map<int, std::optional<int>> offsets;
+    };
+
+protected:
+    // What a song file looked like when it was hashed
+    struct FileKey {
+        std::string hash;
+        std::uintmax_t size;
+        std::int64_t modified;
+    };
+
+    struct Job {
+        int gdSongID;
+        std::filesystem::path path;
+        std::optional<std::filesystem::path> reference;
+    };
+
+    // Envelope of the last default song compared against, worker thread only
+    struct Reference {
+        std::filesystem::path path;
+        std::vector<float> envelope;
+    };
+
+    // Guards m_analyses, the worker looks results up by hash
+    std::mutex m_mutex;
+    // file hash -> analysis
+    std::unordered_map<std::string, Analysis> m_analyses;
+    // song file path -> hash, main thread only
+    StringMap<FileKey> m_files;
+    // Song file paths queued for the worker, main thread only
+    std::unordered_set<std::string> m_pending;
+    bool m_dirty = false;
+
+    // m_worker only. A separate non-realtime system, so decoding never
+    // competes with what GD plays
+    FMOD::System* m_system = nullptr;
+    std::optional<Reference> m_reference;
+
+    SerialQueue m_writer;
+    // Analysis is the bulkiest work there is, it runs whenever nothing more
+    // urgent is queued
+    Executor::Strand m_worker{Executor::Priority::Bulk};
+
+    AnalysisManager() = default;
+
+    AnalysisManager(const AnalysisManager&) = delete;
+    AnalysisManager(AnalysisManager&&) = delete;
+
+    AnalysisManager& operator=(const AnalysisManager&) = delete;
+    AnalysisManager& operator=(AnalysisManager&&) = delete;
+
+    std::filesystem::path statePath();
+    static std::optional<FileKey> statFile(const std::filesystem::path& path);
+    // m_worker only
+    void run(Job job);
+    // m_worker only
+    const std::vector<float>* referenceEnvelope(
+        const std::filesystem::path& path);
+
+public:
+    /**
+     * Reads the analyses stored by the last session
+     */
+    void init();
+
+    /**
+     * Cached analysis of a song file. Only stats the file, so it's cheap
+     * enough for building list cells.
+     *
+     * @return std::nullopt if the file wasn't analyzed yet or changed since
+     */
+    std::optional<Analysis> find(const std::filesystem::path& path);
+
+    /**
+     * Queues a song file to be analyzed, if song analysis is enabled and it
+     * isn't cached yet. event::SongAnalyzed is posted once it's done.
+     *
+     * @param gdSongID the GD song the file is a NONG for, its default song
+     * is what the suggested offset lines up with
+     * @param path the song file
+     */
+    void request(int gdSongID, const std::filesystem::path& path);
+
+    /**
+     * Writes the analyses if any changed
+     *
+     * @param wait block until they're on disk
+     */
+    void flush(bool wait = false);
+
+    /**
+     * Like flush(true), but stops waiting at the deadline
+     *
+     * @return whether the analyses are on disk
+     */
+    bool flushUntil(std::chrono::steady_clock::time_point deadline) {
+        this->flush();
+        return m_writer.drainUntil(deadline);
+    }
+
+    static AnalysisManager& get() {
+        static AnalysisManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
@@ -0,0 +1,274 @@
+#include <jukebox/managers/audio_cache_manager.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+#include <Geode/utils/file.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/shared_library.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+std::int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+std::string toUtf8(const std::filesystem::path& path) {
+    const std::u8string str = path.u8string();
+    return std::string(str.begin(), str.end());
+}
+
+std::filesystem::path fromUtf8(std::string_view str) {
+    return std::filesystem::path(std::u8string(str.begin(), str.end()));
+}
+
+// 0 means no limit
+std::uintmax_t cacheBudget() {
+    const int64_t megabytes = std::max<int64_t>(
+        0, Mod::get()->getSettingValue<int64_t>("nong-cache-budget"));
+    return static_cast<std::uintmax_t>(megabytes) * 1024 * 1024;
+}
+
+}  // namespace
+
+bool AudioCacheManager::hasRoomFor(std::uintmax_t bytes) const {
+    const std::uintmax_t budget = cacheBudget();
+    return budget == 0 || m_totalSize + bytes <= budget;
+}
+
+std::filesystem::path AudioCacheManager::statePath() {
+    return NongManager::get().baseNongsPath() / "cache.json";
+}
+
+void AudioCacheManager::init() {
+    const std::filesystem::path path = this->statePath();
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        return;
+    }
+
+    Result<std::string> contents = file::readString(path);
+    if (contents.isErr()) {
+        log::warn("Couldn't read {}: {}", path.string(), contents.unwrapErr());
+        return;
+    }
+    Result<matjson::Value> parsed = matjson::parse(contents.unwrap());
+    if (parsed.isErr() || !parsed.unwrap()["songs"].isArray()) {
+        log::warn("Ignoring invalid {}", path.string());
+        return;
+    }
+
+    for (const matjson::Value& song : parsed.unwrap()["songs"]) {
+        if (!song["path"].isString() || !song["song_id"].isNumber() ||
+            !song["unique_id"].isString()) {
+            continue;
+        }
+        std::string songPath = song["path"].asString().unwrap();
+        // Deleted since, by the user or another eviction
+        const std::uintmax_t size =
+            std::filesystem::file_size(fromUtf8(songPath), ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        m_totalSize += size;
+        m_entries.insert_or_assign(
+            std::move(songPath),
+            Entry{.gdSongID =
+                      static_cast<int>(song["song_id"].asInt().unwrap()),
+                  .uniqueID = song["unique_id"].asString().unwrap(),
+                  .size = size,
+                  .lastPlayed = song["last_played"].asInt().unwrapOr(0)});
+    }
+
+    this->evict();
+}
+
+void AudioCacheManager::track(int gdSongID, const std::string& uniqueID,
+                              const std::filesystem::path& path) {
+    // Songs from a shared library take no space of this install
+    if (SharedLibrary::get().contains(path)) {
+        return;
+    }
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+
+    std::string key = toUtf8(path);
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        if (!it->second.shared) {
+            m_totalSize -= it->second.size;
+        }
+        m_entries.erase(it);
+    }
+    m_totalSize += size;
+    m_entries.emplace(std::move(key), Entry{.gdSongID = gdSongID,
+                                            .uniqueID = uniqueID,
+                                            .size = size,
+                                            .lastPlayed = unixNow()});
+    m_dirty = true;
+
+    this->evict();
+    this->flush();
+}
+
+void AudioCacheManager::touch(std::string_view path) {
+    auto it = m_entries.find(path);
+    if (it == m_entries.end()) {
+        return;
+    }
+    it->second.lastPlayed = unixNow();
+    m_dirty = true;
+}
+
+void AudioCacheManager::evict() {
+    const std::uintmax_t budget = cacheBudget();
+    if (budget == 0 || m_totalSize <= budget) {
+        return;
+    }
+
+    // Blobs are linked in the background, so which paths share a file is
+    // only worked out here. Only files of the same size can be the same.
+    struct Group {
+        std::vector<StringMap<Entry>::iterator> members;
+        std::uintmax_t size;
+        std::int64_t lastPlayed;
+    };
+    std::vector<Group> groups;
+    std::unordered_map<std::uintmax_t, std::vector<std::size_t>> bySize;
+    m_totalSize = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        Entry& entry = it->second;
+        const std::filesystem::path path = fromUtf8(it->first);
+        std::error_code ec;
+        const bool linked = std::filesystem::hard_link_count(path, ec) > 1;
+
+        std::vector<std::size_t>& candidates = bySize[entry.size];
+        auto group = std::find_if(
+            candidates.begin(), candidates.end(), [&](std::size_t i) {
+                std::error_code equivalentEc;
+                return linked &&
+                       std::filesystem::equivalent(
+                           path, fromUtf8(groups[i].members.front()->first),
+                           equivalentEc);
+            });
+        entry.shared = group != candidates.end();
+        if (entry.shared) {
+            Group& shared = groups[*group];
+            shared.members.push_back(it);
+            shared.lastPlayed = std::max(shared.lastPlayed, entry.lastPlayed);
+            continue;
+        }
+        candidates.push_back(groups.size());
+        groups.push_back(Group{.members = {it},
+                               .size = entry.size,
+                               .lastPlayed = entry.lastPlayed});
+        m_totalSize += entry.size;
+    }
+    m_dirty = true;
+    if (m_totalSize <= budget) {
+        return;
+    }
+
+    std::sort(groups.begin(), groups.end(),
+              [](const Group& a, const Group& b) {
+                  return a.lastPlayed < b.lastPlayed;
+              });
+
+    const PreparedTrack* playing = NongManager::get().playingTrack();
+    for (const Group& group : groups) {
+        if (m_totalSize <= budget) {
+            break;
+        }
+        if (playing &&
+            std::any_of(group.members.begin(), group.members.end(),
+                        [playing](auto it) {
+                            return std::string_view(
+                                       playing->filename.c_str()) ==
+                                   it->first;
+                        })) {
+            continue;
+        }
+
+        bool evicted = true;
+        for (auto it : group.members) {
+            const Entry& entry = it->second;
+            std::error_code ec;
+            if (!std::filesystem::exists(fromUtf8(it->first), ec)) {
+                m_entries.erase(it);
+                continue;
+            }
+            Result<> r = NongManager::get().deleteSongAudio(
+                entry.gdSongID,
+                UniqueID::find(entry.uniqueID).value_or(UniqueID()));
+            if (r.isErr()) {
+                log::warn("Couldn't evict {}: {}", entry.uniqueID,
+                          r.unwrapErr());
+                evicted = false;
+                continue;
+            }
+            log::info("Evicted {} to stay within the NONG cache budget",
+                      entry.uniqueID);
+            m_entries.erase(it);
+        }
+        // The file stays on disk while any path still links to it
+        if (evicted) {
+            m_totalSize -= group.size;
+        }
+    }
+}
+
+void AudioCacheManager::flush(bool wait) {
+    if (m_dirty) {
+        m_dirty = false;
+
+        std::vector<matjson::Value> songs;
+        songs.reserve(m_entries.size());
+        for (const auto& [path, entry] : m_entries) {
+            songs.push_back(matjson::makeObject({
+                {"path", path},
+                {"song_id", entry.gdSongID},
+                {"unique_id", entry.uniqueID},
+                {"last_played", entry.lastPlayed},
+            }));
+        }
+        std::string json =
+            matjson::makeObject({{"songs", std::move(songs)}})
+                .dump(matjson::NO_INDENTATION);
+
+        m_writer.post([path = this->statePath(), json = std::move(json)]() {
+            if (Result<> r = write_file_atomic(path, json); r.isErr()) {
+                log::error("Couldn't save the NONG cache state: {}",
+                           r.unwrapErr());
+            }
+        });
+    }
+
+    if (wait) {
+        m_writer.drain();
+    }
+}
+
+}  // namespace jukebox
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include <jukebox/utils/serial_queue.hpp>
+#include <jukebox/utils/string_hash.hpp>
+
+namespace jukebox {
+
+/**
+ * Keeps downloaded NONG audio within the disk budget set in the mod
+ * settings. The least recently played downloads are evicted first with
+ * deleteSongAudio, so their metadata stays and they can be downloaded again.
+ * Local songs are never evicted.
+ */
+class AudioCacheManager {
+protected:
+    struct Entry {
+        int gdSongID;
+        std::string uniqueID;
+        std::uintmax_t size;
+        // Unix seconds
+        std::int64_t lastPlayed;
+        // Hardlinked to the same blob as an entry that counts the size
+        bool shared = false;
+    };
+
+    // UTF-8 song file path, as GD has it -> downloaded song stored there
+    StringMap<Entry> m_entries;
+    // Each file once, as far as the last eviction found out
+    std::uintmax_t m_totalSize = 0;
+    bool m_dirty = false;
+    SerialQueue m_writer;
+
+    AudioCacheManager() = default;
+
+    AudioCacheManager(const AudioCacheManager&) = delete;
+    AudioCacheManager(AudioCacheManager&&) = delete;
+
+    AudioCacheManager& operator=(const AudioCacheManager&) = delete;
+    AudioCacheManager& operator=(AudioCacheManager&&) = delete;
+
+    std::filesystem::path statePath();
+    /**
+     * Deletes the audio of the least recently played downloads until the
+     * total fits the budget. Paths hardlinked to one blob are counted and
+     * evicted together, deleting only some of them frees nothing.
+     */
+    void evict();
+
+public:
+    /**
+     * Reads the play times stored by the last session
+     */
+    void init();
+
+    /**
+     * Starts tracking a downloaded song file, evicting older ones if the
+     * budget is exceeded
+     */
+    void track(int gdSongID, const std::string& uniqueID,
+               const std::filesystem::path& path);
+
+    /**
+     * Marks a song file as just played. Called every time GD gets a path,
+     * so it's only a lookup
+     */
+    void touch(std::string_view path);
+
+    /**
+     * Whether bytes more of downloads fit the budget without evicting any
+     */
+    bool hasRoomFor(std::uintmax_t bytes) const;
+
+    /**
+     * Writes the play times if any changed
+     *
+     * @param wait block until they're on disk
+     */
+    void flush(bool wait = false);
+
+    /**
+     * Like flush(true), but stops waiting at the deadline
+     *
+     * @return whether the play times are on disk
+     */
+    bool flushUntil(std::chrono::steady_clock::time_point deadline) {
+        this->flush();
+        return m_writer.drainUntil(deadline);
+    }
+
+    static AudioCacheManager& get() {
+        static AudioCacheManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
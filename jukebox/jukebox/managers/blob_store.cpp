@@ -0,0 +1,245 @@
+#include <jukebox/managers/blob_store.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <Geode/loader/Log.hpp>
+
+#include <jukebox/managers/file_status_cache.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/shared_library.hpp>
+#include <jukebox/utils/sha256.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+std::filesystem::path BlobStore::blobsPath() {
+    return NongManager::get().baseNongsPath() / "blobs";
+}
+
+void BlobStore::intern(std::filesystem::path path) {
+    // Shared libraries are read-only
+    if (SharedLibrary::get().contains(path)) {
+        return;
+    }
+    // Just written, whatever was cached for it is stale
+    FileStatusCache::get().invalidate(path);
+    m_worker.post([this, path = std::move(path), blobs = this->blobsPath()]() {
+        this->share(path, blobs);
+    });
+}
+
+void BlobStore::rememberHash(const std::filesystem::path& path,
+                             std::string sha256) {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+    const std::filesystem::file_time_type modified =
+        std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return;
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_knownHashes.insert_or_assign(
+        path.native(), KnownHash{size, modified, std::move(sha256)});
+}
+
+std::error_code BlobStore::remove(const std::filesystem::path& path) {
+    std::error_code ec;
+    // Other installs may use it, the song just stops pointing at it
+    if (SharedLibrary::get().contains(path)) {
+        return ec;
+    }
+    bool shared = false;
+    {
+        std::lock_guard lock(m_mutex);
+        if (!FileStatusCache::get().exists(path)) {
+            return ec;
+        }
+        const std::uintmax_t links = std::filesystem::hard_link_count(path, ec);
+        shared = !ec && links > 1;
+        ec.clear();
+        std::filesystem::remove(path, ec);
+    }
+    FileStatusCache::get().invalidate(path);
+
+    if (!ec && shared) {
+        m_worker.post(
+            [this, blobs = this->blobsPath()]() { this->collect(blobs); });
+    }
+    return ec;
+}
+
+void BlobStore::removeLater(std::vector<std::filesystem::path> paths) {
+    std::vector<QueuedRemoval> queued;
+    queued.reserve(paths.size());
+    for (std::filesystem::path& path : paths) {
+        // Other installs may use it, the song just stops pointing at it
+        if (SharedLibrary::get().contains(path)) {
+            continue;
+        }
+        // Gone already, or queued by an earlier call
+        std::optional<FileStatus> status = FileStatusCache::get().status(path);
+        if (!status.has_value()) {
+            continue;
+        }
+        FileStatusCache::get().markRemoving(path);
+        queued.push_back(QueuedRemoval{std::move(path), status->modified});
+    }
+
+    const std::filesystem::path blobs = this->blobsPath();
+    for (std::size_t start = 0; start < queued.size();
+         start += s_removalBatch) {
+        const std::size_t end = std::min(queued.size(), start + s_removalBatch);
+        std::vector<QueuedRemoval> batch(
+            std::make_move_iterator(queued.begin() + start),
+            std::make_move_iterator(queued.begin() + end));
+        m_worker.post([this, batch = std::move(batch), blobs]() {
+            this->removeBatch(batch, blobs);
+        });
+    }
+}
+
+void BlobStore::removeBatch(const std::vector<QueuedRemoval>& batch,
+                            const std::filesystem::path& blobs) {
+    bool shared = false;
+    for (const QueuedRemoval& removal : batch) {
+        std::error_code ec;
+        {
+            std::lock_guard lock(m_mutex);
+            const std::filesystem::directory_entry entry(removal.path, ec);
+            // A download or import may have written it again since
+            if (!ec && entry.exists(ec) &&
+                entry.last_write_time(ec) == removal.modified) {
+                const std::uintmax_t links = entry.hard_link_count(ec);
+                shared = shared || (!ec && links > 1);
+                ec.clear();
+                std::filesystem::remove(removal.path, ec);
+            }
+        }
+        FileStatusCache::get().invalidate(removal.path);
+        if (ec) {
+            log::error("Couldn't delete {}: {}",
+                       removal.path.filename().string(), ec.message());
+        }
+    }
+
+    if (shared) {
+        this->collect(blobs);
+    }
+}
+
+void BlobStore::share(const std::filesystem::path& path,
+                      const std::filesystem::path& blobs) {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+    const std::filesystem::file_time_type modified =
+        std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return;
+    }
+
+    // A hash checked during the download saves reading the file again
+    std::optional<std::string> hash;
+    {
+        std::lock_guard lock(m_mutex);
+        if (auto it = m_knownHashes.find(path.native());
+            it != m_knownHashes.end()) {
+            if (it->second.size == size && it->second.modified == modified) {
+                hash = std::move(it->second.sha256);
+            }
+            m_knownHashes.erase(it);
+        }
+    }
+
+    // Hashed without the lock, files can be large
+    if (!hash.has_value()) {
+        hash = Sha256::hashFile(path);
+    }
+    if (!hash.has_value()) {
+        return;
+    }
+    const std::filesystem::path blob = blobs / hash.value();
+
+    std::lock_guard lock(m_mutex);
+
+    // The song may have been deleted or replaced while it was hashed
+    if (std::filesystem::file_size(path, ec) != size || ec ||
+        std::filesystem::last_write_time(path, ec) != modified || ec) {
+        return;
+    }
+
+    if (!std::filesystem::exists(blob, ec)) {
+        std::filesystem::create_directories(blobs, ec);
+        std::filesystem::create_hard_link(path, blob, ec);
+        if (ec) {
+            log::warn("Couldn't add {} to the blob store: {}",
+                      path.filename().string(), ec.message());
+        }
+        return;
+    }
+
+    if (std::filesystem::equivalent(path, blob, ec) || ec) {
+        return;
+    }
+    if (std::filesystem::file_size(blob, ec) != size || ec) {
+        log::warn("Blob {} doesn't match the size of {}", hash.value(),
+                  path.filename().string());
+        return;
+    }
+
+    // Linked next to the song, then swapped in, so the song file never goes
+    // missing in between
+    std::filesystem::path link = path;
+    link += ".link";
+    std::filesystem::remove(link, ec);
+    std::filesystem::create_hard_link(blob, link, ec);
+    if (ec) {
+        return;
+    }
+    std::filesystem::rename(link, path, ec);
+    FileStatusCache::get().invalidate(path);
+    if (ec) {
+        // Likely open for playback, it's shared on a later intern instead
+        std::error_code removeEc;
+        std::filesystem::remove(link, removeEc);
+        return;
+    }
+    log::debug("Shared {} with blob {}", path.filename().string(),
+               hash.value());
+}
+
+void BlobStore::collect(const std::filesystem::path& blobs) {
+    std::error_code ec;
+    if (!std::filesystem::exists(blobs, ec)) {
+        return;
+    }
+
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(blobs, ec)) {
+        std::error_code entryEc;
+        // Only the blob itself is left
+        if (entry.is_regular_file(entryEc) &&
+            entry.hard_link_count(entryEc) == 1 && !entryEc) {
+            std::filesystem::remove(entry.path(), entryEc);
+        }
+    }
+}
+
+}  // namespace jukebox
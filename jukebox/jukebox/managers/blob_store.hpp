@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <jukebox/utils/serial_queue.hpp>
+
+namespace jukebox {
+
+/**
+ * Shares one copy of identical NONG files. Every stored file is hashed in
+ * the background and hardlinked to a blob named after its SHA-256, so songs
+ * mapped to many GD song IDs keep a single copy on disk. The link count of
+ * the blob is its reference count: a blob is removed once no song file
+ * links to it anymore.
+ *
+ * Song files keep their own paths, nothing in the manifest changes. Files
+ * on filesystems without hardlinks are left as they are.
+ */
+class BlobStore {
+protected:
+    // Held while song files are linked or removed
+    std::mutex m_mutex;
+    SerialQueue m_worker;
+
+    struct KnownHash {
+        std::uintmax_t size;
+        std::filesystem::file_time_type modified;
+        std::string sha256;
+    };
+
+    // song file -> hash it was verified against while downloading. Only
+    // trusted while the file is still the one that was verified
+    std::unordered_map<std::filesystem::path::string_type, KnownHash>
+        m_knownHashes;
+
+    struct QueuedRemoval {
+        std::filesystem::path path;
+        // When the file was queued, a file written over it since is kept
+        std::filesystem::file_time_type modified;
+    };
+
+    // Removals per worker job, so interning isn't held up behind a long
+    // list of them
+    constexpr static inline std::size_t s_removalBatch = 16;
+
+    BlobStore() = default;
+
+    BlobStore(const BlobStore&) = delete;
+    BlobStore(BlobStore&&) = delete;
+
+    BlobStore& operator=(const BlobStore&) = delete;
+    BlobStore& operator=(BlobStore&&) = delete;
+
+    std::filesystem::path blobsPath();
+    // Worker thread only
+    void share(const std::filesystem::path& path,
+               const std::filesystem::path& blobs);
+    // Worker thread only
+    void collect(const std::filesystem::path& blobs);
+    // Worker thread only
+    void removeBatch(const std::vector<QueuedRemoval>& batch,
+                     const std::filesystem::path& blobs);
+
+public:
+    /**
+     * Queues a song file to be linked to the blob with the same content,
+     * replacing it if there is one already
+     *
+     * @param path the song file, needs to be in the nongs directory
+     */
+    void intern(std::filesystem::path path);
+
+    /**
+     * Records the hash a song file was verified against, so intern doesn't
+     * hash it again. Forgotten if the file changes before it's interned.
+     */
+    void rememberHash(const std::filesystem::path& path, std::string sha256);
+
+    /**
+     * Removes a song file. Its blob is removed in the background once no
+     * other song file links to it.
+     *
+     * @return the error removing the song file, if any
+     */
+    std::error_code remove(const std::filesystem::path& path);
+
+    /**
+     * Queues song files to be removed on the worker thread, in batches.
+     * They're reported missing by the file status cache right away, and
+     * their blobs are collected once the batch is done.
+     */
+    void removeLater(std::vector<std::filesystem::path> paths);
+
+    static BlobStore& get() {
+        static BlobStore instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
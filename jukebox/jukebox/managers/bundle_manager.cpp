@@ -0,0 +1,659 @@
+#include <jukebox/managers/bundle_manager.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/binding/FLAlertLayer.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/utils/Task.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/events/manual_song_added.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/managers/audio_cache_manager.hpp>
+#include <jukebox/managers/blob_store.hpp>
+#include <jukebox/managers/file_status_cache.hpp>
+#include <jukebox/managers/index_manager.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/shared_library.hpp>
+#include <jukebox/nong/nong.hpp>
+#include <jukebox/nong/nong_parser.hpp>
+#include <jukebox/nong/nong_serialize.hpp>
+#include <jukebox/utils/binary_stream.hpp>
+#include <jukebox/utils/executor.hpp>
+#include <jukebox/utils/parallel_for.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+// Magic, version, padding, then the offset and size of the table of contents
+constexpr std::size_t s_headerSize = 4 + 2 + 2 + 8 + 8;
+
+std::string toUtf8(const std::filesystem::path& path) {
+    const std::u8string str = path.u8string();
+    return std::string(str.begin(), str.end());
+}
+
+// Entries are unpacked by name into a folder, so a name can't reach out of
+// it
+bool isPlainFilename(std::string_view name) {
+    return !name.empty() && name != "." && name != ".." &&
+           name.find_first_of("/\\:") == std::string_view::npos;
+}
+
+bool copyBytes(std::istream& in, std::ostream& out, std::uint64_t size,
+               std::vector<char>& buffer) {
+    while (size > 0) {
+        const std::size_t chunk =
+            static_cast<std::size_t>(std::min<std::uint64_t>(size,
+                                                             buffer.size()));
+        in.read(buffer.data(), static_cast<std::streamsize>(chunk));
+        if (static_cast<std::size_t>(in.gcount()) != chunk) {
+            return false;
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(chunk));
+        if (!out) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+// The songs of a Nongs that have their own file, the default song is GD's
+void forEachSong(Nongs& nongs, auto&& fn) {
+    nongs.songs().forEach([&fn](Song& song) { fn(&song); });
+}
+
+}  // namespace
+
+Result<> BundleManager::exportBundle(const std::vector<int>& gdSongIDs,
+                                     std::filesystem::path destination) {
+    if (m_progress.has_value()) {
+        return Err("A bundle is already being exported or imported");
+    }
+
+    const std::filesystem::path nongsPath =
+        NongManager::get().baseNongsPath().lexically_normal();
+    std::vector<ExportEntry> entries;
+    std::unordered_set<std::string> songFiles;
+    for (int id : gdSongIDs) {
+        std::optional<Nongs*> nongs = NongManager::get().getNongs(id);
+        if (!nongs.has_value()) {
+            continue;
+        }
+        entries.push_back(ExportEntry{
+            .kind = EntryKind::Manifest,
+            .gdSongID = id,
+            .name = fmt::format("{}.json", id),
+            .data = matjson::Serialize<Nongs>::toJson(*nongs.value())
+                        .dump(matjson::NO_INDENTATION)});
+
+        // Only files the mod stored itself, missing ones are skipped while
+        // writing
+        forEachSong(*nongs.value(), [&](Song* song) {
+            std::optional<std::filesystem::path> path = song->path();
+            if (!path.has_value() ||
+                path->lexically_normal().parent_path() != nongsPath) {
+                return;
+            }
+            std::string name = toUtf8(path->filename());
+            if (!songFiles.insert(name).second) {
+                return;
+            }
+            entries.push_back(ExportEntry{.kind = EntryKind::Song,
+                                          .gdSongID = id,
+                                          .name = std::move(name),
+                                          .source = path.value()});
+        });
+    }
+    if (entries.empty()) {
+        return Err("None of the songs have NONGs to export");
+    }
+
+    std::error_code ec;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(
+             IndexManager::get().baseIndexesPath(), ec)) {
+        std::error_code fileEc;
+        // Copies being written are left out
+        if (!entry.is_regular_file(fileEc) ||
+            entry.path().extension() == ".part") {
+            continue;
+        }
+        entries.push_back(
+            ExportEntry{.kind = EntryKind::IndexCache,
+                        .name = toUtf8(entry.path().filename()),
+                        .source = entry.path()});
+    }
+
+    m_progress =
+        Progress{.importing = false, .finished = 0, .total = entries.size()};
+    m_exportListener.bind(this, &BundleManager::onExportEvent);
+    m_exportListener.setFilter(
+        writeBundle(std::move(entries), std::move(destination)));
+    return Ok();
+}
+
+BundleManager::ExportTask BundleManager::writeBundle(
+    std::vector<ExportEntry> entries, std::filesystem::path destination) {
+    return Executor::get().run<ExportTask>(
+        Executor::Priority::Bulk,
+        [entries = std::move(entries), destination = std::move(destination)](
+            auto progress, auto hasBeenCanceled) -> ExportTask::Result {
+            std::filesystem::path part = destination;
+            part += ".part";
+            std::ofstream out(part, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                return Err("Couldn't open {} for writing",
+                           toUtf8(destination.filename()));
+            }
+            auto discard = [&out, &part]() {
+                out.close();
+                std::error_code ec;
+                std::filesystem::remove(part, ec);
+            };
+
+            // Filled in once the table of contents is written
+            const std::vector<char> header(s_headerSize, 0);
+            out.write(header.data(), header.size());
+
+            BinaryWriter toc;
+            std::uint32_t count = 0;
+            std::uint64_t offset = s_headerSize;
+            std::vector<char> buffer(s_bufferSize);
+            for (std::size_t i = 0; i < entries.size(); i++) {
+                if (hasBeenCanceled()) {
+                    discard();
+                    return ExportTask::Cancel();
+                }
+                progress(Progress{.importing = false,
+                                  .finished = i,
+                                  .total = entries.size()});
+
+                const ExportEntry& entry = entries[i];
+                std::uint64_t size = 0;
+                if (entry.kind == EntryKind::Manifest) {
+                    size = entry.data.size();
+                    out.write(entry.data.data(), entry.data.size());
+                } else {
+                    std::error_code ec;
+                    size = std::filesystem::file_size(entry.source, ec);
+                    std::ifstream in(entry.source, std::ios::binary);
+                    if (ec || !in.is_open()) {
+                        log::warn("Leaving {} out of the bundle, it can't be "
+                                  "read",
+                                  entry.name);
+                        continue;
+                    }
+                    if (!copyBytes(in, out, size, buffer)) {
+                        discard();
+                        return Err("Couldn't copy {} into the bundle",
+                                   entry.name);
+                    }
+                }
+                if (!out) {
+                    discard();
+                    return Err("Couldn't write to {}",
+                               toUtf8(destination.filename()));
+                }
+
+                toc.write<std::uint8_t>(static_cast<std::uint8_t>(entry.kind));
+                toc.write<std::int32_t>(entry.gdSongID);
+                toc.writeString(entry.name);
+                toc.write<std::uint64_t>(offset);
+                toc.write<std::uint64_t>(size);
+                offset += size;
+                count++;
+            }
+
+            BinaryWriter contents;
+            contents.write<std::uint32_t>(count);
+            contents.writeBytes(toc.buffer());
+            out.write(reinterpret_cast<const char*>(contents.buffer().data()),
+                      contents.size());
+
+            BinaryWriter head;
+            head.write<std::uint32_t>(s_magic);
+            head.write<std::uint16_t>(s_version);
+            head.write<std::uint16_t>(0);
+            head.write<std::uint64_t>(offset);
+            head.write<std::uint64_t>(contents.size());
+            out.seekp(0);
+            out.write(reinterpret_cast<const char*>(head.buffer().data()),
+                      head.size());
+            out.close();
+            if (!out) {
+                discard();
+                return Err("Couldn't write to {}",
+                           toUtf8(destination.filename()));
+            }
+
+            std::error_code ec;
+            std::filesystem::rename(part, destination, ec);
+            if (ec) {
+                discard();
+                return Err("Couldn't move bundle to {}: {}",
+                           toUtf8(destination.filename()), ec.message());
+            }
+            return Ok(static_cast<std::size_t>(count));
+        },
+        "Exporting NONG bundle");
+}
+
+Result<> BundleManager::importBundle(std::filesystem::path source) {
+    if (m_progress.has_value()) {
+        return Err("A bundle is already being exported or imported");
+    }
+
+    m_progress = Progress{.importing = true, .finished = 0, .total = 0};
+    m_importListener.bind(this, &BundleManager::onImportEvent);
+    m_importListener.setFilter(
+        readBundle(std::move(source), NongManager::get().baseNongsPath(),
+                   IndexManager::get().baseIndexesPath(),
+                   IndexManager::get().indexCacheFilenames()));
+    return Ok();
+}
+
+BundleManager::ImportTask BundleManager::readBundle(
+    std::filesystem::path source, std::filesystem::path nongsPath,
+    std::filesystem::path indexesPath,
+    std::unordered_set<std::string> indexCaches) {
+    return Executor::get().run<ImportTask>(
+        Executor::Priority::Bulk,
+        [source = std::move(source), nongsPath = std::move(nongsPath),
+         indexesPath = std::move(indexesPath),
+         indexCaches = std::move(indexCaches)](
+            auto progress, auto hasBeenCanceled) -> ImportTask::Result {
+            struct Entry {
+                EntryKind kind;
+                int gdSongID;
+                std::string name;
+                std::uint64_t offset;
+                std::uint64_t size;
+            };
+
+            std::ifstream in(source, std::ios::binary);
+            if (!in.is_open()) {
+                return Err("Couldn't open {}", toUtf8(source.filename()));
+            }
+
+            std::vector<std::uint8_t> raw(s_headerSize);
+            in.read(reinterpret_cast<char*>(raw.data()), raw.size());
+            if (static_cast<std::size_t>(in.gcount()) != raw.size()) {
+                return Err("Not a NONG bundle");
+            }
+            BinaryReader header(raw);
+            GEODE_UNWRAP_INTO(std::uint32_t magic,
+                              header.read<std::uint32_t>());
+            GEODE_UNWRAP_INTO(std::uint16_t version,
+                              header.read<std::uint16_t>());
+            GEODE_UNWRAP(header.skip(2));
+            GEODE_UNWRAP_INTO(std::uint64_t tocOffset,
+                              header.read<std::uint64_t>());
+            GEODE_UNWRAP_INTO(std::uint64_t tocSize,
+                              header.read<std::uint64_t>());
+            if (magic != s_magic) {
+                return Err("Not a NONG bundle");
+            }
+            if (version != s_version) {
+                return Err("Bundle version {} isn't supported", version);
+            }
+
+            std::error_code ec;
+            const std::uint64_t fileSize = std::filesystem::file_size(source,
+                                                                      ec);
+            if (ec || tocOffset < s_headerSize || tocOffset > fileSize ||
+                tocSize != fileSize - tocOffset) {
+                return Err("Bundle is truncated");
+            }
+
+            raw.resize(tocSize);
+            in.seekg(tocOffset);
+            in.read(reinterpret_cast<char*>(raw.data()), raw.size());
+            if (static_cast<std::size_t>(in.gcount()) != raw.size()) {
+                return Err("Bundle is truncated");
+            }
+            BinaryReader toc(raw);
+            GEODE_UNWRAP_INTO(std::uint32_t count, toc.read<std::uint32_t>());
+            std::vector<Entry> entries;
+            for (std::uint32_t i = 0; i < count; i++) {
+                Entry entry;
+                GEODE_UNWRAP_INTO(std::uint8_t kind, toc.read<std::uint8_t>());
+                GEODE_UNWRAP_INTO(entry.gdSongID, toc.read<std::int32_t>());
+                GEODE_UNWRAP_INTO(entry.name, toc.readString());
+                GEODE_UNWRAP_INTO(entry.offset, toc.read<std::uint64_t>());
+                GEODE_UNWRAP_INTO(entry.size, toc.read<std::uint64_t>());
+                if (kind > static_cast<std::uint8_t>(EntryKind::IndexCache)) {
+                    return Err("Unknown bundle entry {}", entry.name);
+                }
+                entry.kind = static_cast<EntryKind>(kind);
+                if (!isPlainFilename(entry.name) ||
+                    entry.offset < s_headerSize || entry.offset > tocOffset ||
+                    entry.size > tocOffset - entry.offset) {
+                    return Err("Invalid bundle entry {}", entry.name);
+                }
+                entries.push_back(std::move(entry));
+            }
+
+            // Manifests are small, they're read right away
+            Unpacked unpacked;
+            std::vector<const Entry*> files;
+            for (const Entry& entry : entries) {
+                if (entry.kind == EntryKind::IndexCache &&
+                    !indexCaches.contains(entry.name)) {
+                    log::info("Skipping cache {} of an index that isn't "
+                              "configured",
+                              entry.name);
+                    continue;
+                }
+                if (entry.kind != EntryKind::Manifest) {
+                    files.push_back(&entry);
+                    continue;
+                }
+                std::string json(entry.size, '\0');
+                in.seekg(entry.offset);
+                in.read(json.data(), json.size());
+                if (static_cast<std::size_t>(in.gcount()) != json.size()) {
+                    return Err("Bundle is truncated");
+                }
+                unpacked.manifests.push_back(
+                    ImportedManifest{entry.gdSongID, std::move(json)});
+            }
+            in.close();
+
+            std::filesystem::create_directories(nongsPath, ec);
+            std::filesystem::create_directories(indexesPath, ec);
+
+            enum class Unpack : std::uint8_t { Failed, Written, Present };
+
+            auto unpackEntry = [&](const Entry& entry) {
+                const bool song = entry.kind == EntryKind::Song;
+                const std::filesystem::path destination =
+                    (song ? nongsPath : indexesPath) /
+                    std::filesystem::path(
+                        std::u8string(entry.name.begin(), entry.name.end()));
+
+                std::error_code fileEc;
+                // Song files are named at random, one that is there already
+                // is the same song
+                if (song && std::filesystem::exists(destination, fileEc)) {
+                    return Unpack::Present;
+                }
+
+                std::filesystem::path part = destination;
+                part += ".part";
+                std::ifstream bundle(source, std::ios::binary);
+                std::ofstream out(part, std::ios::binary | std::ios::trunc);
+                std::vector<char> buffer(s_bufferSize);
+                bundle.seekg(entry.offset);
+                bool ok = bundle.is_open() && out.is_open() &&
+                          copyBytes(bundle, out, entry.size, buffer);
+                out.close();
+                if (ok) {
+                    std::filesystem::rename(part, destination, fileEc);
+                    ok = !fileEc;
+                }
+                if (!ok) {
+                    log::warn("Couldn't unpack {} from the bundle", entry.name);
+                    std::filesystem::remove(part, fileEc);
+                    return Unpack::Failed;
+                }
+                FileStatusCache::get().invalidate(destination);
+                return Unpack::Written;
+            };
+
+            const std::size_t total = files.size();
+            std::vector<Unpack> status(total, Unpack::Failed);
+            std::atomic<std::size_t> done = 0;
+            std::atomic<bool> stop = false;
+
+            // Every entry is read through a stream of its own, so the
+            // executor's workers unpack them side by side. Progress and
+            // cancellation are only handled on the task's own thread.
+            const std::thread::id importer = std::this_thread::get_id();
+            parallel_for(
+                total,
+                [&](std::size_t i) {
+                    if (stop) {
+                        return;
+                    }
+                    status[i] = unpackEntry(*files[i]);
+                    const std::size_t finished = ++done;
+                    if (std::this_thread::get_id() != importer) {
+                        return;
+                    }
+                    if (hasBeenCanceled()) {
+                        stop = true;
+                        return;
+                    }
+                    progress(Progress{.importing = true,
+                                      .finished = finished,
+                                      .total = total});
+                },
+                Executor::Priority::Bulk, s_maxWriters);
+
+            for (std::size_t i = 0; i < total; i++) {
+                if (status[i] == Unpack::Failed) {
+                    unpacked.failed++;
+                    continue;
+                }
+                if (files[i]->kind == EntryKind::IndexCache) {
+                    unpacked.indexCaches++;
+                    continue;
+                }
+                unpacked.songFiles.insert(files[i]->name);
+                if (status[i] == Unpack::Written) {
+                    unpacked.written.push_back(
+                        nongsPath / std::filesystem::path(std::u8string(
+                                        files[i]->name.begin(),
+                                        files[i]->name.end())));
+                }
+            }
+            if (stop) {
+                // Nothing refers to the new song files yet
+                for (const std::filesystem::path& path : unpacked.written) {
+                    std::filesystem::remove(path, ec);
+                }
+                return ImportTask::Cancel();
+            }
+
+            return Ok(std::move(unpacked));
+        },
+        "Importing NONG bundle");
+}
+
+void BundleManager::onExportEvent(ExportTask::Event* event) {
+    if (Progress* progress = event->getProgress()) {
+        m_progress = *progress;
+        return;
+    }
+    if (event->isCancelled()) {
+        m_progress.reset();
+        return;
+    }
+    Result<std::size_t>* result = event->getValue();
+    if (!result) {
+        return;
+    }
+
+    if (result->isErr()) {
+        this->finish("Export failed",
+                     fmt::format("Couldn't export the bundle: {}",
+                                 result->unwrapErr()));
+        return;
+    }
+    this->finish("Bundle exported",
+                 fmt::format("Exported <cg>{}</c> files.", result->unwrap()));
+}
+
+void BundleManager::onImportEvent(ImportTask::Event* event) {
+    if (Progress* progress = event->getProgress()) {
+        m_progress = *progress;
+        return;
+    }
+    if (event->isCancelled()) {
+        m_progress.reset();
+        return;
+    }
+    Result<Unpacked>* result = event->getValue();
+    if (!result) {
+        return;
+    }
+
+    if (result->isErr()) {
+        this->finish("Import failed",
+                     fmt::format("Couldn't import the bundle: {}",
+                                 result->unwrapErr()));
+        return;
+    }
+
+    Unpacked unpacked = std::move(result->unwrap());
+    const std::size_t added = this->addSongs(unpacked);
+    if (unpacked.indexCaches > 0) {
+        IndexManager::get().loadCachedIndexes();
+    }
+
+    std::string message = fmt::format("Imported <cg>{}</c> songs.", added);
+    if (unpacked.failed > 0) {
+        message += fmt::format(" <cr>{}</c> files couldn't be unpacked.",
+                               unpacked.failed);
+    }
+    if (unpacked.missing > 0) {
+        message += fmt::format(
+            " <cy>{}</c> local songs were skipped, their files aren't in the "
+            "bundle or on this device.",
+            unpacked.missing);
+    }
+    this->finish("Bundle imported", std::move(message));
+}
+
+std::size_t BundleManager::addSongs(Unpacked& unpacked) {
+    const std::filesystem::path nongsPath = NongManager::get().baseNongsPath();
+    std::unordered_set<std::filesystem::path::string_type> used;
+
+    std::size_t count = 0;
+    // Every song ID saves once, together, after the last addNongs
+    NongManager::get().holdSaves();
+    for (ImportedManifest& manifest : unpacked.manifests) {
+        const int gdSongID = manifest.gdSongID;
+        Result<Nongs> parsed = parseNongs(manifest.json, gdSongID);
+        if (parsed.isErr()) {
+            log::error("Couldn't read the bundled NONGs of {}: {}", gdSongID,
+                       parsed.unwrapErr());
+            continue;
+        }
+        Nongs batch = std::move(parsed.unwrap());
+
+        // Paths were those of the install the bundle came from. Songs in a
+        // shared library both installs see stay there, and local songs of
+        // files the bundle doesn't carry only come along if the file is at
+        // the same place here.
+        std::vector<Song*> missing;
+        forEachSong(batch, [&](Song* song) {
+            std::optional<std::filesystem::path> path = song->path();
+            if (!path.has_value() ||
+                SharedLibrary::get().contains(path.value())) {
+                return;
+            }
+            if (unpacked.songFiles.contains(toUtf8(path->filename())) ||
+                song->type() != NongType::LOCAL) {
+                // Songs that weren't downloaded download here
+                song->setPath(nongsPath / path->filename());
+                return;
+            }
+            std::error_code ec;
+            if (!std::filesystem::exists(path.value(), ec)) {
+                missing.push_back(song);
+            }
+        });
+        for (Song* song : missing) {
+            batch.songs().erase(song, song->type());
+        }
+        unpacked.missing += missing.size();
+
+        if (!NongManager::get().hasSongID(gdSongID)) {
+            // RobTop songs are set up when their level is opened
+            if (gdSongID < 0) {
+                continue;
+            }
+            // The bundled default song saves looking the song up
+            const SongMetadata* metadata = batch.defaultSong()->metadata();
+            Result<Nongs*> init = NongManager::get().initSongID(
+                host::SongInfo{metadata->name, metadata->artist}, gdSongID,
+                false);
+            if (init.isErr()) {
+                log::error("Failed to initialize song ID {}: {}", gdSongID,
+                           init.unwrapErr());
+                continue;
+            }
+        }
+
+        Result<std::vector<Song*>> res =
+            NongManager::get().addNongs(std::move(batch));
+        if (res.isErr()) {
+            log::error("Failed to add songs for song ID {}: {}", gdSongID,
+                       res.unwrapErr());
+            continue;
+        }
+
+        Nongs* nongs = NongManager::get().getNongs(gdSongID).value();
+        for (Song* song : res.unwrap()) {
+            const std::optional<std::filesystem::path> path = song->path();
+            std::error_code ec;
+            if (path.has_value() && std::filesystem::exists(path.value(), ec)) {
+                used.insert(path->native());
+                // Local files kept where they were belong to the user,
+                // they're never linked into the blob store
+                if (path->parent_path() == nongsPath) {
+                    BlobStore::get().intern(path.value());
+                }
+                if (song->type() != NongType::LOCAL) {
+                    AudioCacheManager::get().track(
+                        gdSongID, song->metadata()->uniqueID.str(),
+                        path.value());
+                }
+            }
+            event::ManualSongAdded(nongs, song).post();
+            count++;
+        }
+    }
+    NongManager::get().releaseSaves();
+
+    // Files of songs that were there already
+    for (const std::filesystem::path& path : unpacked.written) {
+        if (!used.contains(path.native())) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            FileStatusCache::get().invalidate(path);
+        }
+    }
+
+    return count;
+}
+
+void BundleManager::finish(std::string title, std::string message) {
+    m_progress.reset();
+    FLAlertLayer::create(title.c_str(), message, "Ok")->show();
+}
+
+}  // namespace jukebox
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <Geode/loader/Event.hpp>
+#include <Geode/utils/Task.hpp>
+
+namespace jukebox {
+
+/**
+ * Packs the NONGs of a set of song IDs, their song files and the index
+ * caches into a single bundle file, and unpacks such bundles on another
+ * install, so many installs can be set up the same way without fetching
+ * and downloading everything again on each.
+ *
+ * A bundle is a header, the contents of every file back to back, then a
+ * table of contents. Files are streamed in and out in chunks, and imports
+ * unpack them on the executor's workers straight into the nongs and index
+ * cache folders. Paths of bundled song files are rewritten to the nongs
+ * folder of the install importing them.
+ */
+class BundleManager {
+public:
+    struct Progress {
+        // Exporting otherwise
+        bool importing;
+        std::size_t finished;
+        std::size_t total;
+    };
+
+    constexpr static inline std::uint32_t s_magic = 0x444E424A;  // "JBND"
+    constexpr static inline std::uint16_t s_version = 1;
+
+protected:
+    enum class EntryKind : std::uint8_t {
+        // The manifest JSON of a song ID
+        Manifest,
+        // A file of the nongs folder
+        Song,
+        // A file of the index cache folder
+        IndexCache,
+    };
+
+    // What gets packed, gathered on the main thread
+    struct ExportEntry {
+        EntryKind kind;
+        int gdSongID = 0;
+        std::string name;
+        // Manifest JSON, for manifests
+        std::string data;
+        // File to copy, for everything else
+        std::filesystem::path source;
+    };
+
+    struct ImportedManifest {
+        int gdSongID;
+        std::string json;
+    };
+
+    struct Unpacked {
+        std::vector<ImportedManifest> manifests;
+        // Song files this import wrote, removed again if no song uses them
+        std::vector<std::filesystem::path> written;
+        // Names of every song file the bundle carries, written now or there
+        // already
+        std::unordered_set<std::string> songFiles;
+        std::size_t indexCaches = 0;
+        std::size_t failed = 0;
+        // Local songs left out, their files are neither in the bundle nor
+        // where they were
+        std::size_t missing = 0;
+    };
+
+    using ExportTask = geode::Task<geode::Result<std::size_t>, Progress>;
+    using ImportTask = geode::Task<geode::Result<Unpacked>, Progress>;
+
+    // Entries unpacked at once, capped by the executor's workers
+    constexpr static inline std::size_t s_maxWriters = 4;
+    constexpr static inline std::size_t s_bufferSize = 1024 * 1024;
+
+    geode::EventListener<ExportTask> m_exportListener;
+    geode::EventListener<ImportTask> m_importListener;
+    std::optional<Progress> m_progress;
+
+    BundleManager() = default;
+
+    BundleManager(const BundleManager&) = delete;
+    BundleManager(BundleManager&&) = delete;
+
+    BundleManager& operator=(const BundleManager&) = delete;
+    BundleManager& operator=(BundleManager&&) = delete;
+
+    static ExportTask writeBundle(std::vector<ExportEntry> entries,
+                                  std::filesystem::path destination);
+    /**
+     * @param indexCaches names of the index cache files to unpack, those of
+     * indexes that aren't configured here would only be pruned
+     */
+    static ImportTask readBundle(
+        std::filesystem::path source, std::filesystem::path nongsPath,
+        std::filesystem::path indexesPath,
+        std::unordered_set<std::string> indexCaches);
+
+    void onExportEvent(ExportTask::Event* event);
+    void onImportEvent(ImportTask::Event* event);
+    /**
+     * Adds the songs of the imported manifests, one addNongs per song ID
+     *
+     * @return how many songs were added
+     */
+    std::size_t addSongs(Unpacked& unpacked);
+    void finish(std::string title, std::string message);
+
+public:
+    /**
+     * Starts writing a bundle with the NONGs of the given song IDs, the song
+     * files they have on disk and every index cache
+     *
+     * @return Err if a bundle is already being written or read, or none of
+     * the song IDs has NONGs
+     */
+    geode::Result<> exportBundle(const std::vector<int>& gdSongIDs,
+                                 std::filesystem::path destination);
+
+    /**
+     * Starts unpacking a bundle. Songs already stored are skipped, index
+     * caches replace the ones there and are loaded right after.
+     *
+     * @return Err if a bundle is already being written or read
+     */
+    geode::Result<> importBundle(std::filesystem::path source);
+
+    /**
+     * Progress of the running export or import, nullopt if there is none
+     */
+    std::optional<Progress> progress() const { return m_progress; }
+
+    static BundleManager& get() {
+        static BundleManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
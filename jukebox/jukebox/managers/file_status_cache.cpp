@@ -0,0 +1,145 @@
+#include <jukebox/managers/file_status_cache.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <utility>
+
+#include <Geode/loader/Log.hpp>
+
+#include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/directory_watcher.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+std::filesystem::path FileStatusCache::normalize(
+    const std::filesystem::path& path) {
+    std::filesystem::path normal = path.lexically_normal();
+    // Directories may come with a trailing separator
+    if (!normal.has_filename() && normal.has_parent_path()) {
+        normal = normal.parent_path();
+    }
+    return normal;
+}
+
+bool FileStatusCache::watched(
+    const std::filesystem::path::string_type& directory) const {
+    return std::any_of(m_watches.begin(), m_watches.end(),
+                       [&directory](const Watch& watch) {
+                           return watch.directory == directory &&
+                                  watch.watcher->active();
+                       });
+}
+
+void FileStatusCache::watch(const std::filesystem::path& directory) {
+    std::filesystem::path normal = normalize(directory);
+    {
+        std::lock_guard lock(m_mutex);
+        if (std::any_of(m_watches.begin(), m_watches.end(),
+                        [&normal](const Watch& watch) {
+                            return watch.directory == normal.native();
+                        })) {
+            return;
+        }
+    }
+
+    auto watcher = std::make_unique<DirectoryWatcher>(
+        normal, [this, normal](std::optional<std::filesystem::path> filename) {
+            this->onChange(normal, std::move(filename));
+        });
+    if (!watcher->active()) {
+        log::info("Can't watch {}, file status is rechecked every {}s",
+                  normal.string(), s_unwatchedTTL.count());
+    }
+
+    std::lock_guard lock(m_mutex);
+    // Entries cached before the watcher started may be stale already
+    m_entries.clear();
+    m_changes++;
+    m_watches.push_back(Watch{normal.native(), std::move(watcher)});
+    Nongs::invalidatePlayablePaths();
+}
+
+void FileStatusCache::onChange(const std::filesystem::path& directory,
+                               std::optional<std::filesystem::path> filename) {
+    std::lock_guard lock(m_mutex);
+    m_changes++;
+    if (filename.has_value()) {
+        m_entries.erase((directory / filename.value()).native());
+    } else {
+        // Changes were missed, nothing cached can be trusted
+        m_entries.clear();
+    }
+    Nongs::invalidatePlayablePaths();
+}
+
+std::optional<FileStatus> FileStatusCache::status(
+    const std::filesystem::path& path) {
+    const std::filesystem::path normal = normalize(path);
+    const Clock::time_point now = Clock::now();
+    std::uint64_t changes;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_removing.contains(normal.native())) {
+            return std::nullopt;
+        }
+        if (auto it = m_entries.find(normal.native());
+            it != m_entries.end() &&
+            (now - it->second.checkedAt < s_unwatchedTTL ||
+             this->watched(normal.parent_path().native()))) {
+            return it->second.status;
+        }
+        changes = m_changes;
+    }
+
+    // Read with one stat, the entry keeps what it found
+    std::error_code ec;
+    std::optional<FileStatus> status;
+    const std::filesystem::directory_entry entry(normal, ec);
+    if (!ec && entry.exists(ec)) {
+        status = FileStatus{};
+        if (entry.is_regular_file(ec)) {
+            status->size = entry.file_size(ec);
+        }
+        status->modified = entry.last_write_time(ec);
+    }
+
+    std::lock_guard lock(m_mutex);
+    // Changed while it was read, the next call reads it again
+    if (changes == m_changes) {
+        m_entries.insert_or_assign(normal.native(), Entry{status, now});
+    }
+    return status;
+}
+
+bool FileStatusCache::isWatched(const std::filesystem::path& path) {
+    const std::filesystem::path normal = normalize(path);
+    std::lock_guard lock(m_mutex);
+    return this->watched(normal.parent_path().native());
+}
+
+void FileStatusCache::invalidate(const std::filesystem::path& path) {
+    const std::filesystem::path normal = normalize(path);
+    std::lock_guard lock(m_mutex);
+    m_changes++;
+    m_entries.erase(normal.native());
+    m_removing.erase(normal.native());
+    Nongs::invalidatePlayablePaths();
+}
+
+void FileStatusCache::markRemoving(const std::filesystem::path& path) {
+    const std::filesystem::path normal = normalize(path);
+    std::lock_guard lock(m_mutex);
+    m_changes++;
+    m_entries.erase(normal.native());
+    m_removing.insert(normal.native());
+    Nongs::invalidatePlayablePaths();
+}
+
+}  // namespace jukebox
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <jukebox/utils/directory_watcher.hpp>
+
+namespace jukebox {
+
+struct FileStatus {
+    // 0 for directories
+    std::uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+};
+
+/**
+ * Keeps whether files exist, with their size and modification time, so the
+ * UI doesn't stat song files on every update. Files in watched directories
+ * stay cached until the directory watcher or one of the mod's own writes
+ * reports a change. Anything else is only trusted for a couple of seconds.
+ * Every change also invalidates the playable paths cached by Nongs. Safe to
+ * use from any thread.
+ */
+class FileStatusCache {
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::optional<FileStatus> status;
+        Clock::time_point checkedAt;
+    };
+
+    struct Watch {
+        std::filesystem::path::string_type directory;
+        std::unique_ptr<DirectoryWatcher> watcher;
+    };
+
+    // How long the status of a file outside the watched directories is kept
+    constexpr static inline std::chrono::seconds s_unwatchedTTL{2};
+
+    std::mutex m_mutex;
+    std::unordered_map<std::filesystem::path::string_type, Entry> m_entries;
+    // Files queued for removal, reported missing until invalidated
+    std::unordered_set<std::filesystem::path::string_type> m_removing;
+    // Bumped on every change, so a stat that raced one isn't cached
+    std::uint64_t m_changes = 0;
+    std::vector<Watch> m_watches;
+
+    FileStatusCache() = default;
+
+    FileStatusCache(const FileStatusCache&) = delete;
+    FileStatusCache(FileStatusCache&&) = delete;
+
+    FileStatusCache& operator=(const FileStatusCache&) = delete;
+    FileStatusCache& operator=(FileStatusCache&&) = delete;
+
+    // The same file gives the same key, however the path was put together
+    static std::filesystem::path normalize(const std::filesystem::path& path);
+    // Needs m_mutex held
+    bool watched(const std::filesystem::path::string_type& directory) const;
+    void onChange(const std::filesystem::path& directory,
+                  std::optional<std::filesystem::path> filename);
+
+public:
+    /**
+     * Starts watching a directory. Changes to its files, but not to its
+     * subdirectories, are picked up from then on.
+     */
+    void watch(const std::filesystem::path& directory);
+
+    /**
+     * Status of a file, from memory when it's cached
+     *
+     * @return the status, or std::nullopt if the file doesn't exist
+     */
+    std::optional<FileStatus> status(const std::filesystem::path& path);
+
+    bool exists(const std::filesystem::path& path) {
+        return this->status(path).has_value();
+    }
+
+    /**
+     * Whether a file is in a directory with a running watcher, so every
+     * change to it is reported
+     */
+    bool isWatched(const std::filesystem::path& path);
+
+    /**
+     * Forgets the status of a file. Called after the mod writes, moves or
+     * removes a file, so it's seen before the watcher reports it.
+     */
+    void invalidate(const std::filesystem::path& path);
+
+    /**
+     * Reports a file as missing while its removal is queued on another
+     * thread. Ends with the next invalidate of the file, after it was
+     * removed or written again.
+     */
+    void markRemoving(const std::filesystem::path& path);
+
+    static FileStatusCache& get() {
+        static FileStatusCache instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
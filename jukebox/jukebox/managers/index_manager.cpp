@@ -1,61 +1,151 @@
 #include <jukebox/managers/index_manager.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <functional>
-#include <ios>
 #include <memory>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <Geode/Result.hpp>
-#include <Geode/binding/MusicDownloadManager.hpp>
-#include <Geode/binding/SongInfoObject.hpp>
 #include <Geode/loader/Event.hpp>
+#include <Geode/loader/Loader.hpp>
 #include <Geode/loader/Log.hpp>
 #include <Geode/loader/Mod.hpp>
+#include <Geode/loader/SettingV3.hpp>
 #include <Geode/utils/Task.hpp>
 #include <Geode/utils/general.hpp>
-#include <Geode/utils/web.hpp>
 #include <matjson.hpp>
 
+#include <jukebox/download/host_stats.hpp>
 #include <jukebox/download/hosted.hpp>
+#include <jukebox/download/optimize.hpp>
 #include <jukebox/download/youtube.hpp>
 #include <jukebox/events/song_download_failed.hpp>
 #include <jukebox/events/song_download_finished.hpp>
 #include <jukebox/events/song_download_progress.hpp>
 #include <jukebox/events/song_error.hpp>
 #include <jukebox/events/start_download.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/managers/audio_cache_manager.hpp>
+#include <jukebox/managers/blob_store.hpp>
+#include <jukebox/managers/file_status_cache.hpp>
 #include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/managers/shared_library.hpp>
 #include <jukebox/nong/index.hpp>
+#include <jukebox/nong/index_cache.hpp>
+#include <jukebox/nong/index_delta.hpp>
+#include <jukebox/nong/index_parser.hpp>
 #include <jukebox/nong/index_serialize.hpp>
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/indexes_setting.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/compressed_file.hpp>
+#include <jukebox/utils/executor.hpp>
+#include <jukebox/utils/json_reader.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/profiler.hpp>
+#include <jukebox/utils/string_hash.hpp>
 
 using namespace geode::prelude;
 using namespace jukebox::index;
 
+namespace {
+
+std::uint64_t contentHash(std::string_view text) { return fnv1a64(text); }
+
+// Case and surrounding spaces don't make a different track
+void appendFolded(std::string& out, std::string_view str) {
+    auto space = [](char c) {
+        return std::isspace(static_cast<unsigned char>(c)) != 0;
+    };
+    while (!str.empty() && space(str.front())) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && space(str.back())) {
+        str.remove_suffix(1);
+    }
+    for (char c : str) {
+        out.push_back(static_cast<char>(
+            std::tolower(static_cast<unsigned char>(c))));
+    }
+}
+
+// Removes a download that can't be stored, unless it's the file of a shared
+// library
+void discardDownload(const std::filesystem::path& path) {
+    if (jukebox::SharedLibrary::get().contains(path)) {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+}  // namespace
+
 namespace jukebox {
 
-bool IndexManager::init() {
-    if (m_initialized) {
-        return true;
+void IndexManager::start() {
+    if (m_started) {
+        return;
     }
+    m_started = true;
+    ProfileScope profile("IndexManager::start");
+
+    this->updateIndexPriority();
+    listenForSettingChanges("indexes", [this](Indexes) {
+        this->updateIndexPriority();
+        this->fetchIndexes().inspectErr([](const std::string& err) {
+            log::error("Failed to start fetching indexes: {}", err);
+        });
+    });
 
-    std::filesystem::path path = this->baseIndexesPath();
-    if (!std::filesystem::exists(path)) {
-        std::filesystem::create_directory(path);
-        return true;
+    std::error_code ec;
+    std::filesystem::create_directories(this->baseIndexesPath(), ec);
+    if (ec) {
+        log::error("Failed to create the index cache: {}", ec.message());
     }
 
+    // Songs from the cached copies are available right away, the fetch only
+    // revalidates them
+    this->loadCachedIndexes();
+
     this->fetchIndexes().inspectErr([](const std::string& err) {
         log::error("Failed to start fetching indexes: {}", err);
     });
+}
+
+bool IndexManager::init() {
+    if (m_initialized) {
+        return true;
+    }
+    this->start();
+    ProfileScope profile("IndexManager::init");
 
     m_initialized = true;
+    for (DeferredIndex& deferred : std::exchange(m_deferredIndexes, {})) {
+        // Superseded by a load that finished later
+        if (m_indexLoads[deferred.url] != deferred.ticket) {
+            continue;
+        }
+        this->registerIndex(std::move(deferred.parsed));
+    }
     return true;
 }
 
@@ -65,427 +155,1808 @@ Result<std::vector<IndexSource>> IndexManager::getIndexes() {
 }
 
 std::filesystem::path IndexManager::baseIndexesPath() {
-    static std::filesystem::path path =
-        Mod::get()->getSaveDir() / "indexes-cache";
+    static std::filesystem::path path = host::saveDir() / "indexes-cache";
     return path;
 }
 
-Result<> IndexManager::loadIndex(std::filesystem::path path) {
+std::filesystem::path IndexManager::indexCachePath(const std::string& url) {
+    return this->baseIndexesPath() /
+           fmt::format("{:016x}.json.zip", fnv1a64(url));
+}
+
+std::filesystem::path IndexManager::indexBinaryCachePath(
+    const std::string& url) {
+    return this->baseIndexesPath() / fmt::format("{:016x}.bin", fnv1a64(url));
+}
+
+std::filesystem::path IndexManager::indexDeltaJournalPath(
+    const std::string& url) {
+    return this->baseIndexesPath() /
+           fmt::format("{:016x}.delta.json", fnv1a64(url));
+}
+
+std::filesystem::path IndexManager::indexSidecarPath(const std::string& url) {
+    return this->baseIndexesPath() /
+           fmt::format("{:016x}.meta.json", fnv1a64(url));
+}
+
+std::optional<IndexManager::IndexSidecar> IndexManager::readIndexSidecar(
+    const std::filesystem::path& path) {
+    std::ifstream input(path);
+    if (!input.is_open()) {
+        return std::nullopt;
+    }
+    Result<matjson::Value> parsed = matjson::parse(input);
+    if (parsed.isErr()) {
+        return std::nullopt;
+    }
+    const matjson::Value& value = parsed.unwrap();
+
+    // The hash is stored as hex, JSON numbers don't hold 64 bits
+    Result<std::string> url = value["url"].asString();
+    Result<std::string> hash = value["hash"].asString();
+    if (url.isErr() || hash.isErr()) {
+        return std::nullopt;
+    }
+    IndexSidecar sidecar{.url = url.unwrap()};
+    const std::string& hex = hash.unwrap();
+    auto [end, ec] = std::from_chars(hex.data(), hex.data() + hex.size(),
+                                     sidecar.contentHash, 16);
+    if (ec != std::errc() || end != hex.data() + hex.size()) {
+        return std::nullopt;
+    }
+    if (auto etag = value["etag"].asString(); etag.isOk()) {
+        sidecar.etag = etag.unwrap();
+    }
+    if (auto modified = value["last-modified"].asString(); modified.isOk()) {
+        sidecar.lastModified = modified.unwrap();
+    }
+    return sidecar;
+}
+
+Result<> IndexManager::writeIndexSidecar(const std::filesystem::path& path,
+                                         const IndexSidecar& sidecar) {
+    matjson::Value value = matjson::makeObject({
+        {"url", sidecar.url},
+        {"hash", fmt::format("{:016x}", sidecar.contentHash)},
+    });
+    if (sidecar.etag.has_value()) {
+        value.set("etag", sidecar.etag.value());
+    }
+    if (sidecar.lastModified.has_value()) {
+        value.set("last-modified", sidecar.lastModified.value());
+    }
+    return write_file_atomic(path, value.dump());
+}
+
+std::unordered_set<std::string> IndexManager::indexCacheFilenames(
+    const std::vector<IndexSource>& indexes) {
+    std::unordered_set<std::string> names;
+    for (const IndexSource& index : indexes) {
+        names.insert(this->indexCachePath(index.m_url).filename().string());
+        names.insert(
+            this->indexBinaryCachePath(index.m_url).filename().string());
+        names.insert(this->indexSidecarPath(index.m_url).filename().string());
+        names.insert(
+            this->indexDeltaJournalPath(index.m_url).filename().string());
+    }
+    return names;
+}
+
+std::unordered_set<std::string> IndexManager::indexCacheFilenames() {
+    Result<std::vector<IndexSource>> indexes = this->getIndexes();
+    if (indexes.isErr()) {
+        return {};
+    }
+    return this->indexCacheFilenames(indexes.unwrap());
+}
+
+void IndexManager::pruneIndexCache(const std::vector<IndexSource>& indexes) {
+    // Disabled indexes keep their copies, anything else is from a removed
+    // index or an older naming scheme
+    const std::unordered_set<std::string> keep =
+        this->indexCacheFilenames(indexes);
+
+    std::error_code ec;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(this->baseIndexesPath(), ec)) {
+        if (!keep.contains(entry.path().filename().string())) {
+            log::info("Removing stale index cache {}",
+                      entry.path().filename().string());
+            std::error_code removeError;
+            std::filesystem::remove(entry.path(), removeError);
+        }
+    }
+}
+
+void IndexManager::loadCachedIndexes() {
+    Result<std::vector<IndexSource>> indexes = this->getIndexes();
+    if (indexes.isErr()) {
+        return;
+    }
+    this->pruneIndexCache(indexes.unwrap());
+
+    for (const IndexSource& index : indexes.unwrap()) {
+        if (!index.m_enabled) {
+            continue;
+        }
+        std::filesystem::path path = this->indexCachePath(index.m_url);
+        std::filesystem::path binaryPath =
+            this->indexBinaryCachePath(index.m_url);
+        std::filesystem::path sidecarPath = this->indexSidecarPath(index.m_url);
+        std::filesystem::path journalPath =
+            this->indexDeltaJournalPath(index.m_url);
+        // A compacted copy is only kept in binary, see compactIndexCache
+        std::error_code ec;
+        const bool hasJson = std::filesystem::exists(path, ec);
+        if (!hasJson && !std::filesystem::exists(binaryPath, ec)) {
+            continue;
+        }
+        // Without its sidecar the copy can't be checked, the fetch replaces
+        // it
+        std::optional<IndexSidecar> sidecar = readIndexSidecar(sidecarPath);
+        if (!sidecar.has_value() || sidecar->url != index.m_url) {
+            continue;
+        }
+
+        auto replayDeltas = [journalPath,
+                             sidecarPath](ParsedIndex& parsed) -> Result<> {
+            Result<> res = replayIndexDeltas(journalPath, parsed);
+            if (res.isErr()) {
+                // Without its deltas the copy is stale, it's fetched whole
+                std::error_code ec;
+                std::filesystem::remove(journalPath, ec);
+                std::filesystem::remove(sidecarPath, ec);
+            }
+            return res;
+        };
+
+        auto loadJson = [path, binaryPath, sidecarPath, replayDeltas,
+                         sidecar = sidecar.value()]() -> Result<ParsedIndex> {
+            GEODE_UNWRAP_INTO(IndexFile file, readIndexFile(path));
+            if (file.contentHash != sidecar.contentHash) {
+                // Dropping the sidecar makes the next fetch unconditional
+                std::error_code ec;
+                std::filesystem::remove(sidecarPath, ec);
+                return Err("Cached index doesn't match its hash");
+            }
+            GEODE_UNWRAP_INTO(ParsedIndex parsed,
+                              parseIndexAndCache(file.text, sidecar.url,
+                                                 binaryPath, file.contentHash));
+            GEODE_UNWRAP(replayDeltas(parsed));
+            return Ok(std::move(parsed));
+        };
+
+        // The binary copy is only trusted if it was written after the JSON
+        bool binaryFresh = false;
+        auto binaryTime = std::filesystem::last_write_time(binaryPath, ec);
+        if (!ec && hasJson) {
+            binaryFresh =
+                binaryTime >= std::filesystem::last_write_time(path, ec) &&
+                !ec;
+        } else if (!ec) {
+            binaryFresh = true;
+        }
+        if (binaryFresh) {
+            this->loadIndexInBackground(
+                index.m_url,
+                [binaryPath, journalPath, loadJson]() -> Result<ParsedIndex> {
+                    Result<ParsedIndex> res = IndexCache::read(binaryPath);
+                    if (res.isErr()) {
+                        log::warn("Falling back to JSON index cache: {}",
+                                  res.unwrapErr());
+                        return loadJson();
+                    }
+                    // The journal stays for the JSON copy to replay
+                    if (Result<> replayed =
+                            replayIndexDeltas(journalPath, res.unwrap());
+                        replayed.isErr()) {
+                        log::warn("Falling back to JSON index cache: {}",
+                                  replayed.unwrapErr());
+                        return loadJson();
+                    }
+                    return res;
+                });
+            continue;
+        }
+
+        this->loadIndexInBackground(index.m_url, std::move(loadJson));
+    }
+}
+
+void IndexManager::loadIndexInBackground(
+    const std::string& url, std::function<Result<ParsedIndex>()> load) {
+    const std::uint64_t ticket = ++m_indexLoads[url];
+
+    Executor::get()
+        .run<Task<Result<ParsedIndex>>>(
+            Executor::Priority::Normal,
+            [load = std::move(load)](auto, auto) -> Result<ParsedIndex> {
+                return load();
+            },
+            fmt::format("Loading index {}", url))
+        .listen([this, url, ticket](Result<ParsedIndex>* result) {
+            // A newer copy of this index started loading in the meantime
+            if (m_indexLoads[url] != ticket) {
+                return;
+            }
+            if (result->isErr()) {
+                log::error("Failed to load index {}: {}", url,
+                           result->unwrapErr());
+                return;
+            }
+            // The loaded copy is already up to date
+            if (!result->unwrap().index) {
+                return;
+            }
+            if (!m_initialized) {
+                m_deferredIndexes.push_back(DeferredIndex{
+                    url, ticket, std::move(result->unwrap())});
+                return;
+            }
+            this->registerIndex(std::move(result->unwrap()));
+        });
+}
+
+void IndexManager::unloadIndex(const std::string& indexID) {
+    auto it = m_loadedIndexes.find(indexID);
+    if (it == m_loadedIndexes.end()) {
+        return;
+    }
+    IndexMetadata* index = it->second.get();
+
+    auto fromIndex = [index](IndexSongMetadata* song) {
+        return song->parentID == index;
+    };
+
+    for (auto& [id, songs] : m_nongsForId) {
+        if (std::none_of(songs.begin(), songs.end(), fromIndex)) {
+            continue;
+        }
+        std::erase_if(songs, fromIndex);
+        this->mergeIndexSongs(id);
+    }
+
+    // Queued and running downloads point at the songs being freed
+    std::vector<UniqueID> downloads;
+    for (const QueuedDownload& queued : m_downloadQueue) {
+        downloads.push_back(queued.uniqueID);
+    }
+    for (const auto& [uniqueID, _] : m_runningDownloads) {
+        downloads.push_back(uniqueID);
+    }
+    for (UniqueID uniqueID : downloads) {
+        for (const auto& song : index->m_songs.m_hosted) {
+            if (song->uniqueID == uniqueID) {
+                this->cancelDownload(uniqueID);
+                break;
+            }
+        }
+    }
+
+    m_indexHashes.erase(index->m_url);
+    m_loadedIndexes.erase(it);
+}
+
+Result<IndexManager::IndexFile> IndexManager::readIndexFile(
+    const std::filesystem::path& path) {
     if (!std::filesystem::exists(path)) {
         return Err("Index file does not exist");
     }
 
-    std::ifstream input(path);
-    if (!input.is_open()) {
-        return Err(
-            fmt::format("Couldn't open file: {}", path.filename().string()));
+    GEODE_UNWRAP_INTO(std::string text, read_file_compressed(path));
+    const std::uint64_t hash = contentHash(text);
+    return Ok(IndexFile{.text = std::move(text), .contentHash = hash});
+}
+
+Result<ParsedIndex> IndexManager::parseIndex(
+    matjson::Value&& jsonObj) {
+    ProfileScope profile("IndexManager::parseIndex");
+    return index::parseIndex(std::move(jsonObj));
+}
+
+Result<ParsedIndex> IndexManager::parseIndex(std::string_view text,
+                                             std::string_view url,
+                                             matjson::Value* metadata) {
+    ProfileScope profile("IndexManager::parseIndex");
+    return index::parseIndex(text, url, metadata);
+}
+
+Result<ParsedIndex> IndexManager::parseIndexAndCache(
+    std::string_view text, std::string_view url,
+    const std::filesystem::path& binaryPath, std::uint64_t contentHash) {
+    // The metadata is kept as JSON in the binary cache, minus the songs
+    matjson::Value metadata;
+    GEODE_UNWRAP_INTO(ParsedIndex parsed, parseIndex(text, url, &metadata));
+    parsed.contentHash = contentHash;
+    postBinaryCacheWrite(binaryPath, metadata, parsed);
+    return Ok(std::move(parsed));
+}
+
+void IndexManager::postBinaryCacheWrite(const std::filesystem::path& binaryPath,
+                                        const matjson::Value& metadata,
+                                        const ParsedIndex& parsed) {
+    // Encoded here, so the writer doesn't need the parsed index
+    postCacheWrite([binaryPath,
+                    data = IndexCache::encode(metadata, parsed)]() {
+        if (Result<> res = write_file_atomic(binaryPath, data); res.isErr()) {
+            log::warn("Failed to write binary index cache: {}",
+                      res.unwrapErr());
+            std::error_code ec;
+            std::filesystem::remove(binaryPath, ec);
+        }
+    });
+}
+
+void IndexManager::postCacheWrite(std::function<void()> job) {
+    IndexManager::get().m_cacheWriter.post(std::move(job));
+}
+
+void IndexManager::flushCachesForExit(
+    std::chrono::steady_clock::time_point deadline) {
+    if (m_cacheWriter.drainUntil(deadline)) {
+        return;
+    }
+    // Every write replaces a whole file, so dropping one loses nothing
+    // that isn't fetched again
+    const std::size_t dropped = m_cacheWriter.discard();
+    log::warn("Exiting with {} index cache writes queued, dropped them",
+              dropped);
+}
+
+void IndexManager::registerIndex(ParsedIndex&& parsed) {
+    ProfileScope profile("IndexManager::registerIndex");
+    IndexMetadata* index = parsed.index.get();
+
+    this->cacheIndexName(index->m_id, index->m_name);
+
+    for (const std::string& error : parsed.errors) {
+        event::SongError(false, error).post();
+    }
+
+    auto loaded = m_loadedIndexes.find(index->m_id);
+    IndexMetadata* old =
+        loaded != m_loadedIndexes.end() ? loaded->second.get() : nullptr;
+
+    // A refetched index is diffed against the copy loaded before it. Songs
+    // still in it are swapped for their new copy in place, so only songs
+    // that were added or removed get registered or unregistered
+    std::unordered_set<std::string_view> removed;
+    if (old) {
+        for (auto& [id, registered] : m_nongsForId) {
+            if (std::none_of(registered.begin(), registered.end(),
+                             [old](IndexSongMetadata* song) {
+                                 return song->parentID == old;
+                             })) {
+                continue;
+            }
+
+            std::vector<IndexSongMetadata*> incoming;
+            if (auto it = parsed.songsForID.find(id);
+                it != parsed.songsForID.end()) {
+                incoming = std::move(it->second);
+                parsed.songsForID.erase(it);
+            }
+            std::unordered_map<std::string_view, IndexSongMetadata*> added;
+            for (IndexSongMetadata* song : incoming) {
+                added.emplace(song->uniqueID, song);
+            }
+
+            for (IndexSongMetadata*& song : registered) {
+                if (song->parentID != old) {
+                    continue;
+                }
+
+                IndexSongMetadata* replacement = nullptr;
+                if (auto it = added.find(song->uniqueID); it != added.end()) {
+                    replacement = it->second;
+                    added.erase(it);
+                } else {
+                    removed.insert(song->uniqueID);
+                }
+                song = replacement;
+            }
+            std::erase(registered, nullptr);
+
+            // Whatever wasn't matched is new for this song ID
+            for (IndexSongMetadata* song : incoming) {
+                if (added.contains(song->uniqueID)) {
+                    registered.push_back(song);
+                }
+            }
+            this->mergeIndexSongs(id);
+        }
+
+        for (IndexSongMetadata* song : index->m_songs.m_hosted) {
+            removed.erase(song->uniqueID);
+        }
+        this->cancelDownloads(removed);
+    }
+
+    // Songs were grouped by song ID while parsing, so every ID is looked up
+    // once no matter how many songs of the index it has
+    for (const auto& [id, songs] : parsed.songsForID) {
+        this->registerIndexSongs(id, songs);
+    }
+
+    m_indexHashes[index->m_url] = parsed.contentHash;
+    // Frees the old copy, nothing points into it anymore
+    m_loadedIndexes[index->m_id] = std::move(parsed.index);
+}
+
+void IndexManager::cancelDownloads(
+    const std::unordered_set<std::string_view>& uniqueIDs) {
+    // Downloads of songs that are gone from their index can't finish
+    std::vector<UniqueID> cancelled;
+    for (const QueuedDownload& queued : m_downloadQueue) {
+        if (uniqueIDs.contains(queued.uniqueID.str())) {
+            cancelled.push_back(queued.uniqueID);
+        }
+    }
+    for (const auto& [uniqueID, _] : m_runningDownloads) {
+        if (uniqueIDs.contains(uniqueID.str())) {
+            cancelled.push_back(uniqueID);
+        }
+    }
+    for (UniqueID uniqueID : cancelled) {
+        this->cancelDownload(uniqueID);
+    }
+}
+
+void IndexManager::registerIndexSongs(
+    int gdSongID, const std::vector<IndexSongMetadata*>& songs) {
+    if (songs.empty()) {
+        return;
+    }
+
+    std::vector<IndexSongMetadata*>& registered = m_nongsForId[gdSongID];
+    registered.insert(registered.end(), songs.begin(), songs.end());
+    this->mergeIndexSongs(gdSongID);
+}
+
+std::size_t IndexManager::indexPriority(const IndexMetadata* index) const {
+    // Indexes missing from the setting go last
+    auto it = m_indexPriority.find(index->m_url);
+    return it != m_indexPriority.end() ? it->second : m_indexPriority.size();
+}
+
+void IndexManager::updateIndexPriority() {
+    Result<std::vector<IndexSource>> indexes = this->getIndexes();
+    if (indexes.isErr()) {
+        return;
+    }
+
+    std::unordered_map<std::string, std::size_t> priority;
+    for (const IndexSource& index : indexes.unwrap()) {
+        priority.emplace(index.m_url, priority.size());
+    }
+    if (priority == m_indexPriority) {
+        return;
+    }
+    m_indexPriority = std::move(priority);
+
+    ProfileScope profile("IndexManager::updateIndexPriority");
+    for (const auto& [id, _] : m_nongsForId) {
+        this->mergeIndexSongs(id);
+    }
+}
+
+void IndexManager::mergeIndexSongs(int gdSongID) {
+    std::span<IndexSongMetadata* const> songs =
+        this->registeredIndexSongs(gdSongID);
+
+    m_songIDsWithIndexSongsDirty = true;
+
+    // Most song IDs have one song, nothing to merge
+    m_mergedForId.erase(gdSongID);
+    if (songs.size() > 1) {
+        // Songs sharing any key are the same track. An index lists a track
+        // once, so two songs of the same index are never merged, not even
+        // through a mirror they both match.
+        std::vector<std::size_t> parent(songs.size());
+        std::vector<std::vector<IndexMetadata*>> indexesOf(songs.size());
+        for (std::size_t i = 0; i < parent.size(); i++) {
+            parent[i] = i;
+            indexesOf[i].push_back(songs[i]->parentID);
+        }
+        auto find = [&parent](std::size_t i) {
+            while (parent[i] != i) {
+                i = parent[i] = parent[parent[i]];
+            }
+            return i;
+        };
+
+        std::unordered_map<std::string, std::vector<std::size_t>> keys;
+        std::string key;
+        auto link = [&](std::size_t i) {
+            std::vector<std::size_t>& matches = keys[key];
+            for (std::size_t other : matches) {
+                std::size_t a = find(i);
+                std::size_t b = find(other);
+                if (a == b ||
+                    std::any_of(indexesOf[a].begin(), indexesOf[a].end(),
+                                [&](IndexMetadata* index) {
+                                    return std::find(indexesOf[b].begin(),
+                                                     indexesOf[b].end(),
+                                                     index) !=
+                                           indexesOf[b].end();
+                                })) {
+                    continue;
+                }
+                parent[a] = b;
+                indexesOf[b].insert(indexesOf[b].end(), indexesOf[a].begin(),
+                                    indexesOf[a].end());
+                indexesOf[a].clear();
+            }
+            matches.push_back(i);
+        };
+        for (std::size_t i = 0; i < songs.size(); i++) {
+            const IndexSongMetadata* song = songs[i];
+            if (song->url.has_value()) {
+                key = "url\n";
+                key += song->url.value();
+                link(i);
+            }
+            if (song->ytId.has_value()) {
+                key = "yt\n";
+                key += song->ytId.value();
+                link(i);
+            }
+            // Hosted and YouTube songs are only merged with their own kind,
+            // so a hosted song is never hidden behind one that can't be
+            // downloaded
+            key = song->url.has_value() ? "hosted\n" : "youtube\n";
+            appendFolded(key, song->name);
+            key += '\n';
+            appendFolded(key, song->artist);
+            key += fmt::format("\n{}", song->startOffset);
+            link(i);
+        }
+
+        // Groups in the order their first song was registered
+        std::vector<std::vector<IndexSongMetadata*>> groups;
+        std::unordered_map<std::size_t, std::size_t> groupOf;
+        for (std::size_t i = 0; i < songs.size(); i++) {
+            auto [it, _] = groupOf.emplace(find(i), groups.size());
+            if (it->second == groups.size()) {
+                groups.emplace_back();
+            }
+            groups[it->second].push_back(songs[i]);
+        }
+
+        if (groups.size() < songs.size()) {
+            MergedSongs& merged = m_mergedForId[gdSongID];
+            merged.preferred.reserve(groups.size());
+            for (std::vector<IndexSongMetadata*>& group : groups) {
+                std::stable_sort(group.begin(), group.end(),
+                                 [this](IndexSongMetadata* a,
+                                        IndexSongMetadata* b) {
+                                     return this->indexPriority(a->parentID) <
+                                            this->indexPriority(b->parentID);
+                                 });
+                merged.preferred.push_back(group.front());
+                if (group.size() > 1) {
+                    merged.mirrors.emplace(
+                        group.front(),
+                        std::vector<IndexSongMetadata*>(group.begin() + 1,
+                                                        group.end()));
+                }
+            }
+        }
     }
 
-    GEODE_UNWRAP_INTO(matjson::Value jsonObj, matjson::parse(input));
+    // Song IDs whose Nongs are loaded get the change right away
+    if (std::optional<Nongs*> nongs =
+            NongManager::get().getLoadedNongs(gdSongID)) {
+        nongs.value()->setIndexSongs(this->getIndexSongs(gdSongID));
+    }
+}
 
-    return this->loadIndex(std::move(jsonObj));
+Result<> IndexManager::loadIndex(std::filesystem::path path) {
+    ProfileScope profile("IndexManager::loadIndex");
+    GEODE_UNWRAP_INTO(IndexFile file, readIndexFile(path));
+    GEODE_UNWRAP_INTO(ParsedIndex parsed,
+                      parseIndex(std::string_view(file.text)));
+    parsed.contentHash = file.contentHash;
+    this->registerIndex(std::move(parsed));
+    return Ok();
 }
 
 Result<> IndexManager::loadIndex(matjson::Value&& jsonObj) {
-    GEODE_UNWRAP_INTO(IndexMetadata indexMeta,
-                      matjson::Serialize<IndexMetadata>::fromJson(jsonObj));
-    std::unique_ptr<IndexMetadata> index =
-        std::make_unique<IndexMetadata>(std::move(indexMeta));
+    ProfileScope profile("IndexManager::loadIndex");
+    GEODE_UNWRAP_INTO(ParsedIndex parsed, parseIndex(std::move(jsonObj)));
+    this->registerIndex(std::move(parsed));
+    return Ok();
+}
 
-    this->cacheIndexName(index->m_id, index->m_name);
-    for (const auto& [key, ytNong] : jsonObj["nongs"]["youtube"].as_object())
-         {
-        Result<IndexSongMetadata> r =
-            matjson::Serialize<IndexSongMetadata>::from_json(ytNong);
-        if (r.isErr()) {
-            event::SongError(
-                false, fmt::format("Failed to parse index song: {}",
-       r.error()))
-                .post();
+Result<> IndexManager::fetchIndexes() {
+    ProfileScope profile("IndexManager::fetchIndexes");
+    GEODE_UNWRAP_INTO(const std::vector<IndexSource> indexes,
+                      this->getIndexes());
+
+    std::unordered_set<std::string> enabled;
+    for (const IndexSource& index : indexes) {
+        if (index.m_enabled && index.m_url.size() >= 3) {
+            enabled.insert(index.m_url);
+        }
+    }
+
+    // Indexes that were disabled or removed are dropped, the rest stay
+    // loaded until their refetch finishes
+    std::vector<std::string> disabled;
+    for (const auto& [id, index] : m_loadedIndexes) {
+        if (!enabled.contains(index->m_url)) {
+            disabled.push_back(id);
+        }
+    }
+    for (const std::string& id : disabled) {
+        const std::string url = m_loadedIndexes.at(id)->m_url;
+        this->unloadIndex(id);
+        // A load still in flight for it is dropped too
+        m_indexLoads[url]++;
+    }
+
+    for (const IndexSource& index : indexes) {
+        if (!index.m_enabled || index.m_url.size() < 3) {
+            log::info("Skipping index {}, as it is disabled", index.m_url);
             continue;
         }
-        std::unique_ptr<IndexSongMetadata> song =
-            std::make_unique<IndexSongMetadata>(r.unwrap());
-        song->uniqueID = key;
-        song->parentID = index.get();
-    
+
+        const std::string url = index.m_url;
+
+        // A loaded index that can be updated in place only fetches what
+        // changed since its version
+        const IndexMetadata* loaded = nullptr;
+        for (const auto& [_, candidate] : m_loadedIndexes) {
+            if (candidate->m_url == url) {
+                loaded = candidate.get();
+                break;
+            }
+        }
+        if (loaded && loaded->m_deltaUrl.has_value() &&
+            loaded->m_lastUpdate.has_value()) {
+            log::info("Starting delta fetch for index {}", url);
+            this->fetchIndexDelta(index, *loaded);
+            continue;
+        }
+
+        log::info("Starting fetch for index {}", index.m_url);
+
+        this->fetchIndex(index, [this, url](FetchIndexResult r) {
+            this->onIndexFetched(url, &r);
+        });
+    }
+
+    return Ok();
+}
+
+void IndexManager::fetchIndex(
+    const index::IndexSource& index,
+    std::function<void(FetchIndexResult)> callback) {
+    host::HttpRequest request{.url = index.m_url, .compressed = true};
+
+    // Only ask for a 304 if there is a cached copy to fall back on
+    std::error_code ec;
+    if (std::filesystem::exists(this->indexCachePath(index.m_url), ec)) {
+        if (std::optional<IndexSidecar> sidecar =
+                readIndexSidecar(this->indexSidecarPath(index.m_url))) {
+            if (sidecar->etag.has_value()) {
+                request.headers.emplace_back("If-None-Match",
+                                             sidecar->etag.value());
+            }
+            if (sidecar->lastModified.has_value()) {
+                request.headers.emplace_back("If-Modified-Since",
+                                             sidecar->lastModified.value());
+            }
+        }
+    }
+
+    host::httpGet(
+        std::move(request),
+        [callback = std::move(callback)](Result<host::HttpResponse> result) {
+            callback([&result]() -> FetchIndexResult {
+                GEODE_UNWRAP_INTO(host::HttpResponse response,
+                                  std::move(result));
+                if (response.code == 304) {
+                    return Ok(std::nullopt);
+                }
+                if (response.ok()) {
+                    // Parsing is left to a worker thread
+                    return Ok(FetchedIndex{
+                        .body = std::move(response.body),
+                        .etag = response.header("ETag"),
+                        .lastModified = response.header("Last-Modified")});
+                }
+                return Err(fmt::format("Web request failed. Status code: {}",
+                                       response.code));
+            }());
+        });
+}
+
+void IndexManager::onIndexFetched(const std::string& url,
+                                  FetchIndexResult* result) {
+    if (result->isErr()) {
+        log::error("Failed to fetch index {}: {}", url, result->unwrapErr());
+        return;
+    }
+
+    std::optional<FetchedIndex> fetched = std::move(result->unwrap());
+    if (!fetched.has_value()) {
+        log::info("Cached index is up to date: {}", url);
+        return;
+    }
+
+    log::info("Fetched index: {}", url);
+
+    std::uint64_t knownHash = 0;
+    if (auto it = m_indexHashes.find(url); it != m_indexHashes.end()) {
+        knownHash = it->second;
+    }
+
+    this->loadIndexInBackground(
+        url,
+        [url, knownHash, fetched = std::move(fetched.value()),
+         filepath = this->indexCachePath(url),
+         sidecarPath = this->indexSidecarPath(url),
+         journalPath = this->indexDeltaJournalPath(url),
+         binaryPath = this->indexBinaryCachePath(
+             url)]() mutable -> Result<ParsedIndex> {
+            const std::uint64_t hash = contentHash(fetched.body);
+            if (hash == knownHash) {
+                log::info("Index is unchanged: {}", url);
+                return Ok(ParsedIndex{});
+            }
+
+            matjson::Value metadata;
+            GEODE_UNWRAP_INTO(ParsedIndex parsed,
+                              parseIndex(fetched.body, url, &metadata));
+            parsed.contentHash = hash;
+
+            // Only an index that parses replaces the cached copy. It's
+            // cached as it came, the parser takes the URL from the sidecar.
+            // The sidecar is written after the index, so it never describes
+            // a copy that isn't on disk. Without a sidecar the binary cache
+            // queued after this isn't used either.
+            postCacheWrite([url, hash, body = std::move(fetched.body),
+                            filepath, sidecarPath, journalPath,
+                            etag = std::move(fetched.etag),
+                            lastModified = std::move(fetched.lastModified)]() {
+                std::error_code ec;
+                std::filesystem::remove(sidecarPath, ec);
+                Result<> cached = write_file_compressed(filepath, body);
+                // Deltas journaled over the old copy are part of this one
+                std::filesystem::remove(journalPath, ec);
+                if (cached.isErr()) {
+                    log::info("Failed to cache index {}: {}", url,
+                              cached.unwrapErr());
+                    return;
+                }
+                log::info("Cached index: {}", url);
+
+                Result<> sidecar = writeIndexSidecar(
+                    sidecarPath, IndexSidecar{.url = url,
+                                              .etag = etag,
+                                              .lastModified = lastModified,
+                                              .contentHash = hash});
+                if (sidecar.isErr()) {
+                    log::warn("Failed to write index sidecar {}: {}", url,
+                              sidecar.unwrapErr());
+                }
+            });
+            postBinaryCacheWrite(binaryPath, metadata, parsed);
+
+            return Ok(std::move(parsed));
+        });
+}
+
+void IndexManager::fetchIndexDelta(const IndexSource& source,
+                                   const IndexMetadata& loaded) {
+    std::string deltaUrl = loaded.m_deltaUrl.value();
+    if (std::size_t at = deltaUrl.find("{since}"); at != std::string::npos) {
+        deltaUrl.replace(at, std::string_view("{since}").size(),
+                         std::to_string(loaded.m_lastUpdate.value()));
+    }
+
+    auto fetchWhole = [this, source](std::string_view reason) {
+        log::info("Fetching all of index {}: {}", source.m_url, reason);
+        this->fetchIndex(source,
+                         [this, url = source.m_url](FetchIndexResult r) {
+                             this->onIndexFetched(url, &r);
+                         });
+    };
+
+    host::httpGet(
+        host::HttpRequest{.url = std::move(deltaUrl), .compressed = true},
+        [this, source, fetchWhole](Result<host::HttpResponse> result) {
+            if (result.isErr()) {
+                fetchWhole(result.unwrapErr());
+                return;
+            }
+            host::HttpResponse& response = result.unwrap();
+            if (response.code == 204 || response.code == 304) {
+                log::info("Index is up to date: {}", source.m_url);
+                return;
+            }
+            if (!response.ok()) {
+                fetchWhole(fmt::format("No delta, status code {}",
+                                       response.code));
+                return;
+            }
+
+            const std::uint64_t ticket = ++m_indexLoads[source.m_url];
+            // Kept for the journal once the delta is applied
+            auto text = std::make_shared<const std::string>(
+                std::move(response.body));
+            Executor::get()
+                .run<Task<Result<IndexDelta>>>(
+                    Executor::Priority::Normal,
+                    [text](auto, auto) -> Result<IndexDelta> {
+                        ProfileScope profile("IndexManager::parseIndexDelta");
+                        return index::parseIndexDelta(*text);
+                    },
+                    fmt::format("Loading index delta {}", source.m_url))
+                .listen([this, source, fetchWhole, ticket,
+                         text](Result<IndexDelta>* delta) {
+                    // A newer copy of this index started loading meanwhile
+                    if (m_indexLoads[source.m_url] != ticket) {
+                        return;
+                    }
+                    if (delta->isErr()) {
+                        fetchWhole(delta->unwrapErr());
+                        return;
+                    }
+                    Result<> applied = this->applyLoadedDelta(
+                        source.m_url, std::move(delta->unwrap()));
+                    if (applied.isErr()) {
+                        fetchWhole(applied.unwrapErr());
+                        return;
+                    }
+                    // Queued behind any write of the whole index, which
+                    // removes the journal
+                    postCacheWrite(
+                        [url = source.m_url, text,
+                         path = this->indexCachePath(source.m_url),
+                         binaryPath = this->indexBinaryCachePath(source.m_url),
+                         journalPath =
+                             this->indexDeltaJournalPath(source.m_url)]() {
+                            Result<std::size_t> journaled =
+                                appendIndexDelta(journalPath, *text);
+                            if (journaled.isErr()) {
+                                log::warn(
+                                    "Failed to journal delta of index {}: {}",
+                                    url, journaled.unwrapErr());
+                                return;
+                            }
+                            if (journaled.unwrap() < s_maxJournaledDeltas) {
+                                return;
+                            }
+                            Result<> compacted = compactIndexCache(
+                                url, path, binaryPath, journalPath);
+                            if (compacted.isErr()) {
+                                log::warn("Failed to compact index {}: {}",
+                                          url, compacted.unwrapErr());
+                            }
+                        });
+                });
+        });
+}
+
+Result<> IndexManager::applyLoadedDelta(const std::string& url,
+                                        IndexDelta&& delta) {
+    ProfileScope profile("IndexManager::applyLoadedDelta");
+    IndexMetadata* index = nullptr;
+    for (const auto& [_, loaded] : m_loadedIndexes) {
+        if (loaded->m_url == url) {
+            index = loaded.get();
+            break;
+        }
+    }
+    if (!index) {
+        return Err("Index is no longer loaded");
+    }
+
+    std::vector<std::string> errors = std::move(delta.m_errors);
+    GEODE_UNWRAP_INTO(AppliedDelta applied,
+                      index::applyIndexDelta(*index, std::move(delta)));
+    for (const std::string& error : errors) {
+        event::SongError(false, error).post();
+    }
+
+    // Songs going out are only unregistered from their own song IDs, the
+    // rest of m_nongsForId is left alone
+    std::unordered_set<std::string_view> removed;
+    std::unordered_set<int> shrunk;
+    for (IndexSongMetadata* song : applied.removed) {
+        removed.insert(song->uniqueID);
         for (int id : song->songIDs) {
-            if (!m_nongsForId.contains(id)) {
-                m_nongsForId[id] = {song.get()};
-            } else {
-                m_nongsForId[id].push_back(song.get());
+            if (auto it = m_nongsForId.find(id); it != m_nongsForId.end()) {
+                std::erase(it->second, song);
+                shrunk.insert(id);
+            }
+        }
+    }
+
+    std::unordered_map<int, std::vector<IndexSongMetadata*>> added;
+    for (IndexSongMetadata* song : applied.added) {
+        removed.erase(song->uniqueID);
+        for (int id : song->songIDs) {
+            added[id].push_back(song);
+        }
+    }
+    for (const auto& [id, songs] : added) {
+        shrunk.erase(id);
+        this->registerIndexSongs(id, songs);
+    }
+    for (int id : shrunk) {
+        this->mergeIndexSongs(id);
+    }
+    this->cancelDownloads(removed);
+
+    log::info("Applied delta to index {}: {} songs out, {} in", index->m_id,
+              applied.removed.size(), applied.added.size());
+    return Ok();
+}
+
+Result<std::size_t> IndexManager::appendIndexDelta(
+    const std::filesystem::path& path, std::string_view text) {
+    // The journal is a JSON array of the deltas as they were fetched
+    std::string journal;
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec)) {
+        GEODE_UNWRAP_INTO(journal, read_file_compressed(path));
+    }
+    while (!journal.empty() &&
+           std::isspace(static_cast<unsigned char>(journal.back()))) {
+        journal.pop_back();
+    }
+
+    if (journal.size() < 2 || journal.back() != ']') {
+        journal = fmt::format("[{}]", text);
+    } else {
+        journal.pop_back();
+        journal += ',';
+        journal += text;
+        journal += ']';
+    }
+    GEODE_UNWRAP(write_file_atomic(path, journal));
+
+    std::size_t count = 0;
+    JsonReader reader(journal);
+    GEODE_UNWRAP(reader.readArray([&]() -> Result<> {
+        GEODE_UNWRAP(reader.readRaw());
+        count++;
+        return Ok();
+    }));
+    return Ok(count);
+}
+
+Result<> IndexManager::compactIndexCache(
+    const std::string& url, const std::filesystem::path& path,
+    const std::filesystem::path& binaryPath,
+    const std::filesystem::path& journalPath) {
+    ProfileScope profile("IndexManager::compactIndexCache");
+    // A copy compacted before is only in binary, with its metadata
+    matjson::Value metadata;
+    ParsedIndex parsed;
+    if (Result<IndexFile> file = readIndexFile(path); file.isOk()) {
+        GEODE_UNWRAP_INTO(parsed,
+                          parseIndex(file.unwrap().text, url, &metadata));
+        parsed.contentHash = file.unwrap().contentHash;
+    } else {
+        GEODE_UNWRAP_INTO(parsed, IndexCache::read(binaryPath, &metadata));
+    }
+    GEODE_UNWRAP(replayIndexDeltas(journalPath, parsed));
+    // Deltas move the version of the index, which is read from its metadata
+    if (parsed.index->m_lastUpdate.has_value()) {
+        metadata["lastUpdate"] = parsed.index->m_lastUpdate.value();
+    }
+
+    // Losing the journal first costs at worst refetching its deltas, they
+    // are fetched since the version that ends up loaded
+    std::error_code ec;
+    std::filesystem::remove(journalPath, ec);
+    GEODE_UNWRAP(IndexCache::write(binaryPath, metadata, parsed));
+    // The JSON copy is stale now, and would win over the binary one
+    std::filesystem::remove(path, ec);
+    log::info("Compacted delta journal of index {}", url);
+    return Ok();
+}
+
+Result<> IndexManager::replayIndexDeltas(const std::filesystem::path& path,
+                                         ParsedIndex& parsed) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        return Ok();
+    }
+    GEODE_UNWRAP_INTO(std::string journal, read_file_compressed(path));
+
+    JsonReader reader(journal);
+    GEODE_UNWRAP(reader.readArray([&]() -> Result<> {
+        GEODE_UNWRAP_INTO(std::string_view text, reader.readRaw());
+        GEODE_UNWRAP_INTO(IndexDelta delta, index::parseIndexDelta(text));
+        parsed.errors.insert(parsed.errors.end(), delta.m_errors.begin(),
+                             delta.m_errors.end());
+        return index::applyIndexDelta(parsed, std::move(delta));
+    }));
+    return reader.finish();
+}
+
+std::optional<float> IndexManager::getSongDownloadProgress(UniqueID uniqueID) {
+    if (auto it = m_downloadProgress.find(uniqueID);
+        it != m_downloadProgress.end()) {
+        return it->second;
+    }
+    for (const QueuedDownload& queued : m_downloadQueue) {
+        if (queued.uniqueID == uniqueID) {
+            return 0.f;
+        }
+    }
+    return std::nullopt;
+}
+
+std::unordered_map<std::string, std::string>& IndexManager::indexNames() {
+    if (m_indexNames.has_value()) {
+        return m_indexNames.value();
+    }
+
+    m_indexNames.emplace();
+    auto jsonObj =
+        Mod::get()->getSavedValue<matjson::Value>("cached-index-names");
+    if (jsonObj.isObject()) {
+        for (const auto& [id, name] : jsonObj) {
+            if (name.isString()) {
+                m_indexNames->emplace(id, name.asString().unwrap());
             }
-    
-            std::optional<Nongs*> opt = NongManager::get().getNongs(id);
-            if (!opt.has_value()) {
+        }
+    }
+    return m_indexNames.value();
+}
+
+std::optional<std::string> IndexManager::getIndexName(
+    const std::string& indexID) {
+    const auto& names = this->indexNames();
+    if (auto it = names.find(indexID); it != names.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void IndexManager::cacheIndexName(const std::string& indexId,
+                                  const std::string& indexName) {
+    auto& names = this->indexNames();
+    if (auto it = names.find(indexId);
+        it != names.end() && it->second == indexName) {
+        return;
+    }
+    names[indexId] = indexName;
+    m_indexNamesDirty = true;
+
+    // Every index registered this frame is written in one go
+    if (m_indexNamesFlushQueued) {
+        return;
+    }
+    m_indexNamesFlushQueued = true;
+    Loader::get()->queueInMainThread([this]() {
+        m_indexNamesFlushQueued = false;
+        this->flushIndexNames();
+    });
+}
+
+void IndexManager::flushIndexNames() {
+    if (!m_indexNamesDirty || !m_indexNames.has_value()) {
+        return;
+    }
+    ProfileScope profile("IndexManager::flushIndexNames");
+    m_indexNamesDirty = false;
+
+    matjson::Value jsonObj = matjson::makeObject({});
+    for (const auto& [id, name] : m_indexNames.value()) {
+        jsonObj.set(id, name);
+    }
+    Mod::get()->setSavedValue("cached-index-names", jsonObj);
+}
+
+Result<> IndexManager::downloadSong(int gdSongID, UniqueID uniqueID,
+                                    bool background) {
+    Nongs* nongs = nullptr;
+
+    if (!NongManager::get().hasSongID(gdSongID)) {
+        GEODE_UNWRAP_INTO(nongs,
+                          NongManager::get()
+                              .initSongID(std::nullopt, gdSongID, false)
+                              .mapErr([gdSongID](const std::string& err) {
+                                  return fmt::format(
+                                      "Failed to initialize song ID {}: {}",
+                                      gdSongID, err);
+                              }));
+    } else {
+        nongs = NongManager::get().getNongs(gdSongID).value();
+    }
+
+    std::optional<IndexSongMetadata*> indexMeta = std::nullopt;
+    HostedSong* local = nullptr;
+
+    // Try starting download from local reference first
+    if (std::optional<Song*> song = nongs->findSong(uniqueID)) {
+        if (song.value()->type() == NongType::YOUTUBE) {
+            return Err(
+                "YouTube song downloads will be enabled in a future release!");
+        }
+        if (song.value()->type() == NongType::HOSTED) {
+            local = static_cast<HostedSong*>(song.value());
+        }
+    }
+
+    // Look in indexes otherwise
+    if (!local) {
+        // Mirrors can be downloaded too, so every registered song is looked
+        // through
+        std::span<IndexSongMetadata* const> songs =
+            this->registeredIndexSongs(gdSongID);
+        if (songs.empty()) {
+            return Err("Can't download nong for id {}. No index songs found.",
+                       gdSongID);
+        }
+
+        for (IndexSongMetadata* s : songs) {
+            if (s->uniqueID != uniqueID) {
                 continue;
             }
-    
-            Nongs* nongs = opt.value();
-    
-            if (geode::Result<> r = nongs->registerIndexSong(song.get());
-                r.isErr()) {
-                event::SongError(
-                    false,
-                    fmt::format("Failed to register index song: {}",
-             r.error()))
-                    .post();
+
+            if (s->url.has_value()) {
+                indexMeta = s;
+                break;
+            } else if (s->ytId.has_value()) {
+                return Err(
+                    "YouTube song downloads will be enabled in a future "
+                    "release!");
             }
         }
-        index->m_songs.m_youtube.push_back(std::move(song));
     }
 
-    for (const auto& [key, hostedNong] : jsonObj["nongs"]["hosted"]) {
-        Result<IndexSongMetadata> r =
-            matjson::Serialize<IndexSongMetadata>::fromJson(hostedNong);
-        if (r.isErr()) {
-            event::SongError(
-                false,
-                fmt::format("Failed to parse index song: {}", r.unwrapErr()))
-                .post();
-            continue;
-        }
+    if (!local && !indexMeta.has_value()) {
+        return Err("Couldn't download song. Reference not found");
+    }
 
-        std::unique_ptr<IndexSongMetadata> song =
-            std::make_unique<IndexSongMetadata>(r.unwrap());
+    std::variant<index::IndexSongMetadata*, Song*> source;
+    if (indexMeta.has_value()) {
+        source = indexMeta.value();
+    } else {
+        source = local;
+    }
 
-        song->uniqueID = key;
-        song->parentID = index.get();
+    // The file is streamed straight to its final location
+    const std::filesystem::path path = this->downloadPath(source);
 
-        for (int id : song->songIDs) {
-            if (!m_nongsForId.contains(id)) {
-                m_nongsForId[id] = {song.get()};
-            } else {
-                m_nongsForId[id].push_back(song.get());
+    // The same file from the mirrors of its index and from other indexes
+    std::vector<std::string> urls;
+    auto addSource = [&urls](std::string_view url,
+                             const IndexMetadata* index) {
+        auto add = [&urls](std::string_view url) {
+            if (std::find(urls.begin(), urls.end(), url) == urls.end()) {
+                urls.emplace_back(url);
+            }
+        };
+        add(url);
+        if (index) {
+            for (const std::string& mirror : index->mirrorUrls(url)) {
+                add(mirror);
+            }
+        }
+    };
+    if (local) {
+        const IndexMetadata* index = nullptr;
+        if (local->indexID().has_value()) {
+            if (auto it = m_loadedIndexes.find(local->indexID().value());
+                it != m_loadedIndexes.end()) {
+                index = it->second.get();
             }
-            std::optional<Nongs*> opt = NongManager::get().getNongs(id);
-            if (!opt.has_value()) {
+        }
+        addSource(local->url(), index);
+    } else {
+        addSource(indexMeta.value()->url.value(), indexMeta.value()->parentID);
+        const std::optional<std::string_view> hash = indexMeta.value()->sha256;
+        for (IndexSongMetadata* mirror :
+             this->getMirrors(gdSongID, indexMeta.value())) {
+            // A mirror known to have another file would never verify
+            if (!mirror->url.has_value() ||
+                (hash.has_value() && mirror->sha256.has_value() &&
+                 mirror->sha256 != hash)) {
                 continue;
             }
+            addSource(mirror->url.value(), mirror->parentID);
+        }
+    }
 
-            Nongs* nongs = opt.value();
+    // Stored songs don't keep the hash, the index song does
+    IndexSongMetadata* hashed = indexMeta.has_value()
+                                    ? indexMeta.value()
+                                    : this->findIndexSong(gdSongID, uniqueID);
+    std::optional<std::string> sha256;
+    if (hashed && hashed->sha256.has_value()) {
+        sha256 = std::string(hashed->sha256.value());
+    }
 
-            if (geode::Result<> r = nongs->registerIndexSong(song.get());
-                r.isErr()) {
-                event::SongError(
-                    false, fmt::format("Failed to register index song: {}",
-                                       r.unwrapErr()))
+    // Downloads can wait in the queue for minutes, so the songs are looked
+    // up again rather than kept
+    const bool hosted = local != nullptr;
+    auto finish = [this, hosted, gdSongID,
+                   uniqueID](std::filesystem::path&& path) {
+        std::optional<Nongs*> nongs = NongManager::get().getNongs(gdSongID);
+        std::variant<index::IndexSongMetadata*, Song*> source;
+        if (hosted) {
+            std::optional<Song*> song =
+                nongs ? nongs.value()->findSong(uniqueID) : std::nullopt;
+            if (!song.has_value()) {
+                event::SongDownloadFailed(gdSongID, uniqueID,
+                                          "Song was deleted")
+                    .post();
+                discardDownload(path);
+                return;
+            }
+            source = song.value();
+        } else {
+            // The index may have been reloaded during the download
+            IndexSongMetadata* song = this->findIndexSong(gdSongID, uniqueID);
+            if (!song || !nongs.has_value()) {
+                event::SongDownloadFailed(gdSongID, uniqueID,
+                                          "Song was removed from its index")
                     .post();
+                discardDownload(path);
+                return;
             }
+            source = song;
         }
+        this->onDownloadFinish(std::move(source), nongs.value(),
+                               std::move(path));
+    };
 
-        index->m_songs.m_hosted.push_back(std::move(song));
+    // A copy in a shared library is played from there, on the next frame
+    // like a finished download. It never reaches the scheduler, so it
+    // settles here, which a downloadAll waiting on it needs.
+    if (std::optional<std::filesystem::path> shared =
+            SharedLibrary::get().find(path.filename(), sha256)) {
+        Loader::get()->queueInMainThread(
+            [this, finish, uniqueID,
+             shared = std::move(shared.value())]() mutable {
+                finish(std::move(shared));
+                this->onDownloadSettled(uniqueID);
+            });
+        return Ok();
     }
 
-    IndexMetadata* ref = index.get();
-    m_loadedIndexes.emplace(ref->m_id, std::move(index));
+    // Counted against the host the download is expected to start with
+    const std::string host = download::hostFromUrl(
+        download::HostStats::get().rank(urls, download::s_chunkSize).front());
+    QueuedDownload download{
+        .gdSongID = gdSongID,
+        .uniqueID = uniqueID,
+        .host = host,
+        .background = background,
+        .start = [hosted, gdSongID, uniqueID, urls, path,
+                  sha256]() -> Result<DownloadSongTask> {
+            if (hosted) {
+                std::optional<Nongs*> nongs =
+                    NongManager::get().getNongs(gdSongID);
+                std::optional<Song*> song =
+                    nongs ? nongs.value()->findSong(uniqueID) : std::nullopt;
+                if (!song.has_value()) {
+                    return Err("Failed to start download: Song was deleted");
+                }
+                if (song.value()->path().has_value() &&
+                    FileStatusCache::get().exists(
+                        song.value()->path().value())) {
+                    return Err(
+                        "Failed to start download: Song already is "
+                        "downloaded");
+                }
+            }
+            return Ok(
+                jukebox::download::startHostedDownload(urls, path, sha256)
+                    .map(
+                        [sha256](Result<std::filesystem::path>* r) {
+                            // Verified, the blob store can use the hash
+                            if (r->isOk() && sha256.has_value()) {
+                                BlobStore::get().rememberHash(r->unwrap(),
+                                                              sha256.value());
+                            }
+                            return std::move(*r);
+                        },
+                        [](download::DownloadProgress* p) { return *p; }));
+        },
+        .finish = std::move(finish)};
 
+    this->queueDownload(std::move(download));
     return Ok();
 }
 
-Result<> IndexManager::fetchIndexes() {
-    m_indexListeners.clear();
-    m_downloadSongListeners.clear();
-
-    GEODE_UNWRAP_INTO(const std::vector<IndexSource> indexes,
-                      this->getIndexes());
-
-    for (const IndexSource& index : indexes) {
-        if (!index.m_enabled || index.m_url.size() < 3) {
-            log::info("Skipping index {}, as it is disabled", index.m_url);
-            continue;
+void IndexManager::queueDownload(QueuedDownload&& download) {
+    if (m_runningDownloads.contains(download.uniqueID)) {
+        return;
+    }
+    for (QueuedDownload& queued : m_downloadQueue) {
+        if (queued.uniqueID == download.uniqueID) {
+            // Asked for while waiting in the background
+            if (!download.background && queued.background) {
+                queued.background = false;
+                this->pumpDownloads();
+            }
+            return;
         }
-
-        const std::string url = index.m_url;
-
-        log::info("Starting fetch for index {}", index.m_url);
-
-        this->fetchIndex(index).listen(
-            [this, url](Result<matjson::Value>* r) {
-                this->onIndexFetched(url, r);
-            },
-            [](auto) {},  // irrelevant
-            [index]() {
-                log::error("Failed to fetch index {}. Task cancelled.",
-                           index.m_url);
-            });
     }
 
-    return Ok();
+    download.sequence = m_downloadSequence++;
+    m_downloadQueue.push_back(std::move(download));
+    this->pumpDownloads();
 }
 
-Task<Result<matjson::Value>, float> IndexManager::fetchIndex(
-    const index::IndexSource& index) {
-    return web::WebRequest()
-        .timeout(std::chrono::seconds(30))
-        .get(index.m_url)
-        .map(
-            [this,
-             index](web::WebResponse* response) -> Result<matjson::Value> {
-                if (response->ok()) {
-                    GEODE_UNWRAP_INTO(matjson::Value jsonObj, response->json());
+void IndexManager::pumpDownloads() {
+    const std::size_t limit = static_cast<std::size_t>(std::max<int64_t>(
+        1, Mod::get()->getSettingValue<int64_t>("max-concurrent-downloads")));
 
-                    jsonObj.set("url", index.m_url);
-
-                    GEODE_UNWRAP(
-                        matjson::Serialize<IndexMetadata>::fromJson(jsonObj));
+    auto hostDownloads = [this](const std::string& host) -> std::size_t {
+        return std::count_if(
+            m_runningDownloads.begin(), m_runningDownloads.end(),
+            [&host](const auto& kv) { return kv.second.host == host; });
+    };
 
-                    return Ok(std::move(jsonObj));
+    while (m_runningDownloads.size() < limit) {
+        const std::size_t background = std::count_if(
+            m_runningDownloads.begin(), m_runningDownloads.end(),
+            [](const auto& kv) { return kv.second.background; });
+
+        // Songs of the level being viewed go first, then first come first
+        // served, then background downloads. Downloads from a host that is
+        // at its limit wait.
+        auto best = m_downloadQueue.end();
+        for (auto it = m_downloadQueue.begin(); it != m_downloadQueue.end();
+             ++it) {
+            if (hostDownloads(it->host) >= s_maxDownloadsPerHost) {
+                continue;
+            }
+            if (it->background && background >= s_maxBackgroundDownloads) {
+                continue;
+            }
+            if (best == m_downloadQueue.end()) {
+                best = it;
+                continue;
+            }
+            if (it->background != best->background) {
+                if (!it->background) {
+                    best = it;
                 }
-                return Err(fmt::format("Web request failed. Status code: {}",
-                                       response->code()));
-            },
-            [](web::WebProgress* progress) {
-                return progress->downloadProgress().value_or(0) / 100.f;
-            });
+                continue;
+            }
+            bool itPriority = m_prioritySongIDs.contains(it->gdSongID);
+            bool bestPriority = m_prioritySongIDs.contains(best->gdSongID);
+            if (itPriority != bestPriority ? itPriority
+                                           : it->sequence < best->sequence) {
+                best = it;
+            }
+        }
+
+        if (best == m_downloadQueue.end()) {
+            return;
+        }
+
+        QueuedDownload download = std::move(*best);
+        m_downloadQueue.erase(best);
+        this->startDownload(std::move(download));
+    }
 }
 
-void IndexManager::onIndexFetched(const std::string& url,
-                                  Result<matjson::Value>* result) {
-    if (result->isErr()) {
-        log::error("Failed to fetch index {}: {}", url, result->unwrapErr());
+void IndexManager::startDownload(QueuedDownload&& download) {
+    Result<DownloadSongTask> task = download.start();
+    if (task.isErr()) {
+        event::SongDownloadFailed(download.gdSongID, download.uniqueID,
+                                  task.unwrapErr())
+            .post();
+        this->onDownloadSettled(download.uniqueID);
         return;
     }
 
-    matjson::Value json = result->unwrap();
+    const int gdSongID = download.gdSongID;
+    const UniqueID uniqueID = download.uniqueID;
+
+    m_runningDownloads.emplace(
+        uniqueID, RunningDownload{.gdSongID = gdSongID,
+                                  .host = download.host,
+                                  .background = download.background});
+    m_downloadProgress[uniqueID] = 0.f;
+
+    EventListener<DownloadSongTask>& listener =
+        m_downloadSongListeners[uniqueID];
+    listener.bind([this, gdSongID, uniqueID,
+                   finish = std::move(download.finish)](
+                      DownloadSongTask::Event* e) mutable {
+        if (download::DownloadProgress* progress = e->getProgress()) {
+            m_downloadProgress[uniqueID] = progress->percent;
+            this->onDownloadProgress(gdSongID, uniqueID, progress->percent,
+                                     progress->retry);
+            return;
+        }
 
-    const static std::hash<std::string> hasher;
-    std::size_t hashValue = hasher(url);
+        // A progress tick posted after this would revive the progress bar
+        m_pendingProgress.erase(uniqueID);
 
-    const std::filesystem::path filepath =
-        this->baseIndexesPath() / fmt::format("{0:x}.json", hashValue);
-    log::info("{}", filepath);
+        if (Result<std::filesystem::path>* result = e->getValue()) {
+            if (result->isErr()) {
+                event::SongDownloadFailed(gdSongID, uniqueID,
+                                          result->unwrapErr())
+                    .post();
+            } else {
+                // The download only ends once the file is optimized
+                this->optimizeDownload(uniqueID, std::move(result->unwrap()),
+                                       std::move(finish));
+                return;
+            }
+        } else if (!e->isCancelled()) {
+            return;
+        }
 
-    log::info("Fetched index: {}", url);
+        // This listener can't be destroyed from inside its own callback
+        Loader::get()->queueInMainThread(
+            [this, uniqueID]() { this->onDownloadEnded(uniqueID); });
+    });
+    listener.setFilter(task.unwrap());
+}
 
-    std::ofstream out(filepath);
-    if (out.is_open()) {
-        const std::string str = json.dump(matjson::NO_INDENTATION);
-        out.write(str.data(), str.length());
-        log::info("Cached index: {}", url);
-    } else {
-        log::info("Failed to cache index: {}", url);
-    }
+void IndexManager::optimizeDownload(
+    UniqueID uniqueID, std::filesystem::path&& path,
+    std::function<void(std::filesystem::path&&)>&& finish) {
+    const bool transcode =
+        Mod::get()->getSettingValue<bool>("optimize-downloads");
+
+    EventListener<download::OptimizeTask>& listener =
+        m_optimizeListeners[uniqueID];
+    listener.bind([this, uniqueID, path, finish = std::move(finish)](
+                      download::OptimizeTask::Event* e) mutable {
+        if (Result<std::filesystem::path>* result = e->getValue()) {
+            if (result->isErr()) {
+                // The file is left as it was downloaded, which still plays
+                log::warn("Couldn't optimize {}: {}", path.filename().string(),
+                          result->unwrapErr());
+                finish(std::move(path));
+            } else {
+                finish(std::move(result->unwrap()));
+            }
+        } else if (e->isCancelled()) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        } else {
+            return;
+        }
 
-    this->loadIndex(std::move(json)).inspectErr([url](const std::string& err) {
-        log::info("Failed to load index {}: {}", url, err);
+        Loader::get()->queueInMainThread(
+            [this, uniqueID]() { this->onDownloadEnded(uniqueID); });
     });
+    listener.setFilter(download::optimizeDownload(path, transcode));
 }
 
-std::optional<float> IndexManager::getSongDownloadProgress(
-    const std::string& uniqueID) {
-    if (m_downloadSongListeners.contains(uniqueID)) {
-        return m_downloadProgress.at(uniqueID);
-    }
-    return std::nullopt;
+void IndexManager::onDownloadEnded(UniqueID uniqueID) {
+    m_runningDownloads.erase(uniqueID);
+    m_downloadProgress.erase(uniqueID);
+    m_downloadSongListeners.erase(uniqueID);
+    m_optimizeListeners.erase(uniqueID);
+    this->onDownloadSettled(uniqueID);
+    this->pumpDownloads();
 }
 
-std::optional<std::string> IndexManager::getIndexName(
-    const std::string& indexID) {
-    auto jsonObj =
-        Mod::get()->getSavedValue<matjson::Value>("cached-index-names");
-    if (!jsonObj.contains(indexID)) {
-        return std::nullopt;
+void IndexManager::onDownloadSettled(UniqueID uniqueID) {
+    if (!m_bulkDownload) {
+        return;
+    }
+    auto it = m_bulkDownload->pending.find(uniqueID);
+    if (it == m_bulkDownload->pending.end()) {
+        return;
+    }
+    const int gdSongID = it->second;
+    m_bulkDownload->pending.erase(it);
+
+    // Failed downloads never made it into the Nongs
+    if (std::optional<Nongs*> nongs =
+            NongManager::get().getLoadedNongs(gdSongID);
+        nongs.has_value() && nongs.value()->isDefaultActive() &&
+        nongs.value()->findSong(uniqueID).has_value()) {
+        if (Result<> r = NongManager::get().setActiveSong(gdSongID, uniqueID);
+            r.isErr()) {
+            log::error("Couldn't set {} active for {}: {}", uniqueID, gdSongID,
+                       r.unwrapErr());
+        }
     }
-    return jsonObj[indexID].asString().mapOr<std::optional<std::string>>(
-        std::nullopt, [](auto i) { return std::optional(i); });
-}
 
-void IndexManager::cacheIndexName(const std::string& indexId,
-                                  const std::string& indexName) {
-    auto jsonObj =
-        Mod::get()->getSavedValue<matjson::Value>("cached-index-names", {});
-    jsonObj.set(indexId, indexName);
-    Mod::get()->setSavedValue("cached-index-names", jsonObj);
+    if (m_bulkDownload->pending.empty()) {
+        m_bulkDownload.reset();
+        NongManager::get().releaseSaves();
+    }
 }
 
-Result<> IndexManager::downloadSong(int gdSongID, const std::string& uniqueID) {
-    Nongs* nongs = nullptr;
-
-    if (!NongManager::get().hasSongID(gdSongID)) {
-        SongInfoObject* obj =
-            MusicDownloadManager::sharedState()->getSongInfoObject(gdSongID);
+void IndexManager::prefetchSong(int gdSongID) {
+    if (!m_initialized ||
+        !Mod::get()->getSettingValue<bool>("download-ahead")) {
+        return;
+    }
 
-        GEODE_UNWRAP_INTO(nongs,
-                          NongManager::get()
-                              .initSongID(obj, gdSongID, false)
-                              .mapErr([gdSongID](const std::string& err) {
-                                  return fmt::format(
-                                      "Failed to initialize song ID {}: {}",
-                                      gdSongID, err);
-                              }));
-    } else {
-        nongs = NongManager::get().getNongs(gdSongID).value();
+    // Most song IDs have no index songs, that's checked first
+    if (!this->hasIndexSongs(gdSongID)) {
+        return;
+    }
+    IndexSongs songs = this->getIndexSongs(gdSongID);
+    auto preferred = std::find_if(
+        songs.begin(), songs.end(),
+        [](IndexSongMetadata* song) { return song->url.has_value(); });
+    if (preferred == songs.end()) {
+        return;
     }
 
-    DownloadSongTask task;
-    std::optional<IndexSongMetadata*> indexMeta = std::nullopt;
-    Song* local = nullptr;
-    bool found = false;
+    const UniqueID uniqueID((*preferred)->uniqueID);
+    if (m_runningDownloads.contains(uniqueID) ||
+        std::any_of(m_downloadQueue.begin(), m_downloadQueue.end(),
+                    [&uniqueID](const QueuedDownload& queued) {
+                        return queued.uniqueID == uniqueID;
+                    })) {
+        return;
+    }
 
-    // Try starting download from local reference first
-    for (const std::unique_ptr<YTSong>& song : nongs->youtube()) {
-        if (song->metadata()->uniqueID != uniqueID) {
-            continue;
+    // Nothing is downloaded for a song ID that has one of its songs already
+    if (std::optional<Nongs*> nongs = NongManager::get().getNongs(gdSongID)) {
+        for (IndexSongMetadata* song : this->registeredIndexSongs(gdSongID)) {
+            std::optional<UniqueID> id = UniqueID::find(song->uniqueID);
+            if (id && nongs.value()->findSong(*id).has_value()) {
+                return;
+            }
         }
+    }
 
-        return Err(
-            "YouTube song downloads will be enabled in a future release!");
-        break;
+    if (!AudioCacheManager::get().hasRoomFor(s_backgroundHeadroom)) {
+        return;
+    }
 
-        /*Result<DownloadSongTask> t = song->startDownload();*/
-        /*if (t.isErr()) {*/
-        /*    return Err("Failed to start download: {}", t.error());*/
-        /*}*/
-        /**/
-        /*task = t.unwrap();*/
-        /*found = true;*/
-        /*local = song.get();*/
-        /*break;*/
+    if (Result<> r = this->downloadSong(gdSongID, uniqueID, true); r.isErr()) {
+        log::debug("Couldn't download song {} ahead: {}", gdSongID,
+                   r.unwrapErr());
     }
+}
 
-    if (!found) {
-        for (const std::unique_ptr<HostedSong>& song : nongs->hosted()) {
-            if (song->metadata()->uniqueID != uniqueID) {
-                continue;
-            }
+Result<std::size_t> IndexManager::downloadAll(std::span<const int> gdSongIDs) {
+    if (m_bulkDownload) {
+        return Err("Already downloading every song of a level");
+    }
 
-            GEODE_UNWRAP_INTO(
-                task, song->startDownload().mapErr([](std::string err) {
-                    return fmt::format("Failed to start download: {}", err);
-                }));
+    std::vector<std::pair<int, IndexSongMetadata*>> wanted;
+    // Downloads are queued and settle per unique ID, a song registered for
+    // several of the song IDs is downloaded for the first one only
+    std::unordered_set<std::string_view> wantedIDs;
+    for (int gdSongID : gdSongIDs) {
+        std::optional<Nongs*> nongs = NongManager::get().getNongs(gdSongID);
+        if (!nongs.has_value()) {
+            continue;
+        }
 
-            found = true;
-            local = song.get();
-            break;
+        IndexSongMetadata* preferred = nullptr;
+        for (IndexSongMetadata* song : this->getIndexSongs(gdSongID)) {
+            if (song->url.has_value()) {
+                preferred = song;
+                break;
+            }
+        }
+        // A mirror that is stored counts too
+        bool stored = false;
+        for (IndexSongMetadata* song : this->registeredIndexSongs(gdSongID)) {
+            std::optional<UniqueID> id = UniqueID::find(song->uniqueID);
+            if (id && nongs.value()->findSong(*id).has_value()) {
+                stored = true;
+                break;
+            }
+        }
+        if (!stored && preferred &&
+            wantedIDs.insert(preferred->uniqueID).second) {
+            wanted.emplace_back(gdSongID, preferred);
         }
     }
 
-    // Look in indexes otherwise
-    if (!m_nongsForId.contains(gdSongID)) {
-        return Err("Can't download nong for id {}. No index songs found.",
-                   gdSongID);
+    if (wanted.empty()) {
+        return Ok(0);
     }
 
-    if (!found) {
-        std::vector<IndexSongMetadata*> songs = m_nongsForId[gdSongID];
-        for (IndexSongMetadata* s : songs) {
-            if (s->uniqueID != uniqueID) {
-                continue;
-            }
+    // Every finished download only marks its song dirty, the manifest is
+    // written once the last one settles
+    NongManager::get().holdSaves();
+    m_bulkDownload.emplace();
+    for (auto [gdSongID, song] : wanted) {
+        const UniqueID uniqueID(song->uniqueID);
+        m_bulkDownload->pending.emplace(uniqueID, gdSongID);
+        m_bulkDownload->total++;
+        if (Result<> r = this->downloadSong(gdSongID, uniqueID); r.isErr()) {
+            event::SongDownloadFailed(gdSongID, uniqueID, r.unwrapErr())
+                .post();
+            this->onDownloadSettled(uniqueID);
+        }
+    }
 
-            if (s->url.has_value()) {
-                task = jukebox::download::startHostedDownload(s->url.value());
-                indexMeta = s;
-                found = true;
-                break;
-            } else if (s->ytId.has_value()) {
-                return Err(
-                    "YouTube song downloads will be enabled in a future "
-                    "release!");
-                break;
+    // Everything may have failed straight away
+    return Ok(m_bulkDownload ? m_bulkDownload->total : 0);
+}
 
-                task = jukebox::download::startYoutubeDownload(s->ytId.value());
-                indexMeta = s;
-                found = true;
-                break;
-            }
-        }
+std::optional<IndexManager::BulkProgress>
+IndexManager::getBulkDownloadProgress() const {
+    if (!m_bulkDownload) {
+        return std::nullopt;
     }
 
-    if (!found) {
-        return Err("Couldn't download song. Reference not found");
+    const std::size_t finished =
+        m_bulkDownload->total - m_bulkDownload->pending.size();
+    float percent = 100.f * finished;
+    for (const auto& [uniqueID, _] : m_bulkDownload->pending) {
+        if (auto it = m_downloadProgress.find(uniqueID);
+            it != m_downloadProgress.end()) {
+            percent += it->second;
+        }
     }
+    return BulkProgress{.finished = finished,
+                        .total = m_bulkDownload->total,
+                        .percent = percent / m_bulkDownload->total};
+}
 
-    task.listen(
-        [this, indexMeta, local, nongs, gdSongID,
-         uniqueID](Result<ByteVector>* vector) {
-            if (vector->isErr()) {
-                event::SongDownloadFailed(gdSongID, uniqueID,
-                                          vector->unwrapErr())
-                    .post();
-                return;
-            }
+std::vector<MemoryUsage> IndexManager::memoryUsage() const {
+    MemoryUsage indexes{"Indexes", m_loadedIndexes.size(),
+                        memory::heapBytes(m_loadedIndexes)};
+    MemoryUsage songs{"Index songs"};
+    for (const auto& [id, index] : m_loadedIndexes) {
+        indexes.bytes += memory::heapBytes(id) + index->memoryUsage();
+        songs.count +=
+            index->m_songs.m_youtube.size() + index->m_songs.m_hosted.size();
+        songs.bytes += index->m_arena.memoryUsage();
+    }
 
-            std::variant<index::IndexSongMetadata*, Song*> source;
+    MemoryUsage lookup{"Index song lookup", m_nongsForId.size(),
+                       memory::heapBytes(m_nongsForId) +
+                           memory::heapBytes(m_mergedForId) +
+                           memory::heapBytes(m_songIDsWithIndexSongs)};
+    for (const auto& [_, registered] : m_nongsForId) {
+        lookup.bytes += memory::heapBytes(registered);
+    }
+    for (const auto& [_, merged] : m_mergedForId) {
+        lookup.bytes += memory::heapBytes(merged.preferred) +
+                        memory::heapBytes(merged.mirrors);
+        for (const auto& [_, mirrors] : merged.mirrors) {
+            lookup.bytes += memory::heapBytes(mirrors);
+        }
+    }
 
-            if (indexMeta.has_value()) {
-                source = indexMeta.value();
-            } else {
-                source = local;
-            }
+    // A running download holds up to one chunk of the response at a time
+    MemoryUsage downloads{"Running downloads", m_runningDownloads.size(),
+                          m_runningDownloads.size() * download::s_chunkSize};
 
-            this->onDownloadFinish(std::move(source), nongs,
-                                   std::move(vector->unwrap()));
-        },
-        [this, uniqueID, gdSongID](float* progress) {
-            this->onDownloadProgress(gdSongID, uniqueID, *progress);
-        });
-    return Ok();
+    return {indexes, songs, lookup, downloads};
 }
 
-void IndexManager::onDownloadProgress(int gdSongID, const std::string& uniqueId,
-                                      float progress) {
-    event::SongDownloadProgress(gdSongID, uniqueId, progress).post();
+IndexSongMetadata* IndexManager::findIndexSong(int gdSongID,
+                                               UniqueID uniqueID) {
+    for (IndexSongMetadata* song : this->registeredIndexSongs(gdSongID)) {
+        if (song->uniqueID == uniqueID && song->url.has_value()) {
+            return song;
+        }
+    }
+    return nullptr;
 }
 
-void IndexManager::onDownloadFinish(
-    std::variant<index::IndexSongMetadata*, Song*>&& source, Nongs* destination,
-    ByteVector&& data) {
-    std::string uniqueId;
-    if (std::holds_alternative<index::IndexSongMetadata*>(source)) {
-        uniqueId = std::get<index::IndexSongMetadata*>(source)->uniqueID;
-    } else {
-        uniqueId = std::get<Song*>(source)->metadata()->uniqueID;
+void IndexManager::cancelDownload(UniqueID uniqueID) {
+    for (auto it = m_downloadQueue.begin(); it != m_downloadQueue.end(); ++it) {
+        if (it->uniqueID == uniqueID) {
+            const int gdSongID = it->gdSongID;
+            m_downloadQueue.erase(it);
+            event::SongDownloadFailed(gdSongID, uniqueID, "Download cancelled")
+                .post();
+            this->onDownloadSettled(uniqueID);
+            return;
+        }
     }
 
-    if (data.size() == 0) {
-        const std::string err =
-            "Failed to store downloaded file. ByteVector empty.";
-        log::error("{}", err);
-        event::SongDownloadFailed(destination->songID(), uniqueId, err).post();
+    auto running = m_runningDownloads.find(uniqueID);
+    if (running == m_runningDownloads.end()) {
         return;
     }
 
-    std::filesystem::path path;
+    // The listener cleans up once the task reports the cancellation
+    m_downloadSongListeners[uniqueID].getFilter().cancel();
+    if (auto it = m_optimizeListeners.find(uniqueID);
+        it != m_optimizeListeners.end()) {
+        it->second.getFilter().cancel();
+    }
+    m_pendingProgress.erase(uniqueID);
+    event::SongDownloadFailed(running->second.gdSongID, uniqueID,
+                              "Download cancelled")
+        .post();
+}
+
+void IndexManager::cancelAllDownloads() {
+    std::vector<UniqueID> ids;
+    for (const QueuedDownload& queued : m_downloadQueue) {
+        ids.push_back(queued.uniqueID);
+    }
+    for (const auto& [id, _] : m_runningDownloads) {
+        ids.push_back(id);
+    }
+    for (UniqueID id : ids) {
+        this->cancelDownload(id);
+    }
+}
+
+std::uint64_t IndexManager::setPrioritySongIDs(
+    std::unordered_set<int> songIDs) {
+    m_prioritySongIDs = std::move(songIDs);
+    return ++m_priorityToken;
+}
+
+void IndexManager::clearPrioritySongIDs(std::uint64_t token) {
+    if (token == m_priorityToken) {
+        m_prioritySongIDs.clear();
+    }
+}
 
+std::filesystem::path IndexManager::downloadPath(
+    const std::variant<index::IndexSongMetadata*, Song*>& source) {
     if (std::holds_alternative<index::IndexSongMetadata*>(source)) {
         index::IndexSongMetadata* s =
             std::get<index::IndexSongMetadata*>(source);
-        path = NongManager::get().baseNongsPath() /
+        return NongManager::get().baseNongsPath() /
                fmt::format("{}-{}.mp3", s->parentID->m_id, s->uniqueID);
-    } else {
-        std::string name;
-        Song* song = std::get<Song*>(source);
+    }
 
-        if (song->indexID().has_value()) {
-            name = fmt::format("{}-{}.mp3", song->indexID().value(),
-                               song->metadata()->uniqueID);
-        } else {
-            name = fmt::format("{}.mp3", song->metadata()->uniqueID);
-        }
+    std::string name;
+    Song* song = std::get<Song*>(source);
 
-        path = NongManager::get().baseNongsPath() / name;
+    if (song->indexID().has_value()) {
+        name = fmt::format("{}-{}.mp3", song->indexID().value(),
+                           song->metadata()->uniqueID);
+    } else {
+        name = fmt::format("{}.mp3", song->metadata()->uniqueID);
     }
 
-    std::ofstream out(path, std::ios_base::out | std::ios_base::binary);
+    return NongManager::get().baseNongsPath() / name;
+}
 
-    if (!out.is_open()) {
-        const std::string err =
-            "Failed to store downloaded file. Couldn't open file for write";
-        log::error("{}", err);
-        event::SongDownloadFailed(destination->songID(), uniqueId, err).post();
+void IndexManager::onDownloadProgress(int gdSongID, UniqueID uniqueId,
+                                      float progress, int retry) {
+    m_pendingProgress[uniqueId] = PendingProgress{gdSongID, progress, retry};
+    if (m_progressFlushQueued) {
         return;
     }
+    m_progressFlushQueued = true;
+    Loader::get()->queueInMainThread(
+        [this]() { this->flushDownloadProgress(); });
+}
+
+void IndexManager::flushDownloadProgress() {
+    m_progressFlushQueued = false;
+    // Listeners can start or cancel downloads, which touches the pending map
+    std::unordered_map<UniqueID, PendingProgress> pending =
+        std::exchange(m_pendingProgress, {});
+    for (const auto& [uniqueID, p] : pending) {
+        event::SongDownloadProgress(p.gdSongID, uniqueID, p.progress, p.retry)
+            .post();
+    }
+}
 
-    out.write(reinterpret_cast<const char*>(data.data()), data.size());
-    out.close();
+void IndexManager::onDownloadFinish(
+    std::variant<index::IndexSongMetadata*, Song*>&& source, Nongs* destination,
+    std::filesystem::path&& path) {
+    ProfileScope profile("IndexManager::onDownloadFinish");
+    UniqueID uniqueId;
+    if (std::holds_alternative<index::IndexSongMetadata*>(source)) {
+        uniqueId = std::get<index::IndexSongMetadata*>(source)->uniqueID;
+    } else {
+        uniqueId = std::get<Song*>(source)->metadata()->uniqueID;
+    }
 
     Song* insertedSong = nullptr;
 
     if (auto s = std::holds_alternative<Song*>(source)) {
         Song* localSong = std::get<Song*>(source);
         localSong->setPath(path);
+        BlobStore::get().intern(path);
+        AudioCacheManager::get().track(destination->songID(), uniqueId, path);
         event::SongDownloadFinished(std::nullopt, std::get<Song*>(source))
             .post();
         return;
@@ -501,16 +1972,18 @@ void IndexManager::onDownloadFinish(
         log::error("{}", print);
         event::SongDownloadFailed(destination->songID(), uniqueId, print)
             .post();
-        std::error_code ec;
-        std::filesystem::remove(path, ec);
+        discardDownload(path);
     };
 
     if (metadata->url.has_value()) {
         Result<HostedSong*> r = destination->add(
-            HostedSong(SongMetadata(destination->songID(), metadata->uniqueID,
-                                    metadata->name, metadata->artist,
+            HostedSong(SongMetadata(destination->songID(),
+                                    UniqueID(metadata->uniqueID),
+                                    std::string(metadata->name),
+                                    std::string(metadata->artist),
                                     std::nullopt, metadata->startOffset),
-                       metadata->url.value(), metadata->parentID->m_id, path));
+                       std::string(metadata->url.value()),
+                       metadata->parentID->m_id, path));
 
         if (r.isErr()) {
             orElse(r.unwrapErr());
@@ -520,10 +1993,13 @@ void IndexManager::onDownloadFinish(
         insertedSong = r.unwrap();
     } else if (metadata->ytId.has_value()) {
         Result<YTSong*> r = destination->add(
-            YTSong(SongMetadata(destination->songID(), metadata->uniqueID,
-                                metadata->name, metadata->artist, std::nullopt,
+            YTSong(SongMetadata(destination->songID(),
+                                UniqueID(metadata->uniqueID),
+                                std::string(metadata->name),
+                                std::string(metadata->artist), std::nullopt,
                                 metadata->startOffset),
-                   metadata->ytId.value(), metadata->parentID->m_id, path));
+                   std::string(metadata->ytId.value()),
+                   metadata->parentID->m_id, path));
         if (r.isErr()) {
             orElse(r.unwrapErr());
             return;
@@ -537,29 +2013,85 @@ void IndexManager::onDownloadFinish(
     }
 
     (void)destination->commit();
+    BlobStore::get().intern(path);
+    AudioCacheManager::get().track(destination->songID(), uniqueId, path);
 
     event::SongDownloadFinished(metadata, insertedSong).post();
 }
 
 ListenerResult IndexManager::onDownloadStart(event::StartDownload* e) {
-    Result<> res = this->downloadSong(e->gdId(), e->song()->uniqueID);
+    const UniqueID uniqueID(e->song()->uniqueID);
+    Result<> res = this->downloadSong(e->gdId(), uniqueID);
     if (res.isErr()) {
-        event::SongDownloadFailed(e->gdId(), e->song()->uniqueID,
-                                  res.unwrapErr())
+        event::SongDownloadFailed(e->gdId(), uniqueID, res.unwrapErr())
             .post();
     }
     return ListenerResult::Propagate;
 }
 
+std::span<IndexSongMetadata* const> IndexManager::registeredIndexSongs(
+    int gdSongID) const {
+    auto it = m_nongsForId.find(gdSongID);
+    if (it == m_nongsForId.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+IndexManager::IndexSongs IndexManager::getIndexSongs(int gdSongID) const {
+    if (auto it = m_mergedForId.find(gdSongID); it != m_mergedForId.end()) {
+        return it->second.preferred;
+    }
+    return this->registeredIndexSongs(gdSongID);
+}
+
+bool IndexManager::hasIndexSongs(int gdSongID) {
+    if (m_songIDsWithIndexSongsDirty) {
+        m_songIDsWithIndexSongsDirty = false;
+        m_songIDsWithIndexSongs.clear();
+        for (const auto& [id, songs] : m_nongsForId) {
+            if (!songs.empty()) {
+                m_songIDsWithIndexSongs.push_back(id);
+            }
+        }
+        std::sort(m_songIDsWithIndexSongs.begin(),
+                  m_songIDsWithIndexSongs.end());
+    }
+    return std::binary_search(m_songIDsWithIndexSongs.begin(),
+                              m_songIDsWithIndexSongs.end(), gdSongID);
+}
+
+IndexManager::IndexSongs IndexManager::getMirrors(
+    int gdSongID, IndexSongMetadata* song) const {
+    auto it = m_mergedForId.find(gdSongID);
+    if (it == m_mergedForId.end()) {
+        return {};
+    }
+    auto mirrors = it->second.mirrors.find(song);
+    if (mirrors == it->second.mirrors.end()) {
+        return {};
+    }
+    return mirrors->second;
+}
+
+std::vector<IndexManager::IndexSongs> IndexManager::getIndexSongs(
+    std::span<const int> gdSongIDs) const {
+    std::vector<IndexSongs> ret;
+    ret.reserve(gdSongIDs.size());
+    for (int gdSongID : gdSongIDs) {
+        ret.push_back(this->getIndexSongs(gdSongID));
+    }
+    return ret;
+}
+
 void IndexManager::registerIndexNongs(Nongs* destination) {
-    if (m_nongsForId.contains(!destination->songID())) {
+    IndexSongs songs = this->getIndexSongs(destination->songID());
+    // Most song IDs have no index songs at all
+    if (songs.empty() && destination->indexSongs().empty()) {
         return;
     }
 
-    destination->indexSongs().clear();
-    for (index::IndexSongMetadata* s : m_nongsForId[destination->songID()]) {
-        destination->indexSongs().push_back(s);
-    }
+    destination->setIndexSongs(songs);
 }
 
 };  // namespace jukebox
@@ -1,10 +1,19 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
+#include <vector>
 
 #include <Geode/Result.hpp>
 #include <Geode/loader/Event.hpp>
@@ -12,9 +21,15 @@
 #include <Geode/utils/general.hpp>
 #include <matjson.hpp>
 
+#include <jukebox/download/download.hpp>
+#include <jukebox/download/optimize.hpp>
 #include <jukebox/events/start_download.hpp>
 #include <jukebox/nong/index.hpp>
+#include <jukebox/nong/index_delta.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/serial_queue.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
@@ -22,9 +37,7 @@ class IndexManager {
 protected:
     bool m_initialized = false;
 
-    using FetchIndexTask = geode::Task<geode::Result<>, float>;
-    using DownloadSongTask =
-        geode::Task<geode::Result<geode::ByteVector>, float>;
+    using DownloadSongTask = download::DownloadTask;
 
     IndexManager() = default;
 
@@ -34,34 +47,337 @@ protected:
     IndexManager& operator=(const IndexManager&) = delete;
     IndexManager& operator=(IndexManager&&) = delete;
 
-    // index url -> task listener
-    std::unordered_map<std::string, geode::EventListener<FetchIndexTask>>
-        m_indexListeners;
-
+    // song id -> every index song registered for it, duplicates included
     std::unordered_map<int, std::vector<index::IndexSongMetadata*>>
         m_nongsForId;
+
+    struct MergedSongs {
+        // One song per track, the one from the highest priority index
+        std::vector<index::IndexSongMetadata*> preferred;
+        // preferred song -> the same track in other indexes, best first
+        std::unordered_map<index::IndexSongMetadata*,
+                           std::vector<index::IndexSongMetadata*>>
+            mirrors;
+    };
+
+    // song id -> its songs with duplicates merged. Only song IDs that have
+    // duplicates are in here, the rest are shown as registered
+    std::unordered_map<int, MergedSongs> m_mergedForId;
+    // Sorted song IDs that have index songs, so level lists can check a song
+    // ID without touching the maps. Rebuilt on first use after a change
+    std::vector<int> m_songIDsWithIndexSongs;
+    bool m_songIDsWithIndexSongsDirty = false;
+    // index url -> priority, lower goes first. Follows the order of the
+    // "indexes" setting
+    std::unordered_map<std::string, std::size_t> m_indexPriority;
     // song id -> download song task
-    std::unordered_map<std::string, geode::EventListener<DownloadSongTask>>
+    std::unordered_map<UniqueID, geode::EventListener<DownloadSongTask>>
         m_downloadSongListeners;
+    // song id -> optimize task of a finished download
+    std::unordered_map<UniqueID, geode::EventListener<download::OptimizeTask>>
+        m_optimizeListeners;
     // song id -> current download progress (used when opening NongDropdownLayer
     // while a song is being downloaded)
-    std::unordered_map<std::string, float> m_downloadProgress;
+    std::unordered_map<UniqueID, float> m_downloadProgress;
+
+    struct PendingProgress {
+        int gdSongID;
+        float progress;
+        int retry;
+    };
+
+    // song id -> latest progress not posted yet. Progress is posted at most
+    // once a frame, however often the download reports it
+    std::unordered_map<UniqueID, PendingProgress> m_pendingProgress;
+    bool m_progressFlushQueued = false;
+
+    void flushDownloadProgress();
+
+    struct QueuedDownload {
+        int gdSongID;
+        UniqueID uniqueID;
+        std::string host;
+        std::uint64_t sequence = 0;
+        // Started only when nothing else is waiting, see prefetchSong
+        bool background = false;
+        std::function<geode::Result<DownloadSongTask>()> start;
+        std::function<void(std::filesystem::path&&)> finish;
+    };
+
+    struct RunningDownload {
+        int gdSongID;
+        std::string host;
+        bool background = false;
+    };
+
+    // Downloads cap out per host too, so one index can't take every slot
+    constexpr static inline std::size_t s_maxDownloadsPerHost = 2;
+    // Background downloads running at once, the other slots stay free for
+    // songs the player asked for
+    constexpr static inline std::size_t s_maxBackgroundDownloads = 1;
+    // Room left in the downloaded NONGs budget for a background download,
+    // so it never evicts a song that was played
+    constexpr static inline std::uintmax_t s_backgroundHeadroom =
+        32 * 1024 * 1024;
+    // Deltas journaled over a cached index before they're folded into it
+    constexpr static inline std::size_t s_maxJournaledDeltas = 16;
+
+    // Downloads waiting for a free slot
+    std::vector<QueuedDownload> m_downloadQueue;
+    std::uint64_t m_downloadSequence = 0;
+    // song id -> running download
+    std::unordered_map<UniqueID, RunningDownload> m_runningDownloads;
+    // GD song IDs whose downloads skip ahead in the queue
+    std::unordered_set<int> m_prioritySongIDs;
+    // Bumped whenever they're set, so a layer only clears its own
+    std::uint64_t m_priorityToken = 0;
+
+    struct BulkDownload {
+        // unique ID -> song ID, for downloads still queued or running
+        std::unordered_map<UniqueID, int> pending;
+        std::size_t total = 0;
+    };
+
+    // The running downloadAll, if any
+    std::optional<BulkDownload> m_bulkDownload;
+
+    /**
+     * Called whenever a download leaves the scheduler, however it ended
+     */
+    void onDownloadSettled(UniqueID uniqueID);
+
+    void queueDownload(QueuedDownload&& download);
+    void pumpDownloads();
+    void startDownload(QueuedDownload&& download);
+    void onDownloadEnded(UniqueID uniqueID);
+    /**
+     * Runs download::optimizeDownload on a finished download, then finish
+     * with wherever the file ended up
+     */
+    void optimizeDownload(
+        UniqueID uniqueID, std::filesystem::path&& path,
+        std::function<void(std::filesystem::path&&)>&& finish);
+    /**
+     * Finds the downloadable index song with this unique ID for a song ID
+     */
+    index::IndexSongMetadata* findIndexSong(int gdSongID, UniqueID uniqueID);
 
     geode::EventListener<geode::EventFilter<jukebox::event::StartDownload>>
         m_downloadSignalListener{this, &IndexManager::onDownloadStart};
 
     geode::ListenerResult onDownloadStart(jukebox::event::StartDownload* e);
-    void onDownloadProgress(int gdSongID, const std::string& uniqueId,
-                            float progress);
+    void onDownloadProgress(int gdSongID, UniqueID uniqueId, float progress,
+                            int retry = 0);
     void onDownloadFinish(
         std::variant<index::IndexSongMetadata*, Song*>&& source,
-        Nongs* destination, geode::ByteVector&& data);
-    geode::Task<geode::Result<matjson::Value>, float> fetchIndex(
-        const index::IndexSource& index);
-    void onIndexFetched(const std::string& url,
-                        geode::Result<matjson::Value>* r);
+        Nongs* destination, std::filesystem::path&& path);
+    std::filesystem::path downloadPath(
+        const std::variant<index::IndexSongMetadata*, Song*>& source);
+    struct FetchedIndex {
+        std::string body;
+        // Validators for revalidating the cached copy on the next fetch
+        std::optional<std::string> etag;
+        std::optional<std::string> lastModified;
+    };
+    // std::nullopt if the cached copy is still up to date
+    using FetchIndexResult = geode::Result<std::optional<FetchedIndex>>;
+
+    void fetchIndex(const index::IndexSource& index,
+                    std::function<void(FetchIndexResult)> callback);
+    void onIndexFetched(const std::string& url, FetchIndexResult* r);
+    /**
+     * Fetches the changes to a loaded manifest 2 index since its version
+     * and applies them in place. Falls back to fetching the whole index if
+     * the server has no delta for that version.
+     */
+    void fetchIndexDelta(const index::IndexSource& source,
+                         const index::IndexMetadata& loaded);
+    /**
+     * Applies a delta to a loaded index, registering and unregistering only
+     * the songs it changes. Main thread only
+     */
+    geode::Result<> applyLoadedDelta(const std::string& url,
+                                     index::IndexDelta&& delta);
+    /**
+     * Appends a delta to the journal of deltas applied over a cached index
+     *
+     * @return how many deltas the journal holds now
+     */
+    static geode::Result<std::size_t> appendIndexDelta(
+        const std::filesystem::path& path, std::string_view text);
+    /**
+     * Folds the journaled deltas into the binary cache of an index and
+     * drops the journal and the JSON copy they applied to. Cache writer
+     * only
+     */
+    static geode::Result<> compactIndexCache(
+        const std::string& url, const std::filesystem::path& path,
+        const std::filesystem::path& binaryPath,
+        const std::filesystem::path& journalPath);
+    /**
+     * Applies the journaled deltas to an index loaded from the cache
+     */
+    static geode::Result<> replayIndexDeltas(const std::filesystem::path& path,
+                                             index::ParsedIndex& parsed);
+
+    // Written next to a cached index, whose bytes are kept as fetched
+    struct IndexSidecar {
+        std::string url;
+        std::optional<std::string> etag;
+        std::optional<std::string> lastModified;
+        // fnv1a64 of the cached bytes, a copy that doesn't match is dropped
+        std::uint64_t contentHash = 0;
+    };
+    static std::optional<IndexSidecar> readIndexSidecar(
+        const std::filesystem::path& path);
+    static geode::Result<> writeIndexSidecar(const std::filesystem::path& path,
+                                             const IndexSidecar& sidecar);
+
+    // Cache files are named after a stable hash of the index URL
+    std::filesystem::path indexCachePath(const std::string& url);
+    std::filesystem::path indexSidecarPath(const std::string& url);
+    std::filesystem::path indexBinaryCachePath(const std::string& url);
+    // Deltas applied since the cached copy was fetched, see fetchIndexDelta
+    std::filesystem::path indexDeltaJournalPath(const std::string& url);
+    std::unordered_set<std::string> indexCacheFilenames(
+        const std::vector<index::IndexSource>& indexes);
+    /**
+     * Removes cache files that belong to none of the configured indexes,
+     * like ones named by older versions
+     */
+    void pruneIndexCache(const std::vector<index::IndexSource>& indexes);
+
+    // Writes the cached indexes, their sidecars and delta journals in the
+    // order they were posted. Drained when GD saves and exits
+    SerialQueue m_cacheWriter;
+    /**
+     * Queues a write to the index cache. Safe to call from worker threads
+     */
+    static void postCacheWrite(std::function<void()> job);
+
+    // index url -> number of the latest load, older loads are dropped
+    std::unordered_map<std::string, std::uint64_t> m_indexLoads;
+
+    bool m_started = false;
+    struct DeferredIndex {
+        std::string url;
+        std::uint64_t ticket;
+        index::ParsedIndex parsed;
+    };
+    // Indexes loaded before the manifest was, init registers them
+    std::vector<DeferredIndex> m_deferredIndexes;
+    // index url -> content hash of the loaded copy
+    std::unordered_map<std::string, std::uint64_t> m_indexHashes;
+
+    // index id -> index name, read from the "cached-index-names" saved value
+    // once and written back at most once a frame
+    std::optional<std::unordered_map<std::string, std::string>> m_indexNames;
+    bool m_indexNamesDirty = false;
+    bool m_indexNamesFlushQueued = false;
+
+    std::unordered_map<std::string, std::string>& indexNames();
+
+    struct IndexFile {
+        // Decompressed if the file was stored compressed
+        std::string text;
+        std::uint64_t contentHash;
+    };
+
+    static geode::Result<IndexFile> readIndexFile(
+        const std::filesystem::path& path);
+    /**
+     * Builds an index and its songs from JSON, timed for the profiler. Safe
+     * to call from worker threads
+     */
+    static geode::Result<index::ParsedIndex> parseIndex(matjson::Value&& json);
+    /**
+     * Same as the above, read straight from JSON text
+     *
+     * @param metadata set to the index metadata without its songs, if given
+     */
+    static geode::Result<index::ParsedIndex> parseIndex(
+        std::string_view text, std::string_view url = {},
+        matjson::Value* metadata = nullptr);
+    /**
+     * Swaps a parsed index in and registers its songs. If an older copy of
+     * the index is loaded, only the songs that were added or removed since
+     * are registered or unregistered. Main thread only
+     */
+    void registerIndex(index::ParsedIndex&& parsed);
+    /**
+     * Adds songs of an index to a song ID
+     */
+    void registerIndexSongs(
+        int gdSongID, const std::vector<index::IndexSongMetadata*>& songs);
+    /**
+     * Groups the songs of a song ID that are the same track, by URL, YouTube
+     * ID, or name, artist and offset, and keeps the one from the highest
+     * priority index. Updates the index songs of its Nongs if loaded.
+     * Called whenever the songs of a song ID change
+     */
+    void mergeIndexSongs(int gdSongID);
+    /**
+     * Reads the index priorities from the "indexes" setting, merging every
+     * song ID again if they changed
+     */
+    void updateIndexPriority();
+    std::size_t indexPriority(const index::IndexMetadata* index) const;
+    /**
+     * Every index song registered for a song ID, duplicates included
+     */
+    std::span<index::IndexSongMetadata* const> registeredIndexSongs(
+        int gdSongID) const;
+    /**
+     * Cancels the queued and running downloads of these songs
+     */
+    void cancelDownloads(const std::unordered_set<std::string_view>& uniqueIDs);
+    /**
+     * Parses an index, then queues writing its binary cache. Safe to call
+     * from worker threads
+     *
+     * @param text the index JSON text
+     * @param url the URL of the index
+     * @param binaryPath where to write the binary cache
+     * @param contentHash hash of the cached JSON text
+     */
+    static geode::Result<index::ParsedIndex> parseIndexAndCache(
+        std::string_view text, std::string_view url,
+        const std::filesystem::path& binaryPath, std::uint64_t contentHash);
+    /**
+     * Queues writing the binary cache of a parsed index
+     *
+     * @param binaryPath where to write the binary cache
+     * @param metadata the index metadata, as parseIndex gave it
+     * @param parsed the parsed index
+     */
+    static void postBinaryCacheWrite(const std::filesystem::path& binaryPath,
+                                     const matjson::Value& metadata,
+                                     const index::ParsedIndex& parsed);
+    /**
+     * Loads an index on a worker thread, then registers it
+     *
+     * @param url the URL of the index
+     * @param load produces the index, called on the worker thread
+     */
+    void loadIndexInBackground(
+        const std::string& url,
+        std::function<geode::Result<index::ParsedIndex>()> load);
+    /**
+     * Drops a loaded index and every reference to its songs
+     */
+    void unloadIndex(const std::string& indexID);
 
 public:
+    /**
+     * Starts loading the cached indexes and fetching every index. Doesn't
+     * touch the manifest, so it runs while the manifest is still loading.
+     */
+    void start();
+    /**
+     * Registers the indexes loaded so far with the manifest, and every index
+     * loaded from then on as it arrives. Starts first if start wasn't called.
+     * The manifest has to be loaded.
+     */
     bool init();
     // index id -> index metadata
     std::unordered_map<std::string, std::unique_ptr<index::IndexMetadata>>
@@ -69,24 +385,146 @@ public:
 
     bool initialized() const { return m_initialized; }
 
+    /**
+     * Refetches every enabled index and unloads disabled ones. Downloads are
+     * left running unless their song is gone after the refetch.
+     */
     geode::Result<> fetchIndexes();
 
     geode::Result<> loadIndex(std::filesystem::path path);
     geode::Result<> loadIndex(matjson::Value&& jsonObj);
 
     geode::Result<std::vector<index::IndexSource>> getIndexes();
+    /**
+     * Names of the cache files the configured indexes, enabled or not, may
+     * have. Other files in the indexes directory are pruned on start.
+     */
+    std::unordered_set<std::string> indexCacheFilenames();
 
-    std::optional<float> getSongDownloadProgress(const std::string& uniqueID);
+    std::optional<float> getSongDownloadProgress(UniqueID uniqueID);
     std::optional<std::string> getIndexName(const std::string& indexID);
     void cacheIndexName(const std::string& indexId,
                         const std::string& indexName);
+    /**
+     * Writes index names cached since the last flush to the saved values
+     */
+    void flushIndexNames();
+    /**
+     * Waits for the queued index cache writes, stopping at the deadline
+     *
+     * @return whether they are all on disk
+     */
+    bool flushCachesUntil(std::chrono::steady_clock::time_point deadline) {
+        return m_cacheWriter.drainUntil(deadline);
+    }
+    /**
+     * Flushes before the game exits. Writes that didn't start by the
+     * deadline are dropped, the copies on disk stay valid and the indexes
+     * are fetched again on the next start.
+     */
+    void flushCachesForExit(std::chrono::steady_clock::time_point deadline);
 
     std::filesystem::path baseIndexesPath();
 
-    geode::Result<> downloadSong(int gdSongID, const std::string& uniqueID);
+    /**
+     * Loads the cached copies of the enabled indexes in the background. Run
+     * on start, and again when a bundle brings in new copies.
+     */
+    void loadCachedIndexes();
+
+    /**
+     * Queues a song download. At most "max-concurrent-downloads" downloads
+     * run at once, the rest wait for a free slot.
+     *
+     * @param background wait until no other download is queued, and take at
+     * most one slot
+     */
+    geode::Result<> downloadSong(int gdSongID, UniqueID uniqueID,
+                                 bool background = false);
+    /**
+     * Downloads the preferred index song of a song ID in the background, if
+     * "download-ahead" is on, none of its index songs is stored yet and the
+     * downloaded NONGs budget has room. For song IDs of levels that are
+     * likely to be opened soon, like the ones in the level browser.
+     */
+    void prefetchSong(int gdSongID);
+    /**
+     * Cancels a queued or running download. Posts SongDownloadFailed.
+     */
+    void cancelDownload(UniqueID uniqueID);
+    void cancelAllDownloads();
+    /**
+     * Downloads for these song IDs are started before any other queued ones.
+     * Set to the songs of the level being viewed.
+     *
+     * @return a token to clear them with
+     */
+    std::uint64_t setPrioritySongIDs(std::unordered_set<int> songIDs);
+    /**
+     * Drops the priority song IDs, unless others were set since
+     *
+     * @param token what setPrioritySongIDs returned
+     */
+    void clearPrioritySongIDs(std::uint64_t token);
+
+    /**
+     * Queues the first downloadable index song of every song ID that doesn't
+     * have one of its index songs stored yet. Downloaded songs are set active
+     * for song IDs still playing their default song, and the manifest is
+     * written once after the last download.
+     *
+     * @return the number of songs queued
+     */
+    geode::Result<std::size_t> downloadAll(std::span<const int> gdSongIDs);
+
+    struct BulkProgress {
+        std::size_t finished;
+        std::size_t total;
+        // 0 to 100, counting the progress of running downloads
+        float percent;
+    };
+
+    /**
+     * Progress of the running downloadAll, std::nullopt if there is none
+     */
+    std::optional<BulkProgress> getBulkDownloadProgress() const;
+
+    /**
+     * Estimated memory of the loaded indexes, their lookup tables and the
+     * running downloads, for the profiler popup
+     */
+    std::vector<MemoryUsage> memoryUsage() const;
 
     void registerIndexNongs(Nongs* destination);
 
+    // Read-only view of the index songs registered for a song ID
+    using IndexSongs = std::span<index::IndexSongMetadata* const>;
+
+    /**
+     * Index songs registered for a song ID, without copying, with the same
+     * track from several indexes listed once. Empty if no loaded index has
+     * songs for it. Valid until an index is loaded or unloaded
+     */
+    IndexSongs getIndexSongs(int gdSongID) const;
+
+    /**
+     * Whether any loaded index has songs for a song ID. Cheap enough to
+     * call for every cell of a level list, it doesn't allocate.
+     */
+    bool hasIndexSongs(int gdSongID);
+    /**
+     * The same track as a song of a song ID, from lower priority indexes,
+     * best first. Downloads can fall back to them. Empty if it has none
+     */
+    IndexSongs getMirrors(int gdSongID,
+                          index::IndexSongMetadata* song) const;
+    /**
+     * getIndexSongs for many song IDs at once, e.g. every asset of a level
+     *
+     * @return the songs of gdSongIDs[i] at index i
+     */
+    std::vector<IndexSongs> getIndexSongs(std::span<const int> gdSongIDs) const;
+
     static IndexManager& get() {
         static IndexManager instance;
         return instance;
@@ -0,0 +1,419 @@
+#include <jukebox/managers/library_import_manager.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/binding/FLAlertLayer.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+#include <Geode/utils/Task.hpp>
+
+#include <jukebox/events/manual_song_added.hpp>
+#include <jukebox/managers/blob_store.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/executor.hpp>
+#include <jukebox/utils/file_import.hpp>
+#include <jukebox/utils/parallel_for.hpp>
+#include <jukebox/utils/random_string.hpp>
+#include <jukebox/utils/tag_reader.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+std::string toUtf8(const std::filesystem::path& path) {
+    const std::u8string str = path.u8string();
+    return std::string(str.begin(), str.end());
+}
+
+std::string lowerExtension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return extension;
+}
+
+bool isSongFile(const std::filesystem::path& path) {
+    const std::string extension = lowerExtension(path);
+    return extension == ".mp3" || extension == ".ogg" ||
+           extension == ".wav" || extension == ".flac";
+}
+
+// Songs imported from the same folder before are skipped
+bool alreadyStored(int gdSongID, const std::string& name,
+                   const std::string& artist) {
+    std::optional<Nongs*> nongs = NongManager::get().getNongs(gdSongID);
+    if (!nongs.has_value()) {
+        return false;
+    }
+    for (const std::unique_ptr<LocalSong>& local : nongs.value()->locals()) {
+        const SongMetadata* metadata = local->metadata();
+        if (metadata->name == name && metadata->artist == artist) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+Result<LibraryImportManager::FilenamePattern>
+LibraryImportManager::parsePattern(std::string_view pattern) {
+    constexpr std::string_view special = "\\^$.|?+()[]{}";
+
+    FilenamePattern ret;
+    std::string expression;
+    std::size_t group = 0;
+
+    for (std::size_t i = 0; i < pattern.size(); i++) {
+        const char c = pattern[i];
+        if (c == '*') {
+            expression += ".*?";
+            continue;
+        }
+        if (c != '{') {
+            if (special.find(c) != std::string_view::npos) {
+                expression += '\\';
+            }
+            expression += c;
+            continue;
+        }
+
+        const std::size_t end = pattern.find('}', i);
+        if (end == std::string_view::npos) {
+            return Err("Unclosed {} in the file name pattern", "{");
+        }
+        const std::string_view field = pattern.substr(i + 1, end - i - 1);
+        std::size_t* target = field == "id"       ? &ret.idGroup
+                              : field == "artist" ? &ret.artistGroup
+                              : field == "title"  ? &ret.titleGroup
+                                                  : nullptr;
+        if (!target) {
+            return Err("Unknown field {{{}}} in the file name pattern", field);
+        }
+        if (*target != 0) {
+            return Err("{{{}}} appears twice in the file name pattern", field);
+        }
+        *target = ++group;
+        expression += field == "id" ? "(\\d+)" : "(.+?)";
+        i = end;
+    }
+
+    if (ret.idGroup == 0) {
+        return Err("The file name pattern needs an {} field", "{id}");
+    }
+
+    ret.regex = std::regex(expression,
+                           std::regex::ECMAScript | std::regex::icase);
+    return Ok(std::move(ret));
+}
+
+LibraryImportManager::ScanTask LibraryImportManager::scanFolder(
+    std::filesystem::path folder, FilenamePattern pattern) {
+    return Executor::get().run<ScanTask>(
+        Executor::Priority::Bulk,
+        [folder = std::move(folder), pattern = std::move(pattern)](
+            auto progress, auto hasBeenCanceled) -> ScanTask::Result {
+            Scan scan;
+            // What the pattern captured, used when the tags are missing
+            std::vector<std::pair<std::string, std::string>> captured;
+
+            std::error_code ec;
+            auto it = std::filesystem::recursive_directory_iterator(
+                folder,
+                std::filesystem::directory_options::skip_permission_denied,
+                ec);
+            for (; !ec && it != std::filesystem::recursive_directory_iterator();
+                 it.increment(ec)) {
+                if (hasBeenCanceled()) {
+                    return ScanTask::Cancel();
+                }
+                std::error_code fileEc;
+                if (!it->is_regular_file(fileEc) || !isSongFile(it->path())) {
+                    continue;
+                }
+
+                const std::string stem = toUtf8(it->path().stem());
+                std::smatch match;
+                int gdSongID = 0;
+                if (!std::regex_match(stem, match, pattern.regex)) {
+                    scan.unmatched++;
+                    continue;
+                }
+                const std::string id = match[pattern.idGroup].str();
+                auto [end, err] = std::from_chars(
+                    id.data(), id.data() + id.size(), gdSongID);
+                if (err != std::errc() || gdSongID <= 0) {
+                    scan.unmatched++;
+                    continue;
+                }
+
+                scan.files.push_back(ScannedFile{.gdSongID = gdSongID,
+                                                 .source = it->path(),
+                                                 .name = stem,
+                                                 .artist = "Unknown"});
+                captured.emplace_back(
+                    pattern.titleGroup ? match[pattern.titleGroup].str() : "",
+                    pattern.artistGroup ? match[pattern.artistGroup].str()
+                                        : "");
+            }
+
+            const std::size_t total = scan.files.size();
+            std::vector<SongTags> tags(total);
+            std::atomic<std::size_t> done = 0;
+            std::atomic<bool> stop = false;
+
+            // Tags are a few small reads per file, so reading several files
+            // at once hides the latency of slow or network drives. Progress
+            // and cancellation are only handled on the task's own thread.
+            const std::thread::id scanner = std::this_thread::get_id();
+            parallel_for(
+                total,
+                [&](std::size_t i) {
+                    if (stop) {
+                        return;
+                    }
+                    tags[i] = readTags(scan.files[i].source);
+                    const std::size_t finished = ++done;
+                    if (std::this_thread::get_id() != scanner) {
+                        return;
+                    }
+                    if (hasBeenCanceled()) {
+                        stop = true;
+                        return;
+                    }
+                    progress(Progress{.copying = false,
+                                      .finished = finished,
+                                      .total = total});
+                },
+                Executor::Priority::Normal, s_maxReaders);
+            if (stop) {
+                return ScanTask::Cancel();
+            }
+
+            // Tags win over the file name, then the file name over the
+            // defaults
+            for (std::size_t i = 0; i < total; i++) {
+                ScannedFile& file = scan.files[i];
+                auto& [title, artist] = captured[i];
+                if (tags[i].title.has_value()) {
+                    file.name = std::move(tags[i].title.value());
+                } else if (!title.empty()) {
+                    file.name = std::move(title);
+                }
+                if (tags[i].artist.has_value()) {
+                    file.artist = std::move(tags[i].artist.value());
+                } else if (!artist.empty()) {
+                    file.artist = std::move(artist);
+                }
+            }
+
+            return scan;
+        },
+        "Scanning song folder");
+}
+
+LibraryImportManager::CopyTask LibraryImportManager::copySongs(
+    std::vector<std::pair<std::filesystem::path, LocalSong>> files) {
+    return Executor::get().run<CopyTask>(
+        Executor::Priority::Bulk,
+        [files = std::move(files)](auto progress,
+                                   auto hasBeenCanceled) -> CopyTask::Result {
+            Copied copied;
+            for (std::size_t i = 0; i < files.size(); i++) {
+                if (hasBeenCanceled()) {
+                    // Nothing was added yet, so nothing refers to these
+                    for (const LocalSong& song : copied.songs) {
+                        std::error_code ec;
+                        std::filesystem::remove(song.path().value(), ec);
+                    }
+                    return CopyTask::Cancel();
+                }
+                progress(Progress{
+                    .copying = true, .finished = i, .total = files.size()});
+
+                const auto& [source, song] = files[i];
+                Result<> res = importFileNow(source, song.path().value());
+                if (res.isErr()) {
+                    log::warn("Couldn't import {}: {}", toUtf8(source),
+                              res.unwrapErr());
+                    copied.failed++;
+                    continue;
+                }
+                copied.songs.push_back(song);
+            }
+            return copied;
+        },
+        "Importing song folder");
+}
+
+Result<> LibraryImportManager::start(std::filesystem::path folder) {
+    if (m_progress.has_value()) {
+        return Err("A folder is already being imported");
+    }
+
+    const std::string setting =
+        Mod::get()->getSettingValue<std::string>("library-import-pattern");
+    GEODE_UNWRAP_INTO(FilenamePattern pattern, parsePattern(setting));
+
+    m_unmatched = 0;
+    m_skipped = 0;
+    m_progress = Progress{.copying = false, .finished = 0, .total = 0};
+    m_scanListener.bind(this, &LibraryImportManager::onScanEvent);
+    m_scanListener.setFilter(scanFolder(std::move(folder), std::move(pattern)));
+    return Ok();
+}
+
+void LibraryImportManager::onScanEvent(ScanTask::Event* event) {
+    if (Progress* progress = event->getProgress()) {
+        m_progress = *progress;
+        return;
+    }
+    if (event->isCancelled()) {
+        m_progress.reset();
+        return;
+    }
+    Scan* scan = event->getValue();
+    if (!scan) {
+        return;
+    }
+
+    m_unmatched = scan->unmatched;
+
+    std::vector<std::pair<std::filesystem::path, LocalSong>> files;
+    files.reserve(scan->files.size());
+    for (ScannedFile& file : scan->files) {
+        if (alreadyStored(file.gdSongID, file.name, file.artist)) {
+            m_skipped++;
+            continue;
+        }
+        std::string id = jukebox::random_string(16);
+        std::filesystem::path destination =
+            NongManager::get().generateSongFilePath(
+                lowerExtension(file.source), id);
+        files.emplace_back(
+            std::move(file.source),
+            LocalSong{SongMetadata{file.gdSongID, UniqueID(id),
+                                   std::move(file.name),
+                                   std::move(file.artist)},
+                      std::move(destination)});
+    }
+
+    if (files.empty()) {
+        this->finish("No new songs were found in the folder.");
+        return;
+    }
+
+    m_progress =
+        Progress{.copying = true, .finished = 0, .total = files.size()};
+    m_copyListener.bind(this, &LibraryImportManager::onCopyEvent);
+    m_copyListener.setFilter(copySongs(std::move(files)));
+}
+
+void LibraryImportManager::onCopyEvent(CopyTask::Event* event) {
+    if (Progress* progress = event->getProgress()) {
+        m_progress = *progress;
+        return;
+    }
+    if (event->isCancelled()) {
+        m_progress.reset();
+        return;
+    }
+    Copied* copied = event->getValue();
+    if (!copied) {
+        return;
+    }
+
+    const std::size_t added = this->addSongs(std::move(copied->songs));
+    std::string message = fmt::format("Imported <cg>{}</c> songs.", added);
+    if (copied->failed > 0) {
+        message += fmt::format(" <cr>{}</c> couldn't be copied.",
+                               copied->failed);
+    }
+    this->finish(std::move(message));
+}
+
+std::size_t LibraryImportManager::addSongs(std::vector<LocalSong>&& songs) {
+    std::unordered_map<int, Nongs> batches;
+    for (LocalSong& song : songs) {
+        const int gdSongID = song.metadata()->gdID;
+        Nongs& batch = batches.try_emplace(gdSongID, gdSongID).first->second;
+        (void)batch.add(std::move(song));
+    }
+
+    auto discard = [](const Nongs& batch) {
+        for (const std::unique_ptr<LocalSong>& local : batch.locals()) {
+            std::error_code ec;
+            std::filesystem::remove(local->path().value(), ec);
+        }
+    };
+
+    std::size_t count = 0;
+    // Every song ID saves once, together, after the last addNongs
+    NongManager::get().holdSaves();
+    for (auto& [gdSongID, batch] : batches) {
+        if (!NongManager::get().hasSongID(gdSongID)) {
+            Result<Nongs*> init =
+                NongManager::get().initSongID(std::nullopt, gdSongID, false);
+            if (init.isErr()) {
+                log::error("Failed to initialize song ID {}: {}", gdSongID,
+                           init.unwrapErr());
+                discard(batch);
+                continue;
+            }
+        }
+
+        Result<std::vector<Song*>> res =
+            NongManager::get().addNongs(std::move(batch));
+        if (res.isErr()) {
+            log::error("Failed to add songs for song ID {}: {}", gdSongID,
+                       res.unwrapErr());
+            discard(batch);
+            continue;
+        }
+
+        Nongs* nongs = NongManager::get().getNongs(gdSongID).value();
+        for (Song* song : res.unwrap()) {
+            BlobStore::get().intern(song->path().value());
+            event::ManualSongAdded(nongs, song).post();
+            count++;
+        }
+    }
+    NongManager::get().releaseSaves();
+
+    return count;
+}
+
+void LibraryImportManager::finish(std::string message) {
+    m_progress.reset();
+
+    if (m_skipped > 0) {
+        message += fmt::format(" {} were already added.", m_skipped);
+    }
+    if (m_unmatched > 0) {
+        message += fmt::format(
+            " {} files didn't match the file name pattern.", m_unmatched);
+    }
+    FLAlertLayer::create("Folder import", message, "Ok")->show();
+}
+
+}  // namespace jukebox
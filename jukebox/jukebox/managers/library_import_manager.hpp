@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <Geode/loader/Event.hpp>
+#include <Geode/utils/Task.hpp>
+
+#include <jukebox/nong/nong.hpp>
+
+namespace jukebox {
+
+/**
+ * Imports a whole folder of local songs. Files are mapped to GD song IDs
+ * through the filename pattern in the mod settings, and named from their
+ * tags, read on several threads at once. Each song ID gets all of its new
+ * songs through one addNongs, and the manifest is saved once at the end.
+ */
+class LibraryImportManager {
+public:
+    struct Progress {
+        // Reading tags first, then copying the files into the nongs folder
+        bool copying;
+        std::size_t finished;
+        std::size_t total;
+    };
+
+protected:
+    struct ScannedFile {
+        int gdSongID;
+        std::filesystem::path source;
+        std::string name;
+        std::string artist;
+    };
+
+    struct Scan {
+        std::vector<ScannedFile> files;
+        // Audio files the pattern didn't match
+        std::size_t unmatched = 0;
+    };
+
+    struct Copied {
+        std::vector<LocalSong> songs;
+        std::size_t failed = 0;
+    };
+
+    // Capture groups of the fields, 0 when the pattern doesn't have one
+    struct FilenamePattern {
+        std::regex regex;
+        std::size_t idGroup = 0;
+        std::size_t artistGroup = 0;
+        std::size_t titleGroup = 0;
+    };
+
+    using ScanTask = geode::Task<Scan, Progress>;
+    using CopyTask = geode::Task<Copied, Progress>;
+
+    // Threads reading tags at once, capped by the executor's workers
+    constexpr static inline std::size_t s_maxReaders = 8;
+
+    geode::EventListener<ScanTask> m_scanListener;
+    geode::EventListener<CopyTask> m_copyListener;
+    std::optional<Progress> m_progress;
+    std::size_t m_unmatched = 0;
+    std::size_t m_skipped = 0;
+
+    LibraryImportManager() = default;
+
+    LibraryImportManager(const LibraryImportManager&) = delete;
+    LibraryImportManager(LibraryImportManager&&) = delete;
+
+    LibraryImportManager& operator=(const LibraryImportManager&) = delete;
+    LibraryImportManager& operator=(LibraryImportManager&&) = delete;
+
+    /**
+     * Compiles a pattern like "{id} - {artist} - {title}". The fields match
+     * parts of the file name without its extension, * matches anything and
+     * everything else is matched literally, ignoring case.
+     */
+    static geode::Result<FilenamePattern> parsePattern(
+        std::string_view pattern);
+    static ScanTask scanFolder(std::filesystem::path folder,
+                               FilenamePattern pattern);
+    static CopyTask copySongs(
+        std::vector<std::pair<std::filesystem::path, LocalSong>> files);
+
+    void onScanEvent(ScanTask::Event* event);
+    void onCopyEvent(CopyTask::Event* event);
+    /**
+     * Adds the copied songs, one addNongs per song ID
+     *
+     * @return how many songs were added
+     */
+    std::size_t addSongs(std::vector<LocalSong>&& songs);
+    void finish(std::string message);
+
+public:
+    /**
+     * Starts importing every mp3, ogg, wav and flac file in folder and its
+     * subfolders
+     *
+     * @return Err if an import is already running or the pattern is invalid
+     */
+    geode::Result<> start(std::filesystem::path folder);
+
+    /**
+     * Progress of the running import, nullopt if there is none
+     */
+    std::optional<Progress> progress() const { return m_progress; }
+
+    static LibraryImportManager& get() {
+        static LibraryImportManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
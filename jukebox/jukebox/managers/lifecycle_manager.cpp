@@ -0,0 +1,62 @@
+#include <jukebox/managers/lifecycle_manager.hpp>
+
+#include <chrono>
+
+#include <Geode/loader/Log.hpp>
+
+#include <jukebox/managers/analysis_manager.hpp>
+#include <jukebox/managers/audio_cache_manager.hpp>
+#include <jukebox/managers/index_manager.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/utils/profiler.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+void LifecycleManager::onDataSaved() {
+    if (m_exited) {
+        return;
+    }
+
+    ProfileScope profile("LifecycleManager::onDataSaved");
+    const auto deadline = std::chrono::steady_clock::now() + s_saveBudget;
+    IndexManager::get().flushIndexNames();
+    NongManager::get().flushNongs();
+    AudioCacheManager::get().flush();
+    AnalysisManager::get().flush();
+
+    bool done = NongManager::get().flushNongsUntil(deadline);
+    done = IndexManager::get().flushCachesUntil(deadline) && done;
+    done = AudioCacheManager::get().flushUntil(deadline) && done;
+    done = AnalysisManager::get().flushUntil(deadline) && done;
+    if (!done) {
+        log::info("Saved with writes still running, they finish in the "
+                  "background");
+    }
+}
+
+void LifecycleManager::onExit() {
+    if (m_exited) {
+        return;
+    }
+    m_exited = true;
+
+    ProfileScope profile("LifecycleManager::onExit");
+    const auto deadline = std::chrono::steady_clock::now() + s_exitBudget;
+    IndexManager::get().flushIndexNames();
+    NongManager::get().flushNongs();
+    AudioCacheManager::get().flush();
+    AnalysisManager::get().flush();
+
+    NongManager::get().flushNongsForExit(deadline);
+    IndexManager::get().flushCachesForExit(deadline);
+    bool done = AudioCacheManager::get().flushUntil(deadline);
+    done = AnalysisManager::get().flushUntil(deadline) && done;
+    if (!done) {
+        log::warn("Exiting before the NONG cache state and analyses were "
+                  "saved, they finish while the game closes");
+    }
+}
+
+}  // namespace jukebox
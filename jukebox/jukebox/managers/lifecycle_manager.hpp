@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+
+namespace jukebox {
+
+/**
+ * Gets pending writes to disk when GD saves and when it exits, without
+ * holding either up for long. Every writer is handed its work first, so
+ * they run side by side, then waited for until a shared deadline.
+ *
+ * Saves leave what isn't done by then running in the background. On exit
+ * the manifest writes still queued are dropped and written to the recovery
+ * journal in a single append instead, so no change to the NONGs is lost.
+ * Index cache writes still queued are dropped, the indexes are fetched
+ * again. The play times and analyses are written whole and are only
+ * waited for.
+ */
+class LifecycleManager {
+protected:
+    constexpr static inline std::chrono::milliseconds s_saveBudget{500};
+    constexpr static inline std::chrono::milliseconds s_exitBudget{250};
+
+    bool m_exited = false;
+
+    LifecycleManager() = default;
+
+    LifecycleManager(const LifecycleManager&) = delete;
+    LifecycleManager(LifecycleManager&&) = delete;
+
+    LifecycleManager& operator=(const LifecycleManager&) = delete;
+    LifecycleManager& operator=(LifecycleManager&&) = delete;
+
+public:
+    void onDataSaved();
+    /**
+     * Flushes for the last time. Saves after it don't wait anymore.
+     */
+    void onExit();
+
+    static LifecycleManager& get() {
+        static LifecycleManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
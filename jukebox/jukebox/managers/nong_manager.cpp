@@ -1,88 +1,179 @@
 #include <jukebox/managers/nong_manager.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <ios>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <ranges>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <fmt/chrono.h>
 #include <fmt/core.h>
 #include <Geode/Result.hpp>
-#include <Geode/binding/LevelTools.hpp>
-#include <Geode/binding/MusicDownloadManager.hpp>
-#include <Geode/binding/SongInfoObject.hpp>
+#include <Geode/cocos/CCDirector.h>
+#include <Geode/cocos/CCScheduler.h>
+#include <Geode/loader/Loader.hpp>
 #include <Geode/loader/Log.hpp>
 #include <matjson.hpp>
 
 #include <jukebox/compat/compat.hpp>
 #include <jukebox/compat/v2.hpp>
+#include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/managers/analysis_manager.hpp>
+#include <jukebox/managers/file_status_cache.hpp>
 #include <jukebox/managers/index_manager.hpp>
+#include <jukebox/nong/manifest_journal.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/nong/nong_parser.hpp>
 #include <jukebox/nong/nong_serialize.hpp>
+#include <jukebox/nong/packed_manifest.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/executor.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/parallel_for.hpp>
+#include <jukebox/utils/profiler.hpp>
 #include <jukebox/utils/random_string.hpp>
 
 using namespace geode::prelude;
 
 namespace jukebox {
 
+namespace {
+
+// Scheduler target for the delayed manifest flush
+class ManifestFlushTimer : public CCObject {
+public:
+    void onFlush(float) { NongManager::get().flushNongs(); }
+
+    static ManifestFlushTimer* get() {
+        static ManifestFlushTimer* instance = new ManifestFlushTimer();
+        return instance;
+    }
+};
+
+}  // namespace
+
 std::optional<Nongs*> NongManager::getNongs(int songID) {
-    if (!m_manifest.m_nongs.contains(songID)) {
+    if (auto it = m_manifest.m_nongs.find(songID);
+        it != m_manifest.m_nongs.end()) {
+        return it->second.get();
+    }
+
+    return this->hydrateNongs(songID);
+}
+
+std::optional<Nongs*> NongManager::getLoadedNongs(int songID) {
+    if (auto it = m_manifest.m_nongs.find(songID);
+        it != m_manifest.m_nongs.end()) {
+        return it->second.get();
+    }
+
+    return std::nullopt;
+}
+
+std::optional<Nongs*> NongManager::hydrateNongs(int songID) {
+    if (!m_unloadedNongs.erase(songID)) {
         return std::nullopt;
     }
+    ProfileScope profile("NongManager::hydrateNongs");
+
+    const std::filesystem::path path =
+        this->baseManifestPath() / fmt::format("{}.json", songID);
+
+    Result<std::unique_ptr<Nongs>> res =
+        m_packedStore ? m_packedStore->read(songID)
+                      : this->loadNongsFromPath(path);
 
-    return m_manifest.m_nongs[songID].get();
+    if (res.isErr()) {
+        log::error("Failed to read manifest for ID {}: {}", songID,
+                   res.unwrapErr());
+        if (!m_packedStore) {
+            std::error_code ec;
+            std::filesystem::rename(
+                path,
+                this->baseManifestPath() / fmt::format("{}.json.bak", songID),
+                ec);
+        }
+        return std::nullopt;
+    }
+
+    Nongs* nongs = res.unwrap().get();
+    m_manifest.m_nongs.insert({songID, std::move(res.unwrap())});
+    IndexManager::get().registerIndexNongs(nongs);
+    this->markSnapshotDirty(songID);
+
+    return nongs;
 }
 
 int NongManager::getCurrentManifestVersion() { return m_manifest.m_version; }
 
-int NongManager::getStoredIDCount() { return m_manifest.m_nongs.size(); }
+int NongManager::getStoredIDCount() {
+    return m_manifest.m_nongs.size() + m_unloadedNongs.size();
+}
 
 int NongManager::adjustSongID(int id, bool robtop) {
     return robtop ? (id < 0 ? id : -id - 1) : id;
 }
 
-bool NongManager::hasSongID(int id) { return m_manifest.m_nongs.contains(id); }
+bool NongManager::hasSongID(int id) {
+    return m_manifest.m_nongs.contains(id) || m_unloadedNongs.contains(id);
+}
 
-Result<Nongs*> NongManager::initSongID(SongInfoObject* obj, int id,
-                                       bool robtop) {
+Result<Nongs*> NongManager::initSongID(std::optional<host::SongInfo> info,
+                                       int id, bool robtop) {
+    ProfileScope profile("NongManager::initSongID");
     int adjusted = this->adjustSongID(id, robtop);
 
     if (this->hasSongID(adjusted)) {
         return Err("Song already exists");
     }
 
-    if (!obj && robtop) {
-        return Err("Critical. No song object for RobTop song");
+    if (!info && robtop) {
+        return Err("Critical. No song info for RobTop song");
     }
 
-    if (obj && robtop) {
-        std::string filename = LevelTools::getAudioFileName(id);
-        std::filesystem::path gdDir = std::filesystem::path(
-            CCFileUtils::sharedFileUtils()->getWritablePath2().c_str());
+    if (info && robtop) {
         std::unique_ptr<Nongs> nongs = std::make_unique<Nongs>(
             Nongs{adjusted,
-                  LocalSong{SongMetadata{adjusted, jukebox::random_string(16),
-                                         obj->m_songName, obj->m_artistName},
-                            gdDir / "Resources" / filename}});
+                  LocalSong{SongMetadata{adjusted,
+                                         UniqueID(jukebox::random_string(16)),
+                                         info->name, info->artist},
+                            host::robtopSongPath(id)}});
 
         Nongs* n = nongs.get();
         m_manifest.m_nongs.insert({adjusted, std::move(nongs)});
         IndexManager::get().registerIndexNongs(n);
+        this->markSnapshotDirty(adjusted);
 
         return Ok(n);
     }
 
-    if (!obj) {
+    if (!info) {
         // See if we already have it stored in the savefile
-        obj = MusicDownloadManager::sharedState()->getSongInfoObject(id);
+        info = host::songInfo(id);
     }
 
-    if (!obj) {
+    if (!info) {
         // Try fetch song info from servers
-        MusicDownloadManager::sharedState()->getSongInfo(id, true);
+        host::fetchSongInfo(id, false);
         std::unique_ptr<Nongs> nongs =
             std::make_unique<Nongs>(Nongs{id, LocalSong::createUnknown(id)});
 
@@ -90,94 +181,238 @@ Result<Nongs*> NongManager::initSongID(SongInfoObject* obj, int id,
         m_manifest.m_nongs.insert({adjusted, std::move(nongs)});
 
         IndexManager::get().registerIndexNongs(n);
+        this->markSnapshotDirty(adjusted);
         return Ok(n);
     }
 
-    // Finally, if obj exists just insert normally
-    std::unique_ptr<Nongs> nongs = std::make_unique<Nongs>(Nongs{
-        adjusted,
-        LocalSong{SongMetadata{adjusted, jukebox::random_string(16),
-                               obj->m_songName, obj->m_artistName},
-                  std::filesystem::path(MusicDownloadManager::sharedState()
-                                            ->pathForSong(id)
-                                            .c_str())}});
+    // Finally, if the info exists just insert normally
+    std::unique_ptr<Nongs> nongs = std::make_unique<Nongs>(
+        Nongs{adjusted,
+              LocalSong{SongMetadata{adjusted,
+                                     UniqueID(jukebox::random_string(16)),
+                                     info->name, info->artist},
+                        host::gdSongPath(id)}});
 
     Nongs* n = nongs.get();
     m_manifest.m_nongs.insert({adjusted, std::move(nongs)});
 
     IndexManager::get().registerIndexNongs(n);
+    this->markSnapshotDirty(adjusted);
     return Ok(n);
 }
 
-std::string NongManager::getFormattedSize(const std::filesystem::path& path) {
-    std::error_code code;
-    auto size = std::filesystem::file_size(path, code);
-    if (code) {
-        return "N/A";
-    }
-    double toMegabytes = size / 1024.f / 1024.f;
+std::string NongManager::formatSize(std::uintmax_t bytes) {
+    double toMegabytes = static_cast<double>(bytes) / 1024.0 / 1024.0;
     std::stringstream ss;
     ss << std::setprecision(3) << toMegabytes << "MB";
     return ss.str();
 }
 
+std::string NongManager::getFormattedSize(const std::filesystem::path& path) {
+    std::optional<std::uintmax_t> size = this->assetSize(path);
+    if (!size) {
+        return "N/A";
+    }
+    return formatSize(size.value());
+}
+
+std::optional<std::uintmax_t> NongManager::assetSize(
+    const std::filesystem::path& path) {
+    std::optional<FileStatus> status = FileStatusCache::get().status(path);
+    if (!status) {
+        return std::nullopt;
+    }
+    return status->size;
+}
+
+std::vector<MemoryUsage> NongManager::memoryUsage() const {
+    MemoryUsage loaded{"NONGs", m_manifest.m_nongs.size(),
+                       m_manifest.m_nongs.memoryUsage()};
+    for (const auto& [_, nongs] : m_manifest.m_nongs) {
+        loaded.bytes += nongs->memoryUsage();
+    }
+    // Only their song IDs are kept until they're first used
+    MemoryUsage unloaded{"Unloaded song IDs", m_unloadedNongs.size(),
+                         memory::heapBytes(m_unloadedNongs)};
+    return {loaded, unloaded, UniqueID::memoryUsage()};
+}
+
 NongManager::MultiAssetSizeTask NongManager::getMultiAssetSizes(
     std::string songs, std::string sfx) {
-    auto resources =
-        std::filesystem::path(CCFileUtils::get()->getWritablePath2()) /
-        "Resources";
-    auto songDir = std::filesystem::path(CCFileUtils::get()->getWritablePath());
+    ProfileScope profile("NongManager::getMultiAssetSizes");
+    auto parseIDs = [](std::string_view list) {
+        std::vector<int> ids;
+        for (auto part : std::views::split(list, ',')) {
+            std::string_view str(part.begin(), part.end());
+            int id = 0;
+            auto res = std::from_chars(str.data(), str.data() + str.size(), id);
+            if (res.ec == std::errc()) {
+                ids.push_back(id);
+            }
+        }
+        return ids;
+    };
+    std::vector<int> songIDs = parseIDs(songs);
+    std::vector<int> sfxIDs = parseIDs(sfx);
+
+    // Lazily stored songs have to be loaded to be in the snapshot
+    for (int id : songIDs) {
+        (void)this->getNongs(id);
+    }
+    std::shared_ptr<const ManifestSnapshot> snapshot =
+        this->manifestSnapshot();
+
+    std::erase_if(m_assetSizeTasks,
+                  [](const auto& kv) { return !kv.second.isPending(); });
+    std::string key = fmt::format("{}|{}|{}", songs, sfx, snapshot->version);
+    if (auto it = m_assetSizeTasks.find(key); it != m_assetSizeTasks.end()) {
+        return it->second;
+    }
 
-    return MultiAssetSizeTask::run(
-        [this, songs, sfx, resources, songDir](
+    // The game's directories are read from its singletons, which only the
+    // main thread may touch
+    std::filesystem::path resources = host::gdResourcesDir();
+    std::filesystem::path songDir = host::gdSongsDir();
+    auto task = Executor::get().run<MultiAssetSizeTask>(
+        Executor::Priority::Visible,
+        [this, snapshot = std::move(snapshot), songIDs = std::move(songIDs),
+         sfxIDs = std::move(sfxIDs), resources = std::move(resources),
+         songDir = std::move(songDir)](
             auto progress, auto hasBeenCanceled) -> MultiAssetSizeTask::Result {
-            float sum = 0.f;
-            std::istringstream stream(songs);
-            std::string s;
-            while (std::getline(stream, s, ',')) {
-                int id = std::stoi(s);
-                auto result = this->getNongs(id);
-                if (!result.has_value()) {
+            // An asset counts with the size of the first of its candidate
+            // files that exists
+            using Asset = std::vector<std::filesystem::path>;
+            std::vector<Asset> assets;
+            for (int id : songIDs) {
+                const ActiveSongSnapshot* active = snapshot->find(id);
+                if (!active || !active->path.has_value()) {
                     continue;
                 }
-                auto nongs = result.value();
-                auto path = nongs->active()->path().value();
+                std::filesystem::path path = active->path.value();
                 if (path.string().starts_with("songs/")) {
                     path = resources / path;
                 }
-                if (std::filesystem::exists(path)) {
-                    sum += std::filesystem::file_size(path);
-                }
+                assets.push_back({std::move(path)});
             }
-            stream = std::istringstream(sfx);
-            while (std::getline(stream, s, ',')) {
-                std::stringstream ss;
-                ss << "s" << s << ".ogg";
-                std::string filename = ss.str();
-                auto localPath = resources / "sfx" / filename;
-                std::error_code _ec;
-                if (std::filesystem::exists(localPath, _ec)) {
-                    sum += std::filesystem::file_size(localPath);
-                    continue;
-                }
-                auto path = songDir / filename;
-                if (std::filesystem::exists(path, _ec)) {
-                    sum += std::filesystem::file_size(path);
+            for (int id : sfxIDs) {
+                const std::string filename = fmt::format("s{}.ogg", id);
+                assets.push_back(
+                    {resources / "sfx" / filename, songDir / filename});
+            }
+
+            std::uintmax_t sum = 0;
+            for (const Asset& asset : assets) {
+                for (const std::filesystem::path& path : asset) {
+                    if (auto size = this->assetSize(path)) {
+                        sum += size.value();
+                        break;
+                    }
                 }
             }
 
-            double toMegabytes = sum / 1024.f / 1024.f;
-            std::stringstream ss;
-            ss << std::setprecision(3) << toMegabytes << "MB";
-            return ss.str();
+            return formatSize(sum);
         },
         "Multiasset calculation");
+    m_assetSizeTasks.emplace(std::move(key), task);
+    return task;
+}
+
+void NongManager::markSnapshotDirty(int songID) {
+    // The first snapshot takes every loaded song anyway
+    if (m_snapshotRebuild) {
+        return;
+    }
+    m_snapshotDirty.insert(songID);
+    if (m_snapshotQueued) {
+        return;
+    }
+    m_snapshotQueued = true;
+    Loader::get()->queueInMainThread([this]() { this->publishSnapshot(); });
+}
+
+void NongManager::queueStateChanged(int songID) {
+    if (std::find(m_stateChanged.begin(), m_stateChanged.end(), songID) ==
+        m_stateChanged.end()) {
+        m_stateChanged.push_back(songID);
+    }
+    if (m_stateChangedQueued) {
+        return;
+    }
+    m_stateChangedQueued = true;
+    Loader::get()->queueInMainThread([this]() { this->flushStateChanged(); });
+}
+
+void NongManager::flushStateChanged() {
+    m_stateChangedQueued = false;
+    // Listeners can change active songs again, which queues another flush
+    std::vector<int> changed = std::exchange(m_stateChanged, {});
+    for (int songID : changed) {
+        // The song ID may have been dropped since
+        if (std::optional<Nongs*> nongs = this->getNongs(songID)) {
+            event::SongStateChanged(nongs.value()).post();
+        }
+    }
+}
+
+void NongManager::publishSnapshot() {
+    m_snapshotQueued = false;
+    if (!m_snapshotRebuild && m_snapshotDirty.empty()) {
+        return;
+    }
+    ProfileScope profile("NongManager::publishSnapshot");
+
+    // Only this thread replaces the snapshot, so it's read without the lock
+    auto next = std::make_shared<ManifestSnapshot>();
+    next->version = m_snapshot->version + 1;
+    auto capture = [&next](int songID, Nongs* nongs) {
+        Song* active = nongs->active();
+        const SongMetadata* metadata = active->metadata();
+        next->songs[songID] =
+            std::make_shared<const ActiveSongSnapshot>(ActiveSongSnapshot{
+                .uniqueID = metadata->uniqueID,
+                .path = active->path(),
+                .name = metadata->name,
+                .artist = metadata->artist,
+                .startOffset = metadata->startOffset});
+    };
+
+    if (m_snapshotRebuild) {
+        next->songs.reserve(m_manifest.m_nongs.size());
+        for (const auto& [songID, nongs] : m_manifest.m_nongs) {
+            capture(songID, nongs.get());
+        }
+    } else {
+        next->songs = m_snapshot->songs;
+        for (int songID : m_snapshotDirty) {
+            if (std::optional<Nongs*> nongs = this->getLoadedNongs(songID)) {
+                capture(songID, nongs.value());
+            } else {
+                next->songs.erase(songID);
+            }
+        }
+    }
+    m_snapshotRebuild = false;
+    m_snapshotDirty.clear();
+
+    std::lock_guard lock(m_snapshotMutex);
+    m_snapshot = std::move(next);
+}
+
+std::shared_ptr<const ManifestSnapshot> NongManager::manifestSnapshot() {
+    this->publishSnapshot();
+    return m_snapshot;
+}
+
+std::shared_ptr<const ManifestSnapshot> NongManager::publishedSnapshot() {
+    std::lock_guard lock(m_snapshotMutex);
+    return m_snapshot;
 }
 
 bool NongManager::init() {
     if (m_initialized) {
         return true;
     }
+    ProfileScope profile("NongManager::init");
 
     m_songErrorListener.bind([this](event::SongError* event) {
         log::error("{}", event->error());
@@ -198,8 +433,9 @@ bool NongManager::init() {
 
         defaultSongMetadata->name = event->songName();
         defaultSongMetadata->artist = event->artistName();
+        nongs.value()->refreshActiveSummary();
 
-        (void)this->saveNongs(event->gdSongID());
+        this->queueSave(event->gdSongID(), ManifestChange::DefaultInfo);
 
         return ListenerResult::Propagate;
     });
@@ -215,20 +451,145 @@ bool NongManager::init() {
     if (!std::filesystem::exists(nongsPath)) {
         std::filesystem::create_directory(nongsPath);
     }
+    FileStatusCache::get().watch(nongsPath);
+    FileStatusCache::get().watch(host::gdSongsDir());
+
+    const bool usePacked = Mod::get()->getSettingValue<bool>("packed-manifest");
+    // Lazy loading only applies when the store being read is also the one
+    // being written to. Imports and exports need every song in memory.
+    const bool lazy = Mod::get()->getSettingValue<bool>("lazy-manifest");
+    auto store = std::make_unique<PackedManifest>(this->packedManifestPath());
+    bool loadedPacked = false;
+
+    if (store->exists()) {
+        loadedPacked = lazy && usePacked ? this->indexPackedManifest(*store)
+                                         : this->loadPackedManifest(*store);
+    }
 
+    if (!loadedPacked) {
+        if (lazy && !usePacked) {
+            this->indexJsonManifest();
+        } else {
+            this->loadJsonManifest();
+        }
+    }
+
+    log::info("Read {} files successfuly!", m_manifest.m_nongs.size());
+    if (!m_unloadedNongs.empty()) {
+        log::info("{} more songs will be read on demand",
+                  m_unloadedNongs.size());
+    }
+
+    if (usePacked) {
+        if (!loadedPacked) {
+            // First run with the setting on, import the JSON directory
+            std::vector<Nongs*> all;
+            all.reserve(m_manifest.m_nongs.size());
+            for (const auto& [_, nongs] : m_manifest.m_nongs) {
+                all.push_back(nongs.get());
+            }
+            if (auto res = store->writeAll(all); res.isErr()) {
+                log::error("Failed to write packed manifest: {}",
+                           res.unwrapErr());
+            }
+        }
+        m_packedStore = std::move(store);
+    } else if (loadedPacked) {
+        // The setting was turned off, export back to the JSON directory
+        log::info("Exporting packed manifest to JSON");
+        (void)this->saveNongs();
+        this->flushNongs(true);
+        std::error_code ec;
+        std::filesystem::remove(store->path(), ec);
+    }
+
+    // Replayed after the stores are settled, so folding the journal writes
+    // to the store in use. It's folded even if the setting stays on, records
+    // appended after a crash would otherwise follow a torn one
+    auto journal = std::make_unique<ManifestJournal>(this->journalPath());
+    ManifestJournal recovery(this->recoveryPath());
+    if (journal->exists() || recovery.exists()) {
+        std::vector<int> ids;
+        if (journal->exists()) {
+            ids = this->replayJournal(*journal);
+        }
+        // Newer than everything in the journal, so it goes last
+        if (recovery.exists()) {
+            std::vector<int> recovered = this->replayJournal(recovery);
+            log::info("Recovered {} songs that weren't saved before exiting",
+                      recovered.size());
+            ids.insert(ids.end(), recovered.begin(), recovered.end());
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+        this->foldJournal(ids);
+        // Only cleared here, writeRecovery appends to it once the writer
+        // stopped, so a fold later on must not truncate it
+        if (recovery.exists()) {
+            m_recoveryClear.store(RecoveryClear::Pending,
+                                  std::memory_order_release);
+            this->postWrite({}, [this]() { this->clearRecovery(); });
+        }
+    }
+    if (Mod::get()->getSettingValue<bool>("journaled-manifest")) {
+        m_journal = std::move(journal);
+    }
+
+    Result<> res = this->migrateV2();
+    if (res.isErr()) {
+        log::error("{}", res.unwrapErr());
+    }
+
+    this->publishSnapshot();
+    m_initialized = true;
+    return true;
+}
+
+void NongManager::loadJsonManifest() {
+    ProfileScope profile("NongManager::loadJsonManifest");
+    auto path = this->baseManifestPath();
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::filesystem::path> files;
     for (const std::filesystem::directory_entry& entry :
          std::filesystem::directory_iterator(path)) {
         if (entry.path().extension() != ".json") {
             continue;
         }
+        files.push_back(entry.path());
+    }
+    // Directory order isn't stable, sort so the merge and logs are
+    std::sort(files.begin(), files.end());
+
+    struct LoadResult {
+        std::optional<Result<std::unique_ptr<Nongs>>> nongs;
+        std::vector<std::string> warnings;
+    };
+    std::vector<LoadResult> results(files.size());
+
+    auto listed = std::chrono::steady_clock::now();
+
+    parallel_for(files.size(), [this, &files, &results](size_t i) {
+        results[i].nongs =
+            this->loadNongsFromPath(files[i], &results[i].warnings);
+    });
+
+    auto parsed = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < files.size(); i++) {
+        LoadResult& result = results[i];
+        for (const std::string& warning : result.warnings) {
+            log::error("{}: {}", files[i].filename(), warning);
+        }
 
-        auto res = this->loadNongsFromPath(entry.path());
+        Result<std::unique_ptr<Nongs>>& res = result.nongs.value();
         if (res.isErr()) {
-            log::error("Failed to read file {}: {}", entry.path().filename(),
+            log::error("Failed to read file {}: {}", files[i].filename(),
                        res.unwrapErr());
+            std::error_code ec;
             std::filesystem::rename(
-                entry.path(),
-                path / fmt::format("{}.bak", entry.path().filename().string()));
+                files[i],
+                path / fmt::format("{}.bak", files[i].filename().string()), ec);
             continue;
         }
 
@@ -238,18 +599,124 @@ bool NongManager::init() {
         m_manifest.m_nongs.insert({id, std::move(ptr)});
     }
 
-    log::info("Read {} files successfuly!", m_manifest.m_nongs.size());
+    auto merged = std::chrono::steady_clock::now();
+
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    log::info(
+        "Loaded {} manifest files on {} threads: list {}ms, parse {}ms, "
+        "merge {}ms",
+        files.size(), parallel_worker_count(files.size()),
+        duration_cast<milliseconds>(listed - start).count(),
+        duration_cast<milliseconds>(parsed - listed).count(),
+        duration_cast<milliseconds>(merged - parsed).count());
+}
 
-    Result<> res = this->migrateV2();
+void NongManager::indexJsonManifest() {
+    auto path = this->baseManifestPath();
+
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(path)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+
+        std::string stem = entry.path().stem().string();
+        int id = 0;
+        auto [end, ec] =
+            std::from_chars(stem.data(), stem.data() + stem.size(), id);
+        if (ec != std::errc() || end != stem.data() + stem.size() || id == 0) {
+            log::error("Invalid manifest filename {}", entry.path().filename());
+            std::error_code renameEc;
+            std::filesystem::rename(
+                entry.path(),
+                path / fmt::format("{}.bak", entry.path().filename().string()),
+                renameEc);
+            continue;
+        }
+
+        m_unloadedNongs.insert(id);
+    }
+}
+
+bool NongManager::indexPackedManifest(PackedManifest& store) {
+    if (auto res = store.open(); res.isErr()) {
+        log::error("Failed to read packed manifest: {}", res.unwrapErr());
+        std::error_code ec;
+        std::filesystem::rename(
+            store.path(),
+            std::filesystem::path(store.path()).concat(".bak"), ec);
+        return false;
+    }
+
+    for (int id : store.ids()) {
+        m_unloadedNongs.insert(id);
+    }
+
+    return true;
+}
+
+bool NongManager::loadPackedManifest(PackedManifest& store) {
+    ProfileScope profile("NongManager::loadPackedManifest");
+    auto start = std::chrono::steady_clock::now();
+    auto res = store.readAll();
     if (res.isErr()) {
-        log::error("{}", res.unwrapErr());
+        log::error("Failed to read packed manifest: {}", res.unwrapErr());
+        std::error_code ec;
+        std::filesystem::rename(
+            store.path(),
+            std::filesystem::path(store.path()).concat(".bak"), ec);
+        return false;
     }
 
-    m_initialized = true;
+    for (std::unique_ptr<Nongs>& nongs : res.unwrap()) {
+        int id = nongs->songID();
+        m_manifest.m_nongs.insert({id, std::move(nongs)});
+    }
+
+    log::info("Loaded packed manifest in {}ms",
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count());
+
     return true;
 }
 
+namespace {
+
+// What makes two v2 songs the same song
+struct MigratedSongKey {
+    std::string name;
+    std::string artist;
+    int startOffset;
+    std::filesystem::path path;
+
+    bool operator==(const MigratedSongKey&) const = default;
+
+    static MigratedSongKey of(const LocalSong& song) {
+        return MigratedSongKey{song.metadata()->name, song.metadata()->artist,
+                               song.metadata()->startOffset,
+                               song.path().value_or(std::filesystem::path())};
+    }
+};
+
+struct MigratedSongKeyHash {
+    std::size_t operator()(const MigratedSongKey& key) const {
+        std::size_t hash = std::hash<std::string>{}(key.name);
+        auto mix = [&hash](std::size_t value) {
+            hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        };
+        mix(std::hash<std::string>{}(key.artist));
+        mix(std::hash<int>{}(key.startOffset));
+        mix(std::filesystem::hash_value(key.path));
+        return hash;
+    }
+};
+
+}  // namespace
+
 Result<> NongManager::migrateV2() {
+    ProfileScope profile("NongManager::migrateV2");
     bool migrate = compat::v2::manifestExists();
 
     if (!migrate) {
@@ -260,104 +727,549 @@ Result<> NongManager::migrateV2() {
     using CompatMap = std::unordered_map<int, compat::CompatManifest>;
     GEODE_UNWRAP_INTO(CompatMap manifest, compat::v2::parseManifest());
 
-    size_t i = 0;
-
-    for (const auto& kv : manifest) {
-        if (!m_manifest.m_nongs.contains(kv.first)) {
-            LocalSong defaultSong = kv.second.defaultSong;
-            int id = kv.first;
-            Nongs nongs = Nongs(kv.first, std::move(defaultSong));
-            m_manifest.m_nongs.insert(
-                {id, std::make_unique<Nongs>(std::move(nongs))});
-
-            Nongs* n = m_manifest.m_nongs[kv.first].get();
-            IndexManager::get().registerIndexNongs(n);
+    // Every migrated song ID is written in one flush at the end
+    this->holdSaves();
+
+    const std::size_t total = manifest.size();
+    const std::size_t progressStep = std::max<std::size_t>(total / 10, 1);
+    std::size_t migrated = 0;
+    std::size_t duplicates = 0;
+
+    // Unique ID of the song kept for each distinct song of the current ID
+    std::unordered_map<MigratedSongKey, UniqueID, MigratedSongKeyHash> kept;
+
+    for (auto& [id, entry] : manifest) {
+        const std::optional<std::filesystem::path> defaultPath =
+            entry.defaultSong.path();
+        std::optional<Nongs*> existing = this->getNongs(id);
+        // New song IDs are built in full before they join the manifest
+        std::unique_ptr<Nongs> created;
+        Nongs* nongs = nullptr;
+        if (existing.has_value()) {
+            nongs = existing.value();
+        } else {
+            created =
+                std::make_unique<Nongs>(id, std::move(entry.defaultSong));
+            nongs = created.get();
         }
 
-        Nongs* nongs = m_manifest.m_nongs[kv.first].get();
+        kept.clear();
+        kept.reserve(nongs->locals().size() + entry.songs.size());
+        for (const std::unique_ptr<LocalSong>& stored : nongs->locals()) {
+            kept.try_emplace(MigratedSongKey::of(*stored),
+                             stored->metadata()->uniqueID);
+        }
 
-        for (const LocalSong& i : kv.second.songs) {
-            if (i.path().value() == kv.second.defaultSong.path().value()) {
+        for (LocalSong& song : entry.songs) {
+            if (song.path() == defaultPath) {
                 continue;
             }
-            bool found = false;
-            for (std::unique_ptr<LocalSong>& stored : nongs->locals()) {
-                if (stored->metadata()->startOffset ==
-                        stored->metadata()->startOffset &&
-                    stored->metadata()->name == i.metadata()->name &&
-                    stored->metadata()->artist == i.metadata()->artist) {
-                    found = true;
-                }
-            }
 
-            if (found) {
+            MigratedSongKey key = MigratedSongKey::of(song);
+            if (kept.contains(key)) {
+                duplicates++;
                 continue;
             }
 
-            LocalSong cp = i;
-            auto res = nongs->add(std::move(cp));
+            const UniqueID uniqueID = song.metadata()->uniqueID;
+            auto res = nongs->add(std::move(song));
             if (res.isErr()) {
                 log::error("Failed to add migrated song to manifest: {}",
                            res.unwrapErr());
+                continue;
             }
+            kept.emplace(std::move(key), uniqueID);
+        }
+
+        // The active song may have been dropped as a duplicate of another
+        UniqueID active = entry.active.metadata()->uniqueID;
+        if (auto it = kept.find(MigratedSongKey::of(entry.active));
+            it != kept.end()) {
+            active = it->second;
         }
+        (void)nongs->setActive(active);
 
-        (void)nongs->setActive(kv.second.active.metadata()->uniqueID);
+        if (created) {
+            m_manifest.m_nongs.insert({id, std::move(created)});
+            IndexManager::get().registerIndexNongs(nongs);
+        }
         (void)nongs->commit();
-        i++;
+
+        if (++migrated % progressStep == 0 || migrated == total) {
+            log::info("Migrating from v2: {}/{} song IDs", migrated, total);
+        }
     }
 
-    log::info("Migrated {} ids from v2", i);
+    this->releaseSaves();
+
+    log::info("Migrated {} ids from v2, skipped {} duplicate songs", migrated,
+              duplicates);
     (void)compat::v2::backupManifest(true);
 
     return Ok();
 }
 
 Result<> NongManager::saveNongs(std::optional<int> saveID) {
-    auto path = this->baseManifestPath();
-
-    if (!std::filesystem::exists(path)) {
-        std::filesystem::create_directory(path);
+    if (saveID.has_value()) {
+        this->queueSave(saveID.value());
+        return Ok();
     }
 
     for (const auto& entry : m_manifest.m_nongs) {
-        auto id = entry.first;
+        this->queueSave(entry.first);
+    }
+
+    return Ok();
+}
+
+void NongManager::queueSave(int songID, ManifestChange change) {
+    if (m_journal) {
+        JournalChange& pending = m_journalChanges[songID];
+        switch (change) {
+            case ManifestChange::Full:
+                pending.full = true;
+                break;
+            case ManifestChange::ActiveSong:
+                pending.active = true;
+                break;
+            case ManifestChange::DefaultInfo:
+                pending.defaultInfo = true;
+                break;
+        }
+    }
+    this->scheduleFlush(songID);
+}
+
+void NongManager::queueRemoval(int songID, UniqueID uniqueID) {
+    if (m_journal) {
+        m_journalChanges[songID].removed.push_back(uniqueID);
+    }
+    this->scheduleFlush(songID);
+}
+
+void NongManager::scheduleFlush(int songID) {
+    ProfileScope profile("NongManager::queueSave");
+    m_dirtyNongs.insert(songID);
+    this->markSnapshotDirty(songID);
+
+    if (m_flushScheduled || m_saveHolds > 0) {
+        return;
+    }
+
+    m_flushScheduled = true;
+    CCDirector::sharedDirector()->getScheduler()->scheduleSelector(
+        schedule_selector(ManifestFlushTimer::onFlush),
+        ManifestFlushTimer::get(), 0.f, 0, s_flushDelay, false);
+}
+
+void NongManager::holdSaves() { m_saveHolds++; }
+
+void NongManager::releaseSaves() {
+    if (m_saveHolds == 0 || --m_saveHolds > 0) {
+        return;
+    }
+    this->flushNongs();
+}
+
+void NongManager::flushNongs(bool wait) {
+    if (m_flushScheduled) {
+        m_flushScheduled = false;
+        CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(
+            schedule_selector(ManifestFlushTimer::onFlush),
+            ManifestFlushTimer::get());
+    }
+
+    if (m_dirtyNongs.empty()) {
+        if (wait) {
+            m_writer.drain();
+        }
+        return;
+    }
+
+    ProfileScope profile("NongManager::flushNongs");
+    std::vector<int> ids(m_dirtyNongs.begin(), m_dirtyNongs.end());
+    m_dirtyNongs.clear();
+    std::sort(ids.begin(), ids.end());
+
+    if (m_journal) {
+        this->appendJournal(ids);
+    } else {
+        this->writeSnapshots(ids);
+    }
 
-        if (saveID.has_value() && saveID.value() != id) {
+    if (wait) {
+        m_writer.drain();
+    }
+}
+
+bool NongManager::flushNongsUntil(
+    std::chrono::steady_clock::time_point deadline) {
+    this->flushNongs();
+    return m_writer.drainUntil(deadline);
+}
+
+void NongManager::flushNongsForExit(
+    std::chrono::steady_clock::time_point deadline) {
+    if (this->flushNongsUntil(deadline)) {
+        return;
+    }
+
+    ProfileScope profile("NongManager::flushNongsForExit");
+    const std::size_t dropped = m_writer.discard();
+    // The old recovery journal has to be cleared before it's appended to.
+    // Only a writer that is clearing it right now is waited for, otherwise
+    // the clear happens here if it never started.
+    this->clearRecovery();
+    if (m_recoveryClear.load(std::memory_order_acquire) ==
+        RecoveryClear::Running) {
+        m_writer.drain();
+    }
+    // Read after discarding, the running job finishing after this only
+    // means a song is written twice
+    const std::uint64_t finished =
+        m_finishedWrites.load(std::memory_order_acquire);
+    std::unordered_set<int> unwritten;
+    for (const PostedWrite& write : m_unwritten) {
+        if (write.number > finished) {
+            unwritten.insert(write.ids.begin(), write.ids.end());
+        }
+    }
+    std::vector<int> ids(unwritten.begin(), unwritten.end());
+    std::sort(ids.begin(), ids.end());
+
+    log::warn("Exiting with {} manifest writes queued, saving {} songs to "
+              "the recovery journal instead",
+              dropped, ids.size());
+    this->writeRecovery(ids);
+}
+
+void NongManager::postWrite(std::vector<int> ids, std::function<void()> job) {
+    const std::uint64_t finished =
+        m_finishedWrites.load(std::memory_order_acquire);
+    while (!m_unwritten.empty() && m_unwritten.front().number <= finished) {
+        m_unwritten.pop_front();
+    }
+
+    const std::uint64_t number = ++m_postedWrites;
+    m_unwritten.push_back(PostedWrite{number, std::move(ids)});
+    m_writer.post([this, number, job = std::move(job)]() {
+        job();
+        m_finishedWrites.store(number, std::memory_order_release);
+    });
+}
+
+void NongManager::writeRecovery(const std::vector<int>& ids) {
+    using Op = ManifestJournal::Op;
+    using Record = ManifestJournal::Record;
+
+    std::vector<std::uint8_t> batch;
+    for (int id : ids) {
+        std::optional<Nongs*> opt = this->getLoadedNongs(id);
+        if (!opt.has_value()) {
+            // Dropped by the journal, unless it just hasn't been read yet
+            if (!m_unloadedNongs.contains(id)) {
+                ManifestJournal::encode(Record{.songID = id, .op = Op::Drop},
+                                        batch);
+            }
             continue;
         }
 
-        GEODE_UNWRAP(entry.second->commit());
+        if (PackedManifest::shouldStore(*opt.value())) {
+            ManifestJournal::encode(
+                Record{.songID = id,
+                       .op = Op::Replace,
+                       .nongs = PackedManifest::encode(*opt.value())},
+                batch);
+        } else {
+            ManifestJournal::encode(Record{.songID = id, .op = Op::Drop},
+                                    batch);
+        }
     }
 
-    return Ok();
+    if (batch.empty()) {
+        return;
+    }
+    ManifestJournal recovery(this->recoveryPath());
+    if (auto res = recovery.append(batch); res.isErr()) {
+        log::error("Failed to write the recovery journal: {}",
+                   res.unwrapErr());
+    }
+}
+
+void NongManager::clearRecovery() {
+    RecoveryClear expected = RecoveryClear::Pending;
+    if (!m_recoveryClear.compare_exchange_strong(expected,
+                                                 RecoveryClear::Running,
+                                                 std::memory_order_acq_rel)) {
+        return;
+    }
+    ManifestJournal recovery(this->recoveryPath());
+    if (auto res = recovery.clear(); res.isErr()) {
+        log::error("Failed to clear the recovery journal: {}",
+                   res.unwrapErr());
+    }
+    m_recoveryClear.store(RecoveryClear::None, std::memory_order_release);
+}
+
+void NongManager::writeSnapshots(const std::vector<int>& ids) {
+    struct PendingWrite {
+        int songID;
+        bool remove;
+        std::string json;
+        std::vector<std::uint8_t> record;
+    };
+
+    // Serializing has to happen here, the writer thread can't touch Nongs
+    std::vector<PendingWrite> writes;
+    writes.reserve(ids.size());
+    for (int id : ids) {
+        std::optional<Nongs*> opt = this->getLoadedNongs(id);
+        if (!opt.has_value()) {
+            // Dropped by the journal, unless it just hasn't been read yet
+            if (!m_unloadedNongs.contains(id)) {
+                writes.push_back(PendingWrite{.songID = id, .remove = true});
+            }
+            continue;
+        }
+        Nongs* nongs = opt.value();
+
+        PendingWrite write{.songID = id,
+                           .remove = !PackedManifest::shouldStore(*nongs)};
+        if (!write.remove) {
+            if (m_packedStore) {
+                write.record = PackedManifest::encode(*nongs);
+            } else {
+                write.json = matjson::Serialize<Nongs>::toJson(*nongs).dump(
+                    matjson::NO_INDENTATION);
+            }
+        }
+        writes.push_back(std::move(write));
+    }
+
+    this->postWrite(ids, [writes = std::move(writes),
+                          packed = m_packedStore.get(),
+                          base = this->baseManifestPath()]() mutable {
+        ProfileScope profile("NongManager::writeManifest");
+        for (PendingWrite& write : writes) {
+            Result<> res = [&]() -> Result<> {
+                if (packed) {
+                    return write.remove ? packed->remove(write.songID)
+                                        : packed->write(write.songID,
+                                                        std::move(write.record));
+                }
+
+                const std::filesystem::path path =
+                    base / fmt::format("{}.json", write.songID);
+                if (write.remove) {
+                    std::error_code ec;
+                    std::filesystem::remove(path, ec);
+                    return Ok();
+                }
+                return write_file_atomic(path, write.json);
+            }();
+
+            if (res.isErr()) {
+                log::error("Failed to save manifest for ID {}: {}",
+                           write.songID, res.unwrapErr());
+            }
+        }
+    });
+}
+
+void NongManager::appendJournal(const std::vector<int>& ids) {
+    using Op = ManifestJournal::Op;
+    using Record = ManifestJournal::Record;
+
+    std::vector<std::uint8_t> batch;
+    for (int id : ids) {
+        JournalChange change{.full = true};
+        if (auto it = m_journalChanges.find(id); it != m_journalChanges.end()) {
+            change = std::move(it->second);
+        }
+
+        std::optional<Nongs*> opt = this->getLoadedNongs(id);
+        if (!opt.has_value()) {
+            continue;
+        }
+        Nongs* nongs = opt.value();
+        m_journalIDs.insert(id);
+
+        if (change.full) {
+            if (PackedManifest::shouldStore(*nongs)) {
+                ManifestJournal::encode(
+                    Record{.songID = id,
+                           .op = Op::Replace,
+                           .nongs = PackedManifest::encode(*nongs)},
+                    batch);
+            } else {
+                ManifestJournal::encode(Record{.songID = id, .op = Op::Drop},
+                                        batch);
+            }
+            continue;
+        }
+
+        for (const UniqueID& removed : change.removed) {
+            ManifestJournal::encode(Record{.songID = id,
+                                           .op = Op::RemoveSong,
+                                           .uniqueID = removed.str()},
+                                    batch);
+        }
+        if (change.active) {
+            ManifestJournal::encode(
+                Record{.songID = id,
+                       .op = Op::SetActive,
+                       .uniqueID = nongs->active()->metadata()->uniqueID.str()},
+                batch);
+        }
+        if (change.defaultInfo) {
+            const SongMetadata* metadata = nongs->defaultSong()->metadata();
+            ManifestJournal::encode(Record{.songID = id,
+                                           .op = Op::SetDefaultInfo,
+                                           .name = metadata->name,
+                                           .artist = metadata->artist},
+                                    batch);
+        }
+    }
+    m_journalChanges.clear();
+
+    if (batch.empty()) {
+        return;
+    }
+    m_journalSize += batch.size();
+    this->postWrite(ids, [batch = std::move(batch),
+                          journal = m_journal.get()]() {
+        ProfileScope profile("NongManager::appendJournal");
+        if (auto res = journal->append(batch); res.isErr()) {
+            log::error("Failed to append to manifest journal: {}",
+                       res.unwrapErr());
+        }
+    });
+
+    if (m_journalSize >= ManifestJournal::s_compactThreshold) {
+        std::vector<int> folded(m_journalIDs.begin(), m_journalIDs.end());
+        std::sort(folded.begin(), folded.end());
+        this->foldJournal(folded);
+    }
+}
+
+void NongManager::foldJournal(const std::vector<int>& ids) {
+    ProfileScope profile("NongManager::foldJournal");
+    m_journalIDs.clear();
+    m_journalSize = 0;
+
+    // The writer runs jobs in order, the journal is only emptied once the
+    // songs in it are in the manifest
+    this->writeSnapshots(ids);
+    this->postWrite({}, [path = this->journalPath()]() {
+        ManifestJournal journal(path);
+        if (auto res = journal.clear(); res.isErr()) {
+            log::error("Failed to clear manifest journal: {}",
+                       res.unwrapErr());
+        }
+    });
+}
+
+std::vector<int> NongManager::replayJournal(ManifestJournal& journal) {
+    ProfileScope profile("NongManager::replayJournal");
+    auto res = journal.read();
+    if (res.isErr()) {
+        log::error("Failed to read manifest journal: {}", res.unwrapErr());
+        std::error_code ec;
+        std::filesystem::rename(
+            journal.path(),
+            std::filesystem::path(journal.path()).concat(".bak"), ec);
+        return {};
+    }
+
+    std::unordered_set<int> touched;
+    for (const ManifestJournal::Record& record : res.unwrap()) {
+        touched.insert(record.songID);
+        if (auto applied = this->applyJournalRecord(record);
+            applied.isErr()) {
+            log::warn("Skipping journal record for ID {}: {}", record.songID,
+                      applied.unwrapErr());
+        }
+    }
+    log::info("Replayed {} journal records over {} songs", res.unwrap().size(),
+              touched.size());
+
+    std::vector<int> ids(touched.begin(), touched.end());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+Result<> NongManager::applyJournalRecord(
+    const ManifestJournal::Record& record) {
+    using Op = ManifestJournal::Op;
+
+    switch (record.op) {
+        case Op::Replace: {
+            GEODE_UNWRAP_INTO(
+                std::unique_ptr<Nongs> nongs,
+                PackedManifest::decode(record.nongs, record.songID));
+            m_unloadedNongs.erase(record.songID);
+            m_manifest.m_nongs.insert_or_assign(record.songID,
+                                                std::move(nongs));
+            return Ok();
+        }
+        case Op::Drop:
+            m_unloadedNongs.erase(record.songID);
+            m_manifest.m_nongs.erase(record.songID);
+            return Ok();
+        default:
+            break;
+    }
+
+    std::optional<Nongs*> nongs = this->getNongs(record.songID);
+    if (!nongs.has_value()) {
+        return Err("Song not initialized in manifest");
+    }
+
+    // A song that was added is pooled already, an ID that isn't is of no
+    // song
+    const UniqueID uniqueID =
+        UniqueID::find(record.uniqueID).value_or(UniqueID());
+    switch (record.op) {
+        case Op::SetActive:
+            return nongs.value()->setActive(uniqueID);
+        case Op::RemoveSong:
+            // The audio went with the original delete
+            return nongs.value()->deleteSong(uniqueID, false);
+        case Op::SetDefaultInfo: {
+            SongMetadata* metadata = nongs.value()->defaultSong()->metadata();
+            metadata->name = record.name;
+            metadata->artist = record.artist;
+            nongs.value()->refreshActiveSummary();
+            return Ok();
+        }
+        default:
+            return Err("Unknown journal operation");
+    }
 }
 
 Result<std::unique_ptr<Nongs>> NongManager::loadNongsFromPath(
-    const std::filesystem::path& path) {
+    const std::filesystem::path& path, std::vector<std::string>* warnings) {
     auto stem = path.stem().string();
     // Watch someone edit a json name and have the game crash
-    int id = std::stoi(stem);
-    if (id == 0) {
+    int id = 0;
+    auto [end, ec] =
+        std::from_chars(stem.data(), stem.data() + stem.size(), id);
+    if (ec != std::errc() || end != stem.data() + stem.size() || id == 0) {
         return Err(
             fmt::format("Invalid filename {}", path.filename().string()));
     }
 
-    std::ifstream input(path);
+    std::ifstream input(path, std::ios::binary);
     if (!input.is_open()) {
         return Err(
             fmt::format("Couldn't open file: {}", path.filename().string()));
     }
-
-    GEODE_UNWRAP_INTO(matjson::Value json,
-                      matjson::parse(input).mapErr([id](std::string err) {
-                          return fmt::format(
-                              "Couldn't parse JSON from file: {}", err);
-                      }));
+    const std::string text((std::istreambuf_iterator<char>(input)),
+                           std::istreambuf_iterator<char>());
 
     GEODE_UNWRAP_INTO(Nongs nongs,
-                      matjson::Serialize<Nongs>::fromJson(json, id).mapErr(
-                          [id](std::string err) {
+                      parseNongs(text, id, warnings)
+                          .mapErr([](std::string err) {
                               return fmt::format("Failed to parse JSON: {}",
                                                  err);
                           }));
@@ -366,23 +1278,24 @@ Result<std::unique_ptr<Nongs>> NongManager::loadNongsFromPath(
 }
 
 void NongManager::refetchDefault(int songID) {
-    MusicDownloadManager::sharedState()->clearSong(songID);
-    MusicDownloadManager::sharedState()->getSongInfo(songID, true);
+    host::fetchSongInfo(songID, true);
 }
 
-Result<> NongManager::addNongs(Nongs&& nongs) {
+Result<std::vector<Song*>> NongManager::addNongs(Nongs&& nongs) {
     if (!m_manifest.m_nongs.contains(nongs.songID())) {
         return Err("Song not initialized in manifest");
     }
 
     auto& manifestNongs = m_manifest.m_nongs.at(nongs.songID());
-    if (auto err = manifestNongs->merge(std::move(nongs)); err.isErr()) {
-        return err;
+    GEODE_UNWRAP_INTO(std::vector<Song*> added,
+                      manifestNongs->merge(std::move(nongs)));
+    if (!added.empty()) {
+        (void)this->saveNongs(manifestNongs->songID());
     }
-    return saveNongs(manifestNongs->songID());
+    return Ok(std::move(added));
 }
 
-Result<> NongManager::setActiveSong(int gdSongID, std::string uniqueID) {
+Result<> NongManager::setActiveSong(int gdSongID, UniqueID uniqueID) {
     auto nongs = getNongs(gdSongID);
     if (!nongs.has_value()) {
         return Err("Song not initialized in manifest");
@@ -390,7 +1303,8 @@ Result<> NongManager::setActiveSong(int gdSongID, std::string uniqueID) {
     if (auto err = nongs.value()->setActive(uniqueID); err.isErr()) {
         return err;
     }
-    return saveNongs(gdSongID);
+    this->queueSave(gdSongID, ManifestChange::ActiveSong);
+    return Ok();
 }
 
 Result<> NongManager::deleteAllSongs(int gdSongID) {
@@ -405,7 +1319,7 @@ Result<> NongManager::deleteAllSongs(int gdSongID) {
     return saveNongs(gdSongID);
 }
 
-Result<> NongManager::deleteSongAudio(int gdSongID, std::string uniqueID) {
+Result<> NongManager::deleteSongAudio(int gdSongID, UniqueID uniqueID) {
     auto nongs = getNongs(gdSongID);
     if (!nongs.has_value()) {
         return Err("Song not initialized in manifest");
@@ -419,7 +1333,7 @@ Result<> NongManager::deleteSongAudio(int gdSongID, std::string uniqueID) {
     return saveNongs(gdSongID);
 }
 
-Result<> NongManager::deleteSong(int gdSongID, std::string uniqueID) {
+Result<> NongManager::deleteSong(int gdSongID, UniqueID uniqueID) {
     std::optional<Nongs*> nongs = this->getNongs(gdSongID);
     if (!nongs.has_value()) {
         return Err("Song not initialized in manifest");
@@ -430,13 +1344,35 @@ Result<> NongManager::deleteSong(int gdSongID, std::string uniqueID) {
             return fmt::format("Couldn't delete Nong: {}", err);
         }));
 
-    return nongs.value()->commit();
+    this->queueRemoval(gdSongID, uniqueID);
+    return Ok();
+}
+
+float NongManager::normalizationGain(const gd::string& filename) {
+    if (!Mod::get()->getSettingValue<bool>("loudness-normalization")) {
+        return 1.f;
+    }
+    // The game's strings are UTF-8, a plain char path is in the ANSI code
+    // page on Windows
+    const std::string_view name = filename.c_str();
+    std::optional<AnalysisManager::Analysis> analysis =
+        AnalysisManager::get().find(
+            std::filesystem::path(std::u8string(name.begin(), name.end())));
+    if (!analysis.has_value() || !analysis->loudness.has_value()) {
+        return 1.f;
+    }
+    const double target = static_cast<double>(
+        Mod::get()->getSettingValue<int64_t>("loudness-target"));
+    const double gain =
+        std::pow(10.0, (target - analysis->loudness.value()) / 20.0);
+    // Quiet songs aren't boosted into clipping, rough masters aren't muted
+    return static_cast<float>(std::clamp(gain, 0.25, 2.0));
 }
 
 std::filesystem::path NongManager::generateSongFilePath(
     const std::string& extension, std::optional<std::string> filename) {
     auto unique = filename.value_or(jukebox::random_string(16));
-    auto destination = Mod::get()->getSaveDir() / "nongs";
+    auto destination = host::saveDir() / "nongs";
     if (!std::filesystem::exists(destination)) {
         std::filesystem::create_directory(destination);
     }
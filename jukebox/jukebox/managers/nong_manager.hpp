@@ -1,25 +1,139 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <Geode/Result.hpp>
-#include <Geode/binding/SongInfoObject.hpp>
+#include <Geode/c++stl/string.hpp>
 #include <Geode/loader/Event.hpp>
 #include <Geode/loader/Mod.hpp>
 #include <Geode/utils/Task.hpp>
 
 #include <jukebox/events/get_song_info.hpp>
 #include <jukebox/events/song_error.hpp>
+#include <jukebox/host/host.hpp>
+#include <jukebox/nong/manifest_journal.hpp>
+#include <jukebox/nong/manifest_snapshot.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/nong/packed_manifest.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/serial_queue.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
+/**
+ * The last NONG path handed to GD, with what the FMOD hooks need about it.
+ * Captured once when the path is resolved.
+ */
+struct PreparedTrack {
+    int songID = 0;
+    gd::string filename;
+    int startOffset = 0;
+    // Volume that brings the track to the loudness target, 1 when loudness
+    // normalization is off or the track wasn't analyzed
+    float gain = 1.f;
+};
+
+/**
+ * What a queued save changed, so the journal can record just that
+ */
+enum class ManifestChange {
+    // Anything else, the whole entry is written
+    Full,
+    ActiveSong,
+    // The name or artist of the default song
+    DefaultInfo,
+};
+
 class NongManager {
 protected:
+    std::optional<PreparedTrack> m_preparedTrack;
+    // Whether the music FMOD last started is the prepared track
+    bool m_preparedTrackPlaying = false;
     Manifest m_manifest;
     bool m_initialized = false;
+    std::unique_ptr<PackedManifest> m_packedStore;
+    // Set with the journaled manifest setting. Flushes append their changes
+    // here, the manifest itself is only written when the journal is folded.
+    std::unique_ptr<ManifestJournal> m_journal;
+
+    // Changes to a dirty song since its last flush, only kept with the
+    // journal
+    struct JournalChange {
+        bool full = false;
+        bool active = false;
+        bool defaultInfo = false;
+        std::vector<UniqueID> removed;
+    };
+
+    std::unordered_map<int, JournalChange> m_journalChanges;
+    // Songs with records in the journal, and the bytes appended to it, since
+    // it was last folded into the manifest
+    std::unordered_set<int> m_journalIDs;
+    std::uint64_t m_journalSize = 0;
+    // Song IDs known to be in the manifest that haven't been read yet. Only
+    // used with the lazy manifest setting.
+    std::unordered_set<int> m_unloadedNongs;
+    // Song IDs with changes that haven't been written to disk yet
+    std::unordered_set<int> m_dirtyNongs;
+    bool m_flushScheduled = false;
+    // While above 0, queued saves wait for releaseSaves instead of a timer
+    std::size_t m_saveHolds = 0;
+    // Seconds to wait for more changes before flushing
+    constexpr static inline float s_flushDelay = 0.5f;
+
+    // Song IDs of the writer jobs that may not have finished, by the number
+    // they were posted with. Main thread only, so they can go to the
+    // recovery journal on exit.
+    struct PostedWrite {
+        std::uint64_t number;
+        std::vector<int> ids;
+    };
+
+    std::deque<PostedWrite> m_unwritten;
+    std::uint64_t m_postedWrites = 0;
+    // Set by the writer thread, declared before it so it outlives the thread
+    std::atomic<std::uint64_t> m_finishedWrites = 0;
+    // Clearing the recovery journal left over from the last exit. Whoever
+    // moves it off Pending first, the writer or the exit, clears it.
+    enum class RecoveryClear : std::uint8_t { None, Pending, Running };
+    std::atomic<RecoveryClear> m_recoveryClear = RecoveryClear::None;
+    SerialQueue m_writer;
+
+    // Size tasks still running, keyed by their IDs and snapshot version
+    std::unordered_map<std::string, geode::Task<std::string>> m_assetSizeTasks;
+
+    // Published for background jobs. Only the main thread replaces it, other
+    // threads copy the pointer under the mutex
+    std::mutex m_snapshotMutex;
+    std::shared_ptr<const ManifestSnapshot> m_snapshot =
+        std::make_shared<const ManifestSnapshot>();
+    // Song IDs changed since the last snapshot, main thread only
+    std::unordered_set<int> m_snapshotDirty;
+    // Set until the first snapshot after loading the manifest, which takes
+    // every loaded song
+    bool m_snapshotRebuild = true;
+    bool m_snapshotQueued = false;
+
+    // Song IDs whose active song changed this frame, in the order they did
+    std::vector<int> m_stateChanged;
+    bool m_stateChangedQueued = false;
+
+    void publishSnapshot();
+    void flushStateChanged();
 
     NongManager() = default;
     NongManager(const NongManager&) = delete;
@@ -40,34 +154,214 @@ protected:
         m_songErrorListener;
     geode::EventListener<geode::EventFilter<jukebox::event::GetSongInfo>>
         m_songInfoListener;
+    /**
+     * Reads a single manifest file. Safe to call from worker threads.
+     *
+     * @param path the manifest file
+     * @param warnings optional sink for errors of skipped entries
+     */
     geode::Result<std::unique_ptr<Nongs>> loadNongsFromPath(
-        const std::filesystem::path& path);
-
+        const std::filesystem::path& path,
+        std::vector<std::string>* warnings = nullptr);
+    /**
+     * Applies the journal to the loaded manifest
+     *
+     * @return the IDs of the songs it touched
+     */
+    std::vector<int> replayJournal(ManifestJournal& journal);
+    geode::Result<> applyJournalRecord(const ManifestJournal::Record& record);
+    /**
+     * Writes the given songs to the manifest, then empties the journal
+     */
+    void foldJournal(const std::vector<int>& ids);
+    void appendJournal(const std::vector<int>& ids);
+    /**
+     * Serializes the given songs and has the writer thread store them in the
+     * manifest
+     */
+    void writeSnapshots(const std::vector<int>& ids);
+    /**
+     * Posts a job to the writer, remembering which songs it writes until it
+     * finished
+     */
+    void postWrite(std::vector<int> ids, std::function<void()> job);
+    /**
+     * Appends a full record of each song to the recovery journal, on the
+     * calling thread
+     */
+    void writeRecovery(const std::vector<int>& ids);
+    /**
+     * Clears the recovery journal, unless the writer or the exit claimed
+     * the job already. Any thread
+     */
+    void clearRecovery();
+    void scheduleFlush(int songID);
+    void loadJsonManifest();
+    bool loadPackedManifest(PackedManifest& store);
+    void indexJsonManifest();
+    bool indexPackedManifest(PackedManifest& store);
+    std::optional<Nongs*> hydrateNongs(int songID);
     geode::Result<> migrateV2();
 
+    /**
+     * Gain for a song file from its cached analysis, worked out once when
+     * a new track is prepared so starting it is only a lookup
+     */
+    float normalizationGain(const gd::string& filename);
+
 public:
     using MultiAssetSizeTask = geode::Task<std::string>;
-    std::optional<Nongs*> m_currentlyPreparingNong;
 
     bool init();
 
     bool initialized() const { return m_initialized; }
 
+    /**
+     * Records the path GD got for a song, so its start offset can be applied
+     * when FMOD plays that file
+     */
+    void prepareTrack(int songID, const gd::string& filename, int startOffset) {
+        if (m_preparedTrack && m_preparedTrack->filename == filename) {
+            m_preparedTrack->songID = songID;
+            m_preparedTrack->startOffset = startOffset;
+            return;
+        }
+        m_preparedTrack = PreparedTrack{songID, filename, startOffset,
+                                        this->normalizationGain(filename)};
+        m_preparedTrackPlaying = false;
+    }
+
+    /**
+     * Drops the prepared track if it belongs to the song, for when GD gets
+     * its own path for it instead
+     */
+    void forgetPreparedTrack(int songID) {
+        if (m_preparedTrack && m_preparedTrack->songID == songID) {
+            m_preparedTrack = std::nullopt;
+            m_preparedTrackPlaying = false;
+        }
+    }
+
+    /**
+     * Offset to add when FMOD starts playing the given music file. Anything
+     * other than the prepared track, like menu music, gets 0.
+     */
+    int startMusicOffset(const gd::string& filename) {
+        m_preparedTrackPlaying =
+            m_preparedTrack && m_preparedTrack->filename == filename;
+        return m_preparedTrackPlaying ? m_preparedTrack->startOffset : 0;
+    }
+
+    /**
+     * The prepared track, if FMOD last started playing it
+     */
+    const PreparedTrack* playingTrack() const {
+        return m_preparedTrackPlaying ? &m_preparedTrack.value() : nullptr;
+    }
+
+    /**
+     * Offset to add when seeking the music FMOD last started
+     */
+    int seekOffset() const {
+        return m_preparedTrackPlaying ? m_preparedTrack->startOffset : 0;
+    }
+
     std::filesystem::path baseManifestPath() {
+        static std::filesystem::path path = host::saveDir() / "manifest";
+        return path;
+    }
+
+    std::filesystem::path packedManifestPath() {
+        static std::filesystem::path path = host::saveDir() / "manifest.pack";
+        return path;
+    }
+
+    std::filesystem::path journalPath() {
         static std::filesystem::path path =
-            geode::Mod::get()->getSaveDir() / "manifest";
+            host::saveDir() / "manifest.journal";
         return path;
     }
 
-    std::filesystem::path baseNongsPath() {
+    /**
+     * Written on exit with the songs the writer didn't get to, and replayed
+     * over the manifest and journal on the next start
+     */
+    std::filesystem::path recoveryPath() {
         static std::filesystem::path path =
-            geode::Mod::get()->getSaveDir() / "nongs";
+            host::saveDir() / "manifest.recovery";
+        return path;
+    }
+
+    /**
+     * The packed manifest store, if the packed manifest setting is enabled.
+     * Commits go here instead of the JSON directory while it is set.
+     */
+    PackedManifest* packedStore() { return m_packedStore.get(); }
+
+    /**
+     * Marks the NONGs of a song as changed. Changes are written to disk
+     * shortly after, batched with other pending changes.
+     *
+     * @param songID the id of the song
+     * @param change what changed. Only the journal looks at it
+     */
+    void queueSave(int songID, ManifestChange change = ManifestChange::Full);
+
+    /**
+     * Marks a song of a GD song ID as deleted, like queueSave
+     *
+     * @param songID the id of the GD song
+     * @param uniqueID the unique ID of the deleted song
+     */
+    void queueRemoval(int songID, UniqueID uniqueID);
+
+    /**
+     * Defers the saves queued from now on until the matching releaseSaves,
+     * so a batch of changes is written in one flush. Holds nest.
+     */
+    void holdSaves();
+    /**
+     * Ends a holdSaves. Flushes everything queued once the last hold ends.
+     */
+    void releaseSaves();
+
+    /**
+     * Serializes every pending change and hands it to the writer thread
+     *
+     * @param wait block until everything is on disk
+     */
+    void flushNongs(bool wait = false);
+
+    /**
+     * Like flushNongs(true), but stops waiting at the deadline. Writes still
+     * queued then keep going in the background.
+     *
+     * @return whether everything is on disk
+     */
+    bool flushNongsUntil(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * Flushes before the game exits. Whatever the writer hasn't finished by
+     * the deadline is dropped from its queue and written to the recovery
+     * journal instead, which takes a single append.
+     */
+    void flushNongsForExit(std::chrono::steady_clock::time_point deadline);
+
+    std::filesystem::path baseNongsPath() {
+        static std::filesystem::path path = host::saveDir() / "nongs";
         return path;
     }
 
     bool hasSongID(int id);
 
-    geode::Result<Nongs*> initSongID(SongInfoObject* obj, int id, bool robtop);
+    /**
+     * Creates the NONGs of a song, with its default song from the song info
+     *
+     * @param info song info of the default song. Looked up in GD's savefile
+     * if not given, and fetched from GD's servers if it isn't there either
+     */
+    geode::Result<Nongs*> initSongID(std::optional<host::SongInfo> info,
+                                     int id, bool robtop);
 
     /**
      * Adjusts a song ID with respect to Robtop songs
@@ -97,25 +391,78 @@ public:
      */
     std::optional<Nongs*> getNongs(int songID);
 
+    /**
+     * Same as getNongs, but never reads a song that hasn't been loaded yet
+     * in lazy mode. Meant for bulk passes over many IDs, like index
+     * registration.
+     *
+     * @param songID the id of the song
+     */
+    std::optional<Nongs*> getLoadedNongs(int songID);
+
+    /**
+     * Size of a file, from the file status cache. Safe to call from worker
+     * threads.
+     *
+     * @return the size, or std::nullopt if the file doesn't exist
+     */
+    std::optional<std::uintmax_t> assetSize(const std::filesystem::path& path);
+
     /**
      * Formats a size in bytes to a x.xxMB string
+     */
+    static std::string formatSize(std::uintmax_t bytes);
+
+    /**
+     * Formats the size of a file to a x.xxMB string, through the size cache
      *
      * @param path the path to calculate the filesize of
      *
-     * @return the formatted size, with the format x.xxMB
+     * @return the formatted size, with the format x.xxMB, or N/A
      */
     std::string getFormattedSize(const std::filesystem::path& path);
 
     /**
      * Calculates the total size of multiple assets, then writes it to a string.
-     * Runs on a separate thread. Returns a task that will resolve to the total
-     * size.
+     * Runs on a separate thread, reading the active songs from a manifest
+     * snapshot. Returns a task that will resolve to the total size. Calls for
+     * the same IDs share the task that is already running while the manifest
+     * stays the same, and only files that changed since the last call are
+     * measured again.
      *
      * @param songs string of song ids, separated by commas
      * @param sfx string of sfx ids, separated by commas
      */
     MultiAssetSizeTask getMultiAssetSizes(std::string songs, std::string sfx);
 
+    /**
+     * Estimated memory of the loaded manifest, for the profiler popup
+     */
+    std::vector<MemoryUsage> memoryUsage() const;
+
+    /**
+     * Marks the active song of a song ID as changed. The snapshot published
+     * next, on the next frame at the latest, has it as it is by then.
+     */
+    void markSnapshotDirty(int songID);
+
+    /**
+     * Posts SongStateChanged for a song ID on the next frame. Changes within
+     * the same frame are delivered once, with the NONGs as they are by then.
+     */
+    void queueStateChanged(int songID);
+
+    /**
+     * The manifest as it is now, for handing to a background job. Main
+     * thread only, publishes the pending changes first.
+     */
+    std::shared_ptr<const ManifestSnapshot> manifestSnapshot();
+
+    /**
+     * The snapshot published last. Safe to call from any thread.
+     */
+    std::shared_ptr<const ManifestSnapshot> publishedSnapshot();
+
     /**
      * Add actions needed to fix a broken song default
      * @param songID id of the song
@@ -123,31 +470,32 @@ public:
     void refetchDefault(int songID);
 
     /**
-     * Add NONGs
+     * Add NONGs, songs already in the manifest are skipped
      * @param nong NONG to add
+     * @returns the songs that were added
      */
-    geode::Result<> addNongs(Nongs&& nong);
+    geode::Result<std::vector<Song*>> addNongs(Nongs&& nong);
 
     /**
      * Set active song
      * @param gdSongID the id of the song in GD
      * @param uniqueID the unique id of the song in Jukebox
      */
-    geode::Result<> setActiveSong(int gdSongID, std::string uniqueID);
+    geode::Result<> setActiveSong(int gdSongID, UniqueID uniqueID);
 
     /**
      * Delete a song
      * @param gdSongID the id of the song in GD
      * @param uniqueID the unique id of the song in Jukebox
      */
-    geode::Result<> deleteSong(int gdSongID, std::string uniqueID);
+    geode::Result<> deleteSong(int gdSongID, UniqueID uniqueID);
 
     /**
      * Delete a song's audio file
      * @param gdSongID the id of the song in GD
      * @param uniqueID the unique id of the song in Jukebox
      */
-    geode::Result<> deleteSongAudio(int gdSongID, std::string uniqueID);
+    geode::Result<> deleteSongAudio(int gdSongID, UniqueID uniqueID);
 
     /**
      * Delete all NONGs for a song ID
@@ -0,0 +1,108 @@
+#include <jukebox/managers/prefetch_manager.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <utility>
+
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+
+#include <jukebox/utils/mapped_file.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+std::size_t PrefetchManager::budget() {
+    const int64_t megabytes = std::max<int64_t>(
+        1, Mod::get()->getSettingValue<int64_t>("prefetch-budget"));
+    return static_cast<std::size_t>(megabytes) * 1024 * 1024;
+}
+
+void PrefetchManager::prefetch(int songID, const std::filesystem::path& path) {
+    if (!Mod::get()->getSettingValue<bool>("prefetch-nongs")) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        auto it = std::find_if(
+            m_warm.begin(), m_warm.end(),
+            [&path](const WarmFile& file) { return file.path == path; });
+        if (it != m_warm.end()) {
+            it->songID = songID;
+            m_warm.splice(m_warm.begin(), m_warm, it);
+            return;
+        }
+    }
+
+    // The setting is read here, settings aren't safe to read off the main
+    // thread
+    m_worker.post([this, songID, path, budget = budget()]() {
+        this->warm(songID, path, budget);
+    });
+}
+
+void PrefetchManager::warm(int songID, const std::filesystem::path& path,
+                           std::size_t budget) {
+    {
+        std::lock_guard lock(m_mutex);
+        if (std::any_of(
+                m_warm.begin(), m_warm.end(),
+                [&path](const WarmFile& file) { return file.path == path; })) {
+            return;
+        }
+    }
+
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec || size == 0 || size > budget) {
+        return;
+    }
+
+    Result<MappedFile> res = MappedFile::open(path);
+    if (res.isErr()) {
+        log::debug("Couldn't prefetch {}: {}", path, res.unwrapErr());
+        return;
+    }
+    MappedFile file = std::move(res.unwrap());
+
+    // Reading a byte of every page pulls the whole file into the page cache
+    std::uint8_t sink = 0;
+    for (std::size_t i = 0; i < file.size(); i += s_pageSize) {
+        sink ^= static_cast<const volatile std::uint8_t*>(file.data())[i];
+    }
+    (void)sink;
+
+    std::lock_guard lock(m_mutex);
+    m_warmBytes += file.size();
+    m_warm.push_front(WarmFile{songID, path, std::move(file)});
+    this->evict(budget);
+}
+
+void PrefetchManager::evict(std::size_t budget) {
+    while (!m_warm.empty() &&
+           (m_warm.size() > s_maxWarmFiles || m_warmBytes > budget)) {
+        m_warmBytes -= m_warm.back().file.size();
+        m_warm.pop_back();
+    }
+}
+
+void PrefetchManager::handOff(int songID) {
+    std::lock_guard lock(m_mutex);
+    for (auto it = m_warm.begin(); it != m_warm.end();) {
+        if (it->songID != songID) {
+            it++;
+            continue;
+        }
+        m_warmBytes -= it->file.size();
+        it = m_warm.erase(it);
+    }
+}
+
+}  // namespace jukebox
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <mutex>
+
+#include <jukebox/utils/mapped_file.hpp>
+#include <jukebox/utils/serial_queue.hpp>
+
+namespace jukebox {
+
+/**
+ * Warms the files of NONGs that are likely to play soon, so FMOD doesn't
+ * open a large FLAC or WAV cold when the level starts. Files are mapped and
+ * read on a background thread, and only the most recent ones stay mapped,
+ * within the memory budget set in the mod settings.
+ */
+class PrefetchManager {
+protected:
+    struct WarmFile {
+        int songID;
+        std::filesystem::path path;
+        MappedFile file;
+    };
+
+    // Bytes touched per step, one per page is enough to fault it in
+    constexpr static inline std::size_t s_pageSize = 4096;
+    constexpr static inline std::size_t s_maxWarmFiles = 4;
+
+    std::mutex m_mutex;
+    // Most recently warmed first
+    std::list<WarmFile> m_warm;
+    std::size_t m_warmBytes = 0;
+    // Declared last, so the thread is joined before the files are unmapped
+    SerialQueue m_worker;
+
+    PrefetchManager() = default;
+
+    PrefetchManager(const PrefetchManager&) = delete;
+    PrefetchManager(PrefetchManager&&) = delete;
+
+    PrefetchManager& operator=(const PrefetchManager&) = delete;
+    PrefetchManager& operator=(PrefetchManager&&) = delete;
+
+    static std::size_t budget();
+    void warm(int songID, const std::filesystem::path& path,
+              std::size_t budget);
+    // Needs m_mutex held
+    void evict(std::size_t budget);
+
+public:
+    /**
+     * Starts warming a song file in the background, if prefetching is
+     * enabled. Does nothing if the file is already warm or over the budget.
+     *
+     * @param songID the GD song ID the file belongs to
+     * @param path the file to warm
+     */
+    void prefetch(int songID, const std::filesystem::path& path);
+
+    /**
+     * Unmaps the files of a song once FMOD has opened it itself
+     *
+     * @param songID the GD song ID
+     */
+    void handOff(int songID);
+
+    static PrefetchManager& get() {
+        static PrefetchManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
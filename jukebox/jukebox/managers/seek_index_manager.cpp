@@ -0,0 +1,252 @@
+#include <jukebox/managers/seek_index_manager.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/utils/file.hpp>
+
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/binary_stream.hpp>
+#include <jukebox/utils/mapped_file.hpp>
+#include <jukebox/utils/mp3_frames.hpp>
+
+using namespace geode::prelude;
+
+namespace {
+
+// Followed by the size of every frame but the last as a uint16_t, frames
+// are never bigger than 2881 bytes
+struct Header {
+    std::uint32_t magic;
+    std::uint16_t version;
+    // Songs that don't need a table only get a header, so they aren't
+    // scanned again
+    std::uint8_t indexed;
+    std::uint8_t reserved;
+    // What the song file looked like when it was scanned
+    std::uint64_t size;
+    std::int64_t modified;
+    std::uint32_t sampleRate;
+    std::uint32_t samplesPerFrame;
+    std::uint64_t firstFrame;
+    std::uint64_t audioEnd;
+    std::uint32_t frameCount;
+    std::uint32_t padding;
+};
+
+struct FileStamp {
+    std::uint64_t size;
+    std::int64_t modified;
+};
+
+std::optional<FileStamp> statFile(const std::filesystem::path& path) {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return FileStamp{
+        .size = size,
+        .modified = static_cast<std::int64_t>(
+            modified.time_since_epoch().count())};
+}
+
+}  // namespace
+
+namespace jukebox {
+
+std::filesystem::path SeekIndexManager::seekPath() {
+    return NongManager::get().baseNongsPath() / "seek";
+}
+
+std::filesystem::path SeekIndexManager::sidecarPath(
+    const std::filesystem::path& song) {
+    std::filesystem::path path = this->seekPath() / song.filename();
+    path += ".seek";
+    return path;
+}
+
+std::optional<SeekIndexManager::SeekIndex> SeekIndexManager::loadIndex(
+    const std::filesystem::path& song) {
+    const std::optional<FileStamp> stamp = statFile(song);
+    if (!stamp) {
+        return std::nullopt;
+    }
+
+    const std::filesystem::path sidecar = this->sidecarPath(song);
+    if (Result<ByteVector> bytes = file::readBinary(sidecar); bytes.isOk()) {
+        BinaryReader reader(bytes.unwrap());
+        Result<Header> read = reader.read<Header>();
+        if (read.isOk() && read.unwrap().magic == s_magic &&
+            read.unwrap().version == s_version &&
+            read.unwrap().size == stamp->size &&
+            read.unwrap().modified == stamp->modified) {
+            const Header& header = read.unwrap();
+            if (!header.indexed) {
+                return std::nullopt;
+            }
+
+            SeekIndex index{.sampleRate = header.sampleRate,
+                            .samplesPerFrame = header.samplesPerFrame,
+                            .audioEnd = header.audioEnd};
+            if (header.frameCount > 0 &&
+                reader.remaining() ==
+                    (header.frameCount - 1) * sizeof(std::uint16_t)) {
+                index.frames.reserve(header.frameCount);
+                std::uint64_t offset = header.firstFrame;
+                index.frames.push_back(offset);
+                for (std::uint32_t i = 1; i < header.frameCount; i++) {
+                    offset += reader.read<std::uint16_t>().unwrap();
+                    index.frames.push_back(offset);
+                }
+                return index;
+            }
+        }
+        // Stale or broken, scanned again below
+    }
+
+    Result<MappedFile> mapped = MappedFile::open(song);
+    if (mapped.isErr()) {
+        return std::nullopt;
+    }
+    std::optional<Mp3Stream> stream = scanMp3(mapped.unwrap().bytes());
+    const bool indexed =
+        stream && !stream->constantBitrate && !stream->hasSeekHeader;
+
+    Header header{.magic = s_magic,
+                  .version = s_version,
+                  .indexed = indexed,
+                  .reserved = 0,
+                  .size = stamp->size,
+                  .modified = stamp->modified,
+                  .sampleRate = 0,
+                  .samplesPerFrame = 0,
+                  .firstFrame = 0,
+                  .audioEnd = 0,
+                  .frameCount = 0,
+                  .padding = 0};
+    std::optional<SeekIndex> index;
+    if (indexed) {
+        header.sampleRate = stream->sampleRate;
+        header.samplesPerFrame = stream->samplesPerFrame;
+        header.firstFrame = stream->frames.front();
+        header.audioEnd = stream->audioEnd;
+        header.frameCount = static_cast<std::uint32_t>(stream->frames.size());
+        index = SeekIndex{.sampleRate = stream->sampleRate,
+                          .samplesPerFrame = stream->samplesPerFrame,
+                          .frames = std::move(stream->frames),
+                          .audioEnd = stream->audioEnd};
+    }
+
+    BinaryWriter writer;
+    writer.write(header);
+    if (index) {
+        for (std::size_t i = 1; i < index->frames.size(); i++) {
+            writer.write(static_cast<std::uint16_t>(index->frames[i] -
+                                                    index->frames[i - 1]));
+        }
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(this->seekPath(), ec);
+    if (Result<> r = write_file_atomic(sidecar, writer.buffer()); r.isErr()) {
+        log::warn("Couldn't store the seek table of {}: {}",
+                  song.filename().string(), r.unwrapErr());
+    }
+
+    return index;
+}
+
+void SeekIndexManager::load(const std::filesystem::path& song) {
+    if (song == m_requested) {
+        return;
+    }
+    m_requested = song;
+    m_index = std::nullopt;
+    // Only MP3 streams are seeked by estimate
+    if (song.extension() != ".mp3") {
+        return;
+    }
+
+    m_worker.post([this, song]() {
+        std::optional<SeekIndex> index = this->loadIndex(song);
+        if (!index) {
+            return;
+        }
+        Executor::get().postMain(
+            [this, song, index = std::move(index)]() mutable {
+                // Another song may have started in the meantime
+                if (song == m_requested) {
+                    m_index = std::move(index);
+                }
+            });
+    });
+}
+
+void SeekIndexManager::unload() {
+    m_requested.clear();
+    m_index = std::nullopt;
+}
+
+std::optional<unsigned int> SeekIndexManager::fmodSeekTime(
+    unsigned int ms, unsigned int lengthMs) const {
+    if (!m_index || m_index->frames.empty() || lengthMs == 0 ||
+        m_index->sampleRate == 0) {
+        return std::nullopt;
+    }
+
+    const std::vector<std::uint64_t>& frames = m_index->frames;
+    const double frameMs =
+        1000.0 * m_index->samplesPerFrame / m_index->sampleRate;
+    const double position = ms / frameMs;
+    const std::size_t frame = static_cast<std::size_t>(position);
+    if (frame >= frames.size()) {
+        return lengthMs;
+    }
+
+    // FMOD maps a time to a byte linearly over the audio, so ask for the
+    // time its estimate puts at the byte where the frame starts
+    const std::uint64_t start = frames[frame];
+    const std::uint64_t end =
+        frame + 1 < frames.size() ? frames[frame + 1] : m_index->audioEnd;
+    const double byte =
+        start + (position - frame) * (end - start) - frames.front();
+    const double audioBytes =
+        static_cast<double>(m_index->audioEnd - frames.front());
+    return static_cast<unsigned int>(
+        std::lround(byte / audioBytes * lengthMs));
+}
+
+void SeekIndexManager::prune() {
+    m_worker.post([this]() {
+        const std::filesystem::path songs = NongManager::get().baseNongsPath();
+        std::error_code ec;
+        for (const std::filesystem::directory_entry& entry :
+             std::filesystem::directory_iterator(this->seekPath(), ec)) {
+            if (entry.path().extension() != ".seek") {
+                continue;
+            }
+            std::error_code existsEc;
+            if (!std::filesystem::exists(songs / entry.path().stem(),
+                                         existsEc) &&
+                !existsEc) {
+                std::error_code removeEc;
+                std::filesystem::remove(entry.path(), removeEc);
+            }
+        }
+    });
+}
+
+}  // namespace jukebox
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <jukebox/utils/executor.hpp>
+
+namespace jukebox {
+
+/**
+ * Frame offset tables of VBR MP3 NONGs that have no Xing, Info or VBRI
+ * header. FMOD seeks those as if they were constant bitrate, which lands
+ * seconds away from the checkpoint in long songs, and scanning the file for
+ * every respawn would stall. A table is built on a worker the first time a
+ * song plays and kept next to the songs in nongs/seek, so later sessions
+ * only read it back.
+ */
+class SeekIndexManager {
+protected:
+    struct SeekIndex {
+        std::uint32_t sampleRate = 0;
+        std::uint32_t samplesPerFrame = 0;
+        // Byte offset of every frame
+        std::vector<std::uint64_t> frames;
+        std::uint64_t audioEnd = 0;
+    };
+
+    constexpr static inline std::uint32_t s_magic = 0x4b534a42;  // "BJSK"
+    constexpr static inline std::uint16_t s_version = 1;
+
+    // Song file the hooks loaded last, main thread only
+    std::filesystem::path m_requested;
+    // Its table once the worker read it, std::nullopt while it's loading
+    // or if FMOD seeks the song right by itself
+    std::optional<SeekIndex> m_index;
+
+    // The table of the song playing is wanted right away
+    Executor::Strand m_worker{Executor::Priority::Visible};
+
+    SeekIndexManager() = default;
+
+    SeekIndexManager(const SeekIndexManager&) = delete;
+    SeekIndexManager(SeekIndexManager&&) = delete;
+
+    SeekIndexManager& operator=(const SeekIndexManager&) = delete;
+    SeekIndexManager& operator=(SeekIndexManager&&) = delete;
+
+    std::filesystem::path seekPath();
+    std::filesystem::path sidecarPath(const std::filesystem::path& song);
+    /**
+     * Reads the stored table of a song, or builds and stores it. Worker
+     * thread only
+     */
+    std::optional<SeekIndex> loadIndex(const std::filesystem::path& song);
+
+public:
+    /**
+     * Loads the table of a song file in the background, replacing the one
+     * loaded before. Called when FMOD starts playing the song.
+     */
+    void load(const std::filesystem::path& song);
+
+    /**
+     * Drops the loaded table, for when the music isn't a NONG
+     */
+    void unload();
+
+    /**
+     * Time to hand FMOD so that its constant bitrate estimate lands on the
+     * frame that actually plays at ms
+     *
+     * @param ms where to seek the loaded song to
+     * @param lengthMs the length FMOD reports for the song
+     * @return std::nullopt if FMOD seeks the song right by itself
+     */
+    std::optional<unsigned int> fmodSeekTime(unsigned int ms,
+                                             unsigned int lengthMs) const;
+
+    /**
+     * Deletes, in the background, the tables of songs that aren't on disk
+     * anymore
+     */
+    void prune();
+
+    static SeekIndexManager& get() {
+        static SeekIndexManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
@@ -0,0 +1,94 @@
+#include <jukebox/managers/shared_library.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Geode/loader/Mod.hpp>
+#include <Geode/loader/SettingV3.hpp>
+
+#include <jukebox/download/optimize.hpp>
+#include <jukebox/managers/file_status_cache.hpp>
+#include <jukebox/utils/trim.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+void SharedLibrary::init() {
+    m_roots = parseRoots(
+        Mod::get()->getSettingValue<std::string>("shared-libraries"));
+    listenForSettingChanges("shared-libraries", [this](std::string value) {
+        m_roots = parseRoots(value);
+    });
+}
+
+std::vector<std::filesystem::path> SharedLibrary::parseRoots(
+    std::string_view setting) {
+    std::vector<std::filesystem::path> ret;
+    std::size_t start = 0;
+    while (start <= setting.size()) {
+        std::size_t end = setting.find(';', start);
+        if (end == std::string_view::npos) {
+            end = setting.size();
+        }
+        std::string folder(setting.substr(start, end - start));
+        trim(folder);
+        if (!folder.empty()) {
+            ret.push_back(std::filesystem::path(
+                              std::u8string(folder.begin(), folder.end()))
+                              .lexically_normal());
+        }
+        start = end + 1;
+    }
+    return ret;
+}
+
+std::optional<std::filesystem::path> SharedLibrary::find(
+    const std::filesystem::path& filename,
+    std::optional<std::string_view> sha256) const {
+    for (const std::filesystem::path& root : m_roots) {
+        if (std::filesystem::path path = root / filename;
+            FileStatusCache::get().exists(path)) {
+            return path;
+        }
+        // The other install may have optimized its copy, which can rename
+        // it
+        for (std::string_view extension : download::s_optimizedExtensions) {
+            std::filesystem::path path = root / filename;
+            if (path.extension() == extension) {
+                continue;
+            }
+            path.replace_extension(extension);
+            if (FileStatusCache::get().exists(path)) {
+                return path;
+            }
+        }
+        // Blobs are named after their hash, see BlobStore
+        if (sha256.has_value()) {
+            if (std::filesystem::path path =
+                    root / "blobs" / std::string(sha256.value());
+                FileStatusCache::get().exists(path)) {
+                return path;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+bool SharedLibrary::contains(const std::filesystem::path& path) const {
+    const std::filesystem::path normal = path.lexically_normal();
+    return std::any_of(
+        m_roots.begin(), m_roots.end(),
+        [&normal](const std::filesystem::path& root) {
+            const std::filesystem::path relative =
+                normal.lexically_relative(root);
+            return !relative.empty() && *relative.begin() != "..";
+        });
+}
+
+}  // namespace jukebox
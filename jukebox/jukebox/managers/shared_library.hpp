@@ -0,0 +1,72 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Read-only folders of NONG audio shared between installs, like one on a
+ * network share, set in the "shared-libraries" setting. They're looked
+ * through in order before a song is downloaded, and a song found in one is
+ * played from there, so the nongs folder of the install only holds its own
+ * additions. Files in shared libraries are never written, interned, evicted
+ * or deleted. Main thread only.
+ */
+class SharedLibrary {
+protected:
+    // Parsed from the setting, again whenever it changes
+    std::vector<std::filesystem::path> m_roots;
+
+    SharedLibrary() = default;
+
+    SharedLibrary(const SharedLibrary&) = delete;
+    SharedLibrary(SharedLibrary&&) = delete;
+
+    SharedLibrary& operator=(const SharedLibrary&) = delete;
+    SharedLibrary& operator=(SharedLibrary&&) = delete;
+
+    static std::vector<std::filesystem::path> parseRoots(
+        std::string_view setting);
+
+public:
+    /**
+     * Reads the setting and follows its changes
+     */
+    void init();
+
+    /**
+     * The shared library folders, in the order they're looked through
+     */
+    const std::vector<std::filesystem::path>& roots() const {
+        return m_roots;
+    }
+
+    /**
+     * Finds a song in the shared libraries, by its file name under any of
+     * the extensions optimizing a download may give it, or by its content
+     * hash in the blob store of a library that is another install's nongs
+     * folder
+     *
+     * @param filename name of the file in the nongs folder
+     * @param sha256 hex SHA-256 of the song, if known
+     * @return the path in the first library that has it
+     */
+    std::optional<std::filesystem::path> find(
+        const std::filesystem::path& filename,
+        std::optional<std::string_view> sha256 = std::nullopt) const;
+
+    /**
+     * Whether a path is inside one of the shared libraries
+     */
+    bool contains(const std::filesystem::path& path) const;
+
+    static SharedLibrary& get() {
+        static SharedLibrary instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
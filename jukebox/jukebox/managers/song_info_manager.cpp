@@ -0,0 +1,119 @@
+#include <jukebox/managers/song_info_manager.hpp>
+
+#include <chrono>
+#include <unordered_map>
+
+#include <Geode/binding/MusicDownloadManager.hpp>
+#include <Geode/cocos/CCDirector.h>
+#include <Geode/cocos/CCScheduler.h>
+
+#include <jukebox/managers/nong_manager.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+// Scheduler target for sending queued requests
+class SongInfoTimer : public CCObject {
+public:
+    void onPump(float) { SongInfoManager::get().pump(); }
+
+    static SongInfoTimer* get() {
+        static SongInfoTimer* instance = new SongInfoTimer();
+        return instance;
+    }
+};
+
+}  // namespace
+
+void SongInfoManager::request(int songID, bool refetch) {
+    if (m_inFlight.contains(songID)) {
+        return;
+    }
+
+    if (auto it = m_queued.find(songID); it != m_queued.end()) {
+        it->second = it->second || refetch;
+        return;
+    }
+
+    if (!m_holdingSaves) {
+        m_holdingSaves = true;
+        NongManager::get().holdSaves();
+    }
+
+    m_queued.emplace(songID, refetch);
+    if (refetch) {
+        m_queue.push_front(songID);
+    } else {
+        m_queue.push_back(songID);
+    }
+
+    // The first request of a batch goes out right away
+    this->pump();
+
+    if (!m_pumping && this->pending() > 0) {
+        m_pumping = true;
+        CCDirector::sharedDirector()->getScheduler()->scheduleSelector(
+            schedule_selector(SongInfoTimer::onPump), SongInfoTimer::get(),
+            s_requestInterval, false);
+    }
+}
+
+void SongInfoManager::completed(int songID) {
+    if (m_inFlight.erase(songID) == 0) {
+        return;
+    }
+    this->pump();
+}
+
+void SongInfoManager::pump() {
+    const Clock::time_point now = Clock::now();
+    std::erase_if(m_inFlight, [now](const auto& entry) {
+        return now - entry.second >= s_requestTimeout;
+    });
+
+    if (!m_queue.empty() && m_inFlight.size() < s_maxInFlight &&
+        now - m_lastSent >=
+            std::chrono::duration<float>(s_requestInterval)) {
+        const int songID = m_queue.front();
+        m_queue.pop_front();
+        auto it = m_queued.find(songID);
+        const bool refetch = it->second;
+        m_queued.erase(it);
+
+        m_lastSent = now;
+        m_inFlight.emplace(songID, now);
+        this->send(songID, refetch);
+    }
+
+    this->finishIfIdle();
+}
+
+void SongInfoManager::send(int songID, bool refetch) {
+    if (refetch) {
+        MusicDownloadManager::sharedState()->clearSong(songID);
+    }
+    MusicDownloadManager::sharedState()->getSongInfo(songID, true);
+}
+
+void SongInfoManager::finishIfIdle() {
+    if (this->pending() > 0) {
+        return;
+    }
+
+    if (m_pumping) {
+        m_pumping = false;
+        CCDirector::sharedDirector()->getScheduler()->unscheduleSelector(
+            schedule_selector(SongInfoTimer::onPump), SongInfoTimer::get());
+    }
+
+    if (m_holdingSaves) {
+        m_holdingSaves = false;
+        // Writes every answer of the batch in one flush
+        NongManager::get().releaseSaves();
+    }
+}
+
+}  // namespace jukebox
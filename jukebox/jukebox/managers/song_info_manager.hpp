@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+
+namespace jukebox {
+
+/**
+ * Queues requests for GD's song info, so opening a level with many unknown
+ * songs doesn't send them all to GD's servers at once. A song ID is only
+ * asked for once while its request is queued or waiting for an answer, and
+ * saves are held while a batch runs, so the answers are written to the
+ * manifest in one flush.
+ */
+class SongInfoManager {
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    // Requests waiting for an answer at once
+    constexpr static inline std::size_t s_maxInFlight = 2;
+    // Seconds between two requests
+    constexpr static inline float s_requestInterval = 0.25f;
+    // GD doesn't tell us about failed requests, they count as answered after
+    // this long
+    constexpr static inline std::chrono::seconds s_requestTimeout{10};
+
+    // Song IDs waiting to be sent, in order
+    std::deque<int> m_queue;
+    // The queued song IDs, and whether GD's stored info is dropped first
+    std::unordered_map<int, bool> m_queued;
+    // Song IDs sent, and when
+    std::unordered_map<int, Clock::time_point> m_inFlight;
+    Clock::time_point m_lastSent;
+    bool m_pumping = false;
+    // Whether the current batch holds the manifest saves
+    bool m_holdingSaves = false;
+
+    SongInfoManager() = default;
+
+    SongInfoManager(const SongInfoManager&) = delete;
+    SongInfoManager(SongInfoManager&&) = delete;
+
+    SongInfoManager& operator=(const SongInfoManager&) = delete;
+    SongInfoManager& operator=(SongInfoManager&&) = delete;
+
+    void send(int songID, bool refetch);
+    // Ends the batch once nothing is queued or in flight
+    void finishIfIdle();
+
+public:
+    /**
+     * Queues a request for the song info of a song. Does nothing if one is
+     * already queued or waiting for an answer.
+     *
+     * @param songID the GD song ID
+     * @param refetch drop what GD has stored for it first. These go to the
+     * front of the queue, they come from the user asking for it
+     */
+    void request(int songID, bool refetch);
+
+    /**
+     * Marks the request of a song as answered
+     *
+     * @param songID the GD song ID
+     */
+    void completed(int songID);
+
+    /**
+     * Sends the next queued requests the rate limit allows. Runs on a timer
+     * while anything is queued.
+     */
+    void pump();
+
+    /**
+     * Requests queued or waiting for an answer
+     */
+    std::size_t pending() const { return m_queue.size() + m_inFlight.size(); }
+
+    static SongInfoManager& get() {
+        static SongInfoManager instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
@@ -0,0 +1,210 @@
+#include <jukebox/nong/index.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <jukebox/utils/memory_usage.hpp>
+
+namespace jukebox {
+
+namespace index {
+
+std::optional<std::string> parseSha256(std::string_view hash) {
+    if (hash.size() != 64) {
+        return std::nullopt;
+    }
+    std::string ret;
+    ret.reserve(hash.size());
+    for (char c : hash) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) {
+            return std::nullopt;
+        }
+        ret.push_back(
+            static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+    return ret;
+}
+
+IndexArena::IndexArena(IndexArena&& other) noexcept {
+    *this = std::move(other);
+}
+
+IndexArena& IndexArena::operator=(IndexArena&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    // Moving the block list keeps every block where it is, so songs and
+    // views into the arena stay valid
+    m_blocks = std::move(other.m_blocks);
+    m_cursor = std::exchange(other.m_cursor, nullptr);
+    m_left = std::exchange(other.m_left, 0);
+    m_reserved = std::exchange(other.m_reserved, 0);
+    m_interned = std::move(other.m_interned);
+    other.m_blocks.clear();
+    other.m_interned.clear();
+    return *this;
+}
+
+void* IndexArena::allocate(std::size_t size, std::size_t align) {
+    auto padding = [this, align]() {
+        const std::uintptr_t at = reinterpret_cast<std::uintptr_t>(m_cursor);
+        return (align - at % align) % align;
+    };
+
+    std::size_t pad = m_cursor ? padding() : 0;
+    if (!m_cursor || pad + size > m_left) {
+        // Oversized allocations get a block of their own
+        const std::size_t blockSize = std::max(s_blockSize, size + align);
+        m_blocks.emplace_back(new std::byte[blockSize]);
+        m_reserved += blockSize;
+        m_cursor = m_blocks.back().get();
+        m_left = blockSize;
+        pad = padding();
+    }
+
+    void* ret = m_cursor + pad;
+    m_cursor += pad + size;
+    m_left -= pad + size;
+    return ret;
+}
+
+std::string_view IndexArena::copy(std::string_view str) {
+    char* data = static_cast<char*>(this->allocate(str.size() + 1, 1));
+    std::memcpy(data, str.data(), str.size());
+    data[str.size()] = '\0';
+    return std::string_view(data, str.size());
+}
+
+std::string_view IndexArena::intern(std::string_view str) {
+    if (auto it = m_interned.find(str); it != m_interned.end()) {
+        return *it;
+    }
+    std::string_view ret = this->copy(str);
+    m_interned.insert(ret);
+    return ret;
+}
+
+std::span<int> IndexArena::allocateIDs(std::size_t count) {
+    if (count == 0) {
+        return {};
+    }
+    int* data =
+        static_cast<int*>(this->allocate(count * sizeof(int), alignof(int)));
+    return std::span<int>(data, count);
+}
+
+std::span<const int> IndexArena::copy(std::span<const int> ids) {
+    std::span<int> ret = this->allocateIDs(ids.size());
+    std::copy(ids.begin(), ids.end(), ret.begin());
+    return ret;
+}
+
+void IndexArena::adopt(IndexArena&& other) {
+    if (this == &other) {
+        return;
+    }
+    // New allocations keep going in the current block, the adopted ones are
+    // only kept alive
+    for (std::unique_ptr<std::byte[]>& block : other.m_blocks) {
+        m_blocks.push_back(std::move(block));
+    }
+    m_interned.merge(other.m_interned);
+    m_reserved += std::exchange(other.m_reserved, 0);
+    other.m_blocks.clear();
+    other.m_interned.clear();
+    other.m_cursor = nullptr;
+    other.m_left = 0;
+}
+
+std::size_t IndexArena::memoryUsage() const {
+    return m_reserved + memory::heapBytes(m_blocks) +
+           memory::heapBytes(m_interned);
+}
+
+IndexSongMetadata* IndexArena::create(IndexSongMetadata&& song) {
+    void* at =
+        this->allocate(sizeof(IndexSongMetadata), alignof(IndexSongMetadata));
+    return new (at) IndexSongMetadata(std::move(song));
+}
+
+std::size_t IndexMetadata::memoryUsage() const {
+    std::size_t bytes = sizeof(IndexMetadata) + memory::heapBytes(m_url) +
+                        memory::heapBytes(m_id) + memory::heapBytes(m_name) +
+                        memory::heapBytes(m_description) +
+                        memory::heapBytes(m_deltaUrl) +
+                        memory::heapBytes(m_mirrors) +
+                        memory::heapBytes(m_songs.m_youtube) +
+                        memory::heapBytes(m_songs.m_hosted) +
+                        m_search.memoryUsage() +
+                        memory::heapBytes(m_searchSongs);
+    for (const Mirror& mirror : m_mirrors) {
+        bytes += memory::heapBytes(mirror.m_from) +
+                 memory::heapBytes(mirror.m_to);
+        for (const std::string& to : mirror.m_to) {
+            bytes += memory::heapBytes(to);
+        }
+    }
+    return bytes;
+}
+
+void IndexMetadata::buildSearchIndex() {
+    m_search.clear();
+    m_searchSongs.clear();
+    m_searchSongs.reserve(m_songs.m_youtube.size() + m_songs.m_hosted.size());
+
+    std::string text;
+    for (const std::vector<IndexSongMetadata*>* songs :
+         {&m_songs.m_youtube, &m_songs.m_hosted}) {
+        for (IndexSongMetadata* song : *songs) {
+            // Newlines keep trigrams from matching across fields
+            text.assign(song->name);
+            text += '\n';
+            text += song->artist;
+            text += '\n';
+            text += m_name;
+            m_search.add(text);
+            m_searchSongs.push_back(song);
+        }
+    }
+}
+
+std::vector<std::string> IndexMetadata::mirrorUrls(std::string_view url) const {
+    std::vector<std::string> ret;
+    for (const Mirror& mirror : m_mirrors) {
+        if (!url.starts_with(mirror.m_from)) {
+            continue;
+        }
+        const std::string_view rest = url.substr(mirror.m_from.size());
+        for (const std::string& to : mirror.m_to) {
+            std::string mirrored = to + std::string(rest);
+            if (mirrored != url &&
+                std::find(ret.begin(), ret.end(), mirrored) == ret.end()) {
+                ret.push_back(std::move(mirrored));
+            }
+        }
+    }
+    return ret;
+}
+
+std::vector<IndexSongMetadata*> IndexMetadata::searchSongs(
+    std::string_view query) const {
+    std::vector<IndexSongMetadata*> ret;
+    for (std::uint32_t id : m_search.search(query)) {
+        ret.push_back(m_searchSongs[id]);
+    }
+    return ret;
+}
+
+}  // namespace index
+
+}  // namespace jukebox
@@ -1,20 +1,96 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <fmt/core.h>
 #include <matjson.hpp>
 #include <vector>
 
+#include <jukebox/utils/trigram_index.hpp>
+
 namespace jukebox {
 
 namespace index {
 
 class IndexSongMetadata;
 
+/**
+ * Backing storage for the songs of an index. Songs, their strings and their
+ * song IDs are bump-allocated out of a few large blocks, and are all freed at
+ * once with the index instead of one by one.
+ *
+ * Strings handed out are null-terminated, so their data() can be passed where
+ * a C string is expected.
+ */
+class IndexArena final {
+public:
+    constexpr static inline std::size_t s_blockSize = 64 * 1024;
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+    std::byte* m_cursor = nullptr;
+    std::size_t m_left = 0;
+    // Bytes of every block, adopted ones included
+    std::size_t m_reserved = 0;
+    std::unordered_set<std::string_view> m_interned;
+
+    void* allocate(std::size_t size, std::size_t align);
+
+public:
+    IndexArena() = default;
+    IndexArena(IndexArena&& other) noexcept;
+    IndexArena& operator=(IndexArena&& other) noexcept;
+    IndexArena(const IndexArena&) = delete;
+    IndexArena& operator=(const IndexArena&) = delete;
+
+    /**
+     * Copies a string into the arena
+     */
+    std::string_view copy(std::string_view str);
+
+    /**
+     * Copies a string into the arena, or returns the copy made by an earlier
+     * call with the same string. Meant for strings that repeat a lot across
+     * songs, like artist names.
+     */
+    std::string_view intern(std::string_view str);
+
+    /**
+     * Copies song IDs into the arena
+     */
+    std::span<const int> copy(std::span<const int> ids);
+
+    /**
+     * Allocates uninitialized room for count song IDs
+     */
+    std::span<int> allocateIDs(std::size_t count);
+
+    /**
+     * Moves a song into the arena. The song must only point into this arena.
+     */
+    IndexSongMetadata* create(IndexSongMetadata&& song);
+
+    /**
+     * Takes over the blocks of another arena. Everything allocated out of
+     * it stays where it is, and is freed with this arena instead.
+     */
+    void adopt(IndexArena&& other);
+
+    /**
+     * Estimated bytes of the blocks and the interned string set
+     */
+    std::size_t memoryUsage() const;
+};
+
 struct IndexSource final {
     std::string m_url;
     bool m_userAdded;
@@ -27,6 +103,9 @@ struct IndexSource final {
 };
 
 struct IndexMetadata final {
+    // Manifest 2 adds delta updates
+    constexpr static inline int s_latestManifest = 2;
+
     struct Links final {
         std::optional<std::string> m_discord = std::nullopt;
     };
@@ -65,9 +144,10 @@ struct IndexMetadata final {
         std::optional<Report> m_report = std::nullopt;
     };
 
+    // The songs themselves live in m_arena
     struct Songs final {
-        std::vector<std::unique_ptr<IndexSongMetadata>> m_youtube;
-        std::vector<std::unique_ptr<IndexSongMetadata>> m_hosted;
+        std::vector<IndexSongMetadata*> m_youtube;
+        std::vector<IndexSongMetadata*> m_hosted;
     };
 
     int m_manifest;
@@ -76,22 +156,82 @@ struct IndexMetadata final {
     std::string m_name;
     std::optional<std::string> m_description;
     std::optional<int> m_lastUpdate;
+    // Where changes since m_lastUpdate are served, with {since} standing in
+    // for it. Manifest 2 and up
+    std::optional<std::string> m_deltaUrl;
+    struct Mirror final {
+        // URL prefix of the songs this mirror serves
+        std::string m_from;
+        // Prefixes serving the same files, in order of preference
+        std::vector<std::string> m_to;
+    };
+    std::vector<Mirror> m_mirrors;
     Links m_links;
     Features m_features;
     Songs m_songs;
+    // Search over the name, artist and index name of every song
+    TrigramIndex m_search;
+    // Search text ID -> song
+    std::vector<IndexSongMetadata*> m_searchSongs;
+    IndexArena m_arena;
+
+    /**
+     * Builds m_search from the songs. Done once per load, off the main thread
+     */
+    void buildSearchIndex();
+
+    /**
+     * Where else a song URL of this index can be downloaded from, according
+     * to m_mirrors. Doesn't include the URL itself
+     */
+    std::vector<std::string> mirrorUrls(std::string_view url) const;
+
+    /**
+     * Estimated bytes held by the index, apart from its arena
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * Finds the songs matching every word of a query
+     */
+    std::vector<IndexSongMetadata*> searchSongs(std::string_view query) const;
 };
 
+// Views into the IndexArena of parentID, valid as long as the index is loaded
 struct IndexSongMetadata final {
-    std::string uniqueID;
-    std::string name;
-    std::string artist;
-    std::optional<std::string> url;
-    std::optional<std::string> ytId;
-    std::vector<int> songIDs;
+    std::string_view uniqueID;
+    std::string_view name;
+    std::string_view artist;
+    std::optional<std::string_view> url;
+    std::optional<std::string_view> ytId;
+    // Lowercase hex SHA-256 of the song file, downloads are checked against
+    // it if the index has it
+    std::optional<std::string_view> sha256;
+    std::span<const int> songIDs;
     int startOffset = 0;
     IndexMetadata* parentID;
 };
 
+/**
+ * Lowercases a hex SHA-256 digest, std::nullopt if it isn't one
+ */
+std::optional<std::string> parseSha256(std::string_view hash);
+
+// Songs are never destroyed, the arena just drops its blocks
+static_assert(std::is_trivially_destructible_v<IndexSongMetadata>);
+
+// An index built off the main thread, waiting to be registered
+struct ParsedIndex final {
+    std::unique_ptr<IndexMetadata> index;
+    // Songs of the index grouped by the song IDs they're for
+    std::unordered_map<int, std::vector<IndexSongMetadata*>> songsForID;
+    // Songs that failed to parse, posted as SongErrors on registration
+    std::vector<std::string> errors;
+    // Hash of the cached JSON the index was built from, an index whose hash
+    // didn't change on refetch isn't registered again
+    std::uint64_t contentHash = 0;
+};
+
 }  // namespace index
 
 }  // namespace jukebox
@@ -0,0 +1,386 @@
+#include <jukebox/nong/index_cache.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/nong/index.hpp>
+#include <jukebox/nong/index_serialize.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/binary_stream.hpp>
+#include <jukebox/utils/mapped_file.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace index {
+
+namespace {
+
+// String reference for fields without a value
+constexpr std::uint32_t s_noString = 0xFFFFFFFF;
+
+enum class RecordType : std::uint8_t { YOUTUBE = 0, HOSTED = 1 };
+
+struct Header {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t reserved;
+    std::uint32_t stringCount;
+    std::uint32_t songCount;
+    std::uint32_t songIDCount;
+    std::uint32_t rangeCount;
+    std::uint32_t refCount;
+    std::uint32_t metadataSize;
+    std::uint64_t stringsOffset;
+    std::uint64_t songsOffset;
+    std::uint64_t songIDsOffset;
+    std::uint64_t rangesOffset;
+    std::uint64_t refsOffset;
+    std::uint64_t contentHash;
+};
+
+struct StringEntry {
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+
+struct SongRecord {
+    RecordType type;
+    std::uint8_t reserved[3];
+    std::uint32_t uniqueID;
+    std::uint32_t name;
+    std::uint32_t artist;
+    std::uint32_t url;
+    std::uint32_t ytID;
+    std::uint32_t sha256;
+    std::int32_t startOffset;
+    std::uint32_t firstSongID;
+    std::uint32_t songIDCount;
+};
+
+struct Range {
+    std::int32_t songID;
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+static_assert(sizeof(Header) == 80);
+static_assert(sizeof(StringEntry) == 8);
+static_assert(sizeof(SongRecord) == 44);
+static_assert(sizeof(Range) == 12);
+
+class StringTable final {
+private:
+    std::unordered_map<std::string_view, std::uint32_t> m_ids;
+    std::vector<StringEntry> m_entries;
+    std::string m_blob;
+
+public:
+    std::uint32_t intern(std::string_view str) {
+        if (auto it = m_ids.find(str); it != m_ids.end()) {
+            return it->second;
+        }
+        const std::uint32_t id = static_cast<std::uint32_t>(m_entries.size());
+        m_entries.push_back(StringEntry{
+            static_cast<std::uint32_t>(m_blob.size()),
+            static_cast<std::uint32_t>(str.size())});
+        m_blob += str;
+        // Keys point into the songs being encoded, which outlive the table
+        m_ids.emplace(str, id);
+        return id;
+    }
+
+    std::uint32_t intern(const std::optional<std::string_view>& str) {
+        return str.has_value() ? this->intern(str.value()) : s_noString;
+    }
+
+    const std::vector<StringEntry>& entries() const { return m_entries; }
+    const std::string& blob() const { return m_blob; }
+};
+
+template <class T>
+Result<std::span<const T>> readArray(std::span<const std::uint8_t> data,
+                                     std::uint64_t offset, std::uint32_t count,
+                                     std::vector<T>& storage) {
+    const std::uint64_t size = static_cast<std::uint64_t>(count) * sizeof(T);
+    if (offset > data.size() || data.size() - offset < size) {
+        return Err("Section at offset {} overruns the cache", offset);
+    }
+    // Copied out instead of cast in place, the mapping has no alignment
+    // guarantees for these offsets
+    storage.resize(count);
+    std::memcpy(storage.data(), data.data() + offset, size);
+    return Ok(std::span<const T>(storage));
+}
+
+}  // namespace
+
+std::vector<std::uint8_t> IndexCache::encode(const matjson::Value& metadata,
+                                             const ParsedIndex& parsed) {
+    const IndexMetadata& index = *parsed.index;
+
+    StringTable strings;
+    std::vector<SongRecord> songs;
+    std::vector<std::int32_t> songIDs;
+    std::unordered_map<const IndexSongMetadata*, std::uint32_t> recordOf;
+
+    auto addSongs =
+        [&](const std::vector<IndexSongMetadata*>& list, RecordType type) {
+            for (const IndexSongMetadata* song : list) {
+                recordOf.emplace(song,
+                                 static_cast<std::uint32_t>(songs.size()));
+                songs.push_back(SongRecord{
+                    .type = type,
+                    .reserved = {},
+                    .uniqueID = strings.intern(song->uniqueID),
+                    .name = strings.intern(song->name),
+                    .artist = strings.intern(song->artist),
+                    .url = strings.intern(song->url),
+                    .ytID = strings.intern(song->ytId),
+                    .sha256 = strings.intern(song->sha256),
+                    .startOffset = song->startOffset,
+                    .firstSongID = static_cast<std::uint32_t>(songIDs.size()),
+                    .songIDCount =
+                        static_cast<std::uint32_t>(song->songIDs.size())});
+                songIDs.insert(songIDs.end(), song->songIDs.begin(),
+                               song->songIDs.end());
+            }
+        };
+    addSongs(index.m_songs.m_youtube, RecordType::YOUTUBE);
+    addSongs(index.m_songs.m_hosted, RecordType::HOSTED);
+
+    std::vector<int> ids;
+    ids.reserve(parsed.songsForID.size());
+    for (const auto& [id, _] : parsed.songsForID) {
+        ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::vector<Range> ranges;
+    std::vector<std::uint32_t> refs;
+    ranges.reserve(ids.size());
+    for (int id : ids) {
+        const std::vector<IndexSongMetadata*>& list = parsed.songsForID.at(id);
+        ranges.push_back(Range{id, static_cast<std::uint32_t>(refs.size()),
+                               static_cast<std::uint32_t>(list.size())});
+        for (const IndexSongMetadata* song : list) {
+            refs.push_back(recordOf.at(song));
+        }
+    }
+
+    const std::string metadataJson = metadata.dump(matjson::NO_INDENTATION);
+
+    Header header{
+        .magic = s_magic,
+        .version = s_version,
+        .reserved = 0,
+        .stringCount = static_cast<std::uint32_t>(strings.entries().size()),
+        .songCount = static_cast<std::uint32_t>(songs.size()),
+        .songIDCount = static_cast<std::uint32_t>(songIDs.size()),
+        .rangeCount = static_cast<std::uint32_t>(ranges.size()),
+        .refCount = static_cast<std::uint32_t>(refs.size()),
+        .metadataSize = static_cast<std::uint32_t>(metadataJson.size()),
+        .contentHash = parsed.contentHash};
+
+    header.stringsOffset = sizeof(Header) + metadataJson.size();
+    header.songsOffset = header.stringsOffset +
+                         strings.entries().size() * sizeof(StringEntry) +
+                         strings.blob().size();
+    header.songIDsOffset = header.songsOffset + songs.size() * sizeof(SongRecord);
+    header.rangesOffset =
+        header.songIDsOffset + songIDs.size() * sizeof(std::int32_t);
+    header.refsOffset = header.rangesOffset + ranges.size() * sizeof(Range);
+
+    auto bytesOf = [](const auto& vec) {
+        return std::span<const std::uint8_t>(
+            reinterpret_cast<const std::uint8_t*>(vec.data()),
+            vec.size() * sizeof(vec[0]));
+    };
+
+    BinaryWriter writer;
+    writer.buffer().reserve(header.refsOffset +
+                            refs.size() * sizeof(std::uint32_t));
+    writer.write(header);
+    writer.writeBytes(bytesOf(metadataJson));
+    writer.writeBytes(bytesOf(strings.entries()));
+    writer.writeBytes(bytesOf(strings.blob()));
+    writer.writeBytes(bytesOf(songs));
+    writer.writeBytes(bytesOf(songIDs));
+    writer.writeBytes(bytesOf(ranges));
+    writer.writeBytes(bytesOf(refs));
+    return writer.take();
+}
+
+Result<ParsedIndex> IndexCache::decode(std::span<const std::uint8_t> data,
+                                       matjson::Value* metadata) {
+    BinaryReader reader(data);
+    GEODE_UNWRAP_INTO(Header header, reader.read<Header>());
+    if (header.magic != s_magic) {
+        return Err("Not an index cache");
+    }
+    if (header.version != s_version) {
+        return Err("Unsupported index cache version {}", header.version);
+    }
+
+    if (reader.remaining() < header.metadataSize) {
+        return Err("Index metadata overruns the cache");
+    }
+    std::string_view metadataJson(
+        reinterpret_cast<const char*>(data.data() + reader.offset()),
+        header.metadataSize);
+    GEODE_UNWRAP_INTO(matjson::Value json, matjson::parse(metadataJson));
+    GEODE_UNWRAP_INTO(IndexMetadata indexMeta,
+                      matjson::Serialize<IndexMetadata>::fromJson(json));
+    if (metadata) {
+        *metadata = std::move(json);
+    }
+
+    std::vector<StringEntry> stringStorage;
+    GEODE_UNWRAP_INTO(auto stringEntries,
+                      readArray(data, header.stringsOffset, header.stringCount,
+                                stringStorage));
+    const std::uint64_t blobOffset =
+        header.stringsOffset +
+        static_cast<std::uint64_t>(header.stringCount) * sizeof(StringEntry);
+    if (blobOffset > header.songsOffset || header.songsOffset > data.size()) {
+        return Err("String table overruns the cache");
+    }
+    std::string_view blob(reinterpret_cast<const char*>(data.data()) + blobOffset,
+                          header.songsOffset - blobOffset);
+
+    std::vector<SongRecord> songStorage;
+    GEODE_UNWRAP_INTO(
+        auto records,
+        readArray(data, header.songsOffset, header.songCount, songStorage));
+    std::vector<std::int32_t> songIDStorage;
+    GEODE_UNWRAP_INTO(auto songIDs,
+                      readArray(data, header.songIDsOffset, header.songIDCount,
+                                songIDStorage));
+    std::vector<Range> rangeStorage;
+    GEODE_UNWRAP_INTO(
+        auto ranges,
+        readArray(data, header.rangesOffset, header.rangeCount, rangeStorage));
+    std::vector<std::uint32_t> refStorage;
+    GEODE_UNWRAP_INTO(
+        auto refs,
+        readArray(data, header.refsOffset, header.refCount, refStorage));
+
+    ParsedIndex parsed;
+    parsed.index = std::make_unique<IndexMetadata>(std::move(indexMeta));
+    parsed.contentHash = header.contentHash;
+    IndexMetadata* index = parsed.index.get();
+    IndexArena& arena = index->m_arena;
+
+    // Strings are already deduplicated in the cache, each one is copied into
+    // the arena the first time a record uses it
+    std::vector<std::optional<std::string_view>> copied(stringEntries.size());
+    auto string =
+        [&](std::uint32_t id) -> Result<std::optional<std::string_view>> {
+        if (id == s_noString) {
+            return Ok(std::nullopt);
+        }
+        if (id >= stringEntries.size()) {
+            return Err("Invalid string reference {}", id);
+        }
+        if (copied[id].has_value()) {
+            return Ok(copied[id]);
+        }
+        const StringEntry& entry = stringEntries[id];
+        if (entry.offset > blob.size() ||
+            blob.size() - entry.offset < entry.length) {
+            return Err("String {} overruns the string table", id);
+        }
+        copied[id] = arena.copy(blob.substr(entry.offset, entry.length));
+        return Ok(copied[id]);
+    };
+    auto requiredString = [&](std::uint32_t id) -> Result<std::string_view> {
+        GEODE_UNWRAP_INTO(std::optional<std::string_view> str, string(id));
+        if (!str.has_value()) {
+            return Err("Missing required string");
+        }
+        return Ok(str.value());
+    };
+
+    std::vector<IndexSongMetadata*> byRecord;
+    byRecord.reserve(records.size());
+
+    for (const SongRecord& record : records) {
+        if (record.firstSongID > songIDs.size() ||
+            songIDs.size() - record.firstSongID < record.songIDCount) {
+            return Err("Song IDs of a record overrun the cache");
+        }
+
+        IndexSongMetadata song;
+        GEODE_UNWRAP_INTO(song.uniqueID, requiredString(record.uniqueID));
+        GEODE_UNWRAP_INTO(song.name, requiredString(record.name));
+        GEODE_UNWRAP_INTO(song.artist, requiredString(record.artist));
+        GEODE_UNWRAP_INTO(song.url, string(record.url));
+        GEODE_UNWRAP_INTO(song.ytId, string(record.ytID));
+        GEODE_UNWRAP_INTO(song.sha256, string(record.sha256));
+        song.startOffset = record.startOffset;
+        song.songIDs = arena.copy(
+            songIDs.subspan(record.firstSongID, record.songIDCount));
+        song.parentID = index;
+
+        IndexSongMetadata* stored = arena.create(std::move(song));
+        byRecord.push_back(stored);
+        if (record.type == RecordType::YOUTUBE) {
+            index->m_songs.m_youtube.push_back(stored);
+        } else {
+            index->m_songs.m_hosted.push_back(stored);
+        }
+    }
+
+    // The lookup table is prebuilt, every song ID gets its list in one go
+    parsed.songsForID.reserve(ranges.size());
+    for (const Range& range : ranges) {
+        if (range.first > refs.size() ||
+            refs.size() - range.first < range.count) {
+            return Err("Song ID range overruns the cache");
+        }
+        std::vector<IndexSongMetadata*>& list = parsed.songsForID[range.songID];
+        list.reserve(range.count);
+        for (std::uint32_t ref : refs.subspan(range.first, range.count)) {
+            if (ref >= byRecord.size()) {
+                return Err("Invalid song record reference {}", ref);
+            }
+            list.push_back(byRecord[ref]);
+        }
+    }
+
+    // Cheaper to rebuild than to store, it only walks the strings once
+    index->buildSearchIndex();
+
+    return Ok(std::move(parsed));
+}
+
+Result<> IndexCache::write(const std::filesystem::path& path,
+                           const matjson::Value& metadata,
+                           const ParsedIndex& parsed) {
+    return write_file_atomic(path, encode(metadata, parsed));
+}
+
+Result<ParsedIndex> IndexCache::read(const std::filesystem::path& path,
+                                     matjson::Value* metadata) {
+    GEODE_UNWRAP_INTO(MappedFile file, MappedFile::open(path));
+    return decode(file.bytes(), metadata);
+}
+
+}  // namespace index
+
+}  // namespace jukebox
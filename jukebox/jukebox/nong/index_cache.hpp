@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/nong/index.hpp>
+
+namespace jukebox {
+
+namespace index {
+
+/**
+ * Binary copy of a parsed index, written next to the cached JSON so later
+ * startups can skip parsing it.
+ *
+ * Layout: a header with the offsets of every section, the index metadata as
+ * JSON (it's tiny, and keeps a single parser for it), an interned string
+ * table, a flat array of song records, the song IDs of every record, and a
+ * table of (song ID, first, count) ranges sorted by song ID that indexes
+ * into a flat array of record numbers.
+ */
+class IndexCache final {
+public:
+    constexpr static inline std::uint32_t s_magic = 0x58494A42;  // "BJIX"
+    constexpr static inline std::uint16_t s_version = 3;
+
+    /**
+     * Encodes an index
+     *
+     * @param metadata the index JSON without its songs
+     * @param parsed the index built from that JSON
+     */
+    static std::vector<std::uint8_t> encode(const matjson::Value& metadata,
+                                            const ParsedIndex& parsed);
+
+    /**
+     * Rebuilds an index from a buffer produced by encode()
+     *
+     * @param metadata if set, receives the index JSON without its songs
+     */
+    static geode::Result<ParsedIndex> decode(
+        std::span<const std::uint8_t> data,
+        matjson::Value* metadata = nullptr);
+
+    static geode::Result<> write(const std::filesystem::path& path,
+                                 const matjson::Value& metadata,
+                                 const ParsedIndex& parsed);
+
+    /**
+     * Maps and decodes a cache file
+     */
+    static geode::Result<ParsedIndex> read(const std::filesystem::path& path,
+                                           matjson::Value* metadata = nullptr);
+};
+
+}  // namespace index
+
+}  // namespace jukebox
@@ -0,0 +1,98 @@
+#include <jukebox/nong/index_delta.hpp>
+
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+
+#include <jukebox/nong/index.hpp>
+
+using namespace geode;
+
+namespace jukebox {
+
+namespace index {
+
+Result<AppliedDelta> applyIndexDelta(IndexMetadata& index,
+                                     IndexDelta&& delta) {
+    if (delta.m_id != index.m_id) {
+        return Err(fmt::format("Delta is for index {}, not {}", delta.m_id,
+                               index.m_id));
+    }
+    if (!index.m_lastUpdate.has_value() ||
+        index.m_lastUpdate.value() != delta.m_since) {
+        return Err(fmt::format("Delta is for version {} of index {}",
+                               delta.m_since, index.m_id));
+    }
+
+    // Changed songs go out like removed ones, then come back in
+    std::unordered_set<std::string_view> replaced(delta.m_removed.begin(),
+                                                  delta.m_removed.end());
+    for (const std::vector<IndexSongMetadata*>* songs :
+         {&delta.m_songs.m_youtube, &delta.m_songs.m_hosted}) {
+        for (IndexSongMetadata* song : *songs) {
+            replaced.insert(song->uniqueID);
+        }
+    }
+
+    AppliedDelta applied;
+    for (std::vector<IndexSongMetadata*>* songs :
+         {&index.m_songs.m_youtube, &index.m_songs.m_hosted}) {
+        std::erase_if(*songs, [&](IndexSongMetadata* song) {
+            if (!replaced.contains(song->uniqueID)) {
+                return false;
+            }
+            applied.removed.push_back(song);
+            return true;
+        });
+    }
+
+    auto add = [&](std::vector<IndexSongMetadata*>& from,
+                   std::vector<IndexSongMetadata*>& to) {
+        for (IndexSongMetadata* song : from) {
+            song->parentID = &index;
+            to.push_back(song);
+            applied.added.push_back(song);
+        }
+    };
+    add(delta.m_songs.m_youtube, index.m_songs.m_youtube);
+    add(delta.m_songs.m_hosted, index.m_songs.m_hosted);
+
+    index.m_arena.adopt(std::move(delta.m_arena));
+    index.m_lastUpdate = delta.m_lastUpdate;
+    index.buildSearchIndex();
+
+    return Ok(std::move(applied));
+}
+
+Result<> applyIndexDelta(ParsedIndex& parsed, IndexDelta&& delta) {
+    GEODE_UNWRAP_INTO(AppliedDelta applied,
+                      applyIndexDelta(*parsed.index, std::move(delta)));
+
+    for (IndexSongMetadata* song : applied.removed) {
+        for (int id : song->songIDs) {
+            auto it = parsed.songsForID.find(id);
+            if (it == parsed.songsForID.end()) {
+                continue;
+            }
+            std::erase(it->second, song);
+            if (it->second.empty()) {
+                parsed.songsForID.erase(it);
+            }
+        }
+    }
+    for (IndexSongMetadata* song : applied.added) {
+        for (int id : song->songIDs) {
+            parsed.songsForID[id].push_back(song);
+        }
+    }
+
+    return Ok();
+}
+
+}  // namespace index
+
+}  // namespace jukebox
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+#include <jukebox/nong/index.hpp>
+
+namespace jukebox {
+
+namespace index {
+
+/**
+ * Changes to an index since one of its versions, served from the delta URL
+ * of a manifest 2 index:
+ *
+ *   {"manifest": 2, "id": "...", "since": 1700000000,
+ *    "lastUpdate": 1700086400, "nongs": {"youtube": {}, "hosted": {}},
+ *    "removed": ["unique ID", ...]}
+ *
+ * Songs in "nongs" were added or changed since "since", a changed song
+ * replaces the one with its unique ID as a whole.
+ */
+struct IndexDelta final {
+    std::string m_id;
+    int m_since = 0;
+    int m_lastUpdate = 0;
+    // Added or changed songs, without a parent yet
+    IndexMetadata::Songs m_songs;
+    std::vector<std::string_view> m_removed;
+    // Songs that failed to parse
+    std::vector<std::string> m_errors;
+    IndexArena m_arena;
+};
+
+struct AppliedDelta final {
+    // Songs taken out of the index, changed ones included. They stay valid
+    // until the index is unloaded
+    std::vector<IndexSongMetadata*> removed;
+    // Songs put into the index, changed ones included
+    std::vector<IndexSongMetadata*> added;
+};
+
+/**
+ * Applies a delta to an index in place, then rebuilds its search index. The
+ * delta's songs move into the index's arena. Fails without touching the
+ * index if the delta is for another index or version of it.
+ */
+geode::Result<AppliedDelta> applyIndexDelta(IndexMetadata& index,
+                                            IndexDelta&& delta);
+
+/**
+ * Same as the above, for an index that isn't registered yet. Keeps the
+ * songs grouped by song ID up to date.
+ */
+geode::Result<> applyIndexDelta(ParsedIndex& parsed, IndexDelta&& delta);
+
+}  // namespace index
+
+}  // namespace jukebox
@@ -0,0 +1,312 @@
+#include <jukebox/nong/index_parser.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/nong/index.hpp>
+#include <jukebox/nong/index_delta.hpp>
+#include <jukebox/nong/index_serialize.hpp>
+#include <jukebox/utils/json_reader.hpp>
+
+using namespace geode;
+
+namespace jukebox {
+
+namespace index {
+
+Result<ParsedIndex> parseIndex(matjson::Value&& json) {
+    GEODE_UNWRAP_INTO(IndexMetadata indexMeta,
+                      matjson::Serialize<IndexMetadata>::fromJson(json));
+
+    ParsedIndex parsed;
+    parsed.index = std::make_unique<IndexMetadata>(std::move(indexMeta));
+    IndexMetadata* index = parsed.index.get();
+
+    auto parseSongs = [&](const matjson::Value& songs,
+                          std::vector<IndexSongMetadata*>& destination) {
+        destination.reserve(songs.size());
+        for (const auto& [key, value] : songs) {
+            Result<IndexSongMetadata> r =
+                matjson::Serialize<IndexSongMetadata>::fromJson(
+                    value, index->m_arena);
+            if (r.isErr()) {
+                parsed.errors.push_back(fmt::format(
+                    "Failed to parse index song: {}", r.unwrapErr()));
+                continue;
+            }
+
+            IndexSongMetadata song = r.unwrap();
+            song.uniqueID = index->m_arena.copy(key);
+            song.parentID = index;
+            IndexSongMetadata* stored = index->m_arena.create(std::move(song));
+
+            for (int id : stored->songIDs) {
+                parsed.songsForID[id].push_back(stored);
+            }
+
+            destination.push_back(stored);
+        }
+    };
+
+    parseSongs(json["nongs"]["youtube"], index->m_songs.m_youtube);
+    parseSongs(json["nongs"]["hosted"], index->m_songs.m_hosted);
+    index->buildSearchIndex();
+
+    return Ok(std::move(parsed));
+}
+
+namespace {
+
+/**
+ * Reads one song of "youtube" or "hosted" into the arena, with the same
+ * checks as its matjson serializer. A song that fails them is still read
+ * past and its error put in error, syntax errors are returned.
+ */
+Result<> readSong(JsonReader& reader, IndexArena& arena,
+                  std::vector<int>& songIDs, IndexSongMetadata& song,
+                  std::optional<std::string>& error) {
+    bool hasName = false;
+    bool hasArtist = false;
+    bool hasSongs = false;
+    bool hasSha256 = false;
+    songIDs.clear();
+
+    auto optionalString = [&]() -> Result<std::optional<std::string_view>> {
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (type != JsonReader::Type::String) {
+            GEODE_UNWRAP(reader.skip());
+            return Ok(std::nullopt);
+        }
+        GEODE_UNWRAP_INTO(std::string_view str, reader.readString());
+        return Ok(arena.copy(str));
+    };
+
+    GEODE_UNWRAP(reader.readObject([&](std::string_view key) -> Result<> {
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (key == "name" && type == JsonReader::Type::String) {
+            GEODE_UNWRAP_INTO(std::string_view name, reader.readString());
+            song.name = arena.intern(name);
+            hasName = true;
+            return Ok();
+        }
+        if (key == "artist" && type == JsonReader::Type::String) {
+            GEODE_UNWRAP_INTO(std::string_view artist, reader.readString());
+            song.artist = arena.intern(artist);
+            hasArtist = true;
+            return Ok();
+        }
+        if (key == "url") {
+            GEODE_UNWRAP_INTO(song.url, optionalString());
+            return Ok();
+        }
+        if (key == "ytID") {
+            GEODE_UNWRAP_INTO(song.ytId, optionalString());
+            return Ok();
+        }
+        if (key == "sha256") {
+            hasSha256 = true;
+            if (type != JsonReader::Type::String) {
+                return reader.skip();
+            }
+            GEODE_UNWRAP_INTO(std::string_view str, reader.readString());
+            if (std::optional<std::string> hash = parseSha256(str)) {
+                song.sha256 = arena.copy(hash.value());
+            }
+            return Ok();
+        }
+        if (key == "songs" && type == JsonReader::Type::Array) {
+            hasSongs = true;
+            return reader.readArray([&]() -> Result<> {
+                GEODE_UNWRAP_INTO(JsonReader::Type element, reader.peek());
+                if (element != JsonReader::Type::Number) {
+                    return reader.skip();
+                }
+                GEODE_UNWRAP_INTO(std::int64_t id, reader.readInt());
+                songIDs.push_back(static_cast<int>(id));
+                return Ok();
+            });
+        }
+        if (key == "startOffset" && type == JsonReader::Type::Number) {
+            GEODE_UNWRAP_INTO(std::int64_t offset, reader.readInt());
+            song.startOffset = static_cast<int>(offset);
+            return Ok();
+        }
+        return reader.skip();
+    }));
+
+    if (!hasName) {
+        error = "Song is missing \"name\" key";
+    } else if (!hasArtist) {
+        error = "Song is missing \"artist\" key";
+    } else if (!hasSongs) {
+        error = "Song is missing \"songs\" key";
+    } else if (hasSha256 && !song.sha256.has_value()) {
+        error = "Song has an invalid \"sha256\" key";
+    } else {
+        song.songIDs = arena.copy(std::span<const int>(songIDs));
+    }
+    return Ok();
+}
+
+/**
+ * Reads the "nongs" object of an index or delta into songs, calling
+ * onSong(song) for each one that parsed
+ */
+template <class Fn>
+Result<> readNongs(JsonReader& reader, IndexArena& arena, IndexMetadata* parent,
+                   IndexMetadata::Songs& songs,
+                   std::vector<std::string>& errors, Fn&& onSong) {
+    // Reused by every song
+    std::vector<int> songIDs;
+
+    auto readSongs = [&](std::vector<IndexSongMetadata*>& destination) {
+        return reader.readObject([&](std::string_view key) -> Result<> {
+            IndexSongMetadata song{.uniqueID = arena.copy(key),
+                                   .parentID = parent};
+            std::optional<std::string> error;
+            GEODE_UNWRAP(readSong(reader, arena, songIDs, song, error));
+            if (error.has_value()) {
+                errors.push_back(fmt::format("Failed to parse index song: {}",
+                                             error.value()));
+                return Ok();
+            }
+
+            IndexSongMetadata* stored = arena.create(std::move(song));
+            onSong(stored);
+            destination.push_back(stored);
+            return Ok();
+        });
+    };
+
+    return reader.readObject([&](std::string_view type) -> Result<> {
+        if (type == "youtube") {
+            return readSongs(songs.m_youtube);
+        }
+        if (type == "hosted") {
+            return readSongs(songs.m_hosted);
+        }
+        return reader.skip();
+    });
+}
+
+}  // namespace
+
+Result<ParsedIndex> parseIndex(std::string_view text, std::string_view url,
+                               matjson::Value* metadata) {
+    ParsedIndex parsed;
+    parsed.index = std::make_unique<IndexMetadata>();
+    IndexMetadata* index = parsed.index.get();
+    matjson::Value fields = matjson::makeObject({});
+
+    JsonReader reader(text);
+    GEODE_UNWRAP(reader.readObject([&](std::string_view key) -> Result<> {
+        if (key != "nongs") {
+            std::string name(key);
+            GEODE_UNWRAP_INTO(matjson::Value value, reader.readValue());
+            fields.set(name, std::move(value));
+            return Ok();
+        }
+        return readNongs(reader, index->m_arena, index, index->m_songs,
+                         parsed.errors, [&](IndexSongMetadata* song) {
+                             for (int id : song->songIDs) {
+                                 parsed.songsForID[id].push_back(song);
+                             }
+                         });
+    }));
+    GEODE_UNWRAP(reader.finish());
+    if (!url.empty()) {
+        fields.set("url", std::string(url));
+    }
+
+    // The metadata may come after the songs, so the songs were read into an
+    // empty index that gets the metadata now
+    GEODE_UNWRAP_INTO(IndexMetadata indexMeta,
+                      matjson::Serialize<IndexMetadata>::fromJson(fields));
+    index->m_manifest = indexMeta.m_manifest;
+    index->m_url = std::move(indexMeta.m_url);
+    index->m_id = std::move(indexMeta.m_id);
+    index->m_name = std::move(indexMeta.m_name);
+    index->m_description = std::move(indexMeta.m_description);
+    index->m_lastUpdate = indexMeta.m_lastUpdate;
+    index->m_deltaUrl = std::move(indexMeta.m_deltaUrl);
+    index->m_mirrors = std::move(indexMeta.m_mirrors);
+    index->m_links = std::move(indexMeta.m_links);
+    index->m_features = std::move(indexMeta.m_features);
+    index->buildSearchIndex();
+
+    if (metadata) {
+        *metadata = std::move(fields);
+    }
+    return Ok(std::move(parsed));
+}
+
+Result<IndexDelta> parseIndexDelta(std::string_view text) {
+    IndexDelta delta;
+    std::optional<std::int64_t> manifest;
+    std::optional<std::int64_t> since;
+    std::optional<std::int64_t> lastUpdate;
+
+    JsonReader reader(text);
+    GEODE_UNWRAP(reader.readObject([&](std::string_view key) -> Result<> {
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        const bool number = type == JsonReader::Type::Number;
+        if (key == "manifest" && number) {
+            GEODE_UNWRAP_INTO(manifest, reader.readInt());
+            return Ok();
+        }
+        if (key == "since" && number) {
+            GEODE_UNWRAP_INTO(since, reader.readInt());
+            return Ok();
+        }
+        if (key == "lastUpdate" && number) {
+            GEODE_UNWRAP_INTO(lastUpdate, reader.readInt());
+            return Ok();
+        }
+        if (key == "id" && type == JsonReader::Type::String) {
+            GEODE_UNWRAP_INTO(std::string_view id, reader.readString());
+            delta.m_id = id;
+            return Ok();
+        }
+        if (key == "nongs") {
+            return readNongs(reader, delta.m_arena, nullptr, delta.m_songs,
+                             delta.m_errors, [](IndexSongMetadata*) {});
+        }
+        if (key == "removed" && type == JsonReader::Type::Array) {
+            return reader.readArray([&]() -> Result<> {
+                GEODE_UNWRAP_INTO(std::string_view id, reader.readString());
+                delta.m_removed.push_back(delta.m_arena.copy(id));
+                return Ok();
+            });
+        }
+        return reader.skip();
+    }));
+    GEODE_UNWRAP(reader.finish());
+
+    if (!manifest.has_value() || manifest.value() < 2 ||
+        manifest.value() > IndexMetadata::s_latestManifest) {
+        return Err("Delta has no supported manifest version");
+    }
+    if (delta.m_id.empty()) {
+        return Err("Expected id in delta");
+    }
+    if (!since.has_value() || !lastUpdate.has_value()) {
+        return Err("Expected since and lastUpdate in delta");
+    }
+    delta.m_since = static_cast<int>(since.value());
+    delta.m_lastUpdate = static_cast<int>(lastUpdate.value());
+    return Ok(std::move(delta));
+}
+
+}  // namespace index
+
+}  // namespace jukebox
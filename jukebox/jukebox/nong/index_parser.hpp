@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string_view>
+
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/nong/index.hpp>
+#include <jukebox/nong/index_delta.hpp>
+
+namespace jukebox {
+
+namespace index {
+
+/**
+ * Builds an index and its songs from JSON, along with its search index.
+ * Songs that fail to parse are skipped and listed in the errors of the
+ * result. Safe to call from worker threads
+ */
+geode::Result<ParsedIndex> parseIndex(matjson::Value&& json);
+
+/**
+ * Same as the above, straight from JSON text. Songs are built as they are
+ * read, only the index metadata, everything but "nongs", is ever held as a
+ * matjson::Value.
+ *
+ * @param url the URL the index was fetched from, replacing the "url" of the
+ * JSON. Empty to keep the one in the JSON
+ * @param metadata set to the index metadata, if given
+ */
+geode::Result<ParsedIndex> parseIndex(std::string_view text,
+                                      std::string_view url = {},
+                                      matjson::Value* metadata = nullptr);
+
+/**
+ * Reads the changes to an index since one of its versions, see IndexDelta.
+ * Songs that fail to parse are skipped and listed in its errors.
+ */
+geode::Result<IndexDelta> parseIndexDelta(std::string_view text);
+
+}  // namespace index
+
+}  // namespace jukebox
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 
 #include <Geode/Result.hpp>
 #include <matjson.hpp>
@@ -12,7 +17,8 @@ struct matjson::Serialize<
     jukebox::index::IndexMetadata::Features::RequestParams> {
     static geode::Result<jukebox::index::IndexMetadata::Features::RequestParams>
     fromJson(matjson::Value const& value, int manifest) {
-        if (manifest != 1) {
+        if (manifest < 1 ||
+            manifest > jukebox::index::IndexMetadata::s_latestManifest) {
             return geode::Err("Using unsupported manifest version: " +
                               std::to_string(manifest));
         }
@@ -57,7 +63,8 @@ protected:
 public:
     static geode::Result<jukebox::index::IndexMetadata::Features> fromJson(
         matjson::Value const& value, int manifest) {
-        if (manifest != 1) {
+        if (manifest < 1 ||
+            manifest > jukebox::index::IndexMetadata::s_latestManifest) {
             return geode::Err("Using unsupported manifest version: " +
                               std::to_string(manifest));
         }
@@ -165,7 +172,9 @@ struct matjson::Serialize<jukebox::index::IndexMetadata> {
         }
         const int manifestVersion = value["manifest"].asInt().unwrap();
 
-        if (manifestVersion == 1) {
+        if (manifestVersion >= 1 &&
+            manifestVersion <=
+                jukebox::index::IndexMetadata::s_latestManifest) {
             // Links
             jukebox::index::IndexMetadata::Links links;
             if (value.contains("links") && value["links"].isObject()) {
@@ -203,6 +212,38 @@ struct matjson::Serialize<jukebox::index::IndexMetadata> {
                 return geode::Err("Description must be a string");
             }
 
+            std::optional<std::string> deltaUrl;
+            if (manifestVersion >= 2 && value.contains("delta")) {
+                const matjson::Value& delta = value["delta"];
+                if (!delta.isObject() || !delta["url"].isString()) {
+                    return geode::Err("Expected url in delta");
+                }
+                deltaUrl = delta["url"].asString().unwrap();
+            }
+
+            std::vector<jukebox::index::IndexMetadata::Mirror> mirrors;
+            if (value.contains("mirrors")) {
+                if (!value["mirrors"].isArray()) {
+                    return geode::Err("Expected mirrors to be an array");
+                }
+                for (const matjson::Value& mirror : value["mirrors"]) {
+                    if (!mirror["from"].isString() || !mirror["to"].isArray()) {
+                        return geode::Err(
+                            "Expected from and to in every mirror");
+                    }
+                    jukebox::index::IndexMetadata::Mirror parsed{
+                        .m_from = mirror["from"].asString().unwrap()};
+                    for (const matjson::Value& to : mirror["to"]) {
+                        if (!to.isString()) {
+                            return geode::Err(
+                                "Expected mirror to be a list of strings");
+                        }
+                        parsed.m_to.push_back(to.asString().unwrap());
+                    }
+                    mirrors.push_back(std::move(parsed));
+                }
+            }
+
             return geode::Ok(jukebox::index::IndexMetadata{
                 .m_manifest = manifestVersion,
                 .m_url = value["url"].asString().unwrap(),
@@ -218,6 +259,8 @@ struct matjson::Serialize<jukebox::index::IndexMetadata> {
                         .asInt()
                         .map([](auto i) { return std::optional(i); })
                         .unwrapOr(std::nullopt),
+                .m_deltaUrl = std::move(deltaUrl),
+                .m_mirrors = std::move(mirrors),
                 .m_links = links,
                 .m_features = featuresResult.unwrap()});
         }
@@ -227,10 +270,12 @@ struct matjson::Serialize<jukebox::index::IndexMetadata> {
     }
 };
 
+// Songs are parsed straight into the arena of their index, so unlike the
+// other serializers this one needs the arena passed in
 template <>
 struct matjson::Serialize<jukebox::index::IndexSongMetadata> {
     static geode::Result<jukebox::index::IndexSongMetadata> fromJson(
-        const matjson::Value& value) {
+        const matjson::Value& value, jukebox::index::IndexArena& arena) {
         if (!value.contains("name")) {
             return geode::Err("Song is missing \"name\" key");
         }
@@ -245,28 +290,44 @@ struct matjson::Serialize<jukebox::index::IndexSongMetadata> {
 
         const std::vector<matjson::Value>& jsonSongs =
             value["songs"].asArray().unwrap();
-        std::vector<int> songs;
-        songs.reserve(jsonSongs.size());
+        const std::size_t count = std::count_if(
+            jsonSongs.begin(), jsonSongs.end(),
+            [](const matjson::Value& i) { return i.isNumber(); });
+        std::span<int> songs = arena.allocateIDs(count);
+        std::size_t at = 0;
         for (const matjson::Value& i : jsonSongs) {
             if (!i.isNumber()) {
                 continue;
             }
-            songs.push_back(i.asInt().unwrap());
+            songs[at++] = i.asInt().unwrap();
+        }
+
+        auto optionalString = [&arena](const matjson::Value& str)
+            -> std::optional<std::string_view> {
+            if (!str.isString()) {
+                return std::nullopt;
+            }
+            return arena.copy(str.asString().unwrap());
+        };
+
+        std::optional<std::string_view> sha256;
+        if (value.contains("sha256")) {
+            std::optional<std::string> hash = jukebox::index::parseSha256(
+                value["sha256"].asString().unwrapOr(""));
+            if (!hash.has_value()) {
+                return geode::Err("Song has an invalid \"sha256\" key");
+            }
+            sha256 = arena.copy(hash.value());
         }
 
         return geode::Ok(jukebox::index::IndexSongMetadata{
-            .uniqueID = "",
-            .name = value["name"].asString().unwrap(),
-            .artist = value["artist"].asString().unwrap(),
-            .url = value["url"]
-                       .asString()
-                       .map([](auto i) { return std::optional(i); })
-                       .unwrapOr(std::nullopt),
-            .ytId = value["ytID"]
-                        .asString()
-                        .map([](auto i) { return std::optional(i); })
-                        .unwrapOr(std::nullopt),
-            .songIDs = std::move(songs),
+            .uniqueID = {},
+            .name = arena.intern(value["name"].asString().unwrap()),
+            .artist = arena.intern(value["artist"].asString().unwrap()),
+            .url = optionalString(value["url"]),
+            .ytId = optionalString(value["ytID"]),
+            .sha256 = sha256,
+            .songIDs = songs,
             .startOffset =
                 static_cast<int>(value["startOffset"].asInt().unwrapOr(0)),
             .parentID = nullptr});
@@ -0,0 +1,206 @@
+#include <jukebox/nong/manifest_journal.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+
+#include <jukebox/utils/binary_stream.hpp>
+#include <jukebox/utils/string_hash.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+struct Header {
+    std::uint32_t magic;
+    std::uint16_t formatVersion;
+    std::uint16_t reserved;
+};
+
+// Every record is framed by its length and a hash of its payload, so a
+// record torn by a crash is told apart from a complete one
+struct Frame {
+    std::uint32_t length;
+    std::uint32_t reserved;
+    std::uint64_t hash;
+};
+
+static_assert(sizeof(Header) == 8);
+static_assert(sizeof(Frame) == 16);
+
+std::uint64_t payloadHash(std::span<const std::uint8_t> payload) {
+    return fnv1a64(std::string_view(
+        reinterpret_cast<const char*>(payload.data()), payload.size()));
+}
+
+Result<ManifestJournal::Record> decodeRecord(
+    std::span<const std::uint8_t> payload) {
+    BinaryReader reader(payload);
+    ManifestJournal::Record record;
+    GEODE_UNWRAP_INTO(record.songID, reader.read<std::int32_t>());
+    GEODE_UNWRAP_INTO(std::uint8_t op, reader.read<std::uint8_t>());
+    record.op = static_cast<ManifestJournal::Op>(op);
+
+    switch (record.op) {
+        case ManifestJournal::Op::Replace: {
+            GEODE_UNWRAP_INTO(std::uint32_t size, reader.read<std::uint32_t>());
+            if (reader.remaining() < size) {
+                return Err("Record for ID {} is truncated", record.songID);
+            }
+            auto start = payload.begin() + reader.offset();
+            record.nongs.assign(start, start + size);
+            break;
+        }
+        case ManifestJournal::Op::Drop:
+            break;
+        case ManifestJournal::Op::SetActive:
+        case ManifestJournal::Op::RemoveSong: {
+            GEODE_UNWRAP_INTO(record.uniqueID, reader.readString());
+            break;
+        }
+        case ManifestJournal::Op::SetDefaultInfo: {
+            GEODE_UNWRAP_INTO(record.name, reader.readString());
+            GEODE_UNWRAP_INTO(record.artist, reader.readString());
+            break;
+        }
+        default:
+            return Err("Unknown journal operation {}", op);
+    }
+
+    return Ok(std::move(record));
+}
+
+}  // namespace
+
+bool ManifestJournal::exists() const {
+    std::error_code ec;
+    return std::filesystem::exists(m_path, ec);
+}
+
+void ManifestJournal::encode(const Record& record,
+                             std::vector<std::uint8_t>& out) {
+    BinaryWriter writer;
+    writer.write<std::int32_t>(record.songID);
+    writer.write<std::uint8_t>(static_cast<std::uint8_t>(record.op));
+    switch (record.op) {
+        case Op::Replace:
+            writer.write<std::uint32_t>(
+                static_cast<std::uint32_t>(record.nongs.size()));
+            writer.writeBytes(record.nongs);
+            break;
+        case Op::Drop:
+            break;
+        case Op::SetActive:
+        case Op::RemoveSong:
+            writer.writeString(record.uniqueID);
+            break;
+        case Op::SetDefaultInfo:
+            writer.writeString(record.name);
+            writer.writeString(record.artist);
+            break;
+    }
+
+    const std::vector<std::uint8_t>& payload = writer.buffer();
+    const Frame frame{.length = static_cast<std::uint32_t>(payload.size()),
+                      .reserved = 0,
+                      .hash = payloadHash(payload)};
+    const auto* frameBytes = reinterpret_cast<const std::uint8_t*>(&frame);
+    out.insert(out.end(), frameBytes, frameBytes + sizeof(Frame));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+Result<std::vector<ManifestJournal::Record>> ManifestJournal::read() {
+    std::ifstream input(m_path, std::ios::binary);
+    if (!input.is_open()) {
+        return Err(fmt::format("Couldn't open file: {}", m_path));
+    }
+    const std::vector<std::uint8_t> data(
+        (std::istreambuf_iterator<char>(input)),
+        std::istreambuf_iterator<char>());
+
+    BinaryReader reader(data);
+    GEODE_UNWRAP_INTO(Header header,
+                      reader.read<Header>().mapErr([](std::string) {
+                          return std::string("Journal is truncated");
+                      }));
+    if (header.magic != s_magic) {
+        return Err("Journal has an invalid header");
+    }
+    if (header.formatVersion != s_formatVersion) {
+        return Err("Unsupported journal format {}", header.formatVersion);
+    }
+
+    std::vector<Record> records;
+    while (reader.remaining() > 0) {
+        Result<Frame> frame = reader.read<Frame>();
+        if (frame.isErr() || reader.remaining() < frame.unwrap().length) {
+            log::warn("Journal ends in a truncated record, dropped it");
+            break;
+        }
+        std::span<const std::uint8_t> payload(data.data() + reader.offset(),
+                                              frame.unwrap().length);
+        (void)reader.skip(payload.size());
+
+        if (payloadHash(payload) != frame.unwrap().hash) {
+            log::warn("Journal record {} is damaged, dropped it and the rest",
+                      records.size());
+            break;
+        }
+
+        Result<Record> record = decodeRecord(payload);
+        if (record.isErr()) {
+            log::error("Skipping journal record {}: {}", records.size(),
+                       record.unwrapErr());
+            continue;
+        }
+        records.push_back(std::move(record.unwrap()));
+    }
+
+    return Ok(std::move(records));
+}
+
+Result<> ManifestJournal::append(std::span<const std::uint8_t> records) {
+    const bool fresh = !this->exists();
+    std::ofstream file(m_path, std::ios::binary | std::ios::app);
+    if (!file.is_open()) {
+        return Err(fmt::format("Couldn't open file: {}", m_path));
+    }
+
+    if (fresh) {
+        const Header header{.magic = s_magic,
+                            .formatVersion = s_formatVersion,
+                            .reserved = 0};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    }
+    file.write(reinterpret_cast<const char*>(records.data()), records.size());
+    file.flush();
+
+    if (!file) {
+        return Err(fmt::format("Couldn't append to journal {}", m_path));
+    }
+    return Ok();
+}
+
+Result<> ManifestJournal::clear() {
+    std::error_code ec;
+    std::filesystem::remove(m_path, ec);
+    if (ec) {
+        return Err(fmt::format("Couldn't remove journal: {}", ec.message()));
+    }
+    return Ok();
+}
+
+}  // namespace jukebox
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+namespace jukebox {
+
+/**
+ * Append-only log of manifest changes, kept next to the manifest itself.
+ *
+ * Small changes, like switching the active song or GD's song info renaming
+ * the default song, are appended as records of a few bytes instead of
+ * rewriting the song's manifest entry. Startup replays the log over the
+ * manifest, and once the log grows past s_compactThreshold every song in it
+ * is written back to the manifest and the log is cleared.
+ *
+ * Every record sets state rather than describing a difference, so replaying
+ * the log again over a manifest the log was already folded into gives the
+ * same result.
+ */
+class ManifestJournal final {
+public:
+    constexpr static inline std::uint32_t s_magic = 0x4C4A424A;  // "JBJL"
+    constexpr static inline std::uint16_t s_formatVersion = 1;
+    // Log size that makes the next flush fold the log into the manifest
+    constexpr static inline std::uint64_t s_compactThreshold = 256 * 1024;
+
+    enum class Op : std::uint8_t {
+        // The whole entry of a song, as a packed record
+        Replace = 1,
+        // The song has nothing left worth storing
+        Drop = 2,
+        SetActive = 3,
+        SetDefaultInfo = 4,
+        RemoveSong = 5,
+    };
+
+    struct Record {
+        int songID = 0;
+        Op op = Op::Replace;
+        // Replace only
+        std::vector<std::uint8_t> nongs;
+        // SetActive and RemoveSong
+        std::string uniqueID;
+        // SetDefaultInfo
+        std::string name;
+        std::string artist;
+    };
+
+private:
+    std::filesystem::path m_path;
+
+public:
+    ManifestJournal(std::filesystem::path path) : m_path(std::move(path)) {}
+
+    const std::filesystem::path& path() const { return m_path; }
+    bool exists() const;
+
+    /**
+     * Appends the encoding of a record to a batch for append()
+     */
+    static void encode(const Record& record, std::vector<std::uint8_t>& out);
+
+    /**
+     * Reads every record in the log. A record cut short or damaged by a
+     * crash ends the log, the records before it are still returned.
+     */
+    geode::Result<std::vector<Record>> read();
+
+    /**
+     * Appends a batch of encoded records, creating the log if needed
+     */
+    geode::Result<> append(std::span<const std::uint8_t> records);
+
+    /**
+     * Empties the log, once everything in it is in the manifest
+     */
+    geode::Result<> clear();
+};
+
+}  // namespace jukebox
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <jukebox/utils/unique_id.hpp>
+
+namespace jukebox {
+
+/**
+ * The active song of a GD song ID, as it was when the snapshot holding it
+ * was published
+ */
+struct ActiveSongSnapshot {
+    UniqueID uniqueID;
+    std::optional<std::filesystem::path> path;
+    std::string name;
+    std::string artist;
+    int startOffset = 0;
+};
+
+/**
+ * Immutable copy of the active songs of the loaded NONGs. Every change to
+ * the manifest publishes a new snapshot instead of touching this one, so
+ * background jobs read a snapshot they hold without locking, however long
+ * they take.
+ *
+ * Entries are shared between snapshots, publishing one only copies the
+ * entries of the songs that changed.
+ */
+struct ManifestSnapshot {
+    // Goes up with every snapshot published
+    std::uint64_t version = 0;
+    std::unordered_map<int, std::shared_ptr<const ActiveSongSnapshot>> songs;
+
+    const ActiveSongSnapshot* find(int songID) const {
+        auto it = songs.find(songID);
+        return it != songs.end() ? it->second.get() : nullptr;
+    }
+};
+
+}  // namespace jukebox
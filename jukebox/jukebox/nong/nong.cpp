@@ -1,270 +1,115 @@
 #include <jukebox/nong/nong.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
-#include <system_error>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <Geode/Result.hpp>
-#include <Geode/binding/MusicDownloadManager.hpp>
-#include <Geode/binding/SongInfoObject.hpp>
-#include <Geode/loader/Log.hpp>
-#include <Geode/utils/Task.hpp>
-#include <Geode/utils/general.hpp>
 #include <matjson.hpp>
 
-#include <jukebox/download/hosted.hpp>
-#include <jukebox/download/youtube.hpp>
-#include <jukebox/events/nong_deleted.hpp>
-#include <jukebox/events/song_state_changed.hpp>
-#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/host/host.hpp>
 #include <jukebox/nong/index.hpp>
-#include <jukebox/nong/nong_serialize.hpp>
+#include <jukebox/utils/memory_usage.hpp>
 #include <jukebox/utils/random_string.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
-using namespace geode::prelude;
+using namespace geode;
 using namespace jukebox::index;
 
 namespace jukebox {
 
-class LocalSong::Impl {
-private:
-    friend class LocalSong;
-
-    std::unique_ptr<SongMetadata> m_metadata;
-    std::filesystem::path m_path;
-
-public:
-    Impl(SongMetadata&& metadata, const std::filesystem::path& path)
-        : m_metadata(std::make_unique<SongMetadata>(metadata)), m_path(path) {}
-
-    Impl(const Impl& other)
-        : m_path(other.m_path),
-          m_metadata(std::make_unique<SongMetadata>(*other.m_metadata)) {}
-    Impl& operator=(const Impl&) = delete;
-
-    ~Impl() = default;
-
-    Impl(Impl&&) = default;
-    Impl& operator=(Impl&&) = default;
+namespace {
 
-    SongMetadata* metadata() const { return m_metadata.get(); }
-    std::filesystem::path path() const { return m_path; }
-    void setPath(std::filesystem::path&& p) { m_path = p; }
-};
-
-LocalSong::LocalSong(SongMetadata&& metadata, const std::filesystem::path& path)
-    : m_impl(std::make_unique<Impl>(std::move(metadata), path)) {}
+// Bumped whenever a song path or an active song changes, so cached playable
+// paths know they're stale without touching the filesystem
+std::atomic<std::uint32_t> s_pathGeneration = 1;
 
-LocalSong::LocalSong(const LocalSong& other)
-    : m_impl(std::make_unique<Impl>(*other.m_impl)) {}
+void bumpPathGeneration() {
+    s_pathGeneration.fetch_add(1, std::memory_order_relaxed);
+}
 
-LocalSong& LocalSong::operator=(const LocalSong& other) {
-    m_impl->m_path = other.m_impl->m_path;
-    m_impl->m_metadata =
-        std::make_unique<SongMetadata>(*other.m_impl->m_metadata);
+// Shared by every Nongs, so a generation also tells which song ID it's from
+std::atomic<std::uint64_t> s_summaryGeneration = 1;
 
-    return *this;
+// The unique ID is pooled, it's counted with the pool
+std::size_t metadataHeapBytes(const SongMetadata& metadata) {
+    return memory::heapBytes(metadata.name) +
+           memory::heapBytes(metadata.artist) +
+           memory::heapBytes(metadata.level);
 }
 
-LocalSong::LocalSong(LocalSong&&) = default;
-LocalSong& LocalSong::operator=(LocalSong&&) = default;
-LocalSong::~LocalSong() = default;
+}  // namespace
+
+LocalSong::LocalSong(SongMetadata&& metadata, std::filesystem::path path)
+    : m_metadata(std::move(metadata)), m_path(std::move(path)) {}
 
-SongMetadata* LocalSong::metadata() const { return m_impl->metadata(); }
-std::optional<std::filesystem::path> LocalSong::path() const {
-    return m_impl->path();
-}
 void LocalSong::setPath(std::filesystem::path p) {
-    m_impl->setPath(std::move(p));
+    m_path = std::move(p);
+    bumpPathGeneration();
 }
 
 LocalSong LocalSong::createUnknown(int songID) {
     return LocalSong{
-        SongMetadata{songID, jukebox::random_string(16), "Unknown", ""},
-        std::filesystem::path(
-            MusicDownloadManager::sharedState()->pathForSong(songID))};
-}
-
-LocalSong LocalSong::fromSongObject(SongInfoObject* obj) {
-    return LocalSong{
-        SongMetadata{obj->m_songID, jukebox::random_string(16), obj->m_songName,
-                     obj->m_artistName},
-        std::filesystem::path(
-            MusicDownloadManager::sharedState()->pathForSong(obj->m_songID))};
+        SongMetadata{songID, UniqueID(jukebox::random_string(16)), "Unknown",
+                     ""},
+        host::gdSongPath(songID)};
 }
 
-class YTSong::Impl {
-private:
-    friend class YTSong;
-
-    std::unique_ptr<SongMetadata> m_metadata;
-    std::string m_youtubeID;
-    std::optional<std::string> m_indexID;
-    std::optional<std::filesystem::path> m_path;
-
-public:
-    Impl(SongMetadata&& metadata, std::string youtubeID,
-         std::optional<std::string> indexID,
-         std::optional<std::filesystem::path> path = std::nullopt)
-        : m_metadata(std::make_unique<SongMetadata>(metadata)),
-          m_youtubeID(youtubeID),
-          m_indexID(indexID),
-          m_path(path) {}
-
-    Impl(const Impl& other)
-        : m_metadata(std::make_unique<SongMetadata>(*other.m_metadata)),
-          m_path(other.m_path),
-          m_indexID(other.m_indexID),
-          m_youtubeID(other.m_youtubeID) {}
-    Impl& operator=(const Impl&) = delete;
-
-    ~Impl() = default;
-
-    Impl(Impl&&) = default;
-    Impl& operator=(Impl&&) = default;
-
-    SongMetadata* metadata() const { return m_metadata.get(); }
-    std::optional<std::filesystem::path> path() const { return m_path; }
-    std::string youtubeID() const { return m_youtubeID; }
-    std::optional<std::string> indexID() const { return m_indexID; }
-    Result<Task<Result<ByteVector>, float>> startDownload() {
-        std::error_code ec;
-        if (m_path.has_value() && std::filesystem::exists(m_path.value(), ec)) {
-            return Err("Song already is downloaded");
-        }
-
-        return Ok(download::startYoutubeDownload(m_youtubeID));
-    }
-    void setPath(std::filesystem::path&& p) { m_path = p; }
-};
-
 YTSong::YTSong(SongMetadata&& metadata, std::string youtubeID,
                std::optional<std::string> indexID,
                std::optional<std::filesystem::path> path)
-    : m_impl(std::make_unique<Impl>(std::move(metadata), youtubeID, indexID,
-                                    path)) {}
-
-YTSong::YTSong(const YTSong& other)
-    : m_impl(std::make_unique<Impl>(*other.m_impl)) {}
-
-YTSong& YTSong::operator=(const YTSong& other) {
-    m_impl->m_youtubeID = other.m_impl->m_youtubeID;
-    m_impl->m_path = other.m_impl->m_path;
-    m_impl->m_indexID = other.m_impl->m_indexID;
-    m_impl->m_metadata =
-        std::make_unique<SongMetadata>(*other.m_impl->m_metadata);
-
-    return *this;
-}
-
-YTSong::YTSong(YTSong&& other) = default;
-YTSong& YTSong::operator=(YTSong&& other) = default;
-YTSong::~YTSong() = default;
-
-SongMetadata* YTSong::metadata() const { return m_impl->metadata(); }
-
-std::string YTSong::youtubeID() const { return m_impl->youtubeID(); }
-
-std::optional<std::string> YTSong::indexID() const { return m_impl->indexID(); }
-void YTSong::setIndexID(const std::string& id) { m_impl->m_indexID = id; }
-
-std::optional<std::filesystem::path> YTSong::path() const {
-    return m_impl->path();
+    : m_metadata(std::move(metadata)),
+      m_youtubeID(std::move(youtubeID)),
+      m_indexID(std::move(indexID)),
+      m_path(std::move(path)) {}
+
+void YTSong::setPath(std::filesystem::path p) {
+    m_path = std::move(p);
+    bumpPathGeneration();
 }
-void YTSong::setPath(std::filesystem::path p) { m_impl->setPath(std::move(p)); }
-
-Result<Task<Result<ByteVector>, float>> YTSong::startDownload() {
-    return m_impl->startDownload();
-}
-
-class HostedSong::Impl {
-private:
-    friend class HostedSong;
-
-    std::unique_ptr<SongMetadata> m_metadata;
-    std::string m_url;
-    std::optional<std::string> m_indexID;
-    std::optional<std::filesystem::path> m_path;
-
-public:
-    Impl(SongMetadata&& metadata, std::string url,
-         std::optional<std::string> indexID,
-         std::optional<std::filesystem::path> path = std::nullopt)
-        : m_metadata(std::make_unique<SongMetadata>(metadata)),
-          m_url(url),
-          m_indexID(indexID),
-          m_path(path) {}
-
-    Impl(const Impl& other)
-        : m_metadata(std::make_unique<SongMetadata>(*other.m_metadata)),
-          m_path(other.m_path),
-          m_indexID(other.m_indexID),
-          m_url(other.m_url) {}
-    Impl& operator=(const Impl& other) = delete;
-
-    Impl(Impl&&) = default;
-    Impl& operator=(Impl&&) = default;
-
-    ~Impl() = default;
-
-    SongMetadata* metadata() const { return m_metadata.get(); }
-    std::string url() const { return m_url; }
-    std::optional<std::string> indexID() const { return m_indexID; }
-    std::optional<std::filesystem::path> path() const { return m_path; }
-    Result<Task<Result<ByteVector>, float>> startDownload() {
-        std::error_code ec;
-        if (m_path.has_value() && std::filesystem::exists(m_path.value(), ec)) {
-            return Err("Song already is downloaded");
-        }
-
-        return Ok(download::startHostedDownload(m_url));
-    }
-    void setPath(std::filesystem::path&& p) { m_path = p; }
-};
 
 HostedSong::HostedSong(SongMetadata&& metadata, std::string url,
                        std::optional<std::string> indexID,
                        std::optional<std::filesystem::path> path)
-    : m_impl(std::make_unique<Impl>(std::move(metadata), url, indexID, path)) {}
+    : m_metadata(std::move(metadata)),
+      m_url(std::move(url)),
+      m_indexID(std::move(indexID)),
+      m_path(std::move(path)) {}
 
-HostedSong::HostedSong(const HostedSong& other)
-    : m_impl(std::make_unique<Impl>(*other.m_impl)) {}
-
-HostedSong& HostedSong::operator=(const HostedSong& other) {
-    m_impl->m_metadata =
-        std::make_unique<SongMetadata>(*other.m_impl->m_metadata);
-    m_impl->m_path = other.m_impl->m_path;
-    m_impl->m_indexID = other.m_impl->m_indexID;
-    m_impl->m_url = other.m_impl->m_url;
-
-    return *this;
-}
-SongMetadata* HostedSong::metadata() const { return m_impl->metadata(); }
-std::string HostedSong::url() const { return m_impl->url(); }
-std::optional<std::string> HostedSong::indexID() const {
-    return m_impl->indexID();
-}
-void HostedSong::setIndexID(const std::string& id) { m_impl->m_indexID = id; }
-std::optional<std::filesystem::path> HostedSong::path() const {
-    return m_impl->path();
-}
 void HostedSong::setPath(std::filesystem::path p) {
-    m_impl->setPath(std::move(p));
+    m_path = std::move(p);
+    bumpPathGeneration();
 }
 
-Result<Task<Result<ByteVector>, float>> HostedSong::startDownload() {
-    return m_impl->startDownload();
+std::size_t LocalSong::memoryUsage() const {
+    return sizeof(LocalSong) + metadataHeapBytes(m_metadata) +
+           memory::heapBytes(m_path);
 }
 
-HostedSong::HostedSong(HostedSong&& other) = default;
-HostedSong& HostedSong::operator=(HostedSong&& other) = default;
-HostedSong::~HostedSong() = default;
+std::size_t YTSong::memoryUsage() const {
+    return sizeof(YTSong) + metadataHeapBytes(m_metadata) +
+           memory::heapBytes(m_youtubeID) + memory::heapBytes(m_indexID) +
+           memory::heapBytes(m_path);
+}
+
+std::size_t HostedSong::memoryUsage() const {
+    return sizeof(HostedSong) + metadataHeapBytes(m_metadata) +
+           memory::heapBytes(m_url) + memory::heapBytes(m_indexID) +
+           memory::heapBytes(m_path);
+}
 
 class Nongs::Impl {
 private:
@@ -273,64 +118,65 @@ private:
     int m_songID;
     Song* m_active;
     std::unique_ptr<LocalSong> m_default;
-    std::vector<std::unique_ptr<LocalSong>> m_locals;
-    std::vector<std::unique_ptr<YTSong>> m_youtube;
-    std::vector<std::unique_ptr<HostedSong>> m_hosted;
+    NongStore m_songs;
 
     std::vector<IndexSongMetadata*> m_indexSongs;
 
+    struct SongSlot {
+        NongType type;
+        Song* song;
+    };
+
+    // uniqueID -> song, kept in sync by add(), deleteSong() and
+    // deleteAllSongs(). Always has the default song
+    std::unordered_map<UniqueID, SongSlot> m_songsByID;
+
+    void indexSong(Song* song) {
+        m_songsByID.emplace(song->metadata()->uniqueID,
+                            SongSlot{song->type(), song});
+    }
+
+    Song* lookup(UniqueID uniqueID, NongType type) const {
+        auto it = m_songsByID.find(uniqueID);
+        if (it == m_songsByID.end() || it->second.type != type) {
+            return nullptr;
+        }
+        return it->second.song;
+    }
+
+    geode::Result<> canAdd(const SongMetadata& metadata) const {
+        if (m_songsByID.contains(metadata.uniqueID)) {
+            return Err(fmt::format(
+                "Attempted to add a duplicate song for id {}", metadata.gdID));
+        }
+        return Ok();
+    }
+
     void deletePath(std::optional<std::filesystem::path> path) {
-        std::error_code ec;
-        if (path.has_value() && std::filesystem::exists(path.value())) {
-            std::filesystem::remove(path.value(), ec);
-            if (ec) {
-                log::error("Couldn't delete nong. Category: {}, message: {}",
-                           ec.category().name(),
-                           ec.category().message(ec.value()));
-                ec = {};
-            }
+        if (!path.has_value()) {
+            return;
         }
+        host::removeSongFiles({std::move(path.value())});
     }
 
 public:
     Impl(int songID, std::unique_ptr<LocalSong> defaultSong)
         : m_songID(songID),
           m_active(defaultSong.get()),
-          m_default(std::move(defaultSong)) {}
+          m_default(std::move(defaultSong)) {
+        this->indexSong(m_default.get());
+    }
 
     Impl(int songID)
         : Impl(songID,
                std::make_unique<LocalSong>(LocalSong::createUnknown(songID))) {}
 
-    geode::Result<> commit(Nongs* self) {
-        const std::filesystem::path path =
-            NongManager::get().baseManifestPath() /
-            fmt::format("{}.json", m_songID);
-
-        // Don't save manifest for songs with no nongs
-        if (m_locals.empty() && m_youtube.empty() && m_hosted.empty()) {
-            std::error_code ec;
-            if (std::filesystem::exists(path, ec)) {
-                std::filesystem::remove(path, ec);
-            }
-
-            return Ok();
-        }
-
-        matjson::Value json = matjson::Serialize<Nongs>::toJson(*self);
-
-        std::ofstream output(path);
-        if (!output.is_open()) {
-            return Err(fmt::format("Couldn't open file: {}", path));
-        }
-
-        output << json.dump(matjson::NO_INDENTATION);
-        output.close();
-
+    geode::Result<> commit() {
+        host::queueSave(m_songID);
         return Ok();
     }
 
-    geode::Result<> canSetActive(const std::string& uniqueID,
+    geode::Result<> canSetActive(UniqueID uniqueID,
                                  std::filesystem::path path) {
         const bool IS_DEFAULT = uniqueID == m_default->metadata()->uniqueID;
 
@@ -338,166 +184,131 @@ public:
             return Ok();
         }
 
-        std::error_code ec;
-
-        if (!IS_DEFAULT && !std::filesystem::exists(path, ec)) {
+        if (!IS_DEFAULT && !host::fileExists(path)) {
             return Err("Song doesn't exist on disk");
         }
 
         return Ok();
     }
 
-    geode::Result<> setActive(const std::string& uniqueID, Nongs* self) {
-        if (auto song = this->getLocalFromID(uniqueID)) {
-            geode::Result<> res =
-                this->canSetActive(uniqueID, song.value()->path().value());
-            if (res.isErr()) {
-                return res;
-            }
-
-            m_active = song.value();
-
-            if (NongManager::get().initialized()) {
-                event::SongStateChanged(self).post();
-            }
+    geode::Result<> setActive(UniqueID uniqueID, Nongs* self) {
+        auto it = m_songsByID.find(uniqueID);
+        if (it == m_songsByID.end()) {
+            return Err("No song found with given path for song ID");
+        }
+        Song* song = it->second.song;
 
-            return Ok();
+        // Local songs always have a path
+        if (it->second.type != NongType::LOCAL && !song->path()) {
+            return Err("Song is not downloaded");
         }
+        GEODE_UNWRAP(this->canSetActive(uniqueID, song->path().value()));
 
-        if (auto song = this->getYTFromID(uniqueID)) {
-            if (!song.value()->path()) {
-                return Err("Song is not downloaded");
-            }
-            geode::Result<> res =
-                this->canSetActive(uniqueID, song.value()->path().value());
-            if (res.isErr()) {
-                return res;
-            }
+        m_active = song;
+        bumpPathGeneration();
 
-            m_active = song.value();
-            if (NongManager::get().initialized()) {
-                event::SongStateChanged(self).post();
-            }
-            return Ok();
-        }
+        host::activeChanged(self);
 
-        if (auto song = this->getHostedFromID(uniqueID)) {
-            if (!song.value()->path()) {
-                return Err("Song is not downloaded");
-            }
-            geode::Result<> res =
-                this->canSetActive(uniqueID, song.value()->path().value());
-            if (res.isErr()) {
-                return res;
-            }
+        return Ok();
+    }
 
-            m_active = song.value();
-            if (NongManager::get().initialized()) {
-                event::SongStateChanged(self).post();
+    // Moves the songs of another Impl over without copying them. Songs
+    // whose unique ID is already here are left behind, as is the other
+    // default song
+    template <class T>
+    void adopt(NongStore::Songs<T>& from, const Impl& source,
+               std::vector<Song*>& added) {
+        NongStore::Songs<T>& into = m_songs.of<T>();
+        into.reserve(into.size() + from.size());
+        for (std::unique_ptr<T>& song : from) {
+            if (song->path() == source.m_default->path() ||
+                this->canAdd(*song->metadata()).isErr()) {
+                continue;
             }
-            return Ok();
+            added.push_back(song.get());
+            this->indexSong(song.get());
+            into.push_back(std::move(song));
         }
-
-        return Err("No song found with given path for song ID");
+        from.clear();
     }
 
-    geode::Result<> merge(Nongs&& other) {
+    geode::Result<std::vector<Song*>> merge(Nongs&& other) {
         if (other.songID() != m_songID) {
             return Err("Merging with NONGs of a different song ID");
         }
 
-        for (const std::unique_ptr<LocalSong>& i : other.locals()) {
-            if (i->path() == other.defaultSong()->path()) {
-                continue;
-            }
-            m_locals.emplace_back(std::make_unique<LocalSong>(*i));
-        }
+        Impl& source = *other.m_impl;
+        std::vector<Song*> added;
+        added.reserve(source.m_songs.size());
+        source.m_songs.forEachKind(
+            [&](auto& from) { this->adopt(from, source, added); });
 
-        for (const auto& i : other.youtube()) {
-            m_youtube.emplace_back(std::make_unique<YTSong>(*i));
-        }
+        // Whatever is left of the source only has its default song now
+        source.m_songsByID.clear();
+        source.indexSong(source.m_default.get());
+        source.m_active = source.m_default.get();
 
-        for (const auto& i : other.hosted()) {
-            m_hosted.emplace_back(std::make_unique<HostedSong>(*i));
-        }
-
-        return Ok();
+        return Ok(std::move(added));
     }
 
     geode::Result<> deleteAllSongs() {
-        for (std::unique_ptr<LocalSong>& local : m_locals) {
-            this->deletePath(local->path());
-        }
-        m_locals.clear();
-
-        for (std::unique_ptr<YTSong>& youtube : m_youtube) {
-            this->deletePath(youtube->path());
+        // One batch of file removals and one event for the whole song ID
+        std::vector<std::filesystem::path> paths;
+        std::vector<UniqueID> uniqueIDs;
+        paths.reserve(m_songs.size());
+        uniqueIDs.reserve(m_songs.size());
+        m_songs.forEach([&paths, &uniqueIDs](auto& song) {
+            if (std::optional<std::filesystem::path> path = song.path()) {
+                paths.push_back(std::move(path.value()));
+            }
+            uniqueIDs.push_back(song.metadata()->uniqueID);
+        });
+        m_songs.clear();
+        if (!paths.empty()) {
+            host::removeSongFiles(std::move(paths));
         }
-        m_youtube.clear();
 
-        for (std::unique_ptr<HostedSong>& hosted : m_hosted) {
-            this->deletePath(hosted->path());
-        }
-        m_hosted.clear();
+        m_songsByID.clear();
+        this->indexSong(m_default.get());
 
         m_active = m_default.get();
+        bumpPathGeneration();
 
+        if (!uniqueIDs.empty()) {
+            host::songsCleared(std::move(uniqueIDs), m_songID);
+        }
         return Ok();
     }
 
-    geode::Result<> deleteSong(const std::string& uniqueID, bool audio,
+    geode::Result<> deleteSong(UniqueID uniqueID, bool audio,
                                Nongs* self) {
         if (m_default->metadata()->uniqueID == uniqueID) {
             return Err("Cannot delete default song");
         }
+        bumpPathGeneration();
 
         if (m_active->metadata()->uniqueID == uniqueID) {
             (void)this->setActive(m_default.get()->metadata()->uniqueID, self);
         }
 
-        for (auto i = m_locals.begin(); i != m_locals.end(); ++i) {
-            if ((*i)->metadata()->uniqueID == uniqueID) {
-                if (audio) {
-                    this->deletePath((*i)->path());
-                }
-                m_locals.erase(i);
-                if (NongManager::get().initialized()) {
-                    event::NongDeleted(uniqueID, m_songID).post();
-                }
-                return Ok();
-            }
+        auto it = m_songsByID.find(uniqueID);
+        if (it == m_songsByID.end()) {
+            return Err("No song found with given path for song ID");
         }
+        const SongSlot slot = it->second;
+        m_songsByID.erase(it);
 
-        for (auto i = m_youtube.begin(); i != m_youtube.end(); ++i) {
-            if ((*i)->metadata()->uniqueID == uniqueID) {
-                if (audio) {
-                    this->deletePath((*i)->path());
-                }
-                m_youtube.erase(i);
-                if (NongManager::get().initialized()) {
-                    event::NongDeleted(uniqueID, m_songID).post();
-                }
-                return Ok();
-            }
+        if (audio) {
+            this->deletePath(slot.song->path());
         }
 
-        for (auto i = m_hosted.begin(); i != m_hosted.end(); ++i) {
-            if ((*i)->metadata()->uniqueID == uniqueID) {
-                if (audio) {
-                    this->deletePath((*i)->path());
-                }
-                m_hosted.erase(i);
-                if (NongManager::get().initialized()) {
-                    event::NongDeleted(uniqueID, m_songID).post();
-                }
-                return Ok();
-            }
-        }
+        m_songs.erase(slot.song, slot.type);
 
-        return Err("No song found with given path for song ID");
+        host::songDeleted(uniqueID, m_songID);
+        return Ok();
     }
 
-    geode::Result<> deleteSongAudio(const std::string& uniqueID) {
+    geode::Result<> deleteSongAudio(UniqueID uniqueID) {
         if (m_default->metadata()->uniqueID == uniqueID) {
             return Err("Cannot delete audio of the default song");
         }
@@ -505,138 +316,37 @@ public:
         if (m_active->metadata()->uniqueID == uniqueID) {
             m_active = m_default.get();
         }
+        bumpPathGeneration();
 
-        for (auto i = m_locals.begin(); i != m_locals.end(); ++i) {
-            if ((*i)->metadata()->uniqueID == uniqueID) {
-                return Err("Cannot delete audio of local songs");
-                return Ok();
-            }
-        }
-
-        for (auto i = m_youtube.begin(); i != m_youtube.end(); ++i) {
-            if ((*i)->metadata()->uniqueID == uniqueID) {
-                this->deletePath((*i)->path());
-                return Ok();
-            }
-        }
-
-        for (auto i = m_hosted.begin(); i != m_hosted.end(); ++i) {
-            if ((*i)->metadata()->uniqueID == uniqueID) {
-                this->deletePath((*i)->path());
-                return Ok();
-            }
-        }
-
-        return Err("No song found with given path for song ID");
-    }
-
-    std::optional<LocalSong*> getLocalFromID(const std::string_view uniqueID) {
-        if (m_default->metadata()->uniqueID == uniqueID) {
-            return m_default.get();
+        auto it = m_songsByID.find(uniqueID);
+        if (it == m_songsByID.end()) {
+            return Err("No song found with given path for song ID");
         }
-
-        for (const std::unique_ptr<LocalSong>& i : m_locals) {
-            if (i->metadata()->uniqueID == uniqueID) {
-                return i.get();
-            }
+        if (it->second.type == NongType::LOCAL) {
+            return Err("Cannot delete audio of local songs");
         }
 
-        return std::nullopt;
+        this->deletePath(it->second.song->path());
+        return Ok();
     }
 
-    std::optional<YTSong*> getYTFromID(const std::string_view uniqueID) {
-        for (const std::unique_ptr<YTSong>& i : m_youtube) {
-            if (i->metadata()->uniqueID == uniqueID) {
-                return i.get();
-            }
+    template <class T>
+    std::optional<T*> getFromID(UniqueID uniqueID) {
+        if (Song* song = this->lookup(uniqueID, T::s_type)) {
+            return static_cast<T*>(song);
         }
-
         return std::nullopt;
     }
 
-    std::optional<HostedSong*> getHostedFromID(
-        const std::string_view uniqueID) {
-        for (const std::unique_ptr<HostedSong>& i : m_hosted) {
-            if (i->metadata()->uniqueID == uniqueID) {
-                return i.get();
-            }
+    std::optional<Song*> findSong(UniqueID uniqueID) const {
+        if (auto it = m_songsByID.find(uniqueID); it != m_songsByID.end()) {
+            return it->second.song;
         }
-
         return std::nullopt;
     }
 
-    std::optional<Song*> findSong(const std::string& uniqueID) const {
-        if (m_default->metadata()->uniqueID == uniqueID) {
-            return m_default.get();
-        }
-
-        for (const auto& i : m_locals) {
-            if (i->metadata()->uniqueID == uniqueID) {
-                return i.get();
-            }
-        }
-
-        for (const auto& i : m_youtube) {
-            if (i->metadata()->uniqueID == uniqueID) {
-                return i.get();
-            }
-        }
-
-        for (const auto& i : m_hosted) {
-            if (i->metadata()->uniqueID == uniqueID) {
-                return i.get();
-            }
-        }
-
-        return std::nullopt;
-    }
-
-    geode::Result<> replaceSong(const std::string& id, LocalSong&& song,
-                                Nongs* self) {
-        bool isActive = m_active->metadata()->uniqueID == id;
-        std::optional<Song*> opt = this->findSong(id);
-        if (!opt) {
-            return Err(fmt::format("NONG ID {} not found", id));
-        }
-        Song* prevNong = opt.value();
-        std::optional<std::filesystem::path> prevPath = prevNong->path();
-
-        bool deleteAudio = prevPath != song.path();
-        auto _ = this->deleteSong(id, deleteAudio, self);
-
-        GEODE_UNWRAP(this->add(std::move(song)));
-
-        if (isActive) {
-            (void)this->setActive(id, self);
-        }
-        return Ok();
-    }
-
-    geode::Result<> replaceSong(const std::string& id, YTSong&& song,
-                                Nongs* self) {
-        bool isActive = m_active->metadata()->uniqueID == id;
-        std::optional<Song*> opt = this->findSong(id);
-        if (!opt) {
-            return Err(fmt::format("NONG ID {} not found", id));
-        }
-        Song* prevNong = opt.value();
-        std::optional<std::filesystem::path> prevPath = prevNong->path();
-
-        bool deleteAudio = prevPath != song.path();
-        auto _ = this->deleteSong(id, deleteAudio, self);
-
-        YTSong* added = nullptr;
-
-        GEODE_UNWRAP_INTO(added, this->add(std::move(song)));
-
-        if (isActive && added->path().has_value()) {
-            auto _ = this->setActive(id, self);
-        }
-        return Ok();
-    }
-
-    geode::Result<> replaceSong(const std::string& id, HostedSong&& song,
-                                Nongs* self) {
+    template <class T>
+    geode::Result<> replaceSong(UniqueID id, T&& song, Nongs* self) {
         bool isActive = m_active->metadata()->uniqueID == id;
         std::optional<Song*> opt = this->findSong(id);
         if (!opt) {
@@ -648,58 +358,36 @@ public:
         bool deleteAudio = prevPath != song.path();
         auto _ = this->deleteSong(id, deleteAudio, self);
 
-        HostedSong* added = nullptr;
+        T* added = nullptr;
 
         GEODE_UNWRAP_INTO(added, this->add(std::move(song)));
 
+        // Local songs always have a path
         if (isActive && added->path().has_value()) {
             auto _ = this->setActive(id, self);
         }
         return Ok();
     }
 
-    Result<LocalSong*> add(LocalSong&& song) {
-        for (const std::unique_ptr<LocalSong>& i : m_locals) {
-            if (i->metadata() == song.metadata() && i->path() == song.path()) {
-                std::string err =
-                    fmt::format("Attempted to add a duplicate song for id {}",
-                                song.metadata()->gdID);
-                return Err(err);
-            }
-        }
+    template <class T>
+    Result<T*> add(T&& song) {
+        GEODE_UNWRAP(this->canAdd(*song.metadata()));
 
-        std::unique_ptr<LocalSong> ptr =
-            std::make_unique<LocalSong>(std::move(song));
-        LocalSong* ret = ptr.get();
-        m_locals.push_back(std::move(ptr));
+        T* ret = m_songs.add(std::move(song));
+        this->indexSong(ret);
 
         return Ok(ret);
     }
 
-    Result<YTSong*> add(YTSong&& song) {
-        auto s = std::make_unique<YTSong>(std::move(song));
-        auto ret = s.get();
-        m_youtube.push_back(std::move(s));
-
-        return Ok(ret);
-    }
-
-    Result<HostedSong*> add(HostedSong&& song) {
-        for (const std::unique_ptr<HostedSong>& i : m_hosted) {
-            if (i->url() == song.url() && i->metadata() == song.metadata()) {
-                std::string err =
-                    fmt::format("Attempted to add a duplicate song for id {}",
-                                song.metadata()->gdID);
-                return Err(err);
-            }
-        }
-
-        auto s = std::make_unique<HostedSong>(std::move(song));
-        HostedSong* ret = s.get();
-
-        m_hosted.push_back(std::move(s));
-
-        return Ok(ret);
+    std::size_t memoryUsage() {
+        std::size_t bytes = sizeof(Impl) + m_default->memoryUsage() +
+                            memory::heapBytes(m_indexSongs) +
+                            memory::heapBytes(m_songsByID);
+        m_songs.forEachKind([&bytes](auto& songs) {
+            bytes += memory::heapBytes(songs);
+        });
+        m_songs.forEach([&bytes](auto& song) { bytes += song.memoryUsage(); });
+        return bytes;
     }
 
     bool isDefaultActive() const {
@@ -716,14 +404,14 @@ public:
         }
 
         if (!hasSongID) {
-            return Err("Index song {} doesn't apply for ID {}", song->uniqueID,
-                       m_songID);
+            return Err(fmt::format("Index song {} doesn't apply for ID {}",
+                                   song->uniqueID, m_songID));
         }
 
         for (index::IndexSongMetadata* i : m_indexSongs) {
             if (i == song) {
-                return Err("Song {} already registered for ID {}",
-                           song->uniqueID, m_songID);
+                return Err(fmt::format("Song {} already registered for ID {}",
+                                       song->uniqueID, m_songID));
             }
         }
 
@@ -731,58 +419,159 @@ public:
         return Ok();
     }
 
+    void registerIndexSongs(std::span<index::IndexSongMetadata* const> songs) {
+        if (m_indexSongs.empty()) {
+            m_indexSongs.assign(songs.begin(), songs.end());
+            return;
+        }
+
+        std::unordered_set<index::IndexSongMetadata*> registered(
+            m_indexSongs.begin(), m_indexSongs.end());
+        m_indexSongs.reserve(m_indexSongs.size() + songs.size());
+        for (index::IndexSongMetadata* song : songs) {
+            if (registered.insert(song).second) {
+                m_indexSongs.push_back(song);
+            }
+        }
+    }
+
     int songID() const { return m_songID; }
     LocalSong* defaultSong() const { return m_default.get(); }
     Song* active() const { return m_active; }
-    std::vector<std::unique_ptr<LocalSong>>& locals() { return m_locals; }
-    std::vector<std::unique_ptr<YTSong>>& youtube() { return m_youtube; }
-    std::vector<std::unique_ptr<HostedSong>>& hosted() { return m_hosted; }
+    NongStore& songs() { return m_songs; }
 };
 
 Nongs::Nongs(int songID, LocalSong&& defaultSong)
     : m_impl(std::make_unique<Impl>(
-          songID, std::make_unique<LocalSong>(defaultSong))) {}
-Nongs::Nongs(int songID) : m_impl(std::make_unique<Impl>(songID)) {}
+          songID, std::make_unique<LocalSong>(std::move(defaultSong)))) {
+    this->refreshActiveSummary();
+}
+Nongs::Nongs(int songID) : m_impl(std::make_unique<Impl>(songID)) {
+    this->refreshActiveSummary();
+}
+
+void Nongs::refreshActiveSummary() {
+    Song* active = m_impl->active();
+    SongMetadata* metadata = active->metadata();
+    m_summary.startOffset = metadata->startOffset;
+    if (m_summary.generation != 0 && m_summary.song == active &&
+        m_summary.name == metadata->name &&
+        m_summary.artist == metadata->artist) {
+        return;
+    }
+    m_summary.song = active;
+    m_summary.name = metadata->name;
+    m_summary.artist = metadata->artist;
+    m_summary.generation =
+        s_summaryGeneration.fetch_add(1, std::memory_order_relaxed);
+}
 
-std::optional<Song*> Nongs::findSong(const std::string& uniqueID) {
+const host::GameString* Nongs::playablePath() {
+    const std::uint32_t generation =
+        s_pathGeneration.load(std::memory_order_relaxed);
+
+    // The clock is only read for files nothing watches
+    if (m_playablePath.generation == generation &&
+        m_playablePath.song == m_summary.song &&
+        (m_playablePath.watched ||
+         std::chrono::steady_clock::now() - m_playablePath.checkedAt <
+             s_playablePathTTL)) {
+        return m_playablePath.path ? &m_playablePath.path.value() : nullptr;
+    }
+
+    m_playablePath.generation = generation;
+    m_playablePath.song = m_summary.song;
+    m_playablePath.path = std::nullopt;
+
+    std::optional<std::filesystem::path> path = m_summary.song->path();
+    // Without a path there's no file to appear or go away
+    m_playablePath.watched =
+        !path.has_value() || host::fileWatched(path.value());
+    if (!m_playablePath.watched) {
+        m_playablePath.checkedAt = std::chrono::steady_clock::now();
+    }
+    if (path.has_value() && host::fileExists(path.value())) {
+        const std::u8string utf8 = path.value().u8string();
+        m_playablePath.path = host::GameString(
+            reinterpret_cast<const char*>(utf8.data()), utf8.size());
+    }
+
+    return m_playablePath.path ? &m_playablePath.path.value() : nullptr;
+}
+
+std::optional<Song*> Nongs::findSong(UniqueID uniqueID) {
     return m_impl->findSong(uniqueID);
 }
-Result<> Nongs::commit() { return m_impl->commit(this); }
-geode::Result<> Nongs::replaceSong(const std::string& id, LocalSong&& song) {
-    return m_impl->replaceSong(id, std::move(song), this);
+Result<> Nongs::commit() { return m_impl->commit(); }
+geode::Result<> Nongs::replaceSong(UniqueID id, LocalSong&& song) {
+    Result<> res = m_impl->replaceSong(id, std::move(song), this);
+    this->refreshActiveSummary();
+    return res;
 }
-geode::Result<> Nongs::replaceSong(const std::string& id, YTSong&& song) {
-    return m_impl->replaceSong(id, std::move(song), this);
+geode::Result<> Nongs::replaceSong(UniqueID id, YTSong&& song) {
+    Result<> res = m_impl->replaceSong(id, std::move(song), this);
+    this->refreshActiveSummary();
+    return res;
 }
-geode::Result<> Nongs::replaceSong(const std::string& id, HostedSong&& song) {
-    return m_impl->replaceSong(id, std::move(song), this);
+geode::Result<> Nongs::replaceSong(UniqueID id, HostedSong&& song) {
+    Result<> res = m_impl->replaceSong(id, std::move(song), this);
+    this->refreshActiveSummary();
+    return res;
 }
 geode::Result<> Nongs::registerIndexSong(index::IndexSongMetadata* song) {
     return m_impl->registerIndexSong(song);
 }
+void Nongs::registerIndexSongs(
+    std::span<index::IndexSongMetadata* const> songs) {
+    m_impl->registerIndexSongs(songs);
+}
+void Nongs::setIndexSongs(std::span<index::IndexSongMetadata* const> songs) {
+    m_impl->m_indexSongs.assign(songs.begin(), songs.end());
+}
 bool Nongs::isDefaultActive() const { return m_impl->isDefaultActive(); }
+std::size_t Nongs::memoryUsage() const {
+    return sizeof(Nongs) + m_impl->memoryUsage() +
+           memory::heapBytes(m_summary.name) +
+           memory::heapBytes(m_summary.artist) +
+           (m_playablePath.path ? m_playablePath.path->size() + 1 : 0);
+}
 int Nongs::songID() const { return m_impl->songID(); }
 LocalSong* Nongs::defaultSong() const { return m_impl->defaultSong(); }
-Song* Nongs::active() const { return m_impl->active(); }
-Result<> Nongs::setActive(const std::string& uniqueID) {
-    return m_impl->setActive(uniqueID, this);
+void Nongs::invalidatePlayablePaths() { bumpPathGeneration(); }
+Result<> Nongs::setActive(UniqueID uniqueID) {
+    Result<> res = m_impl->setActive(uniqueID, this);
+    this->refreshActiveSummary();
+    return res;
+}
+Result<std::vector<Song*>> Nongs::merge(Nongs&& other) {
+    Result<std::vector<Song*>> res = m_impl->merge(std::move(other));
+    other.refreshActiveSummary();
+    return res;
+}
+Result<> Nongs::deleteAllSongs() {
+    Result<> res = m_impl->deleteAllSongs();
+    this->refreshActiveSummary();
+    return res;
 }
-Result<> Nongs::merge(Nongs&& other) { return m_impl->merge(std::move(other)); }
-Result<> Nongs::deleteAllSongs() { return m_impl->deleteAllSongs(); }
-Result<> Nongs::deleteSong(const std::string& uniqueID, bool audio) {
-    return m_impl->deleteSong(uniqueID, audio, this);
+Result<> Nongs::deleteSong(UniqueID uniqueID, bool audio) {
+    Result<> res = m_impl->deleteSong(uniqueID, audio, this);
+    this->refreshActiveSummary();
+    return res;
 }
-Result<> Nongs::deleteSongAudio(const std::string& uniqueID) {
-    return m_impl->deleteSongAudio(uniqueID);
+Result<> Nongs::deleteSongAudio(UniqueID uniqueID) {
+    Result<> res = m_impl->deleteSongAudio(uniqueID);
+    this->refreshActiveSummary();
+    return res;
 }
+NongStore& Nongs::songs() const { return m_impl->songs(); }
 std::vector<std::unique_ptr<LocalSong>>& Nongs::locals() const {
-    return m_impl->locals();
+    return m_impl->songs().of<LocalSong>();
 }
 std::vector<std::unique_ptr<YTSong>>& Nongs::youtube() const {
-    return m_impl->youtube();
+    return m_impl->songs().of<YTSong>();
 }
 std::vector<std::unique_ptr<HostedSong>>& Nongs::hosted() const {
-    return m_impl->hosted();
+    return m_impl->songs().of<HostedSong>();
 }
 std::vector<index::IndexSongMetadata*>& Nongs::indexSongs() const {
     return m_impl->m_indexSongs;
@@ -797,9 +586,14 @@ geode::Result<HostedSong*> Nongs::add(HostedSong&& song) {
     return m_impl->add(std::move(song));
 }
 
-Nongs::Nongs(Nongs&& other) : m_impl(std::move(other.m_impl)) {}
+Nongs::Nongs(Nongs&& other)
+    : m_impl(std::move(other.m_impl)),
+      m_summary(std::move(other.m_summary)),
+      m_playablePath(std::move(other.m_playablePath)) {}
 Nongs& Nongs::operator=(Nongs&& other) {
     m_impl = std::move(other.m_impl);
+    m_summary = std::move(other.m_summary);
+    m_playablePath = std::move(other.m_playablePath);
     return *this;
 }
 
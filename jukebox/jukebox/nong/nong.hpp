@@ -1,39 +1,47 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <fmt/core.h>
 #include <Geode/Result.hpp>
-#include <Geode/binding/SongInfoObject.hpp>
-#include <Geode/utils/Task.hpp>
-#include <Geode/utils/general.hpp>
 #include <matjson.hpp>
 
+#include <jukebox/host/host.hpp>
 #include <jukebox/nong/index.hpp>
+#include <jukebox/nong/song_store.hpp>
+#include <jukebox/utils/flat_int_map.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
 struct SongMetadata final {
     int gdID;
-    std::string uniqueID;
+    UniqueID uniqueID;
     std::string name;
     std::string artist;
     std::optional<std::string> level;
     int startOffset;
 
-    SongMetadata(int gdID, std::string uniqueID, std::string name,
+    SongMetadata(int gdID, UniqueID uniqueID, std::string name,
                  std::string artist,
                  std::optional<std::string> level = std::nullopt,
                  int offset = 0)
         : gdID(gdID),
-          uniqueID(uniqueID),
-          name(name),
-          artist(artist),
-          level(level),
+          uniqueID(std::move(uniqueID)),
+          name(std::move(name)),
+          artist(std::move(artist)),
+          level(std::move(level)),
           startOffset(offset) {}
 
     bool operator==(const SongMetadata& other) const {
@@ -57,99 +65,144 @@ public:
     virtual void setPath(std::filesystem::path p) = 0;
 };
 
+// Songs keep their metadata and fields inline, so a song is a single
+// allocation and copying or moving one is a plain member-wise copy or move
 class LocalSong final : public Song {
 private:
-    class Impl;
-
-    std::unique_ptr<Impl> m_impl;
+    // Song::metadata() hands out a mutable pointer from a const song
+    mutable SongMetadata m_metadata;
+    std::filesystem::path m_path;
 
 public:
-    LocalSong(SongMetadata&& metadata, const std::filesystem::path& path);
+    LocalSong(SongMetadata&& metadata, std::filesystem::path path);
 
-    LocalSong(const LocalSong& other);
-    LocalSong& operator=(const LocalSong& other);
+    LocalSong(const LocalSong& other) = default;
+    LocalSong& operator=(const LocalSong& other) = default;
 
-    LocalSong(LocalSong&& other);
-    LocalSong& operator=(LocalSong&& other);
+    LocalSong(LocalSong&& other) noexcept = default;
+    LocalSong& operator=(LocalSong&& other) noexcept = default;
 
-    ~LocalSong();
+    ~LocalSong() = default;
 
-    NongType type() const { return NongType::LOCAL; };
-    SongMetadata* metadata() const;
-    std::optional<std::filesystem::path> path() const;
+    constexpr static inline NongType s_type = NongType::LOCAL;
+
+    NongType type() const { return s_type; }
+    SongMetadata* metadata() const { return &m_metadata; }
+    std::optional<std::filesystem::path> path() const { return m_path; }
     void setPath(std::filesystem::path p);
     std::optional<std::string> indexID() const { return std::nullopt; }
     void setIndexID(const std::string& id) {}
+    // Estimated bytes of the song and what it owns on the heap
+    std::size_t memoryUsage() const;
 
     static LocalSong createUnknown(int songID);
-    static LocalSong fromSongObject(SongInfoObject* obj);
 };
 
 class YTSong final : public Song {
 private:
-    class Impl;
-
-    std::unique_ptr<Impl> m_impl;
+    mutable SongMetadata m_metadata;
+    std::string m_youtubeID;
+    std::optional<std::string> m_indexID;
+    std::optional<std::filesystem::path> m_path;
 
 public:
     YTSong(SongMetadata&& metadata, std::string youtubeID,
            std::optional<std::string> m_indexID,
            std::optional<std::filesystem::path> path = std::nullopt);
-    YTSong(const YTSong& other);
-    YTSong& operator=(const YTSong& other);
+    YTSong(const YTSong& other) = default;
+    YTSong& operator=(const YTSong& other) = default;
+
+    YTSong(YTSong&& other) noexcept = default;
+    YTSong& operator=(YTSong&& other) noexcept = default;
 
-    YTSong(YTSong&& other);
-    YTSong& operator=(YTSong&& other);
+    ~YTSong() = default;
 
-    ~YTSong();
+    constexpr static inline NongType s_type = NongType::YOUTUBE;
 
-    NongType type() const { return NongType::YOUTUBE; };
-    SongMetadata* metadata() const;
-    std::string youtubeID() const;
-    std::optional<std::string> indexID() const;
-    void setIndexID(const std::string& id);
-    std::optional<std::filesystem::path> path() const;
+    NongType type() const { return s_type; }
+    SongMetadata* metadata() const { return &m_metadata; }
+    std::string youtubeID() const { return m_youtubeID; }
+    std::optional<std::string> indexID() const { return m_indexID; }
+    void setIndexID(const std::string& id) { m_indexID = id; }
+    std::optional<std::filesystem::path> path() const { return m_path; }
     void setPath(std::filesystem::path p);
-    geode::Result<geode::Task<geode::Result<geode::ByteVector>, float>>
-    startDownload();
+    std::size_t memoryUsage() const;
 };
 
 class HostedSong final : public Song {
 private:
-    class Impl;
-
-    std::unique_ptr<Impl> m_impl;
+    mutable SongMetadata m_metadata;
+    std::string m_url;
+    std::optional<std::string> m_indexID;
+    std::optional<std::filesystem::path> m_path;
 
 public:
     HostedSong(SongMetadata&& metadata, std::string url,
                std::optional<std::string> m_indexID,
                std::optional<std::filesystem::path> path = std::nullopt);
-    HostedSong(const HostedSong& other);
-    HostedSong& operator=(const HostedSong& other);
+    HostedSong(const HostedSong& other) = default;
+    HostedSong& operator=(const HostedSong& other) = default;
+
+    HostedSong(HostedSong&& other) noexcept = default;
+    HostedSong& operator=(HostedSong&& other) noexcept = default;
 
-    HostedSong(HostedSong&& other);
-    HostedSong& operator=(HostedSong&& other);
+    ~HostedSong() = default;
 
-    ~HostedSong();
+    constexpr static inline NongType s_type = NongType::HOSTED;
 
-    NongType type() const { return NongType::HOSTED; };
-    SongMetadata* metadata() const;
-    std::string url() const;
-    std::optional<std::string> indexID() const;
-    void setIndexID(const std::string& id);
-    std::optional<std::filesystem::path> path() const;
+    NongType type() const { return s_type; }
+    SongMetadata* metadata() const { return &m_metadata; }
+    std::string url() const { return m_url; }
+    std::optional<std::string> indexID() const { return m_indexID; }
+    void setIndexID(const std::string& id) { m_indexID = id; }
+    std::optional<std::filesystem::path> path() const { return m_path; }
     void setPath(std::filesystem::path p);
-    geode::Result<geode::Task<geode::Result<geode::ByteVector>, float>>
-    startDownload();
+    std::size_t memoryUsage() const;
 };
 
+// Every song of a song ID but its default one, by kind
+using NongStore = SongStore<LocalSong, YTSong, HostedSong>;
+
 class Nongs final {
+public:
+    /**
+     * What GD shows for the active song
+     */
+    struct ActiveSummary {
+        Song* song = nullptr;
+        std::string name;
+        std::string artist;
+        int startOffset = 0;
+        // Changes whenever song, name or artist do, and is never the same
+        // for two song IDs. 0 before the first refresh.
+        std::uint64_t generation = 0;
+    };
+
 private:
     class Impl;
 
+    struct PlayablePath {
+        std::uint32_t generation = 0;
+        Song* song = nullptr;
+        // Files outside the watched directories are checked again after
+        // s_playablePathTTL, changes to them aren't reported
+        bool watched = false;
+        std::chrono::steady_clock::time_point checkedAt;
+        // UTF-8, as GD expects it
+        std::optional<host::GameString> path;
+    };
+
     std::unique_ptr<Impl> m_impl;
+    // Kept here rather than behind m_impl, so level lists and audio hooks
+    // read the active song without chasing its pointers
+    ActiveSummary m_summary;
+    PlayablePath m_playablePath;
 
 public:
+    // How long a playable path outside the watched directories is trusted
+    // before the file is checked again
+    constexpr static inline std::chrono::seconds s_playablePathTTL{2};
+
     Nongs(int songID, LocalSong&& defaultSong);
     Nongs(int songID);
 
@@ -164,23 +217,60 @@ public:
 
     int songID() const;
     LocalSong* defaultSong() const;
-    Song* active() const;
+    Song* active() const { return m_summary.song; }
+    const ActiveSummary& activeSummary() const { return m_summary; }
+    /**
+     * Copies the details of the active song into its summary again. Done
+     * automatically when the active song changes, call it after editing the
+     * metadata of the active song in place.
+     */
+    void refreshActiveSummary();
 
     bool isDefaultActive() const;
 
+    /**
+     * Estimated bytes held by these NONGs, their songs and lookup tables
+     */
+    std::size_t memoryUsage() const;
+
+    /**
+     * Path of the active song as GD expects it, or nullptr if the active song
+     * isn't on disk. The result is cached until the active song or any song
+     * path changes, or the file status cache sees a song file change, so
+     * hooks GD calls all the time get it without allocating. Files nothing
+     * watches are checked again after s_playablePathTTL.
+     */
+    const host::GameString* playablePath();
+    /**
+     * Forces every cached playable path to be resolved again
+     */
+    static void invalidatePlayablePaths();
+
+    /**
+     * Queues this song's NONGs to be written to disk. The write happens in the
+     * background, batched with other pending commits.
+     */
     geode::Result<> commit();
     /**
      * Returns Err if there is no NONG with the given path for the song ID
      * Otherwise, returns ok
      */
-    geode::Result<> setActive(const std::string& uniqueID);
-    geode::Result<> merge(Nongs&&);
+    geode::Result<> setActive(UniqueID uniqueID);
+    /**
+     * Moves the songs of other into these NONGs, skipping songs whose unique
+     * ID is already here. other is left with only its default song.
+     * @returns the songs that were added
+     */
+    geode::Result<std::vector<Song*>> merge(Nongs&& other);
     // Remove all custom nongs and set the default song as active
     geode::Result<> deleteAllSongs();
-    geode::Result<> deleteSong(const std::string& uniqueID, bool audio = true);
-    geode::Result<> deleteSongAudio(const std::string& uniqueID);
-    std::optional<Song*> findSong(const std::string& uniqueID);
+    geode::Result<> deleteSong(UniqueID uniqueID, bool audio = true);
+    geode::Result<> deleteSongAudio(UniqueID uniqueID);
+    std::optional<Song*> findSong(UniqueID uniqueID);
 
+    // Songs are looked up by their unique ID through an index kept by add()
+    // and deleteSong(), so only mutate these through them
+    NongStore& songs() const;
     std::vector<std::unique_ptr<LocalSong>>& locals() const;
     std::vector<std::unique_ptr<YTSong>>& youtube() const;
     std::vector<std::unique_ptr<HostedSong>>& hosted() const;
@@ -189,11 +279,20 @@ public:
     geode::Result<LocalSong*> add(LocalSong&& song);
     geode::Result<YTSong*> add(YTSong&& song);
     geode::Result<HostedSong*> add(HostedSong&& song);
-    geode::Result<> replaceSong(const std::string& id, LocalSong&& song);
-    geode::Result<> replaceSong(const std::string& id, YTSong&& song);
-    geode::Result<> replaceSong(const std::string& id, HostedSong&& song);
+    geode::Result<> replaceSong(UniqueID id, LocalSong&& song);
+    geode::Result<> replaceSong(UniqueID id, YTSong&& song);
+    geode::Result<> replaceSong(UniqueID id, HostedSong&& song);
 
     geode::Result<> registerIndexSong(index::IndexSongMetadata* song);
+    /**
+     * Appends index songs of this song ID, skipping the ones already
+     * registered
+     */
+    void registerIndexSongs(std::span<index::IndexSongMetadata* const> songs);
+    /**
+     * Replaces the index songs with songs, in one assignment
+     */
+    void setIndexSongs(std::span<index::IndexSongMetadata* const> songs);
 };
 
 class Manifest {
@@ -201,7 +300,7 @@ class Manifest {
 
 private:
     int m_version = s_latestVersion;
-    std::unordered_map<int, std::unique_ptr<Nongs>> m_nongs = {};
+    FlatIntMap<std::unique_ptr<Nongs>> m_nongs;
 
 public:
     constexpr static inline int s_latestVersion = 4;
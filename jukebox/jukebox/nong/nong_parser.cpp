@@ -0,0 +1,118 @@
+#include <jukebox/nong/nong_parser.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/host/host.hpp>
+#include <jukebox/nong/nong.hpp>
+#include <jukebox/nong/nong_serialize.hpp>
+#include <jukebox/utils/json_reader.hpp>
+
+using namespace geode;
+
+namespace jukebox {
+
+Result<Nongs> parseNongs(std::string_view text, int songID,
+                         std::vector<std::string>* warnings) {
+    auto warn = [warnings](std::string message) {
+        if (warnings) {
+            warnings->push_back(std::move(message));
+        } else {
+            host::logError(message);
+        }
+    };
+
+    // Songs are kept until the end, the default song may come after them
+    std::optional<LocalSong> defaultSong;
+    std::optional<std::string> active;
+    std::vector<LocalSong> locals;
+    std::vector<YTSong> youtube;
+    std::vector<HostedSong> hosted;
+
+    JsonReader reader(text);
+    auto readSongs = [&]<class T>(std::vector<T>& destination,
+                                  std::string_view kind) -> Result<> {
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (type != JsonReader::Type::Array) {
+            return reader.skip();
+        }
+        return reader.readArray([&]() -> Result<> {
+            GEODE_UNWRAP_INTO(matjson::Value value, reader.readValue());
+            Result<T> res = matjson::Serialize<T>::fromJson(value, songID);
+            if (res.isErr()) {
+                warn(fmt::format("Failed to load {} song: {}", kind,
+                                 res.unwrapErr()));
+                return Ok();
+            }
+            destination.push_back(std::move(res.unwrap()));
+            return Ok();
+        });
+    };
+
+    GEODE_UNWRAP(reader.readObject([&](std::string_view key) -> Result<> {
+        GEODE_UNWRAP_INTO(JsonReader::Type type, reader.peek());
+        if (key == "default" && type == JsonReader::Type::Object) {
+            GEODE_UNWRAP_INTO(matjson::Value value, reader.readValue());
+            GEODE_UNWRAP_INTO(
+                defaultSong,
+                matjson::Serialize<LocalSong>::fromJson(value, songID)
+                    .mapErr([songID](std::string err) {
+                        return fmt::format(
+                            "Failed to parse default song for ID {}", songID);
+                    }));
+            return Ok();
+        }
+        if (key == "active" && type == JsonReader::Type::String) {
+            GEODE_UNWRAP_INTO(std::string_view id, reader.readString());
+            active = std::string(id);
+            return Ok();
+        }
+        if (key == "locals") {
+            return readSongs(locals, "local");
+        }
+        if (key == "youtube") {
+            return readSongs(youtube, "YouTube");
+        }
+        if (key == "hosted") {
+            return readSongs(hosted, "hosted");
+        }
+        return reader.skip();
+    }));
+    GEODE_UNWRAP(reader.finish());
+
+    if (!defaultSong.has_value()) {
+        return Err(fmt::format("Invalid nongs object for id {}", songID));
+    }
+
+    Nongs nongs = {songID, std::move(defaultSong.value())};
+
+    auto addSongs = [&](auto& songs, std::string_view kind) {
+        for (auto& song : songs) {
+            if (auto added = nongs.add(std::move(song)); added.isErr()) {
+                warn(fmt::format("Failed to add {} song: {}", kind,
+                                 added.unwrapErr()));
+            }
+        }
+    };
+    addSongs(locals, "local");
+    addSongs(youtube, "YouTube");
+    addSongs(hosted, "hosted");
+
+    std::optional<UniqueID> activeID =
+        active.has_value() ? UniqueID::find(active.value()) : std::nullopt;
+    if (!activeID.has_value() || nongs.setActive(activeID.value()).isErr()) {
+        // This can't fail
+        (void)nongs.setActive(nongs.defaultSong()->metadata()->uniqueID);
+    }
+
+    return Ok(std::move(nongs));
+}
+
+}  // namespace jukebox
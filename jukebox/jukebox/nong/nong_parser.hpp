@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+#include <jukebox/nong/nong.hpp>
+
+namespace jukebox {
+
+/**
+ * Builds the NONGs of a song ID straight from the JSON text of its manifest
+ * file, same as matjson::Serialize<Nongs>::fromJson. Only one song at a time
+ * is held as a matjson::Value, never the whole file.
+ *
+ * Entries that fail to parse are skipped. Their errors are logged, or
+ * appended to warnings if given.
+ */
+geode::Result<Nongs> parseNongs(std::string_view text, int songID,
+                                std::vector<std::string>* warnings = nullptr);
+
+}  // namespace jukebox
@@ -5,12 +5,16 @@
 #include <matjson.hpp>
 #include <memory>
 #include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <Geode/Result.hpp>
-#include <Geode/loader/Log.hpp>
-#include <Geode/utils/file.hpp>  // IWYU pragma: keep
 
+#include <jukebox/host/host.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/path_json.hpp>
 
 template <>
 struct matjson::Serialize<jukebox::SongMetadata> {
@@ -27,7 +31,7 @@ struct matjson::Serialize<jukebox::SongMetadata> {
         }
 
         return geode::Ok(jukebox::SongMetadata{
-            songID, value["unique_id"].asString().unwrap(),
+            songID, jukebox::UniqueID(value["unique_id"].asString().unwrap()),
             value["name"].asString().unwrap(),
             value["artist"].asString().unwrap(),
             value["level"]
@@ -52,8 +56,9 @@ struct matjson::Serialize<jukebox::LocalSong> {
                 }));
 
         if (!value["path"].isString()) {
-            return geode::Err("Local Song {} is invalid. Reason: invalid path",
-                              value.dump(matjson::NO_INDENTATION));
+            return geode::Err(
+                fmt::format("Local Song {} is invalid. Reason: invalid path",
+                            value.dump(matjson::NO_INDENTATION)));
         }
 
         GEODE_UNWRAP_INTO(std::filesystem::path path,
@@ -65,7 +70,7 @@ struct matjson::Serialize<jukebox::LocalSong> {
     static matjson::Value toJson(const jukebox::LocalSong& value) {
         matjson::Value ret = matjson::makeObject({
             {"name", value.metadata()->name},
-            {"unique_id", value.metadata()->uniqueID},
+            {"unique_id", value.metadata()->uniqueID.str()},
             {"artist", value.metadata()->artist},
             {"path", value.path().value()},
             {"offset", value.metadata()->startOffset},
@@ -91,15 +96,15 @@ struct matjson::Serialize<jukebox::YTSong> {
                 }));
 
         if (!value["path"].isString()) {
-            return geode::Err(
+            return geode::Err(fmt::format(
                 "YouTube song {} is invalid. Reason: invalid path",
-                value.dump(matjson::NO_INDENTATION));
+                value.dump(matjson::NO_INDENTATION)));
         }
 
         if (!value["youtube_id"].isString()) {
-            return geode::Err(
+            return geode::Err(fmt::format(
                 "YouTube song {} is invalid. Reason: invalid youtube ID",
-                value.dump(matjson::NO_INDENTATION));
+                value.dump(matjson::NO_INDENTATION)));
         }
 
         GEODE_UNWRAP_INTO(std::filesystem::path path,
@@ -115,13 +120,13 @@ struct matjson::Serialize<jukebox::YTSong> {
     }
 
     static matjson::Value toJson(const jukebox::YTSong& value) {
-        matjson::Value ret =
-            matjson::makeObject({{"name", value.metadata()->name},
-                                 {"unique_id", value.metadata()->uniqueID},
-                                 {"artist", value.metadata()->artist},
-                                 {"path", value.path().value()},
-                                 {"offset", value.metadata()->startOffset},
-                                 {"youtube_id", value.youtubeID()}});
+        matjson::Value ret = matjson::makeObject(
+            {{"name", value.metadata()->name},
+             {"unique_id", value.metadata()->uniqueID.str()},
+             {"artist", value.metadata()->artist},
+             {"path", value.path().value()},
+             {"offset", value.metadata()->startOffset},
+             {"youtube_id", value.youtubeID()}});
         if (value.indexID().has_value()) {
             ret["index_id"] = value.indexID().value();
         }
@@ -147,13 +152,15 @@ struct matjson::Serialize<jukebox::HostedSong> {
                 }));
 
         if (!value["path"].isString()) {
-            return geode::Err("Hosted song {} is invalid. Reason: invalid path",
-                              value.dump(matjson::NO_INDENTATION));
+            return geode::Err(
+                fmt::format("Hosted song {} is invalid. Reason: invalid path",
+                            value.dump(matjson::NO_INDENTATION)));
         }
 
         if (!value["url"].isString()) {
-            return geode::Err("Hosted song {} is invalid. Reason: invalid url",
-                              value.dump(matjson::NO_INDENTATION));
+            return geode::Err(
+                fmt::format("Hosted song {} is invalid. Reason: invalid url",
+                            value.dump(matjson::NO_INDENTATION)));
         }
 
         GEODE_UNWRAP_INTO(std::filesystem::path path,
@@ -169,13 +176,13 @@ struct matjson::Serialize<jukebox::HostedSong> {
     }
 
     static matjson::Value toJson(const jukebox::HostedSong& value) {
-        matjson::Value ret =
-            matjson::makeObject({{"name", value.metadata()->name},
-                                 {"unique_id", value.metadata()->uniqueID},
-                                 {"artist", value.metadata()->artist},
-                                 {"path", value.path().value()},
-                                 {"offset", value.metadata()->startOffset},
-                                 {"url", value.url()}});
+        matjson::Value ret = matjson::makeObject(
+            {{"name", value.metadata()->name},
+             {"unique_id", value.metadata()->uniqueID.str()},
+             {"artist", value.metadata()->artist},
+             {"path", value.path().value()},
+             {"offset", value.metadata()->startOffset},
+             {"url", value.url()}});
         if (value.indexID().has_value()) {
             ret["index_id"] = value.indexID().value();
         }
@@ -195,43 +202,55 @@ struct matjson::Serialize<jukebox::Nongs> {
         ret["default"] = matjson::Serialize<jukebox::LocalSong>::toJson(
             *value.defaultSong());
 
-        ret["active"] = value.active()->metadata()->uniqueID;
+        ret["active"] = value.active()->metadata()->uniqueID.str();
 
         matjson::Value locals = matjson::Value::array();
+        matjson::Value youtubes = matjson::Value::array();
+        matjson::Value hosteds = matjson::Value::array();
 
-        for (std::unique_ptr<jukebox::LocalSong>& local : value.locals()) {
-            locals.push(matjson::Serialize<jukebox::LocalSong>::toJson(*local));
-        }
+        value.songs().forEach([&](auto& song) {
+            using T = std::decay_t<decltype(song)>;
+            if constexpr (std::is_same_v<T, jukebox::LocalSong>) {
+                locals.push(matjson::Serialize<T>::toJson(song));
+                return;
+            }
+            // Songs that haven't been downloaded yet aren't kept
+            if (!song.path().has_value()) {
+                return;
+            }
+            if constexpr (std::is_same_v<T, jukebox::YTSong>) {
+                youtubes.push(matjson::Serialize<T>::toJson(song));
+            } else {
+                hosteds.push(matjson::Serialize<T>::toJson(song));
+            }
+        });
 
         ret["locals"] = locals;
-
-        matjson::Value youtubes = matjson::Value::array();
-        for (std::unique_ptr<jukebox::YTSong>& youtube : value.youtube()) {
-            if (!youtube->path().has_value()) {
-                continue;
-            }
-            youtubes.push(
-                matjson::Serialize<jukebox::YTSong>::toJson(*youtube));
-        }
         ret["youtube"] = youtubes;
-
-        matjson::Value hosteds = matjson::Value::array();
-        for (std::unique_ptr<jukebox::HostedSong>& hosted : value.hosted()) {
-            if (!hosted->path().has_value()) {
-                continue;
-            }
-            hosteds.push(
-                matjson::Serialize<jukebox::HostedSong>::toJson(*hosted));
-        }
         ret["hosted"] = hosteds;
 
         return ret;
     }
 
-    static geode::Result<jukebox::Nongs> fromJson(const matjson::Value& value,
-                                                  int songID) {
+    /**
+     * Entries that fail to parse are skipped. Their errors are logged, or
+     * appended to warnings if given, so callers on other threads can log them
+     * in a stable order.
+     */
+    static geode::Result<jukebox::Nongs> fromJson(
+        const matjson::Value& value, int songID,
+        std::vector<std::string>* warnings = nullptr) {
+        auto warn = [warnings](std::string message) {
+            if (warnings) {
+                warnings->push_back(std::move(message));
+            } else {
+                jukebox::host::logError(message);
+            }
+        };
+
         if (!value["default"].isObject()) {
-            return geode::Err("Invalid nongs object for id {}", songID);
+            return geode::Err(
+                fmt::format("Invalid nongs object for id {}", songID));
         }
 
         GEODE_UNWRAP_INTO(jukebox::LocalSong defaultSong,
@@ -252,13 +271,16 @@ struct matjson::Serialize<jukebox::Nongs> {
                                                                      songID);
 
                 if (res.isErr()) {
-                    geode::log::error("Failed to load local song: {}",
-                                      res.unwrapErr());
+                    warn(fmt::format("Failed to load local song: {}",
+                                     res.unwrapErr()));
                     continue;
                 }
 
-                nongs.locals().push_back(
-                    std::make_unique<jukebox::LocalSong>(res.unwrap()));
+                if (auto added = nongs.add(std::move(res.unwrap()));
+                    added.isErr()) {
+                    warn(fmt::format("Failed to add local song: {}",
+                                     added.unwrapErr()));
+                }
             }
         }
 
@@ -268,13 +290,16 @@ struct matjson::Serialize<jukebox::Nongs> {
                     matjson::Serialize<jukebox::YTSong>::fromJson(yt, songID);
 
                 if (res.isErr()) {
-                    geode::log::error("Failed to load YouTube song: {}",
-                                      res.unwrapErr());
+                    warn(fmt::format("Failed to load YouTube song: {}",
+                                     res.unwrapErr()));
                     continue;
                 }
 
-                nongs.youtube().push_back(
-                    std::make_unique<jukebox::YTSong>(res.unwrap()));
+                if (auto added = nongs.add(std::move(res.unwrap()));
+                    added.isErr()) {
+                    warn(fmt::format("Failed to add YouTube song: {}",
+                                     added.unwrapErr()));
+                }
             }
         }
 
@@ -285,13 +310,16 @@ struct matjson::Serialize<jukebox::Nongs> {
                                                                       songID);
 
                 if (res.isErr()) {
-                    geode::log::error("Failed to load hosted song: {}",
-                                      res.unwrapErr());
+                    warn(fmt::format("Failed to load hosted song: {}",
+                                     res.unwrapErr()));
                     continue;
                 }
 
-                nongs.hosted().push_back(
-                    std::make_unique<jukebox::HostedSong>(res.unwrap()));
+                if (auto added = nongs.add(std::move(res.unwrap()));
+                    added.isErr()) {
+                    warn(fmt::format("Failed to add hosted song: {}",
+                                     added.unwrapErr()));
+                }
             }
         }
 
@@ -299,9 +327,9 @@ struct matjson::Serialize<jukebox::Nongs> {
             // This can't fail
             (void)nongs.setActive(nongs.defaultSong()->metadata()->uniqueID);
         } else {
-            geode::Result<> res =
-                nongs.setActive(value["active"].asString().unwrap());
-            if (res.isErr()) {
+            std::optional<jukebox::UniqueID> active =
+                jukebox::UniqueID::find(value["active"].asString().unwrap());
+            if (!active.has_value() || nongs.setActive(*active).isErr()) {
                 // Can't fail...
                 (void)nongs.setActive(
                     nongs.defaultSong()->metadata()->uniqueID);
@@ -0,0 +1,498 @@
+#include <jukebox/nong/packed_manifest.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/loader/Log.hpp>
+
+#include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+#include <jukebox/utils/binary_stream.hpp>
+#include <jukebox/utils/mapped_file.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+constexpr std::uint8_t s_recordVersion = 1;
+
+void writePath(BinaryWriter& writer, const std::filesystem::path& path) {
+    std::u8string str = path.u8string();
+    writer.writeString(std::string_view(
+        reinterpret_cast<const char*>(str.data()), str.size()));
+}
+
+Result<std::filesystem::path> readPath(BinaryReader& reader) {
+    GEODE_UNWRAP_INTO(std::string_view str, reader.readStringView());
+    return Ok(std::filesystem::path(std::u8string(
+        reinterpret_cast<const char8_t*>(str.data()), str.size())));
+}
+
+void writeMetadata(BinaryWriter& writer, const SongMetadata* metadata) {
+    writer.writeString(metadata->uniqueID.str());
+    writer.writeString(metadata->name);
+    writer.writeString(metadata->artist);
+    writer.writeOptionalString(metadata->level);
+    writer.write<std::int32_t>(metadata->startOffset);
+}
+
+Result<SongMetadata> readMetadata(BinaryReader& reader, int songID) {
+    GEODE_UNWRAP_INTO(std::string uniqueID, reader.readString());
+    GEODE_UNWRAP_INTO(std::string name, reader.readString());
+    GEODE_UNWRAP_INTO(std::string artist, reader.readString());
+    GEODE_UNWRAP_INTO(std::optional<std::string> level,
+                      reader.readOptionalString());
+    GEODE_UNWRAP_INTO(std::int32_t offset, reader.read<std::int32_t>());
+
+    return Ok(SongMetadata{songID, UniqueID(uniqueID), std::move(name),
+                           std::move(artist), std::move(level), offset});
+}
+
+Result<LocalSong> readLocal(BinaryReader& reader, int songID) {
+    GEODE_UNWRAP_INTO(SongMetadata metadata, readMetadata(reader, songID));
+    GEODE_UNWRAP_INTO(std::filesystem::path path, readPath(reader));
+    return Ok(LocalSong{std::move(metadata), path});
+}
+
+}  // namespace
+
+bool PackedManifest::exists() const {
+    std::error_code ec;
+    return std::filesystem::exists(m_path, ec);
+}
+
+std::vector<std::uint8_t> PackedManifest::encode(Nongs& nongs) {
+    BinaryWriter writer;
+
+    writer.write<std::uint8_t>(s_recordVersion);
+    writer.writeString(nongs.active()->metadata()->uniqueID.str());
+
+    writeMetadata(writer, nongs.defaultSong()->metadata());
+    writePath(writer, nongs.defaultSong()->path().value());
+
+    // One group per kind, in the order of NongStore. Same as the JSON
+    // manifest, songs that were never downloaded are not stored.
+    nongs.songs().forEachKind([&writer](auto& songs) {
+        using T = typename std::decay_t<decltype(songs)>::value_type::
+            element_type;
+        writer.write<std::uint32_t>(std::count_if(
+            songs.begin(), songs.end(),
+            [](const std::unique_ptr<T>& s) { return s->path().has_value(); }));
+        for (std::unique_ptr<T>& song : songs) {
+            if (!song->path().has_value()) {
+                continue;
+            }
+            writeMetadata(writer, song->metadata());
+            if constexpr (std::is_same_v<T, YTSong>) {
+                writer.writeString(song->youtubeID());
+                writer.writeOptionalString(song->indexID());
+            } else if constexpr (std::is_same_v<T, HostedSong>) {
+                writer.writeString(song->url());
+                writer.writeOptionalString(song->indexID());
+            }
+            writePath(writer, song->path().value());
+        }
+    });
+
+    return writer.take();
+}
+
+Result<std::unique_ptr<Nongs>> PackedManifest::decode(
+    std::span<const std::uint8_t> bytes, int songID) {
+    BinaryReader reader(bytes);
+
+    GEODE_UNWRAP_INTO(std::uint8_t version, reader.read<std::uint8_t>());
+    if (version != s_recordVersion) {
+        return Err("Unsupported record version {} for ID {}", version, songID);
+    }
+
+    GEODE_UNWRAP_INTO(std::string active, reader.readString());
+    GEODE_UNWRAP_INTO(LocalSong defaultSong, readLocal(reader, songID));
+
+    auto nongs = std::make_unique<Nongs>(songID, std::move(defaultSong));
+
+    GEODE_UNWRAP_INTO(std::uint32_t locals, reader.read<std::uint32_t>());
+    for (std::uint32_t i = 0; i < locals; i++) {
+        GEODE_UNWRAP_INTO(LocalSong song, readLocal(reader, songID));
+        // Duplicate unique IDs are dropped, like in the JSON manifest
+        (void)nongs->add(std::move(song));
+    }
+
+    GEODE_UNWRAP_INTO(std::uint32_t youtube, reader.read<std::uint32_t>());
+    for (std::uint32_t i = 0; i < youtube; i++) {
+        GEODE_UNWRAP_INTO(SongMetadata metadata, readMetadata(reader, songID));
+        GEODE_UNWRAP_INTO(std::string youtubeID, reader.readString());
+        GEODE_UNWRAP_INTO(std::optional<std::string> indexID,
+                          reader.readOptionalString());
+        GEODE_UNWRAP_INTO(std::filesystem::path path, readPath(reader));
+        (void)nongs->add(YTSong(std::move(metadata), std::move(youtubeID),
+                                std::move(indexID), std::move(path)));
+    }
+
+    GEODE_UNWRAP_INTO(std::uint32_t hosted, reader.read<std::uint32_t>());
+    for (std::uint32_t i = 0; i < hosted; i++) {
+        GEODE_UNWRAP_INTO(SongMetadata metadata, readMetadata(reader, songID));
+        GEODE_UNWRAP_INTO(std::string url, reader.readString());
+        GEODE_UNWRAP_INTO(std::optional<std::string> indexID,
+                          reader.readOptionalString());
+        GEODE_UNWRAP_INTO(std::filesystem::path path, readPath(reader));
+        (void)nongs->add(HostedSong(std::move(metadata), std::move(url),
+                                    std::move(indexID), std::move(path)));
+    }
+
+    std::optional<UniqueID> activeID = UniqueID::find(active);
+    if (!activeID.has_value() || nongs->setActive(*activeID).isErr()) {
+        // Can't fail...
+        (void)nongs->setActive(nongs->defaultSong()->metadata()->uniqueID);
+    }
+
+    return Ok(std::move(nongs));
+}
+
+Result<> PackedManifest::readTable(std::span<const std::uint8_t> data) {
+    if (data.size() < sizeof(Header)) {
+        return Err("Packed manifest is truncated");
+    }
+
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+
+    if (header.magic != s_magic) {
+        return Err("Packed manifest has an invalid header");
+    }
+    if (header.formatVersion != s_formatVersion) {
+        return Err("Unsupported packed manifest format {}",
+                   header.formatVersion);
+    }
+    if (header.manifestVersion != Manifest::s_latestVersion) {
+        return Err("Packed manifest was written for manifest version {}",
+                   header.manifestVersion);
+    }
+    if (data.size() < dataStart(header.capacity)) {
+        return Err("Packed manifest table is truncated");
+    }
+
+    m_slots.clear();
+    m_freeSlots.clear();
+    m_liveBytes = 0;
+
+    const std::uint8_t* table = data.data() + sizeof(Header);
+    // Walked backwards so free slots are handed out from the front
+    for (std::uint32_t i = header.capacity; i-- > 0;) {
+        TableEntry entry;
+        std::memcpy(&entry, table + i * sizeof(TableEntry), sizeof(TableEntry));
+
+        if (entry.songID == 0) {
+            m_freeSlots.push_back(i);
+            continue;
+        }
+
+        if (entry.offset < dataStart(header.capacity) ||
+            entry.offset + entry.length > data.size()) {
+            return Err("Record for ID {} is out of bounds", entry.songID);
+        }
+
+        m_slots[entry.songID] = Slot{
+            .index = i, .length = entry.length, .offset = entry.offset};
+        m_liveBytes += entry.length;
+    }
+
+    m_capacity = header.capacity;
+    m_fileSize = data.size();
+    m_opened = true;
+
+    return Ok();
+}
+
+Result<> PackedManifest::load() {
+    if (m_opened) {
+        return Ok();
+    }
+
+    if (!this->exists()) {
+        return this->rewrite(s_initialCapacity, {});
+    }
+
+    GEODE_UNWRAP_INTO(MappedFile file, MappedFile::open(m_path));
+    return this->readTable(file.bytes());
+}
+
+Result<> PackedManifest::open() {
+    std::lock_guard lock(m_mutex);
+    return this->load();
+}
+
+std::vector<int> PackedManifest::ids() {
+    std::lock_guard lock(m_mutex);
+
+    std::vector<int> ret;
+    ret.reserve(m_slots.size());
+    for (const auto& [id, _] : m_slots) {
+        ret.push_back(id);
+    }
+    return ret;
+}
+
+Result<std::unique_ptr<Nongs>> PackedManifest::read(int songID) {
+    std::lock_guard lock(m_mutex);
+
+    GEODE_UNWRAP(this->load());
+
+    auto it = m_slots.find(songID);
+    if (it == m_slots.end()) {
+        return Err("No packed record for ID {}", songID);
+    }
+
+    GEODE_UNWRAP_INTO(MappedFile file, MappedFile::open(m_path));
+    if (file.size() < it->second.offset + it->second.length) {
+        return Err("Packed record for ID {} is out of bounds", songID);
+    }
+
+    return decode(file.bytes().subspan(it->second.offset, it->second.length),
+                  songID);
+}
+
+Result<std::vector<std::unique_ptr<Nongs>>> PackedManifest::readAll() {
+    std::lock_guard lock(m_mutex);
+
+    GEODE_UNWRAP_INTO(MappedFile file, MappedFile::open(m_path));
+    GEODE_UNWRAP(this->readTable(file.bytes()));
+
+    std::vector<std::pair<std::uint32_t, int>> order;
+    order.reserve(m_slots.size());
+    for (const auto& [id, slot] : m_slots) {
+        order.emplace_back(slot.index, id);
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<std::unique_ptr<Nongs>> ret;
+    ret.reserve(order.size());
+
+    for (const auto& [_, id] : order) {
+        const Slot& slot = m_slots.at(id);
+        auto res = decode(file.bytes().subspan(slot.offset, slot.length), id);
+        if (res.isErr()) {
+            log::error("Failed to read packed record for ID {}: {}", id,
+                       res.unwrapErr());
+            continue;
+        }
+        ret.push_back(std::move(res.unwrap()));
+    }
+
+    return Ok(std::move(ret));
+}
+
+Result<> PackedManifest::rewrite(
+    std::uint32_t capacity,
+    const std::vector<std::pair<int, std::vector<std::uint8_t>>>& records) {
+    capacity = std::max(capacity, s_initialCapacity);
+    while (capacity < records.size()) {
+        capacity *= 2;
+    }
+
+    BinaryWriter writer;
+    writer.write(Header{.magic = s_magic,
+                        .formatVersion = s_formatVersion,
+                        .manifestVersion = Manifest::s_latestVersion,
+                        .capacity = capacity,
+                        .reserved = 0});
+
+    std::unordered_map<int, Slot> slots;
+    std::uint64_t offset = dataStart(capacity);
+    for (std::uint32_t i = 0; i < capacity; i++) {
+        if (i >= records.size()) {
+            writer.write(TableEntry{.songID = 0, .length = 0, .offset = 0});
+            continue;
+        }
+        const auto& [id, bytes] = records[i];
+        TableEntry entry{.songID = id,
+                         .length = static_cast<std::uint32_t>(bytes.size()),
+                         .offset = offset};
+        writer.write(entry);
+        slots[id] =
+            Slot{.index = i, .length = entry.length, .offset = entry.offset};
+        offset += bytes.size();
+    }
+
+    std::uint64_t liveBytes = 0;
+    for (const auto& [_, bytes] : records) {
+        writer.writeBytes(bytes);
+        liveBytes += bytes.size();
+    }
+
+    GEODE_UNWRAP(write_file_atomic(m_path, writer.buffer())
+                     .mapErr([](std::string err) {
+                         return fmt::format(
+                             "Couldn't replace packed manifest: {}", err);
+                     }));
+
+    m_slots = std::move(slots);
+    m_freeSlots.clear();
+    for (std::uint32_t i = capacity; i-- > records.size();) {
+        m_freeSlots.push_back(i);
+    }
+    m_capacity = capacity;
+    m_fileSize = writer.size();
+    m_liveBytes = liveBytes;
+    m_opened = true;
+
+    return Ok();
+}
+
+Result<> PackedManifest::compact(std::uint32_t capacity) {
+    std::vector<std::pair<int, std::vector<std::uint8_t>>> records;
+    {
+        GEODE_UNWRAP_INTO(MappedFile file, MappedFile::open(m_path));
+        if (file.size() < m_fileSize) {
+            return Err("Packed manifest shrunk while in use");
+        }
+
+        std::vector<std::pair<std::uint32_t, int>> order;
+        order.reserve(m_slots.size());
+        for (const auto& [id, slot] : m_slots) {
+            order.emplace_back(slot.index, id);
+        }
+        std::sort(order.begin(), order.end());
+
+        records.reserve(order.size());
+        for (const auto& [_, id] : order) {
+            const Slot& slot = m_slots.at(id);
+            auto bytes = file.bytes().subspan(slot.offset, slot.length);
+            records.emplace_back(
+                id, std::vector<std::uint8_t>(bytes.begin(), bytes.end()));
+        }
+    }
+
+    log::debug("Compacting packed manifest ({} records, {} bytes dead)",
+               records.size(), m_fileSize - m_liveBytes - dataStart(m_capacity));
+
+    return this->rewrite(capacity, records);
+}
+
+bool PackedManifest::shouldStore(Nongs& nongs) {
+    // Don't save manifest for songs with no nongs
+    return !nongs.songs().empty();
+}
+
+Result<> PackedManifest::writeAll(const std::vector<Nongs*>& nongs) {
+    std::vector<std::pair<int, std::vector<std::uint8_t>>> records;
+    records.reserve(nongs.size());
+
+    for (Nongs* n : nongs) {
+        if (!shouldStore(*n)) {
+            continue;
+        }
+        records.emplace_back(n->songID(), encode(*n));
+    }
+
+    std::lock_guard lock(m_mutex);
+    return this->rewrite(static_cast<std::uint32_t>(records.size() * 2),
+                         records);
+}
+
+Result<> PackedManifest::write(int id, std::vector<std::uint8_t> record) {
+    std::lock_guard lock(m_mutex);
+
+    GEODE_UNWRAP(this->load());
+
+    const std::uint64_t dead =
+        m_fileSize - dataStart(m_capacity) - m_liveBytes;
+    if (!m_slots.contains(id) && m_freeSlots.empty()) {
+        GEODE_UNWRAP(this->compact(m_capacity * 2));
+    } else if (dead > s_compactThreshold && dead > m_liveBytes) {
+        GEODE_UNWRAP(this->compact(m_capacity));
+    }
+
+    std::uint32_t index;
+    if (auto it = m_slots.find(id); it != m_slots.end()) {
+        index = it->second.index;
+    } else {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+
+    std::fstream file(m_path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        return Err(fmt::format("Couldn't open file: {}", m_path));
+    }
+
+    // The record goes at the end of the file first, so a crash before the
+    // table slot is updated leaves the previous record in place
+    TableEntry entry{.songID = id,
+                     .length = static_cast<std::uint32_t>(record.size()),
+                     .offset = m_fileSize};
+    file.seekp(static_cast<std::streamoff>(m_fileSize));
+    file.write(reinterpret_cast<const char*>(record.data()), record.size());
+    file.flush();
+    file.seekp(static_cast<std::streamoff>(sizeof(Header) +
+                                           index * sizeof(TableEntry)));
+    file.write(reinterpret_cast<const char*>(&entry), sizeof(TableEntry));
+    file.flush();
+
+    if (!file) {
+        return Err(fmt::format("Couldn't write record for ID {}", id));
+    }
+
+    if (auto it = m_slots.find(id); it != m_slots.end()) {
+        m_liveBytes -= it->second.length;
+    }
+    m_slots[id] =
+        Slot{.index = index, .length = entry.length, .offset = entry.offset};
+    m_liveBytes += entry.length;
+    m_fileSize += entry.length;
+
+    return Ok();
+}
+
+Result<> PackedManifest::remove(int songID) {
+    std::lock_guard lock(m_mutex);
+
+    if (!m_opened && !this->exists()) {
+        return Ok();
+    }
+
+    GEODE_UNWRAP(this->load());
+
+    auto it = m_slots.find(songID);
+    if (it == m_slots.end()) {
+        return Ok();
+    }
+
+    std::fstream file(m_path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        return Err(fmt::format("Couldn't open file: {}", m_path));
+    }
+
+    TableEntry entry{.songID = 0, .length = 0, .offset = 0};
+    file.seekp(static_cast<std::streamoff>(
+        sizeof(Header) + it->second.index * sizeof(TableEntry)));
+    file.write(reinterpret_cast<const char*>(&entry), sizeof(TableEntry));
+    file.flush();
+
+    if (!file) {
+        return Err(fmt::format("Couldn't remove record for ID {}", songID));
+    }
+
+    m_liveBytes -= it->second.length;
+    m_freeSlots.push_back(it->second.index);
+    m_slots.erase(it);
+
+    return Ok();
+}
+
+}  // namespace jukebox
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+#include <jukebox/nong/nong.hpp>
+
+namespace jukebox {
+
+/**
+ * Single-file alternative to the one-JSON-per-song manifest directory.
+ *
+ * Layout: a fixed header, a table of (song ID, length, offset) slots and an
+ * append-only record region. Updating a song appends a new record and
+ * rewrites its 16 byte table slot, so a commit never rewrites the whole file.
+ * When the table fills up or too much of the file is dead records, the store
+ * is compacted into a fresh file.
+ */
+class PackedManifest final {
+public:
+    constexpr static inline std::uint32_t s_magic = 0x4B50424A;  // "JBPK"
+    constexpr static inline std::uint16_t s_formatVersion = 1;
+    constexpr static inline std::uint32_t s_initialCapacity = 256;
+    // Dead record bytes tolerated before a commit compacts the store
+    constexpr static inline std::uint64_t s_compactThreshold = 1024 * 1024;
+
+private:
+    struct Header {
+        std::uint32_t magic;
+        std::uint16_t formatVersion;
+        std::uint16_t manifestVersion;
+        std::uint32_t capacity;
+        std::uint32_t reserved;
+    };
+
+    struct TableEntry {
+        std::int32_t songID;
+        std::uint32_t length;
+        std::uint64_t offset;
+    };
+
+    static_assert(sizeof(Header) == 16);
+    static_assert(sizeof(TableEntry) == 16);
+
+    struct Slot {
+        std::uint32_t index;
+        std::uint32_t length;
+        std::uint64_t offset;
+    };
+
+    // Commits are written from the manifest writer thread while the main
+    // thread may be reading records, so every public operation locks
+    std::mutex m_mutex;
+    std::filesystem::path m_path;
+    std::unordered_map<int, Slot> m_slots;
+    std::vector<std::uint32_t> m_freeSlots;
+    std::uint32_t m_capacity = 0;
+    std::uint64_t m_fileSize = 0;
+    std::uint64_t m_liveBytes = 0;
+    bool m_opened = false;
+
+    static std::uint64_t dataStart(std::uint32_t capacity) {
+        return sizeof(Header) +
+               static_cast<std::uint64_t>(capacity) * sizeof(TableEntry);
+    }
+
+    geode::Result<> readTable(std::span<const std::uint8_t> data);
+    geode::Result<> rewrite(
+        std::uint32_t capacity,
+        const std::vector<std::pair<int, std::vector<std::uint8_t>>>& records);
+    geode::Result<> compact(std::uint32_t capacity);
+    geode::Result<> load();
+
+public:
+    PackedManifest(std::filesystem::path path) : m_path(std::move(path)) {}
+
+    const std::filesystem::path& path() const { return m_path; }
+    bool exists() const;
+    std::size_t size() const { return m_slots.size(); }
+
+    /**
+     * Whether a Nongs has anything worth storing
+     */
+    static bool shouldStore(Nongs& nongs);
+
+    /**
+     * Encodes a Nongs into a packed record
+     */
+    static std::vector<std::uint8_t> encode(Nongs& nongs);
+
+    /**
+     * Decodes a packed record
+     *
+     * @param bytes the record bytes
+     * @param songID the song ID the record is stored under
+     */
+    static geode::Result<std::unique_ptr<Nongs>> decode(
+        std::span<const std::uint8_t> bytes, int songID);
+
+    /**
+     * Reads the table of the store without decoding any record. Creates an
+     * empty store if there is none.
+     */
+    geode::Result<> open();
+
+    /**
+     * Song IDs that have a record in the store. Requires open() or readAll()
+     */
+    std::vector<int> ids();
+
+    /**
+     * Decodes the record of a single song
+     */
+    geode::Result<std::unique_ptr<Nongs>> read(int songID);
+
+    /**
+     * Maps the store and decodes every record in it. Records that fail to
+     * decode are logged and skipped.
+     */
+    geode::Result<std::vector<std::unique_ptr<Nongs>>> readAll();
+
+    /**
+     * Replaces the store with the given songs. Songs without custom NONGs are
+     * not stored, like in the JSON manifest.
+     */
+    geode::Result<> writeAll(const std::vector<Nongs*>& nongs);
+
+    /**
+     * Updates the record of a single song in place
+     *
+     * @param songID the song ID to store the record under
+     * @param record a record produced by encode()
+     */
+    geode::Result<> write(int songID, std::vector<std::uint8_t> record);
+
+    /**
+     * Drops the record of a song, if it is stored
+     */
+    geode::Result<> remove(int songID);
+};
+
+}  // namespace jukebox
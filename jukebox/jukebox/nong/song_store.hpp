@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace jukebox {
+
+class Song;
+
+/**
+ * Owns songs of several kinds, one vector per kind, kept in the order of
+ * Kinds. The visitors are expanded for every kind at compile time, so they
+ * get each song as its own type without going through Song's virtual
+ * functions, and findIf is a single pass that stops at the first match.
+ *
+ * Every kind needs a constexpr static s_type, its NongType.
+ */
+template <class... Kinds>
+class SongStore final {
+public:
+    template <class T>
+    using Songs = std::vector<std::unique_ptr<T>>;
+
+private:
+    std::tuple<Songs<Kinds>...> m_songs;
+
+    template <class T, class F>
+    void forEachOf(F& fn) {
+        for (std::unique_ptr<T>& song : this->of<T>()) {
+            fn(*song);
+        }
+    }
+
+    template <class T, class F>
+    Song* findIn(F& pred) {
+        for (std::unique_ptr<T>& song : this->of<T>()) {
+            if (pred(*song)) {
+                return song.get();
+            }
+        }
+        return nullptr;
+    }
+
+    template <class T>
+    bool eraseFrom(const Song* song) {
+        Songs<T>& songs = this->of<T>();
+        auto it = std::find_if(
+            songs.begin(), songs.end(),
+            [song](const std::unique_ptr<T>& i) { return i.get() == song; });
+        if (it == songs.end()) {
+            return false;
+        }
+        songs.erase(it);
+        return true;
+    }
+
+public:
+    template <class T>
+    Songs<T>& of() {
+        return std::get<Songs<T>>(m_songs);
+    }
+
+    template <class T>
+    const Songs<T>& of() const {
+        return std::get<Songs<T>>(m_songs);
+    }
+
+    /**
+     * Calls fn with the vector of every kind
+     */
+    template <class F>
+    void forEachKind(F&& fn) {
+        (fn(this->of<Kinds>()), ...);
+    }
+
+    /**
+     * Calls fn with every song, as a reference to its own type
+     */
+    template <class F>
+    void forEach(F&& fn) {
+        (this->forEachOf<Kinds>(fn), ...);
+    }
+
+    /**
+     * The first song pred holds for, nullptr if there is none
+     */
+    template <class F>
+    Song* findIf(F&& pred) {
+        Song* found = nullptr;
+        (void)((found = this->findIn<Kinds>(pred)) || ...);
+        return found;
+    }
+
+    template <class T>
+    T* add(T&& song) {
+        std::unique_ptr<T> ptr = std::make_unique<T>(std::move(song));
+        T* ret = ptr.get();
+        this->of<T>().push_back(std::move(ptr));
+        return ret;
+    }
+
+    /**
+     * Removes and frees a song. Only the vector of its kind is searched.
+     *
+     * @return false if the song isn't in here
+     */
+    template <class Type>
+    bool erase(const Song* song, Type type) {
+        return ((type == Kinds::s_type && this->eraseFrom<Kinds>(song)) ||
+                ...);
+    }
+
+    void clear() { (this->of<Kinds>().clear(), ...); }
+
+    std::size_t size() const { return (this->of<Kinds>().size() + ...); }
+
+    bool empty() const { return (this->of<Kinds>().empty() && ...); }
+};
+
+}  // namespace jukebox
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include <Geode/cocos/base_nodes/CCNode.h>
@@ -98,6 +99,11 @@ void IndexesPopup::createList() {
                 m_indexes.erase(m_indexes.begin() + i);
                 this->createList();
             },
+            i == 0 ? std::function<void()>()
+                   : [this, i] {
+                         std::swap(m_indexes[i - 1], m_indexes[i]);
+                         this->createList();
+                     },
             CCSize{this->getPopupSize().width - HORIZONTAL_PADDING * 2, 35.f});
         cell->setAnchorPoint({0.f, 0.f});
         m_list->m_contentLayer->addChild(cell);
@@ -0,0 +1,176 @@
+#include <jukebox/ui/level_open_benchmark.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/binding/CustomSongWidget.hpp>
+#include <Geode/binding/LevelTools.hpp>
+#include <Geode/binding/MusicDownloadManager.hpp>
+#include <Geode/binding/SongInfoObject.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+
+#include <jukebox/utils/profiler.hpp>
+
+using namespace geode::prelude;
+
+namespace {
+
+// Phases reported besides whole widgets, in the order they run
+constexpr const char* s_phases[] = {
+    "JBSongWidget::init",
+    "JBSongWidget::setupJBSW",
+    "JBSongWidget::createSongLabels",
+    "JBSongWidget::updateWithMultiAssets",
+    "JBSongWidget::getMultiAssetSongInfo",
+    "NongManager::initSongID",
+    "NongManager::hydrateNongs",
+    "NongManager::getMultiAssetSizes",
+};
+
+// Nearest rank, durations has to be sorted and not empty
+double percentile(const std::vector<std::chrono::microseconds>& durations,
+                  double p) {
+    const auto rank = static_cast<std::size_t>(
+        std::ceil(p / 100.0 * static_cast<double>(durations.size())));
+    return durations[std::max<std::size_t>(rank, 1) - 1].count() / 1000.0;
+}
+
+}  // namespace
+
+namespace jukebox {
+
+Result<std::vector<LevelOpenBenchmark::Case>> LevelOpenBenchmark::parseCases(
+    std::string_view text) {
+    auto parseID = [](std::string_view str) -> Result<int> {
+        int id = 0;
+        auto res = std::from_chars(str.data(), str.data() + str.size(), id);
+        if (res.ec != std::errc() || res.ptr != str.data() + str.size() ||
+            id < 0) {
+            return Err("Invalid song ID \"{}\"", str);
+        }
+        return Ok(id);
+    };
+
+    std::vector<Case> cases;
+    for (auto part : std::views::split(text, ',')) {
+        std::string_view entry(part.begin(), part.end());
+        while (!entry.empty() && entry.front() == ' ') {
+            entry.remove_prefix(1);
+        }
+        while (!entry.empty() && entry.back() == ' ') {
+            entry.remove_suffix(1);
+        }
+        if (entry.empty()) {
+            continue;
+        }
+
+        Case level;
+        if (entry.front() == 'r') {
+            level.robtop = true;
+            entry.remove_prefix(1);
+        }
+        for (auto asset : std::views::split(entry, '+')) {
+            GEODE_UNWRAP_INTO(
+                int id, parseID(std::string_view(asset.begin(), asset.end())));
+            level.assets.push_back(id);
+        }
+        if (level.robtop && level.assets.size() > 1) {
+            return Err("RobTop songs can't have multiple songs");
+        }
+        level.songID = level.assets.front();
+        if (level.assets.size() == 1) {
+            level.assets.clear();
+        }
+        cases.push_back(std::move(level));
+    }
+
+    if (cases.empty()) {
+        return Err("No songs to benchmark");
+    }
+    return Ok(std::move(cases));
+}
+
+void LevelOpenBenchmark::openLevel(const Case& level) {
+    ProfileScope profile(s_widgetPhase);
+
+    SongInfoObject* info =
+        level.robtop
+            ? LevelTools::getSongObject(level.songID)
+            : MusicDownloadManager::sharedState()->getSongInfoObject(
+                  level.songID);
+    if (!info) {
+        info = SongInfoObject::create(level.songID);
+    }
+
+    // Set up like LevelInfoLayer does, without a delegate nothing is
+    // clicked anyway
+    CustomSongWidget* widget = CustomSongWidget::create(
+        info, nullptr, false, false, true, level.robtop, false, false, 0);
+    if (!widget || level.assets.empty()) {
+        return;
+    }
+    std::string songs;
+    for (int id : level.assets) {
+        songs += songs.empty() ? fmt::format("{}", id) : fmt::format(",{}", id);
+    }
+    widget->updateWithMultiAssets(songs, "", 0);
+}
+
+Result<std::string> LevelOpenBenchmark::run() {
+    if (!Profiler::enabled()) {
+        return Err("Turn on profiling to run the benchmark");
+    }
+    const std::string songs =
+        Mod::get()->getSettingValue<std::string>("benchmark-songs");
+    GEODE_UNWRAP_INTO(std::vector<Case> cases, parseCases(songs));
+    const std::int64_t rounds = std::max<std::int64_t>(
+        1, Mod::get()->getSettingValue<std::int64_t>("benchmark-rounds"));
+
+    const auto started = std::chrono::steady_clock::now();
+    for (std::int64_t round = 0; round < rounds; round++) {
+        for (const Case& level : cases) {
+            openLevel(level);
+        }
+    }
+
+    std::string ret = fmt::format("## Level open\n{} songs, {} rounds\n\n",
+                                  cases.size(), rounds);
+    log::info("Level open benchmark: {} songs, {} rounds", cases.size(),
+              rounds);
+
+    std::vector<const char*> phases{s_widgetPhase};
+    phases.insert(phases.end(), std::begin(s_phases), std::end(s_phases));
+    for (const char* phase : phases) {
+        std::vector<std::chrono::microseconds> durations =
+            Profiler::get().durations(phase, started);
+        if (durations.empty()) {
+            continue;
+        }
+        std::sort(durations.begin(), durations.end());
+        const std::string stats = fmt::format(
+            "{} calls, p50 {:.3f} ms, p90 {:.3f} ms, p99 {:.3f} ms, "
+            "max {:.3f} ms",
+            durations.size(), percentile(durations, 50),
+            percentile(durations, 90), percentile(durations, 99),
+            durations.back().count() / 1000.0);
+        ret += fmt::format("- **{}**: {}\n", phase, stats);
+        log::info("Level open benchmark: {}: {}", phase, stats);
+    }
+    return Ok(ret);
+}
+
+}  // namespace jukebox
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+namespace jukebox {
+
+/**
+ * Measures what opening a level costs Jukebox. Builds the song widget of a
+ * level info layer for every configured song, round after round, and
+ * reports percentiles of the profiled phases recorded while doing so, so
+ * builds can be compared on the same machine.
+ *
+ * Songs come from the "benchmark-songs" setting, separated by commas. A
+ * song is a song ID, an r in front makes it a RobTop song, and song IDs
+ * joined with + are a level with multiple songs.
+ */
+class LevelOpenBenchmark final {
+public:
+    struct Case {
+        int songID = 0;
+        bool robtop = false;
+        // Every song of a level with multiple songs, songID first
+        std::vector<int> assets;
+    };
+
+protected:
+    // Whole widgets, the phases below are parts of them
+    constexpr static inline const char* s_widgetPhase =
+        "LevelOpenBenchmark::widget";
+
+    static void openLevel(const Case& level);
+
+public:
+    static geode::Result<std::vector<Case>> parseCases(std::string_view text);
+
+    /**
+     * Runs the benchmark on the main thread with the configured songs and
+     * rounds. Also logs the report.
+     *
+     * @return the report as markdown, or Err if profiling is off or the
+     * songs can't be parsed
+     */
+    static geode::Result<std::string> run();
+};
+
+}  // namespace jukebox
@@ -17,7 +17,8 @@ using namespace geode::prelude;
 namespace jukebox {
 
 bool IndexCell::init(IndexesPopup* parentPopup, IndexSource* index,
-                     std::function<void()> onDelete, CCSize const& size) {
+                     std::function<void()> onDelete,
+                     std::function<void()> onMoveUp, CCSize const& size) {
     if (!CCNode::init()) {
         return false;
     }
@@ -27,6 +28,7 @@ bool IndexCell::init(IndexesPopup* parentPopup, IndexSource* index,
     m_parentPopup = parentPopup;
     m_index = index;
     m_onDelete = onDelete;
+    m_onMoveUp = onMoveUp;
 
     this->setContentSize(size);
     this->setAnchorPoint(CCPoint{0.5f, 0.5f});
@@ -60,6 +62,16 @@ bool IndexCell::init(IndexesPopup* parentPopup, IndexSource* index,
     buttonsMenu->setAnchorPoint(CCPoint{1.0f, 0.5f});
     buttonsMenu->setContentSize(CCSize{50.f, 30.f});
 
+    if (m_onMoveUp) {
+        auto sprite = CCSprite::createWithSpriteFrameName("edit_upBtn_001.png");
+        sprite->setScale(0.7f);
+        auto moveUpButton = CCMenuItemSpriteExtra::create(
+            sprite, this, menu_selector(IndexCell::onMoveUp));
+        moveUpButton->setID("move-up-button");
+        buttonsMenu->addChild(moveUpButton);
+        m_buttonsSize += moveUpButton->getContentSize().width;
+    }
+
     if (m_index->m_userAdded) {
         auto sprite =
             CCSprite::createWithSpriteFrameName("GJ_deleteIcon_001.png");
@@ -117,11 +129,14 @@ void IndexCell::onToggle(CCObject*) {
 
 void IndexCell::onDelete(CCObject*) { m_onDelete(); }
 
+void IndexCell::onMoveUp(CCObject*) { m_onMoveUp(); }
+
 IndexCell* IndexCell::create(IndexesPopup* parentPopup, IndexSource* index,
                              std::function<void()> onDelete,
+                             std::function<void()> onMoveUp,
                              CCSize const& size) {
     auto ret = new IndexCell();
-    if (ret && ret->init(parentPopup, index, onDelete, size)) {
+    if (ret && ret->init(parentPopup, index, onDelete, onMoveUp, size)) {
         return ret;
     }
     CC_SAFE_DELETE(ret);
@@ -20,19 +20,28 @@ protected:
     IndexesPopup* m_parentPopup;
     IndexSource* m_index;
     std::function<void()> m_onDelete;
+    // Empty for the first index
+    std::function<void()> m_onMoveUp;
 
     CCMenuItemToggler* m_toggleButton;
 
     bool init(IndexesPopup* parentPopup, IndexSource* index,
-              std::function<void()> onDelete, cocos2d::CCSize const& size);
+              std::function<void()> onDelete, std::function<void()> onMoveUp,
+              cocos2d::CCSize const& size);
 
 public:
+    /**
+     * @param onMoveUp moves the index up the list, which songs of indexes
+     * higher up are preferred for. Empty for the first index
+     */
     static IndexCell* create(IndexesPopup* parentPopup, IndexSource* index,
                              std::function<void()> onDelete,
+                             std::function<void()> onMoveUp,
                              cocos2d::CCSize const& size);
     void updateUI();
     void onToggle(CCObject*);
     void onDelete(CCObject*);
+    void onMoveUp(CCObject*);
 };
 
 }  // namespace jukebox
@@ -1,6 +1,9 @@
 #include <jukebox/ui/list/index_song_cell.hpp>
 
 #include <GUI/CCControlExtension/CCScale9Sprite.h>
+#include <optional>
+#include <string>
+
 #include <Geode/cocos/base_nodes/CCNode.h>
 #include <Geode/cocos/cocoa/CCGeometry.h>
 #include <Geode/cocos/cocoa/CCObject.h>
@@ -14,7 +17,9 @@
 
 #include <jukebox/events/song_download_failed.hpp>
 #include <jukebox/events/song_download_progress.hpp>
+#include <jukebox/events/song_subscriptions.hpp>
 #include <jukebox/events/start_download.hpp>
+#include <jukebox/managers/index_manager.hpp>
 #include <jukebox/nong/index.hpp>
 
 using namespace jukebox::index;
@@ -28,11 +33,6 @@ bool IndexSongCell::init(IndexSongMetadata* song, int gdId,
         return false;
     }
 
-    m_song = song;
-    m_gdId = gdId;
-
-    m_downloadListener.bind(this, &IndexSongCell::onDownloadProgress);
-
     this->setContentSize(size);
     this->setAnchorPoint({0.5f, 0.5f});
     constexpr float PADDING_X = 12.0f;
@@ -54,22 +54,16 @@ bool IndexSongCell::init(IndexSongMetadata* song, int gdId,
     m_songInfoNode->setContentSize({songInfoWidth, maxSize.height});
     m_songInfoNode->setID("song-info-node");
 
-    m_songNameLabel =
-        CCLabelBMFont::create(m_song->name.c_str(), "bigFont.fnt");
+    m_songNameLabel = CCLabelBMFont::create("", "bigFont.fnt");
     m_songNameLabel->setAnchorPoint({0.0f, 0.5f});
-    m_songNameLabel->limitLabelWidth(songInfoWidth, 0.56f, 0.1f);
     m_songNameLabel->setID("song-info-label");
 
-    m_artistLabel =
-        CCLabelBMFont::create(m_song->artist.c_str(), "goldFont.fnt");
+    m_artistLabel = CCLabelBMFont::create("", "goldFont.fnt");
     m_artistLabel->setAnchorPoint({0.0f, 0.5f});
-    m_artistLabel->limitLabelWidth(songInfoWidth, 0.5f, 0.1f);
     m_songNameLabel->setID("artist-label");
 
-    m_indexNameLabel =
-        CCLabelBMFont::create(m_song->parentID->m_name.c_str(), "bigFont.fnt");
+    m_indexNameLabel = CCLabelBMFont::create("", "bigFont.fnt");
     m_indexNameLabel->setAnchorPoint({0.0f, 0.5f});
-    m_indexNameLabel->limitLabelWidth(songInfoWidth, 0.4f, 0.1f);
     m_indexNameLabel->setColor({.r = 162, .g = 191, .b = 255});
     m_songNameLabel->setID("index-name-label");
 
@@ -131,60 +125,94 @@ bool IndexSongCell::init(IndexSongMetadata* song, int gdId,
             AxisAlignment::End));
 
     this->addChildAtPosition(m_downloadMenu, Anchor::Right, {-PADDING_X, 0.0f});
+
+    this->setSong(song, gdId);
     return true;
 }
 
-void IndexSongCell::onDownload(CCObject*) {
-    if (m_downloading) {
+void IndexSongCell::setSong(IndexSongMetadata* song, int gdId) {
+    m_song = song;
+    m_gdId = gdId;
+
+    const float width = m_songInfoNode->getContentWidth();
+    m_songNameLabel->setString(m_song->name.data());
+    m_songNameLabel->limitLabelWidth(width, 0.56f, 0.1f);
+    m_artistLabel->setString(m_song->artist.data());
+    m_artistLabel->limitLabelWidth(width, 0.5f, 0.1f);
+    m_indexNameLabel->setString(m_song->parentID->m_name.c_str());
+    m_indexNameLabel->limitLabelWidth(width, 0.4f, 0.1f);
+    m_songInfoNode->updateLayout();
+
+    // Scrolling an index list doesn't pool the IDs of its songs
+    m_uniqueID.reset();
+    m_progressSubscription.reset();
+    m_failedSubscription.reset();
+    std::optional<UniqueID> uniqueID = UniqueID::find(m_song->uniqueID);
+    if (!uniqueID.has_value()) {
+        this->showDownloadState(std::nullopt);
         return;
     }
+    this->subscribe(uniqueID.value());
 
-    m_downloading = true;
-    CCSprite* newSpr =
-        CCSprite::createWithSpriteFrameName("GJ_cancelDownloadBtn_001.png");
-    newSpr->setScale(0.7f);
-    m_downloadButton->setSprite(newSpr);
-    m_downloadButton->setColor(ccc3(105, 105, 105));
-    m_progressContainer->setVisible(true);
-    m_progressBar->setPercentage(0.0f);
+    // A recycled cell can land on a song that is downloading already
+    this->showDownloadState(
+        IndexManager::get().getSongDownloadProgress(uniqueID.value()));
+}
 
-    event::StartDownload(m_song, m_gdId).post();
+void IndexSongCell::subscribe(UniqueID uniqueID) {
+    m_uniqueID = uniqueID;
+    event::SongSubscriptions& subscriptions = event::SongSubscriptions::get();
+    m_progressSubscription = subscriptions.onProgress(
+        m_gdId, uniqueID, [this](event::SongDownloadProgress* e) {
+            this->onDownloadProgress(e);
+        });
+    m_failedSubscription = subscriptions.onFailed(
+        m_gdId, uniqueID,
+        [this](event::SongDownloadFailed* e) { this->onDownloadFailed(e); });
+}
+
+void IndexSongCell::showDownloadState(std::optional<float> progress) {
+    m_downloading = progress.has_value();
+    CCSprite* spr = CCSprite::createWithSpriteFrameName(
+        m_downloading ? "GJ_cancelDownloadBtn_001.png"
+                      : "GJ_downloadBtn_001.png");
+    spr->setScale(0.7f);
+    m_downloadButton->setSprite(spr);
+    m_downloadButton->setColor(m_downloading ? ccc3(105, 105, 105)
+                                             : ccc3(255, 255, 255));
+    m_progressContainer->setVisible(m_downloading);
+    m_progressBar->setPercentage(progress.value_or(0.0f));
 }
 
-ListenerResult IndexSongCell::onDownloadProgress(
-    event::SongDownloadProgress* e) {
-    if (e->gdSongID() != m_gdId || e->uniqueID() != m_song->uniqueID) {
-        return ListenerResult::Propagate;
+void IndexSongCell::onDownload(CCObject*) {
+    if (m_downloading) {
+        if (m_uniqueID.has_value()) {
+            IndexManager::get().cancelDownload(m_uniqueID.value());
+        }
+        return;
     }
 
-    if (!m_progressContainer->isVisible()) {
-        CCSprite* newSpr =
-            CCSprite::createWithSpriteFrameName("GJ_cancelDownloadBtn_001.png");
-        newSpr->setScale(0.7f);
-        m_downloadButton->setSprite(newSpr);
-        m_downloadButton->setColor(ccc3(105, 105, 105));
-        m_progressContainer->setVisible(true);
+    if (!m_uniqueID.has_value()) {
+        this->subscribe(UniqueID(m_song->uniqueID));
     }
+    this->showDownloadState(0.0f);
 
-    m_progressBar->setPercentage(e->progress());
-    return ListenerResult::Propagate;
+    event::StartDownload(m_song, m_gdId).post();
 }
 
-ListenerResult IndexSongCell::onDownloadFailed(event::SongDownloadFailed* e) {
-    if (e->gdSongId() != m_gdId || e->uniqueId() != m_song->uniqueID) {
-        return ListenerResult::Propagate;
+void IndexSongCell::onDownloadProgress(event::SongDownloadProgress* e) {
+    if (!m_progressContainer->isVisible()) {
+        this->showDownloadState(e->progress());
     }
 
-    m_progressContainer->setVisible(false);
-    m_progressBar->setPercentage(0.0f);
-    CCSprite* downloadSpr =
-        CCSprite::createWithSpriteFrameName("GJ_downloadBtn_001.png");
-    downloadSpr->setScale(0.7f);
-    m_downloadButton->setSprite(downloadSpr);
-    m_downloadButton->setColor({255, 255, 255});
-    m_downloading = false;
+    m_progressBar->setPercentage(e->progress());
+    // Yellow while a failed chunk is being retried
+    m_progressBar->getSprite()->setColor(
+        e->retry() > 0 ? ccc3(255, 200, 0) : ccc3(0, 255, 0));
+}
 
-    return ListenerResult::Propagate;
+void IndexSongCell::onDownloadFailed(event::SongDownloadFailed* e) {
+    this->showDownloadState(std::nullopt);
 }
 
 IndexSongCell* IndexSongCell::create(IndexSongMetadata* song, int gdId,
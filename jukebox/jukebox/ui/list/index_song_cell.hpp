@@ -1,5 +1,7 @@
 #pragma once
 
+#include <optional>
+
 #include <Geode/cocos/base_nodes/CCNode.h>
 #include <Geode/cocos/cocoa/CCGeometry.h>
 #include <Geode/cocos/cocoa/CCObject.h>
@@ -12,11 +14,15 @@
 
 #include <jukebox/events/song_download_failed.hpp>
 #include <jukebox/events/song_download_progress.hpp>
+#include <jukebox/events/song_subscriptions.hpp>
 #include <jukebox/nong/index.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
-class IndexSongCell : public cocos2d::CCNode {
+class IndexSongCell : public cocos2d::CCNode,
+                      public memory::Counted<IndexSongCell> {
 protected:
     index::IndexSongMetadata* m_song = nullptr;
     int m_gdId;
@@ -35,21 +41,28 @@ protected:
 
     bool m_downloading = false;
 
-    geode::EventListener<
-        geode::EventFilter<jukebox::event::SongDownloadProgress>>
-        m_downloadListener;
-    geode::EventListener<geode::EventFilter<jukebox::event::SongDownloadFailed>>
-        m_downloadFailedListener{this, &IndexSongCell::onDownloadFailed};
+    // Unset while the song's ID isn't pooled, nothing can be downloading it
+    // then
+    std::optional<UniqueID> m_uniqueID;
+    // Moved to the new song whenever the cell is reused
+    event::SongSubscriptions::ProgressSubscription m_progressSubscription;
+    event::SongSubscriptions::FailedSubscription m_failedSubscription;
 
     bool init(index::IndexSongMetadata* song, int gdId,
               const cocos2d::CCSize& size);
 
+    void subscribe(UniqueID uniqueID);
+    void showDownloadState(std::optional<float> progress);
     void onDownload(CCObject*);
-    geode::ListenerResult onDownloadProgress(event::SongDownloadProgress* e);
-    geode::ListenerResult onDownloadFailed(event::SongDownloadFailed* e);
+    void onDownloadProgress(event::SongDownloadProgress* e);
+    void onDownloadFailed(event::SongDownloadFailed* e);
 
 public:
     index::IndexSongMetadata* song() const { return m_song; }
+    /**
+     * Shows another song in this cell, so lists can reuse cells
+     */
+    void setSong(index::IndexSongMetadata* song, int gdId);
 
     static IndexSongCell* create(index::IndexSongMetadata* song, int gdId,
                                  const cocos2d::CCSize& size);
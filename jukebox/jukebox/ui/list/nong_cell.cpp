@@ -1,7 +1,12 @@
 #include <jukebox/ui/list/nong_cell.hpp>
 
+#include <cstdint>
 #include <functional>
 #include <numeric>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <GUI/CCControlExtension/CCScale9Sprite.h>
 #include <Geode/cocos/base_nodes/CCNode.h>
@@ -17,9 +22,13 @@
 #include <Geode/ui/Layout.hpp>
 #include <Geode/ui/Popup.hpp>
 
+#include <jukebox/events/song_analyzed.hpp>
 #include <jukebox/events/song_download_failed.hpp>
 #include <jukebox/events/song_download_finished.hpp>
 #include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/events/song_subscriptions.hpp>
+#include <jukebox/managers/analysis_manager.hpp>
+#include <jukebox/managers/file_status_cache.hpp>
 #include <jukebox/managers/index_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
 #include <jukebox/nong/nong.hpp>
@@ -45,14 +54,34 @@ bool NongCell::init(int songID, Song* info, bool isDefault, bool selected,
     m_songInfo = info;
     m_isDefault = isDefault;
     m_isActive = selected;
-    m_isDownloaded = m_songInfo->path().has_value() &&
-                     std::filesystem::exists(m_songInfo->path().value());
+    m_isDownloaded =
+        m_songInfo->path().has_value() &&
+        FileStatusCache::get().exists(m_songInfo->path().value());
     m_isDownloadable = m_songInfo->type() != NongType::LOCAL;
     m_onSelect = onSelect;
     m_onDelete = onDelete;
     m_onDownload = onDownload;
     m_onEdit = onEdit;
 
+    if (m_isDownloaded) {
+        AnalysisManager::get().request(m_songID, m_songInfo->path().value());
+    }
+
+    event::SongSubscriptions& subscriptions = event::SongSubscriptions::get();
+    m_progressSubscription = subscriptions.onProgress(
+        m_songID, m_uniqueID, [this](event::SongDownloadProgress* e) {
+            this->onDownloadProgress(e);
+        });
+    m_finishedSubscription = subscriptions.onFinished(
+        m_songID, m_uniqueID,
+        [this](event::SongDownloadFinished* e) { this->onDownloadFinish(e); });
+    m_failedSubscription = subscriptions.onFailed(
+        m_songID, m_uniqueID,
+        [this](event::SongDownloadFailed* e) { this->onDownloadFailed(e); });
+    m_stateSubscription = subscriptions.onStateChanged(
+        m_songID,
+        [this](event::SongStateChanged* e) { this->onStateChange(e); });
+
     this->setContentSize(size);
     this->setAnchorPoint({0.5f, 0.5f});
 
@@ -169,42 +198,10 @@ bool NongCell::init(int songID, Song* info, bool isDefault, bool selected,
 
     SongMetadata* songMetadata = m_songInfo->metadata();
 
-    std::vector<std::string> metadataList = {};
-
-    switch (m_songInfo->type()) {
-        case NongType::YOUTUBE:
-            metadataList.push_back("youtube");
-            break;
-        case NongType::HOSTED:
-            metadataList.push_back("hosted");
-            break;
-        default:
-            break;
-    }
-
-    if (m_songInfo->indexID().has_value()) {
-        auto indexID = m_songInfo->indexID().value();
-        auto indexName = IndexManager::get().getIndexName(indexID);
-        metadataList.push_back(indexName.has_value() ? indexName.value()
-                                                     : indexID);
-    }
-
-    if (m_songInfo->metadata()->level.has_value()) {
-        metadataList.push_back(m_songInfo->metadata()->level.value());
-    }
-
-    if (metadataList.size() > 0) {
-        m_metadataLabel = CCLabelBMFont::create(
-            metadataList.size() >= 1
-                ? std::accumulate(
-                      std::next(metadataList.begin()), metadataList.end(),
-                      metadataList[0],
-                      [](const std::string& a, const std::string& b) {
-                          return a + ": " + b;
-                      })
-                      .c_str()
-                : "",
-            "bigFont.fnt");
+    const std::string metadata = this->metadataText();
+    if (!metadata.empty()) {
+        m_metadataLabel =
+            CCLabelBMFont::create(metadata.c_str(), "bigFont.fnt");
         m_metadataLabel->limitLabelWidth(songInfoWidth, 0.4f, 0.1f);
         m_metadataLabel->setColor({.r = 162, .g = 191, .b = 255});
         m_metadataLabel->setID("metadata");
@@ -267,27 +264,19 @@ void NongCell::onFixDefault(CCObject* target) {
         });
 }
 
-ListenerResult NongCell::onDownloadProgress(event::SongDownloadProgress* e) {
-    if (e->uniqueID() != m_uniqueID || e->gdSongID() != m_songID) {
-        return ListenerResult::Propagate;
-    }
-
-    log::info("{}", e->progress());
-
+void NongCell::onDownloadProgress(event::SongDownloadProgress* e) {
     if (!m_downloadProgressContainer->isVisible()) {
         m_downloadProgressContainer->setVisible(true);
         m_downloadButton->setColor(ccc3(105, 105, 105));
     }
 
     m_downloadProgress->setPercentage(e->progress());
-    return ListenerResult::Propagate;
+    // Yellow while a failed chunk is being retried
+    m_downloadProgress->getSprite()->setColor(
+        e->retry() > 0 ? ccc3(255, 200, 0) : ccc3(0, 255, 0));
 }
 
-ListenerResult NongCell::onDownloadFailed(event::SongDownloadFailed* e) {
-    if (e->gdSongId() != m_songID || e->uniqueId() != m_uniqueID) {
-        return ListenerResult::Propagate;
-    }
-
+void NongCell::onDownloadFailed(event::SongDownloadFailed* e) {
     m_downloadProgressContainer->setVisible(false);
     m_downloadProgress->setPercentage(0.0f);
     CCSprite* downloadSpr =
@@ -295,16 +284,9 @@ ListenerResult NongCell::onDownloadFailed(event::SongDownloadFailed* e) {
     downloadSpr->setScale(0.7f);
     m_downloadButton->setSprite(downloadSpr);
     m_downloadButton->setColor({255, 255, 255});
-
-    return ListenerResult::Propagate;
 }
 
-ListenerResult NongCell::onDownloadFinish(event::SongDownloadFinished* e) {
-    if (e->destination()->metadata()->gdID != m_songID ||
-        e->destination()->metadata()->uniqueID != m_uniqueID) {
-        return ListenerResult::Propagate;
-    }
-
+void NongCell::onDownloadFinish(event::SongDownloadFinished* e) {
     m_downloadProgressContainer->setVisible(false);
     m_downloadProgress->setPercentage(0.0f);
     m_downloadButton->setVisible(false);
@@ -312,22 +294,20 @@ ListenerResult NongCell::onDownloadFinish(event::SongDownloadFinished* e) {
     m_buttonMenu->updateLayout();
 
     m_isDownloaded = true;
-
-    return ListenerResult::Propagate;
 }
 
-ListenerResult NongCell::onStateChange(event::SongStateChanged* e) {
+void NongCell::onStateChange(event::SongStateChanged* e) {
     bool sameIDAsActive =
         e->nongs()->active()->metadata()->uniqueID == m_uniqueID;
     bool switchedToActive = !m_isActive && sameIDAsActive;
     bool switchedToInactive = m_isActive && !sameIDAsActive;
 
-    if (e->nongs()->songID() != m_songID || (!m_isDownloaded && !m_isDefault)) {
-        return ListenerResult::Propagate;
+    if (!m_isDownloaded && !m_isDefault) {
+        return;
     }
 
     if (!switchedToActive && !switchedToInactive) {
-        return ListenerResult::Propagate;
+        return;
     }
 
     bool selected = e->nongs()->active()->metadata()->uniqueID == m_uniqueID;
@@ -357,6 +337,77 @@ ListenerResult NongCell::onStateChange(event::SongStateChanged* e) {
     }
 
     m_selectButton->setSprite(selectSpr);
+}
+
+std::string NongCell::metadataText() const {
+    std::vector<std::string> metadataList = {};
+
+    switch (m_songInfo->type()) {
+        case NongType::YOUTUBE:
+            metadataList.push_back("youtube");
+            break;
+        case NongType::HOSTED:
+            metadataList.push_back("hosted");
+            break;
+        default:
+            break;
+    }
+
+    if (m_songInfo->indexID().has_value()) {
+        auto indexID = m_songInfo->indexID().value();
+        auto indexName = IndexManager::get().getIndexName(indexID);
+        metadataList.push_back(indexName.has_value() ? indexName.value()
+                                                     : indexID);
+    }
+
+    if (m_songInfo->metadata()->level.has_value()) {
+        metadataList.push_back(m_songInfo->metadata()->level.value());
+    }
+
+    if (m_isDownloaded) {
+        if (std::optional<AnalysisManager::Analysis> analysis =
+                AnalysisManager::get().find(m_songInfo->path().value())) {
+            const std::uint32_t seconds = analysis->durationMs / 1000;
+            std::string info =
+                fmt::format("{}:{:02}", seconds / 60, seconds % 60);
+            if (analysis->loudness.has_value()) {
+                info += fmt::format(" {:.1f} LUFS", analysis->loudness.value());
+            }
+            metadataList.push_back(std::move(info));
+        }
+    }
+
+    if (metadataList.empty()) {
+        return "";
+    }
+    return std::accumulate(std::next(metadataList.begin()), metadataList.end(),
+                           metadataList[0],
+                           [](const std::string& a, const std::string& b) {
+                               return a + ": " + b;
+                           });
+}
+
+ListenerResult NongCell::onSongAnalyzed(event::SongAnalyzed* e) {
+    if (!m_isDownloaded || e->path() != m_songInfo->path()) {
+        return ListenerResult::Propagate;
+    }
+
+    const std::string metadata = this->metadataText();
+    if (metadata.empty()) {
+        return ListenerResult::Propagate;
+    }
+    if (!m_metadataLabel) {
+        m_metadataLabel = CCLabelBMFont::create("", "bigFont.fnt");
+        m_metadataLabel->setColor({.r = 162, .g = 191, .b = 255});
+        m_metadataLabel->setID("metadata");
+        m_songInfoNode->addChild(m_metadataLabel);
+    }
+
+    const float songInfoWidth =
+        (this->getContentSize().width - 2 * PADDING_X) * (2.0f / 3.0f);
+    m_metadataLabel->setString(metadata.c_str());
+    m_metadataLabel->limitLabelWidth(songInfoWidth, 0.4f, 0.1f);
+    m_songInfoNode->updateLayout();
 
     return ListenerResult::Propagate;
 }
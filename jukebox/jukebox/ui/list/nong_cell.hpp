@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <string>
 
 #include <Geode/cocos/base_nodes/CCNode.h>
 #include <Geode/cocos/cocoa/CCObject.h>
@@ -8,20 +9,25 @@
 #include <Geode/loader/Event.hpp>
 
 #include <jukebox/events/get_song_info.hpp>
+#include <jukebox/events/song_analyzed.hpp>
 #include <jukebox/events/song_download_failed.hpp>
 #include <jukebox/events/song_download_finished.hpp>
 #include <jukebox/events/song_download_progress.hpp>
 #include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/events/song_subscriptions.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/unique_id.hpp>
 
 namespace jukebox {
 
 class NongDropdownLayer;
 
-class NongCell : public cocos2d::CCNode {
+class NongCell : public cocos2d::CCNode,
+                 public memory::Counted<NongCell> {
 protected:
     int m_songID;
-    std::string m_uniqueID;
+    UniqueID m_uniqueID;
     cocos2d::CCLabelBMFont* m_songNameLabel = nullptr;
     cocos2d::CCLabelBMFont* m_authorNameLabel = nullptr;
     cocos2d::CCLabelBMFont* m_metadataLabel = nullptr;
@@ -45,27 +51,31 @@ protected:
     cocos2d::CCMenu* m_downloadProgressContainer = nullptr;
     cocos2d::CCProgressTimer* m_downloadProgress = nullptr;
 
-    geode::EventListener<geode::EventFilter<event::SongDownloadProgress>>
-        m_progressListener{this, &NongCell::onDownloadProgress};
     geode::EventListener<geode::EventFilter<event::GetSongInfo>>
         m_songInfoListener{this, &NongCell::onGetSongInfo};
-    geode::EventListener<geode::EventFilter<event::SongDownloadFinished>>
-        m_downloadSuccessListener{this, &NongCell::onDownloadFinish};
-    geode::EventListener<geode::EventFilter<event::SongDownloadFailed>>
-        m_downloadFailedListener{this, &NongCell::onDownloadFailed};
-    geode::EventListener<geode::EventFilter<event::SongStateChanged>>
-        m_stateListener{this, &NongCell::onStateChange};
+    geode::EventListener<geode::EventFilter<event::SongAnalyzed>>
+        m_analyzedListener{this, &NongCell::onSongAnalyzed};
+    // Only get the events of this cell's song
+    event::SongSubscriptions::ProgressSubscription m_progressSubscription;
+    event::SongSubscriptions::FinishedSubscription m_finishedSubscription;
+    event::SongSubscriptions::FailedSubscription m_failedSubscription;
+    event::SongSubscriptions::StateSubscription m_stateSubscription;
 
     bool init(int songID, Song*, bool isDefault, bool selected,
               const cocos2d::CCSize& size, std::function<void()> onSelect,
               std::function<void()> onDelete, std::function<void()> onDownload,
               std::function<void()> onEdit);
 
-    geode::ListenerResult onDownloadProgress(event::SongDownloadProgress* e);
+    void onDownloadProgress(event::SongDownloadProgress* e);
     geode::ListenerResult onGetSongInfo(event::GetSongInfo* e);
-    geode::ListenerResult onDownloadFailed(event::SongDownloadFailed* e);
-    geode::ListenerResult onDownloadFinish(event::SongDownloadFinished* e);
-    geode::ListenerResult onStateChange(event::SongStateChanged* e);
+    geode::ListenerResult onSongAnalyzed(event::SongAnalyzed* e);
+    /**
+     * Type, index, level and, once analyzed, duration and loudness
+     */
+    std::string metadataText() const;
+    void onDownloadFailed(event::SongDownloadFailed* e);
+    void onDownloadFinish(event::SongDownloadFinished* e);
+    void onStateChange(event::SongStateChanged* e);
 
 public:
     Song* m_songInfo = nullptr;
@@ -1,9 +1,15 @@
 #include <jukebox/ui/list/nong_list.hpp>
 
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <string>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <GUI/CCControlExtension/CCScale9Sprite.h>
 #include <Geode/cocos/base_nodes/CCNode.h>
@@ -19,13 +25,16 @@
 #include <Geode/utils/cocos.hpp>
 
 #include <jukebox/events/nong_deleted.hpp>
+#include <jukebox/events/nongs_cleared.hpp>
 #include <jukebox/events/song_download_finished.hpp>
+#include <jukebox/managers/index_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
 #include <jukebox/nong/index.hpp>
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/list/index_song_cell.hpp>
 #include <jukebox/ui/list/nong_cell.hpp>
 #include <jukebox/ui/list/song_cell.hpp>
+#include <jukebox/utils/trigram_index.hpp>
 
 using namespace geode::prelude;
 
@@ -33,11 +42,11 @@ namespace jukebox {
 
 bool NongList::init(
     std::vector<int>& songIds, const cocos2d::CCSize& size,
-    std::function<void(int, const std::string&)> onSetActive,
-    std::function<void(int, const std::string&, bool onlyAudio, bool confirm)>
+    std::function<void(int, UniqueID)> onSetActive,
+    std::function<void(int, UniqueID, bool onlyAudio, bool confirm)>
         onDelete,
-    std::function<void(int, const std::string&)> onDownload,
-    std::function<void(int, const std::string&)> onEdit,
+    std::function<void(int, UniqueID)> onDownload,
+    std::function<void(int, UniqueID)> onEdit,
     std::function<void(std::optional<int>)> onListTypeChange) {
     if (!CCNode::init()) {
         return false;
@@ -90,12 +99,29 @@ bool NongList::init(
     m_onListTypeChange(m_currentSong);
 
     this->build();
+    this->schedule(schedule_selector(NongList::updateVisibleRows));
     return true;
 }
 
 void NongList::setDownloadProgress(std::string uniqueID, float progress) {}
 
+void NongList::setSearchQuery(std::string query) {
+    if (query == m_query) {
+        return;
+    }
+    m_query = std::move(query);
+    this->build();
+}
+
 void NongList::build() {
+    for (auto& [row, cell] : m_rowCells) {
+        this->recycleCell(cell);
+    }
+    m_rowCells.clear();
+    m_indexRows.clear();
+    m_indexRowsNode = nullptr;
+    m_firstRow = m_lastRow = 0;
+
     if (m_list->m_contentLayer->getChildrenCount() > 0) {
         m_list->m_contentLayer->removeAllChildrenWithCleanup(true);
     }
@@ -135,7 +161,7 @@ void NongList::build() {
 
         Nongs* nongs = optNongs.value();
         LocalSong* defaultSong = nongs->defaultSong();
-        std::string defaultID = defaultSong->metadata()->uniqueID;
+        UniqueID defaultID = defaultSong->metadata()->uniqueID;
         Song* active = nongs->active();
 
         m_list->m_contentLayer->addChild(NongCell::create(
@@ -156,54 +182,83 @@ void NongList::build() {
         std::unordered_set<std::string> localYt;
         std::unordered_set<std::string> localHosted;
 
-        if (nongs->locals().size() == 0 && nongs->youtube().size() == 0 &&
-            nongs->hosted().size() == 0) {
-            this->addNoLocalSongsNotice();
+        const bool searching = !m_query.empty();
+        auto storedMatches = [this, searching](Song* song) {
+            if (!searching) {
+                return true;
+            }
+            SongMetadata* metadata = song->metadata();
+            return TrigramIndex::matches(
+                fmt::format("{}\n{}", metadata->name, metadata->artist),
+                m_query);
+        };
+
+        // Each index searches its own prebuilt trigram index
+        std::unordered_set<index::IndexSongMetadata*> indexMatches;
+        if (searching) {
+            std::unordered_set<index::IndexMetadata*> searched;
+            for (index::IndexSongMetadata* song : nongs->indexSongs()) {
+                if (!searched.insert(song->parentID).second) {
+                    continue;
+                }
+                for (index::IndexSongMetadata* match :
+                     song->parentID->searchSongs(m_query)) {
+                    indexMatches.insert(match);
+                }
+            }
         }
 
-        for (std::unique_ptr<LocalSong>& nong : nongs->locals()) {
-            this->addSongToList(nong.get(), nongs);
+        if (nongs->songs().empty()) {
+            this->addNoLocalSongsNotice();
         }
 
-        for (std::unique_ptr<YTSong>& nong : nongs->youtube()) {
-            this->addSongToList(nong.get(), nongs);
-            if (nong->indexID().has_value()) {
-                localYt.insert(fmt::format("{}|{}", nong->indexID().value(),
-                                           nong->metadata()->uniqueID));
+        nongs->songs().forEach([&](auto& nong) {
+            using T = std::decay_t<decltype(nong)>;
+            if (storedMatches(&nong)) {
+                this->addSongToList(&nong, nongs);
             }
-        }
-
-        for (std::unique_ptr<HostedSong>& nong : nongs->hosted()) {
-            this->addSongToList(nong.get(), nongs);
-            if (nong->indexID().has_value()) {
-                localHosted.insert(fmt::format("{}|{}", nong->indexID().value(),
-                                               nong->metadata()->uniqueID));
+            if constexpr (!std::is_same_v<T, LocalSong>) {
+                if (!nong.indexID().has_value()) {
+                    return;
+                }
+                std::unordered_set<std::string>& local =
+                    std::is_same_v<T, YTSong> ? localYt : localHosted;
+                local.insert(fmt::format("{}|{}", nong.indexID().value(),
+                                         nong.metadata()->uniqueID));
             }
-        }
+        });
 
         if (nongs->indexSongs().size() > 0) {
-            CCLabelBMFont* indexLabel =
-                CCLabelBMFont::create("Download nongs", "goldFont.fnt");
-            indexLabel->setID("index-section");
-            indexLabel->setLayoutOptions(
-                AxisLayoutOptions::create()->setScaleLimits(0.2f, 0.6f));
-            m_list->m_contentLayer->addChild(indexLabel);
+            this->addIndexSection();
         }
 
-        for (index::IndexSongMetadata* index : nongs->indexSongs()) {
+        auto stored = [&localYt,
+                       &localHosted](index::IndexSongMetadata* index) {
             const std::string id =
                 fmt::format("{}|{}", index->parentID->m_id, index->uniqueID);
+            return (index->ytId.has_value() && localYt.contains(id)) ||
+                   (index->url.has_value() && localHosted.contains(id));
+        };
 
-            if (index->ytId.has_value() && localYt.contains(id)) {
+        for (index::IndexSongMetadata* index : nongs->indexSongs()) {
+            if (stored(index)) {
                 continue;
             }
 
-            if (index->url.has_value() && localHosted.contains(id)) {
+            // The same track stored from another index
+            IndexManager::IndexSongs mirrors =
+                IndexManager::get().getMirrors(id, index);
+            if (std::any_of(mirrors.begin(), mirrors.end(), stored)) {
+                continue;
+            }
+
+            if (searching && !indexMatches.contains(index)) {
                 continue;
             }
 
             this->addIndexSongToList(index, nongs);
         }
+        this->resetIndexRows();
     }
     m_list->m_contentLayer->updateLayout();
     this->scrollToTop();
@@ -216,11 +271,8 @@ void NongList::addSongToList(Song* nong, Nongs* parent, bool liveInsert) {
 
     CCSize itemSize = {m_list->getScaledContentSize().width, s_itemSize};
 
-    std::string uniqueID = nong->metadata()->uniqueID;
-    std::optional<std::filesystem::path> path = nong->path();
+    UniqueID uniqueID = nong->metadata()->uniqueID;
     bool isFromIndex = nong->indexID().has_value();
-    bool isDownloaded =
-        path.has_value() && std::filesystem::exists(path.value());
     NongCell* cell = NongCell::create(
         id, nong, uniqueID == defaultSong->metadata()->uniqueID,
         uniqueID == active->metadata()->uniqueID, itemSize,
@@ -245,13 +297,132 @@ void NongList::addSongToList(Song* nong, Nongs* parent, bool liveInsert) {
     }
 }
 
+void NongList::addIndexSection() {
+    if (m_indexRowsNode) {
+        return;
+    }
+
+    CCLabelBMFont* indexLabel =
+        CCLabelBMFont::create("Download nongs", "goldFont.fnt");
+    indexLabel->setID("index-section");
+    indexLabel->setLayoutOptions(
+        AxisLayoutOptions::create()->setScaleLimits(0.2f, 0.6f));
+    m_list->m_contentLayer->addChild(indexLabel);
+
+    m_indexRowsNode = CCNode::create();
+    m_indexRowsNode->setID("index-songs");
+    m_indexRowsNode->setAnchorPoint({0.5f, 0.5f});
+    m_indexRowsNode->setLayoutOptions(
+        AxisLayoutOptions::create()->setAutoScale(false));
+    m_list->m_contentLayer->addChild(m_indexRowsNode);
+}
+
 void NongList::addIndexSongToList(index::IndexSongMetadata* song,
                                   Nongs* parent) {
-    const CCSize itemSize = {m_list->getScaledContentSize().width, s_itemSize};
-    IndexSongCell* cell =
-        IndexSongCell::create(song, m_currentSong.value(), itemSize);
+    this->addIndexSection();
+    m_indexRows.push_back(song);
+}
+
+void NongList::removeIndexSong(index::IndexSongMetadata* song) {
+    if (std::erase(m_indexRows, song) > 0) {
+        this->resetIndexRows();
+    }
+}
+
+void NongList::resetIndexRows() {
+    if (!m_indexRowsNode) {
+        return;
+    }
+
+    for (auto& [row, cell] : m_rowCells) {
+        this->recycleCell(cell);
+    }
+    m_rowCells.clear();
+    m_firstRow = m_lastRow = 0;
+
+    // Rows have a fixed height, so the node is sized without laying out
+    // any cells
+    const float height =
+        m_indexRows.empty() ? 0.0f
+                            : m_indexRows.size() * s_rowStride - s_padding / 2;
+    m_indexRowsNode->setContentSize(
+        {m_list->getScaledContentSize().width, height});
+}
+
+IndexSongCell* NongList::takeCell(std::size_t row) {
+    index::IndexSongMetadata* song = m_indexRows[row];
+    IndexSongCell* cell = nullptr;
+
+    if (!m_cellPool.empty()) {
+        cell = m_cellPool.back();
+        // Stays alive through the parent it is added to below
+        m_indexRowsNode->addChild(cell);
+        m_cellPool.pop_back();
+        cell->setSong(song, m_currentSong.value());
+    } else {
+        const CCSize itemSize = {m_list->getScaledContentSize().width,
+                                 s_itemSize};
+        cell = IndexSongCell::create(song, m_currentSong.value(), itemSize);
+        m_indexRowsNode->addChild(cell);
+    }
+
     cell->setID(fmt::format("{}-{}", song->parentID->m_id, song->uniqueID));
-    m_list->m_contentLayer->addChild(cell);
+    cell->setPosition(
+        {m_indexRowsNode->getContentWidth() / 2,
+         m_indexRowsNode->getContentHeight() - row * s_rowStride -
+             s_itemSize / 2});
+    return cell;
+}
+
+void NongList::recycleCell(IndexSongCell* cell) {
+    m_cellPool.push_back(cell);
+    cell->removeFromParentAndCleanup(false);
+}
+
+void NongList::updateVisibleRows(float) {
+    if (!m_indexRowsNode || m_indexRows.empty() || !m_currentSong) {
+        return;
+    }
+
+    // The viewport in the rows node's space, rows are counted from the top
+    const float height = m_indexRowsNode->getContentHeight();
+    const float bottom = -m_list->m_contentLayer->getPositionY() -
+                         m_indexRowsNode->boundingBox().getMinY();
+    const float top = bottom + m_list->getContentHeight();
+    const float fromTop = std::clamp(height - top, 0.0f, height);
+    const float toTop = std::clamp(height - bottom, 0.0f, height);
+
+    std::size_t first = static_cast<std::size_t>(fromTop / s_rowStride);
+    std::size_t last = static_cast<std::size_t>(toTop / s_rowStride) + 1;
+    first = first > s_rowMargin ? first - s_rowMargin : 0;
+    last = std::min(m_indexRows.size(), last + s_rowMargin);
+
+    if (first == m_firstRow && last == m_lastRow) {
+        return;
+    }
+
+    for (auto it = m_rowCells.begin(); it != m_rowCells.end();) {
+        if (it->first >= first && it->first < last) {
+            it++;
+            continue;
+        }
+        this->recycleCell(it->second);
+        it = m_rowCells.erase(it);
+    }
+
+    for (std::size_t row = first; row < last; row++) {
+        if (!m_rowCells.contains(row)) {
+            m_rowCells.emplace(row, this->takeCell(row));
+        }
+    }
+
+    m_firstRow = first;
+    m_lastRow = last;
+}
+
+void NongList::relayout() {
+    m_list->m_contentLayer->updateLayout();
+    this->updateVisibleRows(0.0f);
 }
 
 void NongList::addNoLocalSongsNotice(bool liveInsert) {
@@ -278,6 +449,7 @@ void NongList::scrollToTop() {
     m_list->m_contentLayer->setPositionY(
         -m_list->m_contentLayer->getContentHeight() +
         m_list->getContentHeight());
+    this->updateVisibleRows(0.0f);
 }
 
 void NongList::onBack(cocos2d::CCObject* target) {
@@ -285,9 +457,7 @@ void NongList::onBack(cocos2d::CCObject* target) {
         return;
     }
 
-    m_currentSong = std::nullopt;
-    this->build();
-    this->scrollToTop();
+    this->showPage(std::nullopt);
     m_backBtn->setVisible(false);
 }
 
@@ -305,13 +475,114 @@ void NongList::onSelectSong(int songId) {
         return;
     }
 
-    m_currentSong = songId;
-    this->build();
-    this->scrollToTop();
+    this->showPage(songId);
     m_backBtn->setVisible(true);
 }
 
+void NongList::showPage(std::optional<int> songID) {
+    this->stashPage();
+    m_currentSong = songID;
+    if (!this->restorePage()) {
+        this->build();
+    }
+}
+
+void NongList::stashPage() {
+    for (auto& [row, cell] : m_rowCells) {
+        this->recycleCell(cell);
+    }
+    m_rowCells.clear();
+    m_firstRow = m_lastRow = 0;
+
+    CCArray* children = m_list->m_contentLayer->getChildren();
+    if (!children || children->count() == 0) {
+        return;
+    }
+
+    Page page{.songID = m_currentSong,
+              .query = m_query,
+              .nodes = CCArray::createWithArray(children),
+              .indexRows = std::move(m_indexRows),
+              .indexRowsNode = m_indexRowsNode};
+    m_indexRows.clear();
+    m_indexRowsNode = nullptr;
+    // Without cleanup, the cells keep their listeners and come back as
+    // they were
+    m_list->m_contentLayer->removeAllChildrenWithCleanup(false);
+
+    this->dropPage(page.songID);
+    m_pages.push_back(std::move(page));
+
+    const auto songPages =
+        std::count_if(m_pages.begin(), m_pages.end(),
+                      [](const Page& page) { return page.songID.has_value(); });
+    if (static_cast<std::size_t>(songPages) > s_cachedPages) {
+        m_pages.erase(std::find_if(
+            m_pages.begin(), m_pages.end(),
+            [](const Page& page) { return page.songID.has_value(); }));
+    }
+}
+
+bool NongList::restorePage() {
+    auto it = std::find_if(m_pages.begin(), m_pages.end(),
+                           [this](const Page& page) {
+                               return page.songID == m_currentSong;
+                           });
+    if (it == m_pages.end()) {
+        return false;
+    }
+
+    // The list of every song ID isn't searched
+    bool valid = !m_currentSong || it->query == m_query;
+    if (valid && m_currentSong) {
+        // An index may have been unloaded while the page was away
+        std::optional<Nongs*> nongs =
+            NongManager::get().getNongs(m_currentSong.value());
+        if (!nongs) {
+            valid = false;
+        } else {
+            const std::vector<index::IndexSongMetadata*>& current =
+                nongs.value()->indexSongs();
+            std::unordered_set<index::IndexSongMetadata*> loaded(
+                current.begin(), current.end());
+            valid = std::all_of(
+                it->indexRows.begin(), it->indexRows.end(),
+                [&loaded](index::IndexSongMetadata* song) {
+                    return loaded.contains(song);
+                });
+        }
+    }
+    if (!valid) {
+        m_pages.erase(it);
+        return false;
+    }
+
+    for (CCNode* node : CCArrayExt<CCNode*>(it->nodes.data())) {
+        m_list->m_contentLayer->addChild(node);
+    }
+    m_indexRows = std::move(it->indexRows);
+    m_indexRowsNode = it->indexRowsNode;
+    m_pages.erase(it);
+
+    if (m_onListTypeChange) {
+        m_onListTypeChange(m_currentSong);
+    }
+    m_list->m_contentLayer->updateLayout();
+    this->scrollToTop();
+    return true;
+}
+
+void NongList::dropPage(std::optional<int> songID) {
+    std::erase_if(m_pages, [songID](const Page& page) {
+        return page.songID == songID;
+    });
+}
+
 ListenerResult NongList::onDownloadFinish(event::SongDownloadFinished* e) {
+    if (m_currentSong != e->destination()->metadata()->gdID) {
+        // Built again the next time it's shown
+        this->dropPage(e->destination()->metadata()->gdID);
+    }
     if (!m_list || !m_currentSong.has_value() ||
         !e->indexSource().has_value()) {
         return ListenerResult::Propagate;
@@ -330,11 +601,7 @@ ListenerResult NongList::onDownloadFinish(event::SongDownloadFinished* e) {
         return ListenerResult::Propagate;
     }
 
-    index::IndexSongMetadata* meta = e->indexSource().value();
-    if (CCNode* i = m_list->m_contentLayer->getChildByID(
-            fmt::format("{}-{}", meta->parentID->m_id, meta->uniqueID))) {
-        i->removeFromParentAndCleanup(true);
-    }
+    this->removeIndexSong(e->indexSource().value());
 
     auto res = nongs->setActive(e->destination()->metadata()->uniqueID);
     if (!res) {
@@ -349,21 +616,24 @@ ListenerResult NongList::onDownloadFinish(event::SongDownloadFinished* e) {
         node->removeFromParentAndCleanup(true);
     }
 
-    m_list->m_contentLayer->updateLayout();
+    this->relayout();
 
     return ListenerResult::Propagate;
 }
 
 ListenerResult NongList::onNongDeleted(event::NongDeleted* e) {
+    if (m_currentSong != e->gdId()) {
+        this->dropPage(e->gdId());
+    }
     if (!m_list || !m_currentSong.has_value() ||
         m_currentSong.value() != e->gdId()) {
         return ListenerResult::Propagate;
     }
 
-    CCNode* found = m_list->m_contentLayer->getChildByID(e->uniqueId());
+    CCNode* found = m_list->m_contentLayer->getChildByID(e->uniqueId().str());
     if (found) {
         found->removeFromParentAndCleanup(true);
-        m_list->m_contentLayer->updateLayout();
+        this->relayout();
     }
 
     std::optional<Nongs*> optNongs =
@@ -380,23 +650,30 @@ ListenerResult NongList::onNongDeleted(event::NongDeleted* e) {
             continue;
         }
 
-        if (!m_list->m_contentLayer->getChildByID("index-section")) {
-            CCLabelBMFont* indexLabel =
-                CCLabelBMFont::create("Download nongs", "goldFont.fnt");
-            indexLabel->setID("index-section");
-            indexLabel->setLayoutOptions(
-                AxisLayoutOptions::create()->setScaleLimits(0.2f, 0.6f));
-            m_list->m_contentLayer->addChild(indexLabel);
-        }
-
         this->addIndexSongToList(i, nongs);
-        m_list->m_contentLayer->updateLayout();
+        this->resetIndexRows();
+        this->relayout();
     }
 
     return ListenerResult::Propagate;
 }
 
+ListenerResult NongList::onNongsCleared(event::NongsCleared* e) {
+    if (m_currentSong != e->gdId()) {
+        this->dropPage(e->gdId());
+        return ListenerResult::Propagate;
+    }
+    // Its cells pointed at the deleted songs
+    if (m_list) {
+        this->build();
+    }
+    return ListenerResult::Propagate;
+}
+
 ListenerResult NongList::onSongAdded(event::ManualSongAdded* e) {
+    if (m_currentSong != e->nongs()->songID()) {
+        this->dropPage(e->nongs()->songID());
+    }
     if (!m_list || !m_currentSong.has_value() ||
         m_currentSong.value() != e->nongs()->songID()) {
         return ListenerResult::Propagate;
@@ -409,17 +686,17 @@ ListenerResult NongList::onSongAdded(event::ManualSongAdded* e) {
         node->removeFromParentAndCleanup(true);
     }
 
-    m_list->m_contentLayer->updateLayout();
+    this->relayout();
     return ListenerResult::Propagate;
 }
 
 NongList* NongList::create(
     std::vector<int>& songIds, const cocos2d::CCSize& size,
-    std::function<void(int, const std::string&)> onSetActive,
-    std::function<void(int, const std::string&, bool onlyAudio, bool confirm)>
+    std::function<void(int, UniqueID)> onSetActive,
+    std::function<void(int, UniqueID, bool onlyAudio, bool confirm)>
         onDelete,
-    std::function<void(int, const std::string&)> onDownload,
-    std::function<void(int, const std::string&)> onEdit,
+    std::function<void(int, UniqueID)> onDownload,
+    std::function<void(int, UniqueID)> onEdit,
     std::function<void(std::optional<int>)> onListTypeChange) {
     auto ret = new NongList();
     if (!ret->init(songIds, size, onSetActive, onDelete, onDownload, onEdit,
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <GUI/CCControlExtension/CCScale9Sprite.h>
@@ -11,9 +14,11 @@
 #include <Geode/binding/CCMenuItemSpriteExtra.hpp>
 #include <Geode/loader/Event.hpp>
 #include <Geode/ui/ScrollLayer.hpp>
+#include <Geode/utils/cocos.hpp>
 
 #include <jukebox/events/manual_song_added.hpp>
 #include <jukebox/events/nong_deleted.hpp>
+#include <jukebox/events/nongs_cleared.hpp>
 #include <jukebox/events/song_download_finished.hpp>
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/list/index_song_cell.hpp>
@@ -33,58 +38,118 @@ protected:
 
     CCMenuItemSpriteExtra* m_backBtn = nullptr;
 
-    std::function<void(int, const std::string&)> m_onSetActive;
-    std::function<void(int, const std::string&, bool onlyAudio, bool confirm)>
-        m_onDelete;
-    std::function<void(int, const std::string&)> m_onDownload;
-    std::function<void(int, const std::string&)> m_onEdit;
+    std::function<void(int, UniqueID)> m_onSetActive;
+    std::function<void(int, UniqueID, bool onlyAudio, bool confirm)> m_onDelete;
+    std::function<void(int, UniqueID)> m_onDownload;
+    std::function<void(int, UniqueID)> m_onEdit;
     std::function<void(std::optional<int>)> m_onListTypeChange;
 
     std::vector<NongCell*> listedNongCells;
 
+    // Index songs are virtualized. One node reserves the height of every
+    // row, and cells only exist for the rows near the viewport, recycled
+    // through a pool as the list scrolls
+    std::vector<index::IndexSongMetadata*> m_indexRows;
+    cocos2d::CCNode* m_indexRowsNode = nullptr;
+    // row -> cell showing it
+    std::unordered_map<std::size_t, IndexSongCell*> m_rowCells;
+    std::vector<geode::Ref<IndexSongCell>> m_cellPool;
+    // Rows with cells, [first, last)
+    std::size_t m_firstRow = 0;
+    std::size_t m_lastRow = 0;
+
+    // Only songs matching every word of this are listed
+    std::string m_query;
+
+    // The nodes of a list that was left for another one, kept to be shown
+    // again as they are
+    struct Page {
+        // std::nullopt for the list of every song ID
+        std::optional<int> songID;
+        std::string query;
+        geode::Ref<cocos2d::CCArray> nodes;
+        std::vector<index::IndexSongMetadata*> indexRows;
+        // One of nodes
+        cocos2d::CCNode* indexRowsNode = nullptr;
+    };
+
+    // Most recently left last
+    std::vector<Page> m_pages;
+    // Song pages kept, the page of every song ID is kept besides these
+    static constexpr std::size_t s_cachedPages = 4;
+
     geode::EventListener<geode::EventFilter<event::SongDownloadFinished>>
         m_downloadFinishedListener = {this, &NongList::onDownloadFinish};
     geode::EventListener<geode::EventFilter<event::NongDeleted>>
         m_nongDeletedListener = {this, &NongList::onNongDeleted};
+    geode::EventListener<geode::EventFilter<event::NongsCleared>>
+        m_nongsClearedListener = {this, &NongList::onNongsCleared};
     geode::EventListener<geode::EventFilter<event::ManualSongAdded>>
         m_nongAddedListener = {this, &NongList::onSongAdded};
 
     static constexpr float s_padding = 10.0f;
     static constexpr float s_itemSize = 60.f;
+    static constexpr float s_rowStride = s_itemSize + s_padding / 2;
+    // Rows past each edge of the viewport that get cells too
+    static constexpr std::size_t s_rowMargin = 2;
 
     void addNoLocalSongsNotice(bool liveInsert = false);
     void addSongToList(Song* nong, Nongs* parent, bool liveInsert = false);
+    void addIndexSection();
     void addIndexSongToList(index::IndexSongMetadata* song, Nongs* parent);
+    void removeIndexSong(index::IndexSongMetadata* song);
+    // Sizes the index rows node for its rows and drops their cells
+    void resetIndexRows();
+    IndexSongCell* takeCell(std::size_t row);
+    void recycleCell(IndexSongCell* cell);
+    void updateVisibleRows(float dt);
+    // Lays out the list, then fills in the visible index rows
+    void relayout();
+    // Switches to the list of a song ID, or of every song ID, reusing its
+    // page if it was built before
+    void showPage(std::optional<int> songID);
+    // Detaches the nodes of the current list into m_pages
+    void stashPage();
+    // Shows the page of the current song from m_pages, if there's one
+    bool restorePage();
+    void dropPage(std::optional<int> songID);
     geode::ListenerResult onDownloadFinish(event::SongDownloadFinished* e);
     geode::ListenerResult onNongDeleted(event::NongDeleted* e);
+    geode::ListenerResult onNongsCleared(event::NongsCleared* e);
     geode::ListenerResult onSongAdded(event::ManualSongAdded* e);
 
 public:
     void scrollToTop();
     void setCurrentSong(int songId);
+    /**
+     * Builds the current list from scratch
+     */
     void build();
     void onBack(cocos2d::CCObject*);
     void onSelectSong(int songId);
     void setDownloadProgress(std::string uniqueID, float progress);
+    /**
+     * Filters the songs by name, artist and index name, then rebuilds the
+     * list
+     */
+    void setSearchQuery(std::string query);
 
     static NongList* create(
         std::vector<int>& songIds, const cocos2d::CCSize& size,
-        std::function<void(int, const std::string&)> onSetActive,
-        std::function<void(int, const std::string&, bool onlyAudio,
-                           bool confirm)>
+        std::function<void(int, UniqueID)> onSetActive,
+        std::function<void(int, UniqueID, bool onlyAudio, bool confirm)>
             onDelete,
-        std::function<void(int, const std::string&)> onDownload,
-        std::function<void(int, const std::string&)> onEdit,
+        std::function<void(int, UniqueID)> onDownload,
+        std::function<void(int, UniqueID)> onEdit,
         std::function<void(std::optional<int>)> onListTypeChange = {});
 
 protected:
     bool init(std::vector<int>& songIds, const cocos2d::CCSize& size,
-              std::function<void(int, const std::string&)> onSetActive,
-              std::function<void(int, const std::string&, bool onlyAudio,
-                                 bool confirm)>
+              std::function<void(int, UniqueID)> onSetActive,
+              std::function<void(int, UniqueID, bool onlyAudio, bool confirm)>
                   onDelete,
-              std::function<void(int, const std::string&)> onDownload,
-              std::function<void(int, const std::string&)> onEdit,
+              std::function<void(int, UniqueID)> onDownload,
+              std::function<void(int, UniqueID)> onEdit,
               std::function<void(std::optional<int>)> onListTypeChange = {});
 };
 
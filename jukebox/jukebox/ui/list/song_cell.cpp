@@ -8,6 +8,8 @@
 #include <Geode/binding/CCMenuItemSpriteExtra.hpp>
 #include <Geode/ui/Layout.hpp>
 
+#include <jukebox/events/song_state_changed.hpp>
+#include <jukebox/events/song_subscriptions.hpp>
 #include <jukebox/nong/nong.hpp>
 
 using namespace geode::prelude;
@@ -63,9 +65,21 @@ bool SongCell::init(int id, SongMetadata* songInfo, const CCSize& size,
     menu->addChild(btn);
     this->addChild(menu);
     menu->setPosition(ccp(290.f, 30.f));
+
+    m_stateSubscription = event::SongSubscriptions::get().onStateChanged(
+        m_songID,
+        [this](event::SongStateChanged* e) { this->onStateChange(e); });
     return true;
 }
 
 void SongCell::onSelectSong(CCObject*) { m_callback(); }
 
+void SongCell::onStateChange(event::SongStateChanged* e) {
+    m_active = e->nongs()->active()->metadata();
+    m_songNameLabel->setString(m_active->name.c_str());
+    m_songNameLabel->limitLabelWidth(240.f, 0.8f, 0.1f);
+    m_authorNameLabel->setString(m_active->artist.c_str());
+    m_authorNameLabel->limitLabelWidth(260.f, 0.6f, 0.1f);
+}
+
 }  // namespace jukebox
@@ -8,13 +8,16 @@
 #include <Geode/cocos/label_nodes/CCLabelBMFont.h>
 #include <Geode/cocos/platform/CCPlatformMacros.h>
 
+#include <jukebox/events/song_subscriptions.hpp>
 #include <jukebox/nong/nong.hpp>
+#include <jukebox/utils/memory_usage.hpp>
 
 namespace jukebox {
 
 class NongDropdownLayer;
 
-class SongCell : public cocos2d::CCNode {
+class SongCell : public cocos2d::CCNode,
+                 public memory::Counted<SongCell> {
 protected:
     SongMetadata* m_active;
     cocos2d::CCLabelBMFont* m_songNameLabel;
@@ -23,6 +26,8 @@ protected:
     int m_songID;
 
     std::function<void()> m_callback;
+    // Keeps the labels on the active song while the cell is cached
+    event::SongSubscriptions::StateSubscription m_stateSubscription;
 
     bool init(int id, SongMetadata* songInfo, const cocos2d::CCSize& size,
               std::function<void()> selectCallback);
@@ -39,6 +44,7 @@ public:
         return nullptr;
     }
     void onSelectSong(CCObject*);
+    void onStateChange(event::SongStateChanged* e);
 };
 
 }  // namespace jukebox
@@ -17,14 +17,12 @@
 #include <Geode/cocos/cocoa/CCObject.h>
 #include <Geode/cocos/menu_nodes/CCMenu.h>
 #include <Geode/cocos/sprite_nodes/CCSprite.h>
-#include <fmod_common.h>
 #include <fmt/core.h>
 #include <Geode/Result.hpp>
 #include <Geode/binding/ButtonSprite.hpp>
 #include <Geode/binding/CCMenuItemSpriteExtra.hpp>
 #include <Geode/binding/FLAlertLayer.hpp>
 #include <Geode/binding/FLAlertLayerProtocol.hpp>
-#include <Geode/binding/FMODAudioEngine.hpp>
 #include <Geode/loader/Log.hpp>
 #include <Geode/loader/Mod.hpp>
 #include <Geode/ui/Layout.hpp>
@@ -33,13 +31,15 @@
 #include <Geode/utils/Task.hpp>
 #include <Geode/utils/file.hpp>
 #include <Geode/utils/string.hpp>
-#include <fmod.hpp>
 
 #include <jukebox/events/manual_song_added.hpp>
+#include <jukebox/managers/analysis_manager.hpp>
+#include <jukebox/managers/blob_store.hpp>
 #include <jukebox/managers/index_manager.hpp>
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/index_choose_popup.hpp>
 #include <jukebox/utils/random_string.hpp>
+#include <jukebox/utils/tag_reader.hpp>
 
 using namespace geode::prelude;
 using namespace jukebox::index;
@@ -50,21 +50,6 @@ void setInputProps(TextInput* i) {
     i->getInputNode()->setLabelPlaceholderScale(0.7f);
 }
 
-std::optional<std::string> parseFromFMODTag(const FMOD_TAG& tag) {
-    std::string ret = "";
-#ifdef GEODE_IS_WINDOWS
-    if (tag.datatype == FMOD_TAGDATATYPE_STRING_UTF16) {
-        return geode::utils::string::wideToUtf8(
-            reinterpret_cast<const wchar_t*>(tag.data));
-    } else if (tag.datatype == FMOD_TAGDATATYPE_STRING_UTF16BE) {
-        // I'm a big endian hater, whachu gonna do?
-        return std::nullopt;
-    }
-#endif
-
-    return std::string(reinterpret_cast<const char*>(tag.data), tag.datalen);
-}
-
 class IndexDisclaimerPopup : public FLAlertLayer, public FLAlertLayerProtocol {
 protected:
     std::function<void(FLAlertLayer*, bool)> m_selected;
@@ -284,8 +269,19 @@ bool NongAddPopup::setup(int songID, std::optional<Song*> replacedNong) {
     if (edit->metadata()->level.has_value()) {
         m_levelNameInput->setString(edit->metadata()->level.value());
     }
-    m_startOffsetInput->setString(
-        std::to_string(edit->metadata()->startOffset));
+    int startOffset = edit->metadata()->startOffset;
+    if (startOffset == 0 && edit->path().has_value()) {
+        // Suggest the offset found by analysis if none was set yet
+        std::optional<AnalysisManager::Analysis> analysis =
+            AnalysisManager::get().find(edit->path().value());
+        if (analysis.has_value()) {
+            auto it = analysis->offsets.find(m_songID);
+            if (it != analysis->offsets.end() && it->second.has_value()) {
+                startOffset = it->second.value();
+            }
+        }
+    }
+    m_startOffsetInput->setString(std::to_string(startOffset));
 
     switch (edit->type()) {
         case NongType::LOCAL:
@@ -410,49 +406,12 @@ void NongAddPopup::onFileOpen(
         }
 
         if (Mod::get()->getSettingValue<bool>("autocomplete-metadata")) {
-            auto meta = this->tryParseMetadata(path);
-            if (meta && (meta->artist.has_value() || meta->name.has_value())) {
-                auto artistName = m_artistNameInput->getString();
-                auto songName = m_songNameInput->getString();
-
-                if (artistName.size() > 0 || songName.size() > 0) {
-                    // We should ask before replacing stuff
-                    std::stringstream ss;
-
-                    ss << "Found metadata for the imported song: ";
-                    if (meta->name.has_value()) {
-                        ss << fmt::format("Name: \"{}\". ", meta->name.value());
-                    }
-                    if (meta->artist.has_value()) {
-                        ss << fmt::format("Artist: \"{}\". ",
-                                          meta->artist.value());
-                    }
-
-                    ss << "Do you want to set those values for the song?";
-
-                    createQuickPopup(
-                        "Metadata found", ss.str(), "No", "Yes",
-                        [this, meta](auto, bool btn2) {
-                            if (!btn2) {
-                                return;
-                            }
-                            if (meta->artist.has_value()) {
-                                m_artistNameInput->setString(
-                                    meta->artist.value());
-                            }
-                            if (meta->name.has_value()) {
-                                m_songNameInput->setString(meta->name.value());
-                            }
-                        });
-                } else {
-                    if (meta->artist.has_value()) {
-                        m_artistNameInput->setString(meta->artist.value());
-                    }
-                    if (meta->name.has_value()) {
-                        m_songNameInput->setString(meta->name.value());
-                    }
+            m_tagListener.bind([this](TagTask::Event* event) {
+                if (SongTags* tags = event->getValue()) {
+                    this->applyTags(*tags);
                 }
-            }
+            });
+            m_tagListener.setFilter(readTagsInBackground(path));
         }
 
         m_localPath = path;
@@ -460,6 +419,47 @@ void NongAddPopup::onFileOpen(
     }
 }
 
+void NongAddPopup::applyTags(const SongTags& tags) {
+    if (tags.empty() || m_songType != SongType::LOCAL) {
+        return;
+    }
+
+    auto apply = [this, tags]() {
+        if (tags.artist.has_value()) {
+            m_artistNameInput->setString(tags.artist.value());
+        }
+        if (tags.title.has_value()) {
+            m_songNameInput->setString(tags.title.value());
+        }
+    };
+
+    if (m_artistNameInput->getString().empty() &&
+        m_songNameInput->getString().empty()) {
+        apply();
+        return;
+    }
+
+    // We should ask before replacing stuff
+    std::stringstream ss;
+
+    ss << "Found metadata for the imported song: ";
+    if (tags.title.has_value()) {
+        ss << fmt::format("Name: \"{}\". ", tags.title.value());
+    }
+    if (tags.artist.has_value()) {
+        ss << fmt::format("Artist: \"{}\". ", tags.artist.value());
+    }
+
+    ss << "Do you want to set those values for the song?";
+
+    createQuickPopup("Metadata found", ss.str(), "No", "Yes",
+                     [apply](auto, bool btn2) {
+                         if (btn2) {
+                             apply();
+                         }
+                     });
+}
+
 void NongAddPopup::setSongType(SongType type) {
     if (m_songType == type) {
         return;
@@ -599,12 +599,14 @@ void NongAddPopup::addSong(CCObject* target) {
     }
 
     if (m_songType == SongType::LOCAL) {
+        // The file is imported in the background, the popup closes once the
+        // song is stored
         auto res =
             this->addLocalSong(songName, artistName, levelName, startOffset);
         if (res.isErr()) {
             FLAlertLayer::create("Error", res.unwrapErr(), "Ok")->show();
-            return;
         }
+        return;
     } else if (m_songType == SongType::YOUTUBE) {
         auto res =
             this->addYTSong(songName, artistName, levelName, startOffset);
@@ -629,6 +631,10 @@ void NongAddPopup::addSong(CCObject* target) {
 geode::Result<> NongAddPopup::addLocalSong(
     const std::string& songName, const std::string& artistName,
     const std::optional<std::string> levelName, int offset) {
+    if (m_importing) {
+        return Err("The song is still being imported.");
+    }
+
     if (!m_localPath.has_value()) {
         return Err("No file selected.");
     }
@@ -666,7 +672,7 @@ geode::Result<> NongAddPopup::addLocalSong(
     }
 
     std::string id = m_replacedNong.has_value()
-                         ? m_replacedNong.value()->metadata()->uniqueID
+                         ? m_replacedNong.value()->metadata()->uniqueID.str()
                          : jukebox::random_string(16);
     std::string unique = fmt::format("{}{}", id, extension);
     std::filesystem::path destination = Mod::get()->getSaveDir() / "nongs";
@@ -678,28 +684,82 @@ geode::Result<> NongAddPopup::addLocalSong(
     }
     destination /= unique;
 
-    if (destination.compare(path) != 0) {
-        bool result = std::filesystem::copy_file(
-            path, destination,
-            std::filesystem::copy_options::overwrite_existing, error_code);
-        if (error_code) {
-            return Err(fmt::format(
-                "Failed to save song. Please try again! Error category: {}, "
-                "message: {}",
-                error_code.category().name(),
-                error_code.category().message(error_code.value())));
-        }
-        if (!result) {
-            return Err(
-                "Failed to copy song to Jukebox's songs folder. Please try "
-                "again.");
-        }
-    }
-
     LocalSong song = LocalSong{
-        SongMetadata{m_songID, id, songName, artistName, levelName, offset},
+        SongMetadata{m_songID, UniqueID(id), songName, artistName, levelName,
+                     offset},
         destination};
 
+    if (destination.compare(path) == 0) {
+        GEODE_UNWRAP(this->storeLocalSong(std::move(song)));
+        FLAlertLayer::create("Success", "Song was added successfuly!", "Ok")
+            ->show();
+        this->onClose(this);
+        return Ok();
+    }
+
+    // The old file may be shared with other songs through its blob, so
+    // it's unlinked instead of overwritten
+    if (std::error_code ec = BlobStore::get().remove(destination)) {
+        return Err(fmt::format("Failed to replace the old song file: {}",
+                               ec.message()));
+    }
+
+    m_importing = true;
+    m_importListener.bind(
+        [this, song = std::move(song)](ImportTask::Event* event) {
+            this->onImportEvent(event, song);
+        });
+    m_importListener.setFilter(importFile(path, destination));
+
+    return Ok();
+}
+
+void NongAddPopup::onImportEvent(ImportTask::Event* event,
+                                 const LocalSong& song) {
+    ButtonSprite* label =
+        static_cast<ButtonSprite*>(m_addSongButton->getNormalImage());
+
+    if (float* progress = event->getProgress()) {
+        label->setString(fmt::format("{:.0f}%", *progress).c_str());
+        return;
+    }
+
+    if (event->isCancelled()) {
+        m_importing = false;
+        label->setString(m_replacedNong.has_value() ? "Edit" : "Add");
+        return;
+    }
+
+    Result<>* result = event->getValue();
+    if (!result) {
+        return;
+    }
+
+    m_importing = false;
+    label->setString(m_replacedNong.has_value() ? "Edit" : "Add");
+
+    if (result->isErr()) {
+        FLAlertLayer::create(
+            "Error",
+            fmt::format("Failed to save song. Please try again! {}",
+                        result->unwrapErr()),
+            "Ok")
+            ->show();
+        return;
+    }
+
+    if (Result<> res = this->storeLocalSong(LocalSong(song)); res.isErr()) {
+        FLAlertLayer::create("Error", res.unwrapErr(), "Ok")->show();
+        return;
+    }
+
+    FLAlertLayer::create("Success", "Song was added successfuly!", "Ok")
+        ->show();
+    this->onClose(this);
+}
+
+Result<> NongAddPopup::storeLocalSong(LocalSong&& song) {
+    std::filesystem::path destination = song.path().value();
     Nongs* nongs = NongManager::get().getNongs(m_songID).value();
 
     if (m_replacedNong.has_value()) {
@@ -719,6 +779,7 @@ geode::Result<> NongAddPopup::addLocalSong(
     }
 
     (void)nongs->commit();
+    BlobStore::get().intern(destination);
 
     return Ok();
 }
@@ -766,7 +827,7 @@ geode::Result<> NongAddPopup::addYTSong(
             m_songID,
             m_replacedNong.has_value()
                 ? m_replacedNong.value()->metadata()->uniqueID
-                : jukebox::random_string(16),
+                : UniqueID(jukebox::random_string(16)),
             songName,
             artistName,
             levelName,
@@ -812,12 +873,12 @@ geode::Result<> NongAddPopup::addHostedSong(
         return Err("No URL specified");
     }
 
-    std::string id;
+    UniqueID id;
 
     if (m_replacedNong.has_value()) {
         id = m_replacedNong.value()->metadata()->uniqueID;
     } else {
-        id = jukebox::random_string(16);
+        id = UniqueID(jukebox::random_string(16));
     }
 
     Nongs* nongs = NongManager::get().getNongs(m_songID).value();
@@ -854,58 +915,6 @@ geode::Result<> NongAddPopup::addHostedSong(
     return Ok();
 }
 
-std::optional<NongAddPopup::ParsedMetadata> NongAddPopup::tryParseMetadata(
-    std::filesystem::path path) {
-    const char* MP3_NAME_TAG = "TIT2";
-    const char* MP3_ARTIST_TAG = "TPE1";
-
-    const char* OGG_FLAC_NAME_TAG = "TITLE";
-    const char* OGG_FLAC_ARTIST_TAG = "ARTIST";
-
-    const char* WAV_NAME_TAG = "INAM";
-    const char* WAV_ARTIST_TAG = "IART";
-
-    // Thanks to undefined06855 for most of this stuff
-    // https://github.com/undefined06855/EditorMusic/blob/main/src/AudioManager.cpp
-
-    NongAddPopup::ParsedMetadata ret{};
-    FMOD::Sound* sound;
-    FMOD::System* system = FMODAudioEngine::sharedEngine()->m_system;
-
-    system->createSound(path.string().c_str(), FMOD_LOOP_NORMAL, nullptr,
-                        &sound);
-
-    if (!sound) {
-        return std::nullopt;
-    }
-
-    FMOD_TAG nameTag = {};
-    FMOD_TAG artistTag = {};
-    FMOD_RESULT nameResult;
-    FMOD_RESULT artistResult;
-
-    const std::string extension = path.extension().string();
-    if (extension == ".mp3") {
-        nameResult = sound->getTag(MP3_NAME_TAG, 0, &nameTag);
-        artistResult = sound->getTag(MP3_ARTIST_TAG, 0, &artistTag);
-    } else if (extension == ".ogg" || extension == ".flac") {
-        nameResult = sound->getTag(OGG_FLAC_NAME_TAG, 0, &nameTag);
-        artistResult = sound->getTag(OGG_FLAC_ARTIST_TAG, 0, &artistTag);
-    } else if (extension == ".wav") {
-        nameResult = sound->getTag(WAV_NAME_TAG, 0, &nameTag);
-        artistResult = sound->getTag(WAV_ARTIST_TAG, 0, &artistTag);
-    }
-
-    if (nameResult != FMOD_ERR_TAGNOTFOUND) {
-        ret.name = parseFromFMODTag(nameTag);
-    }
-    if (artistResult != FMOD_ERR_TAGNOTFOUND) {
-        ret.artist = parseFromFMODTag(artistTag);
-    }
-
-    return ret;
-}
-
 NongAddPopup* NongAddPopup::create(int songID,
                                    std::optional<Song*> replacedNong) {
     auto ret = new NongAddPopup();
@@ -18,6 +18,8 @@
 
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/nong_dropdown_layer.hpp>
+#include <jukebox/utils/file_import.hpp>
+#include <jukebox/utils/tag_reader.hpp>
 
 namespace jukebox {
 
@@ -31,11 +33,6 @@ protected:
         HOSTED,
     };
 
-    struct ParsedMetadata {
-        std::optional<std::string> name;
-        std::optional<std::string> artist;
-    };
-
     int m_songID;
 
     std::vector<std::string> m_publishableIndexes;
@@ -75,10 +72,20 @@ protected:
 
     std::optional<Song*> m_replacedNong;
 
+    geode::EventListener<ImportTask> m_importListener;
+    bool m_importing = false;
+
+    geode::EventListener<TagTask> m_tagListener;
+
     bool setup(int songID, std::optional<Song*> replacedNong) override;
     void addPathLabel(std::string const& path);
     void onFileOpen(
         geode::Task<geode::Result<std::filesystem::path>>::Event* event);
+    /**
+     * Fills in the song and artist names from the picked file's tags, asks
+     * first if either was already typed in
+     */
+    void applyTags(const SongTags& tags);
     void setSongType(SongType type);
     void onSwitchToLocal(cocos2d::CCObject*);
     void onSwitchToYT(cocos2d::CCObject*);
@@ -91,6 +98,11 @@ protected:
                                  const std::string& artistName,
                                  const std::optional<std::string> levelName,
                                  int offset);
+    /**
+     * Adds or replaces the song once its file is in the nongs directory
+     */
+    geode::Result<> storeLocalSong(LocalSong&& song);
+    void onImportEvent(ImportTask::Event* event, const LocalSong& song);
     geode::Result<> addYTSong(const std::string& songName,
                               const std::string& artistName,
                               const std::optional<std::string> levelName,
@@ -100,7 +112,6 @@ protected:
                                   const std::optional<std::string> levelName,
                                   int offset);
     void onPublish(cocos2d::CCObject*);
-    std::optional<ParsedMetadata> tryParseMetadata(std::filesystem::path path);
 
 public:
     static NongAddPopup* create(int songID,
@@ -1,5 +1,7 @@
 #include <jukebox/ui/nong_dropdown_layer.hpp>
 
+#include <cstddef>
+#include <filesystem>
 #include <optional>
 #include <string>
 #include <vector>
@@ -20,10 +22,16 @@
 #include <Geode/ui/GeodeUI.hpp>
 #include <Geode/ui/Layout.hpp>
 #include <Geode/ui/Popup.hpp>
+#include <Geode/ui/TextInput.hpp>
+#include <Geode/utils/Task.hpp>
+#include <Geode/utils/file.hpp>
 #include <Geode/utils/web.hpp>
 
 #include <jukebox/events/get_song_info.hpp>
+#include <jukebox/events/manual_song_added.hpp>
+#include <jukebox/managers/bundle_manager.hpp>
 #include <jukebox/managers/index_manager.hpp>
+#include <jukebox/managers/library_import_manager.hpp>
 #include <jukebox/managers/nong_manager.hpp>
 #include <jukebox/nong/nong.hpp>
 #include <jukebox/ui/list/nong_list.hpp>
@@ -57,6 +65,15 @@ bool NongDropdownLayer::setup(std::vector<int> ids, CustomSongWidget* parent,
     manifestLabel->setID("manifest-label");
     m_mainLayer->addChild(manifestLabel);
 
+    m_bulkLabel = CCLabelBMFont::create("", "chatFont.fnt");
+    m_bulkLabel->setPosition(contentSize.width / 2, 24.f);
+    m_bulkLabel->setScale(0.6f);
+    m_bulkLabel->setID("download-all-label");
+    m_mainLayer->addChild(m_bulkLabel);
+    this->updateBulkProgress(0.f);
+    this->schedule(schedule_selector(NongDropdownLayer::updateBulkProgress),
+                   0.1f);
+
     CCMenu* menu = CCMenu::create();
     menu->setID("bottom-right-menu");
     CCSprite* spr = CCSprite::createWithSpriteFrameName("GJ_plusBtn_001.png");
@@ -77,6 +94,27 @@ bool NongDropdownLayer::setup(std::vector<int> ids, CustomSongWidget* parent,
         spr, this, menu_selector(NongDropdownLayer::deleteAllNongs));
     m_deleteBtn = removeBtn;
 
+    spr = CCSprite::createWithSpriteFrameName("GJ_downloadBtn_001.png");
+    spr->setScale(0.6f);
+    CCMenuItemSpriteExtra* downloadAllBtn = CCMenuItemSpriteExtra::create(
+        spr, this, menu_selector(NongDropdownLayer::onDownloadAll));
+    downloadAllBtn->setID("download-all-button");
+    m_downloadAllBtn = downloadAllBtn;
+
+    spr = CCSprite::createWithSpriteFrameName("gj_folderBtn_001.png");
+    spr->setScale(0.7f);
+    CCMenuItemSpriteExtra* importFolderBtn = CCMenuItemSpriteExtra::create(
+        spr, this, menu_selector(NongDropdownLayer::onImportFolder));
+    importFolderBtn->setID("import-folder-button");
+    m_importFolderBtn = importFolderBtn;
+
+    spr = CCSprite::createWithSpriteFrameName("GJ_shareBtn_001.png");
+    spr->setScale(0.4f);
+    CCMenuItemSpriteExtra* bundleBtn = CCMenuItemSpriteExtra::create(
+        spr, this, menu_selector(NongDropdownLayer::onBundle));
+    bundleBtn->setID("bundle-button");
+    m_bundleBtn = bundleBtn;
+
     if (isMultiple) {
         m_addBtn->setVisible(false);
         m_deleteBtn->setVisible(false);
@@ -84,9 +122,13 @@ bool NongDropdownLayer::setup(std::vector<int> ids, CustomSongWidget* parent,
         m_addBtn->setVisible(true);
         m_deleteBtn->setVisible(true);
     }
+    m_downloadAllBtn->setVisible(isMultiple);
     menu->addChild(addBtn);
     menu->addChild(discordBtn);
     menu->addChild(removeBtn);
+    menu->addChild(downloadAllBtn);
+    menu->addChild(importFolderBtn);
+    menu->addChild(bundleBtn);
     ColumnLayout* layout = ColumnLayout::create();
     layout->setAxisAlignment(AxisAlignment::Start);
     menu->setContentSize({addBtn->getScaledContentSize().width, 200.f});
@@ -139,6 +181,18 @@ bool NongDropdownLayer::setup(std::vector<int> ids, CustomSongWidget* parent,
     topRightArt->setFlipX(true);
     m_mainLayer->addChildAtPosition(topRightArt, Anchor::TopRight);
 
+    m_searchInput = TextInput::create(160.f, "Search", "chatFont.fnt");
+    m_searchInput->setID("search-input");
+    m_searchInput->setCommonFilter(CommonFilter::Any);
+    m_searchInput->setScale(0.6f);
+    m_searchInput->setCallback([this](const std::string& query) {
+        if (m_list) {
+            m_list->setSearchQuery(query);
+        }
+    });
+    m_mainLayer->addChildAtPosition(m_searchInput, Anchor::TopLeft,
+                                    CCPoint{70.0f, -14.0f});
+
     this->createList();
     CCSprite* title =
         CCSprite::createWithSpriteFrameName("JB_ListLogo.png"_spr);
@@ -201,21 +255,174 @@ void NongDropdownLayer::openAddPopup(CCObject* target) {
     NongAddPopup::create(m_currentSongID.value())->show();
 }
 
+void NongDropdownLayer::onDownloadAll(CCObject*) {
+    Result<std::size_t> res = IndexManager::get().downloadAll(m_songIDS);
+    if (res.isErr()) {
+        FLAlertLayer::create(
+            "Failed",
+            fmt::format("Failed to download songs: {}", res.unwrapErr()), "Ok")
+            ->show();
+        return;
+    }
+    if (res.unwrap() == 0) {
+        FLAlertLayer::create("Nothing to download",
+                             "Every song of this level with index NONGs "
+                             "already has one downloaded.",
+                             "Ok")
+            ->show();
+    }
+    this->updateBulkProgress(0.f);
+}
+
+void NongDropdownLayer::onImportFolder(CCObject*) {
+    std::string pattern =
+        Mod::get()->getSettingValue<std::string>("library-import-pattern");
+    createQuickPopup(
+        "Import folder",
+        fmt::format("Every song file in the folder you pick is added to the "
+                    "song ID in its file name, following the pattern "
+                    "<cy>{}</c> from the settings. Names and artists are read "
+                    "from the song tags.",
+                    pattern),
+        "Cancel", "Pick", [this](auto, bool btn2) {
+            if (!btn2) {
+                return;
+            }
+            m_folderPickListener.bind(this,
+                                      &NongDropdownLayer::onFolderPicked);
+            m_folderPickListener.setFilter(
+                file::pick(file::PickMode::OpenFolder, {}));
+        });
+}
+
+void NongDropdownLayer::onFolderPicked(
+    Task<Result<std::filesystem::path>>::Event* event) {
+    Result<std::filesystem::path>* result = event->getValue();
+    if (!result) {
+        return;
+    }
+    if (result->isErr()) {
+        FLAlertLayer::create("Error",
+                             fmt::format("Failed to open folder. Error: {}",
+                                         result->unwrapErr()),
+                             "Ok")
+            ->show();
+        return;
+    }
+    if (Result<> res = LibraryImportManager::get().start(result->unwrap());
+        res.isErr()) {
+        FLAlertLayer::create(
+            "Failed",
+            fmt::format("Failed to import folder: {}", res.unwrapErr()), "Ok")
+            ->show();
+        return;
+    }
+    this->updateBulkProgress(0.f);
+}
+
+void NongDropdownLayer::onBundle(CCObject*) {
+    createQuickPopup(
+        "NONG bundle",
+        "<cy>Export</c> the NONGs of this level's songs, their song files and "
+        "the index caches into a single file, or <cy>import</c> a bundle "
+        "exported on another install.",
+        "Import", "Export", [this](auto, bool btn2) {
+            file::FilePickOptions::Filter filter = {
+                .description = "NONG bundles", .files = {"*.jbbundle"}};
+            file::FilePickOptions options = {
+                btn2 ? std::optional<std::filesystem::path>("nongs.jbbundle")
+                     : std::nullopt,
+                {filter}};
+            m_bundlePickListener.bind(
+                [this, importing = !btn2](
+                    Task<Result<std::filesystem::path>>::Event* event) {
+                    this->onBundlePicked(event, importing);
+                });
+            m_bundlePickListener.setFilter(file::pick(
+                btn2 ? file::PickMode::SaveFile : file::PickMode::OpenFile,
+                options));
+        });
+}
+
+void NongDropdownLayer::onBundlePicked(
+    Task<Result<std::filesystem::path>>::Event* event, bool importing) {
+    Result<std::filesystem::path>* result = event->getValue();
+    if (!result) {
+        return;
+    }
+    if (result->isErr()) {
+        FLAlertLayer::create("Error",
+                             fmt::format("Failed to pick a file. Error: {}",
+                                         result->unwrapErr()),
+                             "Ok")
+            ->show();
+        return;
+    }
+    Result<> res =
+        importing
+            ? BundleManager::get().importBundle(result->unwrap())
+            : BundleManager::get().exportBundle(m_songIDS, result->unwrap());
+    if (res.isErr()) {
+        FLAlertLayer::create(
+            "Failed",
+            fmt::format("Failed to {} bundle: {}",
+                        importing ? "import" : "export", res.unwrapErr()),
+            "Ok")
+            ->show();
+        return;
+    }
+    this->updateBulkProgress(0.f);
+}
+
+void NongDropdownLayer::updateBulkProgress(float) {
+    std::optional<IndexManager::BulkProgress> progress =
+        IndexManager::get().getBulkDownloadProgress();
+    if (!progress.has_value()) {
+        if (std::optional<BundleManager::Progress> bundle =
+                BundleManager::get().progress()) {
+            m_bulkLabel->setVisible(true);
+            m_bulkLabel->setString(
+                fmt::format("{} bundle {}/{}",
+                            bundle->importing ? "Importing" : "Exporting",
+                            bundle->finished, bundle->total)
+                    .c_str());
+            return;
+        }
+        std::optional<LibraryImportManager::Progress> import =
+            LibraryImportManager::get().progress();
+        m_bulkLabel->setVisible(import.has_value());
+        if (import.has_value()) {
+            m_bulkLabel->setString(
+                fmt::format("{} {}/{}",
+                            import->copying ? "Importing songs"
+                                            : "Reading song tags",
+                            import->finished, import->total)
+                    .c_str());
+        }
+        return;
+    }
+    m_bulkLabel->setVisible(true);
+    m_bulkLabel->setString(
+        fmt::format("Downloading songs {}/{} ({:.0f}%)",
+                    progress->finished, progress->total, progress->percent)
+            .c_str());
+}
+
 void NongDropdownLayer::createList() {
     if (!m_list) {
         m_list = NongList::create(
             m_songIDS, CCSize{this->getCellSize().width, 220.f},
-            [this](int gdSongID, const std::string& uniqueID) {
+            [this](int gdSongID, UniqueID uniqueID) {
                 this->setActiveSong(gdSongID, uniqueID);
             },
-            [this](int gdSongID, const std::string& uniqueID, bool onlyAudio,
+            [this](int gdSongID, UniqueID uniqueID, bool onlyAudio,
                    bool confirm) {
                 this->deleteSong(gdSongID, uniqueID, onlyAudio, confirm);
             },
-            [this](int gdSongID, const std::string& uniqueID) {
+            [this](int gdSongID, UniqueID uniqueID) {
                 this->downloadSong(gdSongID, uniqueID);
             },
-            [this](int gdSongID, const std::string& uniqueID) {
+            [this](int gdSongID, UniqueID uniqueID) {
                 std::optional<Nongs*> nongs =
                     NongManager::get().getNongs(gdSongID);
                 if (!nongs.has_value()) {
@@ -237,6 +444,12 @@ void NongDropdownLayer::createList() {
                     m_addBtn->setVisible(true);
                     m_deleteBtn->setVisible(true);
                 }
+                if (m_downloadAllBtn) {
+                    m_downloadAllBtn->setVisible(multiple);
+                }
+                if (m_searchInput) {
+                    m_searchInput->setVisible(!multiple);
+                }
             });
         m_mainLayer->addChildAtPosition(m_list, Anchor::Center);
         return;
@@ -252,8 +465,7 @@ void NongDropdownLayer::createList() {
 
 CCSize NongDropdownLayer::getCellSize() const { return {320.f, 60.f}; }
 
-void NongDropdownLayer::setActiveSong(int gdSongID,
-                                      const std::string& uniqueID) {
+void NongDropdownLayer::setActiveSong(int gdSongID, UniqueID uniqueID) {
     if (auto err = NongManager::get().setActiveSong(gdSongID, uniqueID);
         err.isErr()) {
         FLAlertLayer::create(
@@ -277,7 +489,7 @@ void NongDropdownLayer::onDiscord(CCObject* target) {
                             });
 }
 
-void NongDropdownLayer::deleteSong(int gdSongID, const std::string& uniqueID,
+void NongDropdownLayer::deleteSong(int gdSongID, UniqueID uniqueID,
                                    bool onlyAudio, bool confirm) {
     auto func = [gdSongID, uniqueID, onlyAudio, confirm]() {
         if (onlyAudio) {
@@ -322,8 +534,7 @@ void NongDropdownLayer::deleteSong(int gdSongID, const std::string& uniqueID,
         });
 }
 
-void NongDropdownLayer::downloadSong(int gdSongID,
-                                     const std::string& uniqueID) {
+void NongDropdownLayer::downloadSong(int gdSongID, UniqueID uniqueID) {
     if (auto err = IndexManager::get().downloadSong(gdSongID, uniqueID);
         err.isErr()) {
         FLAlertLayer::create(
@@ -341,13 +552,21 @@ void NongDropdownLayer::addSong(Nongs&& song, bool popup) {
         return;
     }
     int id = m_currentSongID.value();
-    if (auto err = NongManager::get().addNongs(std::move(song)); err.isErr()) {
+    Result<std::vector<Song*>> res =
+        NongManager::get().addNongs(std::move(song));
+    if (res.isErr()) {
         FLAlertLayer::create(
-            "Failed", fmt::format("Failed to add song: {}", err.unwrapErr()),
+            "Failed", fmt::format("Failed to add song: {}", res.unwrapErr()),
             "Ok")
             ->show();
         return;
     }
+
+    // The list inserts a cell per added song instead of rebuilding
+    Nongs* nongs = NongManager::get().getNongs(id).value();
+    for (Song* added : res.unwrap()) {
+        event::ManualSongAdded(nongs, added).post();
+    }
     if (popup) {
         FLAlertLayer::create("Success", "The song was added!", "Ok")->show();
     }
@@ -378,7 +597,6 @@ void NongDropdownLayer::deleteAllNongs(CCObject*) {
                     ->show();
                 return;
             }
-            Nongs* data = NongManager::get().getNongs(id).value();
             FLAlertLayer::create("Success",
                                  "All nongs were deleted successfully!", "Ok")
                 ->show();
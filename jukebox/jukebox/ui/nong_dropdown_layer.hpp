@@ -1,13 +1,18 @@
 #pragma once
 
+#include <filesystem>
 #include <vector>
 
 #include <Geode/cocos/cocoa/CCObject.h>
+#include <Geode/cocos/label_nodes/CCLabelBMFont.h>
 #include <Geode/cocos/platform/CCPlatformMacros.h>
+#include <Geode/Result.hpp>
 #include <Geode/binding/CCMenuItemSpriteExtra.hpp>
 #include <Geode/binding/CustomSongWidget.hpp>
 #include <Geode/loader/Event.hpp>
 #include <Geode/ui/Popup.hpp>
+#include <Geode/ui/TextInput.hpp>
+#include <Geode/utils/Task.hpp>
 #include <Geode/utils/cocos.hpp>
 
 #include <jukebox/events/get_song_info.hpp>
@@ -33,6 +38,11 @@ protected:
     CCMenuItemSpriteExtra* m_addBtn = nullptr;
     CCMenuItemSpriteExtra* m_discordBtn = nullptr;
     CCMenuItemSpriteExtra* m_deleteBtn = nullptr;
+    CCMenuItemSpriteExtra* m_downloadAllBtn = nullptr;
+    CCMenuItemSpriteExtra* m_importFolderBtn = nullptr;
+    CCMenuItemSpriteExtra* m_bundleBtn = nullptr;
+    cocos2d::CCLabelBMFont* m_bulkLabel = nullptr;
+    geode::TextInput* m_searchInput = nullptr;
 
     geode::EventListener<geode::EventFilter<jukebox::event::SongError>>
         m_songErrorListener;
@@ -41,6 +51,11 @@ protected:
     geode::EventListener<geode::EventFilter<jukebox::event::SongDownloadFailed>>
         m_downloadFailedListener;
 
+    geode::EventListener<geode::Task<geode::Result<std::filesystem::path>>>
+        m_folderPickListener;
+    geode::EventListener<geode::Task<geode::Result<std::filesystem::path>>>
+        m_bundlePickListener;
+
     bool m_fetching = false;
 
     bool setup(std::vector<int> ids, CustomSongWidget* parent,
@@ -51,14 +66,23 @@ protected:
     void fetchSongFileHub(cocos2d::CCObject*);
     void onSettings(cocos2d::CCObject*);
     void openAddPopup(cocos2d::CCObject*);
+    void onDownloadAll(cocos2d::CCObject*);
+    void onImportFolder(cocos2d::CCObject*);
+    void onFolderPicked(
+        geode::Task<geode::Result<std::filesystem::path>>::Event* event);
+    void onBundle(cocos2d::CCObject*);
+    void onBundlePicked(
+        geode::Task<geode::Result<std::filesystem::path>>::Event* event,
+        bool importing);
+    void updateBulkProgress(float);
 
 public:
     void onSelectSong(int songID);
     void onDiscord(cocos2d::CCObject*);
-    void setActiveSong(int gdSongID, const std::string& uniqueID);
-    void deleteSong(int gdSongID, const std::string& uniqueID, bool onlyAudio,
+    void setActiveSong(int gdSongID, UniqueID uniqueID);
+    void deleteSong(int gdSongID, UniqueID uniqueID, bool onlyAudio,
                     bool confirm);
-    void downloadSong(int gdSongID, const std::string& uniqueID);
+    void downloadSong(int gdSongID, UniqueID uniqueID);
     void addSong(Nongs&& song, bool popup = true);
     void updateParentWidget(SongMetadata const& song);
 
@@ -0,0 +1,166 @@
+#include <jukebox/ui/profiler_popup.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/cocos/menu_nodes/CCMenu.h>
+#include <Geode/binding/ButtonSprite.hpp>
+#include <Geode/binding/CCMenuItemSpriteExtra.hpp>
+#include <Geode/binding/FLAlertLayer.hpp>
+#include <Geode/ui/Layout.hpp>
+#include <Geode/ui/MDTextArea.hpp>
+#include <Geode/loader/Log.hpp>
+#include <Geode/ui/Popup.hpp>
+
+#include <jukebox/managers/index_manager.hpp>
+#include <jukebox/managers/nong_manager.hpp>
+#include <jukebox/ui/level_open_benchmark.hpp>
+#include <jukebox/ui/list/index_song_cell.hpp>
+#include <jukebox/ui/list/nong_cell.hpp>
+#include <jukebox/ui/list/song_cell.hpp>
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/profiler.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+bool ProfilerPopup::setup() {
+    this->setTitle("Profiler");
+
+    const CCSize size = m_mainLayer->getContentSize();
+    m_text = MDTextArea::create("", {size.width - 20.f, size.height - 75.f});
+    m_mainLayer->addChildAtPosition(m_text, Anchor::Center, {0.f, 2.f});
+
+    auto menu = CCMenu::create();
+    menu->setContentSize({size.width - 20.f, 30.f});
+    menu->setLayout(RowLayout::create()->setGap(10.f));
+    for (auto [label, selector] :
+         std::vector<std::pair<const char*, SEL_MenuHandler>>{
+             {"Refresh", menu_selector(ProfilerPopup::onRefresh)},
+             {"Reset", menu_selector(ProfilerPopup::onReset)},
+             {"Export", menu_selector(ProfilerPopup::onExport)},
+             {"Benchmark", menu_selector(ProfilerPopup::onBenchmark)}}) {
+        auto spr = ButtonSprite::create(label);
+        spr->setScale(0.6f);
+        menu->addChild(CCMenuItemSpriteExtra::create(spr, this, selector));
+    }
+    menu->updateLayout();
+    m_mainLayer->addChildAtPosition(menu, Anchor::Bottom, {0.f, 20.f});
+
+    this->refresh();
+    return true;
+}
+
+std::string ProfilerPopup::summary() {
+    std::string ret;
+    if (!Profiler::enabled()) {
+        ret +=
+            "Profiling is <cr>off</c>. Turn it on in the settings, then "
+            "restart the game to include startup.\n\n";
+    }
+
+    ret += "## Timers\n";
+    const auto timers = Profiler::get().timers();
+    if (timers.empty()) {
+        ret += "Nothing recorded yet.\n";
+    }
+    for (const auto& [name, stats] : timers) {
+        const double total = stats.total.count() / 1000.0;
+        ret += fmt::format(
+            "- **{}**: {} calls, {:.2f} ms total, {:.3f} ms average, "
+            "{:.2f} ms max\n",
+            name, stats.count, total, total / stats.count,
+            stats.max.count() / 1000.0);
+    }
+
+    ret += "\n## Counters\n";
+    for (std::size_t i = 0;
+         i < static_cast<std::size_t>(Profiler::Counter::Count); i++) {
+        const auto counter = static_cast<Profiler::Counter>(i);
+        ret += fmt::format("- **{}**: {} calls\n",
+                           Profiler::counterName(counter),
+                           Profiler::get().counter(counter));
+    }
+
+    ret += "\n## Memory\n";
+    ret += this->memorySummary();
+    return ret;
+}
+
+std::string ProfilerPopup::memorySummary() {
+    std::vector<MemoryUsage> usage = NongManager::get().memoryUsage();
+    for (MemoryUsage& index : IndexManager::get().memoryUsage()) {
+        usage.push_back(index);
+    }
+    // Without the cocos nodes they hold
+    usage.push_back(MemoryUsage{"Song cells", SongCell::live(),
+                                SongCell::live() * sizeof(SongCell)});
+    usage.push_back(MemoryUsage{"NONG cells", NongCell::live(),
+                                NongCell::live() * sizeof(NongCell)});
+    usage.push_back(MemoryUsage{"Index song cells", IndexSongCell::live(),
+                                IndexSongCell::live() * sizeof(IndexSongCell)});
+
+    std::string ret;
+    std::size_t total = 0;
+    for (const MemoryUsage& entry : usage) {
+        total += entry.bytes;
+        ret += fmt::format("- **{}**: {}, {:.1f} KB\n", entry.name,
+                           entry.count, entry.bytes / 1024.0);
+        log::info("Memory: {}: {}, {} bytes", entry.name, entry.count,
+                  entry.bytes);
+    }
+    ret += fmt::format("- **Total**: {:.2f} MB\n", total / 1048576.0);
+    log::info("Memory: {} bytes in total", total);
+    return ret;
+}
+
+void ProfilerPopup::refresh() { m_text->setString(this->summary().c_str()); }
+
+void ProfilerPopup::onRefresh(CCObject*) { this->refresh(); }
+
+void ProfilerPopup::onReset(CCObject*) {
+    Profiler::get().reset();
+    this->refresh();
+}
+
+void ProfilerPopup::onExport(CCObject*) {
+    Result<std::filesystem::path> path = Profiler::get().exportTrace();
+    if (path.isErr()) {
+        FLAlertLayer::create("Error", path.unwrapErr(), "OK")->show();
+        return;
+    }
+    FLAlertLayer::create(
+        "Exported",
+        fmt::format("Saved to <cy>{}</c>. Open it in chrome://tracing or "
+                    "Perfetto.",
+                    path.unwrap().string()),
+        "OK")
+        ->show();
+}
+
+void ProfilerPopup::onBenchmark(CCObject*) {
+    Result<std::string> report = LevelOpenBenchmark::run();
+    if (report.isErr()) {
+        FLAlertLayer::create("Error", report.unwrapErr(), "OK")->show();
+        return;
+    }
+    m_text->setString((this->summary() + "\n" + report.unwrap()).c_str());
+}
+
+ProfilerPopup* ProfilerPopup::create() {
+    auto ret = new ProfilerPopup();
+    if (ret->initAnchored(360.f, 260.f)) {
+        ret->autorelease();
+        return ret;
+    }
+    CC_SAFE_DELETE(ret);
+    return nullptr;
+}
+
+}  // namespace jukebox
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include <Geode/cocos/cocoa/CCObject.h>
+#include <Geode/ui/MDTextArea.hpp>
+#include <Geode/ui/Popup.hpp>
+
+namespace jukebox {
+
+/**
+ * Shows what the Profiler recorded, with buttons to export it as a Chrome
+ * trace, start over or run the level open benchmark
+ */
+class ProfilerPopup : public geode::Popup<> {
+protected:
+    geode::MDTextArea* m_text = nullptr;
+
+    bool setup() override;
+    std::string summary();
+    // Also logged, so it can be compared across sessions
+    std::string memorySummary();
+    void refresh();
+    void onRefresh(CCObject*);
+    void onReset(CCObject*);
+    void onExport(CCObject*);
+    // Shows the report below the summary until the next refresh
+    void onBenchmark(CCObject*);
+
+public:
+    static ProfilerPopup* create();
+};
+
+}  // namespace jukebox
@@ -0,0 +1,71 @@
+#include <jukebox/ui/profiler_setting.hpp>
+
+#include <memory>
+#include <string>
+
+#include <Geode/cocos/cocoa/CCObject.h>
+#include <Geode/cocos/platform/CCPlatformMacros.h>
+#include <Geode/Result.hpp>
+#include <Geode/binding/ButtonSprite.hpp>
+#include <Geode/binding/CCMenuItemSpriteExtra.hpp>
+#include <Geode/loader/SettingV3.hpp>
+#include <Geode/ui/Layout.hpp>
+#include <Geode/utils/JsonValidation.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/ui/profiler_popup.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+Result<std::shared_ptr<SettingV3>> ProfilerSetting::parse(
+    const std::string& key, const std::string& modID,
+    const matjson::Value& json) {
+    auto ret = std::make_shared<ProfilerSetting>();
+    auto root = checkJson(json, "ProfilerSetting");
+    ret->init(key, modID, root);
+    ret->parseNameAndDescription(root);
+    root.checkUnknownKeys();
+    return root.ok(std::static_pointer_cast<SettingV3>(ret));
+}
+
+SettingNodeV3* ProfilerSetting::createNode(float width) {
+    return ProfilerSettingNode::create(
+        std::static_pointer_cast<ProfilerSetting>(shared_from_this()), width);
+}
+
+bool ProfilerSettingNode::init(std::shared_ptr<ProfilerSetting> setting,
+                               float width) {
+    if (!SettingNodeV3::init(setting, width)) {
+        return false;
+    }
+
+    auto viewSpr = ButtonSprite::create("View");
+    viewSpr->setScale(0.72f);
+    auto viewBtn = CCMenuItemSpriteExtra::create(
+        viewSpr, this, menu_selector(ProfilerSettingNode::onView));
+    this->getButtonMenu()->addChildAtPosition(viewBtn, Anchor::Center);
+    this->getButtonMenu()->setContentWidth(60.f);
+    this->getButtonMenu()->updateLayout();
+
+    this->updateState(nullptr);
+    return true;
+}
+
+void ProfilerSettingNode::onView(CCObject*) { ProfilerPopup::create()->show(); }
+
+ProfilerSettingNode* ProfilerSettingNode::create(
+    std::shared_ptr<ProfilerSetting> setting, float width) {
+    ProfilerSettingNode* ret = new ProfilerSettingNode();
+
+    if (ret->init(setting, width)) {
+        ret->autorelease();
+        return ret;
+    }
+
+    CC_SAFE_DELETE(ret);
+    return nullptr;
+}
+
+}  // namespace jukebox
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <Geode/cocos/base_nodes/CCNode.h>
+#include <Geode/cocos/cocoa/CCObject.h>
+#include <Geode/Result.hpp>
+#include <Geode/loader/SettingV3.hpp>
+#include <matjson.hpp>
+
+namespace jukebox {
+
+/**
+ * A settings row holding nothing but a button that opens the ProfilerPopup
+ */
+class ProfilerSetting : public geode::SettingV3 {
+public:
+    static geode::Result<std::shared_ptr<geode::SettingV3>> parse(
+        const std::string& key, const std::string& modID,
+        const matjson::Value& json);
+
+    bool load(const matjson::Value& json) override { return true; }
+    bool save(matjson::Value& json) const override { return true; }
+    bool isDefaultValue() const override { return true; }
+    void reset() override {}
+
+    geode::SettingNodeV3* createNode(float width) override;
+};
+
+class ProfilerSettingNode : public geode::SettingNodeV3 {
+protected:
+    bool init(std::shared_ptr<ProfilerSetting> setting, float width);
+    void onView(CCObject* sender);
+
+    void onCommit() override {}
+    void onResetToDefault() override {}
+
+public:
+    static ProfilerSettingNode* create(std::shared_ptr<ProfilerSetting> setting,
+                                       float width);
+
+    bool hasUncommittedChanges() const override { return false; }
+    bool hasNonDefaultValue() const override { return false; }
+};
+
+}  // namespace jukebox
@@ -0,0 +1,57 @@
+#include <jukebox/utils/atomic_file.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+Result<> write_file_atomic(const std::filesystem::path& path,
+                           std::string_view data) {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+
+    {
+        std::ofstream output(tmp, std::ios::binary | std::ios::trunc);
+        if (!output.is_open()) {
+            return Err(fmt::format("Couldn't open file: {}", tmp));
+        }
+        output.write(data.data(), data.size());
+        output.flush();
+        if (!output) {
+            std::error_code ec;
+            output.close();
+            std::filesystem::remove(tmp, ec);
+            return Err(fmt::format("Couldn't write file: {}", tmp));
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::error_code removeEc;
+        std::filesystem::remove(tmp, removeEc);
+        return Err(
+            fmt::format("Couldn't replace {}: {}", path.filename().string(),
+                        ec.message()));
+    }
+
+    return Ok();
+}
+
+Result<> write_file_atomic(const std::filesystem::path& path,
+                           std::span<const std::uint8_t> data) {
+    return write_file_atomic(
+        path, std::string_view(reinterpret_cast<const char*>(data.data()),
+                               data.size()));
+}
+
+}  // namespace jukebox
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+#include <Geode/Result.hpp>
+
+namespace jukebox {
+
+/**
+ * Writes a file by writing a sibling temp file first, then renaming it over
+ * the destination. A crash mid-write leaves either the old or the new file,
+ * never a truncated one.
+ *
+ * @param path the destination file
+ * @param data the contents to write
+ */
+geode::Result<> write_file_atomic(const std::filesystem::path& path,
+                                  std::span<const std::uint8_t> data);
+geode::Result<> write_file_atomic(const std::filesystem::path& path,
+                                  std::string_view data);
+
+}  // namespace jukebox
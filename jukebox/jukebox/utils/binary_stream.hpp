@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+namespace jukebox {
+
+/**
+ * Appends little-endian primitives and length-prefixed strings to a byte
+ * buffer. All supported platforms are little-endian, so values are copied
+ * as-is.
+ */
+class BinaryWriter final {
+private:
+    std::vector<std::uint8_t> m_buffer;
+
+public:
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void write(T value) {
+        std::size_t at = m_buffer.size();
+        m_buffer.resize(at + sizeof(T));
+        std::memcpy(m_buffer.data() + at, &value, sizeof(T));
+    }
+
+    void writeString(std::string_view value) {
+        this->write<std::uint32_t>(static_cast<std::uint32_t>(value.size()));
+        m_buffer.insert(m_buffer.end(), value.begin(), value.end());
+    }
+
+    void writeOptionalString(const std::optional<std::string>& value) {
+        this->write<std::uint8_t>(value.has_value());
+        if (value.has_value()) {
+            this->writeString(value.value());
+        }
+    }
+
+    void writeBytes(std::span<const std::uint8_t> bytes) {
+        m_buffer.insert(m_buffer.end(), bytes.begin(), bytes.end());
+    }
+
+    std::size_t size() const { return m_buffer.size(); }
+    std::vector<std::uint8_t>& buffer() { return m_buffer; }
+    std::vector<std::uint8_t> take() { return std::move(m_buffer); }
+};
+
+/**
+ * Bounds-checked reader over a byte span produced by BinaryWriter
+ */
+class BinaryReader final {
+private:
+    std::span<const std::uint8_t> m_data;
+    std::size_t m_offset = 0;
+
+public:
+    BinaryReader(std::span<const std::uint8_t> data) : m_data(data) {}
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    geode::Result<T> read() {
+        if (m_data.size() - m_offset < sizeof(T)) {
+            return geode::Err("Unexpected end of data at offset {}", m_offset);
+        }
+        T value;
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return geode::Ok(value);
+    }
+
+    geode::Result<std::string_view> readStringView() {
+        GEODE_UNWRAP_INTO(std::uint32_t size, this->read<std::uint32_t>());
+        if (m_data.size() - m_offset < size) {
+            return geode::Err("String of length {} overruns data at offset {}",
+                              size, m_offset);
+        }
+        std::string_view ret(
+            reinterpret_cast<const char*>(m_data.data() + m_offset), size);
+        m_offset += size;
+        return geode::Ok(ret);
+    }
+
+    geode::Result<std::string> readString() {
+        GEODE_UNWRAP_INTO(std::string_view view, this->readStringView());
+        return geode::Ok(std::string(view));
+    }
+
+    geode::Result<std::optional<std::string>> readOptionalString() {
+        GEODE_UNWRAP_INTO(std::uint8_t present, this->read<std::uint8_t>());
+        if (!present) {
+            return geode::Ok(std::nullopt);
+        }
+        GEODE_UNWRAP_INTO(std::string value, this->readString());
+        return geode::Ok(std::optional(std::move(value)));
+    }
+
+    geode::Result<> skip(std::size_t bytes) {
+        if (m_data.size() - m_offset < bytes) {
+            return geode::Err("Can't skip {} bytes at offset {}", bytes,
+                              m_offset);
+        }
+        m_offset += bytes;
+        return geode::Ok();
+    }
+
+    std::size_t offset() const { return m_offset; }
+    std::size_t remaining() const { return m_data.size() - m_offset; }
+};
+
+}  // namespace jukebox
@@ -0,0 +1,57 @@
+#include <jukebox/utils/compressed_file.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/utils/file.hpp>
+
+#include <jukebox/utils/atomic_file.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+// The zip holds a single entry, its name doesn't matter
+constexpr std::string_view s_entryName = "data";
+constexpr std::string_view s_zipMagic = "PK\x03\x04";
+
+}  // namespace
+
+Result<> write_file_compressed(const std::filesystem::path& path,
+                               std::string_view data) {
+    GEODE_UNWRAP_INTO(file::Zip zip, file::Zip::create());
+    GEODE_UNWRAP(zip.add(s_entryName, data));
+    const ByteVector bytes = zip.getData();
+    return write_file_atomic(path, std::span<const std::uint8_t>(bytes));
+}
+
+Result<std::string> read_file_compressed(const std::filesystem::path& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        return Err(
+            fmt::format("Couldn't open file: {}", path.filename().string()));
+    }
+    std::string raw((std::istreambuf_iterator<char>(input)),
+                    std::istreambuf_iterator<char>());
+    if (!raw.starts_with(s_zipMagic)) {
+        return Ok(std::move(raw));
+    }
+
+    GEODE_UNWRAP_INTO(
+        file::Unzip unzip,
+        file::Unzip::create(ByteSpan(
+            reinterpret_cast<const std::uint8_t*>(raw.data()), raw.size())));
+    GEODE_UNWRAP_INTO(ByteVector bytes, unzip.extract(s_entryName));
+    return Ok(std::string(bytes.begin(), bytes.end()));
+}
+
+}  // namespace jukebox
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include <Geode/Result.hpp>
+
+namespace jukebox {
+
+/**
+ * Writes data deflated into a single entry zip, atomically like
+ * write_file_atomic.
+ *
+ * @param path the destination file
+ * @param data the contents to compress
+ */
+geode::Result<> write_file_compressed(const std::filesystem::path& path,
+                                      std::string_view data);
+
+/**
+ * Reads a file written by write_file_compressed. Files that aren't zips are
+ * read as they are, so plain copies keep working.
+ *
+ * @param path the file to read
+ */
+geode::Result<std::string> read_file_compressed(
+    const std::filesystem::path& path);
+
+}  // namespace jukebox
@@ -0,0 +1,305 @@
+#include <jukebox/utils/directory_watcher.hpp>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <Geode/platform/cplatform.h>
+
+#if defined(GEODE_IS_WINDOWS)
+#include <Windows.h>
+#elif defined(GEODE_IS_MACOS)
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#elif defined(GEODE_IS_ANDROID)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace jukebox {
+
+#if defined(GEODE_IS_WINDOWS)
+
+struct DirectoryWatcher::Impl {
+    Callback callback;
+    HANDLE directory = INVALID_HANDLE_VALUE;
+    HANDLE readEvent = nullptr;
+    HANDLE stopEvent = nullptr;
+    // Cleared if the thread stops on an error
+    std::atomic<bool> watching = false;
+    std::thread thread;
+
+    Impl(const std::filesystem::path& path, Callback cb)
+        : callback(std::move(cb)) {
+        directory = CreateFileW(
+            path.c_str(), FILE_LIST_DIRECTORY,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+            nullptr);
+        if (directory == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        readEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!readEvent || !stopEvent) {
+            return;
+        }
+        watching = true;
+        thread = std::thread([this]() { this->run(); });
+    }
+
+    ~Impl() {
+        if (thread.joinable()) {
+            SetEvent(stopEvent);
+            thread.join();
+        }
+        for (HANDLE handle : {readEvent, stopEvent}) {
+            if (handle) {
+                CloseHandle(handle);
+            }
+        }
+        if (directory != INVALID_HANDLE_VALUE) {
+            CloseHandle(directory);
+        }
+    }
+
+    bool active() const { return watching; }
+
+    void run() {
+        alignas(DWORD) std::array<std::uint8_t, 16384> buffer;
+        while (true) {
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = readEvent;
+            ResetEvent(readEvent);
+            if (!ReadDirectoryChangesW(
+                    directory, buffer.data(),
+                    static_cast<DWORD>(buffer.size()), FALSE,
+                    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+                        FILE_NOTIFY_CHANGE_LAST_WRITE,
+                    nullptr, &overlapped, nullptr)) {
+                watching = false;
+                callback(std::nullopt);
+                return;
+            }
+
+            const std::array<HANDLE, 2> handles{readEvent, stopEvent};
+            DWORD bytes = 0;
+            if (WaitForMultipleObjects(2, handles.data(), FALSE, INFINITE) !=
+                WAIT_OBJECT_0) {
+                CancelIoEx(directory, &overlapped);
+                GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+                return;
+            }
+
+            // No bytes means the buffer overflowed
+            if (!GetOverlappedResult(directory, &overlapped, &bytes, FALSE) ||
+                bytes == 0) {
+                callback(std::nullopt);
+                continue;
+            }
+
+            std::size_t offset = 0;
+            while (true) {
+                auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(
+                    buffer.data() + offset);
+                callback(std::filesystem::path(
+                    std::wstring(info->FileName,
+                                 info->FileNameLength / sizeof(WCHAR))));
+                if (info->NextEntryOffset == 0) {
+                    break;
+                }
+                offset += info->NextEntryOffset;
+            }
+        }
+    }
+};
+
+#elif defined(GEODE_IS_MACOS)
+
+struct DirectoryWatcher::Impl {
+    Callback callback;
+    FSEventStreamRef stream = nullptr;
+    dispatch_queue_t queue = nullptr;
+
+    Impl(const std::filesystem::path& path, Callback cb)
+        : callback(std::move(cb)) {
+        CFStringRef cfPath = CFStringCreateWithCString(
+            nullptr, path.c_str(), kCFStringEncodingUTF8);
+        if (!cfPath) {
+            return;
+        }
+        CFArrayRef paths =
+            CFArrayCreate(nullptr, reinterpret_cast<const void**>(&cfPath), 1,
+                          &kCFTypeArrayCallBacks);
+        CFRelease(cfPath);
+
+        FSEventStreamContext context{0, this, nullptr, nullptr, nullptr};
+        stream = FSEventStreamCreate(
+            nullptr, &Impl::onEvents, &context, paths,
+            kFSEventStreamEventIdSinceNow, 0.05,
+            kFSEventStreamCreateFlagFileEvents |
+                kFSEventStreamCreateFlagNoDefer);
+        CFRelease(paths);
+        if (!stream) {
+            return;
+        }
+
+        queue = dispatch_queue_create("jukebox.directory-watcher",
+                                      DISPATCH_QUEUE_SERIAL);
+        FSEventStreamSetDispatchQueue(stream, queue);
+        if (!FSEventStreamStart(stream)) {
+            this->release();
+        }
+    }
+
+    ~Impl() { this->release(); }
+
+    void release() {
+        if (stream) {
+            FSEventStreamStop(stream);
+            FSEventStreamInvalidate(stream);
+            FSEventStreamRelease(stream);
+            stream = nullptr;
+        }
+        if (queue) {
+            // Waits for a callback that is still running
+            dispatch_sync_f(queue, nullptr, [](void*) {});
+            dispatch_release(queue);
+            queue = nullptr;
+        }
+    }
+
+    bool active() const { return stream != nullptr; }
+
+    static void onEvents(ConstFSEventStreamRef, void* info, std::size_t count,
+                         void* eventPaths,
+                         const FSEventStreamEventFlags* flags,
+                         const FSEventStreamEventId*) {
+        auto self = static_cast<Impl*>(info);
+        auto paths = static_cast<char**>(eventPaths);
+        for (std::size_t i = 0; i < count; i++) {
+            if (flags[i] & (kFSEventStreamEventFlagMustScanSubDirs |
+                            kFSEventStreamEventFlagRootChanged)) {
+                self->callback(std::nullopt);
+                continue;
+            }
+            // Paths are absolute, and resolved, so only the name is kept
+            self->callback(std::filesystem::path(paths[i]).filename());
+        }
+    }
+};
+
+#elif defined(GEODE_IS_ANDROID)
+
+struct DirectoryWatcher::Impl {
+    Callback callback;
+    int inotify = -1;
+    int stop = -1;
+    // Cleared if the thread stops on an error
+    std::atomic<bool> watching = false;
+    std::thread thread;
+
+    Impl(const std::filesystem::path& path, Callback cb)
+        : callback(std::move(cb)) {
+        inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        stop = eventfd(0, EFD_CLOEXEC);
+        if (inotify < 0 || stop < 0) {
+            return;
+        }
+        if (inotify_add_watch(inotify, path.c_str(),
+                              IN_CREATE | IN_DELETE | IN_CLOSE_WRITE |
+                                  IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO |
+                                  IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+            return;
+        }
+        watching = true;
+        thread = std::thread([this]() { this->run(); });
+    }
+
+    ~Impl() {
+        if (thread.joinable()) {
+            const std::uint64_t one = 1;
+            (void)write(stop, &one, sizeof(one));
+            thread.join();
+        }
+        for (int fd : {inotify, stop}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    bool active() const { return watching; }
+
+    void run() {
+        alignas(inotify_event) std::array<char, 16384> buffer;
+        std::array<pollfd, 2> fds{pollfd{inotify, POLLIN, 0},
+                                  pollfd{stop, POLLIN, 0}};
+        while (true) {
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                watching = false;
+                callback(std::nullopt);
+                return;
+            }
+            if (fds[1].revents) {
+                return;
+            }
+            if (!fds[0].revents) {
+                continue;
+            }
+
+            ssize_t length;
+            while ((length = read(inotify, buffer.data(), buffer.size())) >
+                   0) {
+                for (ssize_t offset = 0; offset < length;) {
+                    auto event =
+                        reinterpret_cast<const inotify_event*>(&buffer[offset]);
+                    if (event->mask &
+                        (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                        // The directory itself is gone, so is the watch
+                        watching = false;
+                        callback(std::nullopt);
+                    } else if (event->mask & IN_Q_OVERFLOW) {
+                        callback(std::nullopt);
+                    } else if (event->len > 0) {
+                        callback(std::filesystem::path(event->name));
+                    }
+                    offset += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+    }
+};
+
+#else
+
+struct DirectoryWatcher::Impl {
+    Impl(const std::filesystem::path&, Callback) {}
+
+    bool active() const { return false; }
+};
+
+#endif
+
+DirectoryWatcher::DirectoryWatcher(const std::filesystem::path& directory,
+                                   Callback callback)
+    : m_impl(std::make_unique<Impl>(directory, std::move(callback))) {}
+
+DirectoryWatcher::~DirectoryWatcher() = default;
+
+bool DirectoryWatcher::active() const { return m_impl->active(); }
+
+}  // namespace jukebox
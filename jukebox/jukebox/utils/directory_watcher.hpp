@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace jukebox {
+
+/**
+ * Reports changes to the files of a directory from a background thread,
+ * through ReadDirectoryChangesW on Windows, FSEvents on macOS and inotify on
+ * Android. Where none of them is available, or the directory can't be
+ * watched, the watcher isn't active and reports nothing.
+ */
+class DirectoryWatcher final {
+public:
+    /**
+     * Called on the watcher thread with the name of a file that was
+     * created, changed, renamed or removed, or with std::nullopt when events
+     * were missed and any file may have changed
+     */
+    using Callback =
+        std::function<void(std::optional<std::filesystem::path> filename)>;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+public:
+    DirectoryWatcher(const std::filesystem::path& directory,
+                     Callback callback);
+    // Stops the watcher thread, the callback isn't called anymore after
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    /**
+     * Whether changes are being reported
+     */
+    bool active() const;
+};
+
+}  // namespace jukebox
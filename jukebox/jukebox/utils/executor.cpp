@@ -0,0 +1,213 @@
+#include <jukebox/utils/executor.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Geode/loader/Loader.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+constexpr std::size_t s_notWorker = static_cast<std::size_t>(-1);
+
+// Index of the worker running on this thread, jobs posted from a worker go
+// to its own queues
+thread_local std::size_t t_workerIndex = s_notWorker;
+
+}  // namespace
+
+Executor::~Executor() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void Executor::start() {
+    const std::size_t hardware =
+        std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t count = std::clamp<std::size_t>(
+        hardware > 1 ? hardware - 1 : 1, 1, s_maxWorkers);
+    m_bulkLimit = count > 1 ? count - 1 : 1;
+
+    m_workers.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    m_threads.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        m_threads.emplace_back(&Executor::work, this, i);
+    }
+}
+
+void Executor::post(Priority priority, std::function<void()> job) {
+    std::call_once(m_started, [this]() { this->start(); });
+
+    const std::size_t p = static_cast<std::size_t>(priority);
+    std::size_t index = t_workerIndex;
+    if (index == s_notWorker) {
+        index = m_nextWorker.fetch_add(1, std::memory_order_relaxed) %
+                m_workers.size();
+    }
+    {
+        Worker& worker = *m_workers[index];
+        std::lock_guard lock(worker.mutex);
+        worker.jobs[p].push_back(std::move(job));
+        m_queued[p].fetch_add(1);
+    }
+    // Taking the lock orders this with a worker about to sleep
+    {
+        std::lock_guard lock(m_mutex);
+    }
+    m_wake.notify_one();
+}
+
+bool Executor::hasRunnable() const {
+    for (std::size_t p = 0; p < s_priorities; p++) {
+        if (m_queued[p].load() == 0) {
+            continue;
+        }
+        if (p != static_cast<std::size_t>(Priority::Bulk) ||
+            m_bulkRunning.load() < m_bulkLimit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Executor::take(std::size_t index, std::function<void()>& job,
+                    Priority& priority) {
+    const std::size_t count = m_workers.size();
+    for (std::size_t p = 0; p < s_priorities; p++) {
+        if (m_queued[p].load() == 0) {
+            continue;
+        }
+        const bool bulk = p == static_cast<std::size_t>(Priority::Bulk);
+        if (bulk && m_bulkRunning.fetch_add(1) >= m_bulkLimit) {
+            m_bulkRunning.fetch_sub(1);
+            continue;
+        }
+
+        // Own queue first, then the others in turn
+        for (std::size_t i = 0; i < count; i++) {
+            Worker& worker = *m_workers[(index + i) % count];
+            std::lock_guard lock(worker.mutex);
+            std::deque<std::function<void()>>& jobs = worker.jobs[p];
+            if (jobs.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            } else {
+                job = std::move(jobs.back());
+                jobs.pop_back();
+            }
+            m_queued[p].fetch_sub(1);
+            priority = static_cast<Priority>(p);
+            return true;
+        }
+
+        if (bulk) {
+            m_bulkRunning.fetch_sub(1);
+        }
+    }
+    return false;
+}
+
+void Executor::work(std::size_t index) {
+    t_workerIndex = index;
+    while (!m_stop) {
+        std::function<void()> job;
+        Priority priority;
+        if (!this->take(index, job, priority)) {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || this->hasRunnable(); });
+            continue;
+        }
+
+        job();
+
+        if (priority == Priority::Bulk) {
+            m_bulkRunning.fetch_sub(1);
+            // Bulk work may have been waiting for this slot
+            {
+                std::lock_guard lock(m_mutex);
+            }
+            m_wake.notify_one();
+        }
+    }
+}
+
+void Executor::postMain(std::function<void()> fn) {
+    std::lock_guard lock(m_mainMutex);
+    m_mainJobs.push_back(std::move(fn));
+    if (m_mainQueued) {
+        return;
+    }
+    m_mainQueued = true;
+    Loader::get()->queueInMainThread([this]() { this->flushMain(); });
+}
+
+void Executor::flushMain() {
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard lock(m_mainMutex);
+        jobs.swap(m_mainJobs);
+        m_mainQueued = false;
+    }
+    for (std::function<void()>& job : jobs) {
+        job();
+    }
+}
+
+void Executor::Strand::post(std::function<void()> job) {
+    {
+        std::lock_guard lock(m_state->mutex);
+        m_state->jobs.push_back(std::move(job));
+        if (m_state->scheduled) {
+            return;
+        }
+        m_state->scheduled = true;
+    }
+    Executor::get().post(m_state->priority,
+                         [state = m_state]() { runNext(state); });
+}
+
+void Executor::Strand::runNext(std::shared_ptr<State> state) {
+    std::function<void()> job;
+    {
+        std::lock_guard lock(state->mutex);
+        job = std::move(state->jobs.front());
+        state->jobs.pop_front();
+    }
+
+    job();
+
+    {
+        std::lock_guard lock(state->mutex);
+        if (state->jobs.empty()) {
+            state->scheduled = false;
+            return;
+        }
+    }
+    // One job per post, so more urgent work gets in between
+    Executor::get().post(state->priority, [state]() { runNext(state); });
+}
+
+}  // namespace jukebox
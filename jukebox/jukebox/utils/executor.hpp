@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * The worker threads all of jukebox's background work runs on. Every worker
+ * has its own queues and steals from the others once its own are empty, and
+ * queued work is taken highest priority first, so a size label the player
+ * is looking at doesn't wait behind a library's worth of analysis.
+ *
+ * Running jobs are never interrupted. Bulk work is kept off one of the
+ * workers instead, which is then always free for the other priorities.
+ *
+ * Workers are started on the first post. Jobs still queued on shutdown are
+ * dropped, writes that must land go through a SerialQueue.
+ */
+class Executor final {
+public:
+    enum class Priority : std::size_t {
+        // Shown to the player right now: size labels, the visible list
+        Visible,
+        Normal,
+        // Analysis, transcoding and anything else that can take minutes
+        Bulk,
+        Count
+    };
+
+    /**
+     * Runs jobs one at a time in the order they were posted, on the
+     * executor's workers. For background work with state of its own that
+     * still has to yield to more urgent work between jobs.
+     */
+    class Strand final {
+    private:
+        struct State {
+            Priority priority;
+            std::mutex mutex;
+            std::deque<std::function<void()>> jobs;
+            bool scheduled = false;
+        };
+
+        std::shared_ptr<State> m_state;
+
+        static void runNext(std::shared_ptr<State> state);
+
+    public:
+        explicit Strand(Priority priority)
+            : m_state(std::make_shared<State>()) {
+            m_state->priority = priority;
+        }
+
+        void post(std::function<void()> job);
+    };
+
+    // Upper bound on workers, the rest of the cores are GD's
+    constexpr static inline std::size_t s_maxWorkers = 4;
+
+private:
+    constexpr static inline std::size_t s_priorities =
+        static_cast<std::size_t>(Priority::Count);
+
+    struct Worker {
+        std::mutex mutex;
+        // The owner takes from the front, thieves from the back
+        std::array<std::deque<std::function<void()>>, s_priorities> jobs;
+    };
+
+    std::once_flag m_started;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<std::size_t> m_nextWorker = 0;
+
+    // Guards sleeping only, the counts are read without it
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::array<std::atomic<std::size_t>, s_priorities> m_queued{};
+    std::atomic<std::size_t> m_bulkRunning = 0;
+    std::size_t m_bulkLimit = 1;
+    std::atomic<bool> m_stop = false;
+
+    std::mutex m_mainMutex;
+    std::vector<std::function<void()>> m_mainJobs;
+    bool m_mainQueued = false;
+
+    Executor() = default;
+
+    void start();
+    void work(std::size_t index);
+    bool hasRunnable() const;
+    bool take(std::size_t index, std::function<void()>& job,
+              Priority& priority);
+    void flushMain();
+
+public:
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    ~Executor();
+
+    void post(Priority priority, std::function<void()> job);
+
+    /**
+     * Runs fn on the main thread. Everything posted during a frame runs
+     * together at the start of the next one.
+     */
+    void postMain(std::function<void()> fn);
+
+    /**
+     * Like TaskType::run, but the body runs on the executor at the given
+     * priority instead of a thread of its own. A task cancelled before a
+     * worker gets to it never runs its body.
+     */
+    template <class TaskType, class Body>
+    TaskType run(Priority priority, Body&& body, std::string name) {
+        auto shared =
+            std::make_shared<std::decay_t<Body>>(std::forward<Body>(body));
+        return TaskType::runWithCallback(
+            [this, priority, shared](auto finish, auto progress,
+                                     auto hasBeenCancelled) {
+                this->post(priority, [shared, finish, progress,
+                                      hasBeenCancelled]() {
+                    if (hasBeenCancelled()) {
+                        finish(typename TaskType::Cancel());
+                        return;
+                    }
+                    finish((*shared)(progress, hasBeenCancelled));
+                });
+            },
+            name);
+    }
+
+    static Executor& get() {
+        static Executor instance;
+        return instance;
+    }
+};
+
+}  // namespace jukebox
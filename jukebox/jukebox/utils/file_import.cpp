@@ -0,0 +1,160 @@
+#include <jukebox/utils/file_import.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+#include <Geode/utils/Task.hpp>
+
+#include <jukebox/utils/executor.hpp>
+
+#if defined(GEODE_IS_MACOS) || defined(GEODE_IS_IOS)
+#include <sys/clonefile.h>
+#elif defined(GEODE_IS_ANDROID)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+constexpr std::size_t s_copyChunk = 1 << 20;
+
+/**
+ * Copy-on-write clone, nothing is copied until either file is written
+ *
+ * @return false if the filesystem can't clone, dst doesn't exist then
+ */
+bool cloneFile(const std::filesystem::path& src,
+               const std::filesystem::path& dst) {
+#if defined(GEODE_IS_MACOS) || defined(GEODE_IS_IOS)
+    return clonefile(src.c_str(), dst.c_str(), 0) == 0;
+#elif defined(GEODE_IS_ANDROID) && defined(FICLONE)
+    int in = open(src.c_str(), O_RDONLY);
+    if (in < 0) {
+        return false;
+    }
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+    const bool cloned = ioctl(out, FICLONE, in) == 0;
+    close(out);
+    close(in);
+    if (!cloned) {
+        unlink(dst.c_str());
+    }
+    return cloned;
+#else
+    // ReFS block cloning needs the file preallocated and cloned extent by
+    // extent, the copy below covers it
+    return false;
+#endif
+}
+
+/**
+ * @param step called with the percentage copied, returns false to stop
+ */
+Result<> placeFile(const std::filesystem::path& source,
+                   const std::filesystem::path& destination,
+                   const std::function<bool(float)>& step) {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(source, ec);
+    if (ec) {
+        return Err("Couldn't read {}: {}", source.filename().string(),
+                   ec.message());
+    }
+
+    // Written next to the destination, so a cancelled or failed import never
+    // leaves a partial song behind
+    std::filesystem::path part = destination;
+    part += ".part";
+    std::filesystem::remove(part, ec);
+
+    // Never hardlinked, the import would change along with the user's file
+    // and its blob would never be collected
+    if (!cloneFile(source, part)) {
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(part, std::ios::binary | std::ios::trunc);
+        if (!in || !out) {
+            return Err("Couldn't open {} for copying",
+                       source.filename().string());
+        }
+
+        std::vector<char> chunk(s_copyChunk);
+        std::uintmax_t copied = 0;
+        while (in) {
+            if (!step(size > 0 ? 100.f * copied / size : 100.f)) {
+                out.close();
+                std::filesystem::remove(part, ec);
+                return Err("Import of {} was cancelled",
+                           source.filename().string());
+            }
+            in.read(chunk.data(), chunk.size());
+            out.write(chunk.data(), in.gcount());
+            copied += static_cast<std::uintmax_t>(in.gcount());
+        }
+        out.close();
+        if (in.bad() || !out) {
+            std::filesystem::remove(part, ec);
+            return Err("Couldn't copy {}", source.filename().string());
+        }
+    }
+
+    if (std::filesystem::file_size(part, ec) != size || ec) {
+        std::filesystem::remove(part, ec);
+        return Err("Copy of {} is incomplete", source.filename().string());
+    }
+
+    std::filesystem::rename(part, destination, ec);
+    if (ec) {
+        std::error_code removeEc;
+        std::filesystem::remove(part, removeEc);
+        return Err("Couldn't move {} into place: {}",
+                   destination.filename().string(), ec.message());
+    }
+    return Ok();
+}
+
+}  // namespace
+
+ImportTask importFile(std::filesystem::path source,
+                      std::filesystem::path destination) {
+    return Executor::get().run<ImportTask>(
+        Executor::Priority::Normal,
+        [source = std::move(source), destination = std::move(destination)](
+            auto progress, auto hasBeenCanceled) -> ImportTask::Result {
+            Result<> res =
+                placeFile(source, destination, [&](float percent) {
+                    if (hasBeenCanceled()) {
+                        return false;
+                    }
+                    progress(percent);
+                    return true;
+                });
+            if (hasBeenCanceled()) {
+                return ImportTask::Cancel();
+            }
+            return res;
+        },
+        "Importing song");
+}
+
+Result<> importFileNow(const std::filesystem::path& source,
+                       const std::filesystem::path& destination) {
+    return placeFile(source, destination, [](float) { return true; });
+}
+
+}  // namespace jukebox
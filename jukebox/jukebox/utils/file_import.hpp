@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+
+#include <Geode/Result.hpp>
+#include <Geode/utils/Task.hpp>
+
+namespace jukebox {
+
+// Progress is the percentage copied
+using ImportTask = geode::Task<geode::Result<>, float>;
+
+/**
+ * Imports a file into the save directory on a worker thread. The file is
+ * cloned if the filesystem supports it (APFS, btrfs, XFS) and copied in
+ * chunks otherwise. Either way, editing the source later leaves the import
+ * alone. The destination only appears once its size matches the source.
+ *
+ * @param source the file to import
+ * @param destination where to put it, replaced if it exists
+ */
+ImportTask importFile(std::filesystem::path source,
+                      std::filesystem::path destination);
+
+/**
+ * Same as importFile, on the calling thread
+ */
+geode::Result<> importFileNow(const std::filesystem::path& source,
+                              const std::filesystem::path& destination);
+
+}  // namespace jukebox
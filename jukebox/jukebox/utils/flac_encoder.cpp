@@ -0,0 +1,506 @@
+#include <jukebox/utils/flac_encoder.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace jukebox {
+
+namespace {
+
+// RICE2 parameters are 5 bits, 31 is the escape code
+constexpr unsigned s_maxRiceParameter = 30;
+constexpr unsigned s_maxPartitionOrder = 8;
+constexpr unsigned s_maxFixedOrder = 4;
+
+constexpr std::array<std::uint8_t, 256> s_crc8 = [] {
+    std::array<std::uint8_t, 256> table{};
+    for (unsigned i = 0; i < 256; i++) {
+        std::uint8_t crc = static_cast<std::uint8_t>(i);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? static_cast<std::uint8_t>(crc << 1 ^ 0x07)
+                             : static_cast<std::uint8_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+constexpr std::array<std::uint16_t, 256> s_crc16 = [] {
+    std::array<std::uint16_t, 256> table{};
+    for (unsigned i = 0; i < 256; i++) {
+        std::uint16_t crc = static_cast<std::uint16_t>(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? static_cast<std::uint16_t>(crc << 1 ^ 0x8005)
+                               : static_cast<std::uint16_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+std::uint8_t crc8(const std::uint8_t* data, std::size_t size) {
+    std::uint8_t crc = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        crc = s_crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+std::uint16_t crc16(const std::uint8_t* data, std::size_t size) {
+    std::uint16_t crc = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        crc = static_cast<std::uint16_t>(crc << 8 ^
+                                         s_crc16[crc >> 8 ^ data[i]]);
+    }
+    return crc;
+}
+
+// Appends bits MSB first
+class BitWriter final {
+private:
+    std::vector<std::uint8_t>& m_out;
+    std::uint64_t m_accumulator = 0;
+    unsigned m_bits = 0;
+
+public:
+    explicit BitWriter(std::vector<std::uint8_t>& out) : m_out(out) {}
+
+    // At most 32 bits at once
+    void write(std::uint64_t value, unsigned bits) {
+        if (bits == 0) {
+            return;
+        }
+        m_accumulator = m_accumulator << bits |
+                        (value & ((std::uint64_t(1) << bits) - 1));
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out.push_back(static_cast<std::uint8_t>(m_accumulator >> m_bits));
+        }
+    }
+
+    void writeSigned(std::int64_t value, unsigned bits) {
+        this->write(static_cast<std::uint64_t>(value), bits);
+    }
+
+    // value zeros, then a one
+    void writeUnary(std::uint64_t value) {
+        while (value >= 32) {
+            this->write(0, 32);
+            value -= 32;
+        }
+        this->write(1, static_cast<unsigned>(value) + 1);
+    }
+
+    void alignToByte() {
+        if (m_bits != 0) {
+            this->write(0, 8 - m_bits);
+        }
+    }
+};
+
+// Frame numbers are coded like UTF-8, extended to 31 bits
+void writeCodedNumber(BitWriter& writer, std::uint32_t value) {
+    if (value < 0x80) {
+        writer.write(value, 8);
+        return;
+    }
+    unsigned bytes = value < 0x800       ? 2
+                     : value < 0x10000   ? 3
+                     : value < 0x200000  ? 4
+                     : value < 0x4000000 ? 5
+                                         : 6;
+    writer.write((0xff00 >> bytes & 0xff) | value >> (bytes - 1) * 6, 8);
+    for (unsigned i = bytes - 1; i > 0; i--) {
+        writer.write(0x80 | (value >> (i - 1) * 6 & 0x3f), 8);
+    }
+}
+
+unsigned sampleSizeCode(std::uint32_t bitsPerSample) {
+    switch (bitsPerSample) {
+        case 8:
+            return 1;
+        case 12:
+            return 2;
+        case 16:
+            return 4;
+        case 20:
+            return 5;
+        case 24:
+            return 6;
+        default:
+            // Read from STREAMINFO
+            return 0;
+    }
+}
+
+std::uint64_t fold(std::int64_t value) {
+    return value >= 0 ? static_cast<std::uint64_t>(value) << 1
+                      : static_cast<std::uint64_t>(-(value + 1)) << 1 | 1;
+}
+
+std::int64_t fixedResidual(const std::int64_t* x, std::size_t i,
+                           unsigned order) {
+    switch (order) {
+        case 0:
+            return x[i];
+        case 1:
+            return x[i] - x[i - 1];
+        case 2:
+            return x[i] - 2 * x[i - 1] + x[i - 2];
+        case 3:
+            return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        default:
+            return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] +
+                   x[i - 4];
+    }
+}
+
+struct Subframe {
+    enum class Type { Constant, Verbatim, Fixed };
+
+    Type type;
+    unsigned order = 0;
+    unsigned partitionOrder = 0;
+    std::vector<unsigned> parameters;
+    std::uint64_t bits = 0;
+};
+
+// Cheapest parameter for count folded residuals summing to sum, and roughly
+// how many bits they take with it
+std::pair<unsigned, std::uint64_t> riceParameter(std::uint64_t sum,
+                                                 std::size_t count) {
+    const std::uint64_t mean = sum / count;
+    const unsigned guess =
+        mean == 0 ? 0 : static_cast<unsigned>(std::bit_width(mean)) - 1;
+    unsigned best = 0;
+    std::uint64_t bestBits = std::numeric_limits<std::uint64_t>::max();
+    for (unsigned k = guess == 0 ? 0 : guess - 1;
+         k <= std::min(guess + 1, s_maxRiceParameter); k++) {
+        const std::uint64_t bits = count * (k + 1) + (sum >> k);
+        if (bits < bestBits) {
+            best = k;
+            bestBits = bits;
+        }
+    }
+    return {best, bestBits};
+}
+
+Subframe planSubframe(const std::int64_t* x, std::size_t count,
+                      unsigned bitsPerSample,
+                      std::vector<std::uint64_t>& folded) {
+    if (std::all_of(x, x + count,
+                    [first = x[0]](std::int64_t s) { return s == first; })) {
+        return Subframe{.type = Subframe::Type::Constant,
+                        .bits = 8 + bitsPerSample};
+    }
+
+    Subframe verbatim{.type = Subframe::Type::Verbatim,
+                      .bits = 8 + std::uint64_t(count) * bitsPerSample};
+
+    // The smallest residuals are usually the cheapest to code
+    unsigned order = 0;
+    std::uint64_t bestSum = std::numeric_limits<std::uint64_t>::max();
+    const unsigned maxOrder = static_cast<unsigned>(
+        std::min<std::size_t>(s_maxFixedOrder, count - 1));
+    for (unsigned o = 0; o <= maxOrder; o++) {
+        std::uint64_t sum = 0;
+        for (std::size_t i = o; i < count; i++) {
+            sum += static_cast<std::uint64_t>(
+                std::llabs(fixedResidual(x, i, o)));
+        }
+        if (sum < bestSum) {
+            order = o;
+            bestSum = sum;
+        }
+    }
+
+    folded.resize(count - order);
+    for (std::size_t i = order; i < count; i++) {
+        folded[i - order] = fold(fixedResidual(x, i, order));
+    }
+
+    Subframe fixed{.type = Subframe::Type::Fixed, .order = order};
+    fixed.bits = std::numeric_limits<std::uint64_t>::max();
+    std::vector<unsigned> parameters;
+    for (unsigned p = 0; p <= s_maxPartitionOrder; p++) {
+        const std::size_t partitionSize = count >> p;
+        if (count % (std::size_t(1) << p) != 0 || partitionSize <= order) {
+            break;
+        }
+        parameters.clear();
+        std::uint64_t bits = 8 + std::uint64_t(order) * bitsPerSample + 6;
+        std::size_t at = 0;
+        for (std::size_t j = 0; j < (std::size_t(1) << p); j++) {
+            const std::size_t size =
+                j == 0 ? partitionSize - order : partitionSize;
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < size; i++) {
+                sum += folded[at + i];
+            }
+            at += size;
+            auto [k, partitionBits] = riceParameter(sum, size);
+            parameters.push_back(k);
+            bits += 5 + partitionBits;
+        }
+        if (bits < fixed.bits) {
+            fixed.bits = bits;
+            fixed.partitionOrder = p;
+            fixed.parameters = parameters;
+        }
+    }
+
+    return fixed.bits < verbatim.bits ? fixed : verbatim;
+}
+
+void writeSubframe(BitWriter& writer, const Subframe& subframe,
+                   const std::int64_t* x, std::size_t count,
+                   unsigned bitsPerSample) {
+    // Zero padding bit, then 6 bits of type, then no wasted bits
+    writer.write(0, 1);
+    switch (subframe.type) {
+        case Subframe::Type::Constant:
+            writer.write(0, 6);
+            writer.write(0, 1);
+            writer.writeSigned(x[0], bitsPerSample);
+            return;
+        case Subframe::Type::Verbatim:
+            writer.write(1, 6);
+            writer.write(0, 1);
+            for (std::size_t i = 0; i < count; i++) {
+                writer.writeSigned(x[i], bitsPerSample);
+            }
+            return;
+        case Subframe::Type::Fixed:
+            break;
+    }
+
+    writer.write(8 | subframe.order, 6);
+    writer.write(0, 1);
+    for (std::size_t i = 0; i < subframe.order; i++) {
+        writer.writeSigned(x[i], bitsPerSample);
+    }
+
+    // RICE2, 5 bit parameters
+    writer.write(1, 2);
+    writer.write(subframe.partitionOrder, 4);
+    const std::size_t partitionSize = count >> subframe.partitionOrder;
+    std::size_t i = subframe.order;
+    for (std::size_t j = 0; j < subframe.parameters.size(); j++) {
+        const unsigned k = subframe.parameters[j];
+        writer.write(k, 5);
+        const std::size_t end = (j + 1) * partitionSize;
+        for (; i < end; i++) {
+            const std::uint64_t value =
+                fold(fixedResidual(x, i, subframe.order));
+            writer.writeUnary(value >> k);
+            writer.write(value, k);
+        }
+    }
+}
+
+}  // namespace
+
+FlacEncoder::FlacEncoder(std::uint32_t sampleRate, std::size_t channels,
+                         std::uint32_t bitsPerSample)
+    : m_sampleRate(sampleRate),
+      m_channels(channels),
+      m_bitsPerSample(bitsPerSample) {
+    m_pending.reserve(s_blockSize * channels);
+}
+
+void FlacEncoder::addFrames(const std::int32_t* samples, std::size_t frames) {
+    const std::size_t blockSamples = s_blockSize * m_channels;
+    std::size_t offset = 0;
+
+    if (!m_pending.empty()) {
+        const std::size_t take =
+            std::min(frames, (blockSamples - m_pending.size()) / m_channels);
+        m_pending.insert(m_pending.end(), samples,
+                         samples + take * m_channels);
+        offset = take;
+        if (m_pending.size() < blockSamples) {
+            return;
+        }
+        this->encodeFrame(m_pending.data(), s_blockSize);
+        m_pending.clear();
+    }
+
+    for (; frames - offset >= s_blockSize; offset += s_blockSize) {
+        this->encodeFrame(samples + offset * m_channels, s_blockSize);
+    }
+    m_pending.insert(m_pending.end(), samples + offset * m_channels,
+                     samples + frames * m_channels);
+}
+
+void FlacEncoder::encodeFrame(const std::int32_t* samples,
+                              std::size_t frames) {
+    std::vector<std::vector<std::int64_t>> channels(
+        m_channels, std::vector<std::int64_t>(frames));
+    for (std::size_t i = 0; i < frames; i++) {
+        for (std::size_t c = 0; c < m_channels; c++) {
+            channels[c][i] = samples[i * m_channels + c];
+        }
+    }
+
+    std::vector<std::uint64_t> scratch;
+    // Channel assignment, then the signal and bit depth of each subframe
+    unsigned assignment = static_cast<unsigned>(m_channels - 1);
+    std::vector<const std::vector<std::int64_t>*> signals;
+    std::vector<unsigned> depths(m_channels, m_bitsPerSample);
+    std::vector<Subframe> subframes;
+    std::vector<std::int64_t> mid;
+    std::vector<std::int64_t> side;
+
+    if (m_channels == 2) {
+        mid.resize(frames);
+        side.resize(frames);
+        for (std::size_t i = 0; i < frames; i++) {
+            side[i] = channels[0][i] - channels[1][i];
+            mid[i] = (channels[0][i] + channels[1][i]) >> 1;
+        }
+        Subframe left = planSubframe(channels[0].data(), frames,
+                                     m_bitsPerSample, scratch);
+        Subframe right = planSubframe(channels[1].data(), frames,
+                                      m_bitsPerSample, scratch);
+        Subframe midFrame =
+            planSubframe(mid.data(), frames, m_bitsPerSample, scratch);
+        Subframe sideFrame =
+            planSubframe(side.data(), frames, m_bitsPerSample + 1, scratch);
+
+        const std::array<std::uint64_t, 4> costs{
+            left.bits + right.bits, left.bits + sideFrame.bits,
+            sideFrame.bits + right.bits, midFrame.bits + sideFrame.bits};
+        switch (std::min_element(costs.begin(), costs.end()) - costs.begin()) {
+            case 0:
+                signals = {&channels[0], &channels[1]};
+                subframes = {std::move(left), std::move(right)};
+                break;
+            case 1:
+                assignment = 8;
+                signals = {&channels[0], &side};
+                depths[1]++;
+                subframes = {std::move(left), std::move(sideFrame)};
+                break;
+            case 2:
+                assignment = 9;
+                signals = {&side, &channels[1]};
+                depths[0]++;
+                subframes = {std::move(sideFrame), std::move(right)};
+                break;
+            default:
+                assignment = 10;
+                signals = {&mid, &side};
+                depths[1]++;
+                subframes = {std::move(midFrame), std::move(sideFrame)};
+                break;
+        }
+    } else {
+        for (const std::vector<std::int64_t>& channel : channels) {
+            signals.push_back(&channel);
+            subframes.push_back(planSubframe(channel.data(), frames,
+                                             m_bitsPerSample, scratch));
+        }
+    }
+
+    const std::size_t start = m_frames.size();
+    if (m_seekPoints.empty() ||
+        m_samples >= m_seekPoints.back().sample +
+                         std::uint64_t(s_seekPointSeconds) * m_sampleRate) {
+        m_seekPoints.push_back(
+            SeekPoint{.sample = m_samples,
+                      .offset = start,
+                      .frameSamples = static_cast<std::uint16_t>(frames)});
+    }
+
+    BitWriter writer(m_frames);
+    // Sync code, then a fixed block size
+    writer.write(0xfff8, 16);
+    const unsigned blockSizeCode =
+        frames == s_blockSize ? 12 : frames <= 256 ? 6 : 7;
+    writer.write(blockSizeCode, 4);
+    // Sample rate from STREAMINFO
+    writer.write(0, 4);
+    writer.write(assignment, 4);
+    writer.write(sampleSizeCode(m_bitsPerSample), 3);
+    writer.write(0, 1);
+    writeCodedNumber(writer, m_frameNumber);
+    if (blockSizeCode == 6) {
+        writer.write(frames - 1, 8);
+    } else if (blockSizeCode == 7) {
+        writer.write(frames - 1, 16);
+    }
+    writer.write(crc8(m_frames.data() + start, m_frames.size() - start), 8);
+
+    for (std::size_t c = 0; c < subframes.size(); c++) {
+        writeSubframe(writer, subframes[c], signals[c]->data(), frames,
+                      depths[c]);
+    }
+    writer.alignToByte();
+    writer.write(crc16(m_frames.data() + start, m_frames.size() - start), 16);
+
+    const std::uint32_t size =
+        static_cast<std::uint32_t>(m_frames.size() - start);
+    m_minFrameSize = m_frameNumber == 0 ? size : std::min(m_minFrameSize, size);
+    m_maxFrameSize = std::max(m_maxFrameSize, size);
+    m_samples += frames;
+    m_frameNumber++;
+}
+
+std::vector<std::uint8_t> FlacEncoder::finish() {
+    if (!m_pending.empty()) {
+        this->encodeFrame(m_pending.data(), m_pending.size() / m_channels);
+        m_pending.clear();
+    }
+
+    std::vector<std::uint8_t> out;
+    out.reserve(4 + 38 + 4 + m_seekPoints.size() * 18 + m_frames.size());
+    BitWriter writer(out);
+    writer.write(0x664c6143, 32);  // fLaC
+
+    // STREAMINFO, the last block if there is no seek table
+    writer.write(m_seekPoints.empty() ? 1 : 0, 1);
+    writer.write(0, 7);
+    writer.write(34, 24);
+    const std::uint64_t blockSize =
+        std::min<std::uint64_t>(s_blockSize, m_samples);
+    writer.write(blockSize, 16);
+    writer.write(blockSize, 16);
+    writer.write(m_minFrameSize, 24);
+    writer.write(m_maxFrameSize, 24);
+    writer.write(m_sampleRate, 20);
+    writer.write(m_channels - 1, 3);
+    writer.write(m_bitsPerSample - 1, 5);
+    writer.write(m_samples >> 32, 4);
+    writer.write(m_samples, 32);
+    // No MD5 of the audio
+    for (int i = 0; i < 4; i++) {
+        writer.write(0, 32);
+    }
+
+    if (!m_seekPoints.empty()) {
+        writer.write(1, 1);
+        writer.write(3, 7);
+        writer.write(m_seekPoints.size() * 18, 24);
+        for (const SeekPoint& point : m_seekPoints) {
+            writer.write(point.sample >> 32, 32);
+            writer.write(point.sample, 32);
+            writer.write(point.offset >> 32, 32);
+            writer.write(point.offset, 32);
+            writer.write(point.frameSamples, 16);
+        }
+    }
+
+    out.insert(out.end(), m_frames.begin(), m_frames.end());
+    m_frames.clear();
+    return out;
+}
+
+}  // namespace jukebox
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Lossless FLAC encoder using the fixed predictors, stereo decorrelation and
+ * partitioned Rice coding. Not as small as what libFLAC produces at its
+ * highest levels, but close to its default level and fast. The output has a
+ * seek table with a point every few seconds, so decoders can seek without
+ * scanning.
+ */
+class FlacEncoder final {
+private:
+    struct SeekPoint {
+        std::uint64_t sample;
+        // From the first frame header
+        std::uint64_t offset;
+        std::uint16_t frameSamples;
+    };
+
+    std::uint32_t m_sampleRate;
+    std::size_t m_channels;
+    std::uint32_t m_bitsPerSample;
+
+    // Interleaved samples short of a whole block
+    std::vector<std::int32_t> m_pending;
+    std::vector<std::uint8_t> m_frames;
+    std::vector<SeekPoint> m_seekPoints;
+    std::uint64_t m_samples = 0;
+    std::uint32_t m_frameNumber = 0;
+    std::uint32_t m_minFrameSize = 0;
+    std::uint32_t m_maxFrameSize = 0;
+
+    void encodeFrame(const std::int32_t* samples, std::size_t frames);
+
+public:
+    constexpr static inline std::size_t s_blockSize = 4096;
+    constexpr static inline std::uint32_t s_seekPointSeconds = 5;
+
+    /**
+     * @param sampleRate in Hz
+     * @param channels 1 to 8
+     * @param bitsPerSample 8 to 24
+     */
+    FlacEncoder(std::uint32_t sampleRate, std::size_t channels,
+                std::uint32_t bitsPerSample);
+
+    /**
+     * @param samples interleaved signed samples of bitsPerSample bits
+     * @param frames how many samples per channel there are
+     */
+    void addFrames(const std::int32_t* samples, std::size_t frames);
+
+    /**
+     * Encodes what is left and returns the whole file
+     */
+    std::vector<std::uint8_t> finish();
+};
+
+}  // namespace jukebox
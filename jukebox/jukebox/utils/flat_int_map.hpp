@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Open-addressing hash map from int keys, with linear probing over a single
+ * array of (key, value) slots. A lookup hashes the key and walks adjacent
+ * slots, instead of following a bucket to a separately allocated node like
+ * std::unordered_map does.
+ *
+ * Covers the subset of the std::unordered_map interface the manifest uses.
+ * Inserting or erasing invalidates iterators and references.
+ */
+template <class V>
+class FlatIntMap final {
+public:
+    using value_type = std::pair<int, V>;
+
+private:
+    enum class SlotState : std::uint8_t { EMPTY, FULL, ERASED };
+
+    constexpr static inline std::size_t s_minCapacity = 16;
+
+    std::vector<value_type> m_slots;
+    std::vector<SlotState> m_states;
+    std::size_t m_size = 0;
+    // Full and erased slots, probes only stop at empty ones
+    std::size_t m_used = 0;
+
+    static std::size_t hash(int key) {
+        // Murmur3 finalizer, so nearby song IDs spread over the table
+        std::uint32_t h = static_cast<std::uint32_t>(key);
+        h ^= h >> 16;
+        h *= 0x85EBCA6B;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35;
+        h ^= h >> 16;
+        return h;
+    }
+
+    std::size_t mask() const { return m_slots.size() - 1; }
+
+    std::size_t findSlot(int key) const {
+        if (m_slots.empty()) {
+            return m_slots.size();
+        }
+        for (std::size_t i = hash(key) & this->mask();;
+             i = (i + 1) & this->mask()) {
+            if (m_states[i] == SlotState::EMPTY) {
+                return m_slots.size();
+            }
+            if (m_states[i] == SlotState::FULL && m_slots[i].first == key) {
+                return i;
+            }
+        }
+    }
+
+    void rehash(std::size_t capacity) {
+        std::vector<value_type> slots = std::move(m_slots);
+        std::vector<SlotState> states = std::move(m_states);
+
+        m_slots = std::vector<value_type>(capacity);
+        m_states = std::vector<SlotState>(capacity, SlotState::EMPTY);
+        m_used = m_size;
+
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            if (states[i] != SlotState::FULL) {
+                continue;
+            }
+            std::size_t at = hash(slots[i].first) & this->mask();
+            while (m_states[at] != SlotState::EMPTY) {
+                at = (at + 1) & this->mask();
+            }
+            m_slots[at] = std::move(slots[i]);
+            m_states[at] = SlotState::FULL;
+        }
+    }
+
+    // Keeps at most 3/4 of the slots used, so probes stay short
+    static std::size_t capacityFor(std::size_t count) {
+        return std::max(s_minCapacity, std::bit_ceil(count + count / 3 + 1));
+    }
+
+public:
+    template <bool Const>
+    class Iterator {
+    private:
+        friend class FlatIntMap;
+        using Map = std::conditional_t<Const, const FlatIntMap, FlatIntMap>;
+
+        Map* m_map = nullptr;
+        std::size_t m_index = 0;
+
+        Iterator(Map* map, std::size_t index) : m_map(map), m_index(index) {
+            this->skip();
+        }
+
+        void skip() {
+            while (m_index < m_map->m_slots.size() &&
+                   m_map->m_states[m_index] != SlotState::FULL) {
+                m_index++;
+            }
+        }
+
+    public:
+        using reference =
+            std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer =
+            std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+
+        reference operator*() const { return m_map->m_slots[m_index]; }
+        pointer operator->() const { return &m_map->m_slots[m_index]; }
+
+        Iterator& operator++() {
+            m_index++;
+            this->skip();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return m_map == other.m_map && m_index == other.m_index;
+        }
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatIntMap() = default;
+    FlatIntMap(FlatIntMap&&) = default;
+    FlatIntMap& operator=(FlatIntMap&&) = default;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_slots.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_slots.size()); }
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    // Bytes of the slot arrays, what the values own isn't counted
+    std::size_t memoryUsage() const {
+        return m_slots.capacity() * sizeof(value_type) + m_states.capacity();
+    }
+
+    iterator find(int key) { return iterator(this, this->findSlot(key)); }
+    const_iterator find(int key) const {
+        return const_iterator(this, this->findSlot(key));
+    }
+
+    bool contains(int key) const {
+        return this->findSlot(key) != m_slots.size();
+    }
+
+    V& at(int key) {
+        std::size_t slot = this->findSlot(key);
+        if (slot == m_slots.size()) {
+            throw std::out_of_range("FlatIntMap::at");
+        }
+        return m_slots[slot].second;
+    }
+
+    const V& at(int key) const {
+        return const_cast<FlatIntMap*>(this)->at(key);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        if (std::size_t slot = this->findSlot(value.first);
+            slot != m_slots.size()) {
+            return {iterator(this, slot), false};
+        }
+
+        if (m_slots.empty() || (m_used + 1) * 4 > m_slots.size() * 3) {
+            this->rehash(capacityFor(m_size + 1));
+        }
+
+        std::size_t at = hash(value.first) & this->mask();
+        while (m_states[at] == SlotState::FULL) {
+            at = (at + 1) & this->mask();
+        }
+        if (m_states[at] == SlotState::EMPTY) {
+            m_used++;
+        }
+        m_slots[at] = std::move(value);
+        m_states[at] = SlotState::FULL;
+        m_size++;
+        return {iterator(this, at), true};
+    }
+
+    std::size_t erase(int key) {
+        std::size_t slot = this->findSlot(key);
+        if (slot == m_slots.size()) {
+            return 0;
+        }
+        m_slots[slot] = value_type();
+        m_states[slot] = SlotState::ERASED;
+        m_size--;
+        return 1;
+    }
+
+    void reserve(std::size_t count) {
+        if (capacityFor(count) > m_slots.size()) {
+            this->rehash(capacityFor(count));
+        }
+    }
+
+    void clear() {
+        m_slots.clear();
+        m_states.clear();
+        m_size = 0;
+        m_used = 0;
+    }
+};
+
+}  // namespace jukebox
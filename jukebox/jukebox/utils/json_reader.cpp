@@ -0,0 +1,355 @@
+#include <jukebox/utils/json_reader.hpp>
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+using namespace geode;
+
+namespace jukebox {
+
+namespace {
+
+void appendUtf8(std::string& out, std::uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codepoint >> 6));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codepoint >> 12));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codepoint >> 18));
+        out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+}  // namespace
+
+std::string JsonReader::error(std::string_view what) const {
+    return fmt::format("{} at offset {}", what, m_pos);
+}
+
+void JsonReader::skipWhitespace() {
+    while (m_pos < m_text.size()) {
+        const char c = m_text[m_pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            return;
+        }
+        m_pos++;
+    }
+}
+
+Result<> JsonReader::enter(char open) {
+    this->skipWhitespace();
+    if (m_pos >= m_text.size() || m_text[m_pos] != open) {
+        return Err(this->error(open == '{' ? "Expected object"
+                                           : "Expected array"));
+    }
+    if (m_depth >= s_maxDepth) {
+        return Err(this->error("JSON nested too deep"));
+    }
+    m_pos++;
+    m_depth++;
+    return Ok();
+}
+
+bool JsonReader::tryLeave(char close) {
+    this->skipWhitespace();
+    if (m_pos < m_text.size() && m_text[m_pos] == close) {
+        m_pos++;
+        m_depth--;
+        return true;
+    }
+    return false;
+}
+
+Result<bool> JsonReader::next(char close) {
+    this->skipWhitespace();
+    if (m_pos < m_text.size()) {
+        if (m_text[m_pos] == ',') {
+            m_pos++;
+            return Ok(true);
+        }
+        if (m_text[m_pos] == close) {
+            m_pos++;
+            m_depth--;
+            return Ok(false);
+        }
+    }
+    return Err(
+        this->error(close == '}' ? "Expected , or }" : "Expected , or ]"));
+}
+
+Result<std::string_view> JsonReader::readKey() {
+    GEODE_UNWRAP_INTO(std::string_view key,
+                      this->readStringInto(m_keyScratch));
+    this->skipWhitespace();
+    if (m_pos >= m_text.size() || m_text[m_pos] != ':') {
+        return Err(this->error("Expected :"));
+    }
+    m_pos++;
+    return Ok(key);
+}
+
+Result<std::string_view> JsonReader::readStringInto(std::string& scratch) {
+    this->skipWhitespace();
+    if (m_pos >= m_text.size() || m_text[m_pos] != '"') {
+        return Err(this->error("Expected string"));
+    }
+    const std::size_t start = ++m_pos;
+
+    // Most strings have no escapes and are handed out as they are
+    while (m_pos < m_text.size() && m_text[m_pos] != '"' &&
+           m_text[m_pos] != '\\') {
+        if (static_cast<unsigned char>(m_text[m_pos]) < 0x20) {
+            return Err(this->error("Control character in string"));
+        }
+        m_pos++;
+    }
+    if (m_pos >= m_text.size()) {
+        return Err(this->error("Unterminated string"));
+    }
+    if (m_text[m_pos] == '"') {
+        return Ok(m_text.substr(start, m_pos++ - start));
+    }
+
+    scratch.assign(m_text.substr(start, m_pos - start));
+    auto readHex = [this](std::uint32_t& out) -> bool {
+        if (m_text.size() - m_pos < 4) {
+            return false;
+        }
+        auto [end, ec] = std::from_chars(m_text.data() + m_pos,
+                                         m_text.data() + m_pos + 4, out, 16);
+        if (ec != std::errc() || end != m_text.data() + m_pos + 4) {
+            return false;
+        }
+        m_pos += 4;
+        return true;
+    };
+
+    while (m_pos < m_text.size()) {
+        const char c = m_text[m_pos++];
+        if (c == '"') {
+            return Ok(std::string_view(scratch));
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            return Err(this->error("Control character in string"));
+        }
+        if (c != '\\') {
+            scratch += c;
+            continue;
+        }
+        if (m_pos >= m_text.size()) {
+            break;
+        }
+        switch (m_text[m_pos++]) {
+            case '"':
+                scratch += '"';
+                break;
+            case '\\':
+                scratch += '\\';
+                break;
+            case '/':
+                scratch += '/';
+                break;
+            case 'b':
+                scratch += '\b';
+                break;
+            case 'f':
+                scratch += '\f';
+                break;
+            case 'n':
+                scratch += '\n';
+                break;
+            case 'r':
+                scratch += '\r';
+                break;
+            case 't':
+                scratch += '\t';
+                break;
+            case 'u': {
+                std::uint32_t codepoint = 0;
+                if (!readHex(codepoint)) {
+                    return Err(this->error("Invalid \\u escape"));
+                }
+                // Characters outside the BMP come as a surrogate pair
+                if (codepoint >= 0xD800 && codepoint < 0xDC00 &&
+                    m_text.substr(m_pos, 2) == "\\u") {
+                    m_pos += 2;
+                    std::uint32_t low = 0;
+                    if (!readHex(low) || low < 0xDC00 || low >= 0xE000) {
+                        return Err(this->error("Invalid surrogate pair"));
+                    }
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) +
+                                (low - 0xDC00);
+                }
+                appendUtf8(scratch, codepoint);
+                break;
+            }
+            default:
+                return Err(this->error("Invalid escape"));
+        }
+    }
+    return Err(this->error("Unterminated string"));
+}
+
+Result<std::string_view> JsonReader::readNumberToken() {
+    this->skipWhitespace();
+    const std::size_t start = m_pos;
+    while (m_pos < m_text.size()) {
+        const char c = m_text[m_pos];
+        if ((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' &&
+            c != 'e' && c != 'E') {
+            break;
+        }
+        m_pos++;
+    }
+    if (m_pos == start) {
+        return Err(this->error("Expected number"));
+    }
+    return Ok(m_text.substr(start, m_pos - start));
+}
+
+Result<> JsonReader::readLiteral(std::string_view literal) {
+    this->skipWhitespace();
+    if (m_text.substr(m_pos, literal.size()) != literal) {
+        return Err(this->error(fmt::format("Expected {}", literal)));
+    }
+    m_pos += literal.size();
+    return Ok();
+}
+
+Result<JsonReader::Type> JsonReader::peek() {
+    this->skipWhitespace();
+    if (m_pos >= m_text.size()) {
+        return Err(this->error("Unexpected end of JSON"));
+    }
+    switch (m_text[m_pos]) {
+        case '{':
+            return Ok(Type::Object);
+        case '[':
+            return Ok(Type::Array);
+        case '"':
+            return Ok(Type::String);
+        case 't':
+        case 'f':
+            return Ok(Type::Bool);
+        case 'n':
+            return Ok(Type::Null);
+        default:
+            break;
+    }
+    const char c = m_text[m_pos];
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        return Ok(Type::Number);
+    }
+    return Err(this->error("Unexpected character"));
+}
+
+Result<> JsonReader::readNull() { return this->readLiteral("null"); }
+
+Result<bool> JsonReader::readBool() {
+    this->skipWhitespace();
+    if (m_text.substr(m_pos, 4) == "true") {
+        m_pos += 4;
+        return Ok(true);
+    }
+    GEODE_UNWRAP(this->readLiteral("false"));
+    return Ok(false);
+}
+
+Result<double> JsonReader::readDouble() {
+    GEODE_UNWRAP_INTO(std::string_view token, this->readNumberToken());
+    // from_chars for doubles is missing from some of the standard libraries
+    // the mod is built with
+    const std::string copy(token);
+    char* end = nullptr;
+    const double value = std::strtod(copy.c_str(), &end);
+    if (end != copy.c_str() + copy.size()) {
+        return Err(this->error("Invalid number"));
+    }
+    return Ok(value);
+}
+
+Result<std::int64_t> JsonReader::readInt() {
+    const std::size_t start = m_pos;
+    GEODE_UNWRAP_INTO(std::string_view token, this->readNumberToken());
+    std::int64_t value = 0;
+    auto [end, ec] =
+        std::from_chars(token.data(), token.data() + token.size(), value);
+    if (ec == std::errc() && end == token.data() + token.size()) {
+        return Ok(value);
+    }
+    m_pos = start;
+    GEODE_UNWRAP_INTO(double number, this->readDouble());
+    // Casting a number outside the range is undefined. 2^63 is exact as a
+    // double, the largest int64 isn't.
+    if (!(number >= -0x1p63 && number < 0x1p63)) {
+        m_pos = start;
+        return Err(this->error("Number out of range"));
+    }
+    return Ok(static_cast<std::int64_t>(number));
+}
+
+Result<std::string_view> JsonReader::readString() {
+    return this->readStringInto(m_scratch);
+}
+
+Result<> JsonReader::skip() {
+    GEODE_UNWRAP_INTO(Type type, this->peek());
+    switch (type) {
+        case Type::Null:
+            return this->readNull();
+        case Type::Bool:
+            GEODE_UNWRAP(this->readBool());
+            return Ok();
+        case Type::Number:
+            GEODE_UNWRAP(this->readNumberToken());
+            return Ok();
+        case Type::String:
+            GEODE_UNWRAP(this->readString());
+            return Ok();
+        case Type::Array:
+            return this->readArray([this]() { return this->skip(); });
+        case Type::Object:
+            return this->readObject(
+                [this](std::string_view) { return this->skip(); });
+    }
+    return Ok();
+}
+
+Result<std::string_view> JsonReader::readRaw() {
+    this->skipWhitespace();
+    const std::size_t start = m_pos;
+    GEODE_UNWRAP(this->skip());
+    return Ok(m_text.substr(start, m_pos - start));
+}
+
+Result<matjson::Value> JsonReader::readValue() {
+    GEODE_UNWRAP_INTO(std::string_view raw, this->readRaw());
+    return matjson::parse(raw).mapErr(
+        [](matjson::ParseError err) { return fmt::format("{}", err); });
+}
+
+Result<> JsonReader::finish() {
+    this->skipWhitespace();
+    if (m_pos != m_text.size()) {
+        return Err(this->error("Unexpected data after JSON"));
+    }
+    return Ok();
+}
+
+}  // namespace jukebox
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+namespace jukebox {
+
+/**
+ * Pull parser over JSON text. Values are read in document order straight
+ * from the text, so a large document is never held as a matjson::Value as a
+ * whole. Every read method consumes exactly one value, a value that isn't
+ * needed has to be skipped.
+ *
+ * Syntax errors are fatal, the reader can't be used after one.
+ */
+class JsonReader final {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    // Nesting deeper than this is rejected instead of recursing further
+    constexpr static inline std::size_t s_maxDepth = 128;
+
+private:
+    std::string_view m_text;
+    std::size_t m_pos = 0;
+    std::size_t m_depth = 0;
+    // Unescaped strings, values and keys get their own so a key survives
+    // reading a string value
+    std::string m_scratch;
+    std::string m_keyScratch;
+
+    std::string error(std::string_view what) const;
+    void skipWhitespace();
+    geode::Result<> enter(char open);
+    bool tryLeave(char close);
+    geode::Result<bool> next(char close);
+    geode::Result<std::string_view> readKey();
+    geode::Result<std::string_view> readStringInto(std::string& scratch);
+    geode::Result<std::string_view> readNumberToken();
+    geode::Result<> readLiteral(std::string_view literal);
+
+public:
+    explicit JsonReader(std::string_view text) : m_text(text) {}
+
+    std::size_t offset() const { return m_pos; }
+
+    /**
+     * Type of the next value, without consuming it
+     */
+    geode::Result<Type> peek();
+
+    geode::Result<> readNull();
+    geode::Result<bool> readBool();
+    geode::Result<double> readDouble();
+    /**
+     * Reads a number, truncating it if it has a fraction. Fails if it
+     * doesn't fit in 64 bits
+     */
+    geode::Result<std::int64_t> readInt();
+    /**
+     * Reads a string. The view points into the text if the string has no
+     * escapes, otherwise into a buffer the next string read reuses.
+     */
+    geode::Result<std::string_view> readString();
+
+    /**
+     * Reads an object, calling fn(key) for each of its members. fn has to
+     * consume the value of the member and return a Result<>. The key is only
+     * valid until the next key is read, which nested objects do too.
+     */
+    template <class Fn>
+    geode::Result<> readObject(Fn&& fn) {
+        GEODE_UNWRAP(this->enter('{'));
+        if (this->tryLeave('}')) {
+            return geode::Ok();
+        }
+        while (true) {
+            GEODE_UNWRAP_INTO(std::string_view key, this->readKey());
+            GEODE_UNWRAP(fn(key));
+            GEODE_UNWRAP_INTO(bool more, this->next('}'));
+            if (!more) {
+                return geode::Ok();
+            }
+        }
+    }
+
+    /**
+     * Reads an array, calling fn() for each of its elements. fn has to
+     * consume the element and return a Result<>.
+     */
+    template <class Fn>
+    geode::Result<> readArray(Fn&& fn) {
+        GEODE_UNWRAP(this->enter('['));
+        if (this->tryLeave(']')) {
+            return geode::Ok();
+        }
+        while (true) {
+            GEODE_UNWRAP(fn());
+            GEODE_UNWRAP_INTO(bool more, this->next(']'));
+            if (!more) {
+                return geode::Ok();
+            }
+        }
+    }
+
+    /**
+     * Consumes the next value without looking at it
+     */
+    geode::Result<> skip();
+
+    /**
+     * Consumes the next value, returning its text as it is in the document
+     */
+    geode::Result<std::string_view> readRaw();
+
+    /**
+     * Reads the next value as a matjson::Value. For the small parts of a
+     * document that are easier to handle as a DOM.
+     */
+    geode::Result<matjson::Value> readValue();
+
+    /**
+     * Checks that nothing but whitespace follows the values read
+     */
+    geode::Result<> finish();
+};
+
+}  // namespace jukebox
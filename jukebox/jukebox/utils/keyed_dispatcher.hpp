@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Delivers an event only to the callbacks subscribed to its key, instead of
+ * waking every listener and letting each one filter.
+ *
+ * Callbacks may subscribe or unsubscribe while an event is being delivered.
+ * Main thread only.
+ */
+template <class Key, class Event, class Hash = std::hash<Key>>
+class KeyedDispatcher final {
+public:
+    using Callback = std::function<void(Event*)>;
+
+    /**
+     * Keeps a callback subscribed for as long as it lives
+     */
+    class Subscription final {
+    private:
+        friend class KeyedDispatcher;
+
+        KeyedDispatcher* m_owner = nullptr;
+        Key m_key{};
+        std::uint64_t m_id = 0;
+
+        Subscription(KeyedDispatcher* owner, Key key, std::uint64_t id)
+            : m_owner(owner), m_key(std::move(key)), m_id(id) {}
+
+    public:
+        Subscription() = default;
+        Subscription(const Subscription&) = delete;
+        Subscription& operator=(const Subscription&) = delete;
+
+        Subscription(Subscription&& other) noexcept
+            : m_owner(std::exchange(other.m_owner, nullptr)),
+              m_key(std::move(other.m_key)),
+              m_id(std::exchange(other.m_id, 0)) {}
+
+        Subscription& operator=(Subscription&& other) noexcept {
+            if (this != &other) {
+                this->reset();
+                m_owner = std::exchange(other.m_owner, nullptr);
+                m_key = std::move(other.m_key);
+                m_id = std::exchange(other.m_id, 0);
+            }
+            return *this;
+        }
+
+        ~Subscription() { this->reset(); }
+
+        void reset() {
+            if (m_owner) {
+                m_owner->unsubscribe(m_key, m_id);
+                m_owner = nullptr;
+            }
+        }
+    };
+
+private:
+    struct Entry {
+        std::uint64_t id;
+        Callback callback;
+    };
+
+    std::unordered_map<Key, std::vector<Entry>, Hash> m_entries;
+    std::uint64_t m_nextID = 1;
+    // Entries are only blanked while delivering, and compacted after
+    std::size_t m_dispatching = 0;
+    bool m_hasBlanks = false;
+
+    void unsubscribe(const Key& key, std::uint64_t id) {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            return;
+        }
+        for (auto entry = it->second.begin(); entry != it->second.end();
+             entry++) {
+            if (entry->id != id) {
+                continue;
+            }
+            if (m_dispatching > 0) {
+                entry->callback = nullptr;
+                m_hasBlanks = true;
+            } else {
+                it->second.erase(entry);
+                if (it->second.empty()) {
+                    m_entries.erase(it);
+                }
+            }
+            return;
+        }
+    }
+
+    void compact() {
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            std::erase_if(it->second,
+                          [](const Entry& entry) { return !entry.callback; });
+            it = it->second.empty() ? m_entries.erase(it) : std::next(it);
+        }
+        m_hasBlanks = false;
+    }
+
+public:
+    KeyedDispatcher() = default;
+    KeyedDispatcher(const KeyedDispatcher&) = delete;
+    KeyedDispatcher& operator=(const KeyedDispatcher&) = delete;
+
+    [[nodiscard]] Subscription subscribe(Key key, Callback callback) {
+        const std::uint64_t id = m_nextID++;
+        m_entries[key].push_back(Entry{id, std::move(callback)});
+        return Subscription(this, std::move(key), id);
+    }
+
+    void dispatch(const Key& key, Event* event) {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            return;
+        }
+
+        m_dispatching++;
+        // References to map values survive rehashing, and nothing is erased
+        // while dispatching, so the list stays valid even if callbacks
+        // subscribe
+        std::vector<Entry>& entries = it->second;
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i].callback) {
+                continue;
+            }
+            // Copied, a subscribe in the callback can reallocate the list
+            Callback callback = entries[i].callback;
+            callback(event);
+        }
+        m_dispatching--;
+
+        if (m_dispatching == 0 && m_hasBlanks) {
+            this->compact();
+        }
+    }
+};
+
+}  // namespace jukebox
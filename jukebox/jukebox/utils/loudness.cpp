@@ -0,0 +1,126 @@
+#include <jukebox/utils/loudness.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <optional>
+
+namespace jukebox {
+
+namespace {
+
+constexpr double s_absoluteGate = -70.0;
+constexpr double s_relativeGate = -10.0;
+
+double toLoudness(double meanSquare) {
+    return -0.691 + 10.0 * std::log10(meanSquare);
+}
+
+}  // namespace
+
+LoudnessMeter::LoudnessMeter(int sampleRate, std::size_t channels)
+    : m_channels(channels),
+      m_states(channels * 2),
+      m_stepFrames(static_cast<std::size_t>(sampleRate) / 10) {
+    // BS.1770 only specifies the coefficients at 48 kHz, these are the
+    // analog prototypes they come from, so any sample rate works
+    const double rate = static_cast<double>(sampleRate);
+
+    double k = std::tan(std::numbers::pi * 1681.974450955533 / rate);
+    double q = 0.7071752369554196;
+    const double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_filters[0] = Biquad{(vh + vb * k / q + k * k) / a0,
+                          2.0 * (k * k - vh) / a0,
+                          (vh - vb * k / q + k * k) / a0,
+                          2.0 * (k * k - 1.0) / a0,
+                          (1.0 - k / q + k * k) / a0};
+
+    k = std::tan(std::numbers::pi * 38.13547087602444 / rate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    m_filters[1] = Biquad{1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0,
+                          (1.0 - k / q + k * k) / a0};
+}
+
+double LoudnessMeter::filter(std::size_t channel, double sample) {
+    for (std::size_t i = 0; i < m_filters.size(); i++) {
+        const Biquad& f = m_filters[i];
+        FilterState& s = m_states[channel * 2 + i];
+        const double out = f.b0 * sample + f.b1 * s.x1 + f.b2 * s.x2 -
+                           f.a1 * s.y1 - f.a2 * s.y2;
+        s.x2 = s.x1;
+        s.x1 = sample;
+        s.y2 = s.y1;
+        s.y1 = out;
+        sample = out;
+    }
+    return sample;
+}
+
+void LoudnessMeter::addFrames(const float* samples, std::size_t frames) {
+    if (m_channels == 0 || m_stepFrames == 0) {
+        return;
+    }
+
+    for (std::size_t frame = 0; frame < frames; frame++) {
+        for (std::size_t channel = 0; channel < m_channels; channel++) {
+            const double out =
+                this->filter(channel, samples[frame * m_channels + channel]);
+            // Surround channels of a 5.1 layout weigh about 1.5 dB more
+            const double weight =
+                m_channels == 6 && channel >= 4 ? 1.41 : 1.0;
+            m_stepSum += weight * out * out;
+        }
+
+        if (++m_stepFilled < m_stepFrames) {
+            continue;
+        }
+        m_steps[m_stepCount % m_steps.size()] =
+            m_stepSum / static_cast<double>(m_stepFrames);
+        m_stepCount++;
+        m_stepSum = 0;
+        m_stepFilled = 0;
+
+        if (m_stepCount >= m_steps.size()) {
+            double block = 0;
+            for (double step : m_steps) {
+                block += step;
+            }
+            block /= static_cast<double>(m_steps.size());
+            if (block > 0 && toLoudness(block) > s_absoluteGate) {
+                m_blocks.push_back(block);
+            }
+        }
+    }
+}
+
+std::optional<double> LoudnessMeter::integrated() const {
+    if (m_blocks.empty()) {
+        return std::nullopt;
+    }
+
+    double sum = 0;
+    for (double block : m_blocks) {
+        sum += block;
+    }
+    const double threshold =
+        toLoudness(sum / static_cast<double>(m_blocks.size())) +
+        s_relativeGate;
+
+    double gatedSum = 0;
+    std::size_t gatedCount = 0;
+    for (double block : m_blocks) {
+        if (toLoudness(block) > threshold) {
+            gatedSum += block;
+            gatedCount++;
+        }
+    }
+    if (gatedCount == 0) {
+        return std::nullopt;
+    }
+    return toLoudness(gatedSum / static_cast<double>(gatedCount));
+}
+
+}  // namespace jukebox
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Integrated loudness as defined by EBU R128 / ITU-R BS.1770: K-weighted,
+ * measured over 400 ms blocks overlapping by 75%, with the absolute and
+ * relative gates applied. Fed decoded audio in chunks of any size.
+ */
+class LoudnessMeter final {
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    struct FilterState {
+        double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    };
+
+    std::size_t m_channels;
+    // The high shelf of the K-weighting filter, then its high-pass
+    std::array<Biquad, 2> m_filters;
+    // Two per channel, one for each filter
+    std::vector<FilterState> m_states;
+
+    std::size_t m_stepFrames;
+    // Weighted mean squares of the 100 ms steps, the last four make a block
+    std::array<double, 4> m_steps{};
+    std::size_t m_stepCount = 0;
+    double m_stepSum = 0;
+    std::size_t m_stepFilled = 0;
+    std::vector<double> m_blocks;
+
+    double filter(std::size_t channel, double sample);
+
+public:
+    LoudnessMeter(int sampleRate, std::size_t channels);
+
+    /**
+     * @param samples interleaved samples in [-1, 1]
+     * @param frames how many samples per channel there are
+     */
+    void addFrames(const float* samples, std::size_t frames);
+
+    /**
+     * @return the loudness in LUFS, std::nullopt if everything so far was
+     * below the absolute gate
+     */
+    std::optional<double> integrated() const;
+};
+
+}  // namespace jukebox
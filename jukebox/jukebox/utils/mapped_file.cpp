@@ -0,0 +1,152 @@
+#include <jukebox/utils/mapped_file.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+
+#ifdef GEODE_IS_WINDOWS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    this->release();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+#ifdef GEODE_IS_WINDOWS
+    m_file = std::exchange(other.m_file, nullptr);
+    m_mapping = std::exchange(other.m_mapping, nullptr);
+#else
+    m_fd = std::exchange(other.m_fd, -1);
+#endif
+    return *this;
+}
+
+MappedFile::~MappedFile() { this->release(); }
+
+#ifdef GEODE_IS_WINDOWS
+
+void MappedFile::release() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file) {
+        CloseHandle(m_file);
+        m_file = nullptr;
+    }
+    m_size = 0;
+}
+
+Result<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+    MappedFile ret;
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return Err(fmt::format("Couldn't open {}: error {}",
+                               path.filename().string(), GetLastError()));
+    }
+    ret.m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        return Err(fmt::format("Couldn't get size of {}: error {}",
+                               path.filename().string(), GetLastError()));
+    }
+    ret.m_size = static_cast<std::size_t>(size.QuadPart);
+
+    // Mapping an empty file is an error on Windows
+    if (ret.m_size == 0) {
+        return Ok(std::move(ret));
+    }
+
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        return Err(fmt::format("Couldn't map {}: error {}",
+                               path.filename().string(), GetLastError()));
+    }
+    ret.m_mapping = mapping;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        return Err(fmt::format("Couldn't map view of {}: error {}",
+                               path.filename().string(), GetLastError()));
+    }
+    ret.m_data = static_cast<const std::uint8_t*>(view);
+
+    return Ok(std::move(ret));
+}
+
+#else
+
+void MappedFile::release() {
+    if (m_data) {
+        munmap(const_cast<std::uint8_t*>(m_data), m_size);
+        m_data = nullptr;
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_size = 0;
+}
+
+Result<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+    MappedFile ret;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return Err(fmt::format("Couldn't open {}", path.filename().string()));
+    }
+    ret.m_fd = fd;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return Err(
+            fmt::format("Couldn't get size of {}", path.filename().string()));
+    }
+    ret.m_size = static_cast<std::size_t>(st.st_size);
+
+    if (ret.m_size == 0) {
+        return Ok(std::move(ret));
+    }
+
+    void* view = mmap(nullptr, ret.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        ret.m_size = 0;
+        return Err(fmt::format("Couldn't map {}", path.filename().string()));
+    }
+    ret.m_data = static_cast<const std::uint8_t*>(view);
+
+    return Ok(std::move(ret));
+}
+
+#endif
+
+}  // namespace jukebox
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+#include <Geode/Result.hpp>
+#include <Geode/platform/cplatform.h>
+
+namespace jukebox {
+
+/**
+ * Read-only memory mapping of a whole file. The mapping is released when the
+ * object is destroyed.
+ */
+class MappedFile final {
+private:
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+#ifdef GEODE_IS_WINDOWS
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+
+    MappedFile() = default;
+    void release();
+
+public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    ~MappedFile();
+
+    /**
+     * Maps a file into memory
+     *
+     * @param path the file to map
+     * @return the mapping, or an error if the file couldn't be opened
+     */
+    static geode::Result<MappedFile> open(const std::filesystem::path& path);
+
+    const std::uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    std::span<const std::uint8_t> bytes() const { return {m_data, m_size}; }
+};
+
+}  // namespace jukebox
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Estimated memory held by one kind of object, for the profiler popup.
+ * Estimates count the objects and what they own on the heap, not allocator
+ * overhead.
+ */
+struct MemoryUsage {
+    // A string literal
+    const char* name;
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+};
+
+/**
+ * Heap estimates of the standard containers, without the object itself
+ */
+namespace memory {
+
+template <class C>
+std::size_t heapBytes(const std::basic_string<C>& str) {
+    // Short strings live inside the object
+    static const std::size_t inlineCapacity = std::basic_string<C>().capacity();
+    return str.capacity() > inlineCapacity ? (str.capacity() + 1) * sizeof(C)
+                                           : 0;
+}
+
+inline std::size_t heapBytes(const std::filesystem::path& path) {
+    return heapBytes(path.native());
+}
+
+template <class T>
+std::size_t heapBytes(const std::optional<T>& value) {
+    return value.has_value() ? heapBytes(value.value()) : 0;
+}
+
+template <class T>
+std::size_t heapBytes(const std::vector<T>& vec) {
+    return vec.capacity() * sizeof(T);
+}
+
+// A bucket array plus one node per element, holding the element and a next
+// pointer and cached hash
+template <class K, class V, class H, class E, class A>
+std::size_t heapBytes(const std::unordered_map<K, V, H, E, A>& map) {
+    return map.bucket_count() * sizeof(void*) +
+           map.size() * (sizeof(typename std::unordered_map<
+                                K, V, H, E, A>::value_type) +
+                         2 * sizeof(void*));
+}
+
+template <class K, class H, class E, class A>
+std::size_t heapBytes(const std::unordered_set<K, H, E, A>& set) {
+    return set.bucket_count() * sizeof(void*) +
+           set.size() * (sizeof(K) + 2 * sizeof(void*));
+}
+
+/**
+ * Counts the live objects of a class deriving from it, for kinds that are
+ * too spread out to walk, like list cells. Main thread only.
+ */
+template <class T>
+class Counted {
+private:
+    static inline std::size_t s_live = 0;
+
+protected:
+    Counted() { s_live++; }
+    Counted(const Counted&) { s_live++; }
+    ~Counted() { s_live--; }
+
+public:
+    static std::size_t live() { return s_live; }
+};
+
+}  // namespace memory
+
+}  // namespace jukebox
@@ -0,0 +1,232 @@
+#include <jukebox/utils/mp3_frames.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace jukebox {
+
+namespace {
+
+// Layer III bitrates in kbps
+constexpr std::array<std::uint16_t, 15> s_bitratesV1{
+    0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+constexpr std::array<std::uint16_t, 15> s_bitratesV2{
+    0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+constexpr std::array<std::uint32_t, 3> s_sampleRates{44100, 48000, 32000};
+// How far past the ID3v2 tag the first frame is looked for
+constexpr std::size_t s_maxSyncSearch = 64 * 1024;
+constexpr std::size_t s_tocEntries = 100;
+
+// version is 3 for MPEG-1, 2 for MPEG-2 and 0 for MPEG-2.5
+struct FrameHeader {
+    unsigned version;
+    unsigned bitrateIndex;
+    bool crc;
+    bool mono;
+    std::uint32_t sampleRate;
+    std::uint32_t size;
+};
+
+std::uint32_t frameSize(unsigned version, unsigned bitrateIndex,
+                        std::uint32_t sampleRate, bool padding) {
+    const bool v1 = version == 3;
+    const std::uint32_t kbps =
+        v1 ? s_bitratesV1[bitrateIndex] : s_bitratesV2[bitrateIndex];
+    return (v1 ? 144000 : 72000) * kbps / sampleRate + padding;
+}
+
+// Where the side information of a frame ends, which is where a Xing header
+// goes
+std::size_t sideInfoEnd(unsigned version, bool mono, bool crc) {
+    const std::size_t sideInfo =
+        version == 3 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    return 4 + (crc ? 2 : 0) + sideInfo;
+}
+
+std::optional<FrameHeader> parseHeader(const std::uint8_t* p) {
+    if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0) {
+        return std::nullopt;
+    }
+    const unsigned version = p[1] >> 3 & 3;
+    const unsigned layer = p[1] >> 1 & 3;
+    const unsigned bitrateIndex = p[2] >> 4;
+    const unsigned sampleRateIndex = p[2] >> 2 & 3;
+    // Reserved values, free format streams and other layers aren't
+    // supported
+    if (version == 1 || layer != 1 || bitrateIndex == 0 ||
+        bitrateIndex == 15 || sampleRateIndex == 3) {
+        return std::nullopt;
+    }
+
+    const std::uint32_t sampleRate = s_sampleRates[sampleRateIndex] >>
+                                     (version == 3 ? 0 : version == 2 ? 1 : 2);
+    return FrameHeader{
+        .version = version,
+        .bitrateIndex = bitrateIndex,
+        .crc = (p[1] & 1) == 0,
+        .mono = p[3] >> 6 == 3,
+        .sampleRate = sampleRate,
+        .size = frameSize(version, bitrateIndex, sampleRate, p[2] >> 1 & 1)};
+}
+
+bool sameStream(const FrameHeader& a, const FrameHeader& b) {
+    return a.version == b.version && a.sampleRate == b.sampleRate;
+}
+
+// ID3v2 sizes keep the top bit of every byte clear
+std::uint32_t syncsafe(const std::uint8_t* p) {
+    return std::uint32_t(p[0] & 0x7f) << 21 | std::uint32_t(p[1] & 0x7f) << 14 |
+           std::uint32_t(p[2] & 0x7f) << 7 | (p[3] & 0x7f);
+}
+
+void writeBe32(std::uint8_t* p, std::uint32_t value) {
+    p[0] = static_cast<std::uint8_t>(value >> 24);
+    p[1] = static_cast<std::uint8_t>(value >> 16);
+    p[2] = static_cast<std::uint8_t>(value >> 8);
+    p[3] = static_cast<std::uint8_t>(value);
+}
+
+}  // namespace
+
+std::optional<Mp3Stream> scanMp3(std::span<const std::uint8_t> data) {
+    std::size_t at = 0;
+    if (data.size() >= 10 && std::memcmp(data.data(), "ID3", 3) == 0) {
+        at = 10 + syncsafe(data.data() + 6) + (data[5] & 0x10 ? 10 : 0);
+    }
+
+    // Tags are often padded, and some files have junk before the first
+    // frame. A frame only counts if the next one follows it
+    std::optional<FrameHeader> first;
+    const std::size_t searchEnd =
+        std::min(data.size(), at + s_maxSyncSearch);
+    for (; at + 4 <= searchEnd; at++) {
+        std::optional<FrameHeader> header = parseHeader(data.data() + at);
+        if (!header) {
+            continue;
+        }
+        const std::size_t next = at + header->size;
+        if (next == data.size()) {
+            first = header;
+            break;
+        }
+        if (next + 4 <= data.size()) {
+            std::optional<FrameHeader> following =
+                parseHeader(data.data() + next);
+            if (following && sameStream(*header, *following)) {
+                first = header;
+                break;
+            }
+        }
+    }
+    if (!first) {
+        return std::nullopt;
+    }
+
+    Mp3Stream stream;
+    stream.sampleRate = first->sampleRate;
+    stream.samplesPerFrame = first->version == 3 ? 1152 : 576;
+    std::copy_n(data.data() + at, 4, stream.header.begin());
+
+    const std::size_t tag =
+        at + sideInfoEnd(first->version, first->mono, first->crc);
+    if (tag + 4 <= at + first->size &&
+        (std::memcmp(data.data() + tag, "Xing", 4) == 0 ||
+         std::memcmp(data.data() + tag, "Info", 4) == 0)) {
+        stream.hasSeekHeader = true;
+    } else if (36 + 4 <= first->size &&
+               std::memcmp(data.data() + at + 36, "VBRI", 4) == 0) {
+        stream.hasSeekHeader = true;
+    }
+    // The header frame holds no audio
+    if (stream.hasSeekHeader) {
+        at += first->size;
+    }
+
+    std::optional<unsigned> bitrateIndex;
+    while (at + 4 <= data.size()) {
+        std::optional<FrameHeader> header = parseHeader(data.data() + at);
+        if (!header || !sameStream(*header, *first) ||
+            at + header->size > data.size()) {
+            break;
+        }
+        if (!bitrateIndex) {
+            bitrateIndex = header->bitrateIndex;
+        } else if (*bitrateIndex != header->bitrateIndex) {
+            stream.constantBitrate = false;
+        }
+        stream.frames.push_back(at);
+        at += header->size;
+    }
+    if (stream.frames.empty()) {
+        return std::nullopt;
+    }
+    stream.audioEnd = at;
+
+    return stream;
+}
+
+std::optional<std::vector<std::uint8_t>> buildXingFrame(
+    const Mp3Stream& stream) {
+    if (stream.frames.empty()) {
+        return std::nullopt;
+    }
+
+    const unsigned version = stream.header[1] >> 3 & 3;
+    const unsigned sampleRateIndex = stream.header[2] >> 2 & 3;
+    const bool mono = stream.header[3] >> 6 == 3;
+    const std::size_t tag = sideInfoEnd(version, mono, false);
+    // Tag, flags, frame count, byte count, seek table
+    const std::size_t needed = tag + 4 + 4 + 4 + 4 + s_tocEntries;
+
+    unsigned bitrateIndex = 1;
+    std::uint32_t size = 0;
+    for (; bitrateIndex < 15; bitrateIndex++) {
+        size = frameSize(version, bitrateIndex, stream.sampleRate, false);
+        if (size >= needed) {
+            break;
+        }
+    }
+    if (bitrateIndex == 15) {
+        return std::nullopt;
+    }
+
+    std::vector<std::uint8_t> frame(size, 0);
+    frame[0] = 0xff;
+    // Same stream, without a CRC, at the bitrate picked
+    frame[1] = stream.header[1] | 1;
+    frame[2] = static_cast<std::uint8_t>(bitrateIndex << 4 |
+                                         sampleRateIndex << 2 |
+                                         (stream.header[2] & 1));
+    frame[3] = stream.header[3];
+
+    const std::uint64_t audioBytes = stream.audioEnd - stream.frames.front();
+    const std::uint64_t total = size + audioBytes;
+    std::memcpy(frame.data() + tag, "Xing", 4);
+    // Frame count, byte count and seek table present
+    writeBe32(frame.data() + tag + 4, 0x7);
+    writeBe32(frame.data() + tag + 8,
+              static_cast<std::uint32_t>(stream.frames.size()));
+    writeBe32(frame.data() + tag + 12, static_cast<std::uint32_t>(total));
+
+    // Entry i is where i% of the duration starts, as a fraction of the
+    // stream out of 256
+    std::uint8_t* toc = frame.data() + tag + 16;
+    for (std::size_t i = 0; i < s_tocEntries; i++) {
+        const std::uint64_t offset =
+            size +
+            stream.frames[i * stream.frames.size() / s_tocEntries] -
+            stream.frames.front();
+        toc[i] = static_cast<std::uint8_t>(
+            std::min<std::uint64_t>(255, offset * 256 / total));
+    }
+
+    return frame;
+}
+
+}  // namespace jukebox
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Frame layout of an MPEG Layer III stream
+ */
+struct Mp3Stream {
+    // Byte offset of every frame, the first one is where the audio starts
+    std::vector<std::uint64_t> frames;
+    // Just past the last frame, trailing tags aren't audio
+    std::uint64_t audioEnd = 0;
+    std::uint32_t sampleRate = 0;
+    std::uint32_t samplesPerFrame = 0;
+    bool constantBitrate = true;
+    // The first frame is a Xing, Info or VBRI header rather than audio
+    bool hasSeekHeader = false;
+    // Header of the first frame
+    std::array<std::uint8_t, 4> header{};
+
+    /**
+     * @return the length of the stream in milliseconds
+     */
+    std::uint64_t durationMs() const {
+        return sampleRate == 0 ? 0
+                               : std::uint64_t(frames.size()) *
+                                     samplesPerFrame * 1000 / sampleRate;
+    }
+};
+
+/**
+ * Walks the frames of an MP3 file, skipping a leading ID3v2 tag. Stops at
+ * the first byte that isn't a frame of the same stream, e.g. an ID3v1 or APE
+ * tag.
+ *
+ * @return std::nullopt if data doesn't start with Layer III frames
+ */
+std::optional<Mp3Stream> scanMp3(std::span<const std::uint8_t> data);
+
+/**
+ * Builds a Xing frame with a 100 entry seek table for a stream, to be
+ * inserted before its first frame. Decoders then seek a VBR stream from the
+ * table instead of assuming a constant bitrate.
+ *
+ * @return std::nullopt if no bitrate makes a frame big enough for the table
+ */
+std::optional<std::vector<std::uint8_t>> buildXingFrame(
+    const Mp3Stream& stream);
+
+}  // namespace jukebox
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+#include <jukebox/utils/executor.hpp>
+
+namespace jukebox {
+
+/**
+ * Returns the number of threads parallel_for uses for a job of the given
+ * size, the calling thread included
+ */
+inline std::size_t parallel_worker_count(
+    std::size_t count, std::size_t maxThreads = Executor::s_maxWorkers + 1) {
+    return std::clamp<std::size_t>(
+        std::min(maxThreads, Executor::s_maxWorkers + 1), 1,
+        std::max<std::size_t>(count, 1));
+}
+
+/**
+ * Calls fn(i) for every i in [0, count) on the calling thread and the
+ * executor's workers, and blocks until all of them are done. Indices are
+ * handed out dynamically, so uneven work is balanced between threads. fn
+ * must be safe to call concurrently for different indices.
+ *
+ * The calling thread works through the indices too, so this never waits on
+ * helpers that a busy executor hasn't started yet. Those find nothing left
+ * to do once they run.
+ */
+template <class F>
+void parallel_for(std::size_t count, F&& fn,
+                  Executor::Priority priority = Executor::Priority::Normal,
+                  std::size_t maxThreads = Executor::s_maxWorkers + 1) {
+    const std::size_t threads = parallel_worker_count(count, maxThreads);
+
+    if (threads <= 1) {
+        for (std::size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    // Shared with the helpers, which may outlive this call
+    struct State {
+        std::atomic<std::size_t> next = 0;
+        std::size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+
+    // fn is only touched while an index is left, so never after returning
+    auto work = [state, count, &fn]() {
+        std::size_t ran = 0;
+        auto take = [&state]() {
+            return state->next.fetch_add(1, std::memory_order_relaxed);
+        };
+        for (std::size_t i = take(); i < count; i = take()) {
+            fn(i);
+            ran++;
+        }
+        if (ran > 0) {
+            std::lock_guard lock(state->mutex);
+            state->done += ran;
+            if (state->done == count) {
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    for (std::size_t i = 1; i < threads; i++) {
+        Executor::get().post(priority, work);
+    }
+    work();
+
+    std::unique_lock lock(state->mutex);
+    state->finished.wait(lock,
+                         [&state, count] { return state->done == count; });
+}
+
+}  // namespace jukebox
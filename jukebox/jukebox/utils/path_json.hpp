@@ -0,0 +1,30 @@
+#pragma once
+
+// Geode serializes paths for matjson in Geode/utils/file.hpp, which the
+// headless build doesn't have, so it gets the same conversion here
+#ifdef JUKEBOX_HEADLESS
+
+#include <filesystem>
+#include <string>
+
+#include <Geode/Result.hpp>
+#include <matjson.hpp>
+
+template <>
+struct matjson::Serialize<std::filesystem::path> {
+    static geode::Result<std::filesystem::path> fromJson(
+        const matjson::Value& value) {
+        GEODE_UNWRAP_INTO(std::string str, value.asString());
+        return geode::Ok(std::filesystem::path(str));
+    }
+
+    static matjson::Value toJson(const std::filesystem::path& value) {
+        return matjson::Value(value.string());
+    }
+};
+
+#else
+
+#include <Geode/utils/file.hpp>  // IWYU pragma: keep
+
+#endif
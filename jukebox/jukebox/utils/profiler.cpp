@@ -0,0 +1,191 @@
+#include <jukebox/utils/profiler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include <Geode/Result.hpp>
+#include <Geode/loader/Mod.hpp>
+#include <Geode/loader/SettingV3.hpp>
+#include <matjson.hpp>
+
+#include <jukebox/host/host.hpp>
+#include <jukebox/utils/atomic_file.hpp>
+
+using namespace geode::prelude;
+
+namespace jukebox {
+
+namespace {
+
+std::atomic<std::uint32_t> s_nextThread = 0;
+
+// Small stable thread numbers read better in the trace viewer than hashes
+std::uint32_t currentThread() {
+    thread_local const std::uint32_t thread =
+        s_nextThread.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+}
+
+}  // namespace
+
+void Profiler::init() {
+    s_enabled.store(Mod::get()->getSettingValue<bool>("profiling"),
+                    std::memory_order_relaxed);
+    listenForSettingChanges("profiling", [](bool value) {
+        s_enabled.store(value, std::memory_order_relaxed);
+    });
+}
+
+void Profiler::record(const char* name,
+                      std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    const microseconds duration = duration_cast<microseconds>(end - start);
+    const std::uint32_t thread = currentThread();
+
+    std::lock_guard lock(m_mutex);
+    TimerStats& stats = m_timers[name];
+    stats.count++;
+    stats.total += duration;
+    stats.max = std::max(stats.max, duration);
+
+    if (m_events.size() < s_maxEvents) {
+        m_events.push_back(
+            Event{.name = name,
+                  .thread = thread,
+                  .start = duration_cast<microseconds>(start - m_origin),
+                  .duration = duration});
+    } else {
+        m_droppedEvents++;
+    }
+}
+
+std::vector<std::pair<std::string_view, Profiler::TimerStats>>
+Profiler::timers() {
+    std::vector<std::pair<std::string_view, TimerStats>> ret;
+    {
+        std::lock_guard lock(m_mutex);
+        ret.assign(m_timers.begin(), m_timers.end());
+    }
+    std::sort(ret.begin(), ret.end(), [](const auto& a, const auto& b) {
+        return a.second.total > b.second.total;
+    });
+    return ret;
+}
+
+std::vector<std::chrono::microseconds> Profiler::durations(
+    std::string_view name, std::chrono::steady_clock::time_point since) {
+    const auto from =
+        std::chrono::duration_cast<std::chrono::microseconds>(since - m_origin);
+    std::vector<std::chrono::microseconds> ret;
+    std::lock_guard lock(m_mutex);
+    for (const Event& event : m_events) {
+        if (event.start >= from && name == event.name) {
+            ret.push_back(event.duration);
+        }
+    }
+    return ret;
+}
+
+std::string_view Profiler::counterName(Counter counter) {
+    switch (counter) {
+        case Counter::PathForSong:
+            return "pathForSong";
+        case Counter::GetSongInfoObject:
+            return "getSongInfoObject";
+        case Counter::QueueStartMusic:
+            return "queueStartMusic";
+        case Counter::SetMusicTimeMS:
+            return "setMusicTimeMS";
+        case Counter::Count:
+            break;
+    }
+    return "";
+}
+
+void Profiler::reset() {
+    for (std::atomic<std::uint64_t>& counter : m_counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard lock(m_mutex);
+    m_events.clear();
+    m_droppedEvents = 0;
+    m_timers.clear();
+}
+
+Result<std::filesystem::path> Profiler::exportTrace() {
+    std::vector<matjson::Value> events;
+    std::size_t dropped = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        events.reserve(m_events.size() + m_counters.size());
+        for (const Event& event : m_events) {
+            events.push_back(matjson::makeObject({
+                {"name", event.name},
+                {"ph", "X"},
+                {"pid", 1},
+                {"tid", event.thread},
+                {"ts", event.start.count()},
+                {"dur", event.duration.count()},
+            }));
+        }
+        dropped = m_droppedEvents;
+    }
+
+    // Counters go in once, with their totals at the time of the export
+    const std::int64_t now =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - m_origin)
+            .count();
+    matjson::Value counters = matjson::Value::object();
+    for (std::size_t i = 0; i < m_counters.size(); i++) {
+        const Counter counter = static_cast<Counter>(i);
+        const std::uint64_t value = this->counter(counter);
+        counters.set(std::string(counterName(counter)), value);
+        events.push_back(matjson::makeObject({
+            {"name", std::string(counterName(counter))},
+            {"ph", "C"},
+            {"pid", 1},
+            {"tid", 0},
+            {"ts", now},
+            {"args", matjson::makeObject({{"calls", value}})},
+        }));
+    }
+
+    matjson::Value trace = matjson::makeObject({
+        {"traceEvents", matjson::Value(std::move(events))},
+        {"displayTimeUnit", "ms"},
+        {"otherData", matjson::makeObject({{"counters", std::move(counters)},
+                                           {"droppedEvents", dropped}})},
+    });
+
+    const std::filesystem::path directory = host::saveDir() / "profiles";
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        return Err("Couldn't create {}: {}", directory.string(), ec.message());
+    }
+    const std::filesystem::path path =
+        directory /
+        fmt::format("trace-{}.json",
+                    std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count());
+    GEODE_UNWRAP(
+        write_file_atomic(path, trace.dump(matjson::NO_INDENTATION)));
+    return Ok(path);
+}
+
+}  // namespace jukebox
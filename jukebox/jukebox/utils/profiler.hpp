@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Geode/Result.hpp>
+
+namespace jukebox {
+
+/**
+ * Scoped timers and call counters across the managers, hooks and download
+ * path, shown in the profiler popup and exportable as a Chrome trace. All of
+ * it is off unless the profiling setting is enabled, and then a timer or
+ * counter costs a single relaxed atomic load.
+ */
+class Profiler {
+public:
+    // Hot calls that are counted rather than timed
+    enum class Counter : std::size_t {
+        PathForSong,
+        GetSongInfoObject,
+        QueueStartMusic,
+        SetMusicTimeMS,
+        Count
+    };
+
+    struct TimerStats {
+        std::uint64_t count = 0;
+        std::chrono::microseconds total{0};
+        std::chrono::microseconds max{0};
+    };
+
+protected:
+    struct Event {
+        // A string literal
+        const char* name;
+        std::uint32_t thread;
+        std::chrono::microseconds start;
+        std::chrono::microseconds duration;
+    };
+
+    // Trace events kept for the export, timers are still aggregated after
+    constexpr static inline std::size_t s_maxEvents = 200000;
+
+    static inline std::atomic<bool> s_enabled = false;
+
+    const std::chrono::steady_clock::time_point m_origin =
+        std::chrono::steady_clock::now();
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+    std::size_t m_droppedEvents = 0;
+    std::unordered_map<std::string_view, TimerStats> m_timers;
+    std::array<std::atomic<std::uint64_t>,
+               static_cast<std::size_t>(Counter::Count)>
+        m_counters{};
+
+    Profiler() = default;
+
+    Profiler(const Profiler&) = delete;
+    Profiler(Profiler&&) = delete;
+
+    Profiler& operator=(const Profiler&) = delete;
+    Profiler& operator=(Profiler&&) = delete;
+
+public:
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Follows the profiling setting. Called first on load, so startup is
+     * measured too
+     */
+    void init();
+
+    void count(Counter counter) {
+        if (enabled()) {
+            m_counters[static_cast<std::size_t>(counter)].fetch_add(
+                1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Records a timed scope. Safe to call from any thread
+     *
+     * @param name a string literal, it isn't copied
+     */
+    void record(const char* name, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end);
+
+    /**
+     * Every timer recorded, slowest in total first
+     */
+    std::vector<std::pair<std::string_view, TimerStats>> timers();
+
+    /**
+     * Durations of every scope with a name that started at since or later,
+     * from the trace events kept for the export
+     */
+    std::vector<std::chrono::microseconds> durations(
+        std::string_view name, std::chrono::steady_clock::time_point since);
+
+    std::uint64_t counter(Counter counter) const {
+        return m_counters[static_cast<std::size_t>(counter)].load(
+            std::memory_order_relaxed);
+    }
+
+    static std::string_view counterName(Counter counter);
+
+    void reset();
+
+    /**
+     * Writes the recorded scopes as a Chrome trace (chrome://tracing or
+     * Perfetto) into the profiles folder of the save directory
+     *
+     * @return the file written
+     */
+    geode::Result<std::filesystem::path> exportTrace();
+
+    static Profiler& get() {
+        static Profiler instance;
+        return instance;
+    }
+};
+
+/**
+ * Times the rest of the enclosing scope while profiling is enabled
+ */
+class ProfileScope final {
+private:
+    const char* m_name;
+    std::chrono::steady_clock::time_point m_start;
+
+public:
+    /**
+     * @param name a string literal, it isn't copied
+     */
+    explicit ProfileScope(const char* name)
+        : m_name(Profiler::enabled() ? name : nullptr) {
+        if (m_name) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ProfileScope() {
+        if (m_name) {
+            Profiler::get().record(m_name, m_start,
+                                   std::chrono::steady_clock::now());
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+}  // namespace jukebox
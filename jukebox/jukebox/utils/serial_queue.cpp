@@ -0,0 +1,78 @@
+#include <jukebox/utils/serial_queue.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace jukebox {
+
+SerialQueue::~SerialQueue() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void SerialQueue::post(std::function<void()> job) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+        if (!m_running) {
+            m_running = true;
+            m_thread = std::thread(&SerialQueue::run, this);
+        }
+    }
+    m_wake.notify_one();
+}
+
+void SerialQueue::drain() {
+    std::unique_lock lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_jobs.empty() && !m_busy; });
+}
+
+bool SerialQueue::drainUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock lock(m_mutex);
+    return m_idle.wait_until(lock, deadline,
+                             [this] { return m_jobs.empty() && !m_busy; });
+}
+
+std::size_t SerialQueue::discard() {
+    std::lock_guard lock(m_mutex);
+    const std::size_t dropped = m_jobs.size();
+    m_jobs.clear();
+    return dropped;
+}
+
+void SerialQueue::run() {
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+
+        // Pending jobs still run on shutdown, they are usually writes
+        if (m_jobs.empty()) {
+            return;
+        }
+
+        std::function<void()> job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_busy = true;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        m_busy = false;
+        if (m_jobs.empty()) {
+            m_idle.notify_all();
+        }
+    }
+}
+
+}  // namespace jukebox
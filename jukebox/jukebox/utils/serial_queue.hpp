@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace jukebox {
+
+/**
+ * A single background thread that runs posted jobs one at a time, in the
+ * order they were posted. The thread is started on the first post.
+ */
+class SerialQueue final {
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<std::function<void()>> m_jobs;
+    std::thread m_thread;
+    bool m_running = false;
+    bool m_busy = false;
+    bool m_stop = false;
+
+    void run();
+
+public:
+    SerialQueue() = default;
+    SerialQueue(const SerialQueue&) = delete;
+    SerialQueue& operator=(const SerialQueue&) = delete;
+
+    ~SerialQueue();
+
+    void post(std::function<void()> job);
+
+    /**
+     * Blocks until every job posted so far has finished
+     */
+    void drain();
+
+    /**
+     * Like drain, but stops waiting at the deadline
+     *
+     * @return whether every job posted so far has finished
+     */
+    bool drainUntil(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * Drops the jobs that haven't started yet. The running one, if any,
+     * still finishes.
+     *
+     * @return how many jobs were dropped
+     */
+    std::size_t discard();
+};
+
+}  // namespace jukebox
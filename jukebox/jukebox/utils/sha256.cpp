@@ -0,0 +1,173 @@
+#include <jukebox/utils/sha256.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace jukebox {
+
+namespace {
+
+constexpr std::array<std::uint32_t, 8> s_initialState = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+constexpr std::array<std::uint32_t, 64> s_roundConstants = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+// Files are hashed in chunks of this many bytes
+constexpr std::size_t s_readChunk = 1 << 16;
+
+}  // namespace
+
+Sha256::Sha256() : m_state(s_initialState) {}
+
+void Sha256::compress(const std::uint8_t* block) {
+    std::array<std::uint32_t, 64> w;
+    for (std::size_t i = 0; i < 16; i++) {
+        w[i] = static_cast<std::uint32_t>(block[i * 4]) << 24 |
+               static_cast<std::uint32_t>(block[i * 4 + 1]) << 16 |
+               static_cast<std::uint32_t>(block[i * 4 + 2]) << 8 |
+               static_cast<std::uint32_t>(block[i * 4 + 3]);
+    }
+    for (std::size_t i = 16; i < 64; i++) {
+        const std::uint32_t s0 = std::rotr(w[i - 15], 7) ^
+                                 std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const std::uint32_t s1 = std::rotr(w[i - 2], 17) ^
+                                 std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    auto [a, b, c, d, e, f, g, h] = m_state;
+    for (std::size_t i = 0; i < 64; i++) {
+        const std::uint32_t s1 =
+            std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+        const std::uint32_t ch = (e & f) ^ (~e & g);
+        const std::uint32_t t1 = h + s1 + ch + s_roundConstants[i] + w[i];
+        const std::uint32_t s0 =
+            std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+        const std::uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        const std::uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+    m_state[5] += f;
+    m_state[6] += g;
+    m_state[7] += h;
+}
+
+void Sha256::update(std::span<const std::uint8_t> data) {
+    m_length += data.size();
+
+    if (m_blockSize > 0) {
+        const std::size_t take = std::min(64 - m_blockSize, data.size());
+        std::copy_n(data.begin(), take, m_block.begin() + m_blockSize);
+        m_blockSize += take;
+        data = data.subspan(take);
+        if (m_blockSize < 64) {
+            return;
+        }
+        this->compress(m_block.data());
+        m_blockSize = 0;
+    }
+
+    // Whole blocks are hashed straight from the input
+    while (data.size() >= 64) {
+        this->compress(data.data());
+        data = data.subspan(64);
+    }
+
+    std::copy(data.begin(), data.end(), m_block.begin());
+    m_blockSize = data.size();
+}
+
+Sha256::Digest Sha256::finish() {
+    const std::uint64_t bits = m_length * 8;
+
+    std::array<std::uint8_t, 72> padding{};
+    padding[0] = 0x80;
+    // Pads up to 56 bytes into a block, the last 8 hold the length
+    const std::size_t zeros =
+        m_blockSize < 56 ? 55 - m_blockSize : 119 - m_blockSize;
+    std::array<std::uint8_t, 8> length;
+    for (std::size_t i = 0; i < 8; i++) {
+        length[i] = static_cast<std::uint8_t>(bits >> (56 - i * 8));
+    }
+    this->update(std::span(padding.data(), zeros + 1));
+    this->update(length);
+
+    Digest ret;
+    for (std::size_t i = 0; i < 8; i++) {
+        ret[i * 4] = static_cast<std::uint8_t>(m_state[i] >> 24);
+        ret[i * 4 + 1] = static_cast<std::uint8_t>(m_state[i] >> 16);
+        ret[i * 4 + 2] = static_cast<std::uint8_t>(m_state[i] >> 8);
+        ret[i * 4 + 3] = static_cast<std::uint8_t>(m_state[i]);
+    }
+
+    *this = Sha256();
+    return ret;
+}
+
+std::string Sha256::toHex(const Digest& digest) {
+    constexpr char s_digits[] = "0123456789abcdef";
+    std::string ret;
+    ret.reserve(digest.size() * 2);
+    for (std::uint8_t byte : digest) {
+        ret += s_digits[byte >> 4];
+        ret += s_digits[byte & 0xf];
+    }
+    return ret;
+}
+
+std::optional<std::string> Sha256::hashFile(
+    const std::filesystem::path& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return std::nullopt;
+    }
+
+    Sha256 hasher;
+    std::vector<std::uint8_t> chunk(s_readChunk);
+    while (input) {
+        input.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+        hasher.update(std::span(chunk.data(),
+                                static_cast<std::size_t>(input.gcount())));
+    }
+    if (input.bad()) {
+        return std::nullopt;
+    }
+    return toHex(hasher.finish());
+}
+
+}  // namespace jukebox
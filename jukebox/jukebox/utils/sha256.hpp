@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace jukebox {
+
+/**
+ * Incremental SHA-256, fed in chunks as they are read or downloaded
+ */
+class Sha256 final {
+public:
+    using Digest = std::array<std::uint8_t, 32>;
+
+private:
+    std::array<std::uint32_t, 8> m_state;
+    std::array<std::uint8_t, 64> m_block{};
+    std::size_t m_blockSize = 0;
+    std::uint64_t m_length = 0;
+
+    void compress(const std::uint8_t* block);
+
+public:
+    Sha256();
+
+    void update(std::span<const std::uint8_t> data);
+    /**
+     * Pads the message and returns its digest. The hasher starts over after
+     */
+    Digest finish();
+
+    static std::string toHex(const Digest& digest);
+
+    /**
+     * Hashes a whole file. Safe to call from worker threads.
+     *
+     * @return the lowercase hex digest, std::nullopt if the file can't be
+     * read
+     */
+    static std::optional<std::string> hashFile(
+        const std::filesystem::path& path);
+};
+
+}  // namespace jukebox
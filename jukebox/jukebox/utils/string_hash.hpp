@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace jukebox {
+
+/**
+ * Transparent string hash, lets string keyed maps be searched with a
+ * std::string_view without building a temporary std::string
+ */
+struct StringHash {
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
+/**
+ * 64-bit FNV-1a. Unlike std::hash it's the same on every platform and
+ * standard library, for hashes that end up on disk
+ */
+constexpr std::uint64_t fnv1a64(std::string_view str) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template <class T>
+using StringMap =
+    std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
+}  // namespace jukebox
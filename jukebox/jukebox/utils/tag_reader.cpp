@@ -0,0 +1,583 @@
+#include <jukebox/utils/tag_reader.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <Geode/utils/Task.hpp>
+
+#include <jukebox/utils/executor.hpp>
+
+namespace jukebox {
+
+namespace {
+
+using Bytes = std::span<const std::uint8_t>;
+
+// Tags bigger than this are mostly cover art, they aren't worth reading
+constexpr std::size_t s_maxTagBytes = 16 << 20;
+
+std::uint32_t be24(const std::uint8_t* p) {
+    return std::uint32_t(p[0]) << 16 | std::uint32_t(p[1]) << 8 | p[2];
+}
+
+std::uint32_t be32(const std::uint8_t* p) {
+    return std::uint32_t(p[0]) << 24 | be24(p + 1);
+}
+
+std::uint32_t le32(const std::uint8_t* p) {
+    return std::uint32_t(p[3]) << 24 | std::uint32_t(p[2]) << 16 |
+           std::uint32_t(p[1]) << 8 | p[0];
+}
+
+// ID3v2 sizes keep the top bit of every byte clear
+std::uint32_t syncsafe(const std::uint8_t* p) {
+    return std::uint32_t(p[0] & 0x7f) << 21 | std::uint32_t(p[1] & 0x7f) << 14 |
+           std::uint32_t(p[2] & 0x7f) << 7 | (p[3] & 0x7f);
+}
+
+bool readBytes(std::ifstream& in, std::vector<std::uint8_t>& out,
+               std::size_t count) {
+    out.resize(count);
+    in.read(reinterpret_cast<char*>(out.data()), count);
+    return static_cast<std::size_t>(in.gcount()) == count;
+}
+
+bool skipBytes(std::ifstream& in, std::uint64_t count) {
+    in.seekg(static_cast<std::streamoff>(count), std::ios::cur);
+    return static_cast<bool>(in);
+}
+
+void appendUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xc0 | cp >> 6);
+        out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xe0 | cp >> 12);
+        out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | cp >> 18);
+        out += static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+        out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+}
+
+std::string latin1ToUtf8(Bytes data) {
+    std::string ret;
+    ret.reserve(data.size());
+    for (std::uint8_t byte : data) {
+        appendUtf8(ret, byte);
+    }
+    return ret;
+}
+
+std::string utf16ToUtf8(Bytes data, bool bigEndian) {
+    std::string ret;
+    ret.reserve(data.size());
+    auto unit = [&data, bigEndian](std::size_t i) -> char32_t {
+        return bigEndian ? data[i] << 8 | data[i + 1]
+                         : data[i + 1] << 8 | data[i];
+    };
+    for (std::size_t i = 0; i + 1 < data.size(); i += 2) {
+        char32_t cp = unit(i);
+        if (cp == 0) {
+            break;
+        }
+        if (cp >= 0xd800 && cp < 0xdc00 && i + 3 < data.size()) {
+            const char32_t low = unit(i + 2);
+            if (low >= 0xdc00 && low < 0xe000) {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                i += 2;
+            }
+        }
+        appendUtf8(ret, cp);
+    }
+    return ret;
+}
+
+bool isUtf8(std::string_view str) {
+    for (std::size_t i = 0; i < str.size();) {
+        const auto byte = static_cast<std::uint8_t>(str[i]);
+        const std::size_t length = byte < 0x80           ? 1
+                                   : (byte >> 5) == 0x6  ? 2
+                                   : (byte >> 4) == 0xe  ? 3
+                                   : (byte >> 3) == 0x1e ? 4
+                                                         : 0;
+        if (length == 0 || i + length > str.size()) {
+            return false;
+        }
+        for (std::size_t j = 1; j < length; j++) {
+            if ((static_cast<std::uint8_t>(str[i + j]) & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+// Text meant to be UTF-8 that older taggers may have written as Latin-1
+std::string looseUtf8(Bytes data) {
+    std::string_view str(reinterpret_cast<const char*>(data.data()),
+                         data.size());
+    return isUtf8(str) ? std::string(str) : latin1ToUtf8(data);
+}
+
+/**
+ * Cuts a tag value at its first null, then trims it
+ *
+ * @return std::nullopt if nothing is left
+ */
+std::optional<std::string> cleanValue(std::string value) {
+    if (std::size_t end = value.find('\0'); end != std::string::npos) {
+        value.resize(end);
+    }
+    auto space = [](unsigned char c) { return std::isspace(c); };
+    value.erase(value.begin(), std::find_if_not(value.begin(), value.end(),
+                                                space));
+    value.erase(std::find_if_not(value.rbegin(), value.rend(), space).base(),
+                value.end());
+    if (value.empty()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::toupper(static_cast<unsigned char>(x)) ==
+                      std::toupper(static_cast<unsigned char>(y));
+           });
+}
+
+void setOnce(std::optional<std::string>& field,
+             std::optional<std::string> value) {
+    if (!field.has_value()) {
+        field = std::move(value);
+    }
+}
+
+std::vector<std::uint8_t> removeUnsync(Bytes data) {
+    std::vector<std::uint8_t> ret;
+    ret.reserve(data.size());
+    for (std::size_t i = 0; i < data.size(); i++) {
+        ret.push_back(data[i]);
+        // 0xFF 0x00 was written for a plain 0xFF
+        if (data[i] == 0xff && i + 1 < data.size() && data[i + 1] == 0) {
+            i++;
+        }
+    }
+    return ret;
+}
+
+std::optional<std::string> decodeId3Text(Bytes data) {
+    if (data.empty()) {
+        return std::nullopt;
+    }
+    Bytes text = data.subspan(1);
+    switch (data[0]) {
+        case 0:
+            return cleanValue(latin1ToUtf8(text));
+        case 1: {
+            // UTF-16 with a byte order mark, little endian without one
+            bool bigEndian = false;
+            if (text.size() >= 2 && text[0] == 0xfe && text[1] == 0xff) {
+                bigEndian = true;
+                text = text.subspan(2);
+            } else if (text.size() >= 2 && text[0] == 0xff &&
+                       text[1] == 0xfe) {
+                text = text.subspan(2);
+            }
+            return cleanValue(utf16ToUtf8(text, bigEndian));
+        }
+        case 2:
+            return cleanValue(utf16ToUtf8(text, true));
+        case 3:
+            return cleanValue(looseUtf8(text));
+        default:
+            return std::nullopt;
+    }
+}
+
+/**
+ * The bytes of an ID3v2 tag, read from the file as they're needed. Undoes
+ * the unsynchronization of a whole v2.2 or v2.3 tag on the way, frame
+ * sizes count the bytes after it.
+ */
+class Id3Reader {
+    std::ifstream& m_in;
+    // Bytes of the tag in the file that weren't read yet
+    std::uint64_t m_left;
+    bool m_unsync;
+    bool m_afterFF = false;
+
+public:
+    Id3Reader(std::ifstream& in, std::uint64_t size, bool unsync)
+        : m_in(in), m_left(size), m_unsync(unsync) {}
+
+    bool read(std::uint8_t* out, std::size_t count) {
+        if (!m_unsync) {
+            if (count > m_left) {
+                return false;
+            }
+            m_in.read(reinterpret_cast<char*>(out), count);
+            m_left -= count;
+            return static_cast<std::size_t>(m_in.gcount()) == count;
+        }
+        while (count > 0) {
+            if (m_left == 0) {
+                return false;
+            }
+            const int byte = m_in.get();
+            if (byte == std::char_traits<char>::eof()) {
+                return false;
+            }
+            m_left--;
+            // 0xFF 0x00 was written for a plain 0xFF
+            if (m_afterFF && byte == 0) {
+                m_afterFF = false;
+                continue;
+            }
+            m_afterFF = byte == 0xff;
+            *out++ = static_cast<std::uint8_t>(byte);
+            count--;
+        }
+        return true;
+    }
+
+    bool read(std::vector<std::uint8_t>& out, std::size_t count) {
+        out.resize(count);
+        return this->read(out.data(), count);
+    }
+
+    bool skip(std::uint64_t count) {
+        if (!m_unsync) {
+            if (count > m_left) {
+                return false;
+            }
+            m_left -= count;
+            return skipBytes(m_in, count);
+        }
+        // Where the skipped bytes end in the file depends on what they are
+        std::uint8_t scratch[4096];
+        while (count > 0) {
+            const std::size_t chunk =
+                static_cast<std::size_t>(std::min<std::uint64_t>(
+                    count, sizeof(scratch)));
+            if (!this->read(scratch, chunk)) {
+                return false;
+            }
+            count -= chunk;
+        }
+        return true;
+    }
+};
+
+void readId3v2(std::ifstream& in, const std::uint8_t* header,
+               SongTags& tags) {
+    const std::uint8_t version = header[3];
+    const std::uint8_t flags = header[5];
+    if (version < 2 || version > 4) {
+        return;
+    }
+    Id3Reader reader(in, syncsafe(header + 6), version < 4 && (flags & 0x80));
+
+    if ((flags & 0x40) && version >= 3) {
+        std::uint8_t size[4];
+        if (!reader.read(size, sizeof(size))) {
+            return;
+        }
+        // v2.3 doesn't count the size field itself, v2.4 does
+        const std::uint64_t extended = version == 3
+                                           ? std::uint64_t(be32(size)) + 4
+                                           : syncsafe(size);
+        if (extended < 4 || !reader.skip(extended - 4)) {
+            return;
+        }
+    }
+
+    const std::size_t headerSize = version == 2 ? 6 : 10;
+    const std::string_view titleID = version == 2 ? "TT2" : "TIT2";
+    const std::string_view artistID = version == 2 ? "TP1" : "TPE1";
+
+    // Frames are read one at a time, cover art and the like are skipped
+    // over in the file
+    std::uint8_t frame[10];
+    std::vector<std::uint8_t> contents;
+    while ((!tags.title.has_value() || !tags.artist.has_value()) &&
+           reader.read(frame, headerSize)) {
+        if (frame[0] == 0) {
+            // Padding
+            break;
+        }
+        const std::string_view id(reinterpret_cast<const char*>(frame),
+                                  version == 2 ? 3 : 4);
+        const std::uint32_t frameSize = version == 2   ? be24(frame + 3)
+                                        : version == 4 ? syncsafe(frame + 4)
+                                                       : be32(frame + 4);
+        if ((id != titleID && id != artistID) || frameSize > s_maxTagBytes) {
+            if (!reader.skip(frameSize)) {
+                break;
+            }
+            continue;
+        }
+        if (!reader.read(contents, frameSize)) {
+            break;
+        }
+        Bytes data(contents);
+
+        std::vector<std::uint8_t> unsynced;
+        if (version == 3) {
+            const std::uint8_t format = frame[9];
+            // Compressed or encrypted
+            if (format & 0xc0) {
+                continue;
+            }
+            if (format & 0x20) {
+                data = data.subspan(std::min<std::size_t>(1, data.size()));
+            }
+        } else if (version == 4) {
+            const std::uint8_t format = frame[9];
+            if (format & 0x0c) {
+                continue;
+            }
+            if (format & 0x40) {
+                data = data.subspan(std::min<std::size_t>(1, data.size()));
+            }
+            if (format & 0x01) {
+                data = data.subspan(std::min<std::size_t>(4, data.size()));
+            }
+            if (format & 0x02) {
+                unsynced = removeUnsync(data);
+                data = unsynced;
+            }
+        }
+
+        setOnce(id == titleID ? tags.title : tags.artist, decodeId3Text(data));
+    }
+}
+
+void readId3v1(std::ifstream& in, SongTags& tags) {
+    in.clear();
+    in.seekg(-128, std::ios::end);
+    std::vector<std::uint8_t> tag;
+    if (!in || !readBytes(in, tag, 128) ||
+        std::memcmp(tag.data(), "TAG", 3) != 0) {
+        return;
+    }
+    setOnce(tags.title, cleanValue(latin1ToUtf8(Bytes(tag).subspan(3, 30))));
+    setOnce(tags.artist,
+            cleanValue(latin1ToUtf8(Bytes(tag).subspan(33, 30))));
+}
+
+void readVorbisComment(Bytes data, SongTags& tags) {
+    if (data.size() < 4) {
+        return;
+    }
+    std::size_t pos = 4 + static_cast<std::size_t>(le32(data.data()));
+    if (pos + 4 > data.size()) {
+        return;
+    }
+    const std::uint32_t count = le32(data.data() + pos);
+    pos += 4;
+
+    for (std::uint32_t i = 0; i < count && pos + 4 <= data.size(); i++) {
+        const std::uint32_t length = le32(data.data() + pos);
+        pos += 4;
+        if (length > data.size() - pos) {
+            return;
+        }
+        Bytes comment = data.subspan(pos, length);
+        pos += length;
+
+        const auto* begin = reinterpret_cast<const char*>(comment.data());
+        const std::string_view field(begin, comment.size());
+        const std::size_t eq = field.find('=');
+        if (eq == std::string_view::npos) {
+            continue;
+        }
+        const std::string_view key = field.substr(0, eq);
+        std::optional<std::string>* target =
+            equalsIgnoreCase(key, "TITLE")    ? &tags.title
+            : equalsIgnoreCase(key, "ARTIST") ? &tags.artist
+                                              : nullptr;
+        if (target) {
+            setOnce(*target, cleanValue(looseUtf8(comment.subspan(eq + 1))));
+        }
+    }
+}
+
+// Starts right after the fLaC marker
+void readFlac(std::ifstream& in, SongTags& tags) {
+    std::vector<std::uint8_t> block;
+    while (readBytes(in, block, 4)) {
+        const bool last = block[0] & 0x80;
+        const std::uint8_t type = block[0] & 0x7f;
+        const std::uint32_t length = be24(block.data() + 1);
+
+        // VORBIS_COMMENT
+        if (type == 4) {
+            if (length <= s_maxTagBytes && readBytes(in, block, length)) {
+                readVorbisComment(block, tags);
+            }
+            return;
+        }
+        if (last || !skipBytes(in, length)) {
+            return;
+        }
+    }
+}
+
+// The comment header is the second packet of the first logical stream
+void readOgg(std::ifstream& in, SongTags& tags) {
+    std::vector<std::uint8_t> header;
+    std::vector<std::uint8_t> segments;
+    std::vector<std::uint8_t> packet;
+    std::vector<std::uint8_t> segment;
+    std::size_t packetIndex = 0;
+
+    while (readBytes(in, header, 27) &&
+           std::memcmp(header.data(), "OggS", 4) == 0) {
+        if (!readBytes(in, segments, header[26])) {
+            return;
+        }
+        for (std::uint8_t length : segments) {
+            if (packetIndex == 0) {
+                if (!skipBytes(in, length)) {
+                    return;
+                }
+            } else {
+                if (!readBytes(in, segment, length) ||
+                    packet.size() + length > s_maxTagBytes) {
+                    return;
+                }
+                packet.insert(packet.end(), segment.begin(), segment.end());
+            }
+            // Packets end on the first segment shorter than 255 bytes
+            if (length == 255) {
+                continue;
+            }
+            if (packetIndex == 1) {
+                Bytes data(packet);
+                if (data.size() >= 7 &&
+                    std::memcmp(data.data(), "\x03vorbis", 7) == 0) {
+                    readVorbisComment(data.subspan(7), tags);
+                } else if (data.size() >= 8 &&
+                           std::memcmp(data.data(), "OpusTags", 8) == 0) {
+                    readVorbisComment(data.subspan(8), tags);
+                }
+                return;
+            }
+            packetIndex++;
+        }
+    }
+}
+
+// Starts right after the RIFF WAVE header
+void readRiff(std::ifstream& in, SongTags& tags) {
+    std::vector<std::uint8_t> chunk;
+    while (readBytes(in, chunk, 8)) {
+        const std::uint32_t size = le32(chunk.data() + 4);
+        const std::uint64_t padded = size + (size & 1);
+
+        if (std::memcmp(chunk.data(), "LIST", 4) != 0 || size < 4) {
+            // Skips over the audio data instead of reading it
+            if (!skipBytes(in, padded)) {
+                return;
+            }
+            continue;
+        }
+
+        if (size > s_maxTagBytes || !readBytes(in, chunk, size)) {
+            return;
+        }
+        if ((size & 1) && !skipBytes(in, 1)) {
+            return;
+        }
+        if (std::memcmp(chunk.data(), "INFO", 4) != 0) {
+            continue;
+        }
+
+        std::size_t pos = 4;
+        while (pos + 8 <= chunk.size()) {
+            const std::uint8_t* sub = chunk.data() + pos;
+            const std::uint32_t length = le32(sub + 4);
+            pos += 8;
+            if (length > chunk.size() - pos) {
+                break;
+            }
+            Bytes value(chunk.data() + pos, length);
+            pos += length + (length & 1);
+
+            if (std::memcmp(sub, "INAM", 4) == 0) {
+                setOnce(tags.title, cleanValue(looseUtf8(value)));
+            } else if (std::memcmp(sub, "IART", 4) == 0) {
+                setOnce(tags.artist, cleanValue(looseUtf8(value)));
+            }
+        }
+    }
+}
+
+}  // namespace
+
+SongTags readTags(const std::filesystem::path& path) {
+    SongTags tags;
+    // Opened through the path itself, so non ASCII names work on Windows
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return tags;
+    }
+
+    std::uint8_t header[12] = {};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    const std::size_t count = static_cast<std::size_t>(in.gcount());
+    in.clear();
+
+    if (count >= 10 && std::memcmp(header, "ID3", 3) == 0) {
+        in.seekg(10);
+        readId3v2(in, header, tags);
+        if (!tags.title.has_value() || !tags.artist.has_value()) {
+            readId3v1(in, tags);
+        }
+    } else if (count >= 4 && std::memcmp(header, "fLaC", 4) == 0) {
+        in.seekg(4);
+        readFlac(in, tags);
+    } else if (count >= 4 && std::memcmp(header, "OggS", 4) == 0) {
+        in.seekg(0);
+        readOgg(in, tags);
+    } else if (count >= 12 && std::memcmp(header, "RIFF", 4) == 0 &&
+               std::memcmp(header + 8, "WAVE", 4) == 0) {
+        readRiff(in, tags);
+    } else {
+        // MP3 with only an ID3v1 tag at the end, or none
+        readId3v1(in, tags);
+    }
+
+    return tags;
+}
+
+TagTask readTagsInBackground(std::filesystem::path path) {
+    return Executor::get().run<TagTask>(
+        Executor::Priority::Visible,
+        [path = std::move(path)](auto, auto) -> TagTask::Result {
+            return readTags(path);
+        },
+        "Reading song tags");
+}
+
+}  // namespace jukebox
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <Geode/utils/Task.hpp>
+
+namespace jukebox {
+
+/**
+ * Title and artist of an audio file, as UTF-8
+ */
+struct SongTags {
+    std::optional<std::string> title;
+    std::optional<std::string> artist;
+
+    bool empty() const { return !title.has_value() && !artist.has_value(); }
+};
+
+using TagTask = geode::Task<SongTags>;
+
+/**
+ * Reads the title and artist tags of an MP3 (ID3v2, falling back to ID3v1),
+ * FLAC, Ogg Vorbis or Opus, or WAV (RIFF INFO) file. The format is picked
+ * from the file contents, and only the header bytes holding the tags are
+ * read, audio data and pictures are skipped over. Safe to call from worker
+ * threads.
+ *
+ * @return the tags found, empty if the format isn't supported
+ */
+SongTags readTags(const std::filesystem::path& path);
+
+/**
+ * readTags on a worker thread
+ */
+TagTask readTagsInBackground(std::filesystem::path path);
+
+}  // namespace jukebox
@@ -0,0 +1,155 @@
+#include <jukebox/utils/trigram_index.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <jukebox/utils/memory_usage.hpp>
+
+namespace jukebox {
+
+namespace {
+
+std::uint32_t trigramAt(std::string_view str, std::size_t at) {
+    auto byte = [str, at](std::size_t i) -> std::uint32_t {
+        return static_cast<unsigned char>(str[at + i]);
+    };
+    return byte(0) << 16 | byte(1) << 8 | byte(2);
+}
+
+std::vector<std::string> words(const std::string& query) {
+    std::vector<std::string> ret;
+    std::size_t start = 0;
+    while (start < query.size()) {
+        while (start < query.size() &&
+               std::isspace(static_cast<unsigned char>(query[start]))) {
+            start++;
+        }
+        std::size_t end = start;
+        while (end < query.size() &&
+               !std::isspace(static_cast<unsigned char>(query[end]))) {
+            end++;
+        }
+        if (end > start) {
+            ret.push_back(query.substr(start, end - start));
+        }
+        start = end;
+    }
+    return ret;
+}
+
+}  // namespace
+
+std::string TrigramIndex::normalize(std::string_view text) {
+    std::string ret(text);
+    std::transform(ret.begin(), ret.end(), ret.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return ret;
+}
+
+std::uint32_t TrigramIndex::add(std::string_view text) {
+    const std::uint32_t id = static_cast<std::uint32_t>(m_texts.size());
+    std::string normalized = normalize(text);
+
+    for (std::size_t i = 0; i + 3 <= normalized.size(); i++) {
+        std::vector<std::uint32_t>& posting =
+            m_postings[trigramAt(normalized, i)];
+        // Texts are added in ID order, so only the last entry can repeat
+        if (posting.empty() || posting.back() != id) {
+            posting.push_back(id);
+        }
+    }
+
+    m_texts.push_back(std::move(normalized));
+    return id;
+}
+
+std::vector<std::uint32_t> TrigramIndex::search(std::string_view query) const {
+    std::vector<std::string> queryWords = words(normalize(query));
+    // Long words narrow the candidates down the most, so they go first
+    std::sort(queryWords.begin(), queryWords.end(),
+              [](const std::string& a, const std::string& b) {
+                  return a.size() > b.size();
+              });
+
+    std::optional<std::vector<std::uint32_t>> candidates;
+
+    for (const std::string& word : queryWords) {
+        for (std::size_t i = 0; i + 3 <= word.size(); i++) {
+            auto it = m_postings.find(trigramAt(word, i));
+            if (it == m_postings.end()) {
+                return {};
+            }
+            if (!candidates) {
+                candidates = it->second;
+                continue;
+            }
+            std::vector<std::uint32_t> both;
+            std::set_intersection(candidates->begin(), candidates->end(),
+                                  it->second.begin(), it->second.end(),
+                                  std::back_inserter(both));
+            candidates = std::move(both);
+            if (candidates->empty()) {
+                return {};
+            }
+        }
+
+        if (!candidates) {
+            // Only words under three bytes so far, nothing to look up
+            candidates.emplace(m_texts.size());
+            std::iota(candidates->begin(), candidates->end(), 0);
+        }
+
+        // Sharing every trigram doesn't mean the word is in there in order
+        std::erase_if(*candidates, [this, &word](std::uint32_t id) {
+            return m_texts[id].find(word) == std::string::npos;
+        });
+        if (candidates->empty()) {
+            return {};
+        }
+    }
+
+    if (!candidates) {
+        std::vector<std::uint32_t> all(m_texts.size());
+        std::iota(all.begin(), all.end(), 0);
+        return all;
+    }
+    return std::move(candidates.value());
+}
+
+bool TrigramIndex::matches(std::string_view text, std::string_view query) {
+    const std::string normalized = normalize(text);
+    for (const std::string& word : words(normalize(query))) {
+        if (normalized.find(word) == std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t TrigramIndex::memoryUsage() const {
+    std::size_t bytes = memory::heapBytes(m_texts) +
+                        memory::heapBytes(m_postings);
+    for (const std::string& text : m_texts) {
+        bytes += memory::heapBytes(text);
+    }
+    for (const auto& [_, ids] : m_postings) {
+        bytes += memory::heapBytes(ids);
+    }
+    return bytes;
+}
+
+void TrigramIndex::clear() {
+    m_texts.clear();
+    m_postings.clear();
+}
+
+}  // namespace jukebox
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jukebox {
+
+/**
+ * Substring search over a fixed set of texts. Every lowercase three byte
+ * sequence of a text maps to the texts containing it, so a query only has to
+ * check the texts sharing all of its trigrams instead of every text.
+ *
+ * Lowercasing is ASCII only, other UTF-8 bytes are matched as they are.
+ */
+class TrigramIndex final {
+private:
+    std::vector<std::string> m_texts;
+    // trigram -> ascending IDs of the texts containing it
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> m_postings;
+
+public:
+    static std::string normalize(std::string_view text);
+
+    /**
+     * Adds a text to the index
+     *
+     * @return the ID of the text, IDs count up from 0
+     */
+    std::uint32_t add(std::string_view text);
+
+    /**
+     * Finds the texts containing every whitespace separated word of a query
+     *
+     * @return matching text IDs in ascending order. Every ID for an empty
+     * query
+     */
+    std::vector<std::uint32_t> search(std::string_view query) const;
+
+    /**
+     * Same matching as search(), for a single text without an index. For
+     * sets too small to be worth indexing.
+     */
+    static bool matches(std::string_view text, std::string_view query);
+
+    std::size_t size() const { return m_texts.size(); }
+    // Estimated bytes of the texts and posting lists
+    std::size_t memoryUsage() const;
+    void clear();
+};
+
+}  // namespace jukebox
@@ -0,0 +1,74 @@
+#include <jukebox/utils/unique_id.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include <jukebox/utils/memory_usage.hpp>
+#include <jukebox/utils/string_hash.hpp>
+
+namespace jukebox {
+
+namespace {
+
+struct Pool {
+    std::mutex mutex;
+    // Nodes of an unordered_set don't move, so the strings can be pointed at
+    std::unordered_set<std::string, StringHash, std::equal_to<>> strings;
+};
+
+Pool& pool() {
+    // Leaked so IDs stay valid during static destruction
+    static Pool* pool = new Pool();
+    return *pool;
+}
+
+const std::string* emptyString() {
+    static const std::string* empty = new std::string();
+    return empty;
+}
+
+}  // namespace
+
+UniqueID::UniqueID() : m_str(emptyString()) {}
+
+UniqueID::UniqueID(std::string_view str) : m_str(emptyString()) {
+    if (str.empty()) {
+        return;
+    }
+    Pool& ids = pool();
+    std::lock_guard lock(ids.mutex);
+    auto it = ids.strings.find(str);
+    if (it == ids.strings.end()) {
+        it = ids.strings.emplace(str).first;
+    }
+    m_str = &*it;
+}
+
+std::optional<UniqueID> UniqueID::find(std::string_view str) {
+    if (str.empty()) {
+        return UniqueID();
+    }
+    Pool& ids = pool();
+    std::lock_guard lock(ids.mutex);
+    if (auto it = ids.strings.find(str); it != ids.strings.end()) {
+        return UniqueID(&*it);
+    }
+    return std::nullopt;
+}
+
+MemoryUsage UniqueID::memoryUsage() {
+    Pool& ids = pool();
+    std::lock_guard lock(ids.mutex);
+    std::size_t bytes = memory::heapBytes(ids.strings);
+    for (const std::string& str : ids.strings) {
+        bytes += memory::heapBytes(str);
+    }
+    return MemoryUsage{"Unique IDs", ids.strings.size(), bytes};
+}
+
+}  // namespace jukebox
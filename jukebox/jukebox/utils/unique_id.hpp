@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include <jukebox/utils/memory_usage.hpp>
+
+namespace jukebox {
+
+/**
+ * Interned unique ID of a song. Equal IDs share one pooled string, so
+ * comparing and hashing an ID is an integer operation and copying one is
+ * copying a handle.
+ *
+ * Pooled strings are never freed, there is one per song ever seen. Creating
+ * an ID from a string interns it and is safe from any thread, everything
+ * else doesn't lock.
+ */
+class UniqueID final {
+private:
+    // Points at the pooled string, never null
+    const std::string* m_str;
+
+    explicit UniqueID(const std::string* str) : m_str(str) {}
+
+public:
+    // The empty ID
+    UniqueID();
+    // Interns the string. Explicit, so looking a string up never pools it
+    // by accident, use find for that.
+    explicit UniqueID(std::string_view str);
+    explicit UniqueID(const std::string& str)
+        : UniqueID(std::string_view(str)) {}
+    explicit UniqueID(const char* str) : UniqueID(std::string_view(str)) {}
+
+    /**
+     * The ID of a string, without interning it if it isn't one yet. For
+     * lookups of strings that may not be IDs at all.
+     */
+    static std::optional<UniqueID> find(std::string_view str);
+
+    /**
+     * Pooled strings and their estimated bytes. The pool only grows, so
+     * this is every ID seen since launch.
+     */
+    static MemoryUsage memoryUsage();
+
+    const std::string& str() const { return *m_str; }
+    // IDs stand in for their string wherever one is expected
+    operator const std::string&() const { return *m_str; }
+    bool empty() const { return m_str->empty(); }
+    std::uintptr_t handle() const {
+        return reinterpret_cast<std::uintptr_t>(m_str);
+    }
+
+    bool operator==(const UniqueID& other) const {
+        return m_str == other.m_str;
+    }
+    bool operator==(const std::string& other) const { return *m_str == other; }
+    bool operator==(std::string_view other) const { return *m_str == other; }
+    bool operator==(const char* other) const { return *m_str == other; }
+};
+
+}  // namespace jukebox
+
+template <>
+struct std::hash<jukebox::UniqueID> {
+    std::size_t operator()(const jukebox::UniqueID& id) const {
+        return std::hash<std::uintptr_t>{}(id.handle());
+    }
+};
+
+template <>
+struct fmt::formatter<jukebox::UniqueID> : fmt::formatter<std::string_view> {
+    auto format(const jukebox::UniqueID& id, fmt::format_context& ctx) const {
+        return fmt::formatter<std::string_view>::format(id.str(), ctx);
+    }
+};